@@ -0,0 +1,336 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Benchmark of the cryptography used by the mbed TLS transport.
+ *
+ * The benchmark times full TLS handshakes against a server and the AES-GCM
+ * encryption and decryption of TLS sized records. Build it once as is and once
+ * with -DESP32_HW_CRYPTO=ON to compare software crypto with the hardware
+ * accelerator backend of platform/espressif/crypto.
+ */
+
+/* Zephyr includes. */
+#include <zephyr.h>
+
+/* Standard includes. */
+#include <stdint.h>
+#include <string.h>
+
+/* mbed TLS includes. */
+#include <mbedtls/gcm.h>
+
+/* Include Demo Config as the first non-system header. */
+#include "demo_config.h"
+
+/* Transport interface implementation include header for TLS. */
+#include "mbedtls_zephyr.h"
+
+/* Include header for connection configurations. */
+#include "esp_wifi_wrapper.h"
+
+/**
+ * These configuration settings are required to run the benchmark.
+ * Throw compilation error if the below configs are not defined.
+ */
+#ifndef BROKER_ENDPOINT
+    #error "Please define a TLS server endpoint, BROKER_ENDPOINT, in demo_config.h."
+#endif
+#ifndef ROOT_CA_CERT_PEM
+    #error "Please define the Root CA certificate of the TLS server, ROOT_CA_CERT_PEM, in demo_config.h."
+#endif
+#ifndef WIFI_NETWORK_SSID
+    #error "Please define the wifi network ssid, in demo_config.h."
+#endif
+#ifndef WIFI_NETWORK_PASSWORD
+    #error "Please define the wifi network's password in demo_config.h."
+#endif
+
+/**
+ * @brief Length of the TLS server endpoint.
+ */
+#define BROKER_ENDPOINT_LENGTH            ( ( uint16_t ) ( sizeof( BROKER_ENDPOINT ) - 1 ) )
+
+/**
+ * @brief Transport timeout in milliseconds for transport send and receive.
+ */
+#define TRANSPORT_SEND_RECV_TIMEOUT_MS    ( 5000 )
+
+/**
+ * @brief Size of the AES-GCM key, as used by the AES-128-GCM cipher suites.
+ */
+#define GCM_KEY_BITS                      ( 128U )
+
+/**
+ * @brief Size of the AES-GCM nonce of a TLS 1.2 record.
+ */
+#define GCM_IV_LENGTH                     ( 12U )
+
+/**
+ * @brief Size of the additional data authenticated with a TLS 1.2 record.
+ */
+#define GCM_ADDITIONAL_DATA_LENGTH        ( 13U )
+
+/**
+ * @brief Size of the AES-GCM authentication tag.
+ */
+#define GCM_TAG_LENGTH                    ( 16U )
+
+/*-----------------------------------------------------------*/
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    TlsTransportParams_t * pParams;
+};
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Plaintext record encrypted by the throughput benchmark.
+ */
+static uint8_t plaintextRecord[ BENCHMARK_RECORD_SIZE ];
+
+/**
+ * @brief Encrypted record produced by the throughput benchmark.
+ */
+static uint8_t ciphertextRecord[ BENCHMARK_RECORD_SIZE ];
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Time #BENCHMARK_HANDSHAKE_COUNT full TLS handshakes with the server.
+ *
+ * @return 0 if all handshakes succeeded; -1 otherwise.
+ */
+static int benchmarkHandshakes( void );
+
+/**
+ * @brief Time AES-128-GCM encryption and decryption of
+ * #BENCHMARK_RECORD_COUNT records of #BENCHMARK_RECORD_SIZE bytes.
+ *
+ * @return 0 if successful; -1 otherwise.
+ */
+static int benchmarkRecordThroughput( void );
+
+/**
+ * @brief Convert a number of bytes processed in a time to KiB/s.
+ *
+ * @param[in] bytes Number of bytes processed.
+ * @param[in] elapsedMs Time taken in milliseconds.
+ *
+ * @return The throughput in KiB/s.
+ */
+static uint32_t throughputKiBps( uint64_t bytes,
+                                 int64_t elapsedMs );
+
+/*-----------------------------------------------------------*/
+
+static int benchmarkHandshakes( void )
+{
+    int returnStatus = 0;
+    NetworkContext_t networkContext = { 0 };
+    TlsTransportParams_t tlsTransportParams = { 0 };
+    ServerInfo_t serverInfo;
+    NetworkCredentials_t networkCredentials;
+    TlsTransportStatus_t tlsStatus = TLS_TRANSPORT_SUCCESS;
+    int64_t startTimeMs = 0;
+    int64_t elapsedMs = 0;
+    int64_t totalMs = 0;
+    int64_t minMs = INT64_MAX;
+    int64_t maxMs = 0;
+    uint32_t count = 0U;
+
+    networkContext.pParams = &tlsTransportParams;
+
+    serverInfo.pHostName = BROKER_ENDPOINT;
+    serverInfo.hostNameLength = BROKER_ENDPOINT_LENGTH;
+    serverInfo.port = BROKER_PORT;
+
+    ( void ) memset( &networkCredentials, 0, sizeof( NetworkCredentials_t ) );
+    networkCredentials.pRootCa = ROOT_CA_CERT_PEM;
+    networkCredentials.rootCaSize = sizeof( ROOT_CA_CERT_PEM );
+
+    for( count = 0U; ( count < BENCHMARK_HANDSHAKE_COUNT ) && ( returnStatus == 0 ); count++ )
+    {
+        /* Resumed sessions skip the public key operations being measured. */
+        MbedTLS_ClearSessionCache();
+
+        startTimeMs = k_uptime_get();
+        tlsStatus = MbedTLS_Connect( &networkContext,
+                                     &serverInfo,
+                                     &networkCredentials,
+                                     TRANSPORT_SEND_RECV_TIMEOUT_MS,
+                                     TRANSPORT_SEND_RECV_TIMEOUT_MS,
+                                     NULL );
+        elapsedMs = k_uptime_get() - startTimeMs;
+
+        if( tlsStatus != TLS_TRANSPORT_SUCCESS )
+        {
+            LogError( ( "Handshake %u with %.*s:%d failed: TlsTransportStatus_t=%d.",
+                        ( unsigned int ) count,
+                        BROKER_ENDPOINT_LENGTH,
+                        BROKER_ENDPOINT,
+                        BROKER_PORT,
+                        tlsStatus ) );
+            returnStatus = -1;
+        }
+        else
+        {
+            ( void ) MbedTLS_Disconnect( &networkContext );
+
+            LogInfo( ( "Handshake %u: %u ms.", ( unsigned int ) count, ( unsigned int ) elapsedMs ) );
+
+            totalMs += elapsedMs;
+            minMs = ( elapsedMs < minMs ) ? elapsedMs : minMs;
+            maxMs = ( elapsedMs > maxMs ) ? elapsedMs : maxMs;
+        }
+    }
+
+    if( returnStatus == 0 )
+    {
+        LogInfo( ( "Full handshakes: count=%u, min=%u ms, average=%u ms, max=%u ms.",
+                   ( unsigned int ) BENCHMARK_HANDSHAKE_COUNT,
+                   ( unsigned int ) minMs,
+                   ( unsigned int ) ( totalMs / BENCHMARK_HANDSHAKE_COUNT ),
+                   ( unsigned int ) maxMs ) );
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+static int benchmarkRecordThroughput( void )
+{
+    int returnStatus = 0;
+    int mbedtlsError = 0;
+    mbedtls_gcm_context gcmContext;
+    uint8_t key[ GCM_KEY_BITS / 8U ];
+    uint8_t iv[ GCM_IV_LENGTH ];
+    uint8_t additionalData[ GCM_ADDITIONAL_DATA_LENGTH ];
+    uint8_t tag[ GCM_TAG_LENGTH ];
+    int64_t startTimeMs = 0;
+    int64_t encryptMs = 0;
+    int64_t decryptMs = 0;
+    uint32_t count = 0U;
+
+    /* The contents do not change the timing; fixed patterns keep runs comparable. */
+    ( void ) memset( key, 0x2B, sizeof( key ) );
+    ( void ) memset( iv, 0x5A, sizeof( iv ) );
+    ( void ) memset( additionalData, 0x17, sizeof( additionalData ) );
+    ( void ) memset( plaintextRecord, 0xA5, sizeof( plaintextRecord ) );
+
+    mbedtls_gcm_init( &gcmContext );
+    mbedtlsError = mbedtls_gcm_setkey( &gcmContext, MBEDTLS_CIPHER_ID_AES, key, GCM_KEY_BITS );
+
+    startTimeMs = k_uptime_get();
+
+    for( count = 0U; ( count < BENCHMARK_RECORD_COUNT ) && ( mbedtlsError == 0 ); count++ )
+    {
+        mbedtlsError = mbedtls_gcm_crypt_and_tag( &gcmContext,
+                                                  MBEDTLS_GCM_ENCRYPT,
+                                                  sizeof( plaintextRecord ),
+                                                  iv,
+                                                  sizeof( iv ),
+                                                  additionalData,
+                                                  sizeof( additionalData ),
+                                                  plaintextRecord,
+                                                  ciphertextRecord,
+                                                  sizeof( tag ),
+                                                  tag );
+    }
+
+    encryptMs = k_uptime_get() - startTimeMs;
+    startTimeMs = k_uptime_get();
+
+    /* Every record is identical, so the tag of the last one authenticates all. */
+    for( count = 0U; ( count < BENCHMARK_RECORD_COUNT ) && ( mbedtlsError == 0 ); count++ )
+    {
+        mbedtlsError = mbedtls_gcm_auth_decrypt( &gcmContext,
+                                                 sizeof( ciphertextRecord ),
+                                                 iv,
+                                                 sizeof( iv ),
+                                                 additionalData,
+                                                 sizeof( additionalData ),
+                                                 tag,
+                                                 sizeof( tag ),
+                                                 ciphertextRecord,
+                                                 plaintextRecord );
+    }
+
+    decryptMs = k_uptime_get() - startTimeMs;
+
+    mbedtls_gcm_free( &gcmContext );
+
+    if( mbedtlsError != 0 )
+    {
+        LogError( ( "AES-GCM record benchmark failed: mbedTLSError=-0x%x.", ( unsigned int ) -mbedtlsError ) );
+        returnStatus = -1;
+    }
+    else
+    {
+        LogInfo( ( "AES-128-GCM records: count=%u, size=%u bytes, encrypt=%u KiB/s, decrypt=%u KiB/s.",
+                   ( unsigned int ) BENCHMARK_RECORD_COUNT,
+                   ( unsigned int ) BENCHMARK_RECORD_SIZE,
+                   ( unsigned int ) throughputKiBps( ( uint64_t ) BENCHMARK_RECORD_COUNT * BENCHMARK_RECORD_SIZE, encryptMs ),
+                   ( unsigned int ) throughputKiBps( ( uint64_t ) BENCHMARK_RECORD_COUNT * BENCHMARK_RECORD_SIZE, decryptMs ) ) );
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t throughputKiBps( uint64_t bytes,
+                                 int64_t elapsedMs )
+{
+    /* Runs shorter than the uptime resolution count as 1 ms. */
+    if( elapsedMs <= 0 )
+    {
+        elapsedMs = 1;
+    }
+
+    return ( uint32_t ) ( ( bytes * 1000U ) / ( ( uint64_t ) elapsedMs * 1024U ) );
+}
+/*-----------------------------------------------------------*/
+
+void main()
+{
+    #if defined( MBEDTLS_AES_ENCRYPT_ALT )
+        LogInfo( ( "Crypto backend: ESP32 hardware AES." ) );
+    #else
+        LogInfo( ( "Crypto backend: mbed TLS software." ) );
+    #endif
+
+    /* Record throughput does not need the network, so measure it first. */
+    ( void ) benchmarkRecordThroughput();
+
+    LogInfo( ( "Connecting to WiFi network: SSID=%.*s ...", strlen( WIFI_NETWORK_SSID ), WIFI_NETWORK_SSID ) );
+
+    if( Wifi_Connect( WIFI_NETWORK_SSID, strlen( WIFI_NETWORK_SSID ), WIFI_NETWORK_PASSWORD, strlen( WIFI_NETWORK_PASSWORD ) ) )
+    {
+        ( void ) benchmarkHandshakes();
+    }
+    else
+    {
+        LogError( ( "Unable to attempt wifi connection. Benchmark terminating." ) );
+    }
+}
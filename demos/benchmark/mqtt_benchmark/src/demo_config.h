@@ -0,0 +1,217 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef DEMO_CONFIG_H
+#define DEMO_CONFIG_H
+
+/**************************************************/
+/******* DO NOT CHANGE the following order ********/
+/**************************************************/
+
+/* Include logging header files and define logging macros in the following order:
+ * 1. Include the header file "logging_levels.h".
+ * 2. Define the LIBRARY_LOG_NAME and LIBRARY_LOG_LEVEL macros depending on
+ * the logging configuration for DEMO.
+ * 3. Include the header file "logging_stack.h", if logging is enabled for DEMO.
+ */
+
+#include "logging_levels.h"
+
+/* Logging configuration for the Demo. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME    "BENCHMARK"
+#endif
+
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+/************ End of logging configuration ****************/
+
+/**
+ * @brief Host name or IPv4 address of the MQTT broker.
+ *
+ * Use a broker on the local network, such as Mosquitto, so that the results
+ * measure the device rather than the Internet. The default is the host side
+ * of the TAP interface of native_posix and qemu_x86.
+ */
+#ifndef BROKER_ENDPOINT
+    #define BROKER_ENDPOINT    "192.0.2.2"
+#endif
+
+/**
+ * @brief Broker port of MQTT over TLS, used with
+ * CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_TLS.
+ */
+#ifndef BROKER_TLS_PORT
+    #define BROKER_TLS_PORT    ( 8883 )
+#endif
+
+/**
+ * @brief Broker port of plaintext MQTT, used with
+ * CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_PLAINTEXT.
+ */
+#ifndef BROKER_PLAINTEXT_PORT
+    #define BROKER_PLAINTEXT_PORT    ( 1883 )
+#endif
+
+/**
+ * @brief Root CA certificate of the broker, for the TLS transport.
+ *
+ * Replace it with the CA that signed the certificate of the local broker.
+ * The preset default value is of AmazonRootCA1.pem, for AWS IoT endpoints.
+ *
+ * @note This certificate should be PEM-encoded.
+ *
+ * #define ROOT_CA_CERT_PEM    "...insert here..."
+ */
+#ifndef ROOT_CA_CERT_PEM
+    #define ROOT_CA_CERT_PEM    "-----BEGIN CERTIFICATE-----\n"\
+                                "MIIDQTCCAimgAwIBAgITBmyfz5m/jAo54vB4ikPmljZbyjANBgkqhkiG9w0BAQsF\n"\
+                                "ADA5MQswCQYDVQQGEwJVUzEPMA0GA1UEChMGQW1hem9uMRkwFwYDVQQDExBBbWF6\n"\
+                                "b24gUm9vdCBDQSAxMB4XDTE1MDUyNjAwMDAwMFoXDTM4MDExNzAwMDAwMFowOTEL\n"\
+                                "MAkGA1UEBhMCVVMxDzANBgNVBAoTBkFtYXpvbjEZMBcGA1UEAxMQQW1hem9uIFJv\n"\
+                                "b3QgQ0EgMTCCASIwDQYJKoZIhvcNAQEBBQADggEPADCCAQoCggEBALJ4gHHKeNXj\n"\
+                                "ca9HgFB0fW7Y14h29Jlo91ghYPl0hAEvrAIthtOgQ3pOsqTQNroBvo3bSMgHFzZM\n"\
+                                "9O6II8c+6zf1tRn4SWiw3te5djgdYZ6k/oI2peVKVuRF4fn9tBb6dNqcmzU5L/qw\n"\
+                                "IFAGbHrQgLKm+a/sRxmPUDgH3KKHOVj4utWp+UhnMJbulHheb4mjUcAwhmahRWa6\n"\
+                                "VOujw5H5SNz/0egwLX0tdHA114gk957EWW67c4cX8jJGKLhD+rcdqsq08p8kDi1L\n"\
+                                "93FcXmn/6pUCyziKrlA4b9v7LWIbxcceVOF34GfID5yHI9Y/QCB/IIDEgEw+OyQm\n"\
+                                "jgSubJrIqg0CAwEAAaNCMEAwDwYDVR0TAQH/BAUwAwEB/zAOBgNVHQ8BAf8EBAMC\n"\
+                                "AYYwHQYDVR0OBBYEFIQYzIU07LwMlJQuCFmcx7IQTgoIMA0GCSqGSIb3DQEBCwUA\n"\
+                                "A4IBAQCY8jdaQZChGsV2USggNiMOruYou6r4lK5IpDB/G/wkjUu0yKGX9rbxenDI\n"\
+                                "U5PMCCjjmCXPI6T53iHTfIUJrU6adTrCC2qJeHZERxhlbI1Bjjt/msv0tadQ1wUs\n"\
+                                "N+gDS63pYaACbvXy8MWy7Vu33PqUXHeeE6V/Uq2V8viTO96LXFvKWlJbYK8U90vv\n"\
+                                "o/ufQJVtMVT8QtPHRh8jrdkPSHCa2XV4cdFyQzR1bldZwgJcJmApzyMZFo6IQ6XU\n"\
+                                "5MsI+yMRQ+hDKXJioaldXgjUkK642M4UwtBV8ob2xJNDd2ZhwLnoQdeXeGADbkpy\n"\
+                                "rqXRfboQnoZsG4q5WTP468SQvvG5\n"\
+                                "-----END CERTIFICATE-----"
+#endif
+
+/**
+ * @brief Set to 1 to skip the server name indication of the TLS handshake,
+ * which is needed when #BROKER_ENDPOINT is an IP address.
+ */
+#ifndef DISABLE_SNI
+    #define DISABLE_SNI    ( 1 )
+#endif
+
+/**
+ * @brief MQTT client identifier of the benchmark. It must be unique on the
+ * broker.
+ */
+#ifndef CLIENT_IDENTIFIER
+    #define CLIENT_IDENTIFIER    "mqtt-benchmark"
+#endif
+
+/**
+ * @brief Payload sizes of the sweep, in bytes.
+ *
+ * Each payload starts with an 8 byte header for the round trip timing, so
+ * sizes below 8 are rounded up.
+ */
+#ifndef BENCHMARK_PAYLOAD_SIZES
+    #define BENCHMARK_PAYLOAD_SIZES    { 16U, 256U, 1024U }
+#endif
+
+/**
+ * @brief Largest payload of #BENCHMARK_PAYLOAD_SIZES, which sizes the
+ * payload buffers.
+ */
+#ifndef BENCHMARK_MAX_PAYLOAD_SIZE
+    #define BENCHMARK_MAX_PAYLOAD_SIZE    ( 1024U )
+#endif
+
+/**
+ * @brief QoS levels of the sweep.
+ */
+#ifndef BENCHMARK_QOS_LEVELS
+    #define BENCHMARK_QOS_LEVELS    { MQTTQoS0, MQTTQoS1 }
+#endif
+
+/**
+ * @brief Numbers of producer threads of the sweep.
+ */
+#ifndef BENCHMARK_PRODUCER_COUNTS
+    #define BENCHMARK_PRODUCER_COUNTS    { 1U, 2U, 4U }
+#endif
+
+/**
+ * @brief Largest number of #BENCHMARK_PRODUCER_COUNTS, which sizes the
+ * thread stacks.
+ */
+#ifndef BENCHMARK_MAX_PRODUCERS
+    #define BENCHMARK_MAX_PRODUCERS    ( 4U )
+#endif
+
+/**
+ * @brief Number of publishes of each producer in each run.
+ */
+#ifndef BENCHMARK_MESSAGES_PER_PRODUCER
+    #define BENCHMARK_MESSAGES_PER_PRODUCER    ( 200U )
+#endif
+
+/**
+ * @brief Number of publishes a producer keeps in flight before waiting for
+ * the oldest to complete.
+ */
+#ifndef BENCHMARK_PUBLISH_WINDOW
+    #define BENCHMARK_PUBLISH_WINDOW    ( 4U )
+#endif
+
+/**
+ * @brief Number of times the whole sweep is run. Repeating it shows the
+ * run to run variation.
+ */
+#ifndef BENCHMARK_REPEAT_COUNT
+    #define BENCHMARK_REPEAT_COUNT    ( 1U )
+#endif
+
+/**
+ * @brief Stack size of the agent thread, which also runs mbed TLS.
+ */
+#ifndef BENCHMARK_AGENT_STACK_SIZE
+    #define BENCHMARK_AGENT_STACK_SIZE    ( 4096U )
+#endif
+
+/**
+ * @brief Stack size of each producer thread.
+ */
+#ifndef BENCHMARK_PRODUCER_STACK_SIZE
+    #define BENCHMARK_PRODUCER_STACK_SIZE    ( 1536U )
+#endif
+
+/**
+ * @brief The name of the Wi-Fi network to join, on ESP32.
+ *
+ * #define WIFI_NETWORK_SSID        "...insert here..."
+ */
+
+/**
+ * @brief Password needed to join Wi-Fi network. If you are using WPA, set this
+ * to your network password. If there is no password, use the empty string "".
+ *
+ * #define WIFI_NETWORK_PASSWORD    "...insert here...."
+ */
+
+#endif /* ifndef DEMO_CONFIG_H */
@@ -0,0 +1,1193 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Throughput and latency benchmark of the MQTT agent and the transports.
+ *
+ * For every combination of the payload sizes, QoS levels and producer counts
+ * of demo_config.h, the benchmark connects to the broker, subscribes to its
+ * own topic, and has each producer thread publish
+ * BENCHMARK_MESSAGES_PER_PRODUCER messages through the agent, with up to
+ * BENCHMARK_PUBLISH_WINDOW of them in flight. Each payload carries the cycle
+ * counter at its publish, so that its echo from the broker gives the round
+ * trip time.
+ *
+ * Each run prints one line starting with "BENCHMARK " followed by a JSON
+ * object, and the sweep ends with a "BENCHMARK_DONE" line, so that a host
+ * script can collect the results from the console next to the logs. Build
+ * the benchmark once with CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_TLS and once
+ * with CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_PLAINTEXT to compare the
+ * transports. The coalescing, latency tracing and runner options of the
+ * agent are used when enabled, so their effect can be measured the same
+ * way.
+ */
+
+/* Zephyr includes. */
+#include <zephyr.h>
+#include <sys/printk.h>
+#include <net/socket.h>
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Include Demo Config as the first non-system header. */
+#include "demo_config.h"
+
+/* MQTT agent include. */
+#include "core_mqtt_agent.h"
+
+/* MQTT agent interface of Zephyr, and its latency histograms. */
+#include "agent_interface_zephyr.h"
+#include "agent_latency_zephyr.h"
+
+#if defined( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER )
+    /* Serves the agent from the runner thread. */
+    #include "agent_runner_zephyr.h"
+#endif
+
+#if defined( CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_PLAINTEXT )
+    /* Transport interface implementation include header for plaintext. */
+    #include "plaintext_zephyr.h"
+#else
+    /* Transport interface implementation include header for TLS. */
+    #include "mbedtls_zephyr.h"
+#endif
+
+#if defined( CONFIG_WIFI_ESP32 )
+    /* Include header for connection configurations. */
+    #include "esp_wifi_wrapper.h"
+#endif
+
+#if defined( CONFIG_BOARD_NATIVE_POSIX )
+    /* Ends the process once the sweep is done. */
+    #include "posix_board_if.h"
+#endif
+
+/**
+ * These configuration settings are required to run the benchmark.
+ * Throw compilation error if the below configs are not defined.
+ */
+#if defined( CONFIG_WIFI_ESP32 )
+    #ifndef WIFI_NETWORK_SSID
+        #error "Please define the wifi network ssid, in demo_config.h."
+    #endif
+    #ifndef WIFI_NETWORK_PASSWORD
+        #error "Please define the wifi network's password in demo_config.h."
+    #endif
+#endif
+#if ( BENCHMARK_PUBLISH_WINDOW * BENCHMARK_MAX_PRODUCERS ) > MQTT_STATE_ARRAY_MAX_COUNT
+    #error "MQTT_STATE_ARRAY_MAX_COUNT must hold every QoS 1 publish in flight."
+#endif
+
+/**
+ * @brief Name of the transport in the results, and port of the broker.
+ */
+#if defined( CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_PLAINTEXT )
+    #define BENCHMARK_TRANSPORT_NAME    "plaintext"
+    #define BROKER_PORT                 BROKER_PLAINTEXT_PORT
+#else
+    #define BENCHMARK_TRANSPORT_NAME    "tls"
+    #define BROKER_PORT                 BROKER_TLS_PORT
+#endif
+
+/**
+ * @brief Topic published to and subscribed to by the benchmark.
+ */
+#define BENCHMARK_TOPIC                   "benchmark/" CLIENT_IDENTIFIER
+
+/**
+ * @brief Length of #BENCHMARK_TOPIC.
+ */
+#define BENCHMARK_TOPIC_LENGTH            ( ( uint16_t ) ( sizeof( BENCHMARK_TOPIC ) - 1U ) )
+
+/**
+ * @brief Timeout for receiving CONNACK packet in milliseconds.
+ */
+#define CONNACK_RECV_TIMEOUT_MS           ( 1000U )
+
+/**
+ * @brief Keep-alive interval of the benchmark connections, in seconds.
+ */
+#define KEEP_ALIVE_INTERVAL_SECONDS       ( 60U )
+
+/**
+ * @brief Transport timeout in milliseconds for transport send and receive.
+ */
+#define TRANSPORT_SEND_RECV_TIMEOUT_MS    ( 750 )
+
+/**
+ * @brief Size of the network buffer of the agent.
+ */
+#define NETWORK_BUFFER_SIZE               ( BENCHMARK_MAX_PAYLOAD_SIZE + 128U )
+
+/**
+ * @brief Number of commands the queue of the agent holds.
+ */
+#define COMMAND_QUEUE_LENGTH              ( 25U )
+
+/**
+ * @brief Longest time a producer or the benchmark waits for the agent to
+ * accept or complete a command. A run that hits it is reported as failed.
+ */
+#define COMMAND_TIMEOUT_MS                ( 10000U )
+
+/**
+ * @brief Longest time to wait for the echoes of the publishes once the
+ * producers are done.
+ */
+#define ECHO_DRAIN_TIMEOUT_MS             ( 2000U )
+
+/**
+ * @brief Priorities of the agent and producer threads. The agent runs above
+ * the producers, so that its command queue does not fill up.
+ */
+#define AGENT_THREAD_PRIORITY             ( 4 )
+#define PRODUCER_THREAD_PRIORITY          ( 5 )
+
+/*-----------------------------------------------------------*/
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    #if defined( CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_PLAINTEXT )
+        PlaintextParams_t * pParams;
+    #else
+        TlsTransportParams_t * pParams;
+    #endif
+};
+
+/**
+ * @brief Context of a command of the benchmark. Each producer owns
+ * #BENCHMARK_PUBLISH_WINDOW of them, one per publish in flight.
+ */
+struct MQTTAgentCommandContext
+{
+    MQTTPublishInfo_t publishInfo; /**< @brief The publish, which must persist until it completes. */
+    uint32_t startCycles;          /**< @brief Cycle counter when the publish was requested. */
+    uint32_t producer;             /**< @brief Index of the producer owning the context. */
+    atomic_t busy;                 /**< @brief Whether a publish is in flight with the context. */
+    MQTTStatus_t returnStatus;     /**< @brief Result of the command. */
+};
+
+/**
+ * @brief Header written at the start of each payload.
+ */
+typedef struct BenchmarkHeader
+{
+    uint32_t publishCycles; /**< @brief Cycle counter when the publish was requested. */
+    uint32_t runId;         /**< @brief Run of the publish, so that late echoes are ignored. */
+} BenchmarkHeader_t;
+
+/**
+ * @brief Parameters of one run of the sweep.
+ */
+typedef struct BenchmarkRun
+{
+    uint32_t payloadSize; /**< @brief Size of each payload. */
+    MQTTQoS_t qos;        /**< @brief QoS of the publishes and of the subscription. */
+    uint32_t producers;   /**< @brief Number of producer threads. */
+} BenchmarkRun_t;
+
+/**
+ * @brief Measurements of one run, filled by the agent thread.
+ */
+typedef struct BenchmarkStats
+{
+    AgentLatencyHistogram_t publishLatency; /**< @brief From the publish request to its completion: PUBACK for QoS 1, send for QoS 0. */
+    AgentLatencyHistogram_t roundTrip;      /**< @brief From the publish request to the reception of its echo. */
+    atomic_t completed;                     /**< @brief Publishes that completed successfully. */
+    atomic_t failed;                        /**< @brief Publishes that could not be queued or failed. */
+    atomic_t received;                      /**< @brief Echoes received. */
+} BenchmarkStats_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Run the whole sweep once.
+ *
+ * @return The number of runs that failed.
+ */
+static uint32_t runSweep( void );
+
+/**
+ * @brief Connect, publish from the producer threads, disconnect and print the
+ * results of one run.
+ *
+ * @param[in] pRun Parameters of the run.
+ *
+ * @return true if every publish completed; false otherwise.
+ */
+static bool runBenchmark( const BenchmarkRun_t * pRun );
+
+/**
+ * @brief Connect the transport to the broker and hand its socket to the agent.
+ *
+ * @return true if connected; false otherwise.
+ */
+static bool transportConnect( void );
+
+/**
+ * @brief Take the socket from the agent and disconnect the transport.
+ */
+static void transportDisconnect( void );
+
+/**
+ * @brief Initialize the agent for a new connection.
+ *
+ * @return #MQTTSuccess, or the error of MQTTAgent_Init().
+ */
+static MQTTStatus_t mqttAgentInit( void );
+
+/**
+ * @brief Send the MQTT CONNECT packet with a clean session.
+ *
+ * @return #MQTTSuccess, or the error of MQTT_Connect().
+ */
+static MQTTStatus_t mqttConnect( void );
+
+/**
+ * @brief Subscribe to #BENCHMARK_TOPIC through the agent.
+ *
+ * @param[in] qos QoS of the subscription.
+ *
+ * @return true if the broker accepted the subscription; false otherwise.
+ */
+static bool subscribeToTopic( MQTTQoS_t qos );
+
+/**
+ * @brief Thread running the command loop of the agent until it disconnects.
+ *
+ * @param[in] a Unused parameter to fit Zephyr thread creation.
+ * @param[in] b Unused parameter to fit Zephyr thread creation.
+ * @param[in] c Unused parameter to fit Zephyr thread creation.
+ */
+static void agentTask( void * a,
+                       void * b,
+                       void * c );
+
+#if defined( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER )
+
+/**
+ * @brief Called when the benchmark connection ends, to remove it from the
+ * runner.
+ *
+ * @param[in] pAgentContext Agent of the connection.
+ * @param[in] loopStatus Status with which the connection ended.
+ *
+ * @return false, so that AgentRunner_Run() returns.
+ */
+    static bool agentLoopExit( MQTTAgentContext_t * pAgentContext,
+                               MQTTStatus_t loopStatus );
+#endif
+
+/**
+ * @brief Thread publishing the messages of one producer.
+ *
+ * @param[in] pProducer Index of the producer.
+ * @param[in] pRun The #BenchmarkRun_t of the run.
+ * @param[in] c Unused parameter to fit Zephyr thread creation.
+ */
+static void producerTask( void * pProducer,
+                          void * pRun,
+                          void * c );
+
+/**
+ * @brief Called by the agent when a publish completes.
+ *
+ * @param[in] pCommandContext Context of the publish.
+ * @param[in] pReturnInfo The result of the publish.
+ */
+static void publishCompleteCallback( MQTTAgentCommandContext_t * pCommandContext,
+                                     MQTTAgentReturnInfo_t * pReturnInfo );
+
+/**
+ * @brief Called by the agent when the broker acknowledges the subscription.
+ *
+ * @param[in] pCommandContext Context of the subscribe.
+ * @param[in] pReturnInfo The result of the subscribe.
+ */
+static void subscribeCompleteCallback( MQTTAgentCommandContext_t * pCommandContext,
+                                       MQTTAgentReturnInfo_t * pReturnInfo );
+
+/**
+ * @brief Called by the agent for each incoming publish, which is the echo of
+ * a publish of the benchmark.
+ *
+ * @param[in] pMqttAgentContext The agent.
+ * @param[in] packetId Packet ID of the publish.
+ * @param[in] pPublishInfo The publish.
+ */
+static void incomingPublishCallback( MQTTAgentContext_t * pMqttAgentContext,
+                                     uint16_t packetId,
+                                     MQTTPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Print the results of a run as one JSON line.
+ *
+ * @param[in] pRun Parameters of the run.
+ * @param[in] connectMs Time to connect the transport and MQTT.
+ * @param[in] elapsedMs Time from the start of the producers to their end.
+ * @param[in] cpuCycles Cycles used by the agent and producer threads meanwhile.
+ */
+static void printResults( const BenchmarkRun_t * pRun,
+                          uint32_t connectMs,
+                          uint32_t elapsedMs,
+                          uint64_t cpuCycles );
+
+/**
+ * @brief Cycles a thread has run for.
+ *
+ * @param[in] pThread The thread.
+ *
+ * @return The execution cycles of the thread, or 0 without
+ * CONFIG_THREAD_RUNTIME_STATS.
+ */
+static uint64_t threadCycles( struct k_thread * pThread );
+
+/**
+ * @brief Peak stack use of a thread.
+ *
+ * @param[in] pThread The thread.
+ * @param[in] stackSize Size of its stack.
+ *
+ * @return The bytes of stack used, or -1 without CONFIG_INIT_STACKS.
+ */
+static int32_t threadStackPeak( const struct k_thread * pThread,
+                                size_t stackSize );
+
+/**
+ * @brief The timer query function provided to the MQTT context.
+ *
+ * @return Time in milliseconds.
+ */
+static uint32_t getTimeMs( void );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The network context used by the MQTT library transport interface.
+ */
+static NetworkContext_t networkContext;
+
+#if defined( CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_PLAINTEXT )
+
+/**
+ * @brief The parameters for the network context using a plaintext channel.
+ */
+    static PlaintextParams_t transportParams;
+#else
+
+/**
+ * @brief The parameters for the network context using a TLS channel.
+ */
+    static TlsTransportParams_t transportParams;
+
+/**
+ * @brief Credentials parsed on the first connection and reused by the others.
+ */
+    static TlsCredentialStore_t credentialStore;
+
+/**
+ * @brief Whether #credentialStore has been loaded.
+ */
+    static bool credentialStoreLoaded = false;
+#endif /* if defined( CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_PLAINTEXT ) */
+
+/**
+ * @brief Global entry time into the application, the reference of
+ * #getTimeMs.
+ */
+static uint32_t globalEntryTimeMs;
+
+/**
+ * @brief MQTT agent of the benchmark connection.
+ */
+static MQTTAgentContext_t agentContext;
+
+/**
+ * @brief Network buffer for coreMQTT.
+ */
+static uint8_t networkBuffer[ NETWORK_BUFFER_SIZE ];
+
+#if ( AGENT_COALESCE_PUBLISHES == 1 )
+
+/**
+ * @brief Buffer coalescing the packets of consecutive QoS 0 publishes.
+ */
+    static uint8_t coalesceBuffer[ NETWORK_BUFFER_SIZE ];
+#endif
+
+/**
+ * @brief Message queue used to deliver commands to the agent.
+ */
+static MQTTAgentMessageContext_t commandQueue;
+
+/**
+ * @brief Storage of #commandQueue.
+ */
+static char __aligned( 8 ) commandQueueBuffer[ COMMAND_QUEUE_LENGTH * sizeof( MQTTAgentCommand_t * ) ];
+
+/**
+ * @brief Contexts of the publishes in flight of each producer.
+ */
+static MQTTAgentCommandContext_t publishContexts[ BENCHMARK_MAX_PRODUCERS ][ BENCHMARK_PUBLISH_WINDOW ];
+
+/**
+ * @brief Payloads of the publishes in flight of each producer.
+ */
+static uint8_t payloads[ BENCHMARK_MAX_PRODUCERS ][ BENCHMARK_PUBLISH_WINDOW ][ BENCHMARK_MAX_PAYLOAD_SIZE ];
+
+/**
+ * @brief Free publish contexts of each producer.
+ */
+static struct k_sem windowSems[ BENCHMARK_MAX_PRODUCERS ];
+
+/**
+ * @brief Given when the subscription of a run is acknowledged.
+ */
+static struct k_sem subscribeSem;
+
+/**
+ * @brief Measurements of the current run.
+ */
+static BenchmarkStats_t stats;
+
+/**
+ * @brief Identifier of the current run, written in the payloads.
+ */
+static uint32_t currentRunId = 0U;
+
+/**
+ * @brief Thread of the agent.
+ */
+static struct k_thread agentThread;
+
+/**
+ * @brief Threads of the producers.
+ */
+static struct k_thread producerThreads[ BENCHMARK_MAX_PRODUCERS ];
+
+/**
+ * @brief Buffer of the JSON line of #printResults.
+ */
+static char resultLine[ 512 ];
+
+K_THREAD_STACK_DEFINE( agentStackArea, BENCHMARK_AGENT_STACK_SIZE );
+K_THREAD_STACK_ARRAY_DEFINE( producerStackArea, BENCHMARK_MAX_PRODUCERS, BENCHMARK_PRODUCER_STACK_SIZE );
+
+/*-----------------------------------------------------------*/
+
+static uint32_t runSweep( void )
+{
+    static const uint32_t payloadSizes[] = BENCHMARK_PAYLOAD_SIZES;
+    static const MQTTQoS_t qosLevels[] = BENCHMARK_QOS_LEVELS;
+    static const uint32_t producerCounts[] = BENCHMARK_PRODUCER_COUNTS;
+    BenchmarkRun_t run;
+    uint32_t failures = 0U;
+    size_t i, j, k;
+
+    for( i = 0U; i < ARRAY_SIZE( payloadSizes ); i++ )
+    {
+        for( j = 0U; j < ARRAY_SIZE( qosLevels ); j++ )
+        {
+            for( k = 0U; k < ARRAY_SIZE( producerCounts ); k++ )
+            {
+                run.payloadSize = MIN( MAX( payloadSizes[ i ], sizeof( BenchmarkHeader_t ) ), BENCHMARK_MAX_PAYLOAD_SIZE );
+                run.qos = qosLevels[ j ];
+                run.producers = MIN( MAX( producerCounts[ k ], 1U ), BENCHMARK_MAX_PRODUCERS );
+
+                if( runBenchmark( &run ) == false )
+                {
+                    failures++;
+                }
+            }
+        }
+    }
+
+    return failures;
+}
+/*-----------------------------------------------------------*/
+
+static bool runBenchmark( const BenchmarkRun_t * pRun )
+{
+    bool success = false, connected = false, agentStarted = false;
+    MQTTAgentCommandInfo_t commandInfo = { 0 };
+    uint32_t startMs = 0U, connectMs = 0U, elapsedMs = 0U;
+    uint64_t cpuCycles = 0U, agentStartCycles = 0U;
+    uint32_t i;
+
+    /* The agent of the previous run is gone, so none of its publishes is
+     * still in flight. */
+    ( void ) memset( &stats, 0, sizeof( stats ) );
+    ( void ) memset( publishContexts, 0, sizeof( publishContexts ) );
+    currentRunId++;
+
+    LogInfo( ( "Run %u: payload=%u bytes, QoS%d, %u producers.",
+               ( unsigned int ) currentRunId,
+               ( unsigned int ) pRun->payloadSize,
+               ( int ) pRun->qos,
+               ( unsigned int ) pRun->producers ) );
+
+    startMs = k_uptime_get_32();
+
+    if( ( transportConnect() == true ) &&
+        ( mqttAgentInit() == MQTTSuccess ) )
+    {
+        connected = ( mqttConnect() == MQTTSuccess );
+
+        if( connected == false )
+        {
+            LogError( ( "MQTT connection to the broker failed." ) );
+        }
+    }
+
+    connectMs = k_uptime_get_32() - startMs;
+
+    if( connected == true )
+    {
+        k_thread_create( &agentThread,
+                         agentStackArea,
+                         K_THREAD_STACK_SIZEOF( agentStackArea ),
+                         agentTask,
+                         NULL,
+                         NULL,
+                         NULL,
+                         AGENT_THREAD_PRIORITY,
+                         0,
+                         K_NO_WAIT );
+        agentStarted = true;
+
+        success = subscribeToTopic( pRun->qos );
+    }
+
+    if( success == true )
+    {
+        /* Only the publishes are measured, from the start of the producers
+         * to their end. */
+        agentStartCycles = threadCycles( &agentThread );
+        startMs = k_uptime_get_32();
+
+        for( i = 0U; i < pRun->producers; i++ )
+        {
+            k_sem_init( &( windowSems[ i ] ), BENCHMARK_PUBLISH_WINDOW, BENCHMARK_PUBLISH_WINDOW );
+            k_thread_create( &( producerThreads[ i ] ),
+                             producerStackArea[ i ],
+                             K_THREAD_STACK_SIZEOF( producerStackArea[ i ] ),
+                             producerTask,
+                             ( void * ) ( uintptr_t ) i,
+                             ( void * ) pRun,
+                             NULL,
+                             PRODUCER_THREAD_PRIORITY,
+                             0,
+                             K_NO_WAIT );
+        }
+
+        for( i = 0U; i < pRun->producers; i++ )
+        {
+            ( void ) k_thread_join( &( producerThreads[ i ] ), K_FOREVER );
+            cpuCycles += threadCycles( &( producerThreads[ i ] ) );
+        }
+
+        elapsedMs = k_uptime_get_32() - startMs;
+        cpuCycles += threadCycles( &agentThread ) - agentStartCycles;
+
+        /* QoS 0 echoes may be lost, so stop waiting for them after a while. */
+        startMs = k_uptime_get_32();
+
+        while( ( ( uint32_t ) atomic_get( &( stats.received ) ) < ( uint32_t ) atomic_get( &( stats.completed ) ) ) &&
+               ( ( k_uptime_get_32() - startMs ) < ECHO_DRAIN_TIMEOUT_MS ) )
+        {
+            k_sleep( K_MSEC( 10 ) );
+        }
+
+        success = ( atomic_get( &( stats.completed ) ) == ( atomic_val_t ) ( pRun->producers * BENCHMARK_MESSAGES_PER_PRODUCER ) );
+    }
+
+    if( agentStarted == true )
+    {
+        /* The command loop returns once the DISCONNECT is sent. */
+        commandInfo.blockTimeMs = COMMAND_TIMEOUT_MS;
+
+        if( ( MQTTAgent_Disconnect( &agentContext, &commandInfo ) != MQTTSuccess ) ||
+            ( k_thread_join( &agentThread, K_MSEC( COMMAND_TIMEOUT_MS ) ) != 0 ) )
+        {
+            LogError( ( "The agent did not disconnect, aborting it." ) );
+            k_thread_abort( &agentThread );
+        }
+    }
+
+    if( connected == true )
+    {
+        transportDisconnect();
+    }
+
+    if( agentStarted == true )
+    {
+        printResults( pRun, connectMs, elapsedMs, cpuCycles );
+    }
+
+    return success;
+}
+/*-----------------------------------------------------------*/
+
+static bool transportConnect( void )
+{
+    bool connected = false;
+    int32_t socketDescriptor = -1;
+    AgentPendingDataCheck_t pendingDataCheck = NULL;
+    ServerInfo_t serverInfo = { 0 };
+    SocketsConfig_t socketsConfig = { 0 };
+    /* Set the receive timeout to a small nonzero value. */
+    const uint32_t transportTimeout = 1U;
+
+    #if !defined( CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_PLAINTEXT )
+        NetworkCredentials_t networkCredentials = { 0 };
+    #endif
+
+    /* Initialize the MQTT broker information. */
+    serverInfo.pHostName = BROKER_ENDPOINT;
+    serverInfo.hostNameLength = sizeof( BROKER_ENDPOINT ) - 1U;
+    serverInfo.port = BROKER_PORT;
+
+    /* Send the small packets of the agent without waiting to coalesce them. */
+    socketsConfig.noDelay = true;
+
+    networkContext.pParams = &transportParams;
+
+    LogInfo( ( "Creating a %s connection to %s:%d.",
+               BENCHMARK_TRANSPORT_NAME,
+               BROKER_ENDPOINT,
+               BROKER_PORT ) );
+
+    #if defined( CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_PLAINTEXT )
+        connected = ( Plaintext_Connect( &networkContext,
+                                         &serverInfo,
+                                         TRANSPORT_SEND_RECV_TIMEOUT_MS,
+                                         TRANSPORT_SEND_RECV_TIMEOUT_MS,
+                                         &socketsConfig ) == SOCKETS_SUCCESS );
+        socketDescriptor = transportParams.socketDescriptor;
+        pendingDataCheck = Plaintext_HasPendingData;
+    #else
+        networkCredentials.disableSni = DISABLE_SNI;
+        networkCredentials.pRootCa = ROOT_CA_CERT_PEM;
+        networkCredentials.rootCaSize = sizeof( ROOT_CA_CERT_PEM );
+
+        /* Parse the credentials only once, so that the runs do not repeat it. */
+        if( credentialStoreLoaded == false )
+        {
+            credentialStoreLoaded = ( MbedTLS_LoadCredentials( &credentialStore,
+                                                               &networkCredentials ) == TLS_TRANSPORT_SUCCESS );
+        }
+
+        if( credentialStoreLoaded == true )
+        {
+            networkCredentials.pCredentialStore = &credentialStore;
+        }
+
+        connected = ( MbedTLS_Connect( &networkContext,
+                                       &serverInfo,
+                                       &networkCredentials,
+                                       TRANSPORT_SEND_RECV_TIMEOUT_MS,
+                                       TRANSPORT_SEND_RECV_TIMEOUT_MS,
+                                       &socketsConfig ) == TLS_TRANSPORT_SUCCESS );
+        socketDescriptor = transportParams.tcpSocket;
+        pendingDataCheck = MbedTLS_HasPendingData;
+    #endif /* if defined( CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_PLAINTEXT ) */
+
+    if( connected == true )
+    {
+        zsock_setsockopt( socketDescriptor,
+                          0,
+                          SO_RCVTIMEO,
+                          &( K_TICKS( transportTimeout ) ),
+                          sizeof( k_timeout_t ) );
+
+        /* Let the agent sleep until a command is queued or data arrives. */
+        Agent_SetNetworkSocket( &commandQueue,
+                                socketDescriptor,
+                                &networkContext,
+                                pendingDataCheck );
+    }
+    else
+    {
+        LogError( ( "Failed to connect to %s:%d.", BROKER_ENDPOINT, BROKER_PORT ) );
+    }
+
+    return connected;
+}
+/*-----------------------------------------------------------*/
+
+static void transportDisconnect( void )
+{
+    Agent_SetNetworkSocket( &commandQueue, -1, NULL, NULL );
+
+    #if defined( CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_PLAINTEXT )
+        ( void ) Plaintext_Disconnect( &networkContext );
+    #else
+        ( void ) MbedTLS_Disconnect( &networkContext );
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t mqttAgentInit( void )
+{
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t fixedBuffer = { 0 };
+    MQTTAgentMessageInterface_t messageInterface =
+    {
+        .pMsgCtx        = NULL,
+        .send           = Agent_MessageSend,
+        .recv           = Agent_MessageReceive,
+        .getCommand     = Agent_GetCommand,
+        .releaseCommand = Agent_FreeCommand
+    };
+
+    /* Each run starts with an empty queue, whatever the previous run left. */
+    Agent_MessageContextInit( &commandQueue, commandQueueBuffer, COMMAND_QUEUE_LENGTH );
+    messageInterface.pMsgCtx = &commandQueue;
+
+    fixedBuffer.pBuffer = networkBuffer;
+    fixedBuffer.size = sizeof( networkBuffer );
+
+    /* Fill in Transport Interface send and receive function pointers. */
+    transport.pNetworkContext = &networkContext;
+    #if defined( CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_PLAINTEXT )
+        transport.send = Plaintext_Send;
+        transport.recv = Plaintext_Recv;
+        transport.writev = Plaintext_Writev;
+    #else
+        transport.send = MbedTLS_send;
+        transport.recv = MbedTLS_recv;
+        transport.writev = MbedTLS_Writev;
+    #endif
+
+    #if ( AGENT_COALESCE_PUBLISHES == 1 )
+        /* Send consecutive QoS 0 publishes together. */
+        Agent_EnableCoalescing( &commandQueue, &transport, coalesceBuffer, sizeof( coalesceBuffer ) );
+    #endif
+
+    #if ( AGENT_LATENCY_TRACING == 1 )
+        /* Time the network send of each command. */
+        Agent_EnableLatencyTracing( &commandQueue, &transport );
+    #endif
+
+    return MQTTAgent_Init( &agentContext,
+                           &messageInterface,
+                           &fixedBuffer,
+                           &transport,
+                           getTimeMs,
+                           incomingPublishCallback,
+                           NULL );
+}
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t mqttConnect( void )
+{
+    MQTTConnectInfo_t connectInfo = { 0 };
+    bool sessionPresent = false;
+
+    /* A clean session keeps the runs independent. */
+    connectInfo.cleanSession = true;
+    connectInfo.pClientIdentifier = CLIENT_IDENTIFIER;
+    connectInfo.clientIdentifierLength = ( uint16_t ) strlen( CLIENT_IDENTIFIER );
+    connectInfo.keepAliveSeconds = KEEP_ALIVE_INTERVAL_SECONDS;
+
+    return MQTT_Connect( &( agentContext.mqttContext ),
+                         &connectInfo,
+                         NULL,
+                         CONNACK_RECV_TIMEOUT_MS,
+                         &sessionPresent );
+}
+/*-----------------------------------------------------------*/
+
+static bool subscribeToTopic( MQTTQoS_t qos )
+{
+    bool subscribed = false;
+    MQTTSubscribeInfo_t subscribeInfo = { 0 };
+    MQTTAgentSubscribeArgs_t subscribeArgs = { 0 };
+    MQTTAgentCommandInfo_t commandInfo = { 0 };
+
+    /* Static, as the agent may still complete a subscribe that timed out. */
+    static MQTTAgentCommandContext_t subscribeContext;
+
+    subscribeContext.returnStatus = MQTTSendFailed;
+
+    subscribeInfo.pTopicFilter = BENCHMARK_TOPIC;
+    subscribeInfo.topicFilterLength = BENCHMARK_TOPIC_LENGTH;
+    subscribeInfo.qos = qos;
+    subscribeArgs.pSubscribeInfo = &subscribeInfo;
+    subscribeArgs.numSubscriptions = 1U;
+
+    commandInfo.blockTimeMs = COMMAND_TIMEOUT_MS;
+    commandInfo.cmdCompleteCallback = subscribeCompleteCallback;
+    commandInfo.pCmdCompleteCallbackContext = &subscribeContext;
+
+    k_sem_init( &subscribeSem, 0, 1 );
+
+    if( ( MQTTAgent_Subscribe( &agentContext, &subscribeArgs, &commandInfo ) == MQTTSuccess ) &&
+        ( k_sem_take( &subscribeSem, K_MSEC( COMMAND_TIMEOUT_MS ) ) == 0 ) )
+    {
+        subscribed = ( subscribeContext.returnStatus == MQTTSuccess );
+    }
+
+    if( subscribed == false )
+    {
+        LogError( ( "Failed to subscribe to %s.", BENCHMARK_TOPIC ) );
+    }
+
+    return subscribed;
+}
+/*-----------------------------------------------------------*/
+
+static void agentTask( void * a,
+                       void * b,
+                       void * c )
+{
+    ( void ) a;
+    ( void ) b;
+    ( void ) c;
+
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER )
+        if( AgentRunner_AddConnection( &agentContext, agentLoopExit ) )
+        {
+            AgentRunner_Run();
+        }
+    #else
+        MQTTStatus_t mqttStatus = MQTTAgent_CommandLoop( &agentContext );
+
+        if( ( mqttStatus != MQTTSuccess ) ||
+            ( agentContext.mqttContext.connectStatus != MQTTNotConnected ) )
+        {
+            LogError( ( "MQTT agent command loop ended: Status=%s.", MQTT_Status_strerror( mqttStatus ) ) );
+        }
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+#if defined( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER )
+
+    static bool agentLoopExit( MQTTAgentContext_t * pAgentContext,
+                               MQTTStatus_t loopStatus )
+    {
+        if( ( loopStatus != MQTTSuccess ) ||
+            ( pAgentContext->mqttContext.connectStatus != MQTTNotConnected ) )
+        {
+            LogError( ( "MQTT agent connection ended: Status=%s.", MQTT_Status_strerror( loopStatus ) ) );
+        }
+
+        return false;
+    }
+#endif
+/*-----------------------------------------------------------*/
+
+static void producerTask( void * pProducer,
+                          void * pRun,
+                          void * c )
+{
+    uint32_t producer = ( uint32_t ) ( uintptr_t ) pProducer;
+    const BenchmarkRun_t * pBenchmarkRun = ( const BenchmarkRun_t * ) pRun;
+    MQTTAgentCommandContext_t * pContext = NULL;
+    MQTTAgentCommandInfo_t commandInfo = { 0 };
+    BenchmarkHeader_t header;
+    uint32_t message = 0U, slot = 0U, inFlight = 0U;
+    bool timedOut = false;
+
+    ( void ) c;
+
+    commandInfo.blockTimeMs = COMMAND_TIMEOUT_MS;
+    commandInfo.cmdCompleteCallback = publishCompleteCallback;
+
+    for( message = 0U; ( message < BENCHMARK_MESSAGES_PER_PRODUCER ) && ( timedOut == false ); message++ )
+    {
+        if( k_sem_take( &( windowSems[ producer ] ), K_MSEC( COMMAND_TIMEOUT_MS ) ) != 0 )
+        {
+            LogError( ( "Producer %u: no publish completed in %u ms.",
+                        ( unsigned int ) producer,
+                        ( unsigned int ) COMMAND_TIMEOUT_MS ) );
+            timedOut = true;
+        }
+        else
+        {
+            /* The semaphore guarantees a free context. */
+            for( slot = 0U; ( slot < ( BENCHMARK_PUBLISH_WINDOW - 1U ) ) &&
+                 ( atomic_cas( &( publishContexts[ producer ][ slot ].busy ), 0, 1 ) == false ); slot++ )
+            {
+            }
+
+            pContext = &( publishContexts[ producer ][ slot ] );
+            pContext->producer = producer;
+            pContext->startCycles = k_cycle_get_32();
+
+            header.publishCycles = pContext->startCycles;
+            header.runId = currentRunId;
+            ( void ) memcpy( payloads[ producer ][ slot ], &header, sizeof( header ) );
+
+            pContext->publishInfo.qos = pBenchmarkRun->qos;
+            pContext->publishInfo.pTopicName = BENCHMARK_TOPIC;
+            pContext->publishInfo.topicNameLength = BENCHMARK_TOPIC_LENGTH;
+            pContext->publishInfo.pPayload = payloads[ producer ][ slot ];
+            pContext->publishInfo.payloadLength = pBenchmarkRun->payloadSize;
+
+            commandInfo.pCmdCompleteCallbackContext = pContext;
+
+            if( MQTTAgent_Publish( &agentContext, &( pContext->publishInfo ), &commandInfo ) != MQTTSuccess )
+            {
+                ( void ) atomic_inc( &( stats.failed ) );
+                ( void ) atomic_clear( &( pContext->busy ) );
+                k_sem_give( &( windowSems[ producer ] ) );
+            }
+        }
+    }
+
+    /* Wait for the publishes still in flight, so that their contexts can be
+     * reused by the next run. */
+    for( inFlight = 0U; ( inFlight < BENCHMARK_PUBLISH_WINDOW ) && ( timedOut == false ); inFlight++ )
+    {
+        timedOut = ( k_sem_take( &( windowSems[ producer ] ), K_MSEC( COMMAND_TIMEOUT_MS ) ) != 0 );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void publishCompleteCallback( MQTTAgentCommandContext_t * pCommandContext,
+                                     MQTTAgentReturnInfo_t * pReturnInfo )
+{
+    uint32_t elapsedUs = k_cyc_to_us_floor32( k_cycle_get_32() - pCommandContext->startCycles );
+
+    /* Only the agent thread updates the histograms. */
+    if( pReturnInfo->returnCode == MQTTSuccess )
+    {
+        AgentLatency_AddSample( &( stats.publishLatency ), elapsedUs );
+        ( void ) atomic_inc( &( stats.completed ) );
+    }
+    else
+    {
+        ( void ) atomic_inc( &( stats.failed ) );
+    }
+
+    ( void ) atomic_clear( &( pCommandContext->busy ) );
+    k_sem_give( &( windowSems[ pCommandContext->producer ] ) );
+}
+/*-----------------------------------------------------------*/
+
+static void subscribeCompleteCallback( MQTTAgentCommandContext_t * pCommandContext,
+                                       MQTTAgentReturnInfo_t * pReturnInfo )
+{
+    pCommandContext->returnStatus = pReturnInfo->returnCode;
+    k_sem_give( &subscribeSem );
+}
+/*-----------------------------------------------------------*/
+
+static void incomingPublishCallback( MQTTAgentContext_t * pMqttAgentContext,
+                                     uint16_t packetId,
+                                     MQTTPublishInfo_t * pPublishInfo )
+{
+    BenchmarkHeader_t header;
+
+    ( void ) pMqttAgentContext;
+    ( void ) packetId;
+
+    if( pPublishInfo->payloadLength >= sizeof( header ) )
+    {
+        ( void ) memcpy( &header, pPublishInfo->pPayload, sizeof( header ) );
+
+        if( header.runId == currentRunId )
+        {
+            AgentLatency_AddSample( &( stats.roundTrip ),
+                                    k_cyc_to_us_floor32( k_cycle_get_32() - header.publishCycles ) );
+            ( void ) atomic_inc( &( stats.received ) );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void printResults( const BenchmarkRun_t * pRun,
+                          uint32_t connectMs,
+                          uint32_t elapsedMs,
+                          uint64_t cpuCycles )
+{
+    AgentPoolStats_t poolStats;
+    uint32_t completed = ( uint32_t ) atomic_get( &( stats.completed ) );
+    uint64_t elapsedCycles = 0U;
+    int32_t cpuPermille = -1, tlsHeapPeak = -1, producerStackPeak = -1;
+    uint32_t i;
+
+    Agent_GetPoolStats( &poolStats );
+
+    #if defined( CONFIG_THREAD_RUNTIME_STATS )
+        elapsedCycles = ( ( uint64_t ) MAX( elapsedMs, 1U ) * ( uint64_t ) sys_clock_hw_cycles_per_sec() ) / 1000U;
+        cpuPermille = ( int32_t ) ( ( cpuCycles * 1000U ) / elapsedCycles );
+    #else
+        ( void ) cpuCycles;
+        ( void ) elapsedCycles;
+    #endif
+
+    #if !defined( CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_PLAINTEXT ) && ( MBEDTLS_ZEPHYR_ARENA_SIZE > 0U )
+        {
+            MbedTLSArenaUsage_t memoryUsage;
+
+            MbedTLSArena_GetUsage( &( transportParams.memoryUsage ), &memoryUsage );
+            tlsHeapPeak = ( int32_t ) memoryUsage.peakBytes;
+        }
+    #endif
+
+    for( i = 0U; i < pRun->producers; i++ )
+    {
+        producerStackPeak = MAX( producerStackPeak,
+                                 threadStackPeak( &( producerThreads[ i ] ), K_THREAD_STACK_SIZEOF( producerStackArea[ i ] ) ) );
+    }
+
+    ( void ) snprintf( resultLine, sizeof( resultLine ),
+                       "{\"transport\":\"%s\",\"payload\":%u,\"qos\":%d,\"producers\":%u,"
+                       "\"messages\":%u,\"completed\":%u,\"failed\":%u,\"received\":%u,"
+                       "\"connect_ms\":%u,\"elapsed_ms\":%u,\"msgs_per_s\":%u,"
+                       "\"publish_us\":{\"p50\":%u,\"p90\":%u,\"p99\":%u,\"max\":%u},"
+                       "\"rtt_us\":{\"p50\":%u,\"p90\":%u,\"p99\":%u,\"max\":%u},"
+                       "\"cpu_permille\":%d,\"agent_stack_peak\":%d,\"producer_stack_peak\":%d,"
+                       "\"command_pool_peak\":%u,\"tls_heap_peak\":%d}",
+                       BENCHMARK_TRANSPORT_NAME,
+                       ( unsigned int ) pRun->payloadSize,
+                       ( int ) pRun->qos,
+                       ( unsigned int ) pRun->producers,
+                       ( unsigned int ) ( pRun->producers * BENCHMARK_MESSAGES_PER_PRODUCER ),
+                       ( unsigned int ) completed,
+                       ( unsigned int ) atomic_get( &( stats.failed ) ),
+                       ( unsigned int ) atomic_get( &( stats.received ) ),
+                       ( unsigned int ) connectMs,
+                       ( unsigned int ) elapsedMs,
+                       ( unsigned int ) ( ( ( uint64_t ) completed * 1000U ) / MAX( elapsedMs, 1U ) ),
+                       ( unsigned int ) AgentLatency_PercentileUs( &( stats.publishLatency ), 50U ),
+                       ( unsigned int ) AgentLatency_PercentileUs( &( stats.publishLatency ), 90U ),
+                       ( unsigned int ) AgentLatency_PercentileUs( &( stats.publishLatency ), 99U ),
+                       ( unsigned int ) stats.publishLatency.maxUs,
+                       ( unsigned int ) AgentLatency_PercentileUs( &( stats.roundTrip ), 50U ),
+                       ( unsigned int ) AgentLatency_PercentileUs( &( stats.roundTrip ), 90U ),
+                       ( unsigned int ) AgentLatency_PercentileUs( &( stats.roundTrip ), 99U ),
+                       ( unsigned int ) stats.roundTrip.maxUs,
+                       ( int ) cpuPermille,
+                       ( int ) threadStackPeak( &agentThread, K_THREAD_STACK_SIZEOF( agentStackArea ) ),
+                       ( int ) producerStackPeak,
+                       ( unsigned int ) poolStats.peakInUse,
+                       ( int ) tlsHeapPeak );
+
+    /* printk writes the line at once, without the truncation of the logs. */
+    printk( "BENCHMARK %s\n", resultLine );
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t threadCycles( struct k_thread * pThread )
+{
+    uint64_t cycles = 0U;
+
+    #if defined( CONFIG_THREAD_RUNTIME_STATS )
+        k_thread_runtime_stats_t threadStats;
+
+        if( k_thread_runtime_stats_get( pThread, &threadStats ) == 0 )
+        {
+            cycles = threadStats.execution_cycles;
+        }
+    #else
+        ( void ) pThread;
+    #endif
+
+    return cycles;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t threadStackPeak( const struct k_thread * pThread,
+                                size_t stackSize )
+{
+    int32_t peak = -1;
+
+    #if defined( CONFIG_INIT_STACKS ) && defined( CONFIG_THREAD_STACK_INFO )
+        size_t unused = 0U;
+
+        if( k_thread_stack_space_get( pThread, &unused ) == 0 )
+        {
+            peak = ( int32_t ) ( stackSize - unused );
+        }
+    #else
+        ( void ) pThread;
+        ( void ) stackSize;
+    #endif
+
+    return peak;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t getTimeMs( void )
+{
+    return k_uptime_get_32() - globalEntryTimeMs;
+}
+/*-----------------------------------------------------------*/
+
+void main()
+{
+    uint32_t failures = 0U;
+    uint32_t repeat = 0U;
+    bool networkUp = true;
+
+    globalEntryTimeMs = k_uptime_get_32();
+
+    #if !defined( CONFIG_AWS_IOT_BENCHMARK_TRANSPORT_PLAINTEXT )
+        /* Seed the random number generator shared by the TLS connections once,
+         * so that it is not part of the first run. */
+        if( MbedTLS_Init() != TLS_TRANSPORT_SUCCESS )
+        {
+            LogWarn( ( "Failed to seed the TLS random number generator." ) );
+        }
+    #endif
+
+    #if defined( CONFIG_WIFI_ESP32 )
+        LogInfo( ( "Connecting to WiFi network: SSID=%.*s ...", ( int ) strlen( WIFI_NETWORK_SSID ), WIFI_NETWORK_SSID ) );
+
+        networkUp = Wifi_Connect( WIFI_NETWORK_SSID, strlen( WIFI_NETWORK_SSID ), WIFI_NETWORK_PASSWORD, strlen( WIFI_NETWORK_PASSWORD ) );
+    #endif
+
+    if( networkUp == true )
+    {
+        Agent_InitializePool();
+
+        #if defined( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER )
+            AgentRunner_Init();
+        #endif
+
+        for( repeat = 0U; repeat < BENCHMARK_REPEAT_COUNT; repeat++ )
+        {
+            failures += runSweep();
+        }
+    }
+    else
+    {
+        LogError( ( "Unable to attempt wifi connection. Benchmark terminating." ) );
+        failures++;
+    }
+
+    printk( "BENCHMARK_DONE {\"transport\":\"%s\",\"failed_runs\":%u}\n",
+            BENCHMARK_TRANSPORT_NAME,
+            ( unsigned int ) failures );
+
+    #if defined( CONFIG_BOARD_NATIVE_POSIX )
+        posix_exit( ( failures == 0U ) ? 0 : 1 );
+    #endif
+}
@@ -7,7 +7,15 @@
 
 # HTTP common source files.
 set( HTTP_DEMO_COMMON_SOURCES
-     "${CMAKE_CURRENT_LIST_DIR}/src/http_demo_utils.c" )
+     "${CMAKE_CURRENT_LIST_DIR}/src/http_demo_utils.c"
+     "${CMAKE_CURRENT_LIST_DIR}/src/http_connection_pool.c"
+     "${CMAKE_CURRENT_LIST_DIR}/src/http_pipeline.c" )
+
+# The ranged download to flash needs the flash map.
+if( CONFIG_AWS_IOT_HTTP_FLASH_DOWNLOAD )
+    list( APPEND HTTP_DEMO_COMMON_SOURCES
+          "${CMAKE_CURRENT_LIST_DIR}/src/http_flash_download.c" )
+endif()
 
 # HTTP common include directories.
 set( HTTP_DEMO_COMMON_INCLUDE_DIRS
@@ -0,0 +1,246 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HTTP_CONNECTION_POOL_H_
+#define HTTP_CONNECTION_POOL_H_
+
+/**
+ * @file http_connection_pool.h
+ * @brief Pool of kept-alive HTTP connections, reused across requests.
+ *
+ * Each connection of the pool stays open after its response, so the next
+ * request to the same host and port skips the TCP and TLS handshakes. A
+ * connection idle for longer than the idle time of the pool is closed before
+ * it is reused, as the server has probably closed it already. A connection
+ * the server closes anyway is detected when a request on it gets no response,
+ * and the request is sent again on a new connection.
+ *
+ * The application owns the network context of each connection and provides
+ * the functions connecting and disconnecting it, so the pool works with the
+ * plaintext and the TLS transports.
+ *
+ * @note A pool is not thread safe; it is meant to be used from one thread.
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Transport interface include. */
+#include "transport_interface.h"
+
+/* HTTP API header. */
+#include "core_http_client.h"
+
+/**
+ * @brief Default longest time in milliseconds a connection stays open
+ * without requests. Keep it below the keep-alive timeout of the servers.
+ */
+#ifndef HTTP_POOL_DEFAULT_MAX_IDLE_MS
+    #define HTTP_POOL_DEFAULT_MAX_IDLE_MS    ( 30000U )
+#endif
+
+/**
+ * @brief Return codes of the connection pool functions.
+ */
+typedef enum HttpPoolStatus
+{
+    HTTP_POOL_SUCCESS = 0,        /**< Function successfully completed. */
+    HTTP_POOL_INVALID_PARAMETER,  /**< At least one parameter was invalid. */
+    HTTP_POOL_NO_CONNECTION,      /**< Every connection of the pool is in use. */
+    HTTP_POOL_CONNECT_FAILURE     /**< The connection to the server failed. */
+} HttpPoolStatus_t;
+
+/**
+ * @brief Function connecting the network context of a connection.
+ *
+ * @param[in] pNetworkContext The network context of the connection.
+ * @param[in] pHost Host name of the server.
+ * @param[in] hostLength Length of @p pHost.
+ * @param[in] port Port of the server.
+ *
+ * @return EXIT_SUCCESS on success; EXIT_FAILURE otherwise.
+ */
+typedef int32_t ( * HttpPoolConnect_t )( NetworkContext_t * pNetworkContext,
+                                         const char * pHost,
+                                         size_t hostLength,
+                                         uint16_t port );
+
+/**
+ * @brief Function disconnecting the network context of a connection.
+ *
+ * @param[in] pNetworkContext The network context of the connection.
+ */
+typedef void ( * HttpPoolDisconnect_t )( NetworkContext_t * pNetworkContext );
+
+/**
+ * @brief A connection of a pool.
+ *
+ * Only #HttpPoolConnection_t.transport needs to be set by the application,
+ * with the send and receive functions and the network context of the
+ * connection; the pool manages the other members.
+ */
+typedef struct HttpPoolConnection
+{
+    TransportInterface_t transport; /**< @brief Transport of the connection. */
+    const char * pHost;             /**< @brief Host the connection is open to. */
+    size_t hostLength;              /**< @brief Length of #HttpPoolConnection_t.pHost. */
+    uint16_t port;                  /**< @brief Port the connection is open to. */
+    uint32_t lastUsedMs;            /**< @brief Time the connection was last released. */
+    uint32_t requestCount;          /**< @brief Requests sent since the connection was opened. */
+    bool connected;                 /**< @brief The connection is open. */
+    bool inUse;                     /**< @brief The connection is acquired. */
+} HttpPoolConnection_t;
+
+/**
+ * @brief A pool of connections.
+ */
+typedef struct HttpPool
+{
+    HttpPoolConnection_t * pConnections; /**< @brief The connections. */
+    size_t connectionCount;              /**< @brief Number of connections. */
+    HttpPoolConnect_t connect;           /**< @brief Function connecting a connection. */
+    HttpPoolDisconnect_t disconnect;     /**< @brief Function disconnecting a connection. */
+    uint32_t maxIdleMs;                  /**< @brief Longest time a connection stays open without requests. */
+
+    /**
+     * @brief Whether #HttpPool_Send sends requests of any method again after
+     * #HTTPNoResponse or #HTTPNetworkError on a reused connection, and not
+     * only GET and HEAD.
+     * False after #HttpPool_Init; set it only if the server tolerates
+     * duplicates of those requests.
+     */
+    bool resendAnyMethod;
+} HttpPool_t;
+
+/**
+ * @brief Initialize a pool. All of its connections are closed.
+ *
+ * @param[out] pPool The pool.
+ * @param[in] pConnections The connections, whose transports are set.
+ * @param[in] connectionCount Number of entries of @p pConnections.
+ * @param[in] connect Function connecting a connection.
+ * @param[in] disconnect Function disconnecting a connection.
+ * @param[in] maxIdleMs Longest time a connection stays open without
+ * requests, in milliseconds.
+ *
+ * @return #HTTP_POOL_SUCCESS or #HTTP_POOL_INVALID_PARAMETER.
+ */
+HttpPoolStatus_t HttpPool_Init( HttpPool_t * pPool,
+                                HttpPoolConnection_t * pConnections,
+                                size_t connectionCount,
+                                HttpPoolConnect_t connect,
+                                HttpPoolDisconnect_t disconnect,
+                                uint32_t maxIdleMs );
+
+/**
+ * @brief Acquire a connection to a server, reusing an open connection to it
+ * when there is one.
+ *
+ * Otherwise a closed connection is opened, or else the connection idle for
+ * the longest time is closed and opened to the server.
+ *
+ * @param[in] pPool The pool.
+ * @param[in] pHost Host name of the server, which must stay valid while the
+ * connection is open.
+ * @param[in] hostLength Length of @p pHost.
+ * @param[in] port Port of the server.
+ * @param[out] ppConnection The connection.
+ * @param[out] pReused Whether the connection was already open. May be NULL.
+ *
+ * @return #HTTP_POOL_SUCCESS, #HTTP_POOL_INVALID_PARAMETER,
+ * #HTTP_POOL_NO_CONNECTION, or #HTTP_POOL_CONNECT_FAILURE.
+ */
+HttpPoolStatus_t HttpPool_Acquire( HttpPool_t * pPool,
+                                   const char * pHost,
+                                   size_t hostLength,
+                                   uint16_t port,
+                                   HttpPoolConnection_t ** ppConnection,
+                                   bool * pReused );
+
+/**
+ * @brief Release an acquired connection.
+ *
+ * @param[in] pPool The pool.
+ * @param[in] pConnection The connection.
+ * @param[in] keepAlive Whether the connection can be reused. Otherwise, e.g.
+ * after an error or a "Connection: close" response, it is closed.
+ */
+void HttpPool_Release( HttpPool_t * pPool,
+                       HttpPoolConnection_t * pConnection,
+                       bool keepAlive );
+
+/**
+ * @brief Send a request with #HTTPClient_Send on a connection of the pool.
+ *
+ * The request is sent again on a new connection if it got no response on a
+ * reused connection, which the server had closed. As the server may have
+ * handled the request already, after #HTTPNoResponse as after
+ * #HTTPNetworkError, only GET and HEAD requests are sent again, unless
+ * #HttpPool_t.resendAnyMethod is set. After #HTTPNetworkError, the request
+ * headers and the response must also use separate buffers. The connection
+ * stays open unless the server asked to close it.
+ *
+ * @param[in] pPool The pool.
+ * @param[in] pHost Host name of the server, which must stay valid while the
+ * connection is open.
+ * @param[in] hostLength Length of @p pHost.
+ * @param[in] port Port of the server.
+ * @param[in] pRequestHeaders The request headers, as for #HTTPClient_Send.
+ * @param[in] pRequestBodyBuf The request body, as for #HTTPClient_Send.
+ * @param[in] reqBodyBufLen Length of @p pRequestBodyBuf.
+ * @param[in,out] pResponse The response, as for #HTTPClient_Send.
+ * @param[in] sendFlags Flags of #HTTPClient_Send.
+ *
+ * @return The status of #HTTPClient_Send, or #HTTPNetworkError if no
+ * connection to the server could be acquired.
+ */
+HTTPStatus_t HttpPool_Send( HttpPool_t * pPool,
+                            const char * pHost,
+                            size_t hostLength,
+                            uint16_t port,
+                            HTTPRequestHeaders_t * pRequestHeaders,
+                            const uint8_t * pRequestBodyBuf,
+                            size_t reqBodyBufLen,
+                            HTTPResponse_t * pResponse,
+                            uint32_t sendFlags );
+
+/**
+ * @brief Close the connections idle for longer than the idle time of the
+ * pool. Call it periodically to release the sockets and TLS sessions of
+ * unused connections.
+ *
+ * @param[in] pPool The pool.
+ *
+ * @return Number of connections closed.
+ */
+size_t HttpPool_CloseIdle( HttpPool_t * pPool );
+
+/**
+ * @brief Close all the connections of the pool that are not in use.
+ *
+ * @param[in] pPool The pool.
+ */
+void HttpPool_CloseAll( HttpPool_t * pPool );
+
+#endif /* ifndef HTTP_CONNECTION_POOL_H_ */
@@ -42,9 +42,9 @@ typedef int32_t ( * TransportConnect_t )( NetworkContext_t * pNetworkContext );
 /**
  * @brief Connect to a server with reconnection retries.
  *
- * If connection fails, retry is attempted after a timeout.
- * Timeout value will exponentially increase until maximum
- * timeout value is reached or the number of attempts are exhausted.
+ * If connection fails, retry is attempted after a delay of the reconnect
+ * scheduler, drawn with decorrelated jitter, until the number of attempts
+ * are exhausted.
  *
  * @param[in] connectFunction Function pointer for establishing connection to a server.
  * @param[out] pNetworkContext Implementation-defined network context.
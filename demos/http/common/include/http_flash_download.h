@@ -0,0 +1,217 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HTTP_FLASH_DOWNLOAD_H_
+#define HTTP_FLASH_DOWNLOAD_H_
+
+/**
+ * @file http_flash_download.h
+ * @brief Download of an HTTP object straight into a flash area, in ranges.
+ *
+ * The object is requested in chunks with "Range" headers, on a kept-alive
+ * connection of a #HttpPool_t. Each chunk is received into one of two
+ * buffers and written to the flash area by a work queue while the next chunk
+ * is received into the other buffer, so the network and the flash work in
+ * parallel. The RAM used is the two buffers, whatever the size of the object.
+ *
+ * After a network failure the download resumes from the end of the data
+ * written to flash. A download interrupted by a reset resumes from an offset
+ * the application saved with #HttpDownload_GetWrittenOffset.
+ */
+
+/* Zephyr includes. */
+#include <zephyr.h>
+
+/* Zephyr flash map include. */
+#include <storage/flash_map.h>
+
+/* Connection pool header. */
+#include "http_connection_pool.h"
+
+/**
+ * @brief Room in bytes of each buffer for the headers of a response. The
+ * rest of the buffer holds the body, which is the chunk of the object.
+ */
+#ifndef HTTP_DOWNLOAD_RESPONSE_HEADERS_MAX
+    #define HTTP_DOWNLOAD_RESPONSE_HEADERS_MAX    ( 512U )
+#endif
+
+/**
+ * @brief Length in bytes of the buffer of the request headers.
+ */
+#ifndef HTTP_DOWNLOAD_REQUEST_HEADERS_MAX
+    #define HTTP_DOWNLOAD_REQUEST_HEADERS_MAX    ( 256U )
+#endif
+
+/**
+ * @brief Size in bytes of the erase blocks of the flash area. The flash area
+ * is erased one block ahead of the writes.
+ */
+#ifndef HTTP_DOWNLOAD_ERASE_BLOCK_SIZE
+    #define HTTP_DOWNLOAD_ERASE_BLOCK_SIZE    ( 4096U )
+#endif
+
+/**
+ * @brief Number of consecutive failed requests after which the download
+ * stops.
+ */
+#ifndef HTTP_DOWNLOAD_MAX_RETRIES
+    #define HTTP_DOWNLOAD_MAX_RETRIES    ( 5U )
+#endif
+
+/**
+ * @brief Delay in milliseconds before sending again a failed request,
+ * doubled on each consecutive failure.
+ */
+#ifndef HTTP_DOWNLOAD_RETRY_BASE_MS
+    #define HTTP_DOWNLOAD_RETRY_BASE_MS    ( 500U )
+#endif
+
+/**
+ * @brief Return codes of the download functions.
+ */
+typedef enum HttpDownloadStatus
+{
+    HTTP_DOWNLOAD_SUCCESS = 0,       /**< Function successfully completed. */
+    HTTP_DOWNLOAD_INVALID_PARAMETER, /**< At least one parameter was invalid. */
+    HTTP_DOWNLOAD_NETWORK_ERROR,     /**< The requests failed too many times. */
+    HTTP_DOWNLOAD_SERVER_ERROR,      /**< The server did not answer with the requested range. */
+    HTTP_DOWNLOAD_TOO_LARGE,         /**< The object does not fit in the flash area. */
+    HTTP_DOWNLOAD_FLASH_ERROR        /**< Erasing or writing the flash area failed. */
+} HttpDownloadStatus_t;
+
+struct HttpDownload;
+
+/**
+ * @brief One of the two buffers of a download.
+ */
+typedef struct HttpDownloadBuffer
+{
+    struct k_work work;              /**< @brief Work item writing the buffer to flash. */
+    struct k_sem free;               /**< @brief Given when the buffer is not being written. */
+    struct HttpDownload * pDownload; /**< @brief Download of the buffer. */
+    uint8_t * pBuffer;               /**< @brief The buffer. */
+    uint8_t * pData;                 /**< @brief Chunk to write, in the buffer. */
+    size_t dataLength;               /**< @brief Length of the chunk to write. */
+    uint32_t offset;                 /**< @brief Offset of the chunk in the object. */
+} HttpDownloadBuffer_t;
+
+/**
+ * @brief State of a download.
+ */
+typedef struct HttpDownload
+{
+    HttpPool_t * pPool;                      /**< @brief Pool of the connection to the server. */
+    const char * pHost;                      /**< @brief Host name of the server. */
+    size_t hostLength;                       /**< @brief Length of #HttpDownload_t.pHost. */
+    uint16_t port;                           /**< @brief Port of the server. */
+    const char * pPath;                      /**< @brief Path of the object. */
+    size_t pathLength;                       /**< @brief Length of #HttpDownload_t.pPath. */
+    const struct flash_area * pFlashArea;    /**< @brief Flash area receiving the object. */
+    struct k_work_q * pWriteQueue;           /**< @brief Work queue writing to flash. */
+    HttpDownloadBuffer_t buffers[ 2 ];       /**< @brief Buffers of the chunks. */
+    size_t bufferLength;                     /**< @brief Length of each buffer. */
+    size_t chunkSize;                        /**< @brief Length of the requested ranges. */
+    uint8_t requestHeaders[ HTTP_DOWNLOAD_REQUEST_HEADERS_MAX ]; /**< @brief Buffer of the request headers. */
+    uint32_t objectSize;                     /**< @brief Size of the object, 0 until known. */
+    uint32_t requestOffset;                  /**< @brief Offset of the next range to request. */
+    uint32_t erasedOffset;                   /**< @brief End of the erased part of the flash area. */
+    volatile uint32_t writtenOffset;         /**< @brief End of the data written to flash. */
+    volatile bool flashError;                /**< @brief A flash operation failed. */
+} HttpDownload_t;
+
+/**
+ * @brief Initialize a download.
+ *
+ * @param[out] pDownload The download.
+ * @param[in] pPool Pool of the connection to the server.
+ * @param[in] pHost Host name of the server, which must stay valid during the
+ * download.
+ * @param[in] hostLength Length of @p pHost.
+ * @param[in] port Port of the server.
+ * @param[in] pPath Path of the object, which must stay valid during the
+ * download.
+ * @param[in] pathLength Length of @p pPath.
+ * @param[in] pFlashArea The open flash area receiving the object, from its
+ * start.
+ * @param[in] pWriteQueue Started work queue writing to flash. It should not
+ * run on the thread of the download, for the writes to overlap the receives.
+ * @param[in] pBuffer0 First buffer of the chunks.
+ * @param[in] pBuffer1 Second buffer of the chunks.
+ * @param[in] bufferLength Length of each buffer, which must be larger than
+ * #HTTP_DOWNLOAD_RESPONSE_HEADERS_MAX by at least the write alignment of the
+ * flash area.
+ * @param[in] resumeOffset Offset of the object already written to the flash
+ * area, or 0 to download it from the start.
+ *
+ * @return #HTTP_DOWNLOAD_SUCCESS or #HTTP_DOWNLOAD_INVALID_PARAMETER.
+ */
+HttpDownloadStatus_t HttpDownload_Init( HttpDownload_t * pDownload,
+                                        HttpPool_t * pPool,
+                                        const char * pHost,
+                                        size_t hostLength,
+                                        uint16_t port,
+                                        const char * pPath,
+                                        size_t pathLength,
+                                        const struct flash_area * pFlashArea,
+                                        struct k_work_q * pWriteQueue,
+                                        uint8_t * pBuffer0,
+                                        uint8_t * pBuffer1,
+                                        size_t bufferLength,
+                                        uint32_t resumeOffset );
+
+/**
+ * @brief Download the object into the flash area.
+ *
+ * Returns once the whole object is written to flash, or when the download
+ * fails. A download that failed with #HTTP_DOWNLOAD_NETWORK_ERROR can be run
+ * again, and resumes where it stopped.
+ *
+ * @param[in] pDownload The download.
+ *
+ * @return #HTTP_DOWNLOAD_SUCCESS, #HTTP_DOWNLOAD_INVALID_PARAMETER,
+ * #HTTP_DOWNLOAD_NETWORK_ERROR, #HTTP_DOWNLOAD_SERVER_ERROR,
+ * #HTTP_DOWNLOAD_TOO_LARGE, or #HTTP_DOWNLOAD_FLASH_ERROR.
+ */
+HttpDownloadStatus_t HttpDownload_Run( HttpDownload_t * pDownload );
+
+/**
+ * @brief Get the end of the data of the object written to flash, from which
+ * a new download of the object can resume.
+ *
+ * @param[in] pDownload The download.
+ *
+ * @return Offset in bytes of the end of the written data.
+ */
+uint32_t HttpDownload_GetWrittenOffset( const HttpDownload_t * pDownload );
+
+/**
+ * @brief Get the size of the object.
+ *
+ * @param[in] pDownload The download.
+ *
+ * @return Size of the object in bytes, or 0 before its first chunk is
+ * received.
+ */
+uint32_t HttpDownload_GetObjectSize( const HttpDownload_t * pDownload );
+
+#endif /* ifndef HTTP_FLASH_DOWNLOAD_H_ */
@@ -0,0 +1,175 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HTTP_PIPELINE_H_
+#define HTTP_PIPELINE_H_
+
+/**
+ * @file http_pipeline.h
+ * @brief Pipelining of HTTP requests on a kept-alive connection.
+ *
+ * #HTTPClient_Send waits for the response of a request before the next
+ * request is sent, so each request costs one round trip. A pipeline sends
+ * several requests before reading any response, then reads the responses in
+ * the order of the requests, so the requests share a round trip.
+ *
+ * The requests are built with #HTTPClient_InitializeRequestHeaders into a
+ * buffer of their own, and sent with #HttpPipeline_Send. The responses are
+ * read with #HttpPipeline_Receive into the buffer of the pipeline, which
+ * keeps the bytes of the following responses received with a response.
+ *
+ * A response can also be streamed with #HttpPipeline_ReceiveStreamed: only
+ * its headers are kept in the buffer, and its body is passed to a callback
+ * as it is received. The buffer then only needs to hold the headers, whatever
+ * the length of the body. A single request is streamed by sending it with
+ * #HttpPipeline_Send and receiving its response right away.
+ *
+ * @note Only pipeline requests that can be sent again, e.g. GET requests
+ * without body: a server may close the connection before answering all of
+ * them. HEAD requests are not supported, since the length of their responses
+ * cannot be known from the responses.
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Transport interface include. */
+#include "transport_interface.h"
+
+/* HTTP API header. */
+#include "core_http_client.h"
+
+/**
+ * @brief Time in milliseconds the pipeline waits for the transport to send a
+ * request or to receive data of a response.
+ */
+#ifndef HTTP_PIPELINE_TIMEOUT_MS
+    #define HTTP_PIPELINE_TIMEOUT_MS    ( 5000U )
+#endif
+
+/**
+ * @brief Callback receiving the body of a streamed response, in parts.
+ *
+ * @param[in] pContext Context given to #HttpPipeline_ReceiveStreamed.
+ * @param[in] pResponse The response, whose status code and headers are set.
+ * @param[in] pData Part of the body, valid during the call only. The parts
+ * of a chunked body have no chunk headers.
+ * @param[in] length Length of @p pData.
+ *
+ * @return true to continue receiving the body; false to stop, after which
+ * the connection must be closed.
+ */
+typedef bool ( * HttpPipelineBodyCallback_t )( void * pContext,
+                                               const HTTPResponse_t * pResponse,
+                                               const uint8_t * pData,
+                                               size_t length );
+
+/**
+ * @brief A pipeline of requests on a connection.
+ */
+typedef struct HttpPipeline
+{
+    const TransportInterface_t * pTransport;  /**< @brief Transport of the connection. */
+    HTTPClient_GetCurrentTimeFunc_t getTime;  /**< @brief Function returning the time in milliseconds. */
+    uint8_t * pBuffer;                        /**< @brief Buffer of the responses. */
+    size_t bufferLength;                      /**< @brief Length of #HttpPipeline_t.pBuffer. */
+    size_t receivedLength;                    /**< @brief Bytes received in the buffer. */
+    size_t responseLength;                    /**< @brief Bytes of the last returned response, at the start of the buffer. */
+    size_t pendingCount;                      /**< @brief Requests sent, whose responses are not received. */
+} HttpPipeline_t;
+
+/**
+ * @brief Initialize a pipeline on a connection.
+ *
+ * @param[out] pPipeline The pipeline.
+ * @param[in] pTransport Transport of the connection.
+ * @param[in] pBuffer Buffer of the responses, which must hold the largest
+ * response, or the headers of the largest streamed response.
+ * @param[in] bufferLength Length of @p pBuffer.
+ * @param[in] getTime Function returning the time in milliseconds.
+ *
+ * @return #HTTPSuccess or #HTTPInvalidParameter.
+ */
+HTTPStatus_t HttpPipeline_Init( HttpPipeline_t * pPipeline,
+                                const TransportInterface_t * pTransport,
+                                uint8_t * pBuffer,
+                                size_t bufferLength,
+                                HTTPClient_GetCurrentTimeFunc_t getTime );
+
+/**
+ * @brief Send a request without reading its response.
+ *
+ * @param[in] pPipeline The pipeline.
+ * @param[in] pRequestHeaders Headers of the request, from
+ * #HTTPClient_InitializeRequestHeaders. Their buffer can be used for the next
+ * request once the function returns.
+ *
+ * @return #HTTPSuccess, #HTTPInvalidParameter, or #HTTPNetworkError.
+ */
+HTTPStatus_t HttpPipeline_Send( HttpPipeline_t * pPipeline,
+                                const HTTPRequestHeaders_t * pRequestHeaders );
+
+/**
+ * @brief Read the response of the oldest request sent.
+ *
+ * The response is in the buffer of the pipeline, and is valid until the next
+ * call. It can be read as a response of #HTTPClient_Send, including with
+ * #HTTPClient_ReadHeader.
+ *
+ * @param[in] pPipeline The pipeline.
+ * @param[out] pResponse The response.
+ *
+ * @return #HTTPSuccess, #HTTPInvalidParameter if no request is pending,
+ * #HTTPNetworkError, #HTTPNoResponse, #HTTPPartialResponse,
+ * #HTTPInsufficientMemory if the response does not fit in the buffer, or
+ * #HTTPParserInternalError if the response is invalid. After an error, the
+ * connection must be closed.
+ */
+HTTPStatus_t HttpPipeline_Receive( HttpPipeline_t * pPipeline,
+                                   HTTPResponse_t * pResponse );
+
+/**
+ * @brief Read the response of the oldest request sent, passing its body to a
+ * callback as it is received.
+ *
+ * Only the headers of the response are kept in the buffer of the pipeline,
+ * so a body of any length is received in the memory of the buffer. The
+ * headers are valid until the next call.
+ *
+ * @param[in] pPipeline The pipeline.
+ * @param[out] pResponse The response. Its body is not kept: #HTTPResponse_t.pBody
+ * is NULL, and #HTTPResponse_t.bodyLen is the length of the body streamed.
+ * @param[in] bodyCallback Callback receiving the body.
+ * @param[in] pCallbackContext Context passed to @p bodyCallback.
+ *
+ * @return The return values of #HttpPipeline_Receive, with
+ * #HTTPInsufficientMemory if the headers do not fit in the buffer, or
+ * #HTTPInvalidResponse if the callback stopped the body.
+ */
+HTTPStatus_t HttpPipeline_ReceiveStreamed( HttpPipeline_t * pPipeline,
+                                           HTTPResponse_t * pResponse,
+                                           HttpPipelineBodyCallback_t bodyCallback,
+                                           void * pCallbackContext );
+
+#endif /* ifndef HTTP_PIPELINE_H_ */
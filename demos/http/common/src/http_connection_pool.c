@@ -0,0 +1,549 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file http_connection_pool.c
+ * @brief Pool of kept-alive HTTP connections, reused across requests.
+ */
+
+/* Standard includes. */
+#include <stdlib.h>
+#include <string.h>
+
+/* Connection pool header. */
+#include "http_connection_pool.h"
+
+/* Clock header for the time of the connections. */
+#include "clock.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Whether a connection is open to a server.
+ *
+ * @param[in] pConnection The connection.
+ * @param[in] pHost Host name of the server.
+ * @param[in] hostLength Length of @p pHost.
+ * @param[in] port Port of the server.
+ *
+ * @return true if the connection is open to the server; false otherwise.
+ */
+static bool isOpenTo( const HttpPoolConnection_t * pConnection,
+                      const char * pHost,
+                      size_t hostLength,
+                      uint16_t port );
+
+/**
+ * @brief Whether a connection was idle for longer than the idle time of the
+ * pool.
+ *
+ * @param[in] pPool The pool.
+ * @param[in] pConnection The connection.
+ * @param[in] nowMs The current time.
+ *
+ * @return true if the connection was idle for too long; false otherwise.
+ */
+static bool isExpired( const HttpPool_t * pPool,
+                       const HttpPoolConnection_t * pConnection,
+                       uint32_t nowMs );
+
+/**
+ * @brief Close a connection if it is open.
+ *
+ * @param[in] pPool The pool.
+ * @param[in] pConnection The connection.
+ */
+static void closeConnection( const HttpPool_t * pPool,
+                             HttpPoolConnection_t * pConnection );
+
+/**
+ * @brief Open a connection to a server.
+ *
+ * @param[in] pPool The pool.
+ * @param[in] pConnection The closed connection.
+ * @param[in] pHost Host name of the server.
+ * @param[in] hostLength Length of @p pHost.
+ * @param[in] port Port of the server.
+ *
+ * @return #HTTP_POOL_SUCCESS or #HTTP_POOL_CONNECT_FAILURE.
+ */
+static HttpPoolStatus_t openConnection( const HttpPool_t * pPool,
+                                        HttpPoolConnection_t * pConnection,
+                                        const char * pHost,
+                                        size_t hostLength,
+                                        uint16_t port );
+
+/**
+ * @brief Find the connection to reuse or to open for a server.
+ *
+ * An open connection to the server comes first, then a closed connection,
+ * then the open connection idle for the longest time.
+ *
+ * @param[in] pPool The pool.
+ * @param[in] pHost Host name of the server.
+ * @param[in] hostLength Length of @p pHost.
+ * @param[in] port Port of the server.
+ *
+ * @return The connection, or NULL if every connection is in use.
+ */
+static HttpPoolConnection_t * findConnection( const HttpPool_t * pPool,
+                                              const char * pHost,
+                                              size_t hostLength,
+                                              uint16_t port );
+
+/**
+ * @brief Whether the request headers and the response of a request share
+ * their buffer, in which case a response received in part overwrites the
+ * request.
+ *
+ * @param[in] pRequestHeaders The request headers.
+ * @param[in] pResponse The response.
+ *
+ * @return true if the buffers overlap; false otherwise.
+ */
+static bool buffersOverlap( const HTTPRequestHeaders_t * pRequestHeaders,
+                            const HTTPResponse_t * pResponse );
+
+/**
+ * @brief Whether the method of a request is GET or HEAD, which the server
+ * handles the same way when the request is sent twice.
+ *
+ * @param[in] pRequestHeaders The request headers, starting with the request
+ * line.
+ *
+ * @return true for GET and HEAD requests; false otherwise.
+ */
+static bool isIdempotent( const HTTPRequestHeaders_t * pRequestHeaders );
+
+/*-----------------------------------------------------------*/
+
+static bool isOpenTo( const HttpPoolConnection_t * pConnection,
+                      const char * pHost,
+                      size_t hostLength,
+                      uint16_t port )
+{
+    return ( pConnection->connected == true ) &&
+           ( pConnection->port == port ) &&
+           ( pConnection->hostLength == hostLength ) &&
+           ( memcmp( pConnection->pHost, pHost, hostLength ) == 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isExpired( const HttpPool_t * pPool,
+                       const HttpPoolConnection_t * pConnection,
+                       uint32_t nowMs )
+{
+    /* The unsigned difference stays correct when the clock wraps around. */
+    return ( nowMs - pConnection->lastUsedMs ) > pPool->maxIdleMs;
+}
+
+/*-----------------------------------------------------------*/
+
+static void closeConnection( const HttpPool_t * pPool,
+                             HttpPoolConnection_t * pConnection )
+{
+    if( pConnection->connected == true )
+    {
+        LogDebug( ( "Closing connection to %.*s:%u after %lu requests.",
+                    ( int32_t ) pConnection->hostLength,
+                    pConnection->pHost,
+                    ( unsigned int ) pConnection->port,
+                    ( unsigned long ) pConnection->requestCount ) );
+
+        pPool->disconnect( pConnection->transport.pNetworkContext );
+        pConnection->connected = false;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static HttpPoolStatus_t openConnection( const HttpPool_t * pPool,
+                                        HttpPoolConnection_t * pConnection,
+                                        const char * pHost,
+                                        size_t hostLength,
+                                        uint16_t port )
+{
+    HttpPoolStatus_t status = HTTP_POOL_SUCCESS;
+
+    if( pPool->connect( pConnection->transport.pNetworkContext,
+                        pHost,
+                        hostLength,
+                        port ) == EXIT_SUCCESS )
+    {
+        pConnection->pHost = pHost;
+        pConnection->hostLength = hostLength;
+        pConnection->port = port;
+        pConnection->requestCount = 0U;
+        pConnection->connected = true;
+    }
+    else
+    {
+        LogError( ( "Failed to connect to %.*s:%u.",
+                    ( int32_t ) hostLength,
+                    pHost,
+                    ( unsigned int ) port ) );
+        status = HTTP_POOL_CONNECT_FAILURE;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static HttpPoolConnection_t * findConnection( const HttpPool_t * pPool,
+                                              const char * pHost,
+                                              size_t hostLength,
+                                              uint16_t port )
+{
+    HttpPoolConnection_t * pMatch = NULL;
+    HttpPoolConnection_t * pClosed = NULL;
+    HttpPoolConnection_t * pOldest = NULL;
+    HttpPoolConnection_t * pConnection = NULL;
+    size_t i = 0U;
+
+    for( i = 0U; ( i < pPool->connectionCount ) && ( pMatch == NULL ); i++ )
+    {
+        pConnection = &pPool->pConnections[ i ];
+
+        if( pConnection->inUse == true )
+        {
+            /* Skip the connections acquired by another request. */
+        }
+        else if( isOpenTo( pConnection, pHost, hostLength, port ) == true )
+        {
+            pMatch = pConnection;
+        }
+        else if( pConnection->connected == false )
+        {
+            if( pClosed == NULL )
+            {
+                pClosed = pConnection;
+            }
+        }
+        else if( ( pOldest == NULL ) ||
+                 ( ( int32_t ) ( pConnection->lastUsedMs - pOldest->lastUsedMs ) < 0 ) )
+        {
+            pOldest = pConnection;
+        }
+        else
+        {
+            /* A connection used more recently than the oldest one. */
+        }
+    }
+
+    if( pMatch == NULL )
+    {
+        pMatch = ( pClosed != NULL ) ? pClosed : pOldest;
+    }
+
+    return pMatch;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool buffersOverlap( const HTTPRequestHeaders_t * pRequestHeaders,
+                            const HTTPResponse_t * pResponse )
+{
+    const uint8_t * pHeadersStart = pRequestHeaders->pBuffer;
+    const uint8_t * pHeadersEnd = pHeadersStart + pRequestHeaders->bufferLen;
+    const uint8_t * pResponseStart = pResponse->pBuffer;
+    const uint8_t * pResponseEnd = pResponseStart + pResponse->bufferLen;
+
+    return ( pHeadersStart < pResponseEnd ) && ( pResponseStart < pHeadersEnd );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isIdempotent( const HTTPRequestHeaders_t * pRequestHeaders )
+{
+    const char * pRequestLine = ( const char * ) pRequestHeaders->pBuffer;
+    size_t length = pRequestHeaders->headersLen;
+
+    /* The method is followed by a space in the request line. */
+    return ( ( length >= sizeof( "GET " ) - 1U ) &&
+             ( memcmp( pRequestLine, "GET ", sizeof( "GET " ) - 1U ) == 0 ) ) ||
+           ( ( length >= sizeof( "HEAD " ) - 1U ) &&
+             ( memcmp( pRequestLine, "HEAD ", sizeof( "HEAD " ) - 1U ) == 0 ) );
+}
+
+/*-----------------------------------------------------------*/
+
+HttpPoolStatus_t HttpPool_Init( HttpPool_t * pPool,
+                                HttpPoolConnection_t * pConnections,
+                                size_t connectionCount,
+                                HttpPoolConnect_t connect,
+                                HttpPoolDisconnect_t disconnect,
+                                uint32_t maxIdleMs )
+{
+    HttpPoolStatus_t status = HTTP_POOL_SUCCESS;
+    size_t i = 0U;
+
+    if( ( pPool == NULL ) || ( pConnections == NULL ) ||
+        ( connectionCount == 0U ) || ( connect == NULL ) ||
+        ( disconnect == NULL ) )
+    {
+        LogError( ( "Invalid parameter to initialize the connection pool." ) );
+        status = HTTP_POOL_INVALID_PARAMETER;
+    }
+    else
+    {
+        pPool->pConnections = pConnections;
+        pPool->connectionCount = connectionCount;
+        pPool->connect = connect;
+        pPool->disconnect = disconnect;
+        pPool->maxIdleMs = maxIdleMs;
+        pPool->resendAnyMethod = false;
+
+        for( i = 0U; i < connectionCount; i++ )
+        {
+            pConnections[ i ].pHost = NULL;
+            pConnections[ i ].hostLength = 0U;
+            pConnections[ i ].port = 0U;
+            pConnections[ i ].lastUsedMs = 0U;
+            pConnections[ i ].requestCount = 0U;
+            pConnections[ i ].connected = false;
+            pConnections[ i ].inUse = false;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+HttpPoolStatus_t HttpPool_Acquire( HttpPool_t * pPool,
+                                   const char * pHost,
+                                   size_t hostLength,
+                                   uint16_t port,
+                                   HttpPoolConnection_t ** ppConnection,
+                                   bool * pReused )
+{
+    HttpPoolStatus_t status = HTTP_POOL_SUCCESS;
+    HttpPoolConnection_t * pConnection = NULL;
+    bool reused = false;
+
+    if( ( pPool == NULL ) || ( pHost == NULL ) || ( hostLength == 0U ) ||
+        ( ppConnection == NULL ) )
+    {
+        LogError( ( "Invalid parameter to acquire a connection." ) );
+        status = HTTP_POOL_INVALID_PARAMETER;
+    }
+    else
+    {
+        pConnection = findConnection( pPool, pHost, hostLength, port );
+
+        if( pConnection == NULL )
+        {
+            LogError( ( "Every connection of the pool is in use." ) );
+            status = HTTP_POOL_NO_CONNECTION;
+        }
+    }
+
+    if( status == HTTP_POOL_SUCCESS )
+    {
+        if( isOpenTo( pConnection, pHost, hostLength, port ) == true )
+        {
+            if( isExpired( pPool, pConnection, Clock_GetTimeMs() ) == true )
+            {
+                /* The server has likely closed it already. */
+                closeConnection( pPool, pConnection );
+            }
+            else
+            {
+                reused = true;
+            }
+        }
+        else
+        {
+            /* A connection to another server, idle for the longest time. */
+            closeConnection( pPool, pConnection );
+        }
+
+        if( reused == false )
+        {
+            status = openConnection( pPool, pConnection, pHost, hostLength, port );
+        }
+    }
+
+    if( status == HTTP_POOL_SUCCESS )
+    {
+        LogDebug( ( "%s connection to %.*s:%u.",
+                    ( reused == true ) ? "Reusing" : "Opened",
+                    ( int32_t ) hostLength,
+                    pHost,
+                    ( unsigned int ) port ) );
+
+        pConnection->inUse = true;
+        *ppConnection = pConnection;
+
+        if( pReused != NULL )
+        {
+            *pReused = reused;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void HttpPool_Release( HttpPool_t * pPool,
+                       HttpPoolConnection_t * pConnection,
+                       bool keepAlive )
+{
+    if( ( pPool != NULL ) && ( pConnection != NULL ) )
+    {
+        if( keepAlive == false )
+        {
+            closeConnection( pPool, pConnection );
+        }
+
+        pConnection->lastUsedMs = Clock_GetTimeMs();
+        pConnection->inUse = false;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+HTTPStatus_t HttpPool_Send( HttpPool_t * pPool,
+                            const char * pHost,
+                            size_t hostLength,
+                            uint16_t port,
+                            HTTPRequestHeaders_t * pRequestHeaders,
+                            const uint8_t * pRequestBodyBuf,
+                            size_t reqBodyBufLen,
+                            HTTPResponse_t * pResponse,
+                            uint32_t sendFlags )
+{
+    HTTPStatus_t httpStatus = HTTPNetworkError;
+    HttpPoolConnection_t * pConnection = NULL;
+    bool reused = false;
+    bool retry = false;
+
+    if( HttpPool_Acquire( pPool, pHost, hostLength, port,
+                          &pConnection, &reused ) == HTTP_POOL_SUCCESS )
+    {
+        httpStatus = HTTPClient_Send( &pConnection->transport,
+                                      pRequestHeaders,
+                                      pRequestBodyBuf,
+                                      reqBodyBufLen,
+                                      pResponse,
+                                      sendFlags );
+
+        /* A reused connection the server has closed fails before any of the
+         * response is received, which HTTPClient_Send() reports with
+         * HTTPNoResponse. Yet the server may have handled the request before
+         * closing, and a network error may come after it got the request, so
+         * only a request that can be handled twice is sent again. After a
+         * network error, its buffer must also not have been overwritten by
+         * part of the response. */
+        retry = ( reused == true ) &&
+                ( ( pPool->resendAnyMethod == true ) || ( isIdempotent( pRequestHeaders ) == true ) ) &&
+                ( ( httpStatus == HTTPNoResponse ) ||
+                  ( ( httpStatus == HTTPNetworkError ) &&
+                    ( buffersOverlap( pRequestHeaders, pResponse ) == false ) ) );
+
+        if( retry == true )
+        {
+            LogWarn( ( "Request on a reused connection to %.*s:%u failed, "
+                       "sending it on a new connection: Status=%s.",
+                       ( int32_t ) hostLength,
+                       pHost,
+                       ( unsigned int ) port,
+                       HTTPClient_strerror( httpStatus ) ) );
+
+            closeConnection( pPool, pConnection );
+
+            if( openConnection( pPool, pConnection, pHost,
+                                hostLength, port ) == HTTP_POOL_SUCCESS )
+            {
+                httpStatus = HTTPClient_Send( &pConnection->transport,
+                                              pRequestHeaders,
+                                              pRequestBodyBuf,
+                                              reqBodyBufLen,
+                                              pResponse,
+                                              sendFlags );
+            }
+            else
+            {
+                httpStatus = HTTPNetworkError;
+            }
+        }
+
+        pConnection->requestCount++;
+
+        /* Keep the connection open unless the request failed or the server
+         * closes it after the response. */
+        HttpPool_Release( pPool,
+                          pConnection,
+                          ( httpStatus == HTTPSuccess ) &&
+                          ( ( pResponse->respFlags & HTTP_RESPONSE_CONNECTION_CLOSE_FLAG ) == 0U ) );
+    }
+
+    return httpStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t HttpPool_CloseIdle( HttpPool_t * pPool )
+{
+    size_t closedCount = 0U;
+    uint32_t nowMs = Clock_GetTimeMs();
+    size_t i = 0U;
+
+    if( pPool != NULL )
+    {
+        for( i = 0U; i < pPool->connectionCount; i++ )
+        {
+            if( ( pPool->pConnections[ i ].inUse == false ) &&
+                ( pPool->pConnections[ i ].connected == true ) &&
+                ( isExpired( pPool, &pPool->pConnections[ i ], nowMs ) == true ) )
+            {
+                closeConnection( pPool, &pPool->pConnections[ i ] );
+                closedCount++;
+            }
+        }
+    }
+
+    return closedCount;
+}
+
+/*-----------------------------------------------------------*/
+
+void HttpPool_CloseAll( HttpPool_t * pPool )
+{
+    size_t i = 0U;
+
+    if( pPool != NULL )
+    {
+        for( i = 0U; i < pPool->connectionCount; i++ )
+        {
+            if( pPool->pConnections[ i ].inUse == false )
+            {
+                closeConnection( pPool, &pPool->pConnections[ i ] );
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
@@ -24,17 +24,11 @@
 #include <assert.h>
 #include <stdlib.h>
 
-/* Zephyr random */
-#include <random/rand32.h>
-
 /* Demo utils header. */
 #include "http_demo_utils.h"
 
-/*Include backoff algorithm header for retry logic.*/
-#include "backoff_algorithm.h"
-
-/*Include clock header for millisecond sleep function. */
-#include "clock.h"
+/* Include the reconnect scheduler for retry logic. */
+#include "reconnect_scheduler.h"
 
 /* Third party parser utilities. */
 #include "http_parser.h"
@@ -68,71 +62,45 @@ struct NetworkContext
 
 /*-----------------------------------------------------------*/
 
-/**
- * @brief The random number generator to use for exponential backoff with
- * jitter retry logic.
- *
- * @return The generated random number.
- */
-static uint32_t generateRandomNumber();
-
-/*-----------------------------------------------------------*/
-
-static uint32_t generateRandomNumber()
-{
-    return sys_rand32_get();
-}
-
-/*-----------------------------------------------------------*/
-
 int32_t connectToServerWithBackoffRetries( TransportConnect_t connectFunction,
                                            NetworkContext_t * pNetworkContext )
 {
     int32_t returnStatus = EXIT_FAILURE;
-    /* Status returned by the retry utilities. */
-    BackoffAlgorithmStatus_t backoffAlgStatus = BackoffAlgorithmSuccess;
-    /* Struct containing the next backoff time. */
-    BackoffAlgorithmContext_t reconnectParams;
-    uint16_t nextRetryBackOff = 0U;
+    /* State of the delays between the attempts. */
+    ReconnectScheduler_t reconnectScheduler;
+    bool retry = false;
 
     assert( connectFunction != NULL );
 
     /* Initialize reconnect attempts and interval */
-    BackoffAlgorithm_InitializeParams( &reconnectParams,
-                                       CONNECTION_RETRY_BACKOFF_BASE_MS,
-                                       CONNECTION_RETRY_MAX_BACKOFF_DELAY_MS,
-                                       CONNECTION_RETRY_MAX_ATTEMPTS );
+    Reconnect_Init( &reconnectScheduler,
+                    "HTTP",
+                    CONNECTION_RETRY_BACKOFF_BASE_MS,
+                    CONNECTION_RETRY_MAX_BACKOFF_DELAY_MS,
+                    CONNECTION_RETRY_MAX_ATTEMPTS );
 
     /* Attempt to connect to HTTP server. If connection fails, retry after
-     * a timeout. Timeout value will exponentially increase until maximum
-     * attempts are reached. */
+     * a delay drawn with decorrelated jitter, until maximum attempts are
+     * reached. The connect functions do not tell what failed, so each
+     * failure is retried as one of the TCP connection. */
     do
     {
         returnStatus = connectFunction( pNetworkContext );
 
         if( returnStatus != EXIT_SUCCESS )
         {
-            /* Generate a random number and get back-off value (in milliseconds) for the next connection retry. */
-            backoffAlgStatus = BackoffAlgorithm_GetNextBackoff( &reconnectParams, generateRandomNumber(), &nextRetryBackOff );
-
-            if( backoffAlgStatus == BackoffAlgorithmSuccess )
-            {
-                LogWarn( ( "Connection to the HTTP server failed. Retrying "
-                           "connection after %hu ms backoff.",
-                           ( unsigned short ) nextRetryBackOff ) );
-                Clock_SleepMs( nextRetryBackOff );
-            }
-            else
-            {
-                LogError( ( "Connection to the HTTP server failed, all attempts exhausted." ) );
-            }
+            retry = Reconnect_Wait( &reconnectScheduler, RECONNECT_FAILURE_TCP );
         }
-    } while( ( returnStatus == EXIT_FAILURE ) && ( backoffAlgStatus == BackoffAlgorithmSuccess ) );
+    } while( ( returnStatus == EXIT_FAILURE ) && ( retry == true ) );
 
     if( returnStatus == EXIT_FAILURE )
     {
         LogError( ( "Connection to the server failed, all attempts exhausted." ) );
     }
+    else
+    {
+        Reconnect_Succeeded( &reconnectScheduler );
+    }
 
     return returnStatus;
 }
@@ -0,0 +1,609 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file http_flash_download.c
+ * @brief Download of an HTTP object straight into a flash area, in ranges.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* Download header. */
+#include "http_flash_download.h"
+
+/* Clock header for the response timeouts and the retry delays. */
+#include "clock.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The "Content-Range" header of the responses, and the length of its
+ * name.
+ */
+#define CONTENT_RANGE_FIELD           "Content-Range"
+#define CONTENT_RANGE_FIELD_LENGTH    ( sizeof( CONTENT_RANGE_FIELD ) - 1U )
+
+/**
+ * @brief Status code of a response holding the requested range.
+ */
+#define HTTP_STATUS_PARTIAL_CONTENT           ( 206U )
+
+/**
+ * @brief Status code of a response to a range starting after the end of the
+ * object.
+ */
+#define HTTP_STATUS_RANGE_NOT_SATISFIABLE     ( 416U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Work handler erasing the flash area ahead of a chunk, and writing
+ * the chunk.
+ *
+ * The chunk is padded with the erased value of the flash area up to its
+ * write alignment.
+ *
+ * @param[in] pWork The work item of the buffer of the chunk.
+ */
+static void writeChunk( struct k_work * pWork );
+
+/**
+ * @brief Wait until no buffer is being written to flash.
+ *
+ * @param[in] pDownload The download.
+ */
+static void waitForWrites( HttpDownload_t * pDownload );
+
+/**
+ * @brief Parse a decimal number of a header value.
+ *
+ * @param[in,out] ppValue Start of the number, moved to the character
+ * following it.
+ * @param[in] pEnd End of the header value.
+ * @param[out] pNumber The number.
+ *
+ * @return true if there is a number fitting in 32 bits; false otherwise.
+ */
+static bool parseNumber( const char ** ppValue,
+                         const char * pEnd,
+                         uint32_t * pNumber );
+
+/**
+ * @brief Parse the value of a "Content-Range" header, which is either
+ * "bytes <first>-<last>/<size>" or "bytes * /<size>" without the space.
+ *
+ * @param[in] pValue The header value.
+ * @param[in] valueLength Length of @p pValue.
+ * @param[out] pFirst First byte of the range, set to the size for the second
+ * form.
+ * @param[out] pLast Last byte of the range, not set for the second form.
+ * @param[out] pSize Size of the object.
+ *
+ * @return true if the value is valid; false otherwise.
+ */
+static bool parseContentRange( const char * pValue,
+                               size_t valueLength,
+                               uint32_t * pFirst,
+                               uint32_t * pLast,
+                               uint32_t * pSize );
+
+/**
+ * @brief Request the next range of the object into a buffer.
+ *
+ * @param[in] pDownload The download.
+ * @param[in] pBuffer The buffer, which is not being written.
+ *
+ * @return #HTTP_DOWNLOAD_SUCCESS with the chunk in the buffer, which is empty
+ * for a download resumed at the end of the object,
+ * #HTTP_DOWNLOAD_NETWORK_ERROR, #HTTP_DOWNLOAD_SERVER_ERROR, or
+ * #HTTP_DOWNLOAD_TOO_LARGE.
+ */
+static HttpDownloadStatus_t requestChunk( HttpDownload_t * pDownload,
+                                          HttpDownloadBuffer_t * pBuffer );
+
+/*-----------------------------------------------------------*/
+
+static void writeChunk( struct k_work * pWork )
+{
+    HttpDownloadBuffer_t * pBuffer = CONTAINER_OF( pWork, HttpDownloadBuffer_t, work );
+    HttpDownload_t * pDownload = pBuffer->pDownload;
+    const struct flash_area * pFlashArea = pDownload->pFlashArea;
+    size_t writeLength = ROUND_UP( pBuffer->dataLength, flash_area_align( pFlashArea ) );
+    uint32_t writeEnd = pBuffer->offset + writeLength;
+    size_t eraseLength = 0U;
+
+    /* Erase the blocks the chunk starts to use. The blocks before were erased
+     * with the previous chunks. */
+    while( ( pDownload->flashError == false ) && ( pDownload->erasedOffset < writeEnd ) )
+    {
+        eraseLength = MIN( HTTP_DOWNLOAD_ERASE_BLOCK_SIZE,
+                           pFlashArea->fa_size - pDownload->erasedOffset );
+
+        if( flash_area_erase( pFlashArea, pDownload->erasedOffset, eraseLength ) == 0 )
+        {
+            pDownload->erasedOffset += eraseLength;
+        }
+        else
+        {
+            LogError( ( "Failed to erase the flash area at offset %lu.",
+                        ( unsigned long ) pDownload->erasedOffset ) );
+            pDownload->flashError = true;
+        }
+    }
+
+    if( pDownload->flashError == false )
+    {
+        /* Only the last chunk of the object needs padding. The buffer has
+         * room for it after the body. */
+        ( void ) memset( &pBuffer->pData[ pBuffer->dataLength ],
+                         flash_area_erased_val( pFlashArea ),
+                         writeLength - pBuffer->dataLength );
+
+        if( flash_area_write( pFlashArea, pBuffer->offset, pBuffer->pData, writeLength ) == 0 )
+        {
+            pDownload->writtenOffset = pBuffer->offset + pBuffer->dataLength;
+        }
+        else
+        {
+            LogError( ( "Failed to write %lu bytes to the flash area at offset %lu.",
+                        ( unsigned long ) writeLength,
+                        ( unsigned long ) pBuffer->offset ) );
+            pDownload->flashError = true;
+        }
+    }
+
+    k_sem_give( &pBuffer->free );
+}
+
+/*-----------------------------------------------------------*/
+
+static void waitForWrites( HttpDownload_t * pDownload )
+{
+    size_t i = 0U;
+
+    for( i = 0U; i < 2U; i++ )
+    {
+        ( void ) k_sem_take( &pDownload->buffers[ i ].free, K_FOREVER );
+        k_sem_give( &pDownload->buffers[ i ].free );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool parseNumber( const char ** ppValue,
+                         const char * pEnd,
+                         uint32_t * pNumber )
+{
+    const char * pStart = *ppValue;
+    const char * pValue = pStart;
+    uint64_t number = 0U;
+
+    while( ( pValue < pEnd ) && ( *pValue >= '0' ) && ( *pValue <= '9' ) &&
+           ( number <= UINT32_MAX ) )
+    {
+        number = ( number * 10U ) + ( uint64_t ) ( *pValue - '0' );
+        pValue++;
+    }
+
+    *pNumber = ( uint32_t ) number;
+    *ppValue = pValue;
+
+    /* There is at least one digit, and the number did not overflow. */
+    return ( pValue != pStart ) && ( number <= UINT32_MAX );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool parseContentRange( const char * pValue,
+                               size_t valueLength,
+                               uint32_t * pFirst,
+                               uint32_t * pLast,
+                               uint32_t * pSize )
+{
+    const char * pEnd = pValue + valueLength;
+    bool valid = false;
+
+    if( ( valueLength > 6U ) && ( strncmp( pValue, "bytes ", 6U ) == 0 ) )
+    {
+        pValue += 6U;
+
+        if( *pValue == '*' )
+        {
+            pValue++;
+            valid = ( pValue < pEnd ) && ( *pValue == '/' );
+            pValue++;
+            valid = valid && parseNumber( &pValue, pEnd, pSize );
+            *pFirst = *pSize;
+        }
+        else
+        {
+            valid = parseNumber( &pValue, pEnd, pFirst ) &&
+                    ( pValue < pEnd ) && ( *pValue == '-' );
+            pValue++;
+            valid = valid && parseNumber( &pValue, pEnd, pLast ) &&
+                    ( pValue < pEnd ) && ( *pValue == '/' );
+            pValue++;
+            valid = valid && parseNumber( &pValue, pEnd, pSize ) &&
+                    ( *pFirst <= *pLast ) && ( *pLast < *pSize );
+        }
+
+        valid = valid && ( pValue == pEnd );
+    }
+
+    return valid;
+}
+
+/*-----------------------------------------------------------*/
+
+static HttpDownloadStatus_t requestChunk( HttpDownload_t * pDownload,
+                                          HttpDownloadBuffer_t * pBuffer )
+{
+    HttpDownloadStatus_t status = HTTP_DOWNLOAD_SUCCESS;
+    HTTPStatus_t httpStatus = HTTPSuccess;
+    HTTPRequestInfo_t requestInfo;
+    HTTPRequestHeaders_t requestHeaders;
+    HTTPResponse_t response;
+    uint32_t rangeLast = pDownload->requestOffset + pDownload->chunkSize - 1U;
+    const char * pContentRange = NULL;
+    size_t contentRangeLength = 0U;
+    uint32_t first = 0U;
+    uint32_t last = 0U;
+    uint32_t size = 0U;
+    size_t align = flash_area_align( pDownload->pFlashArea );
+
+    ( void ) memset( &requestInfo, 0, sizeof( requestInfo ) );
+    ( void ) memset( &requestHeaders, 0, sizeof( requestHeaders ) );
+    ( void ) memset( &response, 0, sizeof( response ) );
+
+    if( ( pDownload->objectSize != 0U ) && ( rangeLast >= pDownload->objectSize ) )
+    {
+        rangeLast = pDownload->objectSize - 1U;
+    }
+
+    requestInfo.pHost = pDownload->pHost;
+    requestInfo.hostLen = pDownload->hostLength;
+    requestInfo.pMethod = HTTP_METHOD_GET;
+    requestInfo.methodLen = sizeof( HTTP_METHOD_GET ) - 1U;
+    requestInfo.pPath = pDownload->pPath;
+    requestInfo.pathLen = pDownload->pathLength;
+    requestInfo.reqFlags = HTTP_REQUEST_KEEP_ALIVE_FLAG;
+
+    /* The request headers have their own buffer, so a request that failed on
+     * a connection closed by the server can be sent again by the pool. */
+    requestHeaders.pBuffer = pDownload->requestHeaders;
+    requestHeaders.bufferLen = sizeof( pDownload->requestHeaders );
+
+    response.pBuffer = pBuffer->pBuffer;
+    response.bufferLen = pDownload->bufferLength;
+    response.getTime = Clock_GetTimeMs;
+
+    httpStatus = HTTPClient_InitializeRequestHeaders( &requestHeaders, &requestInfo );
+
+    if( httpStatus == HTTPSuccess )
+    {
+        httpStatus = HTTPClient_AddRangeHeader( &requestHeaders,
+                                                ( int32_t ) pDownload->requestOffset,
+                                                ( int32_t ) rangeLast );
+    }
+
+    if( httpStatus == HTTPSuccess )
+    {
+        httpStatus = HttpPool_Send( pDownload->pPool,
+                                    pDownload->pHost,
+                                    pDownload->hostLength,
+                                    pDownload->port,
+                                    &requestHeaders,
+                                    NULL,
+                                    0U,
+                                    &response,
+                                    0U );
+
+        if( httpStatus != HTTPSuccess )
+        {
+            LogWarn( ( "Request of the range %lu-%lu failed: Error=%s.",
+                       ( unsigned long ) pDownload->requestOffset,
+                       ( unsigned long ) rangeLast,
+                       HTTPClient_strerror( httpStatus ) ) );
+            status = HTTP_DOWNLOAD_NETWORK_ERROR;
+        }
+    }
+    else
+    {
+        LogError( ( "Failed to initialize the range request headers: Error=%s.",
+                    HTTPClient_strerror( httpStatus ) ) );
+        status = HTTP_DOWNLOAD_INVALID_PARAMETER;
+    }
+
+    if( status == HTTP_DOWNLOAD_SUCCESS )
+    {
+        if( ( ( response.statusCode != HTTP_STATUS_PARTIAL_CONTENT ) &&
+              ( response.statusCode != HTTP_STATUS_RANGE_NOT_SATISFIABLE ) ) ||
+            ( HTTPClient_ReadHeader( &response,
+                                     CONTENT_RANGE_FIELD,
+                                     CONTENT_RANGE_FIELD_LENGTH,
+                                     &pContentRange,
+                                     &contentRangeLength ) != HTTPSuccess ) ||
+            ( parseContentRange( pContentRange, contentRangeLength,
+                                 &first, &last, &size ) == false ) )
+        {
+            LogError( ( "Server did not answer with a range of the object: Status=%u.",
+                        ( unsigned int ) response.statusCode ) );
+            status = HTTP_DOWNLOAD_SERVER_ERROR;
+        }
+        else if( ( pDownload->objectSize != 0U ) && ( size != pDownload->objectSize ) )
+        {
+            LogError( ( "Size of the object changed from %lu to %lu bytes.",
+                        ( unsigned long ) pDownload->objectSize,
+                        ( unsigned long ) size ) );
+            status = HTTP_DOWNLOAD_SERVER_ERROR;
+        }
+        else if( ROUND_UP( ( size_t ) size, align ) > pDownload->pFlashArea->fa_size )
+        {
+            LogError( ( "Object of %lu bytes does not fit in the flash area.",
+                        ( unsigned long ) size ) );
+            status = HTTP_DOWNLOAD_TOO_LARGE;
+        }
+        else if( response.statusCode == HTTP_STATUS_RANGE_NOT_SATISFIABLE )
+        {
+            /* The download resumed at the end of the object, which is then
+             * complete. */
+            if( size == pDownload->requestOffset )
+            {
+                pDownload->objectSize = size;
+                pBuffer->dataLength = 0U;
+            }
+            else
+            {
+                LogError( ( "Server rejected the range starting at %lu of an object of %lu bytes.",
+                            ( unsigned long ) pDownload->requestOffset,
+                            ( unsigned long ) size ) );
+                status = HTTP_DOWNLOAD_SERVER_ERROR;
+            }
+        }
+        else if( ( first != pDownload->requestOffset ) ||
+                 ( response.bodyLen != ( size_t ) ( last - first ) + 1U ) ||
+                 ( ( ( last - first ) + 1U < pDownload->chunkSize ) && ( last != size - 1U ) ) )
+        {
+            LogError( ( "Server answered with the range %lu-%lu of %lu bytes instead of %lu-%lu.",
+                        ( unsigned long ) first,
+                        ( unsigned long ) last,
+                        ( unsigned long ) response.bodyLen,
+                        ( unsigned long ) pDownload->requestOffset,
+                        ( unsigned long ) rangeLast ) );
+            status = HTTP_DOWNLOAD_SERVER_ERROR;
+        }
+        else if( ( response.pBody + ROUND_UP( response.bodyLen, align ) ) >
+                 ( pBuffer->pBuffer + pDownload->bufferLength ) )
+        {
+            LogError( ( "Response headers of %lu bytes leave no room to align the chunk, "
+                        "increase HTTP_DOWNLOAD_RESPONSE_HEADERS_MAX.",
+                        ( unsigned long ) response.headersLen ) );
+            status = HTTP_DOWNLOAD_SERVER_ERROR;
+        }
+        else
+        {
+            pDownload->objectSize = size;
+            pBuffer->pData = ( uint8_t * ) response.pBody;
+            pBuffer->dataLength = response.bodyLen;
+            pBuffer->offset = first;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+HttpDownloadStatus_t HttpDownload_Init( HttpDownload_t * pDownload,
+                                        HttpPool_t * pPool,
+                                        const char * pHost,
+                                        size_t hostLength,
+                                        uint16_t port,
+                                        const char * pPath,
+                                        size_t pathLength,
+                                        const struct flash_area * pFlashArea,
+                                        struct k_work_q * pWriteQueue,
+                                        uint8_t * pBuffer0,
+                                        uint8_t * pBuffer1,
+                                        size_t bufferLength,
+                                        uint32_t resumeOffset )
+{
+    HttpDownloadStatus_t status = HTTP_DOWNLOAD_SUCCESS;
+    size_t align = 0U;
+    size_t i = 0U;
+
+    if( ( pDownload == NULL ) || ( pPool == NULL ) || ( pHost == NULL ) ||
+        ( pPath == NULL ) || ( pFlashArea == NULL ) || ( pWriteQueue == NULL ) ||
+        ( pBuffer0 == NULL ) || ( pBuffer1 == NULL ) )
+    {
+        LogError( ( "Invalid parameter to initialize the download." ) );
+        status = HTTP_DOWNLOAD_INVALID_PARAMETER;
+    }
+    else
+    {
+        align = flash_area_align( pFlashArea );
+
+        if( ( bufferLength < HTTP_DOWNLOAD_RESPONSE_HEADERS_MAX + align ) ||
+            ( ( resumeOffset % align ) != 0U ) ||
+            ( resumeOffset > pFlashArea->fa_size ) )
+        {
+            LogError( ( "Invalid buffer length %lu or resume offset %lu of the download.",
+                        ( unsigned long ) bufferLength,
+                        ( unsigned long ) resumeOffset ) );
+            status = HTTP_DOWNLOAD_INVALID_PARAMETER;
+        }
+    }
+
+    if( status == HTTP_DOWNLOAD_SUCCESS )
+    {
+        ( void ) memset( pDownload, 0, sizeof( HttpDownload_t ) );
+
+        pDownload->pPool = pPool;
+        pDownload->pHost = pHost;
+        pDownload->hostLength = hostLength;
+        pDownload->port = port;
+        pDownload->pPath = pPath;
+        pDownload->pathLength = pathLength;
+        pDownload->pFlashArea = pFlashArea;
+        pDownload->pWriteQueue = pWriteQueue;
+        pDownload->bufferLength = bufferLength;
+
+        /* All the chunks but the last start at an offset aligned for
+         * writing. */
+        pDownload->chunkSize = ROUND_DOWN( bufferLength - HTTP_DOWNLOAD_RESPONSE_HEADERS_MAX, align );
+
+        /* The block holding the resume offset was erased before the data
+         * already written to it. */
+        pDownload->requestOffset = resumeOffset;
+        pDownload->writtenOffset = resumeOffset;
+        pDownload->erasedOffset = MIN( ROUND_UP( resumeOffset, HTTP_DOWNLOAD_ERASE_BLOCK_SIZE ),
+                                       pFlashArea->fa_size );
+
+        pDownload->buffers[ 0 ].pBuffer = pBuffer0;
+        pDownload->buffers[ 1 ].pBuffer = pBuffer1;
+
+        for( i = 0U; i < 2U; i++ )
+        {
+            pDownload->buffers[ i ].pDownload = pDownload;
+            k_work_init( &pDownload->buffers[ i ].work, writeChunk );
+            ( void ) k_sem_init( &pDownload->buffers[ i ].free, 1U, 1U );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+HttpDownloadStatus_t HttpDownload_Run( HttpDownload_t * pDownload )
+{
+    HttpDownloadStatus_t status = HTTP_DOWNLOAD_SUCCESS;
+    HttpDownloadStatus_t chunkStatus = HTTP_DOWNLOAD_SUCCESS;
+    HttpDownloadBuffer_t * pBuffer = NULL;
+    uint32_t failureCount = 0U;
+    size_t current = 0U;
+    bool complete = false;
+
+    if( pDownload == NULL )
+    {
+        status = HTTP_DOWNLOAD_INVALID_PARAMETER;
+    }
+    else
+    {
+        /* Resume after the last chunk written by a previous run. */
+        pDownload->requestOffset = pDownload->writtenOffset;
+        complete = ( pDownload->objectSize != 0U ) &&
+                   ( pDownload->writtenOffset >= pDownload->objectSize );
+    }
+
+    while( ( status == HTTP_DOWNLOAD_SUCCESS ) && ( complete == false ) )
+    {
+        /* Receive into the buffer written the longest ago, once its write
+         * is done. The other buffer may still be written meanwhile. */
+        pBuffer = &pDownload->buffers[ current ];
+        ( void ) k_sem_take( &pBuffer->free, K_FOREVER );
+
+        if( pDownload->flashError == true )
+        {
+            k_sem_give( &pBuffer->free );
+            status = HTTP_DOWNLOAD_FLASH_ERROR;
+        }
+        else
+        {
+            chunkStatus = requestChunk( pDownload, pBuffer );
+        }
+
+        if( status != HTTP_DOWNLOAD_SUCCESS )
+        {
+            /* The flash failed. */
+        }
+        else if( ( chunkStatus == HTTP_DOWNLOAD_SUCCESS ) && ( pBuffer->dataLength != 0U ) )
+        {
+            pDownload->requestOffset += ( uint32_t ) pBuffer->dataLength;
+            complete = ( pDownload->requestOffset >= pDownload->objectSize );
+            failureCount = 0U;
+
+            ( void ) k_work_submit_to_queue( pDownload->pWriteQueue, &pBuffer->work );
+            current = ( current + 1U ) % 2U;
+        }
+        else if( chunkStatus == HTTP_DOWNLOAD_SUCCESS )
+        {
+            /* The object was already complete. */
+            k_sem_give( &pBuffer->free );
+            complete = true;
+        }
+        else if( ( chunkStatus == HTTP_DOWNLOAD_NETWORK_ERROR ) &&
+                 ( failureCount < HTTP_DOWNLOAD_MAX_RETRIES ) )
+        {
+            k_sem_give( &pBuffer->free );
+
+            /* The pool closed the failed connection and opens a new one for
+             * the next request, which resumes after the written data. */
+            Clock_SleepMs( HTTP_DOWNLOAD_RETRY_BASE_MS << failureCount );
+            failureCount++;
+            waitForWrites( pDownload );
+            pDownload->requestOffset = pDownload->writtenOffset;
+        }
+        else
+        {
+            k_sem_give( &pBuffer->free );
+            status = chunkStatus;
+        }
+    }
+
+    if( pDownload != NULL )
+    {
+        waitForWrites( pDownload );
+
+        if( pDownload->flashError == true )
+        {
+            status = HTTP_DOWNLOAD_FLASH_ERROR;
+        }
+    }
+
+    if( status == HTTP_DOWNLOAD_SUCCESS )
+    {
+        LogInfo( ( "Downloaded %.*s to flash: Size=%lu bytes.",
+                   ( int32_t ) pDownload->pathLength,
+                   pDownload->pPath,
+                   ( unsigned long ) pDownload->objectSize ) );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t HttpDownload_GetWrittenOffset( const HttpDownload_t * pDownload )
+{
+    return ( pDownload != NULL ) ? pDownload->writtenOffset : 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t HttpDownload_GetObjectSize( const HttpDownload_t * pDownload )
+{
+    return ( pDownload != NULL ) ? pDownload->objectSize : 0U;
+}
+
+/*-----------------------------------------------------------*/
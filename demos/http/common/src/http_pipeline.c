@@ -0,0 +1,578 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file http_pipeline.c
+ * @brief Pipelining of HTTP requests on a kept-alive connection, and
+ * streaming of their responses.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* Pipeline header. */
+#include "http_pipeline.h"
+
+/* Third party parser of the responses. */
+#include "http_parser.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief State of the parsing of a response.
+ */
+typedef struct ParsingContext
+{
+    HTTPResponse_t * pResponse;              /**< @brief The response. */
+    HttpPipelineBodyCallback_t bodyCallback; /**< @brief Callback of a streamed body, or NULL. */
+    void * pCallbackContext;                 /**< @brief Context of #ParsingContext_t.bodyCallback. */
+    const uint8_t * pHeadersEnd;             /**< @brief End of the last header value parsed. */
+    bool lastCallbackWasField;               /**< @brief The last data parsed was a header field. */
+    bool headersComplete;                    /**< @brief The headers were parsed. */
+    bool stopped;                            /**< @brief The body callback stopped the body. */
+    bool complete;                           /**< @brief The whole response was parsed. */
+} ParsingContext_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Parser callback of a header field, which counts the headers and
+ * finds where they start.
+ *
+ * @param[in] pParser The parser.
+ * @param[in] pLoc Start of the field, or of its part.
+ * @param[in] length Length of the field part.
+ *
+ * @return 0, to continue parsing.
+ */
+static int onHeaderField( http_parser * pParser,
+                          const char * pLoc,
+                          size_t length );
+
+/**
+ * @brief Parser callback of a header value, which finds where the headers
+ * end.
+ *
+ * @param[in] pParser The parser.
+ * @param[in] pLoc Start of the value, or of its part.
+ * @param[in] length Length of the value part.
+ *
+ * @return 0, to continue parsing.
+ */
+static int onHeaderValue( http_parser * pParser,
+                          const char * pLoc,
+                          size_t length );
+
+/**
+ * @brief Parser callback of the end of the headers. For a streamed response,
+ * it pauses the parser so that the headers are kept in the buffer and the
+ * body after them is dropped once parsed.
+ *
+ * @param[in] pParser The parser.
+ *
+ * @return 0, to parse the body.
+ */
+static int onHeadersComplete( http_parser * pParser );
+
+/**
+ * @brief Parser callback of body data, which passes it to the callback of a
+ * streamed response. Otherwise the parts of a chunked body are moved next to
+ * each other, over the chunk headers.
+ *
+ * @param[in] pParser The parser.
+ * @param[in] pLoc Start of the body part.
+ * @param[in] length Length of the body part.
+ *
+ * @return 0, to continue parsing.
+ */
+static int onBody( http_parser * pParser,
+                   const char * pLoc,
+                   size_t length );
+
+/**
+ * @brief Parser callback of the end of a response, which pauses the parser
+ * so that the bytes of the next response are left in the buffer.
+ *
+ * @param[in] pParser The parser.
+ *
+ * @return 0.
+ */
+static int onMessageComplete( http_parser * pParser );
+
+/**
+ * @brief Drop the last returned response from the buffer, keeping the bytes
+ * received after it.
+ *
+ * @param[in] pPipeline The pipeline.
+ */
+static void dropResponse( HttpPipeline_t * pPipeline );
+
+/**
+ * @brief Drop bytes of the buffer, keeping the bytes received after them.
+ *
+ * @param[in] pPipeline The pipeline.
+ * @param[in] offset Offset of the bytes in the buffer.
+ * @param[in] length Number of bytes.
+ */
+static void dropBytes( HttpPipeline_t * pPipeline,
+                       size_t offset,
+                       size_t length );
+
+/**
+ * @brief Receive and parse the response of the oldest request sent.
+ *
+ * @param[in] pPipeline The pipeline.
+ * @param[out] pResponse The response.
+ * @param[in] bodyCallback Callback of the body of a streamed response, or
+ * NULL to keep the body in the buffer.
+ * @param[in] pCallbackContext Context passed to @p bodyCallback.
+ *
+ * @return The return values of #HttpPipeline_ReceiveStreamed.
+ */
+static HTTPStatus_t receiveResponse( HttpPipeline_t * pPipeline,
+                                     HTTPResponse_t * pResponse,
+                                     HttpPipelineBodyCallback_t bodyCallback,
+                                     void * pCallbackContext );
+
+/*-----------------------------------------------------------*/
+
+static int onHeaderField( http_parser * pParser,
+                          const char * pLoc,
+                          size_t length )
+{
+    ParsingContext_t * pContext = ( ParsingContext_t * ) pParser->data;
+    HTTPResponse_t * pResponse = pContext->pResponse;
+
+    ( void ) length;
+
+    if( pResponse->pHeaders == NULL )
+    {
+        pResponse->pHeaders = ( const uint8_t * ) pLoc;
+    }
+
+    /* A field received in two parts is parsed in two calls. */
+    if( pContext->lastCallbackWasField == false )
+    {
+        pResponse->headerCount++;
+    }
+
+    pContext->lastCallbackWasField = true;
+
+    return 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static int onHeaderValue( http_parser * pParser,
+                          const char * pLoc,
+                          size_t length )
+{
+    ParsingContext_t * pContext = ( ParsingContext_t * ) pParser->data;
+
+    pContext->pHeadersEnd = ( const uint8_t * ) &pLoc[ length ];
+    pContext->pResponse->headersLen = ( size_t ) ( pContext->pHeadersEnd -
+                                                   pContext->pResponse->pHeaders );
+    pContext->lastCallbackWasField = false;
+
+    return 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static int onHeadersComplete( http_parser * pParser )
+{
+    ParsingContext_t * pContext = ( ParsingContext_t * ) pParser->data;
+
+    pContext->pResponse->statusCode = ( uint16_t ) pParser->status_code;
+    pContext->headersComplete = true;
+
+    if( pContext->bodyCallback != NULL )
+    {
+        http_parser_pause( pParser, 1 );
+    }
+
+    return 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static int onBody( http_parser * pParser,
+                   const char * pLoc,
+                   size_t length )
+{
+    ParsingContext_t * pContext = ( ParsingContext_t * ) pParser->data;
+    HTTPResponse_t * pResponse = pContext->pResponse;
+    uint8_t * pBodyEnd = NULL;
+
+    if( pContext->bodyCallback != NULL )
+    {
+        if( pContext->bodyCallback( pContext->pCallbackContext,
+                                    pResponse,
+                                    ( const uint8_t * ) pLoc,
+                                    length ) == false )
+        {
+            pContext->stopped = true;
+            http_parser_pause( pParser, 1 );
+        }
+    }
+    else
+    {
+        if( pResponse->pBody == NULL )
+        {
+            pResponse->pBody = ( const uint8_t * ) pLoc;
+        }
+
+        /* The bytes between the body parsed so far and this part were parsed
+         * already, so they can be overwritten. */
+        pBodyEnd = ( uint8_t * ) &pResponse->pBody[ pResponse->bodyLen ];
+
+        if( pBodyEnd != ( const uint8_t * ) pLoc )
+        {
+            ( void ) memmove( pBodyEnd, pLoc, length );
+        }
+    }
+
+    pResponse->bodyLen += length;
+
+    return 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static int onMessageComplete( http_parser * pParser )
+{
+    ParsingContext_t * pContext = ( ParsingContext_t * ) pParser->data;
+
+    pContext->pResponse->statusCode = ( uint16_t ) pParser->status_code;
+    pContext->pResponse->respFlags = ( http_should_keep_alive( pParser ) != 0 ) ?
+                                     HTTP_RESPONSE_CONNECTION_KEEP_ALIVE_FLAG :
+                                     HTTP_RESPONSE_CONNECTION_CLOSE_FLAG;
+    pContext->complete = true;
+
+    /* Stop after this response; the parser returns the number of bytes it
+     * used. */
+    http_parser_pause( pParser, 1 );
+
+    return 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static void dropResponse( HttpPipeline_t * pPipeline )
+{
+    dropBytes( pPipeline, 0U, pPipeline->responseLength );
+    pPipeline->responseLength = 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+static void dropBytes( HttpPipeline_t * pPipeline,
+                       size_t offset,
+                       size_t length )
+{
+    if( length > 0U )
+    {
+        ( void ) memmove( &pPipeline->pBuffer[ offset ],
+                          &pPipeline->pBuffer[ offset + length ],
+                          pPipeline->receivedLength - ( offset + length ) );
+        pPipeline->receivedLength -= length;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+HTTPStatus_t HttpPipeline_Init( HttpPipeline_t * pPipeline,
+                                const TransportInterface_t * pTransport,
+                                uint8_t * pBuffer,
+                                size_t bufferLength,
+                                HTTPClient_GetCurrentTimeFunc_t getTime )
+{
+    HTTPStatus_t status = HTTPSuccess;
+
+    if( ( pPipeline == NULL ) || ( pTransport == NULL ) ||
+        ( pTransport->send == NULL ) || ( pTransport->recv == NULL ) ||
+        ( pBuffer == NULL ) || ( bufferLength == 0U ) || ( getTime == NULL ) )
+    {
+        LogError( ( "Invalid parameter to initialize the pipeline." ) );
+        status = HTTPInvalidParameter;
+    }
+    else
+    {
+        ( void ) memset( pPipeline, 0, sizeof( HttpPipeline_t ) );
+        pPipeline->pTransport = pTransport;
+        pPipeline->getTime = getTime;
+        pPipeline->pBuffer = pBuffer;
+        pPipeline->bufferLength = bufferLength;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+HTTPStatus_t HttpPipeline_Send( HttpPipeline_t * pPipeline,
+                                const HTTPRequestHeaders_t * pRequestHeaders )
+{
+    HTTPStatus_t status = HTTPSuccess;
+    const TransportInterface_t * pTransport = NULL;
+    size_t sentLength = 0U;
+    int32_t bytesSent = 0;
+    uint32_t lastSendTimeMs = 0U;
+
+    if( ( pPipeline == NULL ) || ( pRequestHeaders == NULL ) ||
+        ( pRequestHeaders->pBuffer == NULL ) || ( pRequestHeaders->headersLen == 0U ) )
+    {
+        LogError( ( "Invalid parameter to send a pipelined request." ) );
+        status = HTTPInvalidParameter;
+    }
+    else
+    {
+        pTransport = pPipeline->pTransport;
+        lastSendTimeMs = pPipeline->getTime();
+    }
+
+    while( ( status == HTTPSuccess ) && ( sentLength < pRequestHeaders->headersLen ) )
+    {
+        bytesSent = pTransport->send( pTransport->pNetworkContext,
+                                      &pRequestHeaders->pBuffer[ sentLength ],
+                                      pRequestHeaders->headersLen - sentLength );
+
+        if( bytesSent < 0 )
+        {
+            LogError( ( "Failed to send a pipelined request: Error=%ld.", ( long ) bytesSent ) );
+            status = HTTPNetworkError;
+        }
+        else if( bytesSent > 0 )
+        {
+            sentLength += ( size_t ) bytesSent;
+            lastSendTimeMs = pPipeline->getTime();
+        }
+        else if( ( pPipeline->getTime() - lastSendTimeMs ) > HTTP_PIPELINE_TIMEOUT_MS )
+        {
+            LogError( ( "Timed out sending a pipelined request." ) );
+            status = HTTPNetworkError;
+        }
+        else
+        {
+            /* The transport could not send yet; try again. */
+        }
+    }
+
+    if( status == HTTPSuccess )
+    {
+        pPipeline->pendingCount++;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static HTTPStatus_t receiveResponse( HttpPipeline_t * pPipeline,
+                                     HTTPResponse_t * pResponse,
+                                     HttpPipelineBodyCallback_t bodyCallback,
+                                     void * pCallbackContext )
+{
+    HTTPStatus_t status = HTTPSuccess;
+    const TransportInterface_t * pTransport = NULL;
+    http_parser parser;
+    http_parser_settings settings;
+    ParsingContext_t context;
+    enum http_errno parserErrno = HPE_OK;
+    size_t parsedLength = 0U;
+    size_t headersLength = 0U;
+    int32_t bytesReceived = 0;
+    uint32_t lastReceiveTimeMs = 0U;
+
+    if( ( pPipeline == NULL ) || ( pResponse == NULL ) )
+    {
+        LogError( ( "Invalid parameter to receive a pipelined response." ) );
+        status = HTTPInvalidParameter;
+    }
+    else if( pPipeline->pendingCount == 0U )
+    {
+        LogError( ( "No pipelined request is waiting for its response." ) );
+        status = HTTPInvalidParameter;
+    }
+    else
+    {
+        pTransport = pPipeline->pTransport;
+        dropResponse( pPipeline );
+
+        ( void ) memset( pResponse, 0, sizeof( HTTPResponse_t ) );
+        pResponse->pBuffer = pPipeline->pBuffer;
+        pResponse->getTime = pPipeline->getTime;
+
+        ( void ) memset( &context, 0, sizeof( context ) );
+        context.pResponse = pResponse;
+        context.bodyCallback = bodyCallback;
+        context.pCallbackContext = pCallbackContext;
+
+        http_parser_init( &parser, HTTP_RESPONSE );
+        parser.data = &context;
+        http_parser_settings_init( &settings );
+        settings.on_header_field = onHeaderField;
+        settings.on_header_value = onHeaderValue;
+        settings.on_headers_complete = onHeadersComplete;
+        settings.on_body = onBody;
+        settings.on_message_complete = onMessageComplete;
+
+        lastReceiveTimeMs = pPipeline->getTime();
+    }
+
+    while( ( status == HTTPSuccess ) && ( context.complete == false ) )
+    {
+        if( parsedLength < pPipeline->receivedLength )
+        {
+            /* Parse the bytes received with the previous responses first. */
+            parsedLength += http_parser_execute( &parser,
+                                                 &settings,
+                                                 ( const char * ) &pPipeline->pBuffer[ parsedLength ],
+                                                 pPipeline->receivedLength - parsedLength );
+            parserErrno = HTTP_PARSER_ERRNO( &parser );
+
+            if( ( parserErrno != HPE_OK ) && ( parserErrno != HPE_PAUSED ) )
+            {
+                LogError( ( "Failed to parse a pipelined response: Error=%s.",
+                            http_errno_name( parserErrno ) ) );
+                status = HTTPParserInternalError;
+            }
+            else if( context.stopped == true )
+            {
+                LogError( ( "The body callback stopped the streamed response." ) );
+                status = HTTPInvalidResponse;
+            }
+            else if( ( bodyCallback != NULL ) && ( context.headersComplete == true ) )
+            {
+                if( headersLength == 0U )
+                {
+                    /* The parser paused at the end of the headers, which stay
+                     * in the buffer. */
+                    headersLength = parsedLength;
+                    pResponse->bufferLen = headersLength;
+
+                    if( context.complete == false )
+                    {
+                        http_parser_pause( &parser, 0 );
+                    }
+                }
+
+                /* The body parsed was passed to the callback. */
+                dropBytes( pPipeline, headersLength, parsedLength - headersLength );
+                parsedLength = headersLength;
+            }
+            else
+            {
+                /* More bytes are needed to complete the response. */
+            }
+        }
+        else if( pPipeline->receivedLength == pPipeline->bufferLength )
+        {
+            LogError( ( "Pipelined response does not fit in a buffer of %lu bytes.",
+                        ( unsigned long ) pPipeline->bufferLength ) );
+            status = HTTPInsufficientMemory;
+        }
+        else
+        {
+            bytesReceived = pTransport->recv( pTransport->pNetworkContext,
+                                              &pPipeline->pBuffer[ pPipeline->receivedLength ],
+                                              pPipeline->bufferLength - pPipeline->receivedLength );
+
+            if( bytesReceived < 0 )
+            {
+                LogError( ( "Failed to receive a pipelined response: Error=%ld.", ( long ) bytesReceived ) );
+                status = HTTPNetworkError;
+            }
+            else if( bytesReceived > 0 )
+            {
+                pPipeline->receivedLength += ( size_t ) bytesReceived;
+                lastReceiveTimeMs = pPipeline->getTime();
+            }
+            else if( ( pPipeline->getTime() - lastReceiveTimeMs ) <= HTTP_PIPELINE_TIMEOUT_MS )
+            {
+                /* No data yet; try again. */
+            }
+            else if( parsedLength == 0U )
+            {
+                LogError( ( "Timed out waiting for a pipelined response." ) );
+                status = HTTPNoResponse;
+            }
+            else
+            {
+                /* A response without length ends when the server closes the
+                 * connection. Tell the parser that no more data comes. */
+                ( void ) http_parser_execute( &parser, &settings, NULL, 0U );
+
+                if( context.complete == false )
+                {
+                    LogError( ( "Timed out receiving a pipelined response." ) );
+                    status = HTTPPartialResponse;
+                }
+                else
+                {
+                    pResponse->respFlags = HTTP_RESPONSE_CONNECTION_CLOSE_FLAG;
+                }
+            }
+        }
+    }
+
+    if( status == HTTPSuccess )
+    {
+        pPipeline->responseLength = parsedLength;
+        pPipeline->pendingCount--;
+        pResponse->bufferLen = parsedLength;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+HTTPStatus_t HttpPipeline_Receive( HttpPipeline_t * pPipeline,
+                                   HTTPResponse_t * pResponse )
+{
+    return receiveResponse( pPipeline, pResponse, NULL, NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+HTTPStatus_t HttpPipeline_ReceiveStreamed( HttpPipeline_t * pPipeline,
+                                           HTTPResponse_t * pResponse,
+                                           HttpPipelineBodyCallback_t bodyCallback,
+                                           void * pCallbackContext )
+{
+    HTTPStatus_t status = HTTPSuccess;
+
+    if( bodyCallback == NULL )
+    {
+        LogError( ( "Invalid parameter to receive a streamed response." ) );
+        status = HTTPInvalidParameter;
+    }
+    else
+    {
+        status = receiveResponse( pPipeline, pResponse, bodyCallback, pCallbackContext );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
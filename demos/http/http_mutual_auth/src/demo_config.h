@@ -178,6 +178,11 @@
  */
 #define USER_BUFFER_LENGTH                ( 2048 )
 
+/**
+ * @brief The length in bytes of the buffer of the request headers.
+ */
+#define REQUEST_BUFFER_LENGTH             ( 256 )
+
 /**
  * @brief Request body to send for PUT and POST requests in this demo.
  */
@@ -44,6 +44,11 @@
 /* Wifi connection for ESP32 */
 #include "esp_wifi_wrapper.h"
 
+#if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+    /* Network buffers shared with the other clients. */
+    #include "network_buffer_pool.h"
+#endif
+
 /* Check that AWS IoT Core endpoint is defined. */
 #ifndef AWS_IOT_ENDPOINT
     #error "AWS_IOT_ENDPOINT must be defined to your AWS IoT Core endpoint."
@@ -99,6 +104,11 @@
     #define USER_BUFFER_LENGTH    ( 2048 )
 #endif
 
+/* Check that size of the request buffer is defined. */
+#ifndef REQUEST_BUFFER_LENGTH
+    #define REQUEST_BUFFER_LENGTH    ( 256 )
+#endif
+
 /* Check that a request body to send for the POST request is defined. */
 #ifndef REQUEST_BODY
     #error "Please define a REQUEST_BODY."
@@ -124,15 +134,24 @@
  */
 #define REQUEST_BODY_LENGTH        ( sizeof( REQUEST_BODY ) - 1 )
 
+#if !defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+
 /**
- * @brief A buffer used in the demo for storing HTTP request headers and
- * HTTP response headers and body.
+ * @brief A buffer used in the demo for storing HTTP response headers and
+ * body. With the shared pool, it is taken from the pool for each request
+ * instead.
+ */
+    static uint8_t userBuffer[ USER_BUFFER_LENGTH ];
+#endif
+
+/**
+ * @brief A buffer used in the demo for storing HTTP request headers.
  *
- * @note This demo shows how the same buffer can be re-used for storing the HTTP
- * response after the HTTP request is sent out. However, the user can also
- * decide to use separate buffers for storing the HTTP request and response.
+ * @note The request keeps its own buffer rather than sharing the response
+ * buffer, so a request that failed before its response was received can be
+ * sent again on a new connection.
  */
-static uint8_t userBuffer[ USER_BUFFER_LENGTH ];
+static uint8_t requestBuffer[ REQUEST_BUFFER_LENGTH ];
 
 /*-----------------------------------------------------------*/
 
@@ -230,7 +249,8 @@ static int32_t connectToServer( NetworkContext_t * pNetworkContext )
                                          &serverInfo,
                                          &networkCredentials,
                                          TRANSPORT_SEND_RECV_TIMEOUT_MS,
-                                         TRANSPORT_SEND_RECV_TIMEOUT_MS );
+                                         TRANSPORT_SEND_RECV_TIMEOUT_MS,
+                                         NULL );
 
     if( tlsTranportStatus == TLS_TRANSPORT_SUCCESS )
     {
@@ -287,17 +307,24 @@ static int32_t sendHttpRequest( const TransportInterface_t * pTransportInterface
     requestInfo.reqFlags = HTTP_REQUEST_KEEP_ALIVE_FLAG;
 
     /* Set the buffer used for storing request headers. */
-    requestHeaders.pBuffer = userBuffer;
-    requestHeaders.bufferLen = USER_BUFFER_LENGTH;
+    requestHeaders.pBuffer = requestBuffer;
+    requestHeaders.bufferLen = REQUEST_BUFFER_LENGTH;
 
     httpStatus = HTTPClient_InitializeRequestHeaders( &requestHeaders,
                                                       &requestInfo );
 
     if( httpStatus == HTTPSuccess )
     {
-        /* Initialize the response object. The same buffer used for storing
-         * request headers is reused here. */
-        response.pBuffer = userBuffer;
+        /* Initialize the response object, in its own buffer. With the shared
+         * pool, it is only held for this request, and HTTPClient_Send() fails
+         * without one. */
+        #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+            response.pBuffer = NetworkBufferPool_Alloc( "http",
+                                                        USER_BUFFER_LENGTH,
+                                                        CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_WAIT_MS );
+        #else
+            response.pBuffer = userBuffer;
+        #endif
         response.bufferLen = USER_BUFFER_LENGTH;
         response.getTime = Clock_GetTimeMs;
 
@@ -346,6 +373,10 @@ static int32_t sendHttpRequest( const TransportInterface_t * pTransportInterface
                     HTTPClient_strerror( httpStatus ) ) );
     }
 
+    #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+        NetworkBufferPool_Free( response.pBuffer );
+    #endif
+
     if( httpStatus != HTTPSuccess )
     {
         returnStatus = EXIT_FAILURE;
@@ -364,7 +395,7 @@ static int start_mutual_auth_demo()
     TransportInterface_t transportInterface;
     /* The network context for the transport layer interface. */
     NetworkContext_t networkContext;
-    TlsTransportParams_t tlsTransportParams;
+    TlsTransportParams_t tlsTransportParams = { 0 };
 
     /* Set the pParams member of the network context with desired transport. */
     networkContext.pParams = &tlsTransportParams;
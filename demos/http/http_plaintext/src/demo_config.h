@@ -87,11 +87,45 @@
  */
 #define USER_BUFFER_LENGTH                ( 1024 )
 
+/**
+ * @brief The length in bytes of the buffer of the request headers.
+ */
+#define REQUEST_BUFFER_LENGTH             ( 256 )
+
+/**
+ * @brief Number of GET requests sent before reading their responses, after
+ * the requests of each method. Set it to 0 not to pipeline requests.
+ */
+#define PIPELINED_REQUEST_COUNT           ( 3U )
+
+/**
+ * @brief Path of a GET request whose response is streamed, with a body larger
+ * than USER_BUFFER_LENGTH. Remove it not to stream a response.
+ */
+#define STREAM_PATH                       "/stream-bytes/8192"
+
 /**
  * @brief Request body to send for PUT and POST requests in this demo.
  */
 #define REQUEST_BODY                      "Hello, world!"
 
+/**
+ * @brief Path of an object downloaded in ranges into a flash area before the
+ * requests of the demo, with CONFIG_AWS_IOT_HTTP_FLASH_DOWNLOAD enabled in
+ * prj.conf along with CONFIG_FLASH and CONFIG_FLASH_MAP.
+ *
+ * @note The httpbin "/range" endpoint serves objects of any size that support
+ * range requests.
+ *
+ * #define DOWNLOAD_PATH                  "/range/16384"
+ */
+
+/**
+ * @brief Flash area receiving the downloaded object.
+ *
+ * #define DOWNLOAD_FLASH_AREA_ID         FLASH_AREA_ID( storage )
+ */
+
 /**
  * @brief The name of the Wi-Fi network to join.
  *
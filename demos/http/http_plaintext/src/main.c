@@ -32,6 +32,17 @@
 /* Common HTTP demo utilities. */
 #include "http_demo_utils.h"
 
+/* Pool of kept-alive HTTP connections. */
+#include "http_connection_pool.h"
+
+/* Pipelining of HTTP requests. */
+#include "http_pipeline.h"
+
+/* Ranged download to flash, for the optional download of the demo. */
+#ifdef DOWNLOAD_PATH
+    #include "http_flash_download.h"
+#endif
+
 /* HTTP API header. */
 #include "core_http_client.h"
 
@@ -44,6 +55,11 @@
 /* Wifi connection for ESP32 */
 #include "esp_wifi_wrapper.h"
 
+#if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+    /* Network buffers shared with the other clients. */
+    #include "network_buffer_pool.h"
+#endif
+
 /* Check that hostname of the server is defined. */
 #ifndef SERVER_HOST
     #error "Please define a SERVER_HOST."
@@ -74,6 +90,11 @@
     #error "Please define a POST_PATH."
 #endif
 
+/* Check that the download of DOWNLOAD_PATH is built. */
+#if defined( DOWNLOAD_PATH ) && !defined( CONFIG_AWS_IOT_HTTP_FLASH_DOWNLOAD )
+    #error "Please enable CONFIG_AWS_IOT_HTTP_FLASH_DOWNLOAD to download DOWNLOAD_PATH."
+#endif
+
 /* Check that Wifi SSID and password are defined. */
 #ifndef WIFI_NETWORK_SSID
     #error "Please define the wifi network ssid, in demo_config.h."
@@ -97,6 +118,22 @@
     #define USER_BUFFER_LENGTH    ( 1024 )
 #endif
 
+/* Check that size of the request buffer is defined. */
+#ifndef REQUEST_BUFFER_LENGTH
+    #define REQUEST_BUFFER_LENGTH    ( 256 )
+#endif
+
+/* Check that the number of pipelined GET requests is defined. */
+#ifndef PIPELINED_REQUEST_COUNT
+    #define PIPELINED_REQUEST_COUNT    ( 3U )
+#endif
+
+/* Check that the idle time of the pooled connection is defined. Keep it above
+ * DEMO_LOOP_DELAY_SECONDS for the connection to be reused across iterations. */
+#ifndef HTTP_POOL_MAX_IDLE_MS
+    #define HTTP_POOL_MAX_IDLE_MS    HTTP_POOL_DEFAULT_MAX_IDLE_MS
+#endif
+
 /**
  * @brief The length of the HTTP server host name.
  */
@@ -142,6 +179,14 @@
  */
 #define POST_PATH_LENGTH           ( sizeof( POST_PATH ) - 1 )
 
+#ifdef STREAM_PATH
+
+/**
+ * @brief The length of the path of the streamed GET request.
+ */
+    #define STREAM_PATH_LENGTH    ( sizeof( STREAM_PATH ) - 1 )
+#endif
+
 /**
  * @brief Length of the request body.
  */
@@ -170,15 +215,79 @@ typedef struct httpMethodStrings
     size_t httpMethodLength;
 } httpMethodStrings_t;
 
+#if !defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+
+/**
+ * @brief A buffer used in the demo for storing HTTP response headers and
+ * body. With the shared pool, it is taken from the pool for each request
+ * instead.
+ */
+    static uint8_t userBuffer[ USER_BUFFER_LENGTH ];
+#endif
+
 /**
- * @brief A buffer used in the demo for storing HTTP request headers and
- * HTTP response headers and body.
+ * @brief A buffer used in the demo for storing HTTP request headers.
  *
- * @note This demo shows how the same buffer can be re-used for storing the HTTP
- * response after the HTTP request is sent out. However, the user can also
- * decide to use separate buffers for storing the HTTP request and response.
+ * @note The request keeps its own buffer rather than sharing the response
+ * buffer, so a request that failed before its response was received can be
+ * sent again on a new connection.
+ */
+static uint8_t requestBuffer[ REQUEST_BUFFER_LENGTH ];
+
+/**
+ * @brief The connection to the HTTP server, kept open across requests and
+ * iterations of the demo.
+ */
+static HttpPoolConnection_t poolConnections[ 1 ];
+
+/**
+ * @brief The pool of the connection to the HTTP server.
  */
-static uint8_t userBuffer[ USER_BUFFER_LENGTH ];
+static HttpPool_t httpPool;
+
+#ifdef DOWNLOAD_PATH
+
+/* Check that the flash area receiving the download is defined. */
+    #ifndef DOWNLOAD_FLASH_AREA_ID
+        #define DOWNLOAD_FLASH_AREA_ID    FLASH_AREA_ID( storage )
+    #endif
+
+/**
+ * @brief The length of the path of the downloaded object.
+ */
+    #define DOWNLOAD_PATH_LENGTH          ( sizeof( DOWNLOAD_PATH ) - 1 )
+
+/**
+ * @brief The length of each download buffer, holding the headers and a
+ * 2 KB range of a response.
+ */
+    #define DOWNLOAD_BUFFER_LENGTH        ( HTTP_DOWNLOAD_RESPONSE_HEADERS_MAX + 2048U )
+
+/**
+ * @brief Stack size and priority of the work queue writing the download to
+ * flash.
+ */
+    #define DOWNLOAD_WRITE_STACK_SIZE     ( 1024 )
+    #define DOWNLOAD_WRITE_PRIORITY       K_PRIO_PREEMPT( 1 )
+
+/**
+ * @brief The two buffers of the download, one receiving a range while the
+ * other is written to flash.
+ */
+    static uint8_t downloadBuffers[ 2 ][ DOWNLOAD_BUFFER_LENGTH ];
+
+/**
+ * @brief The work queue writing the download to flash, and its stack.
+ */
+    static struct k_work_q downloadWriteQueue;
+    K_THREAD_STACK_DEFINE( downloadWriteStack, DOWNLOAD_WRITE_STACK_SIZE );
+
+/**
+ * @brief The state of the download.
+ */
+    static HttpDownload_t download;
+
+#endif /* ifdef DOWNLOAD_PATH */
 
 /*-----------------------------------------------------------*/
 
@@ -190,6 +299,21 @@ struct NetworkContext
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Get the buffer of #USER_BUFFER_LENGTH bytes receiving a response,
+ * from the shared pool if it is used.
+ *
+ * @return The buffer, or NULL if the pool has none free in time.
+ */
+static uint8_t * takeUserBuffer( void );
+
+/**
+ * @brief Return a buffer of takeUserBuffer() once its response is processed.
+ *
+ * @param[in] pBuffer The buffer, or NULL.
+ */
+static void releaseUserBuffer( uint8_t * pBuffer );
+
 /**
  * @brief Connect to HTTP server with reconnection retries.
  *
@@ -199,11 +323,37 @@ struct NetworkContext
  */
 static int32_t connectToServer( NetworkContext_t * pNetworkContext );
 
+/**
+ * @brief Connect a connection of the pool to the HTTP server, with
+ * reconnection retries.
+ *
+ * @param[in] pNetworkContext The network context of the connection.
+ * @param[in] pHost Host name of the server, which is always #SERVER_HOST.
+ * @param[in] hostLength Length of @p pHost.
+ * @param[in] port Port of the server, which is always #HTTP_PORT.
+ *
+ * @return EXIT_FAILURE on failure; EXIT_SUCCESS on successful connection.
+ */
+static int32_t connectPooledConnection( NetworkContext_t * pNetworkContext,
+                                        const char * pHost,
+                                        size_t hostLength,
+                                        uint16_t port );
+
+/**
+ * @brief Disconnect a connection of the pool from the HTTP server.
+ *
+ * @param[in] pNetworkContext The network context of the connection.
+ */
+static void disconnectPooledConnection( NetworkContext_t * pNetworkContext );
+
 /**
  * @brief Send an HTTP request based on a specified method and path, then
  * print the response received from the server.
  *
- * @param[in] pTransportInterface The transport interface for making network calls.
+ * The request is sent on the connection of the pool to the server, which
+ * stays open for the next requests.
+ *
+ * @param[in] pPool The pool of the connection to the HTTP server.
  * @param[in] pMethod The HTTP request method.
  * @param[in] methodLen The length of the HTTP request method.
  * @param[in] pPath The Request-URI to the objects of interest.
@@ -211,12 +361,89 @@ static int32_t connectToServer( NetworkContext_t * pNetworkContext );
  *
  * @return EXIT_FAILURE on failure; EXIT_SUCCESS on success.
  */
-static int32_t sendHttpRequest( const TransportInterface_t * pTransportInterface,
+static int32_t sendHttpRequest( HttpPool_t * pPool,
                                 const char * pMethod,
                                 size_t methodLen,
                                 const char * pPath,
                                 size_t pathLen );
 
+#ifdef DOWNLOAD_PATH
+
+/**
+ * @brief Download #DOWNLOAD_PATH into the flash area #DOWNLOAD_FLASH_AREA_ID
+ * on the connection of the pool, and log the throughput.
+ *
+ * @param[in] pPool The pool of the connection to the HTTP server.
+ *
+ * @return EXIT_FAILURE on failure; EXIT_SUCCESS on success.
+ */
+    static int32_t downloadToFlash( HttpPool_t * pPool );
+#endif
+
+#if ( PIPELINED_REQUEST_COUNT > 0 )
+
+/**
+ * @brief Send #PIPELINED_REQUEST_COUNT GET requests of a path on the
+ * connection of the pool before reading their responses, which then arrive
+ * within a single round trip.
+ *
+ * The requests are sent again once on a new connection if the server had
+ * closed the reused connection before answering any of them.
+ *
+ * @param[in] pPool The pool of the connection to the HTTP server.
+ * @param[in] pPath The Request-URI of the GET requests.
+ * @param[in] pathLen The length of the Request-URI.
+ *
+ * @return EXIT_FAILURE on failure; EXIT_SUCCESS on success.
+ */
+    static int32_t sendPipelinedRequests( HttpPool_t * pPool,
+                                          const char * pPath,
+                                          size_t pathLen );
+#endif
+
+#ifdef STREAM_PATH
+
+/**
+ * @brief State of a streamed response body: its length and an additive
+ * checksum of its bytes.
+ */
+    typedef struct streamedBody
+    {
+        size_t length;
+        uint32_t checksum;
+    } streamedBody_t;
+
+/**
+ * @brief Body callback of the streamed response, which adds a part of the
+ * body to its length and checksum.
+ *
+ * @param[in] pContext The #streamedBody_t of the response.
+ * @param[in] pResponse The response.
+ * @param[in] pData Part of the body.
+ * @param[in] length Length of @p pData.
+ *
+ * @return true, to receive the whole body.
+ */
+    static bool onStreamedBody( void * pContext,
+                                const HTTPResponse_t * pResponse,
+                                const uint8_t * pData,
+                                size_t length );
+
+/**
+ * @brief Send a GET request of a path on the connection of the pool and
+ * stream its response, whose body can be larger than #USER_BUFFER_LENGTH.
+ *
+ * @param[in] pPool The pool of the connection to the HTTP server.
+ * @param[in] pPath The Request-URI of the GET request.
+ * @param[in] pathLen The length of the Request-URI.
+ *
+ * @return EXIT_FAILURE on failure; EXIT_SUCCESS on success.
+ */
+    static int32_t sendStreamedRequest( HttpPool_t * pPool,
+                                        const char * pPath,
+                                        size_t pathLen );
+#endif
+
 /**
  * @brief Entry point of demo.
  *
@@ -233,6 +460,30 @@ static int start_plaintext_demo();
 
 /*-----------------------------------------------------------*/
 
+static uint8_t * takeUserBuffer( void )
+{
+    #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+        return NetworkBufferPool_Alloc( "http",
+                                        USER_BUFFER_LENGTH,
+                                        CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_WAIT_MS );
+    #else
+        return userBuffer;
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+static void releaseUserBuffer( uint8_t * pBuffer )
+{
+    #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+        NetworkBufferPool_Free( pBuffer );
+    #else
+        ( void ) pBuffer;
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
 static int32_t connectToServer( NetworkContext_t * pNetworkContext )
 {
     int32_t returnStatus = EXIT_FAILURE;
@@ -256,7 +507,8 @@ static int32_t connectToServer( NetworkContext_t * pNetworkContext )
     socketStatus = Plaintext_Connect( pNetworkContext,
                                       &serverInfo,
                                       TRANSPORT_SEND_RECV_TIMEOUT_MS,
-                                      TRANSPORT_SEND_RECV_TIMEOUT_MS );
+                                      TRANSPORT_SEND_RECV_TIMEOUT_MS,
+                                      NULL );
 
     if( socketStatus == SOCKETS_SUCCESS )
     {
@@ -272,7 +524,36 @@ static int32_t connectToServer( NetworkContext_t * pNetworkContext )
 
 /*-----------------------------------------------------------*/
 
-static int32_t sendHttpRequest( const TransportInterface_t * pTransportInterface,
+static int32_t connectPooledConnection( NetworkContext_t * pNetworkContext,
+                                        const char * pHost,
+                                        size_t hostLength,
+                                        uint16_t port )
+{
+    /* The demo only connects to the server of demo_config.h. */
+    ( void ) pHost;
+    ( void ) hostLength;
+    ( void ) port;
+
+    /* Attempt to connect to the HTTP server. If connection fails, retry after
+     * a timeout. Timeout value will be exponentially increased till the maximum
+     * attempts are reached or maximum timeout value is reached. The function
+     * returns EXIT_FAILURE if the TCP connection cannot be established to
+     * broker after configured number of attempts. */
+    return connectToServerWithBackoffRetries( connectToServer,
+                                              pNetworkContext );
+}
+
+/*-----------------------------------------------------------*/
+
+static void disconnectPooledConnection( NetworkContext_t * pNetworkContext )
+{
+    /* Close TCP connection. */
+    ( void ) Plaintext_Disconnect( pNetworkContext );
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t sendHttpRequest( HttpPool_t * pPool,
                                 const char * pMethod,
                                 size_t methodLen,
                                 const char * pPath,
@@ -313,8 +594,8 @@ static int32_t sendHttpRequest( const TransportInterface_t * pTransportInterface
     requestInfo.reqFlags = HTTP_REQUEST_KEEP_ALIVE_FLAG;
 
     /* Set the buffer used for storing request headers. */
-    requestHeaders.pBuffer = userBuffer;
-    requestHeaders.bufferLen = USER_BUFFER_LENGTH;
+    requestHeaders.pBuffer = requestBuffer;
+    requestHeaders.bufferLen = REQUEST_BUFFER_LENGTH;
     response.getTime = Clock_GetTimeMs;
 
     httpStatus = HTTPClient_InitializeRequestHeaders( &requestHeaders,
@@ -322,9 +603,9 @@ static int32_t sendHttpRequest( const TransportInterface_t * pTransportInterface
 
     if( httpStatus == HTTPSuccess )
     {
-        /* Initialize the response object. The same buffer used for storing
-         * request headers is reused here. */
-        response.pBuffer = userBuffer;
+        /* Initialize the response object, in its own buffer. HttpPool_Send()
+         * fails without one. */
+        response.pBuffer = takeUserBuffer();
         response.bufferLen = USER_BUFFER_LENGTH;
 
         LogInfo( ( "Sending HTTP %.*s request to %.*s%.*s...",
@@ -337,13 +618,17 @@ static int32_t sendHttpRequest( const TransportInterface_t * pTransportInterface
                     ( char * ) requestHeaders.pBuffer,
                     ( int32_t ) REQUEST_BODY_LENGTH, REQUEST_BODY ) );
 
-        /* Send the request and receive the response. */
-        httpStatus = HTTPClient_Send( pTransportInterface,
-                                      &requestHeaders,
-                                      ( uint8_t * ) REQUEST_BODY,
-                                      REQUEST_BODY_LENGTH,
-                                      &response,
-                                      0 );
+        /* Send the request and receive the response, on the open connection
+         * to the server if there is one. */
+        httpStatus = HttpPool_Send( pPool,
+                                    SERVER_HOST,
+                                    SERVER_HOST_LENGTH,
+                                    HTTP_PORT,
+                                    &requestHeaders,
+                                    ( uint8_t * ) REQUEST_BODY,
+                                    REQUEST_BODY_LENGTH,
+                                    &response,
+                                    0 );
     }
     else
     {
@@ -375,6 +660,8 @@ static int32_t sendHttpRequest( const TransportInterface_t * pTransportInterface
                     HTTPClient_strerror( httpStatus ) ) );
     }
 
+    releaseUserBuffer( response.pBuffer );
+
     if( httpStatus != HTTPSuccess )
     {
         returnStatus = EXIT_FAILURE;
@@ -385,15 +672,375 @@ static int32_t sendHttpRequest( const TransportInterface_t * pTransportInterface
 
 /*-----------------------------------------------------------*/
 
+#if ( PIPELINED_REQUEST_COUNT > 0 )
+
+    static int32_t sendPipelinedRequests( HttpPool_t * pPool,
+                                          const char * pPath,
+                                          size_t pathLen )
+    {
+        int32_t returnStatus = EXIT_SUCCESS;
+        HTTPRequestInfo_t requestInfo;
+        HTTPRequestHeaders_t requestHeaders;
+        HTTPResponse_t response;
+        HttpPipeline_t pipeline;
+        HttpPoolConnection_t * pConnection = NULL;
+        HTTPStatus_t httpStatus = HTTPSuccess;
+        uint8_t * pUserBuffer = NULL;
+        bool reused = false;
+        bool retry = true;
+        size_t sentCount = 0U;
+        size_t receivedCount = 0U;
+        uint32_t startTimeMs = 0U;
+
+        ( void ) memset( &requestInfo, 0, sizeof( requestInfo ) );
+        ( void ) memset( &requestHeaders, 0, sizeof( requestHeaders ) );
+        ( void ) memset( &response, 0, sizeof( response ) );
+
+        requestInfo.pHost = SERVER_HOST;
+        requestInfo.hostLen = SERVER_HOST_LENGTH;
+        requestInfo.pMethod = HTTP_METHOD_GET;
+        requestInfo.methodLen = HTTP_METHOD_GET_LENGTH;
+        requestInfo.pPath = pPath;
+        requestInfo.pathLen = pathLen;
+        requestInfo.reqFlags = HTTP_REQUEST_KEEP_ALIVE_FLAG;
+
+        /* The requests are identical, so their headers are built once. */
+        requestHeaders.pBuffer = requestBuffer;
+        requestHeaders.bufferLen = REQUEST_BUFFER_LENGTH;
+
+        httpStatus = HTTPClient_InitializeRequestHeaders( &requestHeaders,
+                                                          &requestInfo );
+
+        if( httpStatus == HTTPSuccess )
+        {
+            pUserBuffer = takeUserBuffer();
+            httpStatus = ( pUserBuffer != NULL ) ? HTTPSuccess : HTTPInsufficientMemory;
+        }
+
+        while( ( httpStatus == HTTPSuccess ) && ( retry == true ) )
+        {
+            pConnection = NULL;
+            sentCount = 0U;
+            receivedCount = 0U;
+
+            if( HttpPool_Acquire( pPool, SERVER_HOST, SERVER_HOST_LENGTH, HTTP_PORT,
+                                  &pConnection, &reused ) != HTTP_POOL_SUCCESS )
+            {
+                httpStatus = HTTPNetworkError;
+            }
+            else
+            {
+                httpStatus = HttpPipeline_Init( &pipeline,
+                                                &pConnection->transport,
+                                                pUserBuffer,
+                                                USER_BUFFER_LENGTH,
+                                                Clock_GetTimeMs );
+            }
+
+            LogInfo( ( "Sending %u pipelined HTTP GET requests to %.*s%.*s...",
+                       ( unsigned int ) PIPELINED_REQUEST_COUNT,
+                       ( int32_t ) SERVER_HOST_LENGTH, SERVER_HOST,
+                       ( int32_t ) pathLen, pPath ) );
+            startTimeMs = Clock_GetTimeMs();
+
+            /* Write all the requests before reading any response. */
+            while( ( httpStatus == HTTPSuccess ) && ( sentCount < PIPELINED_REQUEST_COUNT ) )
+            {
+                httpStatus = HttpPipeline_Send( &pipeline, &requestHeaders );
+
+                if( httpStatus == HTTPSuccess )
+                {
+                    sentCount++;
+                }
+            }
+
+            /* The responses come back in the order of the requests. */
+            while( ( httpStatus == HTTPSuccess ) && ( receivedCount < sentCount ) )
+            {
+                httpStatus = HttpPipeline_Receive( &pipeline, &response );
+
+                if( httpStatus == HTTPSuccess )
+                {
+                    receivedCount++;
+                    LogInfo( ( "Received pipelined response %lu: Status=%u, BodyLength=%lu.",
+                               ( unsigned long ) receivedCount,
+                               ( unsigned int ) response.statusCode,
+                               ( unsigned long ) response.bodyLen ) );
+                }
+            }
+
+            if( pConnection != NULL )
+            {
+                HttpPool_Release( pPool,
+                                  pConnection,
+                                  ( httpStatus == HTTPSuccess ) &&
+                                  ( ( response.respFlags & HTTP_RESPONSE_CONNECTION_CLOSE_FLAG ) == 0U ) );
+            }
+
+            /* A reused connection the server has closed answers none of the
+             * requests. */
+            retry = ( reused == true ) && ( receivedCount == 0U ) &&
+                    ( ( httpStatus == HTTPNoResponse ) || ( httpStatus == HTTPNetworkError ) );
+
+            if( retry == true )
+            {
+                LogWarn( ( "Sending the pipelined requests again on a new connection." ) );
+                httpStatus = HTTPSuccess;
+            }
+        }
+
+        if( httpStatus == HTTPSuccess )
+        {
+            LogInfo( ( "Received %lu pipelined responses in %lu ms.",
+                       ( unsigned long ) receivedCount,
+                       ( unsigned long ) ( Clock_GetTimeMs() - startTimeMs ) ) );
+        }
+        else
+        {
+            LogError( ( "Failed to send pipelined HTTP GET requests to %.*s%.*s: Error=%s.",
+                        ( int32_t ) SERVER_HOST_LENGTH, SERVER_HOST,
+                        ( int32_t ) pathLen, pPath,
+                        HTTPClient_strerror( httpStatus ) ) );
+            returnStatus = EXIT_FAILURE;
+        }
+
+        releaseUserBuffer( pUserBuffer );
+
+        return returnStatus;
+    }
+
+#endif /* if ( PIPELINED_REQUEST_COUNT > 0 ) */
+
+/*-----------------------------------------------------------*/
+
+#ifdef STREAM_PATH
+
+    static bool onStreamedBody( void * pContext,
+                                const HTTPResponse_t * pResponse,
+                                const uint8_t * pData,
+                                size_t length )
+    {
+        streamedBody_t * pBody = ( streamedBody_t * ) pContext;
+        size_t i = 0U;
+
+        ( void ) pResponse;
+
+        for( i = 0U; i < length; i++ )
+        {
+            pBody->checksum += pData[ i ];
+        }
+
+        pBody->length += length;
+
+        return true;
+    }
+
+    /*-----------------------------------------------------------*/
+
+    static int32_t sendStreamedRequest( HttpPool_t * pPool,
+                                        const char * pPath,
+                                        size_t pathLen )
+    {
+        int32_t returnStatus = EXIT_SUCCESS;
+        HTTPRequestInfo_t requestInfo;
+        HTTPRequestHeaders_t requestHeaders;
+        HTTPResponse_t response;
+        HttpPipeline_t pipeline;
+        HttpPoolConnection_t * pConnection = NULL;
+        HTTPStatus_t httpStatus = HTTPSuccess;
+        uint8_t * pUserBuffer = NULL;
+        streamedBody_t body = { 0 };
+        bool reused = false;
+        bool retry = true;
+
+        ( void ) memset( &requestInfo, 0, sizeof( requestInfo ) );
+        ( void ) memset( &requestHeaders, 0, sizeof( requestHeaders ) );
+        ( void ) memset( &response, 0, sizeof( response ) );
+
+        requestInfo.pHost = SERVER_HOST;
+        requestInfo.hostLen = SERVER_HOST_LENGTH;
+        requestInfo.pMethod = HTTP_METHOD_GET;
+        requestInfo.methodLen = HTTP_METHOD_GET_LENGTH;
+        requestInfo.pPath = pPath;
+        requestInfo.pathLen = pathLen;
+        requestInfo.reqFlags = HTTP_REQUEST_KEEP_ALIVE_FLAG;
+
+        requestHeaders.pBuffer = requestBuffer;
+        requestHeaders.bufferLen = REQUEST_BUFFER_LENGTH;
+
+        httpStatus = HTTPClient_InitializeRequestHeaders( &requestHeaders,
+                                                          &requestInfo );
+
+        if( httpStatus == HTTPSuccess )
+        {
+            pUserBuffer = takeUserBuffer();
+            httpStatus = ( pUserBuffer != NULL ) ? HTTPSuccess : HTTPInsufficientMemory;
+        }
+
+        while( ( httpStatus == HTTPSuccess ) && ( retry == true ) )
+        {
+            pConnection = NULL;
+            ( void ) memset( &body, 0, sizeof( body ) );
+
+            if( HttpPool_Acquire( pPool, SERVER_HOST, SERVER_HOST_LENGTH, HTTP_PORT,
+                                  &pConnection, &reused ) != HTTP_POOL_SUCCESS )
+            {
+                httpStatus = HTTPNetworkError;
+            }
+            else
+            {
+                /* The buffer only holds the response headers; the body goes to
+                 * the callback as it is received. */
+                httpStatus = HttpPipeline_Init( &pipeline,
+                                                &pConnection->transport,
+                                                pUserBuffer,
+                                                USER_BUFFER_LENGTH,
+                                                Clock_GetTimeMs );
+            }
+
+            if( httpStatus == HTTPSuccess )
+            {
+                LogInfo( ( "Sending HTTP GET request to %.*s%.*s, streaming its response...",
+                           ( int32_t ) SERVER_HOST_LENGTH, SERVER_HOST,
+                           ( int32_t ) pathLen, pPath ) );
+                httpStatus = HttpPipeline_Send( &pipeline, &requestHeaders );
+            }
+
+            if( httpStatus == HTTPSuccess )
+            {
+                httpStatus = HttpPipeline_ReceiveStreamed( &pipeline,
+                                                           &response,
+                                                           onStreamedBody,
+                                                           &body );
+            }
+
+            if( pConnection != NULL )
+            {
+                HttpPool_Release( pPool,
+                                  pConnection,
+                                  ( httpStatus == HTTPSuccess ) &&
+                                  ( ( response.respFlags & HTTP_RESPONSE_CONNECTION_CLOSE_FLAG ) == 0U ) );
+            }
+
+            /* A reused connection the server has closed does not answer. */
+            retry = ( reused == true ) && ( body.length == 0U ) &&
+                    ( ( httpStatus == HTTPNoResponse ) || ( httpStatus == HTTPNetworkError ) );
+
+            if( retry == true )
+            {
+                LogWarn( ( "Sending the streamed request again on a new connection." ) );
+                httpStatus = HTTPSuccess;
+            }
+        }
+
+        if( httpStatus == HTTPSuccess )
+        {
+            LogInfo( ( "Received streamed response: Status=%u, BodyLength=%lu, Checksum=0x%08lx.",
+                       ( unsigned int ) response.statusCode,
+                       ( unsigned long ) body.length,
+                       ( unsigned long ) body.checksum ) );
+        }
+        else
+        {
+            LogError( ( "Failed to stream HTTP GET response of %.*s%.*s: Error=%s.",
+                        ( int32_t ) SERVER_HOST_LENGTH, SERVER_HOST,
+                        ( int32_t ) pathLen, pPath,
+                        HTTPClient_strerror( httpStatus ) ) );
+            returnStatus = EXIT_FAILURE;
+        }
+
+        releaseUserBuffer( pUserBuffer );
+
+        return returnStatus;
+    }
+
+#endif /* ifdef STREAM_PATH */
+
+/*-----------------------------------------------------------*/
+
+#ifdef DOWNLOAD_PATH
+
+    static int32_t downloadToFlash( HttpPool_t * pPool )
+    {
+        int32_t returnStatus = EXIT_SUCCESS;
+        const struct flash_area * pFlashArea = NULL;
+        HttpDownloadStatus_t downloadStatus = HTTP_DOWNLOAD_SUCCESS;
+        uint32_t startTimeMs = 0U;
+        uint32_t elapsedMs = 0U;
+
+        if( flash_area_open( DOWNLOAD_FLASH_AREA_ID, &pFlashArea ) != 0 )
+        {
+            LogError( ( "Failed to open the flash area of the download." ) );
+            returnStatus = EXIT_FAILURE;
+        }
+        else
+        {
+            k_work_queue_init( &downloadWriteQueue );
+            k_work_queue_start( &downloadWriteQueue,
+                                downloadWriteStack,
+                                K_THREAD_STACK_SIZEOF( downloadWriteStack ),
+                                DOWNLOAD_WRITE_PRIORITY,
+                                NULL );
+
+            downloadStatus = HttpDownload_Init( &download,
+                                                pPool,
+                                                SERVER_HOST,
+                                                SERVER_HOST_LENGTH,
+                                                HTTP_PORT,
+                                                DOWNLOAD_PATH,
+                                                DOWNLOAD_PATH_LENGTH,
+                                                pFlashArea,
+                                                &downloadWriteQueue,
+                                                downloadBuffers[ 0 ],
+                                                downloadBuffers[ 1 ],
+                                                DOWNLOAD_BUFFER_LENGTH,
+                                                0U );
+
+            if( downloadStatus == HTTP_DOWNLOAD_SUCCESS )
+            {
+                LogInfo( ( "Downloading %.*s%.*s to flash...",
+                           ( int32_t ) SERVER_HOST_LENGTH, SERVER_HOST,
+                           ( int32_t ) DOWNLOAD_PATH_LENGTH, DOWNLOAD_PATH ) );
+
+                startTimeMs = Clock_GetTimeMs();
+                downloadStatus = HttpDownload_Run( &download );
+                elapsedMs = Clock_GetTimeMs() - startTimeMs;
+            }
+
+            if( downloadStatus == HTTP_DOWNLOAD_SUCCESS )
+            {
+                LogInfo( ( "Downloaded %lu bytes in %lu ms: Throughput=%lu bytes/s.",
+                           ( unsigned long ) HttpDownload_GetObjectSize( &download ),
+                           ( unsigned long ) elapsedMs,
+                           ( unsigned long ) ( ( ( uint64_t ) HttpDownload_GetObjectSize( &download ) * 1000U ) /
+                                               ( ( elapsedMs != 0U ) ? elapsedMs : 1U ) ) ) );
+            }
+            else
+            {
+                LogError( ( "Failed to download %.*s: Status=%d, WrittenBytes=%lu.",
+                            ( int32_t ) DOWNLOAD_PATH_LENGTH, DOWNLOAD_PATH,
+                            ( int ) downloadStatus,
+                            ( unsigned long ) HttpDownload_GetWrittenOffset( &download ) ) );
+                returnStatus = EXIT_FAILURE;
+            }
+
+            flash_area_close( pFlashArea );
+        }
+
+        return returnStatus;
+    }
+
+#endif /* ifdef DOWNLOAD_PATH */
+
+/*-----------------------------------------------------------*/
+
 static int start_plaintext_demo()
 {
     /* Return value of main. */
     int32_t returnStatus = EXIT_SUCCESS;
-    /* The transport layer interface used by the HTTP Client library. */
-    TransportInterface_t transportInterface;
     /* The network context for the transport layer interface. */
     NetworkContext_t networkContext;
-    PlaintextParams_t plaintextParams;
+    PlaintextParams_t plaintextParams = { 0 };
     /* An array of HTTP paths to request. */
     const httpPathStrings_t httpMethodPaths[] =
     {
@@ -414,49 +1061,45 @@ static int start_plaintext_demo()
     /* Set the pParams member of the network context with desired transport. */
     networkContext.pParams = &plaintextParams;
 
-    for( ; ; )
+    /* Define the transport interface of the pooled connection. The pool
+     * connects it when the first request is sent, and keeps it open. */
+    ( void ) memset( &poolConnections[ 0 ].transport, 0, sizeof( TransportInterface_t ) );
+    poolConnections[ 0 ].transport.recv = Plaintext_Recv;
+    poolConnections[ 0 ].transport.send = Plaintext_Send;
+    poolConnections[ 0 ].transport.pNetworkContext = &networkContext;
+
+    if( HttpPool_Init( &httpPool,
+                       poolConnections,
+                       sizeof( poolConnections ) / sizeof( poolConnections[ 0 ] ),
+                       connectPooledConnection,
+                       disconnectPooledConnection,
+                       HTTP_POOL_MAX_IDLE_MS ) != HTTP_POOL_SUCCESS )
     {
-        int i = 0;
-
-        /**************************** Connect. ******************************/
+        returnStatus = EXIT_FAILURE;
+    }
 
-        /* Establish TCP connection. */
+    #ifdef DOWNLOAD_PATH
+        /* Download the object before the requests, which then reuse its
+         * connection. */
         if( returnStatus == EXIT_SUCCESS )
         {
-            /* Attempt to connect to the HTTP server. If connection fails, retry after
-             * a timeout. Timeout value will be exponentially increased till the maximum
-             * attempts are reached or maximum timeout value is reached. The function
-             * returns EXIT_FAILURE if the TCP connection cannot be established to
-             * broker after configured number of attempts. */
-            returnStatus = connectToServerWithBackoffRetries( connectToServer,
-                                                              &networkContext );
-
-            if( returnStatus == EXIT_FAILURE )
-            {
-                /* Log error to indicate connection failure after all
-                 * reconnect attempts are over. */
-                LogError( ( "Failed to connect to HTTP server %.*s.",
-                            ( int32_t ) SERVER_HOST_LENGTH,
-                            SERVER_HOST ) );
-            }
+            returnStatus = downloadToFlash( &httpPool );
         }
+    #endif
 
-        /* Define the transport interface. */
-        if( returnStatus == EXIT_SUCCESS )
-        {
-            ( void ) memset( &transportInterface, 0, sizeof( transportInterface ) );
-            transportInterface.recv = Plaintext_Recv;
-            transportInterface.send = Plaintext_Send;
-            transportInterface.pNetworkContext = &networkContext;
-        }
+    for( ; ; )
+    {
+        int i = 0;
 
         /********************** Send HTTPS requests. ************************/
 
+        /* Each request reuses the connection of the previous one, or opens a
+         * new connection if the server closed it. */
         for( i = 0; i < NUMBER_HTTP_PATHS; i++ )
         {
             if( returnStatus == EXIT_SUCCESS )
             {
-                returnStatus = sendHttpRequest( &transportInterface,
+                returnStatus = sendHttpRequest( &httpPool,
                                                 httpMethods[ i ].httpMethod,
                                                 httpMethods[ i ].httpMethodLength,
                                                 httpMethodPaths[ i ].httpPath,
@@ -468,6 +1111,27 @@ static int start_plaintext_demo()
             }
         }
 
+        #if ( PIPELINED_REQUEST_COUNT > 0 )
+            /* GET requests without body can be sent again, so they can be
+             * pipelined. */
+            if( returnStatus == EXIT_SUCCESS )
+            {
+                returnStatus = sendPipelinedRequests( &httpPool,
+                                                      GET_PATH,
+                                                      GET_PATH_LENGTH );
+            }
+        #endif
+
+        #ifdef STREAM_PATH
+            /* The body of this response does not need to fit in the buffer. */
+            if( returnStatus == EXIT_SUCCESS )
+            {
+                returnStatus = sendStreamedRequest( &httpPool,
+                                                    STREAM_PATH,
+                                                    STREAM_PATH_LENGTH );
+            }
+        #endif
+
         if( returnStatus == EXIT_SUCCESS )
         {
             /* Log message indicating an iteration completed successfully. */
@@ -476,8 +1140,9 @@ static int start_plaintext_demo()
 
         /************************** Disconnect. *****************************/
 
-        /* Close TCP connection. */
-        ( void ) Plaintext_Disconnect( &networkContext );
+        /* The connection stays open for the next iteration, unless it has
+         * been idle for too long. */
+        ( void ) HttpPool_CloseIdle( &httpPool );
 
         LogInfo( ( "Short delay before starting the next iteration....\n" ) );
         k_sleep( K_SECONDS( DEMO_LOOP_DELAY_SECONDS ) );
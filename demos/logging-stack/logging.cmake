@@ -1,3 +1,17 @@
 # Configuration for logging.
 set( LOGGING_INCLUDE_DIRS
-     ${CMAKE_CURRENT_LIST_DIR} )
\ No newline at end of file
+     ${CMAKE_CURRENT_LIST_DIR} )
+
+# The Zephyr logging backend and the run-time levels are only built when
+# they are selected.
+set( LOGGING_SOURCES )
+
+if( CONFIG_AWS_IOT_LOG_ZEPHYR )
+    list( APPEND LOGGING_SOURCES
+          "${CMAKE_CURRENT_LIST_DIR}/logging_zephyr.c" )
+endif()
+
+if( CONFIG_AWS_IOT_LOG_RUNTIME_LEVELS )
+    list( APPEND LOGGING_SOURCES
+          "${CMAKE_CURRENT_LIST_DIR}/logging_runtime.c" )
+endif()
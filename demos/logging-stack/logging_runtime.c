@@ -0,0 +1,255 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file logging_runtime.c
+ * @brief Registry of the run-time log levels of the logging stack, and the
+ * "sdk_log" shell command changing them.
+ */
+
+/* Standard includes. */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Zephyr includes. */
+#include <kernel.h>
+
+#if defined( CONFIG_SHELL )
+    #include <shell/shell.h>
+#endif
+
+/* Logging configuration of this file. */
+#define LIBRARY_LOG_NAME     "LOGGING"
+#define LIBRARY_LOG_LEVEL    LOG_NONE
+
+#include "logging_stack.h"
+
+/**
+ * @brief A module of the registry.
+ */
+typedef struct SdkLogModule
+{
+    const char * pName;      /**< @brief The LIBRARY_LOG_NAME of the module. */
+    volatile uint8_t level;  /**< @brief The level of the messages logged. */
+} SdkLogModule_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The modules, in the order of their first log call.
+ */
+static SdkLogModule_t modules[ CONFIG_AWS_IOT_LOG_RUNTIME_MODULES ];
+
+/**
+ * @brief The number of entries of #modules in use.
+ */
+static size_t moduleCount = 0U;
+
+/**
+ * @brief The level of the modules added from now on, and of those that did
+ * not fit in #modules.
+ */
+static volatile uint8_t defaultLevel = CONFIG_AWS_IOT_LOG_RUNTIME_DEFAULT_LEVEL;
+
+/**
+ * @brief Lock serializing the additions to #modules.
+ */
+static struct k_spinlock registryLock;
+
+/*-----------------------------------------------------------*/
+
+#if defined( CONFIG_SHELL )
+
+/**
+ * @brief Print the level of each module.
+ *
+ * @param[in] pShell The shell.
+ * @param[in] argc Number of arguments.
+ * @param[in] argv Arguments.
+ *
+ * @return 0.
+ */
+    static int listShellCommand( const struct shell * pShell,
+                                 size_t argc,
+                                 char ** argv );
+
+/**
+ * @brief Set the level of a module, or of all modules.
+ *
+ * @param[in] pShell The shell.
+ * @param[in] argc Number of arguments.
+ * @param[in] argv Arguments; the module name, or "all", and the level name.
+ *
+ * @return 0, or -EINVAL for an unknown module or level.
+ */
+    static int setShellCommand( const struct shell * pShell,
+                                size_t argc,
+                                char ** argv );
+#endif /* if defined( CONFIG_SHELL ) */
+
+/*-----------------------------------------------------------*/
+
+const volatile uint8_t * SdkLog_RegisterModule( const char * pName,
+                                                uint8_t buildLevel )
+{
+    const volatile uint8_t * pLevel = &defaultLevel;
+    k_spinlock_key_t key;
+    size_t i = 0U;
+
+    key = k_spin_lock( &registryLock );
+
+    for( i = 0U; ( i < moduleCount ) && ( strcmp( modules[ i ].pName, pName ) != 0 ); i++ )
+    {
+        /* Find the module. */
+    }
+
+    if( i < moduleCount )
+    {
+        pLevel = &( modules[ i ].level );
+    }
+    else if( moduleCount < ( size_t ) CONFIG_AWS_IOT_LOG_RUNTIME_MODULES )
+    {
+        modules[ moduleCount ].pName = pName;
+        modules[ moduleCount ].level = MIN( buildLevel, defaultLevel );
+        pLevel = &( modules[ moduleCount ].level );
+        moduleCount++;
+    }
+    else
+    {
+        /* The module shares the default level. */
+    }
+
+    k_spin_unlock( &registryLock, key );
+
+    return pLevel;
+}
+/*-----------------------------------------------------------*/
+
+bool SdkLog_SetLevel( const char * pName,
+                      uint8_t level )
+{
+    bool found = false;
+    size_t i = 0U;
+
+    if( level <= LOG_DEBUG )
+    {
+        for( i = 0U; i < moduleCount; i++ )
+        {
+            if( ( pName == NULL ) || ( strcmp( modules[ i ].pName, pName ) == 0 ) )
+            {
+                modules[ i ].level = level;
+                found = true;
+            }
+        }
+
+        if( pName == NULL )
+        {
+            defaultLevel = level;
+            found = true;
+        }
+    }
+
+    return found;
+}
+/*-----------------------------------------------------------*/
+
+#if defined( CONFIG_SHELL )
+
+    static const char * const levelNames[ LOG_DEBUG + 1 ] =
+    {
+        "none", "error", "warn", "info", "debug"
+    };
+
+    static int listShellCommand( const struct shell * pShell,
+                                 size_t argc,
+                                 char ** argv )
+    {
+        size_t i = 0U;
+
+        ( void ) argc;
+        ( void ) argv;
+
+        for( i = 0U; i < moduleCount; i++ )
+        {
+            shell_print( pShell, "%-20s %s", modules[ i ].pName, levelNames[ modules[ i ].level ] );
+        }
+
+        shell_print( pShell, "%-20s %s", "(default)", levelNames[ defaultLevel ] );
+
+        return 0;
+    }
+/*-----------------------------------------------------------*/
+
+    static int setShellCommand( const struct shell * pShell,
+                                size_t argc,
+                                char ** argv )
+    {
+        const char * pName = argv[ 1 ];
+        uint8_t level = 0U;
+        int ret = 0;
+
+        ( void ) argc;
+
+        while( ( level <= LOG_DEBUG ) && ( strcmp( levelNames[ level ], argv[ 2 ] ) != 0 ) )
+        {
+            level++;
+        }
+
+        if( strcmp( pName, "all" ) == 0 )
+        {
+            pName = NULL;
+        }
+
+        if( level > LOG_DEBUG )
+        {
+            shell_error( pShell, "Unknown level: %s", argv[ 2 ] );
+            ret = -EINVAL;
+        }
+        else if( SdkLog_SetLevel( pName, level ) == false )
+        {
+            shell_error( pShell, "No module has logged as %s", argv[ 1 ] );
+            ret = -EINVAL;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+
+        return ret;
+    }
+
+    SHELL_STATIC_SUBCMD_SET_CREATE( sdkLogShellCommands,
+                                    SHELL_CMD_ARG( list, NULL,
+                                                   "Print the log level of each module.",
+                                                   listShellCommand, 1, 0 ),
+                                    SHELL_CMD_ARG( set, NULL,
+                                                   "Set the log level of a module. "
+                                                   "Usage: set <module|all> <none|error|warn|info|debug>",
+                                                   setShellCommand, 3, 0 ),
+                                    SHELL_SUBCMD_SET_END );
+
+    SHELL_CMD_REGISTER( sdk_log, &sdkLogShellCommands, "C-SDK log level commands", NULL );
+/*-----------------------------------------------------------*/
+
+#endif /* if defined( CONFIG_SHELL ) */
@@ -32,6 +32,7 @@
 #include "logging_levels.h"
 
 /* Standard Include. */
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
@@ -62,14 +63,64 @@
 /**
  * @brief Macro to extract only the file name from file path to use for metadata in
  * log messages.
+ *
+ * Compilers that provide `__FILE_NAME__` give the file name as a string literal.
+ * Otherwise the search of the literal `__FILE__` is folded to a constant by the
+ * compiler, so no message pays for it at run time.
  */
-#define FILENAME               ( strrchr( __FILE__, '/' ) ? strrchr( __FILE__, '/' ) + 1 : __FILE__ )
+#if defined( __FILE_NAME__ )
+    #define FILENAME    __FILE_NAME__
+#else
+    #define FILENAME    ( strrchr( __FILE__, '/' ) ? strrchr( __FILE__, '/' ) + 1 : __FILE__ )
+#endif
 
 /* Metadata information to prepend to every log message. */
 #define LOG_METADATA_FORMAT    "[%s] [%s:%d] "                      /**< @brief Format of metadata prefix in log messages as `[<Logging-Level>] [<Library-Name>] [<File-Name>:<Line-Number>]` */
 #define LOG_METADATA_ARGS      LIBRARY_LOG_NAME, FILENAME, __LINE__ /**< @brief Arguments into the metadata logging prefix format. */
 
-#if !defined( DISABLE_LOGGING )
+#if defined( DISABLE_LOGGING )
+    #define SdkLog( string )
+    #define SdkLogError( message )
+    #define SdkLogWarn( message )
+    #define SdkLogInfo( message )
+    #define SdkLogDebug( message )
+#elif defined( CONFIG_AWS_IOT_LOG_ZEPHYR )
+
+/**
+ * @brief Hand a log message to the Zephyr logging subsystem.
+ *
+ * Defined in logging_zephyr.c. The message is formatted into a buffer of
+ * CONFIG_AWS_IOT_LOG_MESSAGE_MAX bytes, as its arguments may not outlive the
+ * call, and queued with its metadata. The metadata is formatted and the line
+ * is written out later by the Zephyr logging thread, so the caller does not
+ * wait on the console.
+ *
+ * @param[in] level The level of the message, one of #LOG_ERROR, #LOG_WARN,
+ * #LOG_INFO or #LOG_DEBUG.
+ * @param[in] pLibraryName The name of the library, which must be a string literal.
+ * @param[in] pFileName The name of the source file, which must be a string literal.
+ * @param[in] line The line of the source file.
+ * @param[in] pFormat The printf format of the message.
+ */
+    void SdkLog_Zephyr( uint8_t level,
+                        const char * pLibraryName,
+                        const char * pFileName,
+                        int line,
+                        const char * pFormat,
+                        ... );
+
+/* Each logging interface macro passes its parenthesized message list to one of
+ * these to add the level and the metadata arguments. */
+    #define SdkLogZephyrError( ... )    SdkLog_Zephyr( LOG_ERROR, LOG_METADATA_ARGS, __VA_ARGS__ )
+    #define SdkLogZephyrWarn( ... )     SdkLog_Zephyr( LOG_WARN, LOG_METADATA_ARGS, __VA_ARGS__ )
+    #define SdkLogZephyrInfo( ... )     SdkLog_Zephyr( LOG_INFO, LOG_METADATA_ARGS, __VA_ARGS__ )
+    #define SdkLogZephyrDebug( ... )    SdkLog_Zephyr( LOG_DEBUG, LOG_METADATA_ARGS, __VA_ARGS__ )
+
+    #define SdkLogError( message )      SdkLogZephyrError message
+    #define SdkLogWarn( message )       SdkLogZephyrWarn message
+    #define SdkLogInfo( message )       SdkLogZephyrInfo message
+    #define SdkLogDebug( message )      SdkLogZephyrDebug message
+#else
 
 /**
  * @brief Common macro that maps all the logging interfaces,
@@ -80,9 +131,61 @@
  * for logging functionality.
  */
     #define SdkLog( string )    printf string
-#else
-    #define SdkLog( string )
-#endif
+
+/* Each level prints its prefix, the metadata, the message and the line ending. */
+    #define SdkLogError( message )    SdkLog( ( "[ERROR] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
+    #define SdkLogWarn( message )     SdkLog( ( "[WARN] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
+    #define SdkLogInfo( message )     SdkLog( ( "[INFO] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
+    #define SdkLogDebug( message )    SdkLog( ( "[DEBUG] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
+#endif /* if defined( DISABLE_LOGGING ) */
+
+#if defined( CONFIG_AWS_IOT_LOG_RUNTIME_LEVELS ) && !defined( DISABLE_LOGGING )
+
+/**
+ * @brief Find or add the run-time level of a module.
+ *
+ * Defined in logging_runtime.c. A module is added with the lower of
+ * @p buildLevel and CONFIG_AWS_IOT_LOG_RUNTIME_DEFAULT_LEVEL.
+ *
+ * @param[in] pName The name of the module, which must be a string literal.
+ * @param[in] buildLevel The #LIBRARY_LOG_LEVEL of the module.
+ *
+ * @return The level of the module, which the shell or SdkLog_SetLevel() may
+ * change at any time, or the default level once the registry is full.
+ */
+    const volatile uint8_t * SdkLog_RegisterModule( const char * pName,
+                                                    uint8_t buildLevel );
+
+/**
+ * @brief Set the run-time level of a module, or of all modules.
+ *
+ * @param[in] pName The name of a module added by SdkLog_RegisterModule(), or
+ * NULL for all the modules and the default level.
+ * @param[in] level One of #LOG_NONE, #LOG_ERROR, #LOG_WARN, #LOG_INFO or #LOG_DEBUG.
+ *
+ * @return true, or false if no module has that name or the level is invalid.
+ */
+    bool SdkLog_SetLevel( const char * pName,
+                          uint8_t level );
+
+/* Each log site looks up the level of its module on its first call, then only
+ * loads and compares it. */
+    #define SdkLogIfEnabled( level, logStatement )                                             \
+    do                                                                                         \
+    {                                                                                          \
+        static const volatile uint8_t * pSdkLogModuleLevel = NULL;                             \
+                                                                                               \
+        if( pSdkLogModuleLevel == NULL )                                                       \
+        {                                                                                      \
+            pSdkLogModuleLevel = SdkLog_RegisterModule( LIBRARY_LOG_NAME, LIBRARY_LOG_LEVEL ); \
+        }                                                                                      \
+                                                                                               \
+        if( *pSdkLogModuleLevel >= ( level ) )                                                 \
+        {                                                                                      \
+            logStatement;                                                                      \
+        }                                                                                      \
+    } while( 0 )
+#endif /* if defined( CONFIG_AWS_IOT_LOG_RUNTIME_LEVELS ) && !defined( DISABLE_LOGGING ) */
 
 /**
  * Disable definition of logging interface macros when generating doxygen output,
@@ -99,30 +202,37 @@
     )
     #error "Please define LIBRARY_LOG_LEVEL as either LOG_NONE, LOG_ERROR, LOG_WARN, LOG_INFO, or LOG_DEBUG."
 #else
-    #if LIBRARY_LOG_LEVEL == LOG_DEBUG
+    #if defined( CONFIG_AWS_IOT_LOG_RUNTIME_LEVELS ) && !defined( DISABLE_LOGGING )
+        /* All messages are built in and filtered by the run-time level. */
+        #define LogError( message )    SdkLogIfEnabled( LOG_ERROR, SdkLogError( message ) )
+        #define LogWarn( message )     SdkLogIfEnabled( LOG_WARN, SdkLogWarn( message ) )
+        #define LogInfo( message )     SdkLogIfEnabled( LOG_INFO, SdkLogInfo( message ) )
+        #define LogDebug( message )    SdkLogIfEnabled( LOG_DEBUG, SdkLogDebug( message ) )
+
+    #elif LIBRARY_LOG_LEVEL == LOG_DEBUG
         /* All log level messages will logged. */
-        #define LogError( message )    SdkLog( ( "[ERROR] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
-        #define LogWarn( message )     SdkLog( ( "[WARN] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
-        #define LogInfo( message )     SdkLog( ( "[INFO] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
-        #define LogDebug( message )    SdkLog( ( "[DEBUG] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
+        #define LogError( message )    SdkLogError( message )
+        #define LogWarn( message )     SdkLogWarn( message )
+        #define LogInfo( message )     SdkLogInfo( message )
+        #define LogDebug( message )    SdkLogDebug( message )
 
     #elif LIBRARY_LOG_LEVEL == LOG_INFO
         /* Only INFO, WARNING and ERROR messages will be logged. */
-        #define LogError( message )    SdkLog( ( "[ERROR] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
-        #define LogWarn( message )     SdkLog( ( "[WARN] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
-        #define LogInfo( message )     SdkLog( ( "[INFO] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
+        #define LogError( message )    SdkLogError( message )
+        #define LogWarn( message )     SdkLogWarn( message )
+        #define LogInfo( message )     SdkLogInfo( message )
         #define LogDebug( message )
 
     #elif LIBRARY_LOG_LEVEL == LOG_WARN
         /* Only WARNING and ERROR messages will be logged.*/
-        #define LogError( message )    SdkLog( ( "[ERROR] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
-        #define LogWarn( message )     SdkLog( ( "[WARN] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
+        #define LogError( message )    SdkLogError( message )
+        #define LogWarn( message )     SdkLogWarn( message )
         #define LogInfo( message )
         #define LogDebug( message )
 
     #elif LIBRARY_LOG_LEVEL == LOG_ERROR
         /* Only ERROR messages will be logged. */
-        #define LogError( message )    SdkLog( ( "[ERROR] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
+        #define LogError( message )    SdkLogError( message )
         #define LogWarn( message )
         #define LogInfo( message )
         #define LogDebug( message )
@@ -148,7 +258,7 @@
  * This macro is only enabled for #LOG_DEBUG level configuration in this
  * logging stack implementation.
  */
-    #define LogDebug( message )    SdkLog( ( "[DEBUG] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
+    #define LogDebug( message )    SdkLogDebug( message )
 
 /**
  * @brief Definition of logging interface macro that logs messages at the "Info"
@@ -157,7 +267,7 @@
  * This macro is only enabled for #LOG_DEBUG and #LOG_INFO level configurations
  * in this logging stack implementation.
  */
-    #define LogInfo( message )     SdkLog( ( "[INFO] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
+    #define LogInfo( message )     SdkLogInfo( message )
 
 /**
  * @brief Definition of logging interface macro that logs messages at the "Warning"
@@ -166,7 +276,7 @@
  * This macro is only enabled for #LOG_DEBUG, #LOG_INFO and #LOG_WARN level
  * configurations in this logging stack implementation.
  */
-    #define LogWarn( message )     SdkLog( ( "[WARN] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
+    #define LogWarn( message )     SdkLogWarn( message )
 
 /**
  * @brief Definition of logging interface macro that logs messages at the "Error"
@@ -175,7 +285,7 @@
  * This macro is only enabled for all logging level configurations
  * unless except the #LOG_NONE configuration.
  */
-    #define LogError( message )    SdkLog( ( "[ERROR] "LOG_METADATA_FORMAT, LOG_METADATA_ARGS ) ); SdkLog( message ); SdkLog( ( "\r\n" ) )
+    #define LogError( message )    SdkLogError( message )
 
 #endif /* ifdef DOXYGEN */
 
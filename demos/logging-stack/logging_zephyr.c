@@ -0,0 +1,86 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file logging_zephyr.c
+ * @brief Backend of the logging stack on the Zephyr logging subsystem.
+ */
+
+/* Standard includes. */
+#include <stdarg.h>
+#include <stdio.h>
+
+/* Zephyr includes. */
+#include <zephyr.h>
+#include <logging/log.h>
+
+/* Logging configuration of this file. Its own messages go to the Zephyr log. */
+#define LIBRARY_LOG_NAME     "LOGGING"
+#define LIBRARY_LOG_LEVEL    LOG_NONE
+
+#include "logging_stack.h"
+
+/* All the libraries and demos share one module, so Zephyr filters them at
+ * LOG_LEVEL_DBG and leaves filtering by level to LIBRARY_LOG_LEVEL. */
+LOG_MODULE_REGISTER( awsIotSdk, LOG_LEVEL_DBG );
+
+/*-----------------------------------------------------------*/
+
+void SdkLog_Zephyr( uint8_t level,
+                    const char * pLibraryName,
+                    const char * pFileName,
+                    int line,
+                    const char * pFormat,
+                    ... )
+{
+    char message[ CONFIG_AWS_IOT_LOG_MESSAGE_MAX ];
+    va_list args;
+
+    /* The arguments of the message, such as the unterminated topic strings
+     * logged with "%.*s", may be gone by the time the logging thread runs, so
+     * the message is formatted here. The library name and file name are string
+     * literals and are only formatted by the logging thread. */
+    va_start( args, pFormat );
+    ( void ) vsnprintf( message, sizeof( message ), pFormat, args );
+    va_end( args );
+
+    switch( level )
+    {
+        case LOG_ERROR:
+            LOG_ERR( "[%s] [%s:%d] %s", pLibraryName, pFileName, line, log_strdup( message ) );
+            break;
+
+        case LOG_WARN:
+            LOG_WRN( "[%s] [%s:%d] %s", pLibraryName, pFileName, line, log_strdup( message ) );
+            break;
+
+        case LOG_INFO:
+            LOG_INF( "[%s] [%s:%d] %s", pLibraryName, pFileName, line, log_strdup( message ) );
+            break;
+
+        default:
+            LOG_DBG( "[%s] [%s:%d] %s", pLibraryName, pFileName, line, log_strdup( message ) );
+            break;
+    }
+}
+
+/*-----------------------------------------------------------*/
@@ -49,7 +49,9 @@
 
 /* MQTT API headers. */
 #include "core_mqtt.h"
-#include "core_mqtt_state.h"
+
+/* Outgoing publishes kept until they are acknowledged. */
+#include "outgoing_publish_tracker.h"
 
 /* MBEDTLS sockets transport implementation. */
 #include "mbedtls_zephyr.h"
@@ -153,12 +155,6 @@
  */
 #define MAX_OUTGOING_PUBLISHES                   ( 5U )
 
-/**
- * @brief Invalid packet identifier for the MQTT packets. Zero is always an
- * invalid packet identifier as per MQTT 3.1.1 spec.
- */
-#define MQTT_PACKET_ID_INVALID                   ( ( uint16_t ) 0U )
-
 /**
  * @brief Timeout for MQTT_ProcessLoop function in milliseconds.
  */
@@ -197,25 +193,6 @@
 
 /*-----------------------------------------------------------*/
 
-/**
- * @brief Structure to keep the MQTT publish packets until an ack is received
- * for QoS2 publishes.
- */
-typedef struct PublishPackets
-{
-    /**
-     * @brief Packet identifier of the publish packet.
-     */
-    uint16_t packetId;
-
-    /**
-     * @brief Publish info of the publish packet.
-     */
-    MQTTPublishInfo_t pubInfo;
-} PublishPackets_t;
-
-/*-----------------------------------------------------------*/
-
 /**
  * @brief Packet Identifier generated when Subscribe request was sent to the broker;
  * it is used to match received Subscribe ACK to the transmitted subscribe.
@@ -230,11 +207,10 @@ static uint16_t globalSubscribePacketIdentifier = 0U;
 static uint16_t globalUnsubscribePacketIdentifier = 0U;
 
 /**
- * @brief Array to keep the outgoing publish messages.
- * These stored outgoing publish messages are kept until a successful ack
+ * @brief Outgoing publish messages, kept until a successful ack
  * is received.
  */
-static PublishPackets_t outgoingPublishPackets[ MAX_OUTGOING_PUBLISHES ] = { 0 };
+OUTGOING_PUBLISH_TRACKER_DEFINE( outgoingPublishes, MAX_OUTGOING_PUBLISHES );
 
 /**
  * @brief Array to keep subscription topics.
@@ -399,49 +375,6 @@ static int unsubscribeFromTopic( MQTTContext_t * pMqttContext );
  */
 static int publishToTopic( MQTTContext_t * pMqttContext );
 
-/**
- * @brief Function to get the free index at which an outgoing publish
- * can be stored.
- *
- * @param[out] pIndex The output parameter to return the index at which an
- * outgoing publish message can be stored.
- *
- * @return EXIT_FAILURE if no more publishes can be stored;
- * EXIT_SUCCESS if an index to store the next outgoing publish is obtained.
- */
-static int getNextFreeIndexForOutgoingPublishes( uint8_t * pIndex );
-
-/**
- * @brief Function to clean up an outgoing publish at given index from the
- * #outgoingPublishPackets array.
- *
- * @param[in] index The index at which a publish message has to be cleaned up.
- */
-static void cleanupOutgoingPublishAt( uint8_t index );
-
-/**
- * @brief Function to clean up all the outgoing publishes maintained in the
- * array.
- */
-static void cleanupOutgoingPublishes( void );
-
-/**
- * @brief Function to clean up the publish packet with the given packet id.
- *
- * @param[in] packetId Packet identifier of the packet to be cleaned up from
- * the array.
- */
-static void cleanupOutgoingPublishWithPacketID( uint16_t packetId );
-
-/**
- * @brief Function to resend the publishes if a session is re-established with
- * the broker. This function handles the resending of the QoS2 publish packets,
- * which are maintained locally.
- *
- * @param[in] pMqttContext MQTT context pointer.
- */
-static int handlePublishResend( MQTTContext_t * pMqttContext );
-
 /**
  * @brief Function to update variable globalSubAckStatus with status
  * information from Subscribe ACK. Called by eventCallback after processing
@@ -533,7 +466,8 @@ static int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext
                                               &serverInfo,
                                               &networkCredentials,
                                               TRANSPORT_SEND_RECV_TIMEOUT_MS,
-                                              TRANSPORT_SEND_RECV_TIMEOUT_MS );
+                                              TRANSPORT_SEND_RECV_TIMEOUT_MS,
+                                              NULL );
 
         if( tlsTransportStatus == TLS_TRANSPORT_SUCCESS )
         {
@@ -577,156 +511,6 @@ static int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext
 
 /*-----------------------------------------------------------*/
 
-static int getNextFreeIndexForOutgoingPublishes( uint8_t * pIndex )
-{
-    int returnStatus = EXIT_FAILURE;
-    uint8_t index = 0;
-
-    assert( outgoingPublishPackets != NULL );
-    assert( pIndex != NULL );
-
-    for( index = 0; index < MAX_OUTGOING_PUBLISHES; index++ )
-    {
-        /* A free index is marked by invalid packet id.
-         * Check if the the index has a free slot. */
-        if( outgoingPublishPackets[ index ].packetId == MQTT_PACKET_ID_INVALID )
-        {
-            returnStatus = EXIT_SUCCESS;
-
-            /* Copy the available index into the output param. */
-            *pIndex = index;
-
-            break;
-        }
-    }
-
-    /* Copy the available index into the output param. */
-    *pIndex = index;
-
-    return returnStatus;
-}
-/*-----------------------------------------------------------*/
-
-static void cleanupOutgoingPublishAt( uint8_t index )
-{
-    assert( outgoingPublishPackets != NULL );
-    assert( index < MAX_OUTGOING_PUBLISHES );
-
-    /* Clear the outgoing publish packet. */
-    ( void ) memset( &( outgoingPublishPackets[ index ] ),
-                     0x00,
-                     sizeof( outgoingPublishPackets[ index ] ) );
-}
-
-/*-----------------------------------------------------------*/
-
-static void cleanupOutgoingPublishes( void )
-{
-    assert( outgoingPublishPackets != NULL );
-
-    /* Clean up all the outgoing publish packets. */
-    ( void ) memset( outgoingPublishPackets, 0x00, sizeof( outgoingPublishPackets ) );
-}
-
-/*-----------------------------------------------------------*/
-
-static void cleanupOutgoingPublishWithPacketID( uint16_t packetId )
-{
-    uint8_t index = 0;
-
-    assert( outgoingPublishPackets != NULL );
-    assert( packetId != MQTT_PACKET_ID_INVALID );
-
-    /* Clean up all the saved outgoing publishes. */
-    for( ; index < MAX_OUTGOING_PUBLISHES; index++ )
-    {
-        if( outgoingPublishPackets[ index ].packetId == packetId )
-        {
-            cleanupOutgoingPublishAt( index );
-            LogInfo( ( "Cleaned up outgoing publish packet with packet id %u.\n\n",
-                       packetId ) );
-            break;
-        }
-    }
-}
-
-/*-----------------------------------------------------------*/
-
-static int handlePublishResend( MQTTContext_t * pMqttContext )
-{
-    int returnStatus = EXIT_SUCCESS;
-    MQTTStatus_t mqttStatus = MQTTSuccess;
-    uint8_t index = 0U;
-    MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
-    uint16_t packetIdToResend = MQTT_PACKET_ID_INVALID;
-    bool foundPacketId = false;
-
-    assert( pMqttContext != NULL );
-    assert( outgoingPublishPackets != NULL );
-
-    /* MQTT_PublishToResend() provides a packet ID of the next PUBLISH packet
-     * that should be resent. In accordance with the MQTT v3.1.1 spec,
-     * MQTT_PublishToResend() preserves the ordering of when the original
-     * PUBLISH packets were sent. The outgoingPublishPackets array is searched
-     * through for the associated packet ID. If the application requires
-     * increased efficiency in the look up of the packet ID, then a hashmap of
-     * packetId key and PublishPacket_t values may be used instead. */
-    packetIdToResend = MQTT_PublishToResend( pMqttContext, &cursor );
-
-    while( packetIdToResend != MQTT_PACKET_ID_INVALID )
-    {
-        foundPacketId = false;
-
-        for( index = 0U; index < MAX_OUTGOING_PUBLISHES; index++ )
-        {
-            if( outgoingPublishPackets[ index ].packetId == packetIdToResend )
-            {
-                foundPacketId = true;
-                outgoingPublishPackets[ index ].pubInfo.dup = true;
-
-                LogInfo( ( "Sending duplicate PUBLISH with packet id %u.",
-                           outgoingPublishPackets[ index ].packetId ) );
-                mqttStatus = MQTT_Publish( pMqttContext,
-                                           &outgoingPublishPackets[ index ].pubInfo,
-                                           outgoingPublishPackets[ index ].packetId );
-
-                if( mqttStatus != MQTTSuccess )
-                {
-                    LogError( ( "Sending duplicate PUBLISH for packet id %u "
-                                " failed with status %s.",
-                                outgoingPublishPackets[ index ].packetId,
-                                MQTT_Status_strerror( mqttStatus ) ) );
-                    returnStatus = EXIT_FAILURE;
-                    break;
-                }
-                else
-                {
-                    LogInfo( ( "Sent duplicate PUBLISH successfully for packet id %u.\n\n",
-                               outgoingPublishPackets[ index ].packetId ) );
-                }
-            }
-        }
-
-        if( foundPacketId == false )
-        {
-            LogError( ( "Packet id %u requires resend, but was not found in "
-                        "outgoingPublishPackets.",
-                        packetIdToResend ) );
-            returnStatus = EXIT_FAILURE;
-            break;
-        }
-        else
-        {
-            /* Get the next packetID to be resent. */
-            packetIdToResend = MQTT_PublishToResend( pMqttContext, &cursor );
-        }
-    }
-
-    return returnStatus;
-}
-
-/*-----------------------------------------------------------*/
-
 static void handleIncomingPublish( MQTTPublishInfo_t * pPublishInfo,
                                    uint16_t packetIdentifier )
 {
@@ -933,7 +717,7 @@ static void eventCallback( MQTTContext_t * pMqttContext,
                 LogInfo( ( "PUBREC received for packet id %u.\n\n",
                            packetIdentifier ) );
                 /* Cleanup publish packet when a PUBREC is received. */
-                cleanupOutgoingPublishWithPacketID( packetIdentifier );
+                ( void ) OutgoingPublish_Remove( &outgoingPublishes, packetIdentifier );
                 break;
 
             case MQTT_PACKET_TYPE_PUBREL:
@@ -1128,42 +912,40 @@ static int publishToTopic( MQTTContext_t * pMqttContext )
 {
     int returnStatus = EXIT_SUCCESS;
     MQTTStatus_t mqttStatus = MQTTSuccess;
-    uint8_t publishIndex = MAX_OUTGOING_PUBLISHES;
+    OutgoingPublish_t * pPublish = NULL;
 
     assert( pMqttContext != NULL );
 
-    /* Get the next free index for the outgoing publish. All QoS2 outgoing
+    /* Store the outgoing publish with a new packet id. All QoS2 outgoing
      * publishes are stored until a PUBREC is received. These messages are
      * stored for supporting a resend if a network connection is broken before
      * receiving a PUBREC. */
-    returnStatus = getNextFreeIndexForOutgoingPublishes( &publishIndex );
+    pPublish = OutgoingPublish_Add( &outgoingPublishes, MQTT_GetPacketId( pMqttContext ) );
 
-    if( returnStatus == EXIT_FAILURE )
+    if( pPublish == NULL )
     {
         LogError( ( "Unable to find a free spot for outgoing PUBLISH message.\n\n" ) );
+        returnStatus = EXIT_FAILURE;
     }
     else
     {
         /* This example publishes to only one topic and uses QOS2. */
-        outgoingPublishPackets[ publishIndex ].pubInfo.qos = MQTTQoS2;
-        outgoingPublishPackets[ publishIndex ].pubInfo.pTopicName = MQTT_EXAMPLE_TOPIC;
-        outgoingPublishPackets[ publishIndex ].pubInfo.topicNameLength = MQTT_EXAMPLE_TOPIC_LENGTH;
-        outgoingPublishPackets[ publishIndex ].pubInfo.pPayload = MQTT_EXAMPLE_MESSAGE;
-        outgoingPublishPackets[ publishIndex ].pubInfo.payloadLength = MQTT_EXAMPLE_MESSAGE_LENGTH;
-
-        /* Get a new packet id. */
-        outgoingPublishPackets[ publishIndex ].packetId = MQTT_GetPacketId( pMqttContext );
+        pPublish->pubInfo.qos = MQTTQoS2;
+        pPublish->pubInfo.pTopicName = MQTT_EXAMPLE_TOPIC;
+        pPublish->pubInfo.topicNameLength = MQTT_EXAMPLE_TOPIC_LENGTH;
+        pPublish->pubInfo.pPayload = MQTT_EXAMPLE_MESSAGE;
+        pPublish->pubInfo.payloadLength = MQTT_EXAMPLE_MESSAGE_LENGTH;
 
         /* Send PUBLISH packet. */
         mqttStatus = MQTT_Publish( pMqttContext,
-                                   &outgoingPublishPackets[ publishIndex ].pubInfo,
-                                   outgoingPublishPackets[ publishIndex ].packetId );
+                                   &( pPublish->pubInfo ),
+                                   pPublish->packetId );
 
         if( mqttStatus != MQTTSuccess )
         {
             LogError( ( "Failed to send PUBLISH packet to broker with error = %s.",
                         MQTT_Status_strerror( mqttStatus ) ) );
-            cleanupOutgoingPublishAt( publishIndex );
+            ( void ) OutgoingPublish_Remove( &outgoingPublishes, pPublish->packetId );
             returnStatus = EXIT_FAILURE;
         }
         else
@@ -1171,7 +953,7 @@ static int publishToTopic( MQTTContext_t * pMqttContext )
             LogInfo( ( "PUBLISH sent for topic %.*s to broker with packet ID %u.\n\n",
                        MQTT_EXAMPLE_TOPIC_LENGTH,
                        MQTT_EXAMPLE_TOPIC,
-                       outgoingPublishPackets[ publishIndex ].packetId ) );
+                       pPublish->packetId ) );
         }
     }
 
@@ -1197,6 +979,7 @@ static int initializeMqtt( MQTTContext_t * pMqttContext,
     transport.pNetworkContext = pNetworkContext;
     transport.send = MbedTLS_send;
     transport.recv = MbedTLS_recv;
+    transport.writev = MbedTLS_Writev;
 
     /* Fill the values for network buffer. */
     networkBuffer.pBuffer = buffer;
@@ -1409,7 +1192,7 @@ static int start_basic_tls_demo()
                                "Resending unacked publishes." ) );
 
                     /* Handle all the resend of publish messages. */
-                    returnStatus = handlePublishResend( &mqttContext );
+                    returnStatus = ( OutgoingPublish_Resend( &outgoingPublishes, &mqttContext ) == MQTTSuccess ) ? EXIT_SUCCESS : EXIT_FAILURE;
                 }
                 else
                 {
@@ -1418,7 +1201,7 @@ static int start_basic_tls_demo()
 
                     /* Clean up the outgoing publishes waiting for ack as this new
                      * connection doesn't re-establish an existing session. */
-                    cleanupOutgoingPublishes();
+                    OutgoingPublish_RemoveAll( &outgoingPublishes );
                 }
 
                 /* If TLS session is established, execute Subscribe/Publish loop. */
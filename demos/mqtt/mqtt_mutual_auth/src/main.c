@@ -64,10 +64,20 @@
 
 /* MQTT API headers. */
 #include "core_mqtt.h"
-#include "core_mqtt_state.h"
 
-/* mbedtls transport implementation. */
-#include "mbedtls_zephyr.h"
+/* Outgoing publishes kept until they are acknowledged. */
+#include "outgoing_publish_tracker.h"
+
+/* Sleeps until the MQTT connection has something to do. */
+#include "mqtt_idle.h"
+
+#if defined( CONFIG_AWS_IOT_TLS_SOCKETS_TRANSPORT )
+    /* Zephyr TLS sockets transport implementation. */
+    #include "tls_sockets_zephyr.h"
+#else
+    /* mbedtls transport implementation. */
+    #include "mbedtls_zephyr.h"
+#endif
 
 /* Include backoff algorithm header for retry logic.*/
 #include "backoff_algorithm.h"
@@ -75,6 +85,11 @@
 /* Clock for timer. */
 #include "clock.h"
 
+#if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+    /* Network buffers shared with the other clients. */
+    #include "network_buffer_pool.h"
+#endif
+
 /* Wifi connection for ESP32 */
 #include "esp_wifi_wrapper.h"
 
@@ -133,6 +148,14 @@
     #define NETWORK_BUFFER_SIZE    ( 1024U )
 #endif
 
+/**
+ * @brief Security tag under which the credentials are registered when the
+ * demo uses the Zephyr TLS sockets transport.
+ */
+#ifndef TLS_SOCKETS_SEC_TAG
+    #define TLS_SOCKETS_SEC_TAG    ( 1 )
+#endif
+
 #ifndef OS_NAME
     #define OS_NAME    "Zephyr"
 #endif
@@ -232,12 +255,6 @@
  */
 #define MAX_OUTGOING_PUBLISHES              ( 5U )
 
-/**
- * @brief Invalid packet identifier for the MQTT packets. Zero is always an
- * invalid packet identifier as per MQTT 3.1.1 spec.
- */
-#define MQTT_PACKET_ID_INVALID              ( ( uint16_t ) 0U )
-
 /**
  * @brief Timeout for MQTT_ProcessLoop function in milliseconds.
  */
@@ -298,25 +315,6 @@
 
 /*-----------------------------------------------------------*/
 
-/**
- * @brief Structure to keep the MQTT publish packets until an ack is received
- * for QoS1 publishes.
- */
-typedef struct PublishPackets
-{
-    /**
-     * @brief Packet identifier of the publish packet.
-     */
-    uint16_t packetId;
-
-    /**
-     * @brief Publish info of the publish packet.
-     */
-    MQTTPublishInfo_t pubInfo;
-} PublishPackets_t;
-
-/*-----------------------------------------------------------*/
-
 /**
  * @brief Packet Identifier generated when Subscribe request was sent to the broker;
  * it is used to match received Subscribe ACK to the transmitted subscribe.
@@ -331,11 +329,10 @@ static uint16_t globalSubscribePacketIdentifier = 0U;
 static uint16_t globalUnsubscribePacketIdentifier = 0U;
 
 /**
- * @brief Array to keep the outgoing publish messages.
- * These stored outgoing publish messages are kept until a successful ack
+ * @brief Outgoing publish messages, kept until a successful ack
  * is received.
  */
-static PublishPackets_t outgoingPublishPackets[ MAX_OUTGOING_PUBLISHES ] = { 0 };
+OUTGOING_PUBLISH_TRACKER_DEFINE( outgoingPublishes, MAX_OUTGOING_PUBLISHES );
 
 /**
  * @brief Array to keep subscription topics.
@@ -343,10 +340,14 @@ static PublishPackets_t outgoingPublishPackets[ MAX_OUTGOING_PUBLISHES ] = { 0 }
  */
 static MQTTSubscribeInfo_t pGlobalSubscriptionList[ 1 ];
 
+#if !defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+
 /**
  * @brief The network buffer must remain valid for the lifetime of the MQTT context.
+ * With the shared pool, it is taken from the pool for each connection instead.
  */
-static uint8_t buffer[ NETWORK_BUFFER_SIZE ];
+    static uint8_t buffer[ NETWORK_BUFFER_SIZE ];
+#endif
 
 /**
  * @brief Status of latest Subscribe ACK;
@@ -360,7 +361,11 @@ static MQTTSubAckStatus_t globalSubAckStatus = MQTTSubAckFailure;
 /* Each compilation unit must define the NetworkContext struct. */
 struct NetworkContext
 {
-    TlsTransportParams_t * pParams;
+    #if defined( CONFIG_AWS_IOT_TLS_SOCKETS_TRANSPORT )
+        TlsSocketsParams_t * pParams;
+    #else
+        TlsTransportParams_t * pParams;
+    #endif
 };
 
 /*-----------------------------------------------------------*/
@@ -373,6 +378,25 @@ struct NetworkContext
  */
 static uint32_t generateRandomNumber();
 
+/**
+ * @brief Establish a TLS session with the MQTT broker, using the transport
+ * selected by CONFIG_AWS_IOT_TLS_SOCKETS_TRANSPORT.
+ *
+ * @param[in] pNetworkContext The network context of the session.
+ * @param[in] pServerInfo The MQTT broker.
+ *
+ * @return true if the TLS session is established; false otherwise.
+ */
+static bool connectTls( NetworkContext_t * pNetworkContext,
+                        const ServerInfo_t * pServerInfo );
+
+/**
+ * @brief End the TLS session, then close the TCP connection.
+ *
+ * @param[in] pNetworkContext The network context of the session.
+ */
+static void disconnectTls( NetworkContext_t * pNetworkContext );
+
 /**
  * @brief Connect to MQTT broker with reconnection retries.
  *
@@ -406,6 +430,18 @@ static int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext
  */
 static int subscribePublishLoop( MQTTContext_t * pMqttContext );
 
+/**
+ * @brief Process the MQTT connection for a time, sleeping in between the
+ * packets received, the keep-alive actions and the end of the time.
+ *
+ * @param[in] pMqttContext MQTT context pointer.
+ * @param[in] timeoutMs Time to process the connection for, in milliseconds.
+ *
+ * @return The status of MqttIdle_ProcessLoop().
+ */
+static MQTTStatus_t processLoopIdle( MQTTContext_t * pMqttContext,
+                                     uint32_t timeoutMs );
+
 /**
  * @brief The function to handle the incoming publishes.
  *
@@ -499,49 +535,6 @@ static int unsubscribeFromTopic( MQTTContext_t * pMqttContext );
  */
 static int publishToTopic( MQTTContext_t * pMqttContext );
 
-/**
- * @brief Function to get the free index at which an outgoing publish
- * can be stored.
- *
- * @param[out] pIndex The output parameter to return the index at which an
- * outgoing publish message can be stored.
- *
- * @return EXIT_FAILURE if no more publishes can be stored;
- * EXIT_SUCCESS if an index to store the next outgoing publish is obtained.
- */
-static int getNextFreeIndexForOutgoingPublishes( uint8_t * pIndex );
-
-/**
- * @brief Function to clean up an outgoing publish at given index from the
- * #outgoingPublishPackets array.
- *
- * @param[in] index The index at which a publish message has to be cleaned up.
- */
-static void cleanupOutgoingPublishAt( uint8_t index );
-
-/**
- * @brief Function to clean up all the outgoing publishes maintained in the
- * array.
- */
-static void cleanupOutgoingPublishes( void );
-
-/**
- * @brief Function to clean up the publish packet with the given packet id.
- *
- * @param[in] packetId Packet identifier of the packet to be cleaned up from
- * the array.
- */
-static void cleanupOutgoingPublishWithPacketID( uint16_t packetId );
-
-/**
- * @brief Function to resend the publishes if a session is re-established with
- * the broker. This function handles the resending of the QoS1 publish packets,
- * which are maintained locally.
- *
- * @param[in] pMqttContext MQTT context pointer.
- */
-static int handlePublishResend( MQTTContext_t * pMqttContext );
-
 /**
  * @brief Function to update variable globalSubAckStatus with status
  * information from Subscribe ACK. Called by eventCallback after processing
@@ -583,6 +576,136 @@ static uint32_t generateRandomNumber()
 }
 
 /*-----------------------------------------------------------*/
+#if defined( CONFIG_AWS_IOT_TLS_SOCKETS_TRANSPORT )
+
+    static bool connectTls( NetworkContext_t * pNetworkContext,
+                            const ServerInfo_t * pServerInfo )
+    {
+        static bool credentialsRegistered = false;
+        static const sec_tag_t secTags[] = { TLS_SOCKETS_SEC_TAG };
+        TlsSocketsStatus_t tlsSocketsStatus = TLS_SOCKETS_SUCCESS;
+        TlsSocketsCredentials_t credentials;
+        const char * alpn[] = { AWS_IOT_MQTT_ALPN, NULL };
+
+        /* The network stack keeps the credentials for every later connection,
+         * so they are registered only once. */
+        if( credentialsRegistered == false )
+        {
+            tlsSocketsStatus = TlsSockets_AddCredential( TLS_SOCKETS_SEC_TAG,
+                                                         TLS_CREDENTIAL_CA_CERTIFICATE,
+                                                         ROOT_CA_CERT_PEM,
+                                                         sizeof( ROOT_CA_CERT_PEM ) );
+
+            /* If #CLIENT_USERNAME is defined, username/password is used for
+             * authenticating the client. */
+            #ifndef CLIENT_USERNAME
+                if( tlsSocketsStatus == TLS_SOCKETS_SUCCESS )
+                {
+                    tlsSocketsStatus = TlsSockets_AddCredential( TLS_SOCKETS_SEC_TAG,
+                                                                 TLS_CREDENTIAL_SERVER_CERTIFICATE,
+                                                                 CLIENT_CERT_PEM,
+                                                                 sizeof( CLIENT_CERT_PEM ) );
+                }
+
+                if( tlsSocketsStatus == TLS_SOCKETS_SUCCESS )
+                {
+                    tlsSocketsStatus = TlsSockets_AddCredential( TLS_SOCKETS_SEC_TAG,
+                                                                 TLS_CREDENTIAL_PRIVATE_KEY,
+                                                                 CLIENT_PRIVATE_KEY_PEM,
+                                                                 sizeof( CLIENT_PRIVATE_KEY_PEM ) );
+                }
+            #endif /* ifndef CLIENT_USERNAME */
+
+            credentialsRegistered = ( tlsSocketsStatus == TLS_SOCKETS_SUCCESS );
+        }
+
+        if( tlsSocketsStatus == TLS_SOCKETS_SUCCESS )
+        {
+            ( void ) memset( &credentials, 0, sizeof( TlsSocketsCredentials_t ) );
+            credentials.pSecTags = secTags;
+            credentials.secTagCount = sizeof( secTags ) / sizeof( secTags[ 0 ] );
+
+            /* AWS IoT requires devices to send the Server Name Indication (SNI)
+             * extension, as described for the mbed TLS transport below. */
+            credentials.disableSni = false;
+
+            if( AWS_MQTT_PORT == 443 )
+            {
+                credentials.pAlpnProtos = alpn;
+            }
+
+            tlsSocketsStatus = TlsSockets_Connect( pNetworkContext,
+                                                   pServerInfo,
+                                                   &credentials,
+                                                   TRANSPORT_SEND_RECV_TIMEOUT_MS,
+                                                   TRANSPORT_SEND_RECV_TIMEOUT_MS,
+                                                   NULL );
+        }
+
+        return( tlsSocketsStatus == TLS_SOCKETS_SUCCESS );
+    }
+/*-----------------------------------------------------------*/
+
+    static void disconnectTls( NetworkContext_t * pNetworkContext )
+    {
+        ( void ) TlsSockets_Disconnect( pNetworkContext );
+    }
+/*-----------------------------------------------------------*/
+
+#else /* if defined( CONFIG_AWS_IOT_TLS_SOCKETS_TRANSPORT ) */
+
+    static bool connectTls( NetworkContext_t * pNetworkContext,
+                            const ServerInfo_t * pServerInfo )
+    {
+        TlsTransportStatus_t tlsTransportStatus = TLS_TRANSPORT_SUCCESS;
+        NetworkCredentials_t networkCredentials;
+        const char * alpn[] = { AWS_IOT_MQTT_ALPN, NULL };
+
+        /* Initialize credentials for establishing TLS session. */
+        memset( &networkCredentials, 0, sizeof( NetworkCredentials_t ) );
+        networkCredentials.pRootCa = ROOT_CA_CERT_PEM;
+        networkCredentials.rootCaSize = sizeof( ROOT_CA_CERT_PEM );
+
+        /* If #CLIENT_USERNAME is defined, username/password is used for authenticating
+         * the client. */
+        #ifndef CLIENT_USERNAME
+            networkCredentials.pClientCert = CLIENT_CERT_PEM;
+            networkCredentials.clientCertSize = sizeof( CLIENT_CERT_PEM );
+            networkCredentials.pPrivateKey = CLIENT_PRIVATE_KEY_PEM;
+            networkCredentials.privateKeySize = sizeof( CLIENT_PRIVATE_KEY_PEM );
+        #endif
+
+        /* AWS IoT requires devices to send the Server Name Indication (SNI)
+         * extension to the Transport Layer Security (TLS) protocol and provide
+         * the complete endpoint address in the host_name field. Details about
+         * SNI for AWS IoT can be found in the link below.
+         * https://docs.aws.amazon.com/iot/latest/developerguide/transport-security.html */
+        networkCredentials.disableSni = 0;
+
+        if( AWS_MQTT_PORT == 443 )
+        {
+            networkCredentials.pAlpnProtos = alpn;
+        }
+
+        tlsTransportStatus = MbedTLS_Connect( pNetworkContext,
+                                              pServerInfo,
+                                              &networkCredentials,
+                                              TRANSPORT_SEND_RECV_TIMEOUT_MS,
+                                              TRANSPORT_SEND_RECV_TIMEOUT_MS,
+                                              NULL );
+
+        return( tlsTransportStatus == TLS_TRANSPORT_SUCCESS );
+    }
+/*-----------------------------------------------------------*/
+
+    static void disconnectTls( NetworkContext_t * pNetworkContext )
+    {
+        ( void ) MbedTLS_Disconnect( pNetworkContext );
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* if defined( CONFIG_AWS_IOT_TLS_SOCKETS_TRANSPORT ) */
+
 static int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext,
                                               MQTTContext_t * pMqttContext,
                                               bool * pClientSessionPresent,
@@ -590,45 +713,16 @@ static int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext
 {
     int returnStatus = EXIT_FAILURE;
     BackoffAlgorithmStatus_t backoffAlgStatus = BackoffAlgorithmSuccess;
-    TlsTransportStatus_t tlsTransportStatus = TLS_TRANSPORT_SUCCESS;
     BackoffAlgorithmContext_t reconnectParams;
     ServerInfo_t serverInfo;
-    NetworkCredentials_t networkCredentials;
     uint16_t nextRetryBackOff;
     bool createCleanSession;
-    const char * alpn[] = { AWS_IOT_MQTT_ALPN, NULL };
 
     /* Initialize information to connect to the MQTT broker. */
     serverInfo.pHostName = AWS_IOT_ENDPOINT;
     serverInfo.hostNameLength = AWS_IOT_ENDPOINT_LENGTH;
     serverInfo.port = AWS_MQTT_PORT;
 
-    /* Initialize credentials for establishing TLS session. */
-    memset( &networkCredentials, 0, sizeof( NetworkCredentials_t ) );
-    networkCredentials.pRootCa = ROOT_CA_CERT_PEM;
-    networkCredentials.rootCaSize = sizeof( ROOT_CA_CERT_PEM );
-
-    /* If #CLIENT_USERNAME is defined, username/password is used for authenticating
-     * the client. */
-    #ifndef CLIENT_USERNAME
-        networkCredentials.pClientCert = CLIENT_CERT_PEM;
-        networkCredentials.clientCertSize = sizeof( CLIENT_CERT_PEM );
-        networkCredentials.pPrivateKey = CLIENT_PRIVATE_KEY_PEM;
-        networkCredentials.privateKeySize = sizeof( CLIENT_PRIVATE_KEY_PEM );
-    #endif
-
-    /* AWS IoT requires devices to send the Server Name Indication (SNI)
-     * extension to the Transport Layer Security (TLS) protocol and provide
-     * the complete endpoint address in the host_name field. Details about
-     * SNI for AWS IoT can be found in the link below.
-     * https://docs.aws.amazon.com/iot/latest/developerguide/transport-security.html */
-    networkCredentials.disableSni = 0;
-
-    if( AWS_MQTT_PORT == 443 )
-    {
-        networkCredentials.pAlpnProtos = alpn;
-    }
-
     /* Initialize reconnect attempts and interval */
     BackoffAlgorithm_InitializeParams( &reconnectParams,
                                        CONNECTION_RETRY_BACKOFF_BASE_MS,
@@ -649,13 +743,7 @@ static int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext
                    AWS_IOT_ENDPOINT,
                    AWS_MQTT_PORT ) );
 
-        tlsTransportStatus = MbedTLS_Connect( pNetworkContext,
-                                              &serverInfo,
-                                              &networkCredentials,
-                                              TRANSPORT_SEND_RECV_TIMEOUT_MS,
-                                              TRANSPORT_SEND_RECV_TIMEOUT_MS );
-
-        if( tlsTransportStatus == TLS_TRANSPORT_SUCCESS )
+        if( connectTls( pNetworkContext, &serverInfo ) == true )
         {
             /* A clean MQTT session needs to be created, if there is no session saved
              * in this MQTT client. */
@@ -668,7 +756,7 @@ static int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext
             if( returnStatus == EXIT_FAILURE )
             {
                 /* End TLS session, then close TCP connection. */
-                ( void ) MbedTLS_Disconnect( pNetworkContext );
+                disconnectTls( pNetworkContext );
             }
         }
 
@@ -697,152 +785,6 @@ static int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext
 
 /*-----------------------------------------------------------*/
 
-static int getNextFreeIndexForOutgoingPublishes( uint8_t * pIndex )
-{
-    int returnStatus = EXIT_FAILURE;
-    uint8_t index = 0;
-
-    assert( outgoingPublishPackets != NULL );
-    assert( pIndex != NULL );
-
-    for( index = 0; index < MAX_OUTGOING_PUBLISHES; index++ )
-    {
-        /* A free index is marked by invalid packet id.
-         * Check if the the index has a free slot. */
-        if( outgoingPublishPackets[ index ].packetId == MQTT_PACKET_ID_INVALID )
-        {
-            returnStatus = EXIT_SUCCESS;
-            break;
-        }
-    }
-
-    /* Copy the available index into the output param. */
-    *pIndex = index;
-
-    return returnStatus;
-}
-/*-----------------------------------------------------------*/
-
-static void cleanupOutgoingPublishAt( uint8_t index )
-{
-    assert( outgoingPublishPackets != NULL );
-    assert( index < MAX_OUTGOING_PUBLISHES );
-
-    /* Clear the outgoing publish packet. */
-    ( void ) memset( &( outgoingPublishPackets[ index ] ),
-                     0x00,
-                     sizeof( outgoingPublishPackets[ index ] ) );
-}
-
-/*-----------------------------------------------------------*/
-
-static void cleanupOutgoingPublishes( void )
-{
-    assert( outgoingPublishPackets != NULL );
-
-    /* Clean up all the outgoing publish packets. */
-    ( void ) memset( outgoingPublishPackets, 0x00, sizeof( outgoingPublishPackets ) );
-}
-
-/*-----------------------------------------------------------*/
-
-static void cleanupOutgoingPublishWithPacketID( uint16_t packetId )
-{
-    uint8_t index = 0;
-
-    assert( outgoingPublishPackets != NULL );
-    assert( packetId != MQTT_PACKET_ID_INVALID );
-
-    /* Clean up all the saved outgoing publishes. */
-    for( ; index < MAX_OUTGOING_PUBLISHES; index++ )
-    {
-        if( outgoingPublishPackets[ index ].packetId == packetId )
-        {
-            cleanupOutgoingPublishAt( index );
-            LogInfo( ( "Cleaned up outgoing publish packet with packet id %u.\n\n",
-                       packetId ) );
-            break;
-        }
-    }
-}
-
-/*-----------------------------------------------------------*/
-
-static int handlePublishResend( MQTTContext_t * pMqttContext )
-{
-    int returnStatus = EXIT_SUCCESS;
-    MQTTStatus_t mqttStatus = MQTTSuccess;
-    uint8_t index = 0U;
-    MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
-    uint16_t packetIdToResend = MQTT_PACKET_ID_INVALID;
-    bool foundPacketId = false;
-
-    assert( pMqttContext != NULL );
-    assert( outgoingPublishPackets != NULL );
-
-    /* MQTT_PublishToResend() provides a packet ID of the next PUBLISH packet
-     * that should be resent. In accordance with the MQTT v3.1.1 spec,
-     * MQTT_PublishToResend() preserves the ordering of when the original
-     * PUBLISH packets were sent. The outgoingPublishPackets array is searched
-     * through for the associated packet ID. If the application requires
-     * increased efficiency in the look up of the packet ID, then a hashmap of
-     * packetId key and PublishPacket_t values may be used instead. */
-    packetIdToResend = MQTT_PublishToResend( pMqttContext, &cursor );
-
-    while( packetIdToResend != MQTT_PACKET_ID_INVALID )
-    {
-        foundPacketId = false;
-
-        for( index = 0U; index < MAX_OUTGOING_PUBLISHES; index++ )
-        {
-            if( outgoingPublishPackets[ index ].packetId == packetIdToResend )
-            {
-                foundPacketId = true;
-                outgoingPublishPackets[ index ].pubInfo.dup = true;
-
-                LogInfo( ( "Sending duplicate PUBLISH with packet id %u.",
-                           outgoingPublishPackets[ index ].packetId ) );
-                mqttStatus = MQTT_Publish( pMqttContext,
-                                           &outgoingPublishPackets[ index ].pubInfo,
-                                           outgoingPublishPackets[ index ].packetId );
-
-                if( mqttStatus != MQTTSuccess )
-                {
-                    LogError( ( "Sending duplicate PUBLISH for packet id %u "
-                                " failed with status %s.",
-                                outgoingPublishPackets[ index ].packetId,
-                                MQTT_Status_strerror( mqttStatus ) ) );
-                    returnStatus = EXIT_FAILURE;
-                    break;
-                }
-                else
-                {
-                    LogInfo( ( "Sent duplicate PUBLISH successfully for packet id %u.\n\n",
-                               outgoingPublishPackets[ index ].packetId ) );
-                }
-            }
-        }
-
-        if( foundPacketId == false )
-        {
-            LogError( ( "Packet id %u requires resend, but was not found in "
-                        "outgoingPublishPackets.",
-                        packetIdToResend ) );
-            returnStatus = EXIT_FAILURE;
-            break;
-        }
-        else
-        {
-            /* Get the next packetID to be resent. */
-            packetIdToResend = MQTT_PublishToResend( pMqttContext, &cursor );
-        }
-    }
-
-    return returnStatus;
-}
-
-/*-----------------------------------------------------------*/
-
 static void handleIncomingPublish( MQTTPublishInfo_t * pPublishInfo,
                                    uint16_t packetIdentifier )
 {
@@ -936,7 +878,7 @@ static int handleResubscribe( MQTTContext_t * pMqttContext )
                    MQTT_EXAMPLE_TOPIC ) );
 
         /* Process incoming packet. */
-        mqttStatus = MQTT_ProcessLoop( pMqttContext, MQTT_PROCESS_LOOP_TIMEOUT_MS );
+        mqttStatus = processLoopIdle( pMqttContext, MQTT_PROCESS_LOOP_TIMEOUT_MS );
 
         if( mqttStatus != MQTTSuccess )
         {
@@ -1047,7 +989,7 @@ static void eventCallback( MQTTContext_t * pMqttContext,
                 LogInfo( ( "PUBACK received for packet id %u.\n\n",
                            packetIdentifier ) );
                 /* Cleanup publish packet when a PUBACK is received. */
-                cleanupOutgoingPublishWithPacketID( packetIdentifier );
+                ( void ) OutgoingPublish_Remove( &outgoingPublishes, packetIdentifier );
                 break;
 
             /* Any other packet type is invalid. */
@@ -1252,42 +1194,40 @@ static int publishToTopic( MQTTContext_t * pMqttContext )
 {
     int returnStatus = EXIT_SUCCESS;
     MQTTStatus_t mqttStatus = MQTTSuccess;
-    uint8_t publishIndex = MAX_OUTGOING_PUBLISHES;
+    OutgoingPublish_t * pPublish = NULL;
 
     assert( pMqttContext != NULL );
 
-    /* Get the next free index for the outgoing publish. All QoS1 outgoing
+    /* Store the outgoing publish with a new packet id. All QoS1 outgoing
      * publishes are stored until a PUBACK is received. These messages are
      * stored for supporting a resend if a network connection is broken before
      * receiving a PUBACK. */
-    returnStatus = getNextFreeIndexForOutgoingPublishes( &publishIndex );
+    pPublish = OutgoingPublish_Add( &outgoingPublishes, MQTT_GetPacketId( pMqttContext ) );
 
-    if( returnStatus == EXIT_FAILURE )
+    if( pPublish == NULL )
     {
         LogError( ( "Unable to find a free spot for outgoing PUBLISH message.\n\n" ) );
+        returnStatus = EXIT_FAILURE;
     }
     else
     {
         /* This example publishes to only one topic and uses QOS1. */
-        outgoingPublishPackets[ publishIndex ].pubInfo.qos = MQTTQoS1;
-        outgoingPublishPackets[ publishIndex ].pubInfo.pTopicName = MQTT_EXAMPLE_TOPIC;
-        outgoingPublishPackets[ publishIndex ].pubInfo.topicNameLength = MQTT_EXAMPLE_TOPIC_LENGTH;
-        outgoingPublishPackets[ publishIndex ].pubInfo.pPayload = MQTT_EXAMPLE_MESSAGE;
-        outgoingPublishPackets[ publishIndex ].pubInfo.payloadLength = MQTT_EXAMPLE_MESSAGE_LENGTH;
-
-        /* Get a new packet id. */
-        outgoingPublishPackets[ publishIndex ].packetId = MQTT_GetPacketId( pMqttContext );
+        pPublish->pubInfo.qos = MQTTQoS1;
+        pPublish->pubInfo.pTopicName = MQTT_EXAMPLE_TOPIC;
+        pPublish->pubInfo.topicNameLength = MQTT_EXAMPLE_TOPIC_LENGTH;
+        pPublish->pubInfo.pPayload = MQTT_EXAMPLE_MESSAGE;
+        pPublish->pubInfo.payloadLength = MQTT_EXAMPLE_MESSAGE_LENGTH;
 
         /* Send PUBLISH packet. */
         mqttStatus = MQTT_Publish( pMqttContext,
-                                   &outgoingPublishPackets[ publishIndex ].pubInfo,
-                                   outgoingPublishPackets[ publishIndex ].packetId );
+                                   &( pPublish->pubInfo ),
+                                   pPublish->packetId );
 
         if( mqttStatus != MQTTSuccess )
         {
             LogError( ( "Failed to send PUBLISH packet to broker with error = %s.",
                         MQTT_Status_strerror( mqttStatus ) ) );
-            cleanupOutgoingPublishAt( publishIndex );
+            ( void ) OutgoingPublish_Remove( &outgoingPublishes, pPublish->packetId );
             returnStatus = EXIT_FAILURE;
         }
         else
@@ -1295,7 +1235,7 @@ static int publishToTopic( MQTTContext_t * pMqttContext )
             LogInfo( ( "PUBLISH sent for topic %.*s to broker with packet ID %u.\n\n",
                        MQTT_EXAMPLE_TOPIC_LENGTH,
                        MQTT_EXAMPLE_TOPIC,
-                       outgoingPublishPackets[ publishIndex ].packetId ) );
+                       pPublish->packetId ) );
         }
     }
 
@@ -1319,11 +1259,25 @@ static int initializeMqtt( MQTTContext_t * pMqttContext,
      * For this demo, TCP sockets are used to send and receive data
      * from network. Network context is SSL context for OpenSSL.*/
     transport.pNetworkContext = pNetworkContext;
-    transport.send = MbedTLS_send;
-    transport.recv = MbedTLS_recv;
+
+    #if defined( CONFIG_AWS_IOT_TLS_SOCKETS_TRANSPORT )
+        transport.send = TlsSockets_Send;
+        transport.recv = TlsSockets_Recv;
+        transport.writev = TlsSockets_Writev;
+    #else
+        transport.send = MbedTLS_send;
+        transport.recv = MbedTLS_recv;
+        transport.writev = MbedTLS_Writev;
+    #endif
 
     /* Fill the values for network buffer. */
-    networkBuffer.pBuffer = buffer;
+    #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+        networkBuffer.pBuffer = NetworkBufferPool_Alloc( "mqtt",
+                                                         NETWORK_BUFFER_SIZE,
+                                                         CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_WAIT_MS );
+    #else
+        networkBuffer.pBuffer = buffer;
+    #endif
     networkBuffer.size = NETWORK_BUFFER_SIZE;
 
     /* Initialize MQTT library. */
@@ -1344,6 +1298,27 @@ static int initializeMqtt( MQTTContext_t * pMqttContext,
 
 /*-----------------------------------------------------------*/
 
+static MQTTStatus_t processLoopIdle( MQTTContext_t * pMqttContext,
+                                     uint32_t timeoutMs )
+{
+    NetworkContext_t * pNetworkContext = pMqttContext->transportInterface.pNetworkContext;
+
+    #if defined( CONFIG_AWS_IOT_TLS_SOCKETS_TRANSPORT )
+        /* The TLS sockets of Zephyr poll readable for decrypted data. */
+        return MqttIdle_ProcessLoop( pMqttContext,
+                                     pNetworkContext->pParams->socketDescriptor,
+                                     NULL,
+                                     timeoutMs );
+    #else
+        return MqttIdle_ProcessLoop( pMqttContext,
+                                     pNetworkContext->pParams->tcpSocket,
+                                     MbedTLS_HasPendingData,
+                                     timeoutMs );
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
 static int subscribePublishLoop( MQTTContext_t * pMqttContext )
 {
     int returnStatus = EXIT_SUCCESS;
@@ -1376,7 +1351,7 @@ static int subscribePublishLoop( MQTTContext_t * pMqttContext )
          * of receiving publish message before subscribe ack is zero; but application
          * must be ready to receive any packet. This demo uses MQTT_ProcessLoop to
          * receive packet from network. */
-        mqttStatus = MQTT_ProcessLoop( pMqttContext, MQTT_PROCESS_LOOP_TIMEOUT_MS );
+        mqttStatus = processLoopIdle( pMqttContext, MQTT_PROCESS_LOOP_TIMEOUT_MS );
 
         if( mqttStatus != MQTTSuccess )
         {
@@ -1416,7 +1391,7 @@ static int subscribePublishLoop( MQTTContext_t * pMqttContext )
              * sends ping request to broker if MQTT_KEEP_ALIVE_INTERVAL_SECONDS
              * has expired since the last MQTT packet sent and receive
              * ping responses. */
-            mqttStatus = MQTT_ProcessLoop( pMqttContext, MQTT_PROCESS_LOOP_TIMEOUT_MS );
+            mqttStatus = processLoopIdle( pMqttContext, MQTT_PROCESS_LOOP_TIMEOUT_MS );
 
             /* For any error in #MQTT_ProcessLoop, exit the loop and disconnect
              * from the broker. */
@@ -1430,8 +1405,17 @@ static int subscribePublishLoop( MQTTContext_t * pMqttContext )
 
             LogInfo( ( "Delay before continuing to next iteration.\n\n" ) );
 
-            /* Leave connection idle for some time. */
-            k_sleep( K_SECONDS( DELAY_BETWEEN_PUBLISHES_SECONDS ) );
+            /* Leave connection idle for some time. The thread sleeps until
+             * the broker sends something or a keep-alive action is due. */
+            mqttStatus = processLoopIdle( pMqttContext, DELAY_BETWEEN_PUBLISHES_SECONDS * 1000U );
+
+            if( mqttStatus != MQTTSuccess )
+            {
+                LogError( ( "MQTT_ProcessLoop returned with status = %s.",
+                            MQTT_Status_strerror( mqttStatus ) ) );
+                returnStatus = EXIT_FAILURE;
+                break;
+            }
         }
     }
 
@@ -1447,7 +1431,7 @@ static int subscribePublishLoop( MQTTContext_t * pMqttContext )
     if( returnStatus == EXIT_SUCCESS )
     {
         /* Process Incoming UNSUBACK packet from the broker. */
-        mqttStatus = MQTT_ProcessLoop( pMqttContext, MQTT_PROCESS_LOOP_TIMEOUT_MS );
+        mqttStatus = processLoopIdle( pMqttContext, MQTT_PROCESS_LOOP_TIMEOUT_MS );
 
         if( mqttStatus != MQTTSuccess )
         {
@@ -1488,7 +1472,12 @@ static int start_mutual_auth_demo()
     int returnStatus = EXIT_SUCCESS;
     MQTTContext_t mqttContext = { 0 };
     NetworkContext_t networkContext = { 0 };
-    TlsTransportParams_t tlsTransportParams = { 0 };
+
+    #if defined( CONFIG_AWS_IOT_TLS_SOCKETS_TRANSPORT )
+        TlsSocketsParams_t tlsTransportParams = { 0 };
+    #else
+        TlsTransportParams_t tlsTransportParams = { 0 };
+    #endif
     bool clientSessionPresent = false, brokerSessionPresent = false;
 
     /* Set the pParams member of the network context with desired transport. */
@@ -1507,7 +1496,26 @@ static int start_mutual_auth_demo()
              * attempts are reached or maximum timeout value is reached. The function
              * returns EXIT_FAILURE if the TCP connection cannot be established to
              * broker after configured number of attempts. */
-            returnStatus = connectToServerWithBackoffRetries( &networkContext, &mqttContext, &clientSessionPresent, &brokerSessionPresent );
+            #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+                /* The buffer of the shared pool is only held while connected;
+                 * the first connection uses the one of initializeMqtt(). The
+                 * session state of coreMQTT is kept outside of it. */
+                if( mqttContext.networkBuffer.pBuffer == NULL )
+                {
+                    mqttContext.networkBuffer.pBuffer = NetworkBufferPool_Alloc( "mqtt",
+                                                                                 NETWORK_BUFFER_SIZE,
+                                                                                 CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_WAIT_MS );
+                }
+
+                returnStatus = EXIT_FAILURE;
+
+                if( mqttContext.networkBuffer.pBuffer != NULL )
+                {
+                    returnStatus = connectToServerWithBackoffRetries( &networkContext, &mqttContext, &clientSessionPresent, &brokerSessionPresent );
+                }
+            #else
+                returnStatus = connectToServerWithBackoffRetries( &networkContext, &mqttContext, &clientSessionPresent, &brokerSessionPresent );
+            #endif
 
             if( returnStatus == EXIT_FAILURE )
             {
@@ -1533,7 +1541,7 @@ static int start_mutual_auth_demo()
                                "Resending unacked publishes." ) );
 
                     /* Handle all the resend of publish messages. */
-                    returnStatus = handlePublishResend( &mqttContext );
+                    returnStatus = ( OutgoingPublish_Resend( &outgoingPublishes, &mqttContext ) == MQTTSuccess ) ? EXIT_SUCCESS : EXIT_FAILURE;
                 }
                 else
                 {
@@ -1542,7 +1550,7 @@ static int start_mutual_auth_demo()
 
                     /* Clean up the outgoing publishes waiting for ack as this new
                      * connection doesn't re-establish an existing session. */
-                    cleanupOutgoingPublishes();
+                    OutgoingPublish_RemoveAll( &outgoingPublishes );
                 }
 
                 /* If TLS session is established, execute Subscribe/Publish loop. */
@@ -1556,7 +1564,13 @@ static int start_mutual_auth_demo()
             }
 
             /* End TLS session, then close TCP connection. */
-            ( void ) MbedTLS_Disconnect( &networkContext );
+            disconnectTls( &networkContext );
+
+            #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+                /* Let the other clients use the buffer until the next connection. */
+                NetworkBufferPool_Free( mqttContext.networkBuffer.pBuffer );
+                mqttContext.networkBuffer.pBuffer = NULL;
+            #endif
 
             LogInfo( ( "Short delay before starting the next iteration....\n" ) );
             k_sleep( K_SECONDS( MQTT_SUBPUB_LOOP_DELAY_SECONDS ) );
@@ -408,7 +408,8 @@ static int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext
         socketStatus = Plaintext_Connect( pNetworkContext,
                                           &serverInfo,
                                           TRANSPORT_SEND_RECV_TIMEOUT_MS,
-                                          TRANSPORT_SEND_RECV_TIMEOUT_MS );
+                                          TRANSPORT_SEND_RECV_TIMEOUT_MS,
+                                          NULL );
 
         if( socketStatus == SOCKETS_SUCCESS )
         {
@@ -684,6 +685,7 @@ static int establishMqttSession( MQTTContext_t * pMqttContext,
     transport.pNetworkContext = pNetworkContext;
     transport.send = Plaintext_Send;
     transport.recv = Plaintext_Recv;
+    transport.writev = Plaintext_Writev;
 
     /* Fill the values for network buffer. */
     networkBuffer.pBuffer = buffer;
@@ -42,7 +42,7 @@
 #endif
 
 #ifndef LIBRARY_LOG_LEVEL
-    #define LIBRARY_LOG_LEVEL    LOG_DEBUG
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
 #endif
 //#define LIBRARY_LOG_NAME "MQTT AGENT"
 //#define LIBRARY_LOG_LEVEL   LOG_DEBUG
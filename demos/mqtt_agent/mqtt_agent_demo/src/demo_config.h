@@ -31,6 +31,11 @@
 #define NUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE    1
 #define SIMPLE_SUB_PUB_TASK_STACK_SIZE        ( MINIMAL_STACK_SIZE )
 
+/* Stack size of the MQTT agent task. The peak use of each stack is reported by
+ * the "sdk_threads" shell command when CONFIG_AWS_IOT_MQTT_AGENT_THREAD_PROFILER
+ * is enabled, to size both stacks. */
+#define MQTT_AGENT_TASK_STACK_SIZE            ( MINIMAL_STACK_SIZE )
+
 /**
  * @brief The MQTT client identifier used in this example.  Each client identifier
  * must be unique so edit as required to ensure no two clients connecting to the
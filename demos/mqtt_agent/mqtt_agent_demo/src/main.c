@@ -49,7 +49,6 @@
 #include <zephyr.h>
 
 /* Zephyr includes */
-#include <random/rand32.h>
 #include <net/socket.h>
 
 /* Demo Specific configs. */
@@ -61,12 +60,38 @@
 /* MQTT Agent ports. */
 #include "agent_interface_zephyr.h"
 
-/* Exponential backoff retry include. */
-#include "backoff_algorithm.h"
+/* Decorrelated jitter reconnect delays. */
+#include "reconnect_scheduler.h"
 
 /* Subscription manager header include. */
 #include "subscription_manager.h"
 
+/* Packs the subscriptions into few SUBSCRIBE packets after a reconnect. */
+#include "resubscribe.h"
+
+#if defined( CONFIG_AWS_IOT_MQTT_AGENT_PUBLISH_DISPATCHER )
+    /* Runs the subscription callbacks on worker threads. */
+    #include "publish_dispatcher.h"
+#endif
+
+#if defined( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER )
+    /* Serves the agents of several connections from one thread. */
+    #include "agent_runner_zephyr.h"
+#endif
+
+#if defined( CONFIG_AWS_IOT_MQTT_AGENT_OFFLINE_QUEUE )
+    /* Keeps the publishes made while disconnected in flash. */
+    #include "offline_queue.h"
+#endif
+
+#if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+    /* Network buffers shared with the other clients. */
+    #include "network_buffer_pool.h"
+#endif
+
+/* Stack and CPU profiling of the threads. */
+#include "thread_profiler_zephyr.h"
+
 /* Transport interface implementation include header for TLS. */
 #include "mbedtls_zephyr.h"
 
@@ -113,6 +138,49 @@
     #define MQTT_AGENT_NETWORK_BUFFER_SIZE    ( 5000 )
 #endif
 
+/**
+ * @brief Size of the read-ahead buffer of the TLS transport, which serves the
+ * small reads coreMQTT makes for each incoming packet header from memory.
+ * @note Specified in bytes. Set to 0 to read directly from the connection.
+ */
+#ifndef MQTT_AGENT_READ_AHEAD_BUFFER_SIZE
+    #define MQTT_AGENT_READ_AHEAD_BUFFER_SIZE    ( 256 )
+#endif
+
+/**
+ * @brief Size of the buffer in which the packets of consecutive QoS 0
+ * publishes are coalesced into one transport send, when
+ * CONFIG_AWS_IOT_MQTT_AGENT_COALESCE_PUBLISHES is enabled.
+ * @note Specified in bytes.
+ */
+#ifndef MQTT_AGENT_COALESCE_BUFFER_SIZE
+    #define MQTT_AGENT_COALESCE_BUFFER_SIZE    ( 1024 )
+#endif
+
+/**
+ * @brief Stack size of the MQTT agent task.
+ * @note Specified in bytes.
+ */
+#ifndef MQTT_AGENT_TASK_STACK_SIZE
+    #define MQTT_AGENT_TASK_STACK_SIZE    ( SIMPLE_SUB_PUB_TASK_STACK_SIZE )
+#endif
+
+/**
+ * @brief Topic to which the thread profiles are published, when
+ * CONFIG_AWS_IOT_MQTT_AGENT_THREAD_PROFILER is enabled.
+ */
+#ifndef THREAD_PROFILE_TOPIC
+    #define THREAD_PROFILE_TOPIC    CLIENT_IDENTIFIER "/diagnostics/threads"
+#endif
+
+/**
+ * @brief Size of the buffer holding the JSON payload of the thread profiles.
+ * @note Specified in bytes. Profiles that do not fit are not published.
+ */
+#ifndef THREAD_PROFILE_PAYLOAD_SIZE
+    #define THREAD_PROFILE_PAYLOAD_SIZE    ( 512 )
+#endif
+
 /**
  * @brief The length of the queue used to hold commands for the agent.
  */
@@ -228,32 +296,15 @@ static MQTTStatus_t mqttAgentInit( void );
  */
 static MQTTStatus_t mqttConnect( bool cleanSession );
 
-/**
- * @brief Calculate and perform an exponential backoff with jitter delay for
- * the next retry attempt of a failed network operation with the server.
- *
- * The function generates a random number, calculates the next backoff period
- * with the generated random number, and performs the backoff delay operation if the
- * number of retries have not exhausted.
- *
- * @note The backoff period is calculated using the backoffAlgorithm library.
- *
- * @param[in, out] pRetryParams The context to use for backoff period calculation
- * with the backoffAlgorithm library.
- *
- * @return true if calculating the backoff period was successful; otherwise false
- * if there was failure in random number generation OR all retry attempts had exhausted.
- */
-static bool backoffForRetry( BackoffAlgorithmContext_t * pRetryParams );
-
 /**
  * @brief Connect a TCP socket to the MQTT broker.
  *
  * @param[in] pNetworkContext Network context.
  *
- * @return true if connection succeeds, else false.
+ * @return #TLS_TRANSPORT_SUCCESS if connection succeeds, else the status of
+ * MbedTLS_Connect().
  */
-static bool socketConnect( NetworkContext_t * pNetworkContext );
+static TlsTransportStatus_t socketConnect( NetworkContext_t * pNetworkContext );
 
 /**
  * @brief Disconnect a TCP connection.
@@ -284,7 +335,8 @@ static void incomingPublishCallback( MQTTAgentContext_t * pMqttAgentContext,
  * This function will be invoked when this demo requests the broker to
  * reestablish the session and the broker cannot do so. This function will
  * enqueue commands to the MQTT Agent queue and will be processed once the
- * command loop starts.
+ * command loop starts. The topic filters are packed into as few SUBSCRIBE
+ * packets as fit in the network buffer, by the engine of resubscribe.h.
  *
  * @return `MQTTSuccess` if adding subscribes to the command queue succeeds, else
  * appropriate error code from MQTTAgent_Subscribe.
@@ -292,18 +344,53 @@ static void incomingPublishCallback( MQTTAgentContext_t * pMqttAgentContext,
 static MQTTStatus_t handleResubscribe( void );
 
 /**
- * @brief Passed into MQTTAgent_Subscribe() as the callback to execute when the
- * broker ACKs the SUBSCRIBE message. This callback implementation is used for
- * handling the completion of resubscribes. Any topic filter failed to resubscribe
+ * @brief Called by the resubscribe engine with the SUBACK result of each topic
+ * filter of the subscription list. Any topic filter failed to resubscribe
  * will be removed from the subscription list.
  *
- * See https://freertos.org/mqtt/mqtt-agent-demo.html#example_mqtt_api_call
+ * @param[in] pContext Context of the resubscribe. Not used in this example.
+ * @param[in] pSubscription Subscription holding the topic filter.
+ * @param[in] subackStatus SUBACK result of the topic filter.
+ */
+static void resubscribeFilterCallback( void * pContext,
+                                       const SubscriptionElement_t * pSubscription,
+                                       MQTTSubAckStatus_t subackStatus );
+
+/**
+ * @brief Clean up after MQTTAgent_CommandLoop() returns, and reconnect the TCP
+ * and MQTT connections if it returned an error. With
+ * CONFIG_AWS_IOT_MQTT_AGENT_RUNNER, the connections are re-established by
+ * #reconnectWork instead, as the runner thread serves other connections.
+ *
+ * @param[in] pMqttAgentContext The agent whose command loop returned.
+ * @param[in] mqttStatus Status returned by MQTTAgent_CommandLoop().
  *
- * @param[in] pCommandContext Context of the initial command.
- * @param[in] pReturnInfo The result of the command.
+ * @return `true` if the connection was re-established and the command loop
+ * must run again, or is being re-established for the runner, `false`
+ * otherwise.
  */
-static void subscriptionCommandCallback( MQTTAgentCommandContext_t * pCommandContext,
-                                         MQTTAgentReturnInfo_t * pReturnInfo );
+static bool handleCommandLoopExit( MQTTAgentContext_t * pMqttAgentContext,
+                                   MQTTStatus_t mqttStatus );
+
+/**
+ * @brief Disconnect the socket, and reconnect the TCP and MQTT connections.
+ *
+ * @param[in] pMqttAgentContext The agent of the connection.
+ *
+ * @return `true` if the connection was re-established, `false` otherwise.
+ */
+static bool reconnect( MQTTAgentContext_t * pMqttAgentContext );
+
+#if defined( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER )
+
+/**
+ * @brief Work handler re-establishing the connection after an error, then
+ * handing it back to the runner, or removing it from the runner.
+ *
+ * @param[in] pWork The work item.
+ */
+    static void reconnectWorkHandler( struct k_work * pWork );
+#endif
 
 /**
  * @brief Task used to run the MQTT agent.  In this example the first task that
@@ -313,7 +400,8 @@ static void subscriptionCommandCallback( MQTTAgentCommandContext_t * pCommandCon
  *
  * This task calls MQTTAgent_CommandLoop() in a loop, until MQTTAgent_Terminate()
  * is called. If an error occurs in the command loop, then it will reconnect the
- * TCP and MQTT connections.
+ * TCP and MQTT connections. With CONFIG_AWS_IOT_MQTT_AGENT_RUNNER, the task
+ * runs the agent through the runner of agent_runner_zephyr.h instead.
  *
  * @param[in] pParameters Parameters as passed at the time of task creation. Not
  * used in this example.
@@ -353,6 +441,33 @@ static uint32_t getTimeMs( void );
  */
 static bool connectToMQTTBroker( bool createCleanSession );
 
+#if ( THREAD_PROFILING == 1 )
+
+/**
+ * @brief Called by the thread profiler at the end of each period, to publish
+ * the profiles to #THREAD_PROFILE_TOPIC with QoS 0.
+ *
+ * The profiles of a period are dropped while the publish of the previous ones
+ * is in flight, or when the agent queue is full.
+ *
+ * @param[in] pProfiles Profiles of the registered threads.
+ * @param[in] count Number of profiles.
+ * @param[in] pContext Not used.
+ */
+    static void publishThreadProfiles( const ThreadProfile_t * pProfiles,
+                                       size_t count,
+                                       void * pContext );
+
+/**
+ * @brief Completion callback of the publish of the thread profiles.
+ *
+ * @param[in] pCommandContext Not used.
+ * @param[in] pReturnInfo Not used.
+ */
+    static void threadProfilesPublished( MQTTAgentCommandContext_t * pCommandContext,
+                                         MQTTAgentReturnInfo_t * pReturnInfo );
+#endif
+
 /*
  * Function that starts the tasks demonstrated by this project.
  */
@@ -374,6 +489,17 @@ static NetworkContext_t networkContext;
  */
 static TlsTransportParams_t secureSocketsTransportParams;
 
+/**
+ * @brief Credentials parsed on the first connection and reused by every
+ * reconnection.
+ */
+static TlsCredentialStore_t credentialStore;
+
+/**
+ * @brief Whether #credentialStore has been loaded.
+ */
+static bool credentialStoreLoaded = false;
+
 /**
  * @brief Global entry time into the application to use as a reference timestamp
  * in the #getTimeMs function. #getTimeMs will always return the difference
@@ -387,10 +513,39 @@ static uint32_t globalEntryTimeMs;
  */
 MQTTAgentContext_t globalMqttAgentContext;
 
+#if !defined( CONFIG_AWS_IOT_MQTT_AGENT_PUBLISH_DISPATCHER )
+    #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+
+/**
+ * @brief Network buffer for coreMQTT, taken from the shared pool by the first
+ * initialization of the agent and kept for as long as it runs. The publish
+ * dispatcher provides its own.
+ */
+        static uint8_t * pNetworkBuffer = NULL;
+    #else
+
+/**
+ * @brief Network buffer for coreMQTT. The publish dispatcher provides its own.
+ */
+        static uint8_t networkBuffer[ MQTT_AGENT_NETWORK_BUFFER_SIZE ];
+    #endif
+#endif
+
+#if ( AGENT_COALESCE_PUBLISHES == 1 )
+
+/**
+ * @brief Buffer coalescing the packets of consecutive QoS 0 publishes.
+ */
+    static uint8_t coalesceBuffer[ MQTT_AGENT_COALESCE_BUFFER_SIZE ];
+#endif
+
+#if ( MQTT_AGENT_READ_AHEAD_BUFFER_SIZE > 0 )
+
 /**
- * @brief Network buffer for coreMQTT.
+ * @brief Read-ahead buffer of the TLS transport.
  */
-static uint8_t networkBuffer[ MQTT_AGENT_NETWORK_BUFFER_SIZE ];
+    static uint8_t readAheadBuffer[ MQTT_AGENT_READ_AHEAD_BUFFER_SIZE ];
+#endif
 
 /**
  * @brief Message queue used to deliver commands to the agent task.
@@ -425,12 +580,46 @@ char __aligned( 8 ) commandQueueBuffer[ MQTT_AGENT_COMMAND_QUEUE_LENGTH * sizeof
 
 extern struct k_thread simpleSubPubThreads[ NUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE ];
 
+#if ( THREAD_PROFILING == 1 )
+
+/**
+ * @brief JSON payload of the thread profiles, kept until the publish completes.
+ */
+    static char threadProfilePayload[ THREAD_PROFILE_PAYLOAD_SIZE ];
+
+/**
+ * @brief Publish information of the thread profiles, kept until the publish
+ * completes.
+ */
+    static MQTTPublishInfo_t threadProfilePublishInfo;
+
+/**
+ * @brief Set while the publish of the thread profiles is in flight.
+ */
+    static atomic_t threadProfilePublishInFlight;
+#endif
+
 /*-----------------------------------------------------------*/
 
 /**
  * @brief Define mqttAgentStackArea as the stack area for the MQTT Agent thread.
  */
-K_THREAD_STACK_DEFINE( mqttAgentStackArea, SIMPLE_SUB_PUB_TASK_STACK_SIZE );
+K_THREAD_STACK_DEFINE( mqttAgentStackArea, MQTT_AGENT_TASK_STACK_SIZE );
+
+#if defined( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER )
+
+/**
+ * @brief Work queue re-establishing the connection after an error, so that
+ * the runner keeps serving its other connections meanwhile, and its stack.
+ */
+    static struct k_work_q reconnectQueue;
+    K_THREAD_STACK_DEFINE( reconnectStackArea, MQTT_AGENT_TASK_STACK_SIZE );
+
+/**
+ * @brief Work item re-establishing the connection.
+ */
+    static struct k_work reconnectWork;
+#endif
 
 /*-----------------------------------------------------------*/
 
@@ -477,7 +666,7 @@ static MQTTStatus_t mqttAgentInit( void )
 {
     TransportInterface_t transport;
     MQTTStatus_t mqttStatus;
-    MQTTFixedBuffer_t fixedBuffer = { .pBuffer = networkBuffer, .size = MQTT_AGENT_NETWORK_BUFFER_SIZE };
+    MQTTFixedBuffer_t fixedBuffer = { 0 };
     MQTTAgentMessageInterface_t messageInterface =
     {
         .pMsgCtx        = NULL,
@@ -488,15 +677,49 @@ static MQTTStatus_t mqttAgentInit( void )
     };
 
     LogDebug( ( "Creating command queue." ) );
-    k_msgq_init( &( commandQueue.queue ), commandQueueBuffer, sizeof( MQTTAgentCommand_t * ), MQTT_AGENT_COMMAND_QUEUE_LENGTH );
+    Agent_MessageContextInit( &commandQueue, commandQueueBuffer, MQTT_AGENT_COMMAND_QUEUE_LENGTH );
     messageInterface.pMsgCtx = &commandQueue;
 
     Agent_InitializePool();
 
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER )
+        AgentRunner_Init();
+    #endif
+
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_PUBLISH_DISPATCHER )
+        PublishDispatcher_Init( &fixedBuffer );
+    #elif defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+        /* A retried initialization reuses the buffer. MQTTAgent_Init() fails
+         * without one. */
+        if( pNetworkBuffer == NULL )
+        {
+            pNetworkBuffer = NetworkBufferPool_Alloc( "mqtt_agent",
+                                                      MQTT_AGENT_NETWORK_BUFFER_SIZE,
+                                                      CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_WAIT_MS );
+        }
+
+        fixedBuffer.pBuffer = pNetworkBuffer;
+        fixedBuffer.size = MQTT_AGENT_NETWORK_BUFFER_SIZE;
+    #else
+        fixedBuffer.pBuffer = networkBuffer;
+        fixedBuffer.size = MQTT_AGENT_NETWORK_BUFFER_SIZE;
+    #endif
+
     /* Fill in Transport Interface send and receive function pointers. */
     transport.pNetworkContext = &networkContext;
     transport.send = MbedTLS_send;
     transport.recv = MbedTLS_recv;
+    transport.writev = MbedTLS_Writev;
+
+    #if ( AGENT_COALESCE_PUBLISHES == 1 )
+        /* Send consecutive QoS 0 publishes together. */
+        Agent_EnableCoalescing( &commandQueue, &transport, coalesceBuffer, sizeof( coalesceBuffer ) );
+    #endif
+
+    #if ( AGENT_LATENCY_TRACING == 1 )
+        /* Time the network send of each command. */
+        Agent_EnableLatencyTracing( &commandQueue, &transport );
+    #endif
 
     /* Initialize MQTT library. */
     mqttStatus = MQTTAgent_Init( &globalMqttAgentContext,
@@ -508,6 +731,15 @@ static MQTTStatus_t mqttAgentInit( void )
                                  /* Context to pass into the callback. Passing the pointer to subscription array. */
                                  globalSubscriptionList );
 
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_OFFLINE_QUEUE )
+        if( mqttStatus == MQTTSuccess )
+        {
+            /* The demo runs without the offline queue if the flash cannot be
+             * used. */
+            ( void ) OfflineQueue_Init( &globalMqttAgentContext );
+        }
+    #endif
+
     return mqttStatus;
 }
 
@@ -594,55 +826,18 @@ static MQTTStatus_t mqttConnect( bool cleanSession )
 static MQTTStatus_t handleResubscribe( void )
 {
     MQTTStatus_t mqttStatus = MQTTBadParameter;
-    uint32_t index = 0U;
-    uint16_t numSubscriptions = 0U;
-
-    /* These variables need to stay in scope until command completes. */
-    static MQTTAgentSubscribeArgs_t subArgs = { 0 };
-    static MQTTSubscribeInfo_t subInfo[ SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ] = { 0 };
-    static MQTTAgentCommandInfo_t commandParams = { 0 };
-
-    /* Loop through each subscription in the subscription list and add a subscribe
-     * command to the command queue. */
-    for( index = 0U; index < SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; index++ )
-    {
-        /* Check if there is a subscription in the subscription list. This demo
-         * doesn't check for duplicate subscriptions. */
-        if( globalSubscriptionList[ index ].filterStringLength != 0 )
-        {
-            subInfo[ numSubscriptions ].pTopicFilter = globalSubscriptionList[ index ].pSubscriptionFilterString;
-            subInfo[ numSubscriptions ].topicFilterLength = globalSubscriptionList[ index ].filterStringLength;
 
-            /* QoS1 is used for all the subscriptions in this demo. */
-            subInfo[ numSubscriptions ].qos = MQTTQoS1;
-
-            LogInfo( ( "Resubscribe to the topic %.*s will be attempted.",
-                       subInfo[ numSubscriptions ].topicFilterLength,
-                       subInfo[ numSubscriptions ].pTopicFilter ) );
-
-            numSubscriptions++;
-        }
-    }
-
-    if( numSubscriptions > 0U )
-    {
-        subArgs.pSubscribeInfo = subInfo;
-        subArgs.numSubscriptions = numSubscriptions;
-
-        /* The block time can be 0 as the command loop is not running at this point. */
-        commandParams.blockTimeMs = 0U;
-        commandParams.cmdCompleteCallback = subscriptionCommandCallback;
-        commandParams.pCmdCompleteCallbackContext = ( void * ) &subArgs;
-
-        /* Enqueue subscribe to the command queue. These commands will be processed only
-         * when command loop starts. */
-        mqttStatus = MQTTAgent_Subscribe( &globalMqttAgentContext, &subArgs, &commandParams );
-    }
-    else
-    {
-        /* Mark the resubscribe as success if there is nothing to be subscribed. */
-        mqttStatus = MQTTSuccess;
-    }
+    /* QoS1 is used for all the subscriptions in this demo. The SUBSCRIBE
+     * commands will be processed only when command loop starts. The packets
+     * must fit the network buffer actually given to the agent, which the
+     * publish dispatcher may provide. */
+    mqttStatus = Resubscribe_Start( &globalMqttAgentContext,
+                                    globalSubscriptionList,
+                                    MQTTQoS1,
+                                    globalMqttAgentContext.mqttContext.networkBuffer.size,
+                                    resubscribeFilterCallback,
+                                    NULL,
+                                    NULL );
 
     if( mqttStatus != MQTTSuccess )
     {
@@ -655,78 +850,34 @@ static MQTTStatus_t handleResubscribe( void )
 
 /*-----------------------------------------------------------*/
 
-static void subscriptionCommandCallback( MQTTAgentCommandContext_t * pCommandContext,
-                                         MQTTAgentReturnInfo_t * pReturnInfo )
+static void resubscribeFilterCallback( void * pContext,
+                                       const SubscriptionElement_t * pSubscription,
+                                       MQTTSubAckStatus_t subackStatus )
 {
-    size_t index = 0;
-    MQTTAgentSubscribeArgs_t * pSubscribeArgs = ( MQTTAgentSubscribeArgs_t * ) pCommandContext;
+    ( void ) pContext;
 
-    /* If the return code is success, no further action is required as all the topic filters
-     * are already part of the subscription list. */
-    if( pReturnInfo->returnCode != MQTTSuccess )
+    /* This demo doesn't attempt to resubscribe in the event that a SUBACK failed. */
+    if( subackStatus == MQTTSubAckFailure )
     {
-        /* Check through each of the suback codes and determine if there are any failures. */
-        for( index = 0; index < pSubscribeArgs->numSubscriptions; index++ )
-        {
-            /* This demo doesn't attempt to resubscribe in the event that a SUBACK failed. */
-            if( pReturnInfo->pSubackCodes[ index ] == MQTTSubAckFailure )
-            {
-                LogError( ( "Failed to resubscribe to topic %.*s.",
-                            pSubscribeArgs->pSubscribeInfo[ index ].topicFilterLength,
-                            pSubscribeArgs->pSubscribeInfo[ index ].pTopicFilter ) );
-                /* Remove subscription callback for unsubscribe. */
-                removeSubscription( globalSubscriptionList,
-                                    pSubscribeArgs->pSubscribeInfo[ index ].pTopicFilter,
-                                    pSubscribeArgs->pSubscribeInfo[ index ].topicFilterLength );
-            }
-        }
+        LogError( ( "Failed to resubscribe to topic %.*s.",
+                    pSubscription->filterStringLength,
+                    pSubscription->pSubscriptionFilterString ) );
+        /* Remove subscription callback for unsubscribe. */
+        removeSubscription( globalSubscriptionList,
+                            pSubscription->pSubscriptionFilterString,
+                            pSubscription->filterStringLength );
     }
 }
 
 /*-----------------------------------------------------------*/
 
-static bool backoffForRetry( BackoffAlgorithmContext_t * pRetryParams )
-{
-    bool returnStatus = false;
-    uint16_t nextRetryBackOff = 0U;
-    BackoffAlgorithmStatus_t backoffAlgStatus = BackoffAlgorithmSuccess;
-
-    /**
-     * To calculate the backoff period for the next retry attempt, we will
-     * generate a random number to provide to the backoffAlgorithm library.
-     */
-    uint32_t randomNum = sys_rand32_get();
-
-    /* Get back-off value (in milliseconds) for the next retry attempt. */
-    backoffAlgStatus = BackoffAlgorithm_GetNextBackoff( pRetryParams, randomNum, &nextRetryBackOff );
-
-    if( backoffAlgStatus == BackoffAlgorithmRetriesExhausted )
-    {
-        LogError( ( "All retry attempts have exhausted. Operation will not be retried" ) );
-    }
-    else if( backoffAlgStatus == BackoffAlgorithmSuccess )
-    {
-        /* Perform the backoff delay. */
-        k_sleep( K_MSEC( nextRetryBackOff ) );
-
-        returnStatus = true;
-
-        LogInfo( ( "Retry attempt %d out of maximum retry attempts %d.",
-                   ( pRetryParams->attemptsDone + 1 ),
-                   pRetryParams->maxRetryAttempts ) );
-    }
-
-    return returnStatus;
-}
-
-/*-----------------------------------------------------------*/
-
-static bool socketConnect( NetworkContext_t * pNetworkContext )
+static TlsTransportStatus_t socketConnect( NetworkContext_t * pNetworkContext )
 {
     bool connected = false;
     TlsTransportStatus_t networkStatus = TLS_TRANSPORT_SUCCESS;
     ServerInfo_t serverInfo = { 0 };
     NetworkCredentials_t networkCredentials = { 0 };
+    SocketsConfig_t socketsConfig = { 0 };
     /* Set the receive timeout to a small nonzero value. */
     const uint32_t transportTimeout = 1U;
 
@@ -740,6 +891,21 @@ static bool socketConnect( NetworkContext_t * pNetworkContext )
     networkCredentials.pRootCa = ROOT_CA_PEM;
     networkCredentials.rootCaSize = sizeof( ROOT_CA_PEM );
 
+    /* Send the small packets of the agent without waiting to coalesce them. */
+    socketsConfig.noDelay = true;
+
+    /* Parse the credentials only once, so that reconnections do not repeat it. */
+    if( credentialStoreLoaded == false )
+    {
+        credentialStoreLoaded = ( MbedTLS_LoadCredentials( &credentialStore,
+                                                           &networkCredentials ) == TLS_TRANSPORT_SUCCESS );
+    }
+
+    if( credentialStoreLoaded == true )
+    {
+        networkCredentials.pCredentialStore = &credentialStore;
+    }
+
     /* Establish a TCP connection with the MQTT broker. This example connects to
      * the MQTT broker as specified in MQTT_BROKER_ENDPOINT and
      * MQTT_BROKER_PORT at the top of this file. */
@@ -747,10 +913,23 @@ static bool socketConnect( NetworkContext_t * pNetworkContext )
                MQTT_BROKER_ENDPOINT,
                MQTT_BROKER_PORT ) );
 
-    networkStatus = MbedTLS_Connect( pNetworkContext, &serverInfo, &networkCredentials, TRANSPORT_SEND_RECV_TIMEOUT_MS, TRANSPORT_SEND_RECV_TIMEOUT_MS );
+    networkStatus = MbedTLS_Connect( pNetworkContext, &serverInfo, &networkCredentials, TRANSPORT_SEND_RECV_TIMEOUT_MS, TRANSPORT_SEND_RECV_TIMEOUT_MS, &socketsConfig );
 
     connected = ( networkStatus == TLS_TRANSPORT_SUCCESS );
 
+    #if ( MBEDTLS_ZEPHYR_ARENA_SIZE > 0U )
+        if( connected )
+        {
+            MbedTLSArenaUsage_t memoryUsage;
+
+            /* Report the peak memory of the handshake, to size the arena. */
+            MbedTLSArena_GetUsage( &( pNetworkContext->pParams->memoryUsage ), &memoryUsage );
+            LogInfo( ( "TLS connection memory: Current=%u, Peak=%u bytes.",
+                       ( unsigned int ) memoryUsage.currentBytes,
+                       ( unsigned int ) memoryUsage.peakBytes ) );
+        }
+    #endif
+
     /* Set the socket wakeup callback and ensure the read block time. */
     if( connected )
     {
@@ -759,9 +938,16 @@ static bool socketConnect( NetworkContext_t * pNetworkContext )
                           SO_RCVTIMEO,
                           &( K_TICKS( transportTimeout ) ),
                           sizeof( k_timeout_t ) );
+
+        /* Let the agent sleep until a command is queued or data arrives,
+         * instead of waking up periodically to poll the socket. */
+        Agent_SetNetworkSocket( &commandQueue,
+                                pNetworkContext->pParams->tcpSocket,
+                                pNetworkContext,
+                                MbedTLS_HasPendingData );
     }
 
-    return connected;
+    return networkStatus;
 }
 
 /*-----------------------------------------------------------*/
@@ -769,6 +955,12 @@ static bool socketConnect( NetworkContext_t * pNetworkContext )
 static bool socketDisconnect( NetworkContext_t * pNetworkContext )
 {
     LogInfo( ( "Disconnecting TLS connection.\n" ) );
+
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_OFFLINE_QUEUE )
+        OfflineQueue_SetConnected( false );
+    #endif
+
+    Agent_SetNetworkSocket( &commandQueue, -1, NULL, NULL );
     MbedTLS_Disconnect( pNetworkContext );
 
     return true;
@@ -787,8 +979,13 @@ static void incomingPublishCallback( MQTTAgentContext_t * pMqttAgentContext,
 
     /* Fan out the incoming publishes to the callbacks registered using
      * subscription manager. */
-    publishHandled = handleIncomingPublishes( ( SubscriptionElement_t * ) pMqttAgentContext->pIncomingCallbackContext,
-                                              pPublishInfo );
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_PUBLISH_DISPATCHER )
+        publishHandled = PublishDispatcher_Dispatch( ( SubscriptionElement_t * ) pMqttAgentContext->pIncomingCallbackContext,
+                                                     pPublishInfo );
+    #else
+        publishHandled = handleIncomingPublishes( ( SubscriptionElement_t * ) pMqttAgentContext->pIncomingCallbackContext,
+                                                  pPublishInfo );
+    #endif
 
     /* If there are no callbacks to handle the incoming publishes,
      * handle it as an unsolicited publish. */
@@ -806,62 +1003,128 @@ static void incomingPublishCallback( MQTTAgentContext_t * pMqttAgentContext,
 
 /*-----------------------------------------------------------*/
 
-static void mqttAgentTask( void * pParameters,
-                           void * b,
-                           void * c )
+static bool handleCommandLoopExit( MQTTAgentContext_t * pMqttAgentContext,
+                                   MQTTStatus_t mqttStatus )
+{
+    bool runAgain = false;
+    MQTTStatus_t xConnectStatus = MQTTSuccess;
+    MQTTContext_t * pMqttContext = &( pMqttAgentContext->mqttContext );
+
+    /* Success is returned for disconnect or termination. The socket should
+     * be disconnected. */
+    if( ( mqttStatus == MQTTSuccess ) && ( pMqttContext->connectStatus == MQTTNotConnected ) )
+    {
+        /* MQTT Disconnect. Disconnect the socket. */
+        ( void ) socketDisconnect( &networkContext );
+    }
+    else if( mqttStatus == MQTTSuccess )
+    {
+        /* MQTTAgent_Terminate() was called, but MQTT was not disconnected. */
+        xConnectStatus = MQTT_Disconnect( pMqttContext );
+        ( void ) socketDisconnect( &networkContext );
+    }
+    /* Any error. */
+    else
+    {
+        #if defined( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER )
+            /* The runner does not serve the connection until the work item
+             * resumes it. */
+            ( void ) k_work_submit_to_queue( &reconnectQueue, &reconnectWork );
+            runAgain = true;
+        #else
+            runAgain = reconnect( pMqttAgentContext );
+        #endif
+    }
+
+    return runAgain;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool reconnect( MQTTAgentContext_t * pMqttAgentContext )
 {
     bool networkResult = false;
-    MQTTStatus_t mqttStatus = MQTTSuccess, xConnectStatus = MQTTSuccess;
-    MQTTContext_t * pMqttContext = &( globalMqttAgentContext.mqttContext );
 
-    ( void ) pParameters;
-    ( void ) b;
-    ( void ) c;
+    /* Reconnect TCP. */
+    networkResult = socketDisconnect( &networkContext );
 
-    do
+    if( networkResult )
     {
-        /* MQTTAgent_CommandLoop() is effectively the agent implementation.  It
-         * will manage the MQTT protocol until such time that an error occurs,
-         * which could be a disconnect.  If an error occurs the MQTT context on
-         * which the error happened is returned so there can be an attempt to
-         * clean up and reconnect however the application writer prefers. */
-        mqttStatus = MQTTAgent_CommandLoop( &globalMqttAgentContext );
-
-        /* Success is returned for disconnect or termination. The socket should
-         * be disconnected. */
-        if( ( mqttStatus == MQTTSuccess ) && ( globalMqttAgentContext.mqttContext.connectStatus == MQTTNotConnected ) )
-        {
-            /* MQTT Disconnect. Disconnect the socket. */
-            networkResult = socketDisconnect( &networkContext );
-        }
-        else if( mqttStatus == MQTTSuccess )
+        pMqttAgentContext->mqttContext.connectStatus = MQTTNotConnected;
+
+        /* MQTT Connect with a persistent session. */
+        networkResult = connectToMQTTBroker( false );
+    }
+
+    if( !networkResult )
+    {
+        LogError( ( "Could not reconnect to MQTT broker" ) );
+    }
+
+    return networkResult;
+}
+
+/*-----------------------------------------------------------*/
+
+#if defined( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER )
+
+    static void reconnectWorkHandler( struct k_work * pWork )
+    {
+        ( void ) pWork;
+
+        if( reconnect( &globalMqttAgentContext ) )
         {
-            /* MQTTAgent_Terminate() was called, but MQTT was not disconnected. */
-            xConnectStatus = MQTT_Disconnect( &( globalMqttAgentContext.mqttContext ) );
-            networkResult = socketDisconnect( &networkContext );
-            break;
+            ( void ) AgentRunner_ResumeConnection( &globalMqttAgentContext );
         }
-        /* Any error. */
         else
         {
-            /* Reconnect TCP. */
-            networkResult = socketDisconnect( &networkContext );
+            /* AgentRunner_Run() returns once no connection is left. */
+            ( void ) AgentRunner_RemoveConnection( &globalMqttAgentContext );
+        }
+    }
+#endif
 
-            if( networkResult )
-            {
-                pMqttContext->connectStatus = MQTTNotConnected;
+/*-----------------------------------------------------------*/
 
-                /* MQTT Connect with a persistent session. */
-                networkResult = connectToMQTTBroker( false );
-            }
+static void mqttAgentTask( void * pParameters,
+                           void * b,
+                           void * c )
+{
+    #if !defined( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER )
+        MQTTStatus_t mqttStatus = MQTTSuccess;
+    #endif
 
-            if( !networkResult )
-            {
-                LogError( ( "Could not reconnect to MQTT broker" ) );
-                break;
-            }
+    ( void ) pParameters;
+    ( void ) b;
+    ( void ) c;
+
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER )
+        k_work_queue_init( &reconnectQueue );
+        k_work_queue_start( &reconnectQueue,
+                            reconnectStackArea,
+                            K_THREAD_STACK_SIZEOF( reconnectStackArea ),
+                            4,
+                            NULL );
+        k_work_init( &reconnectWork, reconnectWorkHandler );
+
+        /* The runner serves the agent from this thread, together with any
+         * other connection added to it, and calls handleCommandLoopExit()
+         * when the connection ends. */
+        if( AgentRunner_AddConnection( &globalMqttAgentContext, handleCommandLoopExit ) )
+        {
+            AgentRunner_Run();
         }
-    } while( mqttStatus != MQTTSuccess );
+    #else
+        do
+        {
+            /* MQTTAgent_CommandLoop() is effectively the agent implementation.  It
+             * will manage the MQTT protocol until such time that an error occurs,
+             * which could be a disconnect.  If an error occurs the MQTT context on
+             * which the error happened is returned so there can be an attempt to
+             * clean up and reconnect however the application writer prefers. */
+            mqttStatus = MQTTAgent_CommandLoop( &globalMqttAgentContext );
+        } while( handleCommandLoopExit( &globalMqttAgentContext, mqttStatus ) );
+    #endif
 
     /* Delete the task if it is complete. Zephyr thread should self terminate. */
     LogInfo( ( "MQTT Agent task completed." ) );
@@ -872,26 +1135,28 @@ static void mqttAgentTask( void * pParameters,
 static bool connectToMQTTBroker( bool createCleanSession )
 {
     MQTTStatus_t mqttStatus = MQTTBadParameter;
-    bool connected = false;
-    BackoffAlgorithmContext_t reconnectParams;
-    bool backoffStatus = false;
+    TlsTransportStatus_t networkStatus = TLS_TRANSPORT_SUCCESS;
+    ReconnectScheduler_t reconnectScheduler;
+    ReconnectFailure_t failure = RECONNECT_FAILURE_TCP;
+    bool retry = false;
 
     /* Initialize reconnect attempts and interval. */
-    BackoffAlgorithm_InitializeParams( &reconnectParams,
-                                       RETRY_BACKOFF_BASE_MS,
-                                       RETRY_MAX_BACKOFF_DELAY_MS,
-                                       RETRY_MAX_ATTEMPTS );
+    Reconnect_Init( &reconnectScheduler,
+                    "MQTT",
+                    RETRY_BACKOFF_BASE_MS,
+                    RETRY_MAX_BACKOFF_DELAY_MS,
+                    RETRY_MAX_ATTEMPTS );
 
     /* Attempt to connect to MQTT broker. If connection fails, retry after a
-     * timeout. Timeout value will exponentially increase until the maximum
-     * number of attempts are reached.
+     * delay drawn with decorrelated jitter, until the maximum number of
+     * attempts are reached.
      */
     do
     {
         /* Connect a TCP socket to the broker. */
-        connected = socketConnect( &networkContext );
+        networkStatus = socketConnect( &networkContext );
 
-        if( connected )
+        if( networkStatus == TLS_TRANSPORT_SUCCESS )
         {
             /* Form an MQTT connection. */
             mqttStatus = mqttConnect( createCleanSession );
@@ -900,20 +1165,41 @@ static bool connectToMQTTBroker( bool createCleanSession )
             {
                 /* Close connection before next retry. */
                 socketDisconnect( &networkContext );
+                failure = RECONNECT_FAILURE_CONNACK;
             }
         }
+        else if( networkStatus == TLS_TRANSPORT_DNS_FAILURE )
+        {
+            failure = RECONNECT_FAILURE_DNS;
+        }
+        else if( networkStatus == TLS_TRANSPORT_CONNECT_FAILURE )
+        {
+            failure = RECONNECT_FAILURE_TCP;
+        }
+        else
+        {
+            failure = RECONNECT_FAILURE_TLS;
+        }
 
         if( mqttStatus != MQTTSuccess )
         {
-            LogWarn( ( "Connection to the broker failed. Attempting connection retry after backoff delay." ) );
+            /* Wait before the next attempt, if any is left. */
+            retry = Reconnect_Wait( &reconnectScheduler, failure );
+        }
+    } while( ( mqttStatus != MQTTSuccess ) && ( retry == true ) );
 
-            /* As the connection attempt failed, we will retry the connection after an
-             * exponential backoff with jitter delay. */
+    if( mqttStatus == MQTTSuccess )
+    {
+        Reconnect_Succeeded( &reconnectScheduler );
+    }
 
-            /* Calculate the backoff period for the next retry attempt and perform the wait operation. */
-            backoffStatus = backoffForRetry( &reconnectParams );
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_OFFLINE_QUEUE )
+        if( mqttStatus == MQTTSuccess )
+        {
+            /* Publish what was stored while disconnected. */
+            OfflineQueue_SetConnected( true );
         }
-    } while( ( mqttStatus != MQTTSuccess ) && ( backoffStatus ) );
+    #endif
 
     return mqttStatus == MQTTSuccess;
 }
@@ -934,6 +1220,11 @@ static int connectAndCreateDemoTasks( void * pParameters )
     /* Set the pParams member of the network context with desired transport. */
     networkContext.pParams = &secureSocketsTransportParams;
 
+    #if ( MQTT_AGENT_READ_AHEAD_BUFFER_SIZE > 0 )
+        secureSocketsTransportParams.readAhead.pBuffer = readAheadBuffer;
+        secureSocketsTransportParams.readAhead.bufferSize = sizeof( readAheadBuffer );
+    #endif
+
     /* Initialize the MQTT context with the buffer and transport interface. */
     mqttStatus = mqttAgentInit();
 
@@ -946,6 +1237,11 @@ static int connectAndCreateDemoTasks( void * pParameters )
 
     if( result )
     {
+        #if ( THREAD_PROFILING == 1 )
+            /* Publish the profiles of the threads registered below. */
+            ThreadProfiler_Start( publishThreadProfiles, NULL );
+        #endif
+
         /* Create demo tasks as per the configuration macro settings. */
         StartSimpleSubscribePublishTask( NUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE,
                                          SIMPLE_SUB_PUB_TASK_STACK_SIZE,
@@ -957,7 +1253,7 @@ static int connectAndCreateDemoTasks( void * pParameters )
          * as those tasks need to send commands to the queue. */
         k_thread_create( &mqttAgentThread,
                          mqttAgentStackArea,
-                         SIMPLE_SUB_PUB_TASK_STACK_SIZE,
+                         MQTT_AGENT_TASK_STACK_SIZE,
                          mqttAgentTask,
                          NULL,
                          NULL,
@@ -965,6 +1261,7 @@ static int connectAndCreateDemoTasks( void * pParameters )
                          4,
                          0,
                          K_NO_WAIT );
+        ThreadProfiler_Register( &mqttAgentThread, "mqtt_agent" );
 
         /* Wait for all tasks to exit. */
         for( i = 0; i < NUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE; i++ )
@@ -991,6 +1288,72 @@ static int connectAndCreateDemoTasks( void * pParameters )
 
 /*-----------------------------------------------------------*/
 
+#if ( THREAD_PROFILING == 1 )
+
+    static void publishThreadProfiles( const ThreadProfile_t * pProfiles,
+                                       size_t count,
+                                       void * pContext )
+    {
+        MQTTAgentCommandInfo_t commandParams = { 0 };
+        size_t payloadLength = 0;
+
+        ( void ) pContext;
+
+        /* The payload and the publish information are in use until the
+         * previous publish completed. */
+        if( atomic_cas( &threadProfilePublishInFlight, 0, 1 ) )
+        {
+            payloadLength = ThreadProfiler_Serialize( pProfiles,
+                                                      count,
+                                                      threadProfilePayload,
+                                                      sizeof( threadProfilePayload ) );
+
+            if( payloadLength > 0U )
+            {
+                memset( ( void * ) &threadProfilePublishInfo, 0x00, sizeof( threadProfilePublishInfo ) );
+                threadProfilePublishInfo.qos = MQTTQoS0;
+                threadProfilePublishInfo.pTopicName = THREAD_PROFILE_TOPIC;
+                threadProfilePublishInfo.topicNameLength = ( uint16_t ) ( sizeof( THREAD_PROFILE_TOPIC ) - 1U );
+                threadProfilePublishInfo.pPayload = threadProfilePayload;
+                threadProfilePublishInfo.payloadLength = payloadLength;
+
+                /* Do not block the system work queue, which samples the
+                 * threads. */
+                commandParams.blockTimeMs = 0U;
+                commandParams.cmdCompleteCallback = threadProfilesPublished;
+
+                if( MQTTAgent_Publish( &globalMqttAgentContext,
+                                       &threadProfilePublishInfo,
+                                       &commandParams ) != MQTTSuccess )
+                {
+                    LogDebug( ( "Thread profiles dropped: the agent queue is full." ) );
+                    ( void ) atomic_clear( &threadProfilePublishInFlight );
+                }
+            }
+            else
+            {
+                LogWarn( ( "Thread profiles do not fit in THREAD_PROFILE_PAYLOAD_SIZE (%d).",
+                           THREAD_PROFILE_PAYLOAD_SIZE ) );
+                ( void ) atomic_clear( &threadProfilePublishInFlight );
+            }
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void threadProfilesPublished( MQTTAgentCommandContext_t * pCommandContext,
+                                         MQTTAgentReturnInfo_t * pReturnInfo )
+    {
+        ( void ) pCommandContext;
+        ( void ) pReturnInfo;
+
+        ( void ) atomic_clear( &threadProfilePublishInFlight );
+    }
+
+/*-----------------------------------------------------------*/
+
+#endif /* if ( THREAD_PROFILING == 1 ) */
+
 static uint32_t getTimeMs( void )
 {
     return k_uptime_get_32() - globalEntryTimeMs;
@@ -1000,6 +1363,14 @@ static uint32_t getTimeMs( void )
 
 void main()
 {
+    /* Seed the random number generator shared by the TLS connections once, so
+     * that reconnections do not pay for it. A failure here is retried by the
+     * first connection. */
+    if( MbedTLS_Init() != TLS_TRANSPORT_SUCCESS )
+    {
+        LogWarn( ( "Failed to seed the TLS random number generator." ) );
+    }
+
     LogInfo( ( "Connecting to WiFi network: SSID=%.*s ...", strlen( WIFI_NETWORK_SSID ), WIFI_NETWORK_SSID ) );
 
     if( Wifi_Connect( WIFI_NETWORK_SSID, strlen( WIFI_NETWORK_SSID ), WIFI_NETWORK_PASSWORD, strlen( WIFI_NETWORK_PASSWORD ) ) )
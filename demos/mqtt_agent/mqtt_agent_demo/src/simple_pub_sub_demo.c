@@ -57,6 +57,19 @@
 /* Subscription manager header include. */
 #include "subscription_manager.h"
 
+/* Stack and CPU profiling of the threads. */
+#include "thread_profiler_zephyr.h"
+
+#if defined( CONFIG_AWS_IOT_MQTT_AGENT_OFFLINE_QUEUE )
+    /* Keeps the publishes made while disconnected in flash. */
+    #include "offline_queue.h"
+#endif
+
+#if defined( CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL )
+    /* Reference-counted payload buffers released on publish completion. */
+    #include "payload_pool.h"
+#endif
+
 /**
  * @brief This demo uses task notifications to signal tasks from MQTT callback
  * functions.  MS_TO_WAIT_FOR_NOTIFICATION defines the time, in ticks,
@@ -117,6 +130,21 @@ struct SimplePubSubDemoParams
     bool success;
 };
 
+#if defined( CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL )
+
+/**
+ * @brief Completions of the publishes a task queued with
+ * PayloadPool_Publish(), counted over the life of the task.
+ */
+    struct PoolPublishContext
+    {
+        uint32_t taskNum;
+        uint32_t queued;
+        atomic_t completed;
+        atomic_t succeeded;
+    };
+#endif
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -195,6 +223,37 @@ static bool subscribeToTopic( MQTTQoS_t QoS,
                               char * pTopicFilter,
                               uint32_t taskNumber );
 
+#if defined( CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL )
+
+/**
+ * @brief Passed into PayloadPool_Publish() as the callback to execute when a
+ * publish completes.  It counts the completion and notifies the task that
+ * queued the publish.
+ *
+ * @param[in] pContext The #PoolPublishContext of the task.
+ * @param[in] pPublishInfo The completed publish.
+ * @param[in] returnCode Result of the publish.
+ */
+    static void poolPublishCallback( void * pContext,
+                                     const MQTTPublishInfo_t * pPublishInfo,
+                                     MQTTStatus_t returnCode );
+
+/**
+ * @brief Queue the publishes of a task with payloads of the payload pool,
+ * without waiting for each one to complete before building the next, then
+ * wait for all of them to complete.
+ *
+ * @param[in] pPublishInfo Topic and QoS of the publishes.
+ * @param[in] pTaskName Name of the task, put in the payloads.
+ * @param[in] taskNumber Identifier for the task performing the publishes.
+ *
+ * @return The number of publishes that completed successfully.
+ */
+    static uint32_t publishFromPool( MQTTPublishInfo_t * pPublishInfo,
+                                     const char * pTaskName,
+                                     uint32_t taskNumber );
+#endif
+
 /**
  * @brief The function that implements the task demonstrated by this file.
  *
@@ -229,13 +288,35 @@ struct k_thread simpleSubPubThreads[ NUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE ];
  */
 static struct k_sem subPubSems[ NUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE ];
 
+#if defined( CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL )
+
+/**
+ * @brief Completion contexts of the publishes of each task. They are not on
+ * the stack of the tasks, as publishes may complete after the task stopped
+ * waiting for them.
+ */
+    static struct PoolPublishContext poolPublishContexts[ NUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE ];
+#endif
+
+#if ( THREAD_PROFILING == 1 )
+
+/**
+ * @brief Names under which the threads are profiled.
+ */
+    static char profileNames[ NUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE ][ 20 ];
+#endif
+
+#if ( SUBSCRIPTION_MANAGER_COPY_FILTERS == 0 )
+
 /**
  * @brief The buffer to hold the topic filter. The topic is generated at runtime
  * by adding the task names.
  *
- * @note The topic strings must persist until unsubscribed.
+ * @note The topic strings must persist until unsubscribed, unless the
+ * subscription manager copies them.
  */
-static char topicBuf[ NUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE ][ STRING_BUFFER_LENGTH ];
+    static char topicBuf[ NUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE ][ STRING_BUFFER_LENGTH ];
+#endif
 
 /*-----------------------------------------------------------*/
 
@@ -273,6 +354,11 @@ void StartSimpleSubscribePublishTask( uint32_t numberToCreate,
                          priority,
                          0,
                          K_NO_WAIT );
+
+        #if ( THREAD_PROFILING == 1 )
+            ( void ) snprintf( profileNames[ taskNumber ], sizeof( profileNames[ taskNumber ] ), "pubsub%u", ( unsigned int ) taskNumber );
+            ThreadProfiler_Register( &( simpleSubPubThreads[ taskNumber ] ), profileNames[ taskNumber ] );
+        #endif
     }
 }
 
@@ -438,6 +524,123 @@ static bool subscribeToTopic( MQTTQoS_t QoS,
 
 /*-----------------------------------------------------------*/
 
+#if defined( CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL )
+
+    static void poolPublishCallback( void * pContext,
+                                     const MQTTPublishInfo_t * pPublishInfo,
+                                     MQTTStatus_t returnCode )
+    {
+        struct PoolPublishContext * pPoolContext = ( struct PoolPublishContext * ) pContext;
+
+        if( returnCode == MQTTSuccess )
+        {
+            ( void ) atomic_inc( &( pPoolContext->succeeded ) );
+        }
+        else
+        {
+            LogError( ( "Publish on topic %.*s failed. Error code=%s",
+                        pPublishInfo->topicNameLength,
+                        pPublishInfo->pTopicName,
+                        MQTT_Status_strerror( returnCode ) ) );
+
+            #if defined( CONFIG_AWS_IOT_MQTT_AGENT_OFFLINE_QUEUE )
+                /* The payload stays valid until this callback returns. */
+                ( void ) OfflineQueue_Store( pPublishInfo );
+            #endif
+        }
+
+        ( void ) atomic_inc( &( pPoolContext->completed ) );
+        k_sem_give( &( subPubSems[ pPoolContext->taskNum ] ) );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static uint32_t publishFromPool( MQTTPublishInfo_t * pPublishInfo,
+                                     const char * pTaskName,
+                                     uint32_t taskNumber )
+    {
+        struct PoolPublishContext * pPoolContext = &( poolPublishContexts[ taskNumber ] );
+        uint8_t * pPayload = NULL;
+        uint32_t valueToNotify = 0UL;
+        uint32_t succeededBefore = 0UL;
+        MQTTStatus_t commandAdded;
+
+        /* Publishes left over by an earlier run may still complete, so the
+         * counts are not reset. */
+        pPoolContext->taskNum = taskNumber;
+        succeededBefore = ( uint32_t ) atomic_get( &( pPoolContext->succeeded ) );
+
+        for( valueToNotify = 0UL; valueToNotify < PUBLISH_COUNT; valueToNotify++ )
+        {
+            pPayload = PayloadPool_Alloc( STRING_BUFFER_LENGTH, MAX_COMMAND_SEND_BLOCK_TIME_MS );
+
+            if( pPayload == NULL )
+            {
+                LogError( ( "No payload buffer for publish %d.", ( int ) valueToNotify ) );
+            }
+            else
+            {
+                snprintf( ( char * ) pPayload,
+                          STRING_BUFFER_LENGTH,
+                          "%s publishing message %d",
+                          pTaskName,
+                          ( int ) valueToNotify );
+
+                pPublishInfo->pPayload = pPayload;
+                pPublishInfo->payloadLength = ( uint16_t ) strlen( ( char * ) pPayload );
+
+                LogInfo( ( "Sending publish request to agent with message \"%s\" on topic \"%.*s\"",
+                           ( char * ) pPayload,
+                           pPublishInfo->topicNameLength,
+                           pPublishInfo->pTopicName ) );
+
+                commandAdded = PayloadPool_Publish( &globalMqttAgentContext,
+                                                    pPublishInfo,
+                                                    MAX_COMMAND_SEND_BLOCK_TIME_MS,
+                                                    poolPublishCallback,
+                                                    pPoolContext );
+
+                if( commandAdded == MQTTSuccess )
+                {
+                    pPoolContext->queued++;
+                }
+                else
+                {
+                    LogError( ( "Failed to enqueue publish command. Error code=%s", MQTT_Status_strerror( commandAdded ) ) );
+
+                    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_OFFLINE_QUEUE )
+                        ( void ) OfflineQueue_Store( pPublishInfo );
+                    #endif
+
+                    /* The reference was not handed to the publish. */
+                    PayloadPool_Release( pPayload );
+                }
+            }
+
+            k_sleep( K_MSEC( DELAY_BETWEEN_PUBLISH_OPERATIONS_MS ) );
+        }
+
+        /* Each completion gives the semaphore, so a timeout means the
+         * remaining publishes are not progressing. */
+        while( ( ( uint32_t ) atomic_get( &( pPoolContext->completed ) ) < pPoolContext->queued ) &&
+               waitForCommandAcknowledgment( taskNumber ) )
+        {
+        }
+
+        if( ( uint32_t ) atomic_get( &( pPoolContext->completed ) ) < pPoolContext->queued )
+        {
+            LogError( ( "Task %s timed out waiting for %d publishes to complete.",
+                        pTaskName,
+                        ( int ) ( pPoolContext->queued - ( uint32_t ) atomic_get( &( pPoolContext->completed ) ) ) ) );
+        }
+
+        return ( uint32_t ) atomic_get( &( pPoolContext->succeeded ) ) - succeededBefore;
+    }
+
+/*-----------------------------------------------------------*/
+
+#endif /* if defined( CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL ) */
+
 static void simpleSubscribePublishTask( void * pParameters,
                                         void * b,
                                         void * c )
@@ -452,9 +655,15 @@ static void simpleSubscribePublishTask( void * pParameters,
     uint32_t taskNumber = pParams->taskNumber;
     MQTTQoS_t QoS;
     MQTTAgentCommandInfo_t commandParams = { 0 };
-    char * pTopicBuffer = topicBuf[ taskNumber ];
     uint32_t numSuccesses = 0U;
 
+    #if ( SUBSCRIPTION_MANAGER_COPY_FILTERS == 1 )
+        /* The subscription manager keeps its own copy of the topic filter. */
+        char pTopicBuffer[ STRING_BUFFER_LENGTH ];
+    #else
+        char * pTopicBuffer = topicBuf[ taskNumber ];
+    #endif
+
     /* Have different tasks use different QoS.  0 and 1.  2 can also be used
      * if supported by the broker. */
     QoS = ( MQTTQoS_t ) ( taskNumber % QOS_MODULUS );
@@ -488,6 +697,15 @@ static void simpleSubscribePublishTask( void * pParameters,
     commandParams.cmdCompleteCallback = publishCommandCallback;
     commandParams.pCmdCompleteCallbackContext = &commandContext;
 
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL )
+        /* Only used by the publishes that wait for each completion. */
+        ( void ) valueToNotify;
+        ( void ) commandAdded;
+        ( void ) commandParams;
+
+        numSuccesses = publishFromPool( &publishInfo, taskName, taskNumber );
+    #else
+
     /* For a finite number of publishes... */
     for( valueToNotify = 0UL; valueToNotify < PUBLISH_COUNT; valueToNotify++ )
     {
@@ -505,6 +723,7 @@ static void simpleSubscribePublishTask( void * pParameters,
          * be accessed by the callback that executes when the publish operation
          * is acknowledged. */
         commandContext.notificationValue = valueToNotify;
+        commandContext.returnStatus = MQTTSuccess;
 
         LogInfo( ( "Sending publish request to agent with message \"%s\" on topic \"%s\"",
                    payloadBuf,
@@ -528,6 +747,15 @@ static void simpleSubscribePublishTask( void * pParameters,
             LogError( ( "Failed to enqueue publish command. Error code=%s", MQTT_Status_strerror( commandAdded ) ) );
         }
 
+        #if defined( CONFIG_AWS_IOT_MQTT_AGENT_OFFLINE_QUEUE )
+            /* Keep the publish for the next connection if it could not be
+             * sent on this one. */
+            if( ( commandAdded != MQTTSuccess ) || ( commandContext.returnStatus != MQTTSuccess ) )
+            {
+                ( void ) OfflineQueue_Store( &publishInfo );
+            }
+        #endif
+
         /* The value received by the callback that executed when the publish was
          * completed came from the context passed into MQTTAgent_Publish() above,
          * so should match the value set in the context above. */
@@ -539,6 +767,7 @@ static void simpleSubscribePublishTask( void * pParameters,
 
         k_sleep( K_MSEC( DELAY_BETWEEN_PUBLISH_OPERATIONS_MS ) );
     }
+    #endif /* if defined( CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL ) */
 
     /* Mark this task as successful if every publish was successfully completed. */
     if( numSuccesses == PUBLISH_COUNT )
@@ -227,6 +227,38 @@
  */
 #define SHADOW_NAME_LENGTH    ( ( uint16_t ) ( sizeof( SHADOW_NAME ) - 1 ) )
 
+/**
+ * @brief Set to 1 to exchange the reported state and the deltas in CBOR
+ * instead of JSON.
+ *
+ * Shadow topics only accept JSON, so this needs two AWS IoT rules: one on
+ * #SHADOW_CBOR_UPDATE_TOPIC whose action decodes the CBOR document and
+ * updates the shadow with its JSON equivalent, and one on the
+ * `/update/delta` topic that republishes the deltas encoded in CBOR on
+ * #SHADOW_CBOR_DELTA_TOPIC. The shadow responses stay in JSON. The demo also
+ * logs the size and the encode and decode times of the reported state in
+ * both encodings.
+ */
+#ifndef SHADOW_USE_CBOR
+    #define SHADOW_USE_CBOR    ( 0 )
+#endif
+
+/**
+ * @brief Topic receiving the CBOR reported state. Topics starting with
+ * "$aws/rules/<rule name>/" go straight to the rule, without the cost of the
+ * message broker.
+ */
+#ifndef SHADOW_CBOR_UPDATE_TOPIC
+    #define SHADOW_CBOR_UPDATE_TOPIC    "$aws/rules/ShadowCborUpdate/things/" THING_NAME "/shadow/update"
+#endif
+
+/**
+ * @brief Topic on which the rule republishes the deltas in CBOR.
+ */
+#ifndef SHADOW_CBOR_DELTA_TOPIC
+    #define SHADOW_CBOR_DELTA_TOPIC    "things/" THING_NAME "/shadow/cbor/delta"
+#endif
+
 /**
  * @brief The name of the Wi-Fi network to join.
  *
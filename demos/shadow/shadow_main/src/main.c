@@ -34,12 +34,12 @@
  * This example assumes there is a powerOn state in the device shadow. It does the
  * following operations:
  * 1. Establish a MQTT connection by using the helper functions in shadow_demo_helpers.c.
- * 2. Assemble strings for the MQTT topics of device shadow, by using macros defined by the Device Shadow library.
- * 3. Subscribe to those MQTT topics by using helper functions in shadow_demo_helpers.c.
+ * 2. Assemble the MQTT topics of device shadow once in a shadow session (shadow_session.h).
+ * 3. Subscribe to all of those MQTT topics with one SUBSCRIBE by using helper functions in shadow_demo_helpers.c.
  * 4. Publish a desired state of powerOn by using helper functions in shadow_demo_helpers.c.  That will cause
  * a delta message to be sent to device.
- * 5. Handle incoming MQTT messages in eventCallback, determine whether the message is related to the device
- * shadow by using a function defined by the Device Shadow library (Shadow_MatchTopicString). If the message is a
+ * 5. Handle incoming MQTT messages in eventCallback, which looks the topic up in the shadow session and
+ * calls the handler registered for its message type. If the message is a
  * device shadow delta message, set a flag for the main function to know, then the main function will publish
  * a second message to update the reported state of powerOn.
  * 6. Handle incoming message again in eventCallback. If the message is from update/accepted, verify that it
@@ -62,6 +62,18 @@
 /* JSON API header. */
 #include "core_json.h"
 
+/* Single-pass extraction of several JSON values. */
+#include "json_extract.h"
+
+/* Reported state with dirty field tracking. */
+#include "shadow_state.h"
+
+/* Prebuilt shadow topics and their handlers. */
+#include "shadow_session.h"
+
+/* Compact binary encoding of the shadow documents. */
+#include "shadow_cbor.h"
+
 /* Clock for timer. */
 #include "clock.h"
 
@@ -120,9 +132,10 @@
 #define SHADOW_DESIRED_JSON_LENGTH    ( sizeof( SHADOW_DESIRED_JSON ) - 3 )
 
 /**
- * @brief Format string representing a Shadow document with a "reported" state.
+ * @brief Size of the buffer holding the desired and reported update documents.
  *
- * The real json document will look like this:
+ * The reported documents are written by #ShadowState_SerializeReported and
+ * only hold the fields that changed since the previous update, such as:
  * {
  *   "state": {
  *     "reported": {
@@ -136,24 +149,39 @@
  * token must be unique at any given time, but may be reused once the update is
  * completed. For this demo, a timestamp is used for a client token.
  */
-#define SHADOW_REPORTED_JSON    \
-    "{"                         \
-    "\"state\":{"               \
-    "\"reported\":{"            \
-    "\"powerOn\":%01d"          \
-    "}"                         \
-    "},"                        \
-    "\"clientToken\":\"%06lu\"" \
-    "}"
+#define SHADOW_UPDATE_DOCUMENT_SIZE    ( 128U )
 
 /**
- * @brief The expected size of #SHADOW_REPORTED_JSON.
- *
- * Because all the format specifiers in #SHADOW_REPORTED_JSON include a length,
- * its full size is known at compile-time by pre-calculation. Users could refer to
- * the way how to calculate the actual length in #SHADOW_DESIRED_JSON_LENGTH.
+ * @brief Length of the client tokens of the demo, which are six digits.
+ */
+#define SHADOW_CLIENT_TOKEN_LENGTH    ( 6U )
+
+/**
+ * @brief Shortest time in milliseconds between two reported state updates.
+ * The changes made in between are sent together by the next update.
+ */
+#define SHADOW_REPORTED_MIN_INTERVAL_MS    ( 1000U )
+
+/**
+ * @brief Index of the powerOn field in #reportedFields.
  */
-#define SHADOW_REPORTED_JSON_LENGTH    ( sizeof( SHADOW_REPORTED_JSON ) - 3 )
+#define REPORTED_FIELD_POWER_ON    ( 0U )
+
+/**
+ * @brief The number of topics the demo subscribes to. With #SHADOW_USE_CBOR,
+ * #SHADOW_CBOR_DELTA_TOPIC replaces the `/update/delta` topic.
+ */
+#define SHADOW_DEMO_SUBSCRIPTION_COUNT    ( 5U )
+
+/**
+ * @brief The length of #SHADOW_CBOR_UPDATE_TOPIC.
+ */
+#define SHADOW_CBOR_UPDATE_TOPIC_LENGTH    ( ( uint16_t ) ( sizeof( SHADOW_CBOR_UPDATE_TOPIC ) - 1U ) )
+
+/**
+ * @brief The length of #SHADOW_CBOR_DELTA_TOPIC.
+ */
+#define SHADOW_CBOR_DELTA_TOPIC_LENGTH     ( ( uint16_t ) ( sizeof( SHADOW_CBOR_DELTA_TOPIC ) - 1U ) )
 
 /**
  * @brief The maximum number of times to run the loop in this demo.
@@ -194,6 +222,20 @@ static uint32_t currentPowerOnState = 0;
  */
 static bool stateChanged = false;
 
+/**
+ * @brief The fields of the reported state of the device.
+ */
+static ShadowField_t reportedFields[] =
+{
+    SHADOW_FIELD( "powerOn", SHADOW_FIELD_TYPE_UINT )
+};
+
+/**
+ * @brief The reported state of the device, which tracks the fields changed
+ * since the last update.
+ */
+static ShadowState_t reportedState;
+
 /**
  * @brief When we send an update to the device shadow, and if we care about
  * the response from cloud (accepted/rejected), remember the clientToken and
@@ -225,6 +267,12 @@ static bool deleteResponseReceived = false;
  */
 static bool shadowDeleted = false;
 
+/**
+ * @brief The topics of #SHADOW_NAME, which are assembled once, and the
+ * handlers of the messages received on them.
+ */
+SHADOW_SESSION_DEFINE( shadowSession, 1U );
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -247,10 +295,47 @@ static void eventCallback( MQTTContext_t * pMqttContext,
  * This handler examines the version number and the powerOn state. If powerOn
  * state has changed, it sets a flag for the main function to take further actions.
  *
+ * @param[in] pContext Unused.
+ * @param[in] shadowIndex Unused, the demo has a single shadow.
  * @param[in] pPublishInfo Deserialized publish info pointer for the incoming
  * packet.
  */
-static void updateDeltaHandler( MQTTPublishInfo_t * pPublishInfo );
+static void updateDeltaHandler( void * pContext,
+                                size_t shadowIndex,
+                                MQTTPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Apply the version and the powerOn state of a delta.
+ *
+ * @param[in] version Version of the delta.
+ * @param[in] hasPowerOn Whether the delta has a powerOn state.
+ * @param[in] newState The powerOn state of the delta.
+ */
+static void applyDelta( uint32_t version,
+                        bool hasPowerOn,
+                        uint32_t newState );
+
+#if ( SHADOW_USE_CBOR == 1 )
+
+/**
+ * @brief Process a CBOR delta republished by a rule on #SHADOW_CBOR_DELTA_TOPIC.
+ *
+ * @param[in] pPublishInfo Deserialized publish info pointer for the incoming
+ * packet.
+ */
+    static void cborDeltaHandler( MQTTPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Log the size and the encode and decode times of the next reported
+ * state update in JSON and in CBOR.
+ *
+ * The update is serialized from a copy of the reported state, which is left
+ * unchanged.
+ *
+ * @param[in] pClientToken The client token of the update.
+ */
+    static void logEncodingComparison( const char * pClientToken );
+#endif
 
 /**
  * @brief Process payload from /update/accepted topic.
@@ -258,10 +343,14 @@ static void updateDeltaHandler( MQTTPublishInfo_t * pPublishInfo );
  * This handler examines the accepted message that carries the same clientToken
  * as sent before.
  *
+ * @param[in] pContext Unused.
+ * @param[in] shadowIndex Unused, the demo has a single shadow.
  * @param[in] pPublishInfo Deserialized publish info pointer for the incoming
  * packet.
  */
-static void updateAcceptedHandler( MQTTPublishInfo_t * pPublishInfo );
+static void updateAcceptedHandler( void * pContext,
+                                   size_t shadowIndex,
+                                   MQTTPublishInfo_t * pPublishInfo );
 
 /**
  * @brief Process payload from `/delete/rejected` topic.
@@ -271,27 +360,59 @@ static void updateAcceptedHandler( MQTTPublishInfo_t * pPublishInfo );
  * document which was not present yet. This is considered to be success for this
  * demo application.
  *
+ * @param[in] pContext Unused.
+ * @param[in] shadowIndex Unused, the demo has a single shadow.
  * @param[in] pPublishInfo Deserialized publish info pointer for the incoming
  * packet.
  */
-static void deleteRejectedHandler( MQTTPublishInfo_t * pPublishInfo );
+static void deleteRejectedHandler( void * pContext,
+                                   size_t shadowIndex,
+                                   MQTTPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Process payload from `/delete/accepted` topic.
+ *
+ * @param[in] pContext Unused.
+ * @param[in] shadowIndex Unused, the demo has a single shadow.
+ * @param[in] pPublishInfo Deserialized publish info pointer for the incoming
+ * packet.
+ */
+static void deleteAcceptedHandler( void * pContext,
+                                   size_t shadowIndex,
+                                   MQTTPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Process payload from /update/rejected topic.
+ *
+ * The fields of the rejected update are reported again by the next update.
+ *
+ * @param[in] pContext Unused.
+ * @param[in] shadowIndex Unused, the demo has a single shadow.
+ * @param[in] pPublishInfo Deserialized publish info pointer for the incoming
+ * packet.
+ */
+static void updateRejectedHandler( void * pContext,
+                                   size_t shadowIndex,
+                                   MQTTPublishInfo_t * pPublishInfo );
 
 /**
  * @brief Entry point of shadow demo.
  *
- * This main function demonstrates how to use the macros provided by the
- * Device Shadow library to assemble strings for the MQTT topics defined
- * by AWS IoT Device Shadow. Named shadow topic strings differ from unnamed
- * ("Classic") topic strings as indicated by the tokens within square brackets.
+ * This main function assembles the MQTT topics defined by AWS IoT Device
+ * Shadow once in a shadow session, which uses #Shadow_AssembleTopicString.
+ * Named shadow topic strings differ from unnamed ("Classic") topic strings
+ * as indicated by the tokens within square brackets.
  *
- * The main function uses these macros for topics to subscribe to:
- * - SHADOW_TOPIC_STR_UPDATE_DELTA for "$aws/things/thingName/shadow[/name/shadowname]/update/delta"
- * - SHADOW_TOPIC_STR_UPDATE_ACC for "$aws/things/thingName/shadow[/name/shadowname]/update/accepted"
- * - SHADOW_TOPIC_STR_UPDATE_REJ for "$aws/things/thingName/shadow[/name/shadowname]/update/rejected"
+ * The main function subscribes to these topics with a single SUBSCRIBE:
+ * - "$aws/things/thingName/shadow[/name/shadowname]/delete/accepted"
+ * - "$aws/things/thingName/shadow[/name/shadowname]/delete/rejected"
+ * - "$aws/things/thingName/shadow[/name/shadowname]/update/delta"
+ * - "$aws/things/thingName/shadow[/name/shadowname]/update/accepted"
+ * - "$aws/things/thingName/shadow[/name/shadowname]/update/rejected"
  *
- * It also uses these macros for topics to publish to:
- * - SHADOW_TOPIC_STR_DELETE for "$aws/things/thingName/shadow[/name/shadowname]/delete"
- * - SHADOW_TOPIC_STR_UPDATE for "$aws/things/thingName/shadow[/name/shadowname]/update"
+ * It also publishes to these topics:
+ * - "$aws/things/thingName/shadow[/name/shadowname]/delete"
+ * - "$aws/things/thingName/shadow[/name/shadowname]/update"
  *
  * The helper functions this demo uses for MQTT operations have internal
  * loops to process incoming messages. Those are not the focus of this demo
@@ -301,13 +422,17 @@ static int start_shadow_demo();
 
 /*-----------------------------------------------------------*/
 
-static void deleteRejectedHandler( MQTTPublishInfo_t * pPublishInfo )
+static void deleteRejectedHandler( void * pContext,
+                                   size_t shadowIndex,
+                                   MQTTPublishInfo_t * pPublishInfo )
 {
     JSONStatus_t result = JSONSuccess;
-    char * pOutValue = NULL;
-    uint32_t outValueLength = 0U;
+    JSONExtractKey_t errorCodeKey = JSON_EXTRACT_KEY( SHADOW_DELETE_REJECTED_ERROR_CODE_KEY );
     long errorCode = 0L;
 
+    ( void ) pContext;
+    ( void ) shadowIndex;
+
     assert( pPublishInfo != NULL );
     assert( pPublishInfo->pPayload != NULL );
 
@@ -322,33 +447,25 @@ static void deleteRejectedHandler( MQTTPublishInfo_t * pPublishInfo )
      * }
      */
 
-    /* Make sure the payload is a valid json document. */
-    result = JSON_Validate( pPublishInfo->pPayload,
-                            pPublishInfo->payloadLength );
+    /* Validate the payload and get the error code in the same pass. */
+    result = JSONExtract_Keys( pPublishInfo->pPayload,
+                               pPublishInfo->payloadLength,
+                               &errorCodeKey,
+                               1U );
 
-    if( result == JSONSuccess )
-    {
-        /* Then we start to get the version value by JSON keyword "version". */
-        result = JSON_Search( ( char * ) pPublishInfo->pPayload,
-                              pPublishInfo->payloadLength,
-                              SHADOW_DELETE_REJECTED_ERROR_CODE_KEY,
-                              SHADOW_DELETE_REJECTED_ERROR_CODE_KEY_LENGTH,
-                              &pOutValue,
-                              ( size_t * ) &outValueLength );
-    }
-    else
+    if( ( result != JSONSuccess ) && ( result != JSONNotFound ) )
     {
         LogError( ( "The json document is invalid!!" ) );
     }
 
-    if( result == JSONSuccess )
+    if( errorCodeKey.pValue != NULL )
     {
         LogInfo( ( "Error code is: %.*s.",
-                   outValueLength,
-                   pOutValue ) );
+                   ( int ) errorCodeKey.valueLength,
+                   errorCodeKey.pValue ) );
 
         /* Convert the extracted value to an unsigned integer value. */
-        errorCode = strtoul( pOutValue, NULL, 10 );
+        errorCode = strtoul( errorCodeKey.pValue, NULL, 10 );
     }
     else
     {
@@ -362,18 +479,43 @@ static void deleteRejectedHandler( MQTTPublishInfo_t * pPublishInfo )
     {
         shadowDeleted = true;
     }
+
+    deleteResponseReceived = true;
 }
 
 /*-----------------------------------------------------------*/
 
-static void updateDeltaHandler( MQTTPublishInfo_t * pPublishInfo )
+static void deleteAcceptedHandler( void * pContext,
+                                   size_t shadowIndex,
+                                   MQTTPublishInfo_t * pPublishInfo )
+{
+    ( void ) pContext;
+    ( void ) shadowIndex;
+    ( void ) pPublishInfo;
+
+    LogInfo( ( "Received an MQTT incoming publish on /delete/accepted topic." ) );
+    shadowDeleted = true;
+    deleteResponseReceived = true;
+}
+
+/*-----------------------------------------------------------*/
+
+static void updateDeltaHandler( void * pContext,
+                                size_t shadowIndex,
+                                MQTTPublishInfo_t * pPublishInfo )
 {
-    static uint32_t currentVersion = 0; /* Remember the latestVersion # we've ever received */
     uint32_t version = 0U;
-    uint32_t newState = 0U;
-    char * outValue = NULL;
-    uint32_t outValueLength = 0U;
     JSONStatus_t result = JSONSuccess;
+    JSONExtractKey_t deltaKeys[] =
+    {
+        JSON_EXTRACT_KEY( "version" ),
+        JSON_EXTRACT_KEY( "state.powerOn" )
+    };
+    const JSONExtractKey_t * pVersion = &( deltaKeys[ 0 ] );
+    const JSONExtractKey_t * pPowerOn = &( deltaKeys[ 1 ] );
+
+    ( void ) pContext;
+    ( void ) shadowIndex;
 
     assert( pPublishInfo != NULL );
     assert( pPublishInfo->pPayload != NULL );
@@ -396,34 +538,27 @@ static void updateDeltaHandler( MQTTPublishInfo_t * pPublishInfo )
      *  }
      */
 
-    /* Make sure the payload is a valid json document. */
-    result = JSON_Validate( pPublishInfo->pPayload,
-                            pPublishInfo->payloadLength );
+    /* Validate the payload and get the version and the powerOn state in the
+     * same pass over the document. */
+    result = JSONExtract_Keys( pPublishInfo->pPayload,
+                               pPublishInfo->payloadLength,
+                               deltaKeys,
+                               sizeof( deltaKeys ) / sizeof( deltaKeys[ 0 ] ) );
 
-    if( result == JSONSuccess )
-    {
-        /* Then we start to get the version value by JSON keyword "version". */
-        result = JSON_Search( ( char * ) pPublishInfo->pPayload,
-                              pPublishInfo->payloadLength,
-                              "version",
-                              sizeof( "version" ) - 1,
-                              &outValue,
-                              ( size_t * ) &outValueLength );
-    }
-    else
+    if( ( result != JSONSuccess ) && ( result != JSONNotFound ) )
     {
         LogError( ( "The json document is invalid!!" ) );
         eventCallbackError = true;
     }
 
-    if( result == JSONSuccess )
+    if( pVersion->pValue != NULL )
     {
         LogInfo( ( "version: %.*s",
-                   outValueLength,
-                   outValue ) );
+                   ( int ) pVersion->valueLength,
+                   pVersion->pValue ) );
 
         /* Convert the extracted value to an unsigned integer value. */
-        version = ( uint32_t ) strtoul( outValue, NULL, 10 );
+        version = ( uint32_t ) strtoul( pVersion->pValue, NULL, 10 );
     }
     else
     {
@@ -431,6 +566,19 @@ static void updateDeltaHandler( MQTTPublishInfo_t * pPublishInfo )
         eventCallbackError = true;
     }
 
+    applyDelta( version, ( pPowerOn->pValue != NULL ),
+                ( pPowerOn->pValue != NULL ) ? ( uint32_t ) strtoul( pPowerOn->pValue, NULL, 10 ) : 0U );
+}
+
+/*-----------------------------------------------------------*/
+
+static void applyDelta( uint32_t version,
+                        bool hasPowerOn,
+                        uint32_t newState )
+{
+    static uint32_t currentVersion = 0; /* Remember the latestVersion # we've ever received */
+    bool newerVersion = false;
+
     LogInfo( ( "version:%d, currentVersion:%d \r\n", version, currentVersion ) );
 
     /* When the version is much newer than the on we retained, that means the powerOn
@@ -439,14 +587,7 @@ static void updateDeltaHandler( MQTTPublishInfo_t * pPublishInfo )
     {
         /* Set to received version as the current version. */
         currentVersion = version;
-
-        /* Get powerOn state from json documents. */
-        result = JSON_Search( ( char * ) pPublishInfo->pPayload,
-                              pPublishInfo->payloadLength,
-                              "state.powerOn",
-                              sizeof( "state.powerOn" ) - 1,
-                              &outValue,
-                              ( size_t * ) &outValueLength );
+        newerVersion = true;
     }
     else
     {
@@ -458,11 +599,8 @@ static void updateDeltaHandler( MQTTPublishInfo_t * pPublishInfo )
         LogWarn( ( "The received version is smaller than current one!!" ) );
     }
 
-    if( result == JSONSuccess )
+    if( ( newerVersion == true ) && ( hasPowerOn == true ) )
     {
-        /* Convert the powerOn state value to an unsigned integer value. */
-        newState = ( uint32_t ) strtoul( outValue, NULL, 10 );
-
         LogInfo( ( "The new power on state newState:%d, currentPowerOnState:%d \r\n",
                    newState, currentPowerOnState ) );
 
@@ -471,6 +609,7 @@ static void updateDeltaHandler( MQTTPublishInfo_t * pPublishInfo )
             /* The received powerOn state is different from the one we retained before, so we switch them
              * and set the flag. */
             currentPowerOnState = newState;
+            ( void ) ShadowState_SetUint( &reportedState, REPORTED_FIELD_POWER_ON, newState );
 
             /* State change will be handled in main(), where we will publish a "reported"
              * state to the device shadow. We do not do it here because we are inside of
@@ -479,21 +618,128 @@ static void updateDeltaHandler( MQTTPublishInfo_t * pPublishInfo )
             stateChanged = true;
         }
     }
-    else
+    else if( newerVersion == true )
     {
-        LogError( ( "No powerOn in json document!!" ) );
+        LogError( ( "No powerOn in delta document!!" ) );
         eventCallbackError = true;
     }
 }
 
 /*-----------------------------------------------------------*/
 
-static void updateAcceptedHandler( MQTTPublishInfo_t * pPublishInfo )
+#if ( SHADOW_USE_CBOR == 1 )
+
+    static void cborDeltaHandler( MQTTPublishInfo_t * pPublishInfo )
+    {
+        ShadowCborStatus_t result = SHADOW_CBOR_SUCCESS;
+        ShadowCborKey_t deltaKeys[] =
+        {
+            SHADOW_CBOR_KEY( "version" ),
+            SHADOW_CBOR_KEY( "state.powerOn" )
+        };
+        const ShadowCborKey_t * pVersion = &( deltaKeys[ 0 ] );
+        const ShadowCborKey_t * pPowerOn = &( deltaKeys[ 1 ] );
+
+        assert( pPublishInfo != NULL );
+        assert( pPublishInfo->pPayload != NULL );
+
+        LogInfo( ( "CBOR delta of %lu bytes.", ( unsigned long ) pPublishInfo->payloadLength ) );
+
+        /* The delta has the maps and keys of the JSON /update/delta document,
+         * with binary integers. */
+        result = ShadowCbor_FindKeys( pPublishInfo->pPayload,
+                                      pPublishInfo->payloadLength,
+                                      deltaKeys,
+                                      sizeof( deltaKeys ) / sizeof( deltaKeys[ 0 ] ) );
+
+        if( ( result != SHADOW_CBOR_SUCCESS ) && ( result != SHADOW_CBOR_NOT_FOUND ) )
+        {
+            LogError( ( "The CBOR document is invalid: %d.", ( int ) result ) );
+            eventCallbackError = true;
+        }
+        else if( ( pVersion->found == false ) || ( pVersion->type != SHADOW_CBOR_TYPE_UINT ) )
+        {
+            LogError( ( "No version in CBOR document!!" ) );
+            eventCallbackError = true;
+        }
+        else
+        {
+            applyDelta( ( uint32_t ) pVersion->argument,
+                        ( pPowerOn->found == true ) && ( pPowerOn->type == SHADOW_CBOR_TYPE_UINT ),
+                        ( uint32_t ) pPowerOn->argument );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void logEncodingComparison( const char * pClientToken )
+    {
+        static ShadowField_t fieldsCopy[ sizeof( reportedFields ) / sizeof( reportedFields[ 0 ] ) ];
+        static char jsonDocument[ SHADOW_UPDATE_DOCUMENT_SIZE ];
+        static uint8_t cborDocument[ SHADOW_UPDATE_DOCUMENT_SIZE ];
+        ShadowState_t stateCopy = reportedState;
+        size_t jsonLength = 0U, cborLength = 0U;
+        uint32_t start = 0U, jsonEncodeCycles = 0U, jsonDecodeCycles = 0U, cborEncodeCycles = 0U, cborDecodeCycles = 0U;
+        JSONExtractKey_t jsonKeys[] =
+        {
+            JSON_EXTRACT_KEY( "state.reported.powerOn" ),
+            JSON_EXTRACT_KEY( "clientToken" )
+        };
+        ShadowCborKey_t cborKeys[] =
+        {
+            SHADOW_CBOR_KEY( "state.reported.powerOn" ),
+            SHADOW_CBOR_KEY( "clientToken" )
+        };
+
+        /* Both documents are serialized from the same copy of the state,
+         * which has no update in flight, so that none is given up. */
+        stateCopy.pFields = fieldsCopy;
+        ( void ) memset( stateCopy.updates, 0x00, sizeof( stateCopy.updates ) );
+
+        ( void ) memcpy( fieldsCopy, reportedFields, sizeof( fieldsCopy ) );
+        start = k_cycle_get_32();
+        ( void ) ShadowState_SerializeReported( &stateCopy, Clock_GetTimeMs(), pClientToken, SHADOW_CLIENT_TOKEN_LENGTH,
+                                                jsonDocument, sizeof( jsonDocument ), &jsonLength );
+        jsonEncodeCycles = k_cycle_get_32() - start;
+
+        ( void ) memcpy( fieldsCopy, reportedFields, sizeof( fieldsCopy ) );
+        start = k_cycle_get_32();
+        ( void ) ShadowState_SerializeReportedCbor( &stateCopy, Clock_GetTimeMs(), pClientToken, SHADOW_CLIENT_TOKEN_LENGTH,
+                                                    cborDocument, sizeof( cborDocument ), &cborLength );
+        cborEncodeCycles = k_cycle_get_32() - start;
+
+        start = k_cycle_get_32();
+        ( void ) JSONExtract_Keys( jsonDocument, jsonLength, jsonKeys, sizeof( jsonKeys ) / sizeof( jsonKeys[ 0 ] ) );
+        jsonDecodeCycles = k_cycle_get_32() - start;
+
+        start = k_cycle_get_32();
+        ( void ) ShadowCbor_FindKeys( cborDocument, cborLength, cborKeys, sizeof( cborKeys ) / sizeof( cborKeys[ 0 ] ) );
+        cborDecodeCycles = k_cycle_get_32() - start;
+
+        LogInfo( ( "Reported state in JSON: %lu bytes, encoded in %u us, decoded in %u us.",
+                   ( unsigned long ) jsonLength,
+                   k_cyc_to_us_floor32( jsonEncodeCycles ),
+                   k_cyc_to_us_floor32( jsonDecodeCycles ) ) );
+        LogInfo( ( "Reported state in CBOR: %lu bytes, encoded in %u us, decoded in %u us.",
+                   ( unsigned long ) cborLength,
+                   k_cyc_to_us_floor32( cborEncodeCycles ),
+                   k_cyc_to_us_floor32( cborDecodeCycles ) ) );
+    }
+
+/*-----------------------------------------------------------*/
+
+#endif /* if ( SHADOW_USE_CBOR == 1 ) */
+
+static void updateAcceptedHandler( void * pContext,
+                                   size_t shadowIndex,
+                                   MQTTPublishInfo_t * pPublishInfo )
 {
-    char * outValue = NULL;
-    uint32_t outValueLength = 0U;
     uint32_t receivedToken = 0U;
     JSONStatus_t result = JSONSuccess;
+    JSONExtractKey_t clientTokenKey = JSON_EXTRACT_KEY( "clientToken" );
+
+    ( void ) pContext;
+    ( void ) shadowIndex;
 
     assert( pPublishInfo != NULL );
     assert( pPublishInfo->pPayload != NULL );
@@ -523,36 +769,32 @@ static void updateAcceptedHandler( MQTTPublishInfo_t * pPublishInfo )
      *  }
      */
 
-    /* Make sure the payload is a valid json document. */
-    result = JSON_Validate( pPublishInfo->pPayload,
-                            pPublishInfo->payloadLength );
+    /* Validate the payload and get clientToken in the same pass. */
+    result = JSONExtract_Keys( pPublishInfo->pPayload,
+                               pPublishInfo->payloadLength,
+                               &clientTokenKey,
+                               1U );
 
-    if( result == JSONSuccess )
-    {
-        /* Get clientToken from json documents. */
-        result = JSON_Search( ( char * ) pPublishInfo->pPayload,
-                              pPublishInfo->payloadLength,
-                              "clientToken",
-                              sizeof( "clientToken" ) - 1,
-                              &outValue,
-                              ( size_t * ) &outValueLength );
-    }
-    else
+    if( ( result != JSONSuccess ) && ( result != JSONNotFound ) )
     {
         LogError( ( "Invalid json documents !!" ) );
         eventCallbackError = true;
     }
 
-    if( result == JSONSuccess )
+    if( clientTokenKey.pValue != NULL )
     {
-        LogInfo( ( "clientToken: %.*s", outValueLength,
-                   outValue ) );
+        LogInfo( ( "clientToken: %.*s", ( int ) clientTokenKey.valueLength,
+                   clientTokenKey.pValue ) );
 
         /* Convert the code to an unsigned integer value. */
-        receivedToken = ( uint32_t ) strtoul( outValue, NULL, 10 );
+        receivedToken = ( uint32_t ) strtoul( clientTokenKey.pValue, NULL, 10 );
 
         LogInfo( ( "receivedToken:%d, clientToken:%u \r\n", receivedToken, clientToken ) );
 
+        /* Only the fields of the update with this clientToken are accepted,
+         * as a later update may still be in flight. */
+        ShadowState_Complete( &reportedState, clientTokenKey.pValue, clientTokenKey.valueLength, true );
+
         /* If the clientToken in this update/accepted message matches the one we
          * published before, it means the device shadow has accepted our latest
          * reported state. We are done. */
@@ -576,20 +818,41 @@ static void updateAcceptedHandler( MQTTPublishInfo_t * pPublishInfo )
 
 /*-----------------------------------------------------------*/
 
+static void updateRejectedHandler( void * pContext,
+                                   size_t shadowIndex,
+                                   MQTTPublishInfo_t * pPublishInfo )
+{
+    JSONExtractKey_t clientTokenKey = JSON_EXTRACT_KEY( "clientToken" );
+
+    ( void ) pContext;
+    ( void ) shadowIndex;
+
+    assert( pPublishInfo != NULL );
+
+    LogInfo( ( "/update/rejected json payload:%.*s.",
+               ( int ) pPublishInfo->payloadLength,
+               ( const char * ) pPublishInfo->pPayload ) );
+
+    /* Report the fields of the rejected update again. The rejection holds the
+     * clientToken of the update. */
+    ( void ) JSONExtract_Keys( pPublishInfo->pPayload,
+                               pPublishInfo->payloadLength,
+                               &clientTokenKey,
+                               1U );
+    ShadowState_Complete( &reportedState, clientTokenKey.pValue, clientTokenKey.valueLength, false );
+}
+
+/*-----------------------------------------------------------*/
+
 /* This is the callback function invoked by the MQTT stack when it receives
- * incoming messages. This function demonstrates how to use the Shadow_MatchTopicString
- * function to determine whether the incoming message is a device shadow message
- * or not. If it is, it handles the message depending on the message type.
+ * incoming messages. The topic of an incoming publish is looked up in the
+ * topics assembled by the shadow session, which calls the handler registered
+ * for its message type.
  */
 static void eventCallback( MQTTContext_t * pMqttContext,
                            MQTTPacketInfo_t * pPacketInfo,
                            MQTTDeserializedInfo_t * pDeserializedInfo )
 {
-    ShadowMessageType_t messageType = ShadowMessageTypeMaxNum;
-    const char * pThingName = NULL;
-    uint8_t thingNameLength = 0U;
-    const char * pShadowName = NULL;
-    uint8_t shadowNameLength = 0U;
     uint16_t packetIdentifier;
 
     ( void ) pMqttContext;
@@ -606,56 +869,28 @@ static void eventCallback( MQTTContext_t * pMqttContext,
     if( ( pPacketInfo->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
     {
         assert( pDeserializedInfo->pPublishInfo != NULL );
-        LogInfo( ( "pPublishInfo->pTopicName:%s.", pDeserializedInfo->pPublishInfo->pTopicName ) );
-
-        /* Let the Device Shadow library tell us whether this is a device shadow message. */
-        if( SHADOW_SUCCESS == Shadow_MatchTopicString( pDeserializedInfo->pPublishInfo->pTopicName,
-                                                       pDeserializedInfo->pPublishInfo->topicNameLength,
-                                                       &messageType,
-                                                       &pThingName,
-                                                       &thingNameLength,
-                                                       &pShadowName,
-                                                       &shadowNameLength ) )
-        {
-            /* Upon successful return, the messageType has been filled in. */
-            if( messageType == ShadowMessageTypeUpdateDelta )
-            {
-                /* Handler function to process payload. */
-                updateDeltaHandler( pDeserializedInfo->pPublishInfo );
-            }
-            else if( messageType == ShadowMessageTypeUpdateAccepted )
-            {
-                /* Handler function to process payload. */
-                updateAcceptedHandler( pDeserializedInfo->pPublishInfo );
-            }
-            else if( messageType == ShadowMessageTypeUpdateDocuments )
-            {
-                LogInfo( ( "/update/documents json payload:%s.", ( const char * ) pDeserializedInfo->pPublishInfo->pPayload ) );
-            }
-            else if( messageType == ShadowMessageTypeUpdateRejected )
-            {
-                LogInfo( ( "/update/rejected json payload:%s.", ( const char * ) pDeserializedInfo->pPublishInfo->pPayload ) );
-            }
-            else if( messageType == ShadowMessageTypeDeleteAccepted )
+        LogInfo( ( "pPublishInfo->pTopicName:%.*s.",
+                   ( int ) pDeserializedInfo->pPublishInfo->topicNameLength,
+                   pDeserializedInfo->pPublishInfo->pTopicName ) );
+
+        #if ( SHADOW_USE_CBOR == 1 )
+            if( ( pDeserializedInfo->pPublishInfo->topicNameLength == SHADOW_CBOR_DELTA_TOPIC_LENGTH ) &&
+                ( memcmp( pDeserializedInfo->pPublishInfo->pTopicName,
+                          SHADOW_CBOR_DELTA_TOPIC,
+                          SHADOW_CBOR_DELTA_TOPIC_LENGTH ) == 0 ) )
             {
-                LogInfo( ( "Received an MQTT incoming publish on /delete/accepted topic." ) );
-                shadowDeleted = true;
-                deleteResponseReceived = true;
-            }
-            else if( messageType == ShadowMessageTypeDeleteRejected )
-            {
-                /* Handler function to process payload. */
-                deleteRejectedHandler( pDeserializedInfo->pPublishInfo );
-                deleteResponseReceived = true;
+                cborDeltaHandler( pDeserializedInfo->pPublishInfo );
             }
             else
-            {
-                LogInfo( ( "Other message type:%d !!", messageType ) );
-            }
-        }
-        else
+        #endif
+
+        /* A single lookup finds the shadow and the message type of the topic
+         * and calls the handler of that message type. */
+        if( ShadowSession_Dispatch( &shadowSession, pDeserializedInfo->pPublishInfo ) == false )
         {
-            LogError( ( "Shadow_MatchTopicString parse failed:%s !!", ( const char * ) pDeserializedInfo->pPublishInfo->pTopicName ) );
+            LogError( ( "Not a handled shadow topic:%.*s !!",
+                        ( int ) pDeserializedInfo->pPublishInfo->topicNameLength,
+                        pDeserializedInfo->pPublishInfo->pTopicName ) );
             eventCallbackError = true;
         }
     }
@@ -671,177 +906,154 @@ static int start_shadow_demo()
 {
     int returnStatus = EXIT_SUCCESS;
     int demoRunCount = 0;
+    ShadowStateStatus_t shadowStateStatus = SHADOW_STATE_SUCCESS;
+    char clientTokenString[ SHADOW_CLIENT_TOKEN_LENGTH + 1U ] = { 0 };
+    size_t updateDocumentLength = 0U;
+    ShadowSessionStatus_t sessionStatus = SHADOW_SESSION_SUCCESS;
+    const ShadowSessionName_t shadowNames[] =
+    {
+        { SHADOW_NAME, ( uint8_t ) SHADOW_NAME_LENGTH }
+    };
+    MQTTSubscribeInfo_t subscriptions[ SHADOW_DEMO_SUBSCRIPTION_COUNT ];
+    size_t subscriptionCount = 0U;
+    const char * pDeleteTopic = NULL;
+    uint16_t deleteTopicLength = 0U;
+    const char * pUpdateTopic = NULL;
+    uint16_t updateTopicLength = 0U;
 
     /* A buffer containing the update document. It has static duration to prevent
      * it from being placed on the call stack. */
-    static char updateDocument[ SHADOW_REPORTED_JSON_LENGTH + 1 ] = { 0 };
+    static char updateDocument[ SHADOW_UPDATE_DOCUMENT_SIZE ] = { 0 };
+
+    /* The thing name and shadow name do not change, so every topic of the
+     * shadow is assembled once here instead of for each publish and for each
+     * incoming message. */
+    sessionStatus = ShadowSession_Init( &shadowSession,
+                                        THING_NAME,
+                                        ( uint8_t ) THING_NAME_LENGTH,
+                                        shadowNames,
+                                        sizeof( shadowNames ) / sizeof( shadowNames[ 0 ] ),
+                                        NULL );
+
+    if( sessionStatus == SHADOW_SESSION_SUCCESS )
+    {
+        ( void ) ShadowSession_SetHandler( &shadowSession, ShadowMessageTypeDeleteAccepted, deleteAcceptedHandler );
+        ( void ) ShadowSession_SetHandler( &shadowSession, ShadowMessageTypeDeleteRejected, deleteRejectedHandler );
+        #if ( SHADOW_USE_CBOR == 0 )
+            ( void ) ShadowSession_SetHandler( &shadowSession, ShadowMessageTypeUpdateDelta, updateDeltaHandler );
+        #else
+            /* The deltas arrive in CBOR on #SHADOW_CBOR_DELTA_TOPIC instead. */
+            ( void ) updateDeltaHandler;
+        #endif
+        ( void ) ShadowSession_SetHandler( &shadowSession, ShadowMessageTypeUpdateAccepted, updateAcceptedHandler );
+        ( void ) ShadowSession_SetHandler( &shadowSession, ShadowMessageTypeUpdateRejected, updateRejectedHandler );
+
+        /* Only the topics of the message types with a handler are subscribed. */
+        subscriptionCount = ShadowSession_GetSubscriptions( &shadowSession,
+                                                            MQTTQoS1,
+                                                            subscriptions,
+                                                            SHADOW_DEMO_SUBSCRIPTION_COUNT );
+
+        #if ( SHADOW_USE_CBOR == 1 )
+            /* The deltas republished by the rule in CBOR arrive instead of
+             * the JSON deltas, in the same SUBSCRIBE. */
+            subscriptions[ subscriptionCount ].qos = MQTTQoS1;
+            subscriptions[ subscriptionCount ].pTopicFilter = SHADOW_CBOR_DELTA_TOPIC;
+            subscriptions[ subscriptionCount ].topicFilterLength = SHADOW_CBOR_DELTA_TOPIC_LENGTH;
+            subscriptionCount++;
+        #endif
+
+        ( void ) ShadowSession_GetTopic( &shadowSession, 0U, ShadowTopicStringTypeDelete,
+                                         &pDeleteTopic, &deleteTopicLength );
+        sessionStatus = ShadowSession_GetTopic( &shadowSession, 0U, ShadowTopicStringTypeUpdate,
+                                                &pUpdateTopic, &updateTopicLength );
+    }
 
-    do
+    if( ( sessionStatus != SHADOW_SESSION_SUCCESS ) || ( subscriptionCount == 0U ) )
     {
-        returnStatus = EstablishMqttSession( eventCallback );
+        LogError( ( "Failed to assemble the shadow topics: %d.", ( int ) sessionStatus ) );
+        returnStatus = EXIT_FAILURE;
+    }
 
-        if( returnStatus == EXIT_FAILURE )
-        {
-            /* Log error to indicate connection failure. */
-            LogError( ( "Failed to connect to MQTT broker." ) );
-        }
-        else
+    if( returnStatus == EXIT_SUCCESS )
+    {
+        do
         {
-            /* Reset the shadow delete status flags. */
-            deleteResponseReceived = false;
-            shadowDeleted = false;
-
-            /* First of all, try to delete any Shadow document in the cloud.
-             * Try to subscribe to `/delete/accepted` and `/delete/rejected` topics. */
-            returnStatus = SubscribeToTopic( SHADOW_TOPIC_STR_DELETE_ACC( THING_NAME, SHADOW_NAME ),
-                                             SHADOW_TOPIC_LEN_DELETE_ACC( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
-
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                /* Try to subscribe to `/delete/rejected` topic. */
-                returnStatus = SubscribeToTopic( SHADOW_TOPIC_STR_DELETE_REJ( THING_NAME, SHADOW_NAME ),
-                                                 SHADOW_TOPIC_LEN_DELETE_REJ( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
-            }
-
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                /* Publish to Shadow `delete` topic to attempt to delete the
-                 * Shadow document if exists. */
-                returnStatus = PublishToTopic( SHADOW_TOPIC_STR_DELETE( THING_NAME, SHADOW_NAME ),
-                                               SHADOW_TOPIC_LEN_DELETE( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ),
-                                               updateDocument,
-                                               0U );
-            }
-
-            /* Unsubscribe from the `/delete/accepted` and 'delete/rejected` topics.*/
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                returnStatus = UnsubscribeFromTopic( SHADOW_TOPIC_STR_DELETE_ACC( THING_NAME, SHADOW_NAME ),
-                                                     SHADOW_TOPIC_LEN_DELETE_ACC( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
-            }
+            returnStatus = EstablishMqttSession( eventCallback );
 
-            if( returnStatus == EXIT_SUCCESS )
+            if( returnStatus == EXIT_FAILURE )
             {
-                returnStatus = UnsubscribeFromTopic( SHADOW_TOPIC_STR_DELETE_REJ( THING_NAME, SHADOW_NAME ),
-                                                     SHADOW_TOPIC_LEN_DELETE_REJ( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
+                /* Log error to indicate connection failure. */
+                LogError( ( "Failed to connect to MQTT broker." ) );
             }
-
-            /* Check if an incoming publish on `/delete/accepted` or `/delete/rejected`
-             * topics. If a response is not received, mark the demo execution as a failure.*/
-            if( ( returnStatus == EXIT_SUCCESS ) && ( deleteResponseReceived != true ) )
+            else
             {
-                LogError( ( "Failed to receive a response for Shadow delete." ) );
-                returnStatus = EXIT_FAILURE;
-            }
+                /* Reset the shadow delete status flags. */
+                deleteResponseReceived = false;
+                shadowDeleted = false;
+
+                /* The shadow is deleted below, so the first update reports every
+                 * field. */
+                ( void ) ShadowState_Init( &reportedState,
+                                           reportedFields,
+                                           sizeof( reportedFields ) / sizeof( reportedFields[ 0 ] ),
+                                           SHADOW_REPORTED_MIN_INTERVAL_MS );
+                ( void ) ShadowState_SetUint( &reportedState, REPORTED_FIELD_POWER_ON, currentPowerOnState );
+
+                /* Subscribe to the `/delete` responses and to the `/update`
+                 * responses and deltas with a single SUBSCRIBE. */
+                returnStatus = SubscribeToTopics( subscriptions, subscriptionCount );
+
+                if( returnStatus == EXIT_SUCCESS )
+                {
+                    /* First of all, publish to Shadow `delete` topic to attempt to
+                     * delete the Shadow document if exists. */
+                    returnStatus = PublishToTopic( pDeleteTopic,
+                                                   deleteTopicLength,
+                                                   updateDocument,
+                                                   0U );
+                }
 
-            /* Check if Shadow document delete was successful. A delete can be
-             * successful in cases listed below.
-             *  1. If an incoming publish is received on `/delete/accepted` topic.
-             *  2. If an incoming publish is received on `/delete/rejected` topic
-             *     with an error code 404. This indicates that a delete was
-             *     attempted when a Shadow document is not available for the
-             *     Thing. */
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                if( shadowDeleted == false )
+                /* Check if an incoming publish on `/delete/accepted` or `/delete/rejected`
+                 * topics. If a response is not received, mark the demo execution as a failure.*/
+                if( ( returnStatus == EXIT_SUCCESS ) && ( deleteResponseReceived != true ) )
                 {
-                    LogError( ( "Shadow delete operation failed." ) );
+                    LogError( ( "Failed to receive a response for Shadow delete." ) );
                     returnStatus = EXIT_FAILURE;
                 }
-            }
-
-            /* Successfully connect to MQTT broker, the next step is
-             * to subscribe shadow topics. */
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                returnStatus = SubscribeToTopic( SHADOW_TOPIC_STR_UPDATE_DELTA( THING_NAME, SHADOW_NAME ),
-                                                 SHADOW_TOPIC_LEN_UPDATE_DELTA( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
-            }
 
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                returnStatus = SubscribeToTopic( SHADOW_TOPIC_STR_UPDATE_ACC( THING_NAME, SHADOW_NAME ),
-                                                 SHADOW_TOPIC_LEN_UPDATE_ACC( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
-            }
-
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                returnStatus = SubscribeToTopic( SHADOW_TOPIC_STR_UPDATE_REJ( THING_NAME, SHADOW_NAME ),
-                                                 SHADOW_TOPIC_LEN_UPDATE_REJ( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
-            }
+                /* Check if Shadow document delete was successful. A delete can be
+                 * successful in cases listed below.
+                 *  1. If an incoming publish is received on `/delete/accepted` topic.
+                 *  2. If an incoming publish is received on `/delete/rejected` topic
+                 *     with an error code 404. This indicates that a delete was
+                 *     attempted when a Shadow document is not available for the
+                 *     Thing. */
+                if( returnStatus == EXIT_SUCCESS )
+                {
+                    if( shadowDeleted == false )
+                    {
+                        LogError( ( "Shadow delete operation failed." ) );
+                        returnStatus = EXIT_FAILURE;
+                    }
+                }
 
-            /* This demo uses a constant #THING_NAME and #SHADOW_NAME known at compile time therefore
-             * we can use macros to assemble shadow topic strings.
-             * If the thing name or shadow name is only known at run time, then we could use the API
-             * #Shadow_AssembleTopicString to assemble shadow topic strings, here is the example for /update/delta:
-             *
-             * For /update/delta:
-             *
-             * #define SHADOW_TOPIC_MAX_LENGTH  (256U)
-             *
-             * ShadowStatus_t shadowStatus = SHADOW_SUCCESS;
-             * char topicBuffer[ SHADOW_TOPIC_MAX_LENGTH ] = { 0 };
-             * uint16_t bufferSize = SHADOW_TOPIC_MAX_LENGTH;
-             * uint16_t outLength = 0;
-             * const char thingName[] = { "TestThingName" };
-             * uint16_t thingNameLength  = ( sizeof( thingName ) - 1U );
-             * const char shadowName[] = { "TestShadowName" };
-             * uint16_t shadowNameLength  = ( sizeof( shadowName ) - 1U );
-             *
-             * shadowStatus = Shadow_AssembleTopicString( ShadowTopicStringTypeUpdateDelta,
-             *                                            thingName,
-             *                                            thingNameLength,
-             *                                            shadowName,
-             *                                            shadowNameLength,
-             *                                            & ( topicBuffer[ 0 ] ),
-             *                                            bufferSize,
-             *                                            & outLength );
-             */
-
-            /* Then we publish a desired state to the /update topic. Since we've deleted
-             * the device shadow at the beginning of the demo, this will cause a delta message
-             * to be published, which we have subscribed to.
-             * In many real applications, the desired state is not published by
-             * the device itself. But for the purpose of making this demo self-contained,
-             * we publish one here so that we can receive a delta message later.
-             */
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                /* desired power on state . */
-                LogInfo( ( "Send desired power state with 1." ) );
-
-                ( void ) memset( updateDocument,
-                                 0x00,
-                                 sizeof( updateDocument ) );
-
-                /* Keep the client token in global variable used to compare if
-                 * the same token in /update/accepted. */
-                clientToken = ( Clock_GetTimeMs() % 1000000 );
-
-                snprintf( updateDocument,
-                          SHADOW_DESIRED_JSON_LENGTH + 1,
-                          SHADOW_DESIRED_JSON,
-                          ( int ) 1,
-                          ( long unsigned ) clientToken );
-
-                returnStatus = PublishToTopic( SHADOW_TOPIC_STR_UPDATE( THING_NAME, SHADOW_NAME ),
-                                               SHADOW_TOPIC_LEN_UPDATE( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ),
-                                               updateDocument,
-                                               ( SHADOW_DESIRED_JSON_LENGTH + 1 ) );
-            }
+                /* This demo uses a constant #THING_NAME and #SHADOW_NAME, but the
+                 * shadow session assembles its topics with #Shadow_AssembleTopicString,
+                 * so the names may as well only be known at run time. */
 
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                /* Note that PublishToTopic already called MQTT_ProcessLoop,
-                 * therefore responses may have been received and the eventCallback
-                 * may have been called, which may have changed the stateChanged flag.
-                 * Check if the state change flag has been modified or not. If it's modified,
-                 * then we publish reported state to update topic.
+                /* Then we publish a desired state to the /update topic. Since we've deleted
+                 * the device shadow at the beginning of the demo, this will cause a delta message
+                 * to be published, which we have subscribed to.
+                 * In many real applications, the desired state is not published by
+                 * the device itself. But for the purpose of making this demo self-contained,
+                 * we publish one here so that we can receive a delta message later.
                  */
-                if( stateChanged == true )
+                if( returnStatus == EXIT_SUCCESS )
                 {
-                    /* Report the latest power state back to device shadow. */
-                    LogInfo( ( "Report to the state change: %d", currentPowerOnState ) );
+                    /* desired power on state . */
+                    LogInfo( ( "Send desired power state with 1." ) );
+
                     ( void ) memset( updateDocument,
                                      0x00,
                                      sizeof( updateDocument ) );
@@ -851,73 +1063,135 @@ static int start_shadow_demo()
                     clientToken = ( Clock_GetTimeMs() % 1000000 );
 
                     snprintf( updateDocument,
-                              SHADOW_REPORTED_JSON_LENGTH + 1,
-                              SHADOW_REPORTED_JSON,
-                              ( int ) currentPowerOnState,
+                              SHADOW_DESIRED_JSON_LENGTH + 1,
+                              SHADOW_DESIRED_JSON,
+                              ( int ) 1,
                               ( long unsigned ) clientToken );
 
-                    returnStatus = PublishToTopic( SHADOW_TOPIC_STR_UPDATE( THING_NAME, SHADOW_NAME ),
-                                                   SHADOW_TOPIC_LEN_UPDATE( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ),
+                    returnStatus = PublishToTopic( pUpdateTopic,
+                                                   updateTopicLength,
                                                    updateDocument,
-                                                   ( SHADOW_REPORTED_JSON_LENGTH + 1 ) );
+                                                   ( SHADOW_DESIRED_JSON_LENGTH + 1 ) );
+                }
+
+                if( returnStatus == EXIT_SUCCESS )
+                {
+                    /* Note that PublishToTopic already called MQTT_ProcessLoop,
+                     * therefore responses may have been received and the eventCallback
+                     * may have been called, which may have changed the stateChanged flag.
+                     * Check if the state change flag has been modified or not. If it's modified,
+                     * then we publish reported state to update topic.
+                     */
+                    if( ( stateChanged == true ) &&
+                        ( ShadowState_UpdateDue( &reportedState, Clock_GetTimeMs() ) == true ) )
+                    {
+                        /* Report the latest power state back to device shadow. */
+                        LogInfo( ( "Report to the state change: %d", currentPowerOnState ) );
+
+                        /* Keep the client token in global variable used to compare if
+                         * the same token in /update/accepted. */
+                        clientToken = ( Clock_GetTimeMs() % 1000000 );
+
+                        snprintf( clientTokenString,
+                                  sizeof( clientTokenString ),
+                                  "%06lu",
+                                  ( long unsigned ) ( clientToken % 1000000U ) );
+
+                        /* Only the fields changed since the last update are
+                         * reported. The document is written in the buffer that is
+                         * published. */
+                        #if ( SHADOW_USE_CBOR == 1 )
+                            logEncodingComparison( clientTokenString );
+
+                            shadowStateStatus = ShadowState_SerializeReportedCbor( &reportedState,
+                                                                                   Clock_GetTimeMs(),
+                                                                                   clientTokenString,
+                                                                                   SHADOW_CLIENT_TOKEN_LENGTH,
+                                                                                   ( uint8_t * ) updateDocument,
+                                                                                   sizeof( updateDocument ),
+                                                                                   &updateDocumentLength );
+                        #else
+                            shadowStateStatus = ShadowState_SerializeReported( &reportedState,
+                                                                               Clock_GetTimeMs(),
+                                                                               clientTokenString,
+                                                                               SHADOW_CLIENT_TOKEN_LENGTH,
+                                                                               updateDocument,
+                                                                               sizeof( updateDocument ),
+                                                                               &updateDocumentLength );
+                        #endif
+
+                        if( shadowStateStatus == SHADOW_STATE_SUCCESS )
+                        {
+                            #if ( SHADOW_USE_CBOR == 1 )
+                                /* The rule updates the shadow, which answers on
+                                 * /update/accepted as for a JSON update. */
+                                returnStatus = PublishToTopic( SHADOW_CBOR_UPDATE_TOPIC,
+                                                               SHADOW_CBOR_UPDATE_TOPIC_LENGTH,
+                                                               updateDocument,
+                                                               updateDocumentLength );
+                            #else
+                                returnStatus = PublishToTopic( pUpdateTopic,
+                                                               updateTopicLength,
+                                                               updateDocument,
+                                                               updateDocumentLength );
+                            #endif
+
+                            if( returnStatus != EXIT_SUCCESS )
+                            {
+                                ShadowState_Complete( &reportedState, clientTokenString, SHADOW_CLIENT_TOKEN_LENGTH, false );
+                            }
+                        }
+                        else
+                        {
+                            LogError( ( "Failed to serialize the reported state: %d.", ( int ) shadowStateStatus ) );
+                            returnStatus = EXIT_FAILURE;
+                        }
+                    }
+                    else
+                    {
+                        LogInfo( ( "No change from /update/delta, unsubscribe all shadow topics and disconnect from MQTT.\r\n" ) );
+                    }
                 }
-                else
+
+                if( returnStatus == EXIT_SUCCESS )
                 {
-                    LogInfo( ( "No change from /update/delta, unsubscribe all shadow topics and disconnect from MQTT.\r\n" ) );
+                    LogInfo( ( "Start to unsubscribe shadow topics and disconnect from MQTT. \r\n" ) );
+                    returnStatus = UnsubscribeFromTopics( subscriptions, subscriptionCount );
                 }
+
+                /* The MQTT session is always disconnected, even there were prior failures. */
+                returnStatus = DisconnectMqttSession();
             }
 
-            if( returnStatus == EXIT_SUCCESS )
+            /* This demo performs only Device Shadow operations. If matching the Shadow
+             * topic fails or there are failures in parsing the received JSON document,
+             * then this demo was not successful. */
+            if( eventCallbackError == true )
             {
-                LogInfo( ( "Start to unsubscribe shadow topics and disconnect from MQTT. \r\n" ) );
-                returnStatus = UnsubscribeFromTopic( SHADOW_TOPIC_STR_UPDATE_DELTA( THING_NAME, SHADOW_NAME ),
-                                                     SHADOW_TOPIC_LEN_UPDATE_DELTA( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
+                returnStatus = EXIT_FAILURE;
             }
 
+            /* Increment the demo run count. */
+            demoRunCount++;
+
             if( returnStatus == EXIT_SUCCESS )
             {
-                returnStatus = UnsubscribeFromTopic( SHADOW_TOPIC_STR_UPDATE_ACC( THING_NAME, SHADOW_NAME ),
-                                                     SHADOW_TOPIC_LEN_UPDATE_ACC( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
+                LogInfo( ( "Demo iteration %d is successful.", demoRunCount ) );
             }
-
-            if( returnStatus == EXIT_SUCCESS )
+            /* Attempt to retry a failed iteration of demo for up to #SHADOW_MAX_DEMO_LOOP_COUNT times. */
+            else if( demoRunCount < SHADOW_MAX_DEMO_LOOP_COUNT )
             {
-                returnStatus = UnsubscribeFromTopic( SHADOW_TOPIC_STR_UPDATE_REJ( THING_NAME, SHADOW_NAME ),
-                                                     SHADOW_TOPIC_LEN_UPDATE_REJ( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
+                LogWarn( ( "Demo iteration %d failed. Retrying...", demoRunCount ) );
+                k_sleep( K_SECONDS( DELAY_BETWEEN_DEMO_RETRY_ITERATIONS_S ) );
             }
-
-            /* The MQTT session is always disconnected, even there were prior failures. */
-            returnStatus = DisconnectMqttSession();
-        }
-
-        /* This demo performs only Device Shadow operations. If matching the Shadow
-         * topic fails or there are failures in parsing the received JSON document,
-         * then this demo was not successful. */
-        if( eventCallbackError == true )
-        {
-            returnStatus = EXIT_FAILURE;
-        }
-
-        /* Increment the demo run count. */
-        demoRunCount++;
-
-        if( returnStatus == EXIT_SUCCESS )
-        {
-            LogInfo( ( "Demo iteration %d is successful.", demoRunCount ) );
-        }
-        /* Attempt to retry a failed iteration of demo for up to #SHADOW_MAX_DEMO_LOOP_COUNT times. */
-        else if( demoRunCount < SHADOW_MAX_DEMO_LOOP_COUNT )
-        {
-            LogWarn( ( "Demo iteration %d failed. Retrying...", demoRunCount ) );
-            k_sleep( K_SECONDS( DELAY_BETWEEN_DEMO_RETRY_ITERATIONS_S ) );
-        }
-        /* Failed all #SHADOW_MAX_DEMO_LOOP_COUNT demo iterations. */
-        else
-        {
-            LogError( ( "All %d demo iterations failed.", SHADOW_MAX_DEMO_LOOP_COUNT ) );
-            break;
-        }
-    } while( returnStatus != EXIT_SUCCESS );
+            /* Failed all #SHADOW_MAX_DEMO_LOOP_COUNT demo iterations. */
+            else
+            {
+                LogError( ( "All %d demo iterations failed.", SHADOW_MAX_DEMO_LOOP_COUNT ) );
+                break;
+            }
+        } while( returnStatus != EXIT_SUCCESS );
+    }
 
     if( returnStatus == EXIT_SUCCESS )
     {
@@ -52,6 +52,14 @@
 /* Clock for timer. */
 #include "clock.h"
 
+/* Outgoing publishes kept until they are acknowledged. */
+#include "outgoing_publish_tracker.h"
+
+#if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+    /* Network buffers shared with the other clients. */
+    #include "network_buffer_pool.h"
+#endif
+
 /**
  * These configuration settings are required to run the shadow demo.
  * Throw compilation error if the below configs are not defined.
@@ -142,12 +150,6 @@
  */
 #define MAX_OUTGOING_PUBLISHES              ( 5U )
 
-/**
- * @brief Invalid packet identifier for the MQTT packets. Zero is always an
- * invalid packet identifier as per MQTT 3.1.1 spec.
- */
-#define MQTT_PACKET_ID_INVALID              ( ( uint16_t ) 0U )
-
 /**
  * @brief Timeout for MQTT_ProcessLoop function in milliseconds.
  */
@@ -181,25 +183,6 @@
 
 /*-----------------------------------------------------------*/
 
-/**
- * @brief Structure to keep the MQTT publish packets until an ack is received
- * for QoS1 publishes.
- */
-typedef struct PublishPackets
-{
-    /**
-     * @brief Packet identifier of the publish packet.
-     */
-    uint16_t packetId;
-
-    /**
-     * @brief Publish info of the publish packet.
-     */
-    MQTTPublishInfo_t pubInfo;
-} PublishPackets_t;
-
-/*-----------------------------------------------------------*/
-
 /* Each compilation unit must define the NetworkContext struct. */
 struct NetworkContext
 {
@@ -222,16 +205,25 @@ static uint16_t globalSubscribePacketIdentifier = 0U;
 static uint16_t globalUnsubscribePacketIdentifier = 0U;
 
 /**
- * @brief Array to keep the outgoing publish messages.
- * These stored outgoing publish messages are kept until a successful ack
+ * @brief Outgoing publish messages, kept until a successful ack
  * is received.
  */
-static PublishPackets_t outgoingPublishPackets[ MAX_OUTGOING_PUBLISHES ] = { 0 };
+OUTGOING_PUBLISH_TRACKER_DEFINE( outgoingPublishes, MAX_OUTGOING_PUBLISHES );
+
+#if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+
+/**
+ * @brief The network buffer, taken from the shared pool for each MQTT session
+ * and returned once it is disconnected.
+ */
+    static uint8_t * pNetworkBuffer = NULL;
+#else
 
 /**
  * @brief The network buffer must remain valid for the lifetime of the MQTT context.
  */
-static uint8_t buffer[ NETWORK_BUFFER_SIZE ];
+    static uint8_t buffer[ NETWORK_BUFFER_SIZE ];
+#endif
 
 /**
  * @brief The MQTT context used for MQTT operation.
@@ -276,49 +268,6 @@ static uint32_t generateRandomNumber();
  */
 static int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext );
 
-/**
- * @brief Function to get the free index at which an outgoing publish
- * can be stored.
- *
- * @param[out] pIndex The output parameter to return the index at which an
- * outgoing publish message can be stored.
- *
- * @return EXIT_FAILURE if no more publishes can be stored;
- * EXIT_SUCCESS if an index to store the next outgoing publish is obtained.
- */
-static int getNextFreeIndexForOutgoingPublishes( uint8_t * pIndex );
-
-/**
- * @brief Function to clean up an outgoing publish at given index from the
- * #outgoingPublishPackets array.
- *
- * @param[in] index The index at which a publish message has to be cleaned up.
- */
-static void cleanupOutgoingPublishAt( uint8_t index );
-
-/**
- * @brief Function to clean up all the outgoing publishes maintained in the
- * array.
- */
-static void cleanupOutgoingPublishes( void );
-
-/**
- * @brief Function to clean up the publish packet with the given packet id.
- *
- * @param[in] packetId Packet identifier of the packet to be cleaned up from
- * the array.
- */
-static void cleanupOutgoingPublishWithPacketID( uint16_t packetId );
-
-/**
- * @brief Function to resend the publishes if a session is re-established with
- * the broker. This function handles the resending of the QoS1 publish packets,
- * which are maintained locally.
- *
- * @param[in] pMqttContext MQTT context pointer.
- */
-static int handlePublishResend( MQTTContext_t * pMqttContext );
-
 /*-----------------------------------------------------------*/
 
 static uint32_t generateRandomNumber()
@@ -390,7 +339,8 @@ static int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext
                                               &serverInfo,
                                               &networkCredentials,
                                               TRANSPORT_SEND_RECV_TIMEOUT_MS,
-                                              TRANSPORT_SEND_RECV_TIMEOUT_MS );
+                                              TRANSPORT_SEND_RECV_TIMEOUT_MS,
+                                              NULL );
 
         if( tlsTransportStatus != TLS_TRANSPORT_SUCCESS )
         {
@@ -417,77 +367,6 @@ static int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext
 
 /*-----------------------------------------------------------*/
 
-static int getNextFreeIndexForOutgoingPublishes( uint8_t * pIndex )
-{
-    int returnStatus = EXIT_FAILURE;
-    uint8_t index = 0;
-
-    assert( outgoingPublishPackets != NULL );
-    assert( pIndex != NULL );
-
-    for( index = 0; index < MAX_OUTGOING_PUBLISHES; index++ )
-    {
-        /* A free index is marked by invalid packet id.
-         * Check if the the index has a free slot. */
-        if( outgoingPublishPackets[ index ].packetId == MQTT_PACKET_ID_INVALID )
-        {
-            returnStatus = EXIT_SUCCESS;
-            break;
-        }
-    }
-
-    /* Copy the available index into the output param. */
-    *pIndex = index;
-
-    return returnStatus;
-}
-/*-----------------------------------------------------------*/
-
-static void cleanupOutgoingPublishAt( uint8_t index )
-{
-    assert( outgoingPublishPackets != NULL );
-    assert( index < MAX_OUTGOING_PUBLISHES );
-
-    /* Clear the outgoing publish packet. */
-    ( void ) memset( &( outgoingPublishPackets[ index ] ),
-                     0x00,
-                     sizeof( outgoingPublishPackets[ index ] ) );
-}
-
-/*-----------------------------------------------------------*/
-
-static void cleanupOutgoingPublishes( void )
-{
-    assert( outgoingPublishPackets != NULL );
-
-    /* Clean up all the outgoing publish packets. */
-    ( void ) memset( outgoingPublishPackets, 0x00, sizeof( outgoingPublishPackets ) );
-}
-
-/*-----------------------------------------------------------*/
-
-static void cleanupOutgoingPublishWithPacketID( uint16_t packetId )
-{
-    uint8_t index = 0;
-
-    assert( outgoingPublishPackets != NULL );
-    assert( packetId != MQTT_PACKET_ID_INVALID );
-
-    /* Clean up all the saved outgoing publishes. */
-    for( ; index < MAX_OUTGOING_PUBLISHES; index++ )
-    {
-        if( outgoingPublishPackets[ index ].packetId == packetId )
-        {
-            cleanupOutgoingPublishAt( index );
-            LogInfo( ( "Cleaned up outgoing publish packet with packet id %u.",
-                       packetId ) );
-            break;
-        }
-    }
-}
-
-/*-----------------------------------------------------------*/
-
 void HandleOtherIncomingPacket( MQTTPacketInfo_t * pPacketInfo,
                                 uint16_t packetIdentifier )
 {
@@ -518,7 +397,7 @@ void HandleOtherIncomingPacket( MQTTPacketInfo_t * pPacketInfo,
             LogInfo( ( "PUBACK received for packet id %u.",
                        packetIdentifier ) );
             /* Cleanup publish packet when a PUBACK is received. */
-            cleanupOutgoingPublishWithPacketID( packetIdentifier );
+            ( void ) OutgoingPublish_Remove( &outgoingPublishes, packetIdentifier );
             break;
 
         /* Any other packet type is invalid. */
@@ -530,51 +409,6 @@ void HandleOtherIncomingPacket( MQTTPacketInfo_t * pPacketInfo,
 
 /*-----------------------------------------------------------*/
 
-static int handlePublishResend( MQTTContext_t * pMqttContext )
-{
-    int returnStatus = EXIT_SUCCESS;
-    MQTTStatus_t mqttStatus = MQTTSuccess;
-    uint8_t index = 0U;
-
-    assert( outgoingPublishPackets != NULL );
-
-    /* Resend all the QoS1 publishes still in the array. These are the
-     * publishes that hasn't received a PUBACK. When a PUBACK is
-     * received, the publish is removed from the array. */
-    for( index = 0U; index < MAX_OUTGOING_PUBLISHES; index++ )
-    {
-        if( outgoingPublishPackets[ index ].packetId != MQTT_PACKET_ID_INVALID )
-        {
-            outgoingPublishPackets[ index ].pubInfo.dup = true;
-
-            LogInfo( ( "Sending duplicate PUBLISH with packet id %u.",
-                       outgoingPublishPackets[ index ].packetId ) );
-            mqttStatus = MQTT_Publish( pMqttContext,
-                                       &outgoingPublishPackets[ index ].pubInfo,
-                                       outgoingPublishPackets[ index ].packetId );
-
-            if( mqttStatus != MQTTSuccess )
-            {
-                LogError( ( "Sending duplicate PUBLISH for packet id %u "
-                            " failed with status %u.",
-                            outgoingPublishPackets[ index ].packetId,
-                            mqttStatus ) );
-                returnStatus = EXIT_FAILURE;
-                break;
-            }
-            else
-            {
-                LogInfo( ( "Sent duplicate PUBLISH successfully for packet id %u.",
-                           outgoingPublishPackets[ index ].packetId ) );
-            }
-        }
-    }
-
-    return returnStatus;
-}
-
-/*-----------------------------------------------------------*/
-
 int EstablishMqttSession( MQTTEventCallback_t eventCallback )
 {
     int returnStatus = EXIT_SUCCESS;
@@ -612,9 +446,17 @@ int EstablishMqttSession( MQTTEventCallback_t eventCallback )
         transport.pNetworkContext = pNetworkContext;
         transport.send = MbedTLS_send;
         transport.recv = MbedTLS_recv;
+        transport.writev = MbedTLS_Writev;
 
         /* Fill the values for network buffer. */
-        networkBuffer.pBuffer = buffer;
+        #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+            pNetworkBuffer = NetworkBufferPool_Alloc( "shadow",
+                                                      NETWORK_BUFFER_SIZE,
+                                                      CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_WAIT_MS );
+            networkBuffer.pBuffer = pNetworkBuffer;
+        #else
+            networkBuffer.pBuffer = buffer;
+        #endif
         networkBuffer.size = NETWORK_BUFFER_SIZE;
 
         /* Initialize MQTT library. */
@@ -696,7 +538,7 @@ int EstablishMqttSession( MQTTEventCallback_t eventCallback )
                            "Resending unacked publishes." ) );
 
                 /* Handle all the resend of publish messages. */
-                returnStatus = handlePublishResend( &mqttContext );
+                returnStatus = ( OutgoingPublish_Resend( &outgoingPublishes, &mqttContext ) == MQTTSuccess ) ? EXIT_SUCCESS : EXIT_FAILURE;
             }
             else
             {
@@ -705,11 +547,20 @@ int EstablishMqttSession( MQTTEventCallback_t eventCallback )
 
                 /* Clean up the outgoing publishes waiting for ack as this new
                  * connection doesn't re-establish an existing session. */
-                cleanupOutgoingPublishes();
+                OutgoingPublish_RemoveAll( &outgoingPublishes );
             }
         }
     }
 
+    #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+        /* DisconnectMqttSession() is only called for an established session. */
+        if( returnStatus != EXIT_SUCCESS )
+        {
+            NetworkBufferPool_Free( pNetworkBuffer );
+            pNetworkBuffer = NULL;
+        }
+    #endif
+
     return returnStatus;
 }
 
@@ -741,6 +592,12 @@ int32_t DisconnectMqttSession( void )
     /* End TLS session, then close TCP connection. */
     ( void ) MbedTLS_Disconnect( pNetworkContext );
 
+    #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+        /* Let the other clients use the buffer until the next session. */
+        NetworkBufferPool_Free( pNetworkBuffer );
+        pNetworkBuffer = NULL;
+    #endif
+
     return returnStatus;
 }
 
@@ -872,6 +729,98 @@ int32_t UnsubscribeFromTopic( const char * pTopicFilter,
 
 /*-----------------------------------------------------------*/
 
+int32_t SubscribeToTopics( const MQTTSubscribeInfo_t * pSubscriptionList,
+                           size_t subscriptionCount )
+{
+    int returnStatus = EXIT_SUCCESS;
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t * pMqttContext = &mqttContext;
+
+    assert( pSubscriptionList != NULL );
+    assert( subscriptionCount > 0 );
+
+    /* Generate packet identifier for the SUBSCRIBE packet. */
+    globalSubscribePacketIdentifier = MQTT_GetPacketId( pMqttContext );
+
+    /* Send all of the topic filters in a single SUBSCRIBE packet. */
+    mqttStatus = MQTT_Subscribe( pMqttContext,
+                                 pSubscriptionList,
+                                 subscriptionCount,
+                                 globalSubscribePacketIdentifier );
+
+    if( mqttStatus != MQTTSuccess )
+    {
+        LogError( ( "Failed to send SUBSCRIBE packet to broker with error = %u.",
+                    mqttStatus ) );
+        returnStatus = EXIT_FAILURE;
+    }
+    else
+    {
+        LogInfo( ( "SUBSCRIBE sent for %u topics to broker.",
+                   ( unsigned int ) subscriptionCount ) );
+
+        /* Process incoming packet from the broker. The single SUBACK carries
+         * a return code for every topic filter in the request. */
+        mqttStatus = MQTT_ProcessLoop( pMqttContext, MQTT_PROCESS_LOOP_TIMEOUT_MS );
+
+        if( mqttStatus != MQTTSuccess )
+        {
+            returnStatus = EXIT_FAILURE;
+            LogError( ( "MQTT_ProcessLoop returned with status = %u.",
+                        mqttStatus ) );
+        }
+    }
+
+    return returnStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t UnsubscribeFromTopics( const MQTTSubscribeInfo_t * pSubscriptionList,
+                               size_t subscriptionCount )
+{
+    int returnStatus = EXIT_SUCCESS;
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t * pMqttContext = &mqttContext;
+
+    assert( pSubscriptionList != NULL );
+    assert( subscriptionCount > 0 );
+
+    /* Generate packet identifier for the UNSUBSCRIBE packet. */
+    globalUnsubscribePacketIdentifier = MQTT_GetPacketId( pMqttContext );
+
+    /* Send all of the topic filters in a single UNSUBSCRIBE packet. */
+    mqttStatus = MQTT_Unsubscribe( pMqttContext,
+                                   pSubscriptionList,
+                                   subscriptionCount,
+                                   globalUnsubscribePacketIdentifier );
+
+    if( mqttStatus != MQTTSuccess )
+    {
+        LogError( ( "Failed to send UNSUBSCRIBE packet to broker with error = %u.",
+                    mqttStatus ) );
+        returnStatus = EXIT_FAILURE;
+    }
+    else
+    {
+        LogInfo( ( "UNSUBSCRIBE sent for %u topics to broker.",
+                   ( unsigned int ) subscriptionCount ) );
+
+        mqttStatus = MQTT_ProcessLoop( pMqttContext, MQTT_PROCESS_LOOP_TIMEOUT_MS );
+
+        if( mqttStatus != MQTTSuccess )
+        {
+            returnStatus = EXIT_FAILURE;
+            LogError( ( "MQTT_ProcessLoop returned with status = %u.",
+                        mqttStatus ) );
+        }
+    }
+
+    return returnStatus;
+}
+
+/*-----------------------------------------------------------*/
+
 int32_t PublishToTopic( const char * pTopicFilter,
                         int32_t topicFilterLength,
                         const char * pPayload,
@@ -879,46 +828,44 @@ int32_t PublishToTopic( const char * pTopicFilter,
 {
     int returnStatus = EXIT_SUCCESS;
     MQTTStatus_t mqttStatus = MQTTSuccess;
-    uint8_t publishIndex = MAX_OUTGOING_PUBLISHES;
+    OutgoingPublish_t * pPublish = NULL;
     MQTTContext_t * pMqttContext = &mqttContext;
 
     assert( pMqttContext != NULL );
     assert( pTopicFilter != NULL );
     assert( topicFilterLength > 0 );
 
-    /* Get the next free index for the outgoing publish. All QoS1 outgoing
+    /* Store the outgoing publish with a new packet id. All QoS1 outgoing
      * publishes are stored until a PUBACK is received. These messages are
      * stored for supporting a resend if a network connection is broken before
      * receiving a PUBACK. */
-    returnStatus = getNextFreeIndexForOutgoingPublishes( &publishIndex );
+    pPublish = OutgoingPublish_Add( &outgoingPublishes, MQTT_GetPacketId( pMqttContext ) );
 
-    if( returnStatus == EXIT_FAILURE )
+    if( pPublish == NULL )
     {
         LogError( ( "Unable to find a free spot for outgoing PUBLISH message." ) );
+        returnStatus = EXIT_FAILURE;
     }
     else
     {
         LogInfo( ( "Published payload: %s", pPayload ) );
         /* This example publishes to only one topic and uses QOS1. */
-        outgoingPublishPackets[ publishIndex ].pubInfo.qos = MQTTQoS1;
-        outgoingPublishPackets[ publishIndex ].pubInfo.pTopicName = pTopicFilter;
-        outgoingPublishPackets[ publishIndex ].pubInfo.topicNameLength = topicFilterLength;
-        outgoingPublishPackets[ publishIndex ].pubInfo.pPayload = pPayload;
-        outgoingPublishPackets[ publishIndex ].pubInfo.payloadLength = payloadLength;
-
-        /* Get a new packet id. */
-        outgoingPublishPackets[ publishIndex ].packetId = MQTT_GetPacketId( pMqttContext );
+        pPublish->pubInfo.qos = MQTTQoS1;
+        pPublish->pubInfo.pTopicName = pTopicFilter;
+        pPublish->pubInfo.topicNameLength = topicFilterLength;
+        pPublish->pubInfo.pPayload = pPayload;
+        pPublish->pubInfo.payloadLength = payloadLength;
 
         /* Send PUBLISH packet. */
         mqttStatus = MQTT_Publish( pMqttContext,
-                                   &outgoingPublishPackets[ publishIndex ].pubInfo,
-                                   outgoingPublishPackets[ publishIndex ].packetId );
+                                   &( pPublish->pubInfo ),
+                                   pPublish->packetId );
 
         if( mqttStatus != MQTTSuccess )
         {
             LogError( ( "Failed to send PUBLISH packet to broker with error = %u.",
                         mqttStatus ) );
-            cleanupOutgoingPublishAt( publishIndex );
+            ( void ) OutgoingPublish_Remove( &outgoingPublishes, pPublish->packetId );
             returnStatus = EXIT_FAILURE;
         }
         else
@@ -926,7 +873,7 @@ int32_t PublishToTopic( const char * pTopicFilter,
             LogInfo( ( "PUBLISH sent for topic %.*s to broker with packet ID %u.",
                        topicFilterLength,
                        pTopicFilter,
-                       outgoingPublishPackets[ publishIndex ].packetId ) );
+                       pPublish->packetId ) );
 
             /* Calling MQTT_ProcessLoop to process incoming publish echo, since
              * application subscribed to the same topic the broker will send
@@ -84,6 +84,31 @@ int32_t SubscribeToTopic( const char * pTopicFilter,
 int32_t UnsubscribeFromTopic( const char * pTopicFilter,
                               uint16_t topicFilterLength );
 
+/**
+ * @brief Subscribe to several MQTT topic filters with a single SUBSCRIBE.
+ *
+ * @param[in] pSubscriptionList The topic filters and their QoS.
+ * @param[in] subscriptionCount Number of entries in pSubscriptionList.
+ *
+ * @return EXIT_SUCCESS if SUBSCRIBE was successfully sent;
+ * EXIT_FAILURE otherwise.
+ */
+int32_t SubscribeToTopics( const MQTTSubscribeInfo_t * pSubscriptionList,
+                           size_t subscriptionCount );
+
+/**
+ * @brief Unsubscribe from several MQTT topic filters with a single
+ * UNSUBSCRIBE.
+ *
+ * @param[in] pSubscriptionList The topic filters to unsubscribe from.
+ * @param[in] subscriptionCount Number of entries in pSubscriptionList.
+ *
+ * @return EXIT_SUCCESS if UNSUBSCRIBE was successfully sent;
+ * EXIT_FAILURE otherwise.
+ */
+int32_t UnsubscribeFromTopics( const MQTTSubscribeInfo_t * pSubscriptionList,
+                               size_t subscriptionCount );
+
 /**
  * @brief Publish a message to a MQTT topic.
  *
@@ -0,0 +1,52 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file esp32_crypto_alt_config.h
+ * @brief mbed TLS user configuration that moves the AES block cipher onto the
+ * ESP32 AES accelerator.
+ *
+ * Zephyr includes this file at the end of its mbed TLS configuration when the
+ * application is built with platform/espressif/crypto/esp32_hw_crypto.conf,
+ * which sets CONFIG_MBEDTLS_USER_CONFIG_FILE to it.
+ */
+
+#ifndef ESP32_CRYPTO_ALT_CONFIG_H_
+#define ESP32_CRYPTO_ALT_CONFIG_H_
+
+/* Replace the key schedule and the single block operations of mbed TLS with
+ * the implementation in esp32_aes_alt.c. The cipher modes of mbed TLS (GCM,
+ * CCM, CBC, CTR ...) are unchanged and run on top of the accelerator, so TLS
+ * record encryption and decryption use the hardware. */
+#define MBEDTLS_AES_SETKEY_ENC_ALT
+#define MBEDTLS_AES_SETKEY_DEC_ALT
+#define MBEDTLS_AES_ENCRYPT_ALT
+#define MBEDTLS_AES_DECRYPT_ALT
+
+/* The ESP32 has no ECC engine, so the ECDHE and ECDSA arithmetic of the
+ * handshake stays in software. Use the fast reduction of the NIST curves for
+ * it, which shortens P-256 handshakes at a small cost in code size. */
+#ifndef MBEDTLS_ECP_NIST_OPTIM
+    #define MBEDTLS_ECP_NIST_OPTIM
+#endif
+
+#endif /* ifndef ESP32_CRYPTO_ALT_CONFIG_H_ */
@@ -0,0 +1,225 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file esp32_aes_alt.c
+ * @brief mbed TLS AES block functions implemented on the ESP32 AES accelerator.
+ *
+ * The accelerator takes the raw key, so the "key schedule" kept in
+ * mbedtls_aes_context is the key itself: mbedtls_aes_context.buf holds the key
+ * bytes and mbedtls_aes_context.nr the key length in bytes.
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Zephyr includes. */
+#include <kernel.h>
+
+/* mbed TLS includes. */
+#include <mbedtls/aes.h>
+#include <mbedtls/platform_util.h>
+
+/* Espressif ESP-IDF Includes. */
+#include <driver/periph_ctrl.h>
+#include <soc/dport_access.h>
+#include <soc/hwcrypto_reg.h>
+
+#if defined( MBEDTLS_AES_ENCRYPT_ALT ) && defined( MBEDTLS_AES_DECRYPT_ALT ) && \
+    defined( MBEDTLS_AES_SETKEY_ENC_ALT ) && defined( MBEDTLS_AES_SETKEY_DEC_ALT )
+
+/**
+ * @brief Value of AES_MODE_REG selecting decryption instead of encryption.
+ */
+    #define AES_MODE_DECRYPT_BIT    ( 4U )
+
+/**
+ * @brief Size of an AES block in 32-bit words.
+ */
+    #define AES_BLOCK_WORDS         ( 4U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Serializes use of the accelerator, which holds one key at a time.
+ */
+    K_MUTEX_DEFINE( aesHardwareMutex );
+
+/**
+ * @brief Whether the accelerator has been clocked and taken out of reset.
+ *
+ * Only accessed with #aesHardwareMutex held.
+ */
+    static bool aesHardwareEnabled = false;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Store a key in an AES context for use by #aesBlock.
+ *
+ * @param[out] ctx The AES context.
+ * @param[in] key The key.
+ * @param[in] keybits Size of the key in bits.
+ *
+ * @return 0 on success, MBEDTLS_ERR_AES_INVALID_KEY_LENGTH for a size other
+ * than 128, 192 or 256 bits.
+ */
+    static int storeKey( mbedtls_aes_context * ctx,
+                         const unsigned char * key,
+                         unsigned int keybits );
+
+/**
+ * @brief Run one AES block through the accelerator.
+ *
+ * @param[in] ctx AES context holding the key stored by #storeKey.
+ * @param[in] decrypt Whether to decrypt rather than encrypt the block.
+ * @param[in] input The 16 byte input block.
+ * @param[out] output The 16 byte output block. May be the same as @p input.
+ */
+    static void aesBlock( const mbedtls_aes_context * ctx,
+                          bool decrypt,
+                          const unsigned char input[ 16 ],
+                          unsigned char output[ 16 ] );
+
+/*-----------------------------------------------------------*/
+
+    static int storeKey( mbedtls_aes_context * ctx,
+                         const unsigned char * key,
+                         unsigned int keybits )
+    {
+        int returnStatus = 0;
+
+        if( ( keybits != 128U ) && ( keybits != 192U ) && ( keybits != 256U ) )
+        {
+            returnStatus = MBEDTLS_ERR_AES_INVALID_KEY_LENGTH;
+        }
+        else
+        {
+            ( void ) memcpy( ctx->buf, key, keybits / 8U );
+            ctx->nr = ( int ) ( keybits / 8U );
+            ctx->rk = ctx->buf;
+        }
+
+        return returnStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    static void aesBlock( const mbedtls_aes_context * ctx,
+                          bool decrypt,
+                          const unsigned char input[ 16 ],
+                          unsigned char output[ 16 ] )
+    {
+        uint32_t block[ AES_BLOCK_WORDS ];
+        uint32_t mode;
+        size_t i;
+
+        /* Modes 0, 1 and 2 select 128, 192 and 256 bit keys. */
+        mode = ( ( uint32_t ) ctx->nr / 8U ) - 2U;
+
+        if( decrypt == true )
+        {
+            mode += AES_MODE_DECRYPT_BIT;
+        }
+
+        ( void ) memcpy( block, input, sizeof( block ) );
+
+        ( void ) k_mutex_lock( &aesHardwareMutex, K_FOREVER );
+
+        if( aesHardwareEnabled == false )
+        {
+            periph_module_enable( PERIPH_AES_MODULE );
+            aesHardwareEnabled = true;
+        }
+
+        /* The key is reloaded for every block as contexts share the accelerator.
+         * This costs a few register writes, far less than a software round. */
+        for( i = 0; i < ( ( size_t ) ctx->nr / sizeof( uint32_t ) ); i++ )
+        {
+            DPORT_REG_WRITE( AES_KEY_BASE + ( i * sizeof( uint32_t ) ), ctx->rk[ i ] );
+        }
+
+        DPORT_REG_WRITE( AES_MODE_REG, mode );
+
+        for( i = 0; i < AES_BLOCK_WORDS; i++ )
+        {
+            DPORT_REG_WRITE( AES_TEXT_BASE + ( i * sizeof( uint32_t ) ), block[ i ] );
+        }
+
+        DPORT_REG_WRITE( AES_START_REG, 1U );
+
+        while( DPORT_REG_READ( AES_IDLE_REG ) != 1U )
+        {
+            /* The operation completes within a few dozen cycles. */
+        }
+
+        for( i = 0; i < AES_BLOCK_WORDS; i++ )
+        {
+            block[ i ] = DPORT_REG_READ( AES_TEXT_BASE + ( i * sizeof( uint32_t ) ) );
+        }
+
+        ( void ) k_mutex_unlock( &aesHardwareMutex );
+
+        ( void ) memcpy( output, block, sizeof( block ) );
+        mbedtls_platform_zeroize( block, sizeof( block ) );
+    }
+/*-----------------------------------------------------------*/
+
+    int mbedtls_aes_setkey_enc( mbedtls_aes_context * ctx,
+                                const unsigned char * key,
+                                unsigned int keybits )
+    {
+        return storeKey( ctx, key, keybits );
+    }
+/*-----------------------------------------------------------*/
+
+    int mbedtls_aes_setkey_dec( mbedtls_aes_context * ctx,
+                                const unsigned char * key,
+                                unsigned int keybits )
+    {
+        /* The accelerator derives the decryption schedule itself. */
+        return storeKey( ctx, key, keybits );
+    }
+/*-----------------------------------------------------------*/
+
+    int mbedtls_internal_aes_encrypt( mbedtls_aes_context * ctx,
+                                      const unsigned char input[ 16 ],
+                                      unsigned char output[ 16 ] )
+    {
+        aesBlock( ctx, false, input, output );
+
+        return 0;
+    }
+/*-----------------------------------------------------------*/
+
+    int mbedtls_internal_aes_decrypt( mbedtls_aes_context * ctx,
+                                      const unsigned char input[ 16 ],
+                                      unsigned char output[ 16 ] )
+    {
+        aesBlock( ctx, true, input, output );
+
+        return 0;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* if defined( MBEDTLS_AES_ENCRYPT_ALT ) && defined( MBEDTLS_AES_DECRYPT_ALT ) && defined( MBEDTLS_AES_SETKEY_ENC_ALT ) && defined( MBEDTLS_AES_SETKEY_DEC_ALT ) */
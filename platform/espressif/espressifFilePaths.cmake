@@ -11,4 +11,13 @@ set( WIFI_SOURCES
 
 #Platform ESP library include directories.
 set( WIFI_INCLUDE_DIRS
-     ${CMAKE_CURRENT_LIST_DIR}/wifi/include )
\ No newline at end of file
+     ${CMAKE_CURRENT_LIST_DIR}/wifi/include )
+
+# Platform ESP hardware crypto (mbed TLS AES _ALT) source files.
+set( CRYPTO_SOURCES
+     ${CMAKE_CURRENT_LIST_DIR}/crypto/src/esp32_aes_alt.c )
+
+# Platform ESP hardware crypto include directories. These must be visible to
+# the mbed TLS library itself, so add them with zephyr_include_directories().
+set( CRYPTO_INCLUDE_DIRS
+     ${CMAKE_CURRENT_LIST_DIR}/crypto/include )
@@ -28,6 +28,9 @@
  * @brief Establish WiFi connection with the passed information of network SSID and password.
  *
  * If the wifi interface is available, this function will block until connection is succesful.
+ * The modem sleep mode is set from the AWS_IOT_WIFI_POWER_SAVE choice. With
+ * CONFIG_AWS_IOT_WIFI_FAST_REJOIN, the access point last joined for the same SSID
+ * is associated with directly, and a full scan is made only if it does not answer.
  *
  * @param[in] pWifiSsid Wifi network name.
  * @param[in] ssidLen Length of wifi network name.
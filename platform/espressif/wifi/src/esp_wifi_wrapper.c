@@ -20,12 +20,19 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+/* Standard includes. */
+#include <string.h>
+
 /* Zephyr Includes. */
 #include <zephyr.h>
 #include <net/net_if.h>
 #include <net/net_mgmt.h>
 #include <logging/log.h>
 
+#if defined( CONFIG_AWS_IOT_WIFI_FAST_REJOIN )
+    #include <settings/settings.h>
+#endif
+
 /* Espressif ESP-IDF Includes. */
 #include <esp_wifi.h>
 
@@ -55,6 +62,41 @@ static struct k_sem wifiSem;
  */
 static struct net_mgmt_event_callback dhcpCb;
 
+/**
+ * @brief Modem sleep mode of the station, chosen with Kconfig.
+ */
+#if defined( CONFIG_AWS_IOT_WIFI_PS_NONE )
+    #define WIFI_POWER_SAVE_MODE    WIFI_PS_NONE
+#elif defined( CONFIG_AWS_IOT_WIFI_PS_MAX_MODEM )
+    #define WIFI_POWER_SAVE_MODE    WIFI_PS_MAX_MODEM
+#else
+    #define WIFI_POWER_SAVE_MODE    WIFI_PS_MIN_MODEM
+#endif
+
+#if defined( CONFIG_AWS_IOT_WIFI_FAST_REJOIN )
+
+/**
+ * @brief Settings key of the cached access point.
+ */
+    #define WIFI_REJOIN_SETTINGS_KEY    "aws_iot/wifi/ap"
+
+/**
+ * @brief Length of a BSSID.
+ */
+    #define WIFI_BSSID_LENGTH           ( 6U )
+
+/**
+ * @brief The access point that was joined last, as kept in the settings.
+ */
+    typedef struct WifiRejoinCache
+    {
+        uint32_t ssidHash;                     /**< @brief Hash of the SSID the access point was joined for. */
+        uint8_t bssid[ WIFI_BSSID_LENGTH ];    /**< @brief BSSID of the access point. */
+        uint8_t channel;                       /**< @brief Primary channel of the access point. */
+        bool valid;                            /**< @brief Whether the rest of the cache was loaded. */
+    } WifiRejoinCache_t;
+#endif /* if defined( CONFIG_AWS_IOT_WIFI_FAST_REJOIN ) */
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -68,6 +110,48 @@ static void wifiConnectionCallback( struct net_mgmt_event_callback * pEventCb,
                                     uint32_t mgmtEvent,
                                     struct net_if * pInterface );
 
+#if defined( CONFIG_AWS_IOT_WIFI_FAST_REJOIN )
+
+/**
+ * @brief Hash an SSID, so that an access point cached for one network is not
+ * used to join another.
+ *
+ * @param[in] pWiFiSsid Wifi network name.
+ * @param[in] ssidLen Length of wifi network name.
+ *
+ * @return FNV-1a hash of the SSID.
+ */
+    static uint32_t ssidHash( const char * pWiFiSsid,
+                              size_t ssidLen );
+
+/**
+ * @brief Called by the settings subsystem with the cached access point.
+ *
+ * @param[in] pKey Remainder of the key, not used.
+ * @param[in] length Length of the value.
+ * @param[in] readCallback Function that reads the value.
+ * @param[in] pCallbackArgument Argument of @p readCallback.
+ * @param[out] pParameter The #WifiRejoinCache_t to fill.
+ *
+ * @return 0, so that the loading goes on.
+ */
+    static int loadRejoinCache( const char * pKey,
+                                size_t length,
+                                settings_read_cb readCallback,
+                                void * pCallbackArgument,
+                                void * pParameter );
+
+/**
+ * @brief Store the access point the station is associated with, if it is not
+ * the cached one.
+ *
+ * @param[in] pCache The cache loaded before connecting.
+ * @param[in] hash Hash of the SSID that was joined.
+ */
+    static void storeRejoinCache( const WifiRejoinCache_t * pCache,
+                                  uint32_t hash );
+#endif /* if defined( CONFIG_AWS_IOT_WIFI_FAST_REJOIN ) */
+
 /*-----------------------------------------------------------*/
 
 static void wifiConnectionCallback( struct net_mgmt_event_callback * pEventCb,
@@ -99,12 +183,98 @@ static void wifiConnectionCallback( struct net_mgmt_event_callback * pEventCb,
 }
 /*-----------------------------------------------------------*/
 
+#if defined( CONFIG_AWS_IOT_WIFI_FAST_REJOIN )
+
+    static uint32_t ssidHash( const char * pWiFiSsid,
+                              size_t ssidLen )
+    {
+        uint32_t hash = 2166136261U;
+        size_t i;
+
+        for( i = 0U; i < ssidLen; i++ )
+        {
+            hash ^= ( uint8_t ) pWiFiSsid[ i ];
+            hash *= 16777619U;
+        }
+
+        return hash;
+    }
+/*-----------------------------------------------------------*/
+
+    static int loadRejoinCache( const char * pKey,
+                                size_t length,
+                                settings_read_cb readCallback,
+                                void * pCallbackArgument,
+                                void * pParameter )
+    {
+        WifiRejoinCache_t * pCache = ( WifiRejoinCache_t * ) pParameter;
+
+        ( void ) pKey;
+
+        if( ( length == sizeof( *pCache ) ) &&
+            ( readCallback( pCallbackArgument, pCache, sizeof( *pCache ) ) == ( ssize_t ) sizeof( *pCache ) ) &&
+            ( pCache->channel != 0U ) )
+        {
+            pCache->valid = true;
+        }
+        else
+        {
+            memset( pCache, 0, sizeof( *pCache ) );
+        }
+
+        return 0;
+    }
+/*-----------------------------------------------------------*/
+
+    static void storeRejoinCache( const WifiRejoinCache_t * pCache,
+                                  uint32_t hash )
+    {
+        wifi_ap_record_t apInfo = { 0 };
+        WifiRejoinCache_t newCache = { 0 };
+        int result = 0;
+
+        if( esp_wifi_sta_get_ap_info( &apInfo ) == ESP_OK )
+        {
+            newCache.ssidHash = hash;
+            memcpy( newCache.bssid, apInfo.bssid, WIFI_BSSID_LENGTH );
+            newCache.channel = apInfo.primary;
+            newCache.valid = true;
+
+            /* Only write the flash when the access point changed. */
+            if( memcmp( &newCache, pCache, sizeof( newCache ) ) != 0 )
+            {
+                result = settings_save_one( WIFI_REJOIN_SETTINGS_KEY, &newCache, sizeof( newCache ) );
+
+                if( result != 0 )
+                {
+                    LOG_WRN( "Failed to store the access point: Result=%d", result );
+                }
+                else
+                {
+                    LOG_INF( "Stored access point %02x:%02x:%02x:%02x:%02x:%02x on channel %u",
+                             newCache.bssid[ 0 ], newCache.bssid[ 1 ], newCache.bssid[ 2 ],
+                             newCache.bssid[ 3 ], newCache.bssid[ 4 ], newCache.bssid[ 5 ],
+                             newCache.channel );
+                }
+            }
+        }
+    }
+#endif /* if defined( CONFIG_AWS_IOT_WIFI_FAST_REJOIN ) */
+/*-----------------------------------------------------------*/
+
 bool Wifi_Connect( const char * pWiFiSsid,
                    size_t ssidLen,
                    const char * pWiFiPassword,
                    size_t passwordLen )
 {
     struct net_if * pInterface = NULL;
+    bool connected = false;
+
+    #if defined( CONFIG_AWS_IOT_WIFI_FAST_REJOIN )
+        WifiRejoinCache_t rejoinCache = { 0 };
+        uint32_t hash = 0U;
+        bool directedJoin = false;
+    #endif
     esp_err_t wifiStatus = esp_wifi_set_mode( WIFI_MODE_STA );
 
     if( wifiStatus != ESP_OK )
@@ -131,6 +301,12 @@ bool Wifi_Connect( const char * pWiFiSsid,
             /* Starts DHCPv4 client on pInterface and begins negotiating for IPv4 address. */
             net_dhcpv4_start( pInterface );
 
+            /* The modem sleep mode is kept by the driver across connections. */
+            if( esp_wifi_set_ps( WIFI_POWER_SAVE_MODE ) != ESP_OK )
+            {
+                LOG_WRN( "Failed to set WiFi power save mode %d", WIFI_POWER_SAVE_MODE );
+            }
+
             if( !IS_ENABLED( CONFIG_ESP32_WIFI_STA_AUTO ) )
             {
                 wifi_config_t wifi_config = { 0 };
@@ -138,6 +314,32 @@ bool Wifi_Connect( const char * pWiFiSsid,
                 memcpy( wifi_config.sta.ssid, pWiFiSsid, ssidLen );
                 memcpy( wifi_config.sta.password, pWiFiPassword, passwordLen );
 
+                #if defined( CONFIG_AWS_IOT_WIFI_PS_MAX_MODEM )
+                    wifi_config.sta.listen_interval = CONFIG_AWS_IOT_WIFI_LISTEN_INTERVAL;
+                #endif
+
+                #if defined( CONFIG_AWS_IOT_WIFI_FAST_REJOIN )
+                    if( settings_subsys_init() == 0 )
+                    {
+                        ( void ) settings_load_subtree_direct( WIFI_REJOIN_SETTINGS_KEY, loadRejoinCache, &rejoinCache );
+                    }
+
+                    hash = ssidHash( pWiFiSsid, ssidLen );
+
+                    if( ( rejoinCache.valid == true ) && ( rejoinCache.ssidHash == hash ) )
+                    {
+                        /* Associate with the cached BSSID on its channel, without
+                         * scanning the other channels. */
+                        wifi_config.sta.bssid_set = true;
+                        memcpy( wifi_config.sta.bssid, rejoinCache.bssid, WIFI_BSSID_LENGTH );
+                        wifi_config.sta.channel = rejoinCache.channel;
+                        wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+                        directedJoin = true;
+
+                        LOG_INF( "Rejoining the cached access point on channel %u", rejoinCache.channel );
+                    }
+                #endif /* if defined( CONFIG_AWS_IOT_WIFI_FAST_REJOIN ) */
+
                 /* Set the configuration of the ESP32 station and connect to network. */
                 wifiStatus |= esp_wifi_set_config( ESP_IF_WIFI_STA, &wifi_config );
                 wifiStatus |= esp_wifi_connect();
@@ -146,10 +348,53 @@ bool Wifi_Connect( const char * pWiFiSsid,
                 {
                     LOG_ERR( "Failed to connect to WiFi network: SSID=%.*s, ReturnCode=%d", ssidLen, pWiFiSsid, wifiStatus );
                 }
+
+                #if defined( CONFIG_AWS_IOT_WIFI_FAST_REJOIN )
+                    if( ( directedJoin == true ) &&
+                        ( ( wifiStatus != ESP_OK ) ||
+                          ( k_sem_take( &wifiSem, K_MSEC( CONFIG_AWS_IOT_WIFI_FAST_REJOIN_TIMEOUT_MS ) ) != 0 ) ) )
+                    {
+                        /* The access point moved or is gone. Forget it and scan
+                         * every channel for the SSID. */
+                        LOG_WRN( "Cached access point did not answer, scanning for SSID=%.*s", ( int ) ssidLen, pWiFiSsid );
+                        ( void ) settings_delete( WIFI_REJOIN_SETTINGS_KEY );
+                        memset( &rejoinCache, 0, sizeof( rejoinCache ) );
+                        directedJoin = false;
+
+                        ( void ) esp_wifi_disconnect();
+                        wifi_config.sta.bssid_set = false;
+                        memset( wifi_config.sta.bssid, 0, WIFI_BSSID_LENGTH );
+                        wifi_config.sta.channel = 0U;
+                        wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+
+                        wifiStatus = esp_wifi_set_config( ESP_IF_WIFI_STA, &wifi_config );
+                        wifiStatus |= esp_wifi_connect();
+
+                        if( wifiStatus != ESP_OK )
+                        {
+                            LOG_ERR( "Failed to connect to WiFi network: SSID=%.*s, ReturnCode=%d", ( int ) ssidLen, pWiFiSsid, wifiStatus );
+                        }
+                    }
+                    else if( directedJoin == true )
+                    {
+                        /* The semaphore was taken by the directed join. */
+                        connected = true;
+                    }
+                #endif /* if defined( CONFIG_AWS_IOT_WIFI_FAST_REJOIN ) */
             }
 
-            /* Take a semaphore, blocking until semaphore is given from successful connection */
-            k_sem_take( &wifiSem, K_FOREVER );
+            if( connected == false )
+            {
+                /* Take a semaphore, blocking until semaphore is given from successful connection */
+                k_sem_take( &wifiSem, K_FOREVER );
+            }
+
+            #if defined( CONFIG_AWS_IOT_WIFI_FAST_REJOIN )
+                if( !IS_ENABLED( CONFIG_ESP32_WIFI_STA_AUTO ) )
+                {
+                    storeRejoinCache( &rejoinCache, hash );
+                }
+            #endif
         }
         else
         {
@@ -0,0 +1,244 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file network_buffer_pool.h
+ * @brief Network buffers of the MQTT, Shadow and HTTP clients, drawn from one
+ * statically planned pool.
+ *
+ * Instead of a static array each, the clients of an image take their network
+ * buffer from this pool while they use it, and return it when idle: an MQTT
+ * client between its connections, an HTTP client between its requests. The
+ * pool has three size classes, each a k_mem_slab, whose block sizes and counts
+ * are the memory plan of the image. It costs #NETWORK_BUFFER_POOL_TOTAL_SIZE
+ * bytes of RAM, fixed at build time.
+ *
+ * The pool counts, per class, the buffers in use, their peak and the failed
+ * allocations, and per client, the largest buffer it asked for. With
+ * #NETWORK_BUFFER_POOL_WATERMARK, each buffer is also filled with a pattern
+ * when allocated and scanned when freed, which gives the number of bytes the
+ * client actually wrote to it. These peaks, read with
+ * #NetworkBufferPool_GetStats or the "netbuf stats" shell command, are the
+ * field data to size the clients and the classes from.
+ */
+#ifndef NETWORK_BUFFER_POOL_H_
+#define NETWORK_BUFFER_POOL_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Size in bytes of the buffers of the small class, set with
+ * CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_SMALL_SIZE when the Kconfig options of
+ * the pool are used.
+ */
+#ifndef NETWORK_BUFFER_POOL_SMALL_SIZE
+    #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_SMALL_SIZE )
+        #define NETWORK_BUFFER_POOL_SMALL_SIZE    ( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_SMALL_SIZE )
+    #else
+        #define NETWORK_BUFFER_POOL_SMALL_SIZE    ( 1024U )
+    #endif
+#endif
+
+/**
+ * @brief Number of buffers of the small class, set with
+ * CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_SMALL_COUNT when the Kconfig options of
+ * the pool are used.
+ */
+#ifndef NETWORK_BUFFER_POOL_SMALL_COUNT
+    #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_SMALL_COUNT )
+        #define NETWORK_BUFFER_POOL_SMALL_COUNT    ( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_SMALL_COUNT )
+    #else
+        #define NETWORK_BUFFER_POOL_SMALL_COUNT    ( 2U )
+    #endif
+#endif
+
+/**
+ * @brief Size in bytes of the buffers of the medium class, set with
+ * CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_MEDIUM_SIZE when the Kconfig options of
+ * the pool are used.
+ */
+#ifndef NETWORK_BUFFER_POOL_MEDIUM_SIZE
+    #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_MEDIUM_SIZE )
+        #define NETWORK_BUFFER_POOL_MEDIUM_SIZE    ( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_MEDIUM_SIZE )
+    #else
+        #define NETWORK_BUFFER_POOL_MEDIUM_SIZE    ( 2048U )
+    #endif
+#endif
+
+/**
+ * @brief Number of buffers of the medium class, set with
+ * CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_MEDIUM_COUNT when the Kconfig options of
+ * the pool are used.
+ */
+#ifndef NETWORK_BUFFER_POOL_MEDIUM_COUNT
+    #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_MEDIUM_COUNT )
+        #define NETWORK_BUFFER_POOL_MEDIUM_COUNT    ( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_MEDIUM_COUNT )
+    #else
+        #define NETWORK_BUFFER_POOL_MEDIUM_COUNT    ( 1U )
+    #endif
+#endif
+
+/**
+ * @brief Size in bytes of the buffers of the large class, set with
+ * CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_LARGE_SIZE when the Kconfig options of
+ * the pool are used.
+ */
+#ifndef NETWORK_BUFFER_POOL_LARGE_SIZE
+    #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_LARGE_SIZE )
+        #define NETWORK_BUFFER_POOL_LARGE_SIZE    ( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_LARGE_SIZE )
+    #else
+        #define NETWORK_BUFFER_POOL_LARGE_SIZE    ( 5120U )
+    #endif
+#endif
+
+/**
+ * @brief Number of buffers of the large class, set with
+ * CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_LARGE_COUNT when the Kconfig options of
+ * the pool are used.
+ */
+#ifndef NETWORK_BUFFER_POOL_LARGE_COUNT
+    #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_LARGE_COUNT )
+        #define NETWORK_BUFFER_POOL_LARGE_COUNT    ( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_LARGE_COUNT )
+    #else
+        #define NETWORK_BUFFER_POOL_LARGE_COUNT    ( 1U )
+    #endif
+#endif
+
+/**
+ * @brief Number of clients whose usage is tracked, set with
+ * CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_MAX_OWNERS when the Kconfig options of
+ * the pool are used. The buffers of further clients are only counted in their
+ * class.
+ */
+#ifndef NETWORK_BUFFER_POOL_MAX_OWNERS
+    #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_MAX_OWNERS )
+        #define NETWORK_BUFFER_POOL_MAX_OWNERS    ( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_MAX_OWNERS )
+    #else
+        #define NETWORK_BUFFER_POOL_MAX_OWNERS    ( 8U )
+    #endif
+#endif
+
+/**
+ * @brief Set to 1 to measure the bytes used of each buffer, as with
+ * CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_WATERMARK when the Kconfig options of the
+ * pool are used. It costs a fill of each buffer when allocated, and a scan
+ * when freed.
+ */
+#ifndef NETWORK_BUFFER_POOL_WATERMARK
+    #if defined( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL_WATERMARK )
+        #define NETWORK_BUFFER_POOL_WATERMARK    ( 1 )
+    #else
+        #define NETWORK_BUFFER_POOL_WATERMARK    ( 0 )
+    #endif
+#endif
+
+/**
+ * @brief Number of size classes.
+ */
+#define NETWORK_BUFFER_POOL_CLASSES    ( 3U )
+
+/**
+ * @brief RAM in bytes of the buffers of the pool, the sum of the size times
+ * the count of each class. Each buffer also has an 8 byte header.
+ */
+#define NETWORK_BUFFER_POOL_TOTAL_SIZE                                            \
+    ( ( NETWORK_BUFFER_POOL_SMALL_SIZE * NETWORK_BUFFER_POOL_SMALL_COUNT ) +     \
+      ( NETWORK_BUFFER_POOL_MEDIUM_SIZE * NETWORK_BUFFER_POOL_MEDIUM_COUNT ) +   \
+      ( NETWORK_BUFFER_POOL_LARGE_SIZE * NETWORK_BUFFER_POOL_LARGE_COUNT ) )
+
+/**
+ * @brief Usage of a size class.
+ */
+typedef struct NetworkBufferClassStats
+{
+    size_t bufferSize;     /**< @brief Size of the buffers of the class. */
+    uint32_t bufferCount;  /**< @brief Number of buffers of the class. */
+    uint32_t inUse;        /**< @brief Buffers allocated and not freed. */
+    uint32_t peakInUse;    /**< @brief Largest value of #NetworkBufferClassStats_t.inUse. */
+    uint32_t failures;     /**< @brief Allocations that fitted the class, and found no free buffer in time. */
+} NetworkBufferClassStats_t;
+
+/**
+ * @brief Usage of the pool by one client.
+ */
+typedef struct NetworkBufferOwnerStats
+{
+    const char * pOwner;     /**< @brief Name of the client, or NULL for an unused entry. */
+    uint32_t allocations;    /**< @brief Buffers the client was given. */
+    uint32_t failures;       /**< @brief Allocations of the client that returned NULL. */
+    uint32_t inUse;          /**< @brief Buffers of the client not freed. */
+    size_t peakRequested;    /**< @brief Largest size the client asked for. */
+    size_t peakUsed;         /**< @brief Most bytes the client wrote to a buffer, from its start. 0 without #NETWORK_BUFFER_POOL_WATERMARK. */
+} NetworkBufferOwnerStats_t;
+
+/**
+ * @brief Usage of the pool.
+ */
+typedef struct NetworkBufferPoolStats
+{
+    NetworkBufferClassStats_t classes[ NETWORK_BUFFER_POOL_CLASSES ];    /**< @brief Usage of each class, from the smallest. */
+    NetworkBufferOwnerStats_t owners[ NETWORK_BUFFER_POOL_MAX_OWNERS ];  /**< @brief Usage of each client, in the order of their first allocation. */
+    size_t bytesInUse;                                                   /**< @brief Size of the buffers allocated and not freed. */
+    size_t peakBytesInUse;                                               /**< @brief Largest value of #NetworkBufferPoolStats_t.bytesInUse. */
+} NetworkBufferPoolStats_t;
+
+/**
+ * @brief Allocate a network buffer from the smallest class that has a free
+ * buffer of at least @p size bytes.
+ *
+ * If every fitting class is exhausted, it waits up to @p blockTimeMs for a
+ * buffer of the smallest fitting class.
+ *
+ * @param[in] pOwner Name of the client, kept to account its usage. It must
+ * stay valid, so it is usually a string literal.
+ * @param[in] size Number of bytes the client needs.
+ * @param[in] blockTimeMs Time to wait for a free buffer.
+ *
+ * @return The buffer, aligned to 8 bytes, or NULL if no class holds @p size
+ * bytes or none was freed in time.
+ */
+uint8_t * NetworkBufferPool_Alloc( const char * pOwner,
+                                   size_t size,
+                                   uint32_t blockTimeMs );
+
+/**
+ * @brief Return a buffer of #NetworkBufferPool_Alloc to the pool.
+ *
+ * @param[in] pBuffer The buffer, or NULL to do nothing.
+ */
+void NetworkBufferPool_Free( uint8_t * pBuffer );
+
+/**
+ * @brief Copy the usage of the pool, and optionally restart its peaks from
+ * the current usage.
+ *
+ * @param[out] pStats Copy of the usage.
+ * @param[in] resetPeaks Whether to reset the peaks and failure counts once
+ * copied.
+ */
+void NetworkBufferPool_GetStats( NetworkBufferPoolStats_t * pStats,
+                                 bool resetPeaks );
+
+#endif /* ifndef NETWORK_BUFFER_POOL_H_ */
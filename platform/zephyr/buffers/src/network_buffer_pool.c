@@ -0,0 +1,484 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file network_buffer_pool.c
+ * @brief Slab-backed network buffers shared by the clients, and the
+ * "netbuf stats" shell command printing their usage.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+/* Zephyr includes. */
+#include <kernel.h>
+
+#if defined( CONFIG_SHELL )
+    #include <shell/shell.h>
+#endif
+
+/* Include header that defines log levels. */
+#include "logging_levels.h"
+
+/* Logging configuration for the network buffer pool. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "NetBufPool"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+
+#include "logging_stack.h"
+
+#include "network_buffer_pool.h"
+
+#if ( NETWORK_BUFFER_POOL_SMALL_SIZE > NETWORK_BUFFER_POOL_MEDIUM_SIZE ) || \
+    ( NETWORK_BUFFER_POOL_MEDIUM_SIZE > NETWORK_BUFFER_POOL_LARGE_SIZE )
+    #error "The network buffer pool classes must be sized from the smallest to the largest."
+#endif
+
+/**
+ * @brief Header in front of each buffer.
+ *
+ * Its size keeps the buffer aligned to 8 bytes.
+ */
+typedef struct NetworkBufferHeader
+{
+    uint32_t requestedSize; /**< @brief Size the owner asked for. */
+    uint8_t sizeClass;      /**< @brief Index of the class of the buffer in #bufferSlabs. */
+    uint8_t owner;          /**< @brief Index of the owner in #poolStats, or #NETWORK_BUFFER_POOL_MAX_OWNERS. */
+    uint16_t reserved;      /**< @brief Padding. */
+} NetworkBufferHeader_t;
+
+/**
+ * @brief Size of a slab block holding a buffer of @p bufferSize bytes.
+ */
+#define NETWORK_BUFFER_BLOCK_SIZE( bufferSize )    ROUND_UP( sizeof( NetworkBufferHeader_t ) + ( bufferSize ), 8U )
+
+/**
+ * @brief Byte the buffers are filled with when allocated, to find how much of
+ * them was written when they are freed.
+ */
+#define NETWORK_BUFFER_FILL                        ( 0xAAU )
+
+/*-----------------------------------------------------------*/
+
+K_MEM_SLAB_DEFINE( smallNetworkSlab, NETWORK_BUFFER_BLOCK_SIZE( NETWORK_BUFFER_POOL_SMALL_SIZE ), NETWORK_BUFFER_POOL_SMALL_COUNT, 8 );
+K_MEM_SLAB_DEFINE( mediumNetworkSlab, NETWORK_BUFFER_BLOCK_SIZE( NETWORK_BUFFER_POOL_MEDIUM_SIZE ), NETWORK_BUFFER_POOL_MEDIUM_COUNT, 8 );
+K_MEM_SLAB_DEFINE( largeNetworkSlab, NETWORK_BUFFER_BLOCK_SIZE( NETWORK_BUFFER_POOL_LARGE_SIZE ), NETWORK_BUFFER_POOL_LARGE_COUNT, 8 );
+
+/**
+ * @brief Slab of each size class, from the smallest.
+ */
+static struct k_mem_slab * const bufferSlabs[ NETWORK_BUFFER_POOL_CLASSES ] =
+{
+    &smallNetworkSlab,
+    &mediumNetworkSlab,
+    &largeNetworkSlab
+};
+
+/**
+ * @brief Usage of the pool, with the plan of each class.
+ */
+static NetworkBufferPoolStats_t poolStats =
+{
+    .classes =
+    {
+        { .bufferSize = NETWORK_BUFFER_POOL_SMALL_SIZE,  .bufferCount = NETWORK_BUFFER_POOL_SMALL_COUNT  },
+        { .bufferSize = NETWORK_BUFFER_POOL_MEDIUM_SIZE, .bufferCount = NETWORK_BUFFER_POOL_MEDIUM_COUNT },
+        { .bufferSize = NETWORK_BUFFER_POOL_LARGE_SIZE,  .bufferCount = NETWORK_BUFFER_POOL_LARGE_COUNT  }
+    }
+};
+
+/**
+ * @brief Lock protecting #poolStats. The sections it protects never block.
+ */
+static struct k_spinlock statsLock;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the header of a buffer.
+ *
+ * @param[in] pBuffer A buffer of #NetworkBufferPool_Alloc.
+ *
+ * @return Its header.
+ */
+static NetworkBufferHeader_t * getHeader( const uint8_t * pBuffer );
+
+/**
+ * @brief Find the entry of an owner in #poolStats, or claim a free one.
+ *
+ * @note Called with #statsLock held.
+ *
+ * @param[in] pOwner Name of the owner.
+ *
+ * @return Index of the entry, or #NETWORK_BUFFER_POOL_MAX_OWNERS if the table
+ * is full.
+ */
+static uint8_t findOwner( const char * pOwner );
+
+#if ( NETWORK_BUFFER_POOL_WATERMARK == 1 )
+
+/**
+ * @brief Measure how much of a buffer filled with #NETWORK_BUFFER_FILL was
+ * written.
+ *
+ * A written byte equal to #NETWORK_BUFFER_FILL at the end of the written part
+ * is not counted, so the result may be a few bytes short.
+ *
+ * @param[in] pBuffer The buffer.
+ * @param[in] bufferSize Size of the buffer.
+ *
+ * @return Offset following the last byte that differs from the fill.
+ */
+    static size_t measureUse( const uint8_t * pBuffer,
+                              size_t bufferSize );
+#endif
+
+#if defined( CONFIG_SHELL )
+
+/**
+ * @brief Print the plan and the usage of the pool.
+ *
+ * @param[in] pShell The shell.
+ * @param[in] argc Number of arguments.
+ * @param[in] argv Arguments; "reset" resets the peaks once printed.
+ *
+ * @return 0, or -EINVAL for an unknown argument.
+ */
+    static int statsShellCommand( const struct shell * pShell,
+                                  size_t argc,
+                                  char ** argv );
+#endif
+
+/*-----------------------------------------------------------*/
+
+static NetworkBufferHeader_t * getHeader( const uint8_t * pBuffer )
+{
+    assert( pBuffer != NULL );
+
+    return ( NetworkBufferHeader_t * ) ( pBuffer - sizeof( NetworkBufferHeader_t ) );
+}
+/*-----------------------------------------------------------*/
+
+static uint8_t findOwner( const char * pOwner )
+{
+    uint8_t owner = 0U;
+    bool found = false;
+
+    for( owner = 0U; owner < NETWORK_BUFFER_POOL_MAX_OWNERS; owner++ )
+    {
+        if( poolStats.owners[ owner ].pOwner == NULL )
+        {
+            poolStats.owners[ owner ].pOwner = pOwner;
+            found = true;
+        }
+        else
+        {
+            found = ( strcmp( poolStats.owners[ owner ].pOwner, pOwner ) == 0 );
+        }
+
+        if( found == true )
+        {
+            break;
+        }
+    }
+
+    return owner;
+}
+/*-----------------------------------------------------------*/
+
+#if ( NETWORK_BUFFER_POOL_WATERMARK == 1 )
+
+    static size_t measureUse( const uint8_t * pBuffer,
+                              size_t bufferSize )
+    {
+        size_t used = bufferSize;
+
+        while( ( used > 0U ) && ( pBuffer[ used - 1U ] == NETWORK_BUFFER_FILL ) )
+        {
+            used--;
+        }
+
+        return used;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* if ( NETWORK_BUFFER_POOL_WATERMARK == 1 ) */
+
+uint8_t * NetworkBufferPool_Alloc( const char * pOwner,
+                                   size_t size,
+                                   uint32_t blockTimeMs )
+{
+    NetworkBufferHeader_t * pHeader = NULL;
+    NetworkBufferClassStats_t * pClass = NULL;
+    NetworkBufferOwnerStats_t * pOwnerStats = NULL;
+    uint8_t * pBuffer = NULL;
+    uint32_t sizeClass = 0U, fittingClass = NETWORK_BUFFER_POOL_CLASSES;
+    uint8_t owner = 0U;
+    k_spinlock_key_t key;
+
+    assert( pOwner != NULL );
+
+    /* Take the smallest free buffer that fits. */
+    for( sizeClass = 0U; ( sizeClass < NETWORK_BUFFER_POOL_CLASSES ) && ( pHeader == NULL ); sizeClass++ )
+    {
+        if( size <= poolStats.classes[ sizeClass ].bufferSize )
+        {
+            fittingClass = MIN( fittingClass, sizeClass );
+
+            if( k_mem_slab_alloc( bufferSlabs[ sizeClass ], ( void ** ) &pHeader, K_NO_WAIT ) != 0 )
+            {
+                pHeader = NULL;
+            }
+            else
+            {
+                pHeader->sizeClass = ( uint8_t ) sizeClass;
+            }
+        }
+    }
+
+    /* Otherwise, wait for a buffer of the smallest class that fits. */
+    if( ( pHeader == NULL ) && ( fittingClass < NETWORK_BUFFER_POOL_CLASSES ) && ( blockTimeMs > 0U ) )
+    {
+        if( k_mem_slab_alloc( bufferSlabs[ fittingClass ], ( void ** ) &pHeader, K_MSEC( blockTimeMs ) ) != 0 )
+        {
+            pHeader = NULL;
+        }
+        else
+        {
+            pHeader->sizeClass = ( uint8_t ) fittingClass;
+        }
+    }
+
+    key = k_spin_lock( &statsLock );
+
+    owner = findOwner( pOwner );
+    pOwnerStats = ( owner < NETWORK_BUFFER_POOL_MAX_OWNERS ) ? &( poolStats.owners[ owner ] ) : NULL;
+
+    if( pHeader != NULL )
+    {
+        pHeader->requestedSize = ( uint32_t ) size;
+        pHeader->owner = owner;
+
+        pClass = &( poolStats.classes[ pHeader->sizeClass ] );
+        pClass->inUse++;
+        pClass->peakInUse = MAX( pClass->peakInUse, pClass->inUse );
+        poolStats.bytesInUse += pClass->bufferSize;
+        poolStats.peakBytesInUse = MAX( poolStats.peakBytesInUse, poolStats.bytesInUse );
+
+        if( pOwnerStats != NULL )
+        {
+            pOwnerStats->allocations++;
+            pOwnerStats->inUse++;
+            pOwnerStats->peakRequested = MAX( pOwnerStats->peakRequested, size );
+        }
+    }
+    else
+    {
+        if( fittingClass < NETWORK_BUFFER_POOL_CLASSES )
+        {
+            poolStats.classes[ fittingClass ].failures++;
+        }
+
+        if( pOwnerStats != NULL )
+        {
+            pOwnerStats->failures++;
+        }
+    }
+
+    k_spin_unlock( &statsLock, key );
+
+    if( pHeader != NULL )
+    {
+        pBuffer = ( uint8_t * ) &( pHeader[ 1 ] );
+
+        #if ( NETWORK_BUFFER_POOL_WATERMARK == 1 )
+            ( void ) memset( pBuffer, NETWORK_BUFFER_FILL, poolStats.classes[ pHeader->sizeClass ].bufferSize );
+        #endif
+    }
+    else if( fittingClass == NETWORK_BUFFER_POOL_CLASSES )
+    {
+        LogError( ( "No network buffer class holds the %lu bytes of %s.",
+                    ( unsigned long ) size,
+                    pOwner ) );
+    }
+    else
+    {
+        LogWarn( ( "No network buffer of %lu bytes for %s within %u ms.",
+                   ( unsigned long ) size,
+                   pOwner,
+                   ( unsigned int ) blockTimeMs ) );
+    }
+
+    return pBuffer;
+}
+/*-----------------------------------------------------------*/
+
+void NetworkBufferPool_Free( uint8_t * pBuffer )
+{
+    NetworkBufferHeader_t * pHeader = NULL;
+    NetworkBufferClassStats_t * pClass = NULL;
+    NetworkBufferOwnerStats_t * pOwnerStats = NULL;
+    size_t used = 0U;
+    k_spinlock_key_t key;
+
+    if( pBuffer != NULL )
+    {
+        pHeader = getHeader( pBuffer );
+        assert( pHeader->sizeClass < NETWORK_BUFFER_POOL_CLASSES );
+        pClass = &( poolStats.classes[ pHeader->sizeClass ] );
+
+        #if ( NETWORK_BUFFER_POOL_WATERMARK == 1 )
+            used = measureUse( pBuffer, pClass->bufferSize );
+        #endif
+
+        key = k_spin_lock( &statsLock );
+
+        assert( pClass->inUse > 0U );
+        pClass->inUse--;
+        poolStats.bytesInUse -= pClass->bufferSize;
+
+        if( pHeader->owner < NETWORK_BUFFER_POOL_MAX_OWNERS )
+        {
+            pOwnerStats = &( poolStats.owners[ pHeader->owner ] );
+            pOwnerStats->inUse--;
+            pOwnerStats->peakUsed = MAX( pOwnerStats->peakUsed, used );
+        }
+
+        k_spin_unlock( &statsLock, key );
+
+        k_mem_slab_free( bufferSlabs[ pHeader->sizeClass ], ( void ** ) &pHeader );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void NetworkBufferPool_GetStats( NetworkBufferPoolStats_t * pStats,
+                                 bool resetPeaks )
+{
+    k_spinlock_key_t key;
+    size_t i = 0U;
+
+    assert( pStats != NULL );
+
+    key = k_spin_lock( &statsLock );
+
+    *pStats = poolStats;
+
+    if( resetPeaks == true )
+    {
+        poolStats.peakBytesInUse = poolStats.bytesInUse;
+
+        for( i = 0U; i < NETWORK_BUFFER_POOL_CLASSES; i++ )
+        {
+            poolStats.classes[ i ].peakInUse = poolStats.classes[ i ].inUse;
+            poolStats.classes[ i ].failures = 0U;
+        }
+
+        for( i = 0U; i < NETWORK_BUFFER_POOL_MAX_OWNERS; i++ )
+        {
+            poolStats.owners[ i ].failures = 0U;
+            poolStats.owners[ i ].peakRequested = 0U;
+            poolStats.owners[ i ].peakUsed = 0U;
+        }
+    }
+
+    k_spin_unlock( &statsLock, key );
+}
+/*-----------------------------------------------------------*/
+
+#if defined( CONFIG_SHELL )
+
+    static int statsShellCommand( const struct shell * pShell,
+                                  size_t argc,
+                                  char ** argv )
+    {
+        NetworkBufferPoolStats_t stats;
+        const NetworkBufferClassStats_t * pClass = NULL;
+        const NetworkBufferOwnerStats_t * pOwner = NULL;
+        bool reset = false;
+        int ret = 0;
+        size_t i = 0U;
+
+        if( argc > 1 )
+        {
+            if( strcmp( argv[ 1 ], "reset" ) == 0 )
+            {
+                reset = true;
+            }
+            else
+            {
+                shell_error( pShell, "Unknown argument: %s", argv[ 1 ] );
+                ret = -EINVAL;
+            }
+        }
+
+        if( ret == 0 )
+        {
+            NetworkBufferPool_GetStats( &stats, reset );
+
+            shell_print( pShell, "plan %u bytes, in use %u, peak %u",
+                         ( unsigned int ) NETWORK_BUFFER_POOL_TOTAL_SIZE,
+                         ( unsigned int ) stats.bytesInUse,
+                         ( unsigned int ) stats.peakBytesInUse );
+
+            for( i = 0U; i < NETWORK_BUFFER_POOL_CLASSES; i++ )
+            {
+                pClass = &( stats.classes[ i ] );
+                shell_print( pShell, "  class %5u x%u: in use %u, peak %u, failures %u",
+                             ( unsigned int ) pClass->bufferSize,
+                             ( unsigned int ) pClass->bufferCount,
+                             ( unsigned int ) pClass->inUse,
+                             ( unsigned int ) pClass->peakInUse,
+                             ( unsigned int ) pClass->failures );
+            }
+
+            for( i = 0U; ( i < NETWORK_BUFFER_POOL_MAX_OWNERS ) && ( stats.owners[ i ].pOwner != NULL ); i++ )
+            {
+                pOwner = &( stats.owners[ i ] );
+                shell_print( pShell, "  %-12s allocs %u, in use %u, failures %u, peak requested %u, peak used %u",
+                             pOwner->pOwner,
+                             ( unsigned int ) pOwner->allocations,
+                             ( unsigned int ) pOwner->inUse,
+                             ( unsigned int ) pOwner->failures,
+                             ( unsigned int ) pOwner->peakRequested,
+                             ( unsigned int ) pOwner->peakUsed );
+            }
+        }
+
+        return ret;
+    }
+
+    SHELL_STATIC_SUBCMD_SET_CREATE( netbufShellCommands,
+                                    SHELL_CMD_ARG( stats, NULL,
+                                                   "Print the usage of the network buffer pool. "
+                                                   "Usage: stats [reset]",
+                                                   statsShellCommand, 1, 1 ),
+                                    SHELL_SUBCMD_SET_END );
+
+    SHELL_CMD_REGISTER( netbuf, &netbufShellCommands, "Network buffer pool commands", NULL );
+/*-----------------------------------------------------------*/
+
+#endif /* if defined( CONFIG_SHELL ) */
@@ -0,0 +1,109 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file json_extract.h
+ * @brief Extraction of several values of a JSON document in a single pass.
+ *
+ * Reading n values with JSON_Search() after JSON_Validate() scans the
+ * document n + 1 times. #JSONExtract_Keys validates the document and locates
+ * the values of all the keys of a table while scanning it once, so its cost
+ * depends on the size of the document but barely on the number of keys.
+ *
+ * Keys use the syntax of JSON_Search(): object keys are separated by '.' and
+ * array elements are selected with "[index]", e.g. "state.reported.powerOn"
+ * or "temperatures[2]". Like JSON_Search(), the values returned for strings
+ * exclude the quotes, and the values of other types are their text in the
+ * document.
+ */
+
+#ifndef JSON_EXTRACT_H_
+#define JSON_EXTRACT_H_
+
+/* Standard includes. */
+#include <stddef.h>
+#include <stdint.h>
+
+/* JSON API header. */
+#include "core_json.h"
+
+/**
+ * @brief Deepest nesting of objects and arrays accepted by #JSONExtract_Keys.
+ */
+#ifndef JSON_EXTRACT_MAX_DEPTH
+    #define JSON_EXTRACT_MAX_DEPTH    ( 16U )
+#endif
+
+/**
+ * @brief A key to extract from a document, and its value once extracted.
+ *
+ * Only #JSONExtractKey_t.pKey and #JSONExtractKey_t.keyLength need to be set
+ * by the caller; #JSONExtract_Keys sets the other fields.
+ */
+typedef struct JSONExtractKey
+{
+    const char * pKey; /**< @brief Path of the key, in the syntax of JSON_Search(). */
+    size_t keyLength;  /**< @brief Length of #JSONExtractKey_t.pKey. */
+
+    /**
+     * @brief Start of the value in the document, or NULL if the document does
+     * not have the key.
+     */
+    const char * pValue;
+    size_t valueLength; /**< @brief Length of #JSONExtractKey_t.pValue. */
+
+    /* Progress of the scan; not meant to be read by the caller. */
+    size_t cursor;         /**< @brief End of the part of #JSONExtractKey_t.pKey matching the current path. */
+    uint16_t matchedDepth; /**< @brief Number of segments of the key matching the current path. */
+    uint8_t state;         /**< @brief Whether the key is being matched, its value captured, or found. */
+} JSONExtractKey_t;
+
+/**
+ * @brief Helper to initialize a #JSONExtractKey_t from a string literal key.
+ */
+#define JSON_EXTRACT_KEY( key )    { ( key ), sizeof( key ) - 1U, NULL, 0U, 0U, 0U, 0U }
+
+/**
+ * @brief Validate a JSON document and locate the values of a table of keys,
+ * in a single pass over the document.
+ *
+ * The document is validated as by JSON_Validate(). When a key appears more
+ * than once, its first value is returned, as JSON_Search() does.
+ *
+ * @param[in] pBuffer The document.
+ * @param[in] max Length of the document.
+ * @param[in,out] pKeys The keys to extract. Their values are set on return.
+ * @param[in] keyCount Number of entries of @p pKeys.
+ *
+ * @return #JSONSuccess if the document is valid and has all the keys;
+ * #JSONNotFound if it is valid but some keys have no value;
+ * #JSONNullParameter or #JSONBadParameter if the parameters or the syntax of
+ * a key are invalid; #JSONPartial if the document is truncated;
+ * #JSONMaxDepthExceeded if it nests deeper than #JSON_EXTRACT_MAX_DEPTH;
+ * #JSONIllegalDocument otherwise.
+ */
+JSONStatus_t JSONExtract_Keys( const char * pBuffer,
+                               size_t max,
+                               JSONExtractKey_t * pKeys,
+                               size_t keyCount );
+
+#endif /* ifndef JSON_EXTRACT_H_ */
@@ -0,0 +1,1207 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file json_extract.c
+ * @brief Single-pass validation and extraction of the values of a table of
+ * keys of a JSON document.
+ *
+ * The document is scanned once, without recursion. Each key keeps how much of
+ * its path matches the path of the value being scanned: entering a member of
+ * an object or an element of an array extends the match of the keys that
+ * fully match the enclosing value, and leaving it rewinds them, so only the
+ * keys that can still match are compared with each member name.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Zephyr includes. */
+#include <zephyr.h>
+
+/* JSON extraction header include. */
+#include "json_extract.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The key is matched against the path of the scanned value.
+ */
+#define KEY_STATE_MATCHING     ( 0U )
+
+/**
+ * @brief The value of the key is being scanned.
+ */
+#define KEY_STATE_CAPTURING    ( 1U )
+
+/**
+ * @brief The value of the key was found.
+ */
+#define KEY_STATE_FOUND        ( 2U )
+
+/**
+ * @brief Longest array index of a key, in digits.
+ */
+#define MAX_INDEX_DIGITS       ( 9U )
+
+/**
+ * @brief An object or array enclosing the scanned value.
+ */
+typedef struct ExtractContainer
+{
+    bool isArray;          /**< @brief Whether the container is an array. */
+    uint32_t elementIndex; /**< @brief Index of the scanned element of an array. */
+} ExtractContainer_t;
+
+/**
+ * @brief State of a scan.
+ */
+typedef struct ExtractScan
+{
+    const char * pBuffer;     /**< @brief The document. */
+    size_t max;               /**< @brief Length of the document. */
+    size_t index;             /**< @brief Position of the scan in the document. */
+    JSONExtractKey_t * pKeys; /**< @brief The keys to extract. */
+    size_t keyCount;          /**< @brief Number of keys. */
+    uint16_t depth;           /**< @brief Number of containers enclosing the scanned value. */
+
+    /**
+     * @brief The containers enclosing the scanned value, outermost first.
+     */
+    ExtractContainer_t containers[ JSON_EXTRACT_MAX_DEPTH ];
+} ExtractScan_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check the syntax of the path of a key.
+ *
+ * @param[in] pKey The path.
+ * @param[in] keyLength Length of the path.
+ *
+ * @return true if the path is made of member names separated by '.' and of
+ * "[index]" array indices, otherwise false.
+ */
+static bool validateKey( const char * pKey,
+                         size_t keyLength );
+
+/**
+ * @brief Match the segment following the matched part of the path of a key.
+ *
+ * @param[in] pKey The key.
+ * @param[in] pSegment Member name, if @p isIndex is false.
+ * @param[in] segmentLength Length of @p pSegment.
+ * @param[in] isIndex Whether the segment is an array element.
+ * @param[in] elementIndex Index of the array element, if @p isIndex is true.
+ *
+ * @return The end of the matched part of the path including the segment, or 0
+ * if the segment does not match.
+ */
+static size_t matchSegment( const JSONExtractKey_t * pKey,
+                            const char * pSegment,
+                            size_t segmentLength,
+                            bool isIndex,
+                            uint32_t elementIndex );
+
+/**
+ * @brief Get the end of the matched part of the path of a key, without its
+ * last segment.
+ *
+ * @param[in] pKey The key.
+ *
+ * @return The end of the part of the path before its last matched segment.
+ */
+static size_t rewindSegment( const JSONExtractKey_t * pKey );
+
+/**
+ * @brief Extend the match of the keys with a member or element entered at
+ * the current depth.
+ *
+ * @param[in] pScan The scan.
+ * @param[in] pSegment Member name, if @p isIndex is false.
+ * @param[in] segmentLength Length of @p pSegment.
+ * @param[in] isIndex Whether the segment is an array element.
+ * @param[in] elementIndex Index of the array element, if @p isIndex is true.
+ */
+static void enterSegment( ExtractScan_t * pScan,
+                          const char * pSegment,
+                          size_t segmentLength,
+                          bool isIndex,
+                          uint32_t elementIndex );
+
+/**
+ * @brief Rewind the match of the keys when leaving the member or element at
+ * the current depth.
+ *
+ * @param[in] pScan The scan.
+ */
+static void leaveSegment( ExtractScan_t * pScan );
+
+/**
+ * @brief Start capturing the value of the keys fully matching the path of the
+ * value at the scan position.
+ *
+ * @param[in] pScan The scan.
+ */
+static void startValue( ExtractScan_t * pScan );
+
+/**
+ * @brief Complete the values of the keys captured at the current depth, once
+ * the scan is past the end of the value.
+ *
+ * @param[in] pScan The scan.
+ * @param[in] isString Whether the value is a string, whose quotes are removed.
+ */
+static void endValue( ExtractScan_t * pScan,
+                      bool isString );
+
+/**
+ * @brief Advance the scan past whitespace.
+ *
+ * @param[in] pScan The scan.
+ */
+static void skipSpace( ExtractScan_t * pScan );
+
+/**
+ * @brief Read the four hexadecimal digits of a "\u" escape.
+ *
+ * @param[in] pDigits The digits.
+ * @param[out] pValue The value of the digits.
+ *
+ * @return true if the digits are hexadecimal, otherwise false.
+ */
+static bool readHex4( const char * pDigits,
+                      uint16_t * pValue );
+
+/**
+ * @brief Advance past an escape sequence of a string.
+ *
+ * @param[in] pScan The scan.
+ * @param[in,out] pIndex Position of the backslash, then past the escape.
+ *
+ * @return #JSONSuccess, #JSONPartial or #JSONIllegalDocument.
+ */
+static JSONStatus_t skipEscape( const ExtractScan_t * pScan,
+                                size_t * pIndex );
+
+/**
+ * @brief Advance past a multibyte UTF-8 character of a string.
+ *
+ * @param[in] pScan The scan.
+ * @param[in,out] pIndex Position of the first byte, then past the character.
+ *
+ * @return #JSONSuccess, #JSONPartial or #JSONIllegalDocument.
+ */
+static JSONStatus_t skipUTF8( const ExtractScan_t * pScan,
+                              size_t * pIndex );
+
+/**
+ * @brief Advance the scan past a string.
+ *
+ * @param[in] pScan The scan, at the opening quote.
+ *
+ * @return #JSONSuccess, #JSONPartial or #JSONIllegalDocument.
+ */
+static JSONStatus_t skipString( ExtractScan_t * pScan );
+
+/**
+ * @brief Advance past one or more decimal digits.
+ *
+ * @param[in] pScan The scan.
+ * @param[in,out] pIndex Position of the first digit, then past the digits.
+ *
+ * @return #JSONSuccess, #JSONPartial or #JSONIllegalDocument.
+ */
+static JSONStatus_t skipDigits( const ExtractScan_t * pScan,
+                                size_t * pIndex );
+
+/**
+ * @brief Advance the scan past a number.
+ *
+ * @param[in] pScan The scan, at the first character of the number.
+ *
+ * @return #JSONSuccess, #JSONPartial or #JSONIllegalDocument.
+ */
+static JSONStatus_t skipNumber( ExtractScan_t * pScan );
+
+/**
+ * @brief Advance the scan past "true", "false" or "null".
+ *
+ * @param[in] pScan The scan.
+ * @param[in] pLiteral The expected literal.
+ * @param[in] length Length of @p pLiteral.
+ *
+ * @return #JSONSuccess, #JSONPartial or #JSONIllegalDocument.
+ */
+static JSONStatus_t skipLiteral( ExtractScan_t * pScan,
+                                 const char * pLiteral,
+                                 size_t length );
+
+/**
+ * @brief Advance the scan past a string, number or literal.
+ *
+ * @param[in] pScan The scan.
+ *
+ * @return #JSONSuccess, #JSONPartial or #JSONIllegalDocument.
+ */
+static JSONStatus_t skipScalar( ExtractScan_t * pScan );
+
+/**
+ * @brief Enter the member or element at the scan position of the innermost
+ * container, up to its value.
+ *
+ * @param[in] pScan The scan.
+ *
+ * @return #JSONSuccess, #JSONPartial or #JSONIllegalDocument.
+ */
+static JSONStatus_t startMember( ExtractScan_t * pScan );
+
+/**
+ * @brief Leave the innermost container after the scan moves past its end.
+ *
+ * @param[in] pScan The scan.
+ */
+static void closeContainer( ExtractScan_t * pScan );
+
+/**
+ * @brief Scan the value at the scan position. The scan stops, for an object
+ * or array, at the value of its first member or element.
+ *
+ * @param[in] pScan The scan.
+ * @param[out] pExpectValue Whether the scan stopped at a value.
+ *
+ * @return #JSONSuccess, #JSONPartial, #JSONMaxDepthExceeded or
+ * #JSONIllegalDocument.
+ */
+static JSONStatus_t scanValue( ExtractScan_t * pScan,
+                               bool * pExpectValue );
+
+/**
+ * @brief Move from a scanned value to the next member or element of the
+ * innermost container, or past its end.
+ *
+ * @param[in] pScan The scan.
+ * @param[out] pExpectValue Whether the scan stopped at a value.
+ *
+ * @return #JSONSuccess, #JSONPartial or #JSONIllegalDocument.
+ */
+static JSONStatus_t scanNextMember( ExtractScan_t * pScan,
+                                    bool * pExpectValue );
+
+/**
+ * @brief Scan a whole document.
+ *
+ * @param[in] pScan The scan, at the start of the document.
+ *
+ * @return #JSONSuccess if the document is valid, otherwise #JSONPartial,
+ * #JSONMaxDepthExceeded or #JSONIllegalDocument.
+ */
+static JSONStatus_t scanDocument( ExtractScan_t * pScan );
+
+/*-----------------------------------------------------------*/
+
+static bool validateKey( const char * pKey,
+                         size_t keyLength )
+{
+    bool valid = ( pKey != NULL ) && ( keyLength > 0U );
+    size_t i = 0U, start = 0U;
+
+    while( ( valid == true ) && ( i < keyLength ) )
+    {
+        if( pKey[ i ] == '[' )
+        {
+            i++;
+            start = i;
+
+            while( ( i < keyLength ) && ( pKey[ i ] >= '0' ) && ( pKey[ i ] <= '9' ) )
+            {
+                i++;
+            }
+
+            valid = ( i > start ) && ( ( i - start ) <= MAX_INDEX_DIGITS ) &&
+                    ( i < keyLength ) && ( pKey[ i ] == ']' );
+            i++;
+        }
+        else
+        {
+            /* Member names after the first one follow a '.'. */
+            if( i > 0U )
+            {
+                valid = ( pKey[ i ] == '.' );
+                i++;
+            }
+
+            start = i;
+
+            while( ( i < keyLength ) && ( pKey[ i ] != '.' ) && ( pKey[ i ] != '[' ) && ( pKey[ i ] != ']' ) )
+            {
+                i++;
+            }
+
+            valid = valid && ( i > start );
+        }
+    }
+
+    return valid;
+}
+/*-----------------------------------------------------------*/
+
+static size_t matchSegment( const JSONExtractKey_t * pKey,
+                            const char * pSegment,
+                            size_t segmentLength,
+                            bool isIndex,
+                            uint32_t elementIndex )
+{
+    const char * pPath = pKey->pKey;
+    size_t start = pKey->cursor, end = 0U, newCursor = 0U;
+    uint32_t keyIndex = 0U;
+
+    if( start < pKey->keyLength )
+    {
+        if( pPath[ start ] == '[' )
+        {
+            if( isIndex == true )
+            {
+                /* validateKey() checked the digits and the closing bracket. */
+                for( end = start + 1U; pPath[ end ] != ']'; end++ )
+                {
+                    keyIndex = ( keyIndex * 10U ) + ( uint32_t ) ( pPath[ end ] - '0' );
+                }
+
+                if( keyIndex == elementIndex )
+                {
+                    newCursor = end + 1U;
+                }
+            }
+        }
+        else if( isIndex == false )
+        {
+            if( pPath[ start ] == '.' )
+            {
+                start++;
+            }
+
+            end = start;
+
+            while( ( end < pKey->keyLength ) && ( pPath[ end ] != '.' ) && ( pPath[ end ] != '[' ) )
+            {
+                end++;
+            }
+
+            if( ( ( end - start ) == segmentLength ) &&
+                ( memcmp( &( pPath[ start ] ), pSegment, segmentLength ) == 0 ) )
+            {
+                newCursor = end;
+            }
+        }
+        else
+        {
+            /* A member name does not match an array element. */
+        }
+    }
+
+    return newCursor;
+}
+/*-----------------------------------------------------------*/
+
+static size_t rewindSegment( const JSONExtractKey_t * pKey )
+{
+    const char * pPath = pKey->pKey;
+    size_t cursor = pKey->cursor;
+
+    assert( cursor > 0U );
+
+    if( pPath[ cursor - 1U ] == ']' )
+    {
+        cursor--;
+
+        while( pPath[ cursor ] != '[' )
+        {
+            cursor--;
+        }
+    }
+    else
+    {
+        while( ( cursor > 0U ) && ( pPath[ cursor - 1U ] != '.' ) )
+        {
+            cursor--;
+        }
+
+        /* Also rewind the separator, which matchSegment() skips. */
+        if( cursor > 0U )
+        {
+            cursor--;
+        }
+    }
+
+    return cursor;
+}
+/*-----------------------------------------------------------*/
+
+static void enterSegment( ExtractScan_t * pScan,
+                          const char * pSegment,
+                          size_t segmentLength,
+                          bool isIndex,
+                          uint32_t elementIndex )
+{
+    JSONExtractKey_t * pKey = NULL;
+    size_t i = 0U, newCursor = 0U;
+
+    for( i = 0U; i < pScan->keyCount; i++ )
+    {
+        pKey = &( pScan->pKeys[ i ] );
+
+        if( ( pKey->state == KEY_STATE_MATCHING ) && ( ( pKey->matchedDepth + 1U ) == pScan->depth ) )
+        {
+            newCursor = matchSegment( pKey, pSegment, segmentLength, isIndex, elementIndex );
+
+            if( newCursor != 0U )
+            {
+                pKey->matchedDepth = pScan->depth;
+                pKey->cursor = newCursor;
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void leaveSegment( ExtractScan_t * pScan )
+{
+    JSONExtractKey_t * pKey = NULL;
+    size_t i = 0U;
+
+    for( i = 0U; i < pScan->keyCount; i++ )
+    {
+        pKey = &( pScan->pKeys[ i ] );
+
+        if( ( pKey->state == KEY_STATE_MATCHING ) && ( pKey->matchedDepth == pScan->depth ) )
+        {
+            pKey->cursor = rewindSegment( pKey );
+            pKey->matchedDepth--;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void startValue( ExtractScan_t * pScan )
+{
+    JSONExtractKey_t * pKey = NULL;
+    size_t i = 0U;
+
+    for( i = 0U; i < pScan->keyCount; i++ )
+    {
+        pKey = &( pScan->pKeys[ i ] );
+
+        if( ( pKey->state == KEY_STATE_MATCHING ) && ( pKey->matchedDepth == pScan->depth ) &&
+            ( pKey->cursor == pKey->keyLength ) )
+        {
+            pKey->pValue = &( pScan->pBuffer[ pScan->index ] );
+            pKey->state = KEY_STATE_CAPTURING;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void endValue( ExtractScan_t * pScan,
+                      bool isString )
+{
+    JSONExtractKey_t * pKey = NULL;
+    size_t i = 0U;
+
+    for( i = 0U; i < pScan->keyCount; i++ )
+    {
+        pKey = &( pScan->pKeys[ i ] );
+
+        if( ( pKey->state == KEY_STATE_CAPTURING ) && ( pKey->matchedDepth == pScan->depth ) )
+        {
+            pKey->valueLength = ( size_t ) ( &( pScan->pBuffer[ pScan->index ] ) - pKey->pValue );
+
+            if( isString == true )
+            {
+                pKey->pValue++;
+                pKey->valueLength -= 2U;
+            }
+
+            pKey->state = KEY_STATE_FOUND;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void skipSpace( ExtractScan_t * pScan )
+{
+    char c = '\0';
+
+    while( pScan->index < pScan->max )
+    {
+        c = pScan->pBuffer[ pScan->index ];
+
+        if( ( c != ' ' ) && ( c != '\t' ) && ( c != '\n' ) && ( c != '\r' ) )
+        {
+            break;
+        }
+
+        pScan->index++;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static bool readHex4( const char * pDigits,
+                      uint16_t * pValue )
+{
+    bool valid = true;
+    size_t i = 0U;
+    char c = '\0';
+    uint16_t value = 0U;
+
+    for( i = 0U; ( i < 4U ) && ( valid == true ); i++ )
+    {
+        c = pDigits[ i ];
+
+        if( ( c >= '0' ) && ( c <= '9' ) )
+        {
+            value = ( uint16_t ) ( ( value << 4 ) | ( uint16_t ) ( c - '0' ) );
+        }
+        else if( ( c >= 'a' ) && ( c <= 'f' ) )
+        {
+            value = ( uint16_t ) ( ( value << 4 ) | ( uint16_t ) ( c - 'a' + 10 ) );
+        }
+        else if( ( c >= 'A' ) && ( c <= 'F' ) )
+        {
+            value = ( uint16_t ) ( ( value << 4 ) | ( uint16_t ) ( c - 'A' + 10 ) );
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+
+    *pValue = value;
+
+    return valid;
+}
+/*-----------------------------------------------------------*/
+
+static JSONStatus_t skipEscape( const ExtractScan_t * pScan,
+                                size_t * pIndex )
+{
+    JSONStatus_t status = JSONSuccess;
+    const char * pBuffer = pScan->pBuffer;
+    size_t i = *pIndex;
+    uint16_t high = 0U, low = 0U;
+
+    if( ( pScan->max - i ) < 2U )
+    {
+        status = JSONPartial;
+    }
+    else if( pBuffer[ i + 1U ] != 'u' )
+    {
+        switch( pBuffer[ i + 1U ] )
+        {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                i += 2U;
+                break;
+
+            default:
+                status = JSONIllegalDocument;
+                break;
+        }
+    }
+    else if( ( pScan->max - i ) < 6U )
+    {
+        status = JSONPartial;
+    }
+    else if( readHex4( &( pBuffer[ i + 2U ] ), &high ) == false )
+    {
+        status = JSONIllegalDocument;
+    }
+    else if( ( high >= 0xDC00U ) && ( high <= 0xDFFFU ) )
+    {
+        /* A low surrogate must follow a high one. */
+        status = JSONIllegalDocument;
+    }
+    else if( ( high < 0xD800U ) || ( high > 0xDBFFU ) )
+    {
+        i += 6U;
+    }
+    else if( ( ( pScan->max - i ) > 6U ) && ( pBuffer[ i + 6U ] != '\\' ) )
+    {
+        /* A high surrogate must be followed by a low one. */
+        status = JSONIllegalDocument;
+    }
+    else if( ( ( pScan->max - i ) > 7U ) && ( pBuffer[ i + 7U ] != 'u' ) )
+    {
+        status = JSONIllegalDocument;
+    }
+    else if( ( pScan->max - i ) < 12U )
+    {
+        status = JSONPartial;
+    }
+    else if( ( readHex4( &( pBuffer[ i + 8U ] ), &low ) == false ) ||
+             ( low < 0xDC00U ) || ( low > 0xDFFFU ) )
+    {
+        status = JSONIllegalDocument;
+    }
+    else
+    {
+        i += 12U;
+    }
+
+    *pIndex = i;
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+static JSONStatus_t skipUTF8( const ExtractScan_t * pScan,
+                              size_t * pIndex )
+{
+    JSONStatus_t status = JSONSuccess;
+    const uint8_t * pBytes = ( const uint8_t * ) pScan->pBuffer;
+    size_t i = *pIndex, count = 0U, j = 0U;
+    uint8_t lead = pBytes[ i ], low = 0x80U, high = 0xBFU;
+
+    /* Number of continuation bytes, and the range of the first one that
+     * excludes overlong forms, surrogates and code points above U+10FFFF. */
+    if( ( lead >= 0xC2U ) && ( lead <= 0xDFU ) )
+    {
+        count = 1U;
+    }
+    else if( ( lead >= 0xE0U ) && ( lead <= 0xEFU ) )
+    {
+        count = 2U;
+        low = ( lead == 0xE0U ) ? 0xA0U : 0x80U;
+        high = ( lead == 0xEDU ) ? 0x9FU : 0xBFU;
+    }
+    else if( ( lead >= 0xF0U ) && ( lead <= 0xF4U ) )
+    {
+        count = 3U;
+        low = ( lead == 0xF0U ) ? 0x90U : 0x80U;
+        high = ( lead == 0xF4U ) ? 0x8FU : 0xBFU;
+    }
+    else
+    {
+        status = JSONIllegalDocument;
+    }
+
+    if( status == JSONSuccess )
+    {
+        for( j = 1U; ( j <= count ) && ( status == JSONSuccess ); j++ )
+        {
+            if( ( i + j ) >= pScan->max )
+            {
+                status = JSONPartial;
+            }
+            else if( ( pBytes[ i + j ] < low ) || ( pBytes[ i + j ] > high ) )
+            {
+                status = JSONIllegalDocument;
+            }
+            else
+            {
+                low = 0x80U;
+                high = 0xBFU;
+            }
+        }
+
+        i += count + 1U;
+    }
+
+    *pIndex = i;
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+static JSONStatus_t skipString( ExtractScan_t * pScan )
+{
+    JSONStatus_t status = JSONSuccess;
+    size_t i = pScan->index + 1U;
+    bool closed = false;
+    uint8_t c = 0U;
+
+    assert( pScan->pBuffer[ pScan->index ] == '"' );
+
+    while( ( status == JSONSuccess ) && ( closed == false ) )
+    {
+        if( i >= pScan->max )
+        {
+            status = JSONPartial;
+        }
+        else
+        {
+            c = ( uint8_t ) pScan->pBuffer[ i ];
+
+            if( c == ( uint8_t ) '"' )
+            {
+                i++;
+                closed = true;
+            }
+            else if( c == ( uint8_t ) '\\' )
+            {
+                status = skipEscape( pScan, &i );
+            }
+            else if( c < 0x20U )
+            {
+                status = JSONIllegalDocument;
+            }
+            else if( c < 0x80U )
+            {
+                i++;
+            }
+            else
+            {
+                status = skipUTF8( pScan, &i );
+            }
+        }
+    }
+
+    if( status == JSONSuccess )
+    {
+        pScan->index = i;
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+static JSONStatus_t skipDigits( const ExtractScan_t * pScan,
+                                size_t * pIndex )
+{
+    JSONStatus_t status = JSONSuccess;
+    size_t i = *pIndex;
+
+    if( i >= pScan->max )
+    {
+        status = JSONPartial;
+    }
+    else if( ( pScan->pBuffer[ i ] < '0' ) || ( pScan->pBuffer[ i ] > '9' ) )
+    {
+        status = JSONIllegalDocument;
+    }
+    else
+    {
+        while( ( i < pScan->max ) && ( pScan->pBuffer[ i ] >= '0' ) && ( pScan->pBuffer[ i ] <= '9' ) )
+        {
+            i++;
+        }
+    }
+
+    *pIndex = i;
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+static JSONStatus_t skipNumber( ExtractScan_t * pScan )
+{
+    JSONStatus_t status = JSONSuccess;
+    const char * pBuffer = pScan->pBuffer;
+    size_t i = pScan->index;
+
+    if( pBuffer[ i ] == '-' )
+    {
+        i++;
+    }
+
+    /* The integer part has no leading zero. */
+    if( ( i < pScan->max ) && ( pBuffer[ i ] == '0' ) )
+    {
+        i++;
+    }
+    else
+    {
+        status = skipDigits( pScan, &i );
+    }
+
+    if( ( status == JSONSuccess ) && ( i < pScan->max ) && ( pBuffer[ i ] == '.' ) )
+    {
+        i++;
+        status = skipDigits( pScan, &i );
+    }
+
+    if( ( status == JSONSuccess ) && ( i < pScan->max ) &&
+        ( ( pBuffer[ i ] == 'e' ) || ( pBuffer[ i ] == 'E' ) ) )
+    {
+        i++;
+
+        if( ( i < pScan->max ) && ( ( pBuffer[ i ] == '+' ) || ( pBuffer[ i ] == '-' ) ) )
+        {
+            i++;
+        }
+
+        status = skipDigits( pScan, &i );
+    }
+
+    if( status == JSONSuccess )
+    {
+        pScan->index = i;
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+static JSONStatus_t skipLiteral( ExtractScan_t * pScan,
+                                 const char * pLiteral,
+                                 size_t length )
+{
+    JSONStatus_t status = JSONSuccess;
+    size_t available = MIN( pScan->max - pScan->index, length );
+
+    if( memcmp( &( pScan->pBuffer[ pScan->index ] ), pLiteral, available ) != 0 )
+    {
+        status = JSONIllegalDocument;
+    }
+    else if( available < length )
+    {
+        status = JSONPartial;
+    }
+    else
+    {
+        pScan->index += length;
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+static JSONStatus_t skipScalar( ExtractScan_t * pScan )
+{
+    JSONStatus_t status = JSONSuccess;
+    char c = pScan->pBuffer[ pScan->index ];
+
+    if( c == '"' )
+    {
+        status = skipString( pScan );
+    }
+    else if( ( c == '-' ) || ( ( c >= '0' ) && ( c <= '9' ) ) )
+    {
+        status = skipNumber( pScan );
+    }
+    else if( c == 't' )
+    {
+        status = skipLiteral( pScan, "true", sizeof( "true" ) - 1U );
+    }
+    else if( c == 'f' )
+    {
+        status = skipLiteral( pScan, "false", sizeof( "false" ) - 1U );
+    }
+    else if( c == 'n' )
+    {
+        status = skipLiteral( pScan, "null", sizeof( "null" ) - 1U );
+    }
+    else
+    {
+        status = JSONIllegalDocument;
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+static JSONStatus_t startMember( ExtractScan_t * pScan )
+{
+    JSONStatus_t status = JSONSuccess;
+    const ExtractContainer_t * pContainer = &( pScan->containers[ pScan->depth - 1U ] );
+    size_t nameStart = 0U;
+
+    if( pContainer->isArray == true )
+    {
+        enterSegment( pScan, NULL, 0U, true, pContainer->elementIndex );
+    }
+    else if( pScan->pBuffer[ pScan->index ] != '"' )
+    {
+        status = JSONIllegalDocument;
+    }
+    else
+    {
+        nameStart = pScan->index + 1U;
+        status = skipString( pScan );
+
+        if( status == JSONSuccess )
+        {
+            enterSegment( pScan,
+                          &( pScan->pBuffer[ nameStart ] ),
+                          pScan->index - 1U - nameStart,
+                          false,
+                          0U );
+
+            skipSpace( pScan );
+
+            if( pScan->index >= pScan->max )
+            {
+                status = JSONPartial;
+            }
+            else if( pScan->pBuffer[ pScan->index ] != ':' )
+            {
+                status = JSONIllegalDocument;
+            }
+            else
+            {
+                pScan->index++;
+                skipSpace( pScan );
+            }
+        }
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+static void closeContainer( ExtractScan_t * pScan )
+{
+    assert( pScan->depth > 0U );
+
+    pScan->depth--;
+    endValue( pScan, false );
+}
+/*-----------------------------------------------------------*/
+
+static JSONStatus_t scanValue( ExtractScan_t * pScan,
+                               bool * pExpectValue )
+{
+    JSONStatus_t status = JSONSuccess;
+    ExtractContainer_t * pContainer = NULL;
+    char c = '\0';
+
+    *pExpectValue = false;
+
+    if( pScan->index >= pScan->max )
+    {
+        status = JSONPartial;
+    }
+    else
+    {
+        c = pScan->pBuffer[ pScan->index ];
+        startValue( pScan );
+
+        if( ( c == '{' ) || ( c == '[' ) )
+        {
+            if( pScan->depth >= JSON_EXTRACT_MAX_DEPTH )
+            {
+                status = JSONMaxDepthExceeded;
+            }
+            else
+            {
+                pContainer = &( pScan->containers[ pScan->depth ] );
+                pContainer->isArray = ( c == '[' );
+                pContainer->elementIndex = 0U;
+                pScan->depth++;
+                pScan->index++;
+                skipSpace( pScan );
+
+                if( pScan->index >= pScan->max )
+                {
+                    status = JSONPartial;
+                }
+                else if( pScan->pBuffer[ pScan->index ] == ( ( c == '[' ) ? ']' : '}' ) )
+                {
+                    /* Empty container. */
+                    pScan->index++;
+                    closeContainer( pScan );
+                }
+                else
+                {
+                    status = startMember( pScan );
+                    *pExpectValue = ( status == JSONSuccess );
+                }
+            }
+        }
+        else
+        {
+            status = skipScalar( pScan );
+
+            if( status == JSONSuccess )
+            {
+                endValue( pScan, ( c == '"' ) );
+            }
+        }
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+static JSONStatus_t scanNextMember( ExtractScan_t * pScan,
+                                    bool * pExpectValue )
+{
+    JSONStatus_t status = JSONSuccess;
+    ExtractContainer_t * pContainer = &( pScan->containers[ pScan->depth - 1U ] );
+    char c = '\0';
+
+    *pExpectValue = false;
+
+    leaveSegment( pScan );
+    skipSpace( pScan );
+
+    if( pScan->index >= pScan->max )
+    {
+        status = JSONPartial;
+    }
+    else
+    {
+        c = pScan->pBuffer[ pScan->index ];
+        pScan->index++;
+
+        if( c == ',' )
+        {
+            skipSpace( pScan );
+
+            if( pScan->index >= pScan->max )
+            {
+                status = JSONPartial;
+            }
+            else
+            {
+                pContainer->elementIndex++;
+                status = startMember( pScan );
+                *pExpectValue = ( status == JSONSuccess );
+            }
+        }
+        else if( c == ( ( pContainer->isArray == true ) ? ']' : '}' ) )
+        {
+            closeContainer( pScan );
+        }
+        else
+        {
+            status = JSONIllegalDocument;
+        }
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+static JSONStatus_t scanDocument( ExtractScan_t * pScan )
+{
+    JSONStatus_t status = JSONSuccess;
+    bool expectValue = true, done = false;
+
+    skipSpace( pScan );
+
+    while( ( status == JSONSuccess ) && ( done == false ) )
+    {
+        if( expectValue == true )
+        {
+            status = scanValue( pScan, &expectValue );
+        }
+        else if( pScan->depth > 0U )
+        {
+            status = scanNextMember( pScan, &expectValue );
+        }
+        else
+        {
+            /* Only whitespace may follow the top level value. */
+            skipSpace( pScan );
+
+            if( pScan->index < pScan->max )
+            {
+                status = JSONIllegalDocument;
+            }
+
+            done = true;
+        }
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+JSONStatus_t JSONExtract_Keys( const char * pBuffer,
+                               size_t max,
+                               JSONExtractKey_t * pKeys,
+                               size_t keyCount )
+{
+    JSONStatus_t status = JSONSuccess;
+    ExtractScan_t scan;
+    JSONExtractKey_t * pKey = NULL;
+    bool missing = false;
+    size_t i = 0U;
+
+    if( ( pBuffer == NULL ) || ( pKeys == NULL ) )
+    {
+        status = JSONNullParameter;
+    }
+    else if( max == 0U )
+    {
+        status = JSONBadParameter;
+    }
+    else
+    {
+        for( i = 0U; i < keyCount; i++ )
+        {
+            pKey = &( pKeys[ i ] );
+
+            if( validateKey( pKey->pKey, pKey->keyLength ) == false )
+            {
+                status = JSONBadParameter;
+            }
+
+            pKey->pValue = NULL;
+            pKey->valueLength = 0U;
+            pKey->cursor = 0U;
+            pKey->matchedDepth = 0U;
+            pKey->state = KEY_STATE_MATCHING;
+        }
+    }
+
+    if( status == JSONSuccess )
+    {
+        ( void ) memset( &scan, 0x00, sizeof( scan ) );
+        scan.pBuffer = pBuffer;
+        scan.max = max;
+        scan.pKeys = pKeys;
+        scan.keyCount = keyCount;
+
+        status = scanDocument( &scan );
+
+        /* Values are only returned from valid documents. */
+        for( i = 0U; i < keyCount; i++ )
+        {
+            pKey = &( pKeys[ i ] );
+
+            if( ( status != JSONSuccess ) || ( pKey->state != KEY_STATE_FOUND ) )
+            {
+                pKey->pValue = NULL;
+                pKey->valueLength = 0U;
+                missing = true;
+            }
+        }
+
+        if( ( status == JSONSuccess ) && ( missing == true ) )
+        {
+            status = JSONNotFound;
+        }
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
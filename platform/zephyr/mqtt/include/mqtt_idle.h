@@ -0,0 +1,106 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file mqtt_idle.h
+ * @brief Drive an MQTT connection from the time of its next keep-alive
+ * action instead of polling it.
+ *
+ * MQTT_ProcessLoop() receives with the timeout of the socket over and over
+ * until its own timeout elapses, so a thread calling it in a loop wakes up
+ * periodically even when the connection is idle. #MqttIdle_ProcessLoop
+ * instead blocks in zsock_poll() until data arrives, the keep-alive interval
+ * or the PINGRESP timeout of the context expires, or the caller's own deadline
+ * is reached, and only then calls MQTT_ProcessLoop(). No timer or thread
+ * runs in between, so a tickless kernel can stay idle.
+ *
+ * @note The receive timeout of the transport bounds how long
+ * MQTT_ProcessLoop() blocks when it is woken up for a keep-alive action with
+ * nothing to read, so keep it short.
+ */
+
+#ifndef MQTT_IDLE_H_
+#define MQTT_IDLE_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* MQTT API header. */
+#include "core_mqtt.h"
+
+/**
+ * @brief Time in milliseconds given to each MQTT_ProcessLoop() call once the
+ * connection is ready, to receive the rest of a packet.
+ */
+#ifndef MQTT_IDLE_RECEIVE_TIMEOUT_MS
+    #define MQTT_IDLE_RECEIVE_TIMEOUT_MS    ( 10U )
+#endif
+
+/**
+ * @brief Value of #MqttIdle_NextDeadlineMs when keep-alive is disabled.
+ */
+#define MQTT_IDLE_NO_DEADLINE    ( UINT32_MAX )
+
+/**
+ * @brief Function telling whether the transport holds received data that
+ * polling the socket does not report, such as MbedTLS_HasPendingData().
+ *
+ * @param[in] pNetworkContext The network context of the MQTT connection.
+ *
+ * @return true if the transport can return data without reading the socket.
+ */
+typedef bool ( * MqttIdlePendingData_t )( NetworkContext_t * pNetworkContext );
+
+/**
+ * @brief Get the time until MQTT_ProcessLoop() must run for the keep-alive of
+ * a connection: to send a PINGREQ, or to time out the PINGRESP.
+ *
+ * @param[in] pContext The MQTT context.
+ *
+ * @return The time in milliseconds, 0 if it is due, or
+ * #MQTT_IDLE_NO_DEADLINE if keep-alive is disabled.
+ */
+uint32_t MqttIdle_NextDeadlineMs( const MQTTContext_t * pContext );
+
+/**
+ * @brief Process the connection for @p timeoutMs, sleeping whenever there is
+ * nothing to do.
+ *
+ * It replaces MQTT_ProcessLoop() with the same timeout, such as to wait for an
+ * acknowledgment, as well as the sleeps of an idle connection: give the time
+ * until the next packet to send as @p timeoutMs.
+ *
+ * @param[in] pContext The MQTT context.
+ * @param[in] socketDescriptor The socket of the transport of @p pContext.
+ * @param[in] hasPendingData Function reporting data buffered by the transport,
+ * or NULL if polling the socket reports all the data.
+ * @param[in] timeoutMs Time to return after, in milliseconds.
+ *
+ * @return #MQTTSuccess, or the first error of MQTT_ProcessLoop().
+ */
+MQTTStatus_t MqttIdle_ProcessLoop( MQTTContext_t * pContext,
+                                   int32_t socketDescriptor,
+                                   MqttIdlePendingData_t hasPendingData,
+                                   uint32_t timeoutMs );
+
+#endif /* ifndef MQTT_IDLE_H_ */
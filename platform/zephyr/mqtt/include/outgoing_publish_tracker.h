@@ -0,0 +1,175 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file outgoing_publish_tracker.h
+ * @brief Store of the outgoing QoS 1 and QoS 2 publishes of an MQTT connection
+ * until they are acknowledged, to resend them when a session is resumed.
+ *
+ * Free entries are found in an allocation bitmap and entries are looked up by
+ * packet identifier in a hash table, so storing, acknowledging and resending a
+ * publish take constant time however many publishes are in flight.
+ *
+ * @note A tracker is not thread safe; it is meant to be used from the thread
+ * running the MQTT connection.
+ */
+
+#ifndef OUTGOING_PUBLISH_TRACKER_H_
+#define OUTGOING_PUBLISH_TRACKER_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* MQTT API header. */
+#include "core_mqtt.h"
+
+/**
+ * @brief Number of entries tracked by each word of the allocation bitmap.
+ */
+#define OUTGOING_PUBLISH_BITS_PER_WORD    ( 32U )
+
+/**
+ * @brief An outgoing publish waiting for its acknowledgment.
+ */
+typedef struct OutgoingPublish
+{
+    /**
+     * @brief Publish info of the publish packet.
+     */
+    MQTTPublishInfo_t pubInfo;
+
+    /**
+     * @brief Packet identifier of the publish packet.
+     */
+    uint16_t packetId;
+
+    /**
+     * @brief One more than the index of the next entry of the same hash
+     * bucket, or 0 at the end of the bucket.
+     */
+    uint16_t nextInBucket;
+} OutgoingPublish_t;
+
+/**
+ * @brief Outgoing publishes of an MQTT connection.
+ *
+ * Define one with #OUTGOING_PUBLISH_TRACKER_DEFINE. A tracker in zeroed
+ * memory is empty.
+ */
+typedef struct OutgoingPublishTracker
+{
+    OutgoingPublish_t * pEntries; /**< @brief Storage of the publishes. */
+    uint16_t * pBuckets;          /**< @brief One more than the index of the first entry of each hash bucket, or 0. */
+    uint32_t * pAllocated;        /**< @brief Allocation bitmap of #OutgoingPublishTracker_t.pEntries. */
+    uint16_t entryCount;          /**< @brief Number of entries, and of hash buckets. */
+} OutgoingPublishTracker_t;
+
+/**
+ * @brief Define a static tracker named @p name holding up to @p maxPublishes
+ * publishes.
+ *
+ * Packet identifiers are handed out in sequence by MQTT_GetPacketId(), so
+ * hashing them modulo the number of entries spreads the publishes in flight
+ * over one bucket each.
+ *
+ * @param[in] name Name of the #OutgoingPublishTracker_t.
+ * @param[in] maxPublishes Number of publishes, from 1 to 65534.
+ */
+#define OUTGOING_PUBLISH_TRACKER_DEFINE( name, maxPublishes )                                    \
+    static OutgoingPublish_t name ## Entries[ maxPublishes ];                                    \
+    static uint16_t name ## Buckets[ maxPublishes ];                                             \
+    static uint32_t name ## Allocated[ ( ( maxPublishes ) + OUTGOING_PUBLISH_BITS_PER_WORD - 1U ) \
+                                      / OUTGOING_PUBLISH_BITS_PER_WORD ];                        \
+    static OutgoingPublishTracker_t name =                                                       \
+    {                                                                                            \
+        .pEntries = name ## Entries,                                                             \
+        .pBuckets = name ## Buckets,                                                             \
+        .pAllocated = name ## Allocated,                                                         \
+        .entryCount = ( uint16_t ) ( maxPublishes )                                              \
+    }
+
+/**
+ * @brief Store an outgoing publish.
+ *
+ * The caller fills in OutgoingPublish_t.pubInfo of the entry returned, which
+ * must stay valid until the publish is acknowledged.
+ *
+ * @param[in] pTracker The tracker.
+ * @param[in] packetId Packet identifier of the publish, obtained with
+ * MQTT_GetPacketId().
+ *
+ * @return The entry of the publish, or NULL if the tracker is full.
+ */
+OutgoingPublish_t * OutgoingPublish_Add( OutgoingPublishTracker_t * pTracker,
+                                         uint16_t packetId );
+
+/**
+ * @brief Find the outgoing publish with a packet identifier.
+ *
+ * @param[in] pTracker The tracker.
+ * @param[in] packetId Packet identifier of the publish.
+ *
+ * @return The entry of the publish, or NULL if none has this identifier.
+ */
+OutgoingPublish_t * OutgoingPublish_Find( const OutgoingPublishTracker_t * pTracker,
+                                          uint16_t packetId );
+
+/**
+ * @brief Forget the outgoing publish with a packet identifier, once it is
+ * acknowledged or could not be sent.
+ *
+ * @param[in] pTracker The tracker.
+ * @param[in] packetId Packet identifier of the publish.
+ *
+ * @return `true` if a publish was removed, `false` if none has this identifier.
+ */
+bool OutgoingPublish_Remove( OutgoingPublishTracker_t * pTracker,
+                             uint16_t packetId );
+
+/**
+ * @brief Forget every outgoing publish, such as when a clean session starts.
+ *
+ * @param[in] pTracker The tracker.
+ */
+void OutgoingPublish_RemoveAll( OutgoingPublishTracker_t * pTracker );
+
+/**
+ * @brief Resend the outgoing publishes that the broker did not acknowledge
+ * before a session was resumed.
+ *
+ * The publishes are resent with the DUP flag, in the order coreMQTT reports
+ * them with MQTT_PublishToResend(), which is the order in which they were
+ * first sent.
+ *
+ * @param[in] pTracker The tracker.
+ * @param[in] pMqttContext MQTT context of the resumed session.
+ *
+ * @return #MQTTSuccess if every publish was resent, #MQTTIllegalState if
+ * coreMQTT reports a publish missing from the tracker, or the status of the
+ * failed MQTT_Publish() call.
+ */
+MQTTStatus_t OutgoingPublish_Resend( OutgoingPublishTracker_t * pTracker,
+                                     MQTTContext_t * pMqttContext );
+
+#endif /* ifndef OUTGOING_PUBLISH_TRACKER_H_ */
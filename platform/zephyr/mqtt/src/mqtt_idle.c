@@ -0,0 +1,187 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file mqtt_idle.c
+ * @brief Implementation of the idle processing of an MQTT connection.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+
+/* Zephyr includes. */
+#include <zephyr.h>
+#include <net/socket.h>
+
+/* Include header that defines log levels. */
+#include "logging_levels.h"
+
+/* Logging configuration for the idle MQTT processing. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "MqttIdle"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_ERROR
+#endif
+
+#include "logging_stack.h"
+
+#include "mqtt_idle.h"
+
+/**
+ * @brief The PINGRESP timeout of coreMQTT, which MQTTContext_t does not hold.
+ * It must match the value coreMQTT is built with.
+ */
+#ifndef MQTT_PINGRESP_TIMEOUT_MS
+    #define MQTT_PINGRESP_TIMEOUT_MS    ( 500U )
+#endif
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Wait for the socket of the connection to become readable.
+ *
+ * @param[in] socketDescriptor The socket.
+ * @param[in] waitMs The longest wait in milliseconds.
+ * @param[out] pReady Whether the socket has data to read.
+ *
+ * @return #MQTTSuccess, or #MQTTRecvFailed if the socket failed or was closed
+ * by the server, which MQTT_ProcessLoop() would take for a lack of data.
+ */
+static MQTTStatus_t waitForData( int32_t socketDescriptor,
+                                 uint32_t waitMs,
+                                 bool * pReady );
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t waitForData( int32_t socketDescriptor,
+                                 uint32_t waitMs,
+                                 bool * pReady )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    struct zsock_pollfd pollFd;
+    int pollStatus = 0;
+    uint8_t peekByte = 0U;
+
+    pollFd.fd = socketDescriptor;
+    pollFd.events = ZSOCK_POLLIN;
+    pollFd.revents = 0;
+
+    pollStatus = zsock_poll( &pollFd, 1, ( int ) MIN( waitMs, ( uint32_t ) INT32_MAX ) );
+
+    if( ( pollStatus < 0 ) ||
+        ( ( pollFd.revents & ( ZSOCK_POLLERR | ZSOCK_POLLHUP | ZSOCK_POLLNVAL ) ) != 0 ) )
+    {
+        status = MQTTRecvFailed;
+    }
+    else if( ( pollStatus > 0 ) &&
+             ( zsock_recv( socketDescriptor, &peekByte, 1, ZSOCK_MSG_PEEK | ZSOCK_MSG_DONTWAIT ) == 0 ) )
+    {
+        /* Readable with nothing to read is the end of the stream. */
+        status = MQTTRecvFailed;
+    }
+    else
+    {
+        *pReady = ( pollStatus > 0 );
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t MqttIdle_NextDeadlineMs( const MQTTContext_t * pContext )
+{
+    uint32_t keepAliveMs = 0U, limitMs = 0U, elapsedMs = 0U;
+    uint32_t deadlineMs = MQTT_IDLE_NO_DEADLINE;
+
+    assert( pContext != NULL );
+    assert( pContext->getTime != NULL );
+
+    keepAliveMs = 1000U * ( uint32_t ) pContext->keepAliveIntervalSec;
+
+    if( keepAliveMs != 0U )
+    {
+        if( pContext->waitingForPingResp == true )
+        {
+            elapsedMs = pContext->getTime() - pContext->pingReqSendTimeMs;
+            limitMs = MQTT_PINGRESP_TIMEOUT_MS;
+        }
+        else
+        {
+            elapsedMs = pContext->getTime() - pContext->lastPacketTime;
+            limitMs = keepAliveMs;
+        }
+
+        /* coreMQTT acts once the elapsed time exceeds the limit. */
+        deadlineMs = ( elapsedMs > limitMs ) ? 0U : ( limitMs - elapsedMs + 1U );
+    }
+
+    return deadlineMs;
+}
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MqttIdle_ProcessLoop( MQTTContext_t * pContext,
+                                   int32_t socketDescriptor,
+                                   MqttIdlePendingData_t hasPendingData,
+                                   uint32_t timeoutMs )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint32_t entryTimeMs = 0U, elapsedMs = 0U, deadlineMs = 0U, waitMs = 0U;
+    bool ready = false;
+
+    assert( pContext != NULL );
+    assert( pContext->getTime != NULL );
+
+    entryTimeMs = pContext->getTime();
+
+    do
+    {
+        deadlineMs = MqttIdle_NextDeadlineMs( pContext );
+        waitMs = MIN( timeoutMs - elapsedMs, deadlineMs );
+
+        ready = ( hasPendingData != NULL ) &&
+                ( hasPendingData( pContext->transportInterface.pNetworkContext ) == true );
+
+        if( ( ready == false ) && ( waitMs > 0U ) )
+        {
+            status = waitForData( socketDescriptor, waitMs, &ready );
+
+            if( status != MQTTSuccess )
+            {
+                LogError( ( "The MQTT connection was closed while idle." ) );
+            }
+        }
+
+        /* Run the MQTT process loop for the data, or for the keep-alive once
+         * its deadline is reached. */
+        if( ( status == MQTTSuccess ) &&
+            ( ( ready == true ) || ( MqttIdle_NextDeadlineMs( pContext ) == 0U ) ) )
+        {
+            status = MQTT_ProcessLoop( pContext, MQTT_IDLE_RECEIVE_TIMEOUT_MS );
+        }
+
+        elapsedMs = pContext->getTime() - entryTimeMs;
+    } while( ( status == MQTTSuccess ) && ( elapsedMs < timeoutMs ) );
+
+    return status;
+}
+/*-----------------------------------------------------------*/
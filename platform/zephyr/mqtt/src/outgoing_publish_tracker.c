@@ -0,0 +1,263 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file outgoing_publish_tracker.c
+ * @brief Store of the outgoing publishes of an MQTT connection, indexed by
+ * packet identifier.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+/* Zephyr includes. */
+#include <zephyr.h>
+
+/* MQTT state API header, for MQTT_PublishToResend(). */
+#include "core_mqtt_state.h"
+
+#include "outgoing_publish_tracker.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the hash bucket of a packet identifier.
+ *
+ * @param[in] pTracker The tracker.
+ * @param[in] packetId The packet identifier.
+ *
+ * @return Index of the bucket in OutgoingPublishTracker_t.pBuckets.
+ */
+static size_t bucketOf( const OutgoingPublishTracker_t * pTracker,
+                        uint16_t packetId );
+
+/**
+ * @brief Claim a free entry of the allocation bitmap.
+ *
+ * @param[in] pTracker The tracker.
+ *
+ * @return Index of the entry, or OutgoingPublishTracker_t.entryCount if all are
+ * in use.
+ */
+static size_t allocateEntry( OutgoingPublishTracker_t * pTracker );
+
+/*-----------------------------------------------------------*/
+
+static size_t bucketOf( const OutgoingPublishTracker_t * pTracker,
+                        uint16_t packetId )
+{
+    return ( size_t ) packetId % pTracker->entryCount;
+}
+/*-----------------------------------------------------------*/
+
+static size_t allocateEntry( OutgoingPublishTracker_t * pTracker )
+{
+    size_t wordCount = ( ( size_t ) pTracker->entryCount + OUTGOING_PUBLISH_BITS_PER_WORD - 1U ) / OUTGOING_PUBLISH_BITS_PER_WORD;
+    size_t wordIndex = 0U, entryIndex = pTracker->entryCount;
+    uint32_t freeBits = 0U;
+
+    for( wordIndex = 0U; wordIndex < wordCount; wordIndex++ )
+    {
+        freeBits = ~( pTracker->pAllocated[ wordIndex ] );
+
+        /* The last word may track fewer entries than it has bits. */
+        if( ( ( wordIndex + 1U ) * OUTGOING_PUBLISH_BITS_PER_WORD ) > pTracker->entryCount )
+        {
+            freeBits &= ( 1UL << ( pTracker->entryCount % OUTGOING_PUBLISH_BITS_PER_WORD ) ) - 1UL;
+        }
+
+        if( freeBits != 0U )
+        {
+            entryIndex = ( wordIndex * OUTGOING_PUBLISH_BITS_PER_WORD ) + ( size_t ) find_lsb_set( freeBits ) - 1U;
+            pTracker->pAllocated[ wordIndex ] |= 1UL << ( entryIndex % OUTGOING_PUBLISH_BITS_PER_WORD );
+            break;
+        }
+    }
+
+    return entryIndex;
+}
+/*-----------------------------------------------------------*/
+
+OutgoingPublish_t * OutgoingPublish_Add( OutgoingPublishTracker_t * pTracker,
+                                         uint16_t packetId )
+{
+    OutgoingPublish_t * pPublish = NULL;
+    size_t entryIndex = 0U, bucket = 0U;
+
+    assert( pTracker != NULL );
+    assert( packetId != MQTT_PACKET_ID_INVALID );
+    assert( OutgoingPublish_Find( pTracker, packetId ) == NULL );
+
+    entryIndex = allocateEntry( pTracker );
+
+    if( entryIndex < pTracker->entryCount )
+    {
+        bucket = bucketOf( pTracker, packetId );
+
+        pPublish = &( pTracker->pEntries[ entryIndex ] );
+        ( void ) memset( &( pPublish->pubInfo ), 0x00, sizeof( pPublish->pubInfo ) );
+        pPublish->packetId = packetId;
+
+        /* Push the entry at the head of its bucket. */
+        pPublish->nextInBucket = pTracker->pBuckets[ bucket ];
+        pTracker->pBuckets[ bucket ] = ( uint16_t ) ( entryIndex + 1U );
+    }
+
+    return pPublish;
+}
+/*-----------------------------------------------------------*/
+
+OutgoingPublish_t * OutgoingPublish_Find( const OutgoingPublishTracker_t * pTracker,
+                                          uint16_t packetId )
+{
+    OutgoingPublish_t * pPublish = NULL;
+    uint16_t link = 0U;
+
+    assert( pTracker != NULL );
+
+    if( packetId != MQTT_PACKET_ID_INVALID )
+    {
+        for( link = pTracker->pBuckets[ bucketOf( pTracker, packetId ) ]; link != 0U; link = pPublish->nextInBucket )
+        {
+            pPublish = &( pTracker->pEntries[ link - 1U ] );
+
+            if( pPublish->packetId == packetId )
+            {
+                break;
+            }
+        }
+
+        if( link == 0U )
+        {
+            pPublish = NULL;
+        }
+    }
+
+    return pPublish;
+}
+/*-----------------------------------------------------------*/
+
+bool OutgoingPublish_Remove( OutgoingPublishTracker_t * pTracker,
+                             uint16_t packetId )
+{
+    OutgoingPublish_t * pPublish = NULL;
+    uint16_t * pLink = NULL;
+    size_t entryIndex = 0U;
+    bool removed = false;
+
+    assert( pTracker != NULL );
+
+    if( packetId != MQTT_PACKET_ID_INVALID )
+    {
+        /* Walk the links of the bucket, to unlink the entry in place. */
+        for( pLink = &( pTracker->pBuckets[ bucketOf( pTracker, packetId ) ] ); *pLink != 0U; pLink = &( pPublish->nextInBucket ) )
+        {
+            entryIndex = ( size_t ) *pLink - 1U;
+            pPublish = &( pTracker->pEntries[ entryIndex ] );
+
+            if( pPublish->packetId == packetId )
+            {
+                *pLink = pPublish->nextInBucket;
+                ( void ) memset( pPublish, 0x00, sizeof( OutgoingPublish_t ) );
+                pTracker->pAllocated[ entryIndex / OUTGOING_PUBLISH_BITS_PER_WORD ] &=
+                    ~( 1UL << ( entryIndex % OUTGOING_PUBLISH_BITS_PER_WORD ) );
+                removed = true;
+                break;
+            }
+        }
+    }
+
+    return removed;
+}
+/*-----------------------------------------------------------*/
+
+void OutgoingPublish_RemoveAll( OutgoingPublishTracker_t * pTracker )
+{
+    size_t wordCount = 0U;
+
+    assert( pTracker != NULL );
+
+    wordCount = ( ( size_t ) pTracker->entryCount + OUTGOING_PUBLISH_BITS_PER_WORD - 1U ) / OUTGOING_PUBLISH_BITS_PER_WORD;
+
+    ( void ) memset( pTracker->pEntries, 0x00, sizeof( OutgoingPublish_t ) * pTracker->entryCount );
+    ( void ) memset( pTracker->pBuckets, 0x00, sizeof( uint16_t ) * pTracker->entryCount );
+    ( void ) memset( pTracker->pAllocated, 0x00, sizeof( uint32_t ) * wordCount );
+}
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t OutgoingPublish_Resend( OutgoingPublishTracker_t * pTracker,
+                                     MQTTContext_t * pMqttContext )
+{
+    MQTTStatus_t mqttStatus = MQTTSuccess;
+    MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
+    OutgoingPublish_t * pPublish = NULL;
+    uint16_t packetIdToResend = MQTT_PACKET_ID_INVALID;
+
+    assert( pTracker != NULL );
+    assert( pMqttContext != NULL );
+
+    /* MQTT_PublishToResend() provides the packet IDs of the PUBLISH packets
+     * to resend, in the order they were first sent, as required by the MQTT
+     * v3.1.1 spec. */
+    packetIdToResend = MQTT_PublishToResend( pMqttContext, &cursor );
+
+    while( ( packetIdToResend != MQTT_PACKET_ID_INVALID ) && ( mqttStatus == MQTTSuccess ) )
+    {
+        pPublish = OutgoingPublish_Find( pTracker, packetIdToResend );
+
+        if( pPublish == NULL )
+        {
+            LogError( ( "Packet id %u requires resend, but was not found in "
+                        "the outgoing publishes.",
+                        packetIdToResend ) );
+            mqttStatus = MQTTIllegalState;
+        }
+        else
+        {
+            pPublish->pubInfo.dup = true;
+
+            LogInfo( ( "Sending duplicate PUBLISH with packet id %u.",
+                       pPublish->packetId ) );
+            mqttStatus = MQTT_Publish( pMqttContext, &( pPublish->pubInfo ), pPublish->packetId );
+
+            if( mqttStatus != MQTTSuccess )
+            {
+                LogError( ( "Sending duplicate PUBLISH for packet id %u "
+                            " failed with status %s.",
+                            pPublish->packetId,
+                            MQTT_Status_strerror( mqttStatus ) ) );
+            }
+            else
+            {
+                LogInfo( ( "Sent duplicate PUBLISH successfully for packet id %u.\n\n",
+                           pPublish->packetId ) );
+
+                /* Get the next packetID to be resent. */
+                packetIdToResend = MQTT_PublishToResend( pMqttContext, &cursor );
+            }
+        }
+    }
+
+    return mqttStatus;
+}
+/*-----------------------------------------------------------*/
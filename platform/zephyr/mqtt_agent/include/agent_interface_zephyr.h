@@ -30,19 +30,322 @@
 #include "core_mqtt_agent_message_interface.h"
 #include "core_mqtt_agent.h"
 
+/* Latency tracing of the agent commands. */
+#include "agent_latency_zephyr.h"
+
+/**
+ * @brief Number of priority lanes of a message context. Lane 0 has the
+ * highest priority.
+ */
+#ifndef AGENT_MESSAGE_LANES
+    #define AGENT_MESSAGE_LANES    ( 2U )
+#endif
+
+/**
+ * @brief Number of commands each lane but the last can hold. The last lane,
+ * with the lowest priority, holds the commands of the buffer given to
+ * #Agent_MessageContextInit.
+ */
+#ifndef AGENT_PRIORITY_LANE_LENGTH
+    #define AGENT_PRIORITY_LANE_LENGTH    ( 4U )
+#endif
+
+/**
+ * @brief Number of commands that #Agent_MessageReceive takes from higher
+ * lanes while a lower lane holds a command, before it takes one from the
+ * lower lane. This bounds the wait of the lower lanes when the higher lanes
+ * are saturated.
+ */
+#ifndef AGENT_STARVATION_LIMIT
+    #define AGENT_STARVATION_LIMIT    ( 8U )
+#endif
+
+/**
+ * @brief Maximum number of commands that #Agent_MessageReceive takes from the
+ * lanes at once. It hands them out on its next calls without waiting again,
+ * so that a burst of commands is processed back to back.
+ *
+ * Set to 1 to take commands one by one.
+ */
+#ifndef AGENT_RECEIVE_BATCH_SIZE
+    #define AGENT_RECEIVE_BATCH_SIZE    ( 4U )
+#endif
+
+/**
+ * @brief Set to 1 to build the coalescing of QoS 0 publishes enabled with
+ * #Agent_EnableCoalescing, as with
+ * CONFIG_AWS_IOT_MQTT_AGENT_COALESCE_PUBLISHES when the Kconfig options of the
+ * agent are used.
+ */
+#ifndef AGENT_COALESCE_PUBLISHES
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_COALESCE_PUBLISHES )
+        #define AGENT_COALESCE_PUBLISHES    ( 1 )
+    #else
+        #define AGENT_COALESCE_PUBLISHES    ( 0 )
+    #endif
+#endif
+
+/**
+ * @brief Longest time in milliseconds a coalesced QoS 0 publish waits for
+ * other publishes before it is sent, set with
+ * CONFIG_AWS_IOT_MQTT_AGENT_COALESCE_WINDOW_MS when the Kconfig options of the
+ * agent are used.
+ */
+#ifndef AGENT_COALESCE_WINDOW_MS
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_COALESCE_WINDOW_MS )
+        #define AGENT_COALESCE_WINDOW_MS    ( CONFIG_AWS_IOT_MQTT_AGENT_COALESCE_WINDOW_MS )
+    #else
+        #define AGENT_COALESCE_WINDOW_MS    ( 10U )
+    #endif
+#endif
+
+/**
+ * @brief Longest time in milliseconds the coalesced packets wait for the
+ * transport to send any of them before the connection is given up, set with
+ * CONFIG_AWS_IOT_MQTT_AGENT_COALESCE_SEND_TIMEOUT_MS when the Kconfig options
+ * of the agent are used.
+ */
+#ifndef AGENT_COALESCE_SEND_TIMEOUT_MS
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_COALESCE_SEND_TIMEOUT_MS )
+        #define AGENT_COALESCE_SEND_TIMEOUT_MS    ( CONFIG_AWS_IOT_MQTT_AGENT_COALESCE_SEND_TIMEOUT_MS )
+    #else
+        #define AGENT_COALESCE_SEND_TIMEOUT_MS    ( 1000U )
+    #endif
+#endif
+
+/**
+ * @brief Function choosing the lane of a command sent with
+ * #Agent_MessageSend.
+ *
+ * @param[in] pCommand The command.
+ *
+ * @return Lane of the command, from 0 for the highest priority to
+ * #AGENT_MESSAGE_LANES - 1 for the lowest. Larger values select the lowest lane.
+ */
+typedef uint32_t ( * AgentPriorityClassifier_t )( const MQTTAgentCommand_t * pCommand );
+
+/**
+ * @brief Function reporting whether a transport holds received data that has
+ * not been read yet, such as the remainder of a decrypted TLS record.
+ *
+ * Such data cannot be detected by polling the socket.
+ */
+typedef bool ( * AgentPendingDataCheck_t )( NetworkContext_t * pNetworkContext );
+
 /**
  * @ingroup mqtt_agent_struct_types
  * @brief Context with which tasks may deliver messages to the agent.
  */
 struct MQTTAgentMessageContext
 {
-    struct k_msgq queue;
+    /**
+     * @brief Queue of each lane, from the highest priority to the lowest.
+     */
+    struct k_msgq lanes[ AGENT_MESSAGE_LANES ];
+
+    /**
+     * @brief Storage of the lanes but the last.
+     */
+    MQTTAgentCommand_t * laneBuffers[ AGENT_MESSAGE_LANES - 1U ][ AGENT_PRIORITY_LANE_LENGTH ];
+
+    /**
+     * @brief Number of commands in all the lanes, taken by the receiver
+     * before each command it dequeues.
+     */
+    struct k_sem pendingCommands;
+
+    /**
+     * @brief Commands taken from higher lanes since each lane was last served
+     * while it held a command, in its queue or in
+     * #MQTTAgentMessageContext.batch.
+     */
+    uint32_t skippedCount[ AGENT_MESSAGE_LANES ];
+
+    AgentPriorityClassifier_t classify; /**< @brief Chooses the lane of each command. */
+
+    /**
+     * @brief Commands taken from the lanes by #Agent_MessageReceive and not
+     * handed out yet.
+     */
+    MQTTAgentCommand_t * batch[ AGENT_RECEIVE_BATCH_SIZE ];
+    uint32_t batchCount; /**< @brief Number of commands in #MQTTAgentMessageContext.batch. */
+    uint32_t batchIndex; /**< @brief Next command of #MQTTAgentMessageContext.batch to hand out. */
+    uint32_t batchLane;  /**< @brief Lane of the commands of #MQTTAgentMessageContext.batch. */
+
+    /**
+     * @brief eventfd signalled by #Agent_MessageSend so that the agent can
+     * wait on the queue and its socket at the same time; -1 if unavailable.
+     */
+    int wakeupFd;
+
+    /**
+     * @brief Socket of the MQTT connection; -1 while not connected.
+     */
+    int32_t socket;
+
+    NetworkContext_t * pNetworkContext;       /**< @brief Network context passed to #MQTTAgentMessageContext.pendingDataCheck. */
+    AgentPendingDataCheck_t pendingDataCheck; /**< @brief Optional check for data buffered by the transport. */
+
+    #if ( AGENT_COALESCE_PUBLISHES == 1 )
+
+        /**
+         * @brief Transport of the connection, to which the coalesced packets
+         * are sent.
+         */
+        TransportInterface_t coalescedTransport;
+
+        /**
+         * @brief Buffer collecting the packets sent while QoS 0 publishes are
+         * coalesced; NULL while coalescing is disabled.
+         */
+        uint8_t * pCoalesceBuffer;
+        size_t coalesceBufferSize; /**< @brief Size of #MQTTAgentMessageContext.pCoalesceBuffer. */
+        size_t coalescedBytes;     /**< @brief Bytes held in #MQTTAgentMessageContext.pCoalesceBuffer. */
+        int64_t coalesceStartMs;   /**< @brief Uptime at which the oldest held byte was buffered. */
+        bool corked;               /**< @brief Whether the agent processes a QoS 0 publish, whose packets are held. */
+        bool coalesceBroken;       /**< @brief Whether the connection was shut down as held packets could not be sent. */
+    #endif
+
+    #if ( AGENT_LATENCY_TRACING == 1 )
+
+        /**
+         * @brief Transport of the connection, whose sends are timestamped.
+         */
+        TransportInterface_t tracedTransport;
+
+        /**
+         * @brief Command last handed out by #Agent_MessageReceive, whose first
+         * network send is timestamped; NULL before any.
+         */
+        MQTTAgentCommand_t * pTracedCommand;
+    #endif
 };
 
+/**
+ * @brief Initialize a message context.
+ *
+ * Commands are routed to the lanes of the context by
+ * #Agent_DefaultPriorityClassifier until #Agent_SetPriorityClassifier is called.
+ *
+ * @param[out] pMsgCtx The #MQTTAgentMessageContext_t to initialize.
+ * @param[in] pQueueBuffer Buffer for the lowest-priority lane, holding
+ * @p queueLength command pointers and aligned to a pointer.
+ * @param[in] queueLength Maximum number of commands in the lowest-priority lane.
+ */
+void Agent_MessageContextInit( MQTTAgentMessageContext_t * pMsgCtx,
+                               char * pQueueBuffer,
+                               uint32_t queueLength );
+
+/**
+ * @brief Choose the lane of a command: QoS 0 publishes, such as telemetry, go
+ * to the lowest-priority lane, and every other command to the highest.
+ *
+ * @param[in] pCommand The command.
+ *
+ * @return Lane of the command.
+ */
+uint32_t Agent_DefaultPriorityClassifier( const MQTTAgentCommand_t * pCommand );
+
+/**
+ * @brief Change how commands are routed to the lanes of a message context.
+ *
+ * @note Call this function before commands are sent to the context.
+ *
+ * @param[in] pMsgCtx An #MQTTAgentMessageContext_t.
+ * @param[in] classify Function choosing the lane of each command, or NULL for
+ * #Agent_DefaultPriorityClassifier.
+ */
+void Agent_SetPriorityClassifier( MQTTAgentMessageContext_t * pMsgCtx,
+                                  AgentPriorityClassifier_t classify );
+
+/**
+ * @brief Set the socket on which #Agent_MessageReceive also waits.
+ *
+ * While a socket is set, #Agent_MessageReceive returns as soon as a command
+ * is queued or data arrives on the socket, instead of blocking on the queue
+ * alone. It returns `false` in the latter case, which makes the agent run the
+ * MQTT process loop right away.
+ *
+ * @note Call this function from the agent thread, or while the agent does not
+ * run, such as while the runner of agent_runner_zephyr.h does not serve it.
+ *
+ * @param[in] pMsgCtx An #MQTTAgentMessageContext_t.
+ * @param[in] socket Socket of the connection, or -1 once disconnected.
+ * @param[in] pNetworkContext Network context of the connection.
+ * @param[in] pendingDataCheck Check for data buffered by the transport, or NULL.
+ */
+void Agent_SetNetworkSocket( MQTTAgentMessageContext_t * pMsgCtx,
+                             int32_t socket,
+                             NetworkContext_t * pNetworkContext,
+                             AgentPendingDataCheck_t pendingDataCheck );
+
+#if ( AGENT_COALESCE_PUBLISHES == 1 )
+
+/**
+ * @brief Coalesce the QoS 0 publishes processed back to back by the agent of a
+ * message context into as few transport sends as possible.
+ *
+ * The packets of a QoS 0 publish are held in @p pBuffer, and sent with those
+ * of the following QoS 0 publishes, in order, once another command is
+ * received, the buffer is full, or the oldest publish has waited for
+ * #AGENT_COALESCE_WINDOW_MS. A QoS 0 publish thus completes once buffered. If
+ * the held packets cannot be sent within #AGENT_COALESCE_SEND_TIMEOUT_MS, the
+ * connection is shut down, and the sends and receives of the agent fail until
+ * #Agent_SetNetworkSocket sets the socket of a new connection.
+ *
+ * @note Call this function before MQTTAgent_Init(), with the transport then
+ * passed to MQTTAgent_Init(). Only the agent may send on the transport.
+ *
+ * @param[in] pMsgCtx Message context of the agent.
+ * @param[in,out] pTransport Transport of the connection, which is replaced by
+ * one coalescing its sends through @p pMsgCtx.
+ * @param[in] pBuffer Buffer holding the coalesced packets.
+ * @param[in] bufferSize Size of @p pBuffer. Larger packets are not coalesced.
+ */
+    void Agent_EnableCoalescing( MQTTAgentMessageContext_t * pMsgCtx,
+                                 TransportInterface_t * pTransport,
+                                 uint8_t * pBuffer,
+                                 size_t bufferSize );
+#endif
+
+#if ( AGENT_LATENCY_TRACING == 1 )
+
+/**
+ * @brief Timestamp the first network send of each command processed by the
+ * agent of a message context, for the processing and acknowledgment stages of
+ * the latency histograms.
+ *
+ * The other points of the life of a command are timestamped without it.
+ *
+ * @note Call this function before MQTTAgent_Init(), with the transport then
+ * passed to MQTTAgent_Init(), and after #Agent_EnableCoalescing if
+ * coalescing is enabled.
+ *
+ * @param[in] pMsgCtx Message context of the agent.
+ * @param[in,out] pTransport Transport of the connection, which is replaced by
+ * one timestamping its sends through @p pMsgCtx.
+ */
+    void Agent_EnableLatencyTracing( MQTTAgentMessageContext_t * pMsgCtx,
+                                     TransportInterface_t * pTransport );
+#endif
+
+/**
+ * @brief Usage statistics of the command pool.
+ */
+typedef struct AgentPoolStats
+{
+    uint32_t poolSize;           /**< @brief Number of structures in the pool. */
+    uint32_t inUse;              /**< @brief Structures currently obtained and not freed. */
+    uint32_t peakInUse;          /**< @brief Highest value of #AgentPoolStats_t.inUse. */
+    uint32_t allocationFailures; /**< @brief Calls to #Agent_GetCommand that returned NULL. */
+} AgentPoolStats_t;
+
 /**
  * @brief Send a message to the specified context.
  * Must be thread safe.
  *
+ * The command is queued in the lane chosen by the classifier of the context.
+ *
  * @param[in] pMsgCtx An #MQTTAgentMessageContext_t.
  * @param[in] pCommandToSend Pointer to address to send to queue.
  * @param[in] blockTimeMs Block time to wait for a send.
@@ -57,6 +360,18 @@ bool Agent_MessageSend( MQTTAgentMessageContext_t * pMsgCtx,
  * @brief Receive a message from the specified context.
  * Must be thread safe.
  *
+ * The command is taken from the highest-priority lane holding one, unless a
+ * lower lane has waited for #AGENT_STARVATION_LIMIT commands.
+ *
+ * Up to #AGENT_RECEIVE_BATCH_SIZE commands of one lane are taken at once,
+ * as with #Agent_MessageReceiveBatch, and the following calls return them
+ * without blocking or polling, in the order they were sent. A command sent
+ * meanwhile to a higher lane is received before the rest of them, unless
+ * they were passed over for #AGENT_STARVATION_LIMIT commands.
+ *
+ * @note When #AGENT_RECEIVE_BATCH_SIZE is above 1, only one thread, the agent,
+ * may receive from a context.
+ *
  * @param[in] pMsgCtx An #MQTTAgentMessageContext_t.
  * @param[in] pReceivedCommand Pointer to write address of received command.
  * @param[in] blockTimeMs Block time to wait for a receive.
@@ -67,6 +382,28 @@ bool Agent_MessageReceive( MQTTAgentMessageContext_t * pMsgCtx,
                            MQTTAgentCommand_t ** pReceivedCommand,
                            uint32_t blockTimeMs );
 
+/**
+ * @brief Receive up to @p maxCommands messages from the specified context.
+ * Must be thread safe.
+ *
+ * Waits as #Agent_MessageReceive does for a first command, then takes the
+ * commands already queued behind it in its lane, without waiting any longer.
+ * It stops early if a higher lane gets a command, so that a batch never holds
+ * up a command of higher priority.
+ *
+ * @param[in] pMsgCtx An #MQTTAgentMessageContext_t.
+ * @param[out] pReceivedCommands Array of @p maxCommands command addresses.
+ * @param[in] maxCommands Maximum number of commands to receive.
+ * @param[in] blockTimeMs Block time to wait for the first command.
+ *
+ * @return Number of commands received, 0 on timeout or if data arrived on the
+ * socket of the context.
+ */
+uint32_t Agent_MessageReceiveBatch( MQTTAgentMessageContext_t * pMsgCtx,
+                                    MQTTAgentCommand_t ** pReceivedCommands,
+                                    uint32_t maxCommands,
+                                    uint32_t blockTimeMs );
+
 /**
  * @brief Initialize the common task pool. Not thread safe, but only called on one thread.
  */
@@ -80,6 +417,9 @@ void Agent_InitializePool( void );
  * SUBSCRIBE. The MQTTAgentCommand_t structure must persist for the duration of the command's
  * operation.
  *
+ * A free structure is claimed with atomic operations, without a kernel call,
+ * so this function may be called from an ISR with a @p blockTimeMs of 0.
+ *
  * @param[in] blockTimeMs The length of time the calling task should remain in the
  * Blocked state (so not consuming any CPU time) to wait for a MQTTAgentCommand_t structure to
  * become available should one not be immediately at the time of the call.
@@ -101,8 +441,17 @@ MQTTAgentCommand_t * Agent_GetCommand( uint32_t blockTimeMs );
  * The structure must first have been obtained by calling Agent_GetCommand(), otherwise
  * Agent_ReleaseCommand() will have no effect.
  *
+ * @note This function may be called from an ISR.
+ *
  * @return true if the MQTTAgentCommand_t structure was freed, otherwise false.
  */
 bool Agent_FreeCommand( MQTTAgentCommand_t * pCommandToRelease );
 
+/**
+ * @brief Read the usage statistics of the command pool.
+ *
+ * @param[out] pStats The statistics.
+ */
+void Agent_GetPoolStats( AgentPoolStats_t * pStats );
+
 #endif /* ifndef AGENT_INTERFACE_ZEPHYR_H_ */
@@ -0,0 +1,184 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file agent_latency_zephyr.h
+ * @brief Optional latency histograms of the commands of the MQTT agent.
+ *
+ * The agent interface timestamps each command of its pool when it is
+ * requested and allocated with Agent_GetCommand(), queued with
+ * Agent_MessageSend(), handed to the agent by Agent_MessageReceive(), first
+ * sent to the network, and freed by the agent once its completion callback
+ * returned. The durations between these points are added to histograms kept
+ * per command type, for the commands the agent received.
+ *
+ * Timestamps come from k_cycle_get_32, so a duration longer than the period of
+ * the cycle counter is mismeasured.
+ */
+
+#ifndef AGENT_LATENCY_ZEPHYR_H_
+#define AGENT_LATENCY_ZEPHYR_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* coreMQTT Agent includes. */
+#include "core_mqtt_agent.h"
+
+/**
+ * @brief Set to 1 to trace the latency of the agent commands, as with
+ * CONFIG_AWS_IOT_MQTT_AGENT_LATENCY_TRACING when the Kconfig options of the
+ * agent are used. With the default of 0, the histograms stay zero and tracing
+ * costs nothing.
+ */
+#ifndef AGENT_LATENCY_TRACING
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_LATENCY_TRACING )
+        #define AGENT_LATENCY_TRACING    ( 1 )
+    #else
+        #define AGENT_LATENCY_TRACING    ( 0 )
+    #endif
+#endif
+
+/**
+ * @brief Number of buckets of a latency histogram.
+ */
+#ifndef AGENT_LATENCY_HISTOGRAM_BUCKETS
+    #define AGENT_LATENCY_HISTOGRAM_BUCKETS    ( 16U )
+#endif
+
+/**
+ * @brief Upper bound, in microseconds, of the first bucket of a latency
+ * histogram.
+ *
+ * Each following bucket doubles the bound, and the last one counts every
+ * longer duration. The defaults span 50 us to 1.6 s.
+ */
+#ifndef AGENT_LATENCY_HISTOGRAM_BASE_US
+    #define AGENT_LATENCY_HISTOGRAM_BASE_US    ( 50U )
+#endif
+
+/**
+ * @brief Points of the life of a command at which it is timestamped.
+ */
+typedef enum AgentLatencyPoint
+{
+    AGENT_LATENCY_POINT_REQUESTED = 0, /**< @brief Agent_GetCommand() was called. */
+    AGENT_LATENCY_POINT_ALLOCATED,     /**< @brief Agent_GetCommand() obtained a structure. */
+    AGENT_LATENCY_POINT_ENQUEUED,      /**< @brief Agent_MessageSend() started queueing the command. */
+    AGENT_LATENCY_POINT_DEQUEUED,      /**< @brief Agent_MessageReceive() handed the command to the agent. */
+    AGENT_LATENCY_POINT_SENT,          /**< @brief The agent first sent data to the network for the command. */
+    AGENT_LATENCY_POINT_COMPLETED,     /**< @brief The agent freed the command after its completion callback. */
+    AGENT_LATENCY_POINTS               /**< @brief Number of points. */
+} AgentLatencyPoint_t;
+
+/**
+ * @brief Stages of the life of a command, each with a histogram.
+ */
+typedef enum AgentLatencyStage
+{
+    AGENT_LATENCY_STAGE_POOL_WAIT = 0, /**< @brief Waiting for a free structure of the pool. */
+    AGENT_LATENCY_STAGE_QUEUE_WAIT,    /**< @brief Waiting in the queue of the agent, including for room in it. */
+    AGENT_LATENCY_STAGE_PROCESSING,    /**< @brief From the agent taking the command to its first network send. */
+    AGENT_LATENCY_STAGE_ACK_WAIT,      /**< @brief From the first network send to completion, such as waiting for a PUBACK. */
+    AGENT_LATENCY_STAGE_TOTAL,         /**< @brief From Agent_GetCommand() to completion. */
+    AGENT_LATENCY_STAGES               /**< @brief Number of stages. */
+} AgentLatencyStage_t;
+
+/**
+ * @brief Logarithmic histogram of the duration of a stage.
+ */
+typedef struct AgentLatencyHistogram
+{
+    uint32_t buckets[ AGENT_LATENCY_HISTOGRAM_BUCKETS ]; /**< @brief Number of commands per duration range. */
+    uint32_t count;                                      /**< @brief Number of commands. */
+    uint64_t totalUs;                                    /**< @brief Sum of the durations, in microseconds. */
+    uint32_t maxUs;                                      /**< @brief Longest duration, in microseconds. */
+} AgentLatencyHistogram_t;
+
+/**
+ * @brief Latency histograms of one command type.
+ */
+typedef struct AgentLatencyStats
+{
+    AgentLatencyHistogram_t stages[ AGENT_LATENCY_STAGES ]; /**< @brief Histogram of each #AgentLatencyStage_t. */
+} AgentLatencyStats_t;
+
+/**
+ * @brief Add the timestamps of a completed command to the histograms of its
+ * type.
+ *
+ * A stage is only accounted if both its points were stamped; for example, a
+ * command that sends nothing has no processing or acknowledgment stage.
+ *
+ * @note Called by the agent interface; this function may be called from an
+ * ISR.
+ *
+ * @param[in] commandType Type of the command.
+ * @param[in] pStamps Cycle counter at each #AgentLatencyPoint_t.
+ * @param[in] stampedPoints Bit mask of the points of @p pStamps that were
+ * stamped, with bit N for point N.
+ */
+void AgentLatency_Record( MQTTAgentCommandType_t commandType,
+                          const uint32_t * pStamps,
+                          uint32_t stampedPoints );
+
+/**
+ * @brief Copy the latency histograms of a command type, and optionally reset
+ * them.
+ *
+ * @param[in] commandType Type of the commands.
+ * @param[out] pStats Copy of the histograms. All zero when
+ * #AGENT_LATENCY_TRACING is 0.
+ * @param[in] reset Whether to reset the histograms once copied.
+ */
+void AgentLatency_GetStats( MQTTAgentCommandType_t commandType,
+                            AgentLatencyStats_t * pStats,
+                            bool reset );
+
+/**
+ * @brief Add a duration to a latency histogram.
+ *
+ * It lets applications keep histograms of their own durations, such as the
+ * round trip of a publish, in the buckets of the agent histograms.
+ *
+ * @note The caller serializes the updates of a histogram.
+ *
+ * @param[in,out] pHistogram The histogram.
+ * @param[in] elapsedUs The duration, in microseconds.
+ */
+void AgentLatency_AddSample( AgentLatencyHistogram_t * pHistogram,
+                             uint32_t elapsedUs );
+
+/**
+ * @brief Estimate a percentile of a latency histogram.
+ *
+ * @param[in] pHistogram The histogram.
+ * @param[in] percent Percentile, from 0 to 100.
+ *
+ * @return Upper bound in microseconds of the bucket holding the percentile,
+ * capped to the longest duration, or 0 for an empty histogram.
+ */
+uint32_t AgentLatency_PercentileUs( const AgentLatencyHistogram_t * pHistogram,
+                                    uint32_t percent );
+
+#endif /* ifndef AGENT_LATENCY_ZEPHYR_H_ */
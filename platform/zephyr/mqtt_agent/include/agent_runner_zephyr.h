@@ -0,0 +1,157 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file agent_runner_zephyr.h
+ * @brief Runs the MQTT agents of several broker connections on one thread.
+ *
+ * MQTTAgent_CommandLoop() only returns once its connection ends, so each
+ * agent would otherwise need a thread of its own. The runner instead waits
+ * on the sockets and command queues of all its connections at once, and
+ * gives a connection a turn while it has work: queued commands, received
+ * data, or a keep-alive to service. In a turn, the runner carries out the
+ * commands of the agent itself and runs the MQTT process loop, in which the
+ * agent completes the commands whose acknowledgment is received.
+ *
+ * Each turn of a connection is bounded by #AGENT_RUNNER_TURN_BUDGET, so a busy
+ * connection does not delay the others for long.
+ */
+#ifndef AGENT_RUNNER_ZEPHYR_H_
+#define AGENT_RUNNER_ZEPHYR_H_
+
+/* Kernel Header */
+#include <zephyr.h>
+
+/* Agent interface header */
+#include "agent_interface_zephyr.h"
+
+/**
+ * @brief Maximum number of connections served by the runner, set with
+ * CONFIG_AWS_IOT_MQTT_AGENT_RUNNER_CONNECTIONS when the Kconfig options of the
+ * agent are used.
+ */
+#ifndef AGENT_RUNNER_MAX_CONNECTIONS
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER_CONNECTIONS )
+        #define AGENT_RUNNER_MAX_CONNECTIONS    ( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER_CONNECTIONS )
+    #else
+        #define AGENT_RUNNER_MAX_CONNECTIONS    ( 3U )
+    #endif
+#endif
+
+/**
+ * @brief Maximum number of commands and MQTT process loop runs in one turn of
+ * a connection.
+ */
+#ifndef AGENT_RUNNER_TURN_BUDGET
+    #define AGENT_RUNNER_TURN_BUDGET    ( 8U )
+#endif
+
+/**
+ * @brief Longest time in milliseconds a connection waits for a turn while it
+ * is idle, so that its keep-alive is serviced.
+ *
+ * It must be well below the keep-alive interval of the connections.
+ */
+#ifndef AGENT_RUNNER_SERVICE_INTERVAL_MS
+    #define AGENT_RUNNER_SERVICE_INTERVAL_MS    ( 1000U )
+#endif
+
+/**
+ * @brief Function called on the runner thread when a connection ends: on a
+ * network error, a disconnect, or a call to MQTTAgent_Terminate().
+ *
+ * The connection is not served until #AgentRunner_ResumeConnection is called,
+ * and its commands wait in its queue. The function must not block, as other
+ * connections are not served until it returns: it may hand the reconnection
+ * over to another thread, as the thread of an agent would reconnect after
+ * MQTTAgent_CommandLoop() returns.
+ *
+ * @param[in] pAgentContext Agent of the connection.
+ * @param[in] loopStatus #MQTTSuccess after a disconnect or a terminate, else
+ * the status of the failed MQTT operation.
+ *
+ * @return `true` to keep the connection, to be resumed with
+ * #AgentRunner_ResumeConnection or removed with #AgentRunner_RemoveConnection,
+ * `false` to remove it from the runner.
+ */
+typedef bool ( * AgentRunnerLoopExitCallback_t )( MQTTAgentContext_t * pAgentContext,
+                                                  MQTTStatus_t loopStatus );
+
+/**
+ * @brief Initialize the runner. Call it once, before any other function of
+ * the runner.
+ */
+void AgentRunner_Init( void );
+
+/**
+ * @brief Serve the agent of a connection from the runner thread.
+ *
+ * The agent must have been initialized with a message context of
+ * agent_interface_zephyr.h, and its MQTT connection must be established. Its
+ * socket is waited on once set with #Agent_SetNetworkSocket. The runner
+ * carries out its commands, so MQTTAgent_CommandLoop() must not be called for
+ * it.
+ *
+ * @note This function may be called from any thread.
+ *
+ * @param[in] pAgentContext Agent of the connection.
+ * @param[in] loopExitCallback Called when the connection ends, or NULL to
+ * remove the connection then.
+ *
+ * @return `true` if the connection was added, `false` if
+ * #AGENT_RUNNER_MAX_CONNECTIONS connections are served already.
+ */
+bool AgentRunner_AddConnection( MQTTAgentContext_t * pAgentContext,
+                                AgentRunnerLoopExitCallback_t loopExitCallback );
+
+/**
+ * @brief Serve again a connection that ended, once it is re-established.
+ *
+ * @note This function may be called from any thread.
+ *
+ * @param[in] pAgentContext Agent of the connection.
+ *
+ * @return `true` if the connection is served again, `false` if the runner does
+ * not serve it.
+ */
+bool AgentRunner_ResumeConnection( MQTTAgentContext_t * pAgentContext );
+
+/**
+ * @brief Remove a connection that ended and could not be re-established.
+ *
+ * @note This function may be called from any thread.
+ *
+ * @param[in] pAgentContext Agent of the connection.
+ *
+ * @return `true` if the connection is removed, `false` if the runner does not
+ * hold it ended.
+ */
+bool AgentRunner_RemoveConnection( MQTTAgentContext_t * pAgentContext );
+
+/**
+ * @brief Serve the connections added to the runner on the calling thread.
+ *
+ * @return Once no connection is left to serve.
+ */
+void AgentRunner_Run( void );
+
+#endif /* ifndef AGENT_RUNNER_ZEPHYR_H_ */
@@ -0,0 +1,141 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file offline_queue.h
+ * @brief Keeps the publishes made while the MQTT connection is down in a flash
+ * ring log, and publishes them once it is back.
+ *
+ * Each publish is appended as one record of a flash circular buffer (FCB):
+ * its QoS, the length of its topic, its topic and its payload. The oldest
+ * sector is erased when the log is full, dropping its records. Once
+ * #OfflineQueue_SetConnected reports the connection up, records are read back
+ * in order and published through the agent in batches of
+ * #OFFLINE_QUEUE_DRAIN_BATCH, one batch every #OFFLINE_QUEUE_DRAIN_INTERVAL_MS.
+ * A batch is only released once every publish of it has completed, and it is
+ * published again otherwise. The last record released is then appended to the
+ * log as a commit record, from which the drain resumes after a restart.
+ * Records are thus published at least once; those of a batch that failed
+ * midway, or that was in flight when the device restarted, may be published
+ * twice.
+ */
+#ifndef OFFLINE_QUEUE_H
+#define OFFLINE_QUEUE_H
+
+/* Kernel Header */
+#include <zephyr.h>
+
+/* Zephyr flash map include. */
+#include <storage/flash_map.h>
+
+/* MQTT agent include. */
+#include "core_mqtt_agent.h"
+
+/**
+ * @brief Flash area holding the log.
+ */
+#ifndef OFFLINE_QUEUE_FLASH_AREA_ID
+    #define OFFLINE_QUEUE_FLASH_AREA_ID    FLASH_AREA_ID( storage )
+#endif
+
+/**
+ * @brief Maximum number of flash sectors of the log. The flash area may have
+ * fewer.
+ */
+#ifndef OFFLINE_QUEUE_MAX_SECTORS
+    #define OFFLINE_QUEUE_MAX_SECTORS    ( 8U )
+#endif
+
+/**
+ * @brief Size in bytes of the largest record, the topic and payload of a
+ * publish and 3 bytes of header. Each publish of a batch being drained holds a
+ * buffer of this size.
+ */
+#ifndef OFFLINE_QUEUE_MAX_RECORD_SIZE
+    #define OFFLINE_QUEUE_MAX_RECORD_SIZE    ( 512U )
+#endif
+
+/**
+ * @brief Number of records published at once, set with
+ * CONFIG_AWS_IOT_MQTT_AGENT_OFFLINE_QUEUE_DRAIN_BATCH when the Kconfig options
+ * of the agent are used.
+ */
+#ifndef OFFLINE_QUEUE_DRAIN_BATCH
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_OFFLINE_QUEUE_DRAIN_BATCH )
+        #define OFFLINE_QUEUE_DRAIN_BATCH    ( CONFIG_AWS_IOT_MQTT_AGENT_OFFLINE_QUEUE_DRAIN_BATCH )
+    #else
+        #define OFFLINE_QUEUE_DRAIN_BATCH    ( 4U )
+    #endif
+#endif
+
+/**
+ * @brief Delay in milliseconds between the completion of a batch and the
+ * publish of the next, set with
+ * CONFIG_AWS_IOT_MQTT_AGENT_OFFLINE_QUEUE_DRAIN_INTERVAL_MS when the Kconfig
+ * options of the agent are used. It bounds the rate at which the backlog
+ * competes with live traffic.
+ */
+#ifndef OFFLINE_QUEUE_DRAIN_INTERVAL_MS
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_OFFLINE_QUEUE_DRAIN_INTERVAL_MS )
+        #define OFFLINE_QUEUE_DRAIN_INTERVAL_MS    ( CONFIG_AWS_IOT_MQTT_AGENT_OFFLINE_QUEUE_DRAIN_INTERVAL_MS )
+    #else
+        #define OFFLINE_QUEUE_DRAIN_INTERVAL_MS    ( 100U )
+    #endif
+#endif
+
+/**
+ * @brief Open the log, whose records left by a previous run are kept.
+ *
+ * @param[in] pAgentContext Agent publishing the records.
+ *
+ * @return `true` if the log is usable, else `false`.
+ */
+bool OfflineQueue_Init( MQTTAgentContext_t * pAgentContext );
+
+/**
+ * @brief Append a publish to the log. The topic and payload are copied.
+ *
+ * @note This function may be called from any thread.
+ *
+ * @param[in] pPublishInfo The publish.
+ *
+ * @return `true` if the publish was written to flash, `false` if it is too
+ * large or flash failed.
+ */
+bool OfflineQueue_Store( const MQTTPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Report whether the MQTT connection is up. The log is drained, on the
+ * system work queue, while it is.
+ *
+ * @param[in] connected Whether the agent is connected to the broker.
+ */
+void OfflineQueue_SetConnected( bool connected );
+
+/**
+ * @brief Check whether the log holds records not yet acknowledged.
+ *
+ * @return `true` if no record is left to publish.
+ */
+bool OfflineQueue_IsEmpty( void );
+
+#endif /* ifndef OFFLINE_QUEUE_H */
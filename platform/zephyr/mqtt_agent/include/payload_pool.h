@@ -0,0 +1,204 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file payload_pool.h
+ * @brief Reference-counted publish payload buffers, released when the MQTT
+ * agent completes the publishes using them.
+ *
+ * The payload of a publish queued with MQTTAgent_Publish() must stay valid
+ * until the publish completes. A producer that builds each payload in a
+ * buffer of this pool and queues it with #PayloadPool_Publish does not have
+ * to wait for the completion before building the next one: the reference to
+ * the buffer is handed to the publish, and the buffer returns to the pool
+ * once the last publish using it completes.
+ *
+ * Buffers come in three size classes, each a k_mem_slab. Each buffer and each
+ * publish record can be allocated and released from any thread.
+ */
+#ifndef PAYLOAD_POOL_H
+#define PAYLOAD_POOL_H
+
+/* Kernel Header */
+#include <zephyr.h>
+
+/* coreMQTT Agent include. */
+#include "core_mqtt_agent.h"
+
+/**
+ * @brief Payload size in bytes of the buffers of the small class.
+ */
+#ifndef PAYLOAD_POOL_SMALL_SIZE
+    #define PAYLOAD_POOL_SMALL_SIZE    ( 64U )
+#endif
+
+/**
+ * @brief Payload size in bytes of the buffers of the medium class.
+ */
+#ifndef PAYLOAD_POOL_MEDIUM_SIZE
+    #define PAYLOAD_POOL_MEDIUM_SIZE    ( 256U )
+#endif
+
+/**
+ * @brief Payload size in bytes of the buffers of the large class.
+ */
+#ifndef PAYLOAD_POOL_LARGE_SIZE
+    #define PAYLOAD_POOL_LARGE_SIZE    ( 1024U )
+#endif
+
+/**
+ * @brief Number of buffers of the small class, set with
+ * CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL_SMALL_COUNT when the Kconfig options
+ * of the agent are used.
+ */
+#ifndef PAYLOAD_POOL_SMALL_COUNT
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL_SMALL_COUNT )
+        #define PAYLOAD_POOL_SMALL_COUNT    ( CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL_SMALL_COUNT )
+    #else
+        #define PAYLOAD_POOL_SMALL_COUNT    ( 16U )
+    #endif
+#endif
+
+/**
+ * @brief Number of buffers of the medium class, set with
+ * CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL_MEDIUM_COUNT when the Kconfig options
+ * of the agent are used.
+ */
+#ifndef PAYLOAD_POOL_MEDIUM_COUNT
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL_MEDIUM_COUNT )
+        #define PAYLOAD_POOL_MEDIUM_COUNT    ( CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL_MEDIUM_COUNT )
+    #else
+        #define PAYLOAD_POOL_MEDIUM_COUNT    ( 4U )
+    #endif
+#endif
+
+/**
+ * @brief Number of buffers of the large class, set with
+ * CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL_LARGE_COUNT when the Kconfig options
+ * of the agent are used.
+ */
+#ifndef PAYLOAD_POOL_LARGE_COUNT
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL_LARGE_COUNT )
+        #define PAYLOAD_POOL_LARGE_COUNT    ( CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL_LARGE_COUNT )
+    #else
+        #define PAYLOAD_POOL_LARGE_COUNT    ( 2U )
+    #endif
+#endif
+
+/**
+ * @brief Number of publishes of pool buffers that may be in flight at once.
+ * A buffer published to several topics counts once per publish.
+ */
+#ifndef PAYLOAD_POOL_MAX_PUBLISHES
+    #define PAYLOAD_POOL_MAX_PUBLISHES    ( PAYLOAD_POOL_SMALL_COUNT + PAYLOAD_POOL_MEDIUM_COUNT + PAYLOAD_POOL_LARGE_COUNT )
+#endif
+
+/**
+ * @brief Function called when a publish queued with #PayloadPool_Publish
+ * completes, before its reference to the payload buffer is released.
+ *
+ * @note It runs on the agent thread, and must not block.
+ *
+ * @param[in] pContext Context given to #PayloadPool_Publish.
+ * @param[in] pPublishInfo The publish, whose payload is still valid.
+ * @param[in] returnCode Result of the publish.
+ */
+typedef void ( * PayloadPublishCallback_t )( void * pContext,
+                                             const MQTTPublishInfo_t * pPublishInfo,
+                                             MQTTStatus_t returnCode );
+
+/**
+ * @brief Usage counters of the pool.
+ */
+typedef struct PayloadPoolStats
+{
+    uint32_t buffersInUse;       /**< @brief Buffers allocated and not returned, across the classes. */
+    uint32_t publishesInFlight;  /**< @brief Publishes queued and not completed. */
+    uint32_t allocationFailures; /**< @brief Calls to #PayloadPool_Alloc that returned NULL. */
+} PayloadPoolStats_t;
+
+/**
+ * @brief Allocate a payload buffer holding a reference for the caller.
+ *
+ * The buffer is taken from the smallest class that fits @p size and has a
+ * free buffer. If all such classes are exhausted, the call waits for a buffer
+ * of the smallest class that fits.
+ *
+ * @param[in] size Number of bytes needed.
+ * @param[in] blockTimeMs Time to wait for a free buffer; must be 0 in an ISR.
+ *
+ * @return The buffer, of at least @p size bytes, or NULL.
+ */
+uint8_t * PayloadPool_Alloc( size_t size,
+                             uint32_t blockTimeMs );
+
+/**
+ * @brief Take another reference to a payload buffer, such as before
+ * publishing it to another topic.
+ *
+ * @param[in] pBuffer A buffer of #PayloadPool_Alloc.
+ */
+void PayloadPool_Ref( uint8_t * pBuffer );
+
+/**
+ * @brief Release a reference to a payload buffer. The buffer returns to the
+ * pool when its last reference is released.
+ *
+ * @param[in] pBuffer A buffer of #PayloadPool_Alloc.
+ */
+void PayloadPool_Release( uint8_t * pBuffer );
+
+/**
+ * @brief Queue a publish of a pool buffer to the MQTT agent without waiting
+ * for it to complete.
+ *
+ * On success, the reference of the caller to the payload buffer is handed to
+ * the publish and released once it completes; the caller must not use the
+ * buffer any more unless it took another reference. On failure, the caller
+ * keeps its reference.
+ *
+ * @param[in] pAgentContext The agent.
+ * @param[in] pPublishInfo The publish, copied. Its payload must start in a
+ * buffer of #PayloadPool_Alloc, and its topic must stay valid until the
+ * publish completes.
+ * @param[in] blockTimeMs Time to wait for a publish record and for room in the
+ * queue of the agent.
+ * @param[in] callback Function called when the publish completes, or NULL.
+ * @param[in] pCallbackContext Context passed to @p callback.
+ *
+ * @return #MQTTSuccess if the publish was queued, #MQTTNoMemory if too many
+ * publishes are in flight, or the status of MQTTAgent_Publish().
+ */
+MQTTStatus_t PayloadPool_Publish( MQTTAgentContext_t * pAgentContext,
+                                  const MQTTPublishInfo_t * pPublishInfo,
+                                  uint32_t blockTimeMs,
+                                  PayloadPublishCallback_t callback,
+                                  void * pCallbackContext );
+
+/**
+ * @brief Read the usage counters of the pool.
+ *
+ * @param[out] pStats The counters.
+ */
+void PayloadPool_GetStats( PayloadPoolStats_t * pStats );
+
+#endif /* ifndef PAYLOAD_POOL_H */
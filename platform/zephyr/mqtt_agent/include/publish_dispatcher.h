@@ -0,0 +1,185 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file publish_dispatcher.h
+ * @brief Hands incoming publishes to worker threads, so that slow
+ * subscription callbacks do not stall the MQTT agent.
+ *
+ * When a publish matches subscriptions, its topic and payload are copied into
+ * a buffer of a small pool, which is leased to the callbacks of those
+ * subscriptions, which run on the workers. The buffer returns to the pool
+ * once the last callback returns. When the pool runs out, the agent waits up
+ * to #PUBLISH_DISPATCHER_WAIT_MS for the workers to return a buffer, then
+ * drops the publish, so that callbacks never run on the agent thread, where
+ * they would run ahead of the publishes waiting for the workers.
+ *
+ * The publish is copied because coreMQTT may reuse or move the content of its
+ * network buffer as soon as the incoming publish callback returns, so the
+ * dispatcher relies on no version-specific receive behavior of coreMQTT.
+ */
+#ifndef PUBLISH_DISPATCHER_H
+#define PUBLISH_DISPATCHER_H
+
+/* Kernel Header */
+#include <zephyr.h>
+
+/* core MQTT include. */
+#include "core_mqtt.h"
+
+/* Subscription manager header include. */
+#include "subscription_manager.h"
+
+/**
+ * @brief Number of worker threads running subscription callbacks, set with
+ * CONFIG_AWS_IOT_MQTT_AGENT_PUBLISH_DISPATCHER_WORKERS when the Kconfig
+ * options of the agent are used.
+ *
+ * The callbacks of a subscription always run on the same thread, in the order
+ * the publishes were received.
+ */
+#ifndef PUBLISH_DISPATCHER_WORKERS
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_PUBLISH_DISPATCHER_WORKERS )
+        #define PUBLISH_DISPATCHER_WORKERS    ( CONFIG_AWS_IOT_MQTT_AGENT_PUBLISH_DISPATCHER_WORKERS )
+    #else
+        #define PUBLISH_DISPATCHER_WORKERS    ( 1U )
+    #endif
+#endif
+
+/**
+ * @brief Number of buffers of the pool, one of which is the network buffer
+ * of the agent while the others are leased to callbacks, set with
+ * CONFIG_AWS_IOT_MQTT_AGENT_PUBLISH_DISPATCHER_BUFFERS when the Kconfig
+ * options of the agent are used.
+ */
+#ifndef PUBLISH_DISPATCHER_BUFFERS
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_PUBLISH_DISPATCHER_BUFFERS )
+        #define PUBLISH_DISPATCHER_BUFFERS    ( CONFIG_AWS_IOT_MQTT_AGENT_PUBLISH_DISPATCHER_BUFFERS )
+    #else
+        #define PUBLISH_DISPATCHER_BUFFERS    ( 3U )
+    #endif
+#endif
+
+/**
+ * @brief Size in bytes of each buffer of the pool, which must hold the
+ * largest packet received by the agent, as one of them is its network buffer.
+ */
+#ifndef PUBLISH_DISPATCHER_BUFFER_SIZE
+    #define PUBLISH_DISPATCHER_BUFFER_SIZE    ( 2048U )
+#endif
+
+/**
+ * @brief Maximum number of subscriptions to which a publish is dispatched,
+ * by default every subscription of the list. Publishes matching more
+ * subscriptions are dropped.
+ */
+#ifndef PUBLISH_DISPATCHER_MAX_MATCHES
+    #define PUBLISH_DISPATCHER_MAX_MATCHES    ( SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS )
+#endif
+
+/**
+ * @brief Number of callbacks that may wait for a worker at once.
+ */
+#ifndef PUBLISH_DISPATCHER_MAX_DELIVERIES
+    #define PUBLISH_DISPATCHER_MAX_DELIVERIES    ( PUBLISH_DISPATCHER_BUFFERS * PUBLISH_DISPATCHER_MAX_MATCHES )
+#endif
+
+/**
+ * @brief Time in milliseconds the agent waits for the workers to free a
+ * buffer and the callbacks of a publish before dropping it, set with
+ * CONFIG_AWS_IOT_MQTT_AGENT_PUBLISH_DISPATCHER_WAIT_MS when the Kconfig
+ * options of the agent are used.
+ *
+ * The wait is bounded in case a callback itself waits for the agent.
+ */
+#ifndef PUBLISH_DISPATCHER_WAIT_MS
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_PUBLISH_DISPATCHER_WAIT_MS )
+        #define PUBLISH_DISPATCHER_WAIT_MS    ( CONFIG_AWS_IOT_MQTT_AGENT_PUBLISH_DISPATCHER_WAIT_MS )
+    #else
+        #define PUBLISH_DISPATCHER_WAIT_MS    ( 100U )
+    #endif
+#endif
+
+/**
+ * @brief Stack size in bytes of each worker thread.
+ */
+#ifndef PUBLISH_DISPATCHER_STACK_SIZE
+    #define PUBLISH_DISPATCHER_STACK_SIZE    ( 2048U )
+#endif
+
+/**
+ * @brief Priority of the worker threads. It should be lower than the
+ * priority of the agent thread.
+ */
+#ifndef PUBLISH_DISPATCHER_PRIORITY
+    #define PUBLISH_DISPATCHER_PRIORITY    ( 5 )
+#endif
+
+/**
+ * @brief Counters of the dispatcher.
+ */
+typedef struct PublishDispatcherStats
+{
+    uint32_t dispatched;        /**< @brief Publishes whose callbacks ran on the workers. */
+    uint32_t dropped;           /**< @brief Matching publishes whose callbacks did not run. */
+    uint32_t buffersLeased;     /**< @brief Network buffers currently leased to callbacks. */
+    uint32_t peakBuffersLeased; /**< @brief Highest value of #PublishDispatcherStats_t.buffersLeased. */
+} PublishDispatcherStats_t;
+
+/**
+ * @brief Start the workers and get the first network buffer of the agent.
+ *
+ * @note Call this function once, before MQTTAgent_Init(), and pass it
+ * @p pNetworkBuffer.
+ *
+ * @param[out] pNetworkBuffer The network buffer to give to the agent.
+ */
+void PublishDispatcher_Init( MQTTFixedBuffer_t * pNetworkBuffer );
+
+/**
+ * @brief Hand an incoming publish to the callbacks of the subscriptions it
+ * matches. Call it from the incoming publish callback of the agent instead of
+ * #handleIncomingPublishes.
+ *
+ * @note A callback may run after its subscription was removed if the publish
+ * was dispatched before.
+ *
+ * @note This may block the agent for up to #PUBLISH_DISPATCHER_WAIT_MS while
+ * the workers are behind.
+ *
+ * @param[in] pSubscriptionList The pointer to the subscription list array.
+ * @param[in] pPublishInfo Info of the incoming publish.
+ *
+ * @return `true` if the publish matched a subscription, even if it was
+ * dropped; `false` otherwise.
+ */
+bool PublishDispatcher_Dispatch( SubscriptionElement_t * pSubscriptionList,
+                                 MQTTPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Read the counters of the dispatcher.
+ *
+ * @param[out] pStats The counters.
+ */
+void PublishDispatcher_GetStats( PublishDispatcherStats_t * pStats );
+
+#endif /* PUBLISH_DISPATCHER_H */
@@ -0,0 +1,116 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file resubscribe.h
+ * @brief Restores the subscriptions of a subscription list after the broker
+ * lost the session, with as few SUBSCRIBE packets as possible.
+ *
+ * The distinct topic filters of the list are packed into SUBSCRIBE packets of
+ * at most the size of the network buffer of the agent. Up to
+ * #RESUBSCRIBE_MAX_PACKETS packets are queued to the agent at once, which
+ * sends each without waiting for the SUBACK of the previous one; the next
+ * packet is queued as each SUBACK arrives.
+ */
+#ifndef RESUBSCRIBE_H
+#define RESUBSCRIBE_H
+
+/* Kernel Header */
+#include <zephyr.h>
+
+/* MQTT agent include. */
+#include "core_mqtt_agent.h"
+
+/* Subscription manager header include. */
+#include "subscription_manager.h"
+
+/**
+ * @brief Maximum number of SUBSCRIBE packets awaiting their SUBACK.
+ *
+ * It must not exceed the free space of the command queue of the agent, nor
+ * its MQTT_AGENT_MAX_OUTSTANDING_ACKS.
+ */
+#ifndef RESUBSCRIBE_MAX_PACKETS
+    #define RESUBSCRIBE_MAX_PACKETS    ( 4U )
+#endif
+
+/**
+ * @brief Function called with the SUBACK result of each topic filter.
+ *
+ * It runs on the agent thread, and may remove the subscription with
+ * removeSubscription().
+ *
+ * @param[in] pContext Context given to #Resubscribe_Start.
+ * @param[in] pSubscription First element of the subscription list holding the
+ * topic filter.
+ * @param[in] subackStatus Result of the filter; #MQTTSubAckFailure if the
+ * SUBSCRIBE could not be sent, or if the connection ended before its SUBACK.
+ */
+typedef void ( * ResubscribeFilterCallback_t )( void * pContext,
+                                                const SubscriptionElement_t * pSubscription,
+                                                MQTTSubAckStatus_t subackStatus );
+
+/**
+ * @brief Function called on the agent thread once every topic filter has its
+ * result.
+ *
+ * @param[in] pContext Context given to #Resubscribe_Start.
+ * @param[in] failedCount Number of topic filters that were refused or could
+ * not be subscribed.
+ */
+typedef void ( * ResubscribeDoneCallback_t )( void * pContext,
+                                              size_t failedCount );
+
+/**
+ * @brief Subscribe again to the distinct topic filters of a subscription list.
+ *
+ * Results of a previous call whose SUBACKs are still awaited are dropped.
+ *
+ * @note Call this function on the agent thread, or before the agent runs,
+ * such as after MQTTAgent_ResumeSession(). The subscription list may only
+ * change from the callbacks until the done callback is called. Until then,
+ * and until the packets of previous calls are sent, the filters of the list
+ * are held with holdSubscriptionFilters(), so the ones removed meanwhile do
+ * not free their arena space before that.
+ *
+ * @param[in] pAgentContext The agent.
+ * @param[in] pSubscriptionList The subscription list.
+ * @param[in] qos QoS of the subscriptions.
+ * @param[in] maxPacketSize Size of the network buffer of the agent, which
+ * bounds the size of each SUBSCRIBE packet.
+ * @param[in] filterCallback Called with the result of each filter, or NULL.
+ * @param[in] doneCallback Called once all the results are known, or NULL.
+ * @param[in] pContext Passed to the callbacks.
+ *
+ * @return #MQTTSuccess if the first packets were queued, or if the list is
+ * empty, in which case the done callback was called already; else the error
+ * of MQTTAgent_Subscribe().
+ */
+MQTTStatus_t Resubscribe_Start( MQTTAgentContext_t * pAgentContext,
+                                const SubscriptionElement_t * pSubscriptionList,
+                                MQTTQoS_t qos,
+                                size_t maxPacketSize,
+                                ResubscribeFilterCallback_t filterCallback,
+                                ResubscribeDoneCallback_t doneCallback,
+                                void * pContext );
+
+#endif /* ifndef RESUBSCRIBE_H */
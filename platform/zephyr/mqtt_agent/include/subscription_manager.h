@@ -61,6 +61,76 @@
     #define SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS    10U
 #endif
 
+/**
+ * @brief Set to 1 for subscription_manager.c to copy the topic filters of the
+ * subscriptions into an arena, set with
+ * CONFIG_AWS_IOT_MQTT_AGENT_SUBSCRIPTION_FILTER_ARENA when the Kconfig options
+ * of the agent are used.
+ *
+ * The filters are packed one after the other, and their lengths and hashes
+ * are kept in separate arrays, so that an incoming publish is compared with
+ * the full filter only when their lengths and hashes match, or when the filter
+ * holds a wildcard.
+ */
+#ifndef SUBSCRIPTION_MANAGER_COPY_FILTERS
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_SUBSCRIPTION_FILTER_ARENA )
+        #define SUBSCRIPTION_MANAGER_COPY_FILTERS    1
+    #else
+        #define SUBSCRIPTION_MANAGER_COPY_FILTERS    0
+    #endif
+#endif
+
+/**
+ * @brief Size in bytes of the arena holding the topic filters of all the
+ * subscriptions with #SUBSCRIPTION_MANAGER_COPY_FILTERS.
+ */
+#ifndef SUBSCRIPTION_MANAGER_ARENA_SIZE
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_SUBSCRIPTION_ARENA_SIZE )
+        #define SUBSCRIPTION_MANAGER_ARENA_SIZE    ( CONFIG_AWS_IOT_MQTT_AGENT_SUBSCRIPTION_ARENA_SIZE )
+    #else
+        #define SUBSCRIPTION_MANAGER_ARENA_SIZE    ( SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS * 64U )
+    #endif
+#endif
+
+/**
+ * @brief Number of nodes of the topic trie of subscription_trie.c, each
+ * holding one level of a topic filter. Filters share the nodes of their
+ * common leading levels.
+ *
+ * subscription_trie.c implements this interface in place of
+ * subscription_manager.c when CONFIG_AWS_IOT_MQTT_AGENT_SUBSCRIPTION_TRIE is
+ * set. The trie is walked one topic level at a time, so the cost of matching
+ * an incoming publish grows with the depth of its topic rather than with the
+ * number of subscriptions.
+ */
+#ifndef SUBSCRIPTION_TRIE_MAX_NODES
+    #define SUBSCRIPTION_TRIE_MAX_NODES    ( SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS * 4U )
+#endif
+
+/**
+ * @brief Maximum number of levels of a topic filter added to the topic trie of
+ * subscription_trie.c.
+ */
+#ifndef SUBSCRIPTION_TRIE_MAX_LEVELS
+    #define SUBSCRIPTION_TRIE_MAX_LEVELS    ( 8U )
+#endif
+
+/**
+ * @brief Number of subscription lists that subscription_trie.c can index, each
+ * in a trie of its own of #SUBSCRIPTION_TRIE_MAX_NODES nodes.
+ *
+ * A list takes a trie on first use and keeps it. The default allows one list
+ * per connection of the agent runner, when CONFIG_AWS_IOT_MQTT_AGENT_RUNNER is
+ * enabled, and a single list otherwise.
+ */
+#ifndef SUBSCRIPTION_TRIE_MAX_LISTS
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER_CONNECTIONS )
+        #define SUBSCRIPTION_TRIE_MAX_LISTS    ( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER_CONNECTIONS )
+    #else
+        #define SUBSCRIPTION_TRIE_MAX_LISTS    ( 1U )
+    #endif
+#endif
+
 /**
  * @brief Callback function called when receiving a publish.
  *
@@ -76,11 +146,21 @@ typedef void (* IncomingPubCallback_t )( void * pIncomingPublishCallbackContext,
  * This subscription manager implementation expects that the array of the
  * subscription elements used for storing subscriptions to be initialized to 0.
  *
+ * @note With subscription_trie.c, up to #SUBSCRIPTION_TRIE_MAX_LISTS
+ * subscription lists may be used, since the topic tries indexing them are
+ * statically allocated.
+ *
+ * @note With #SUBSCRIPTION_MANAGER_COPY_FILTERS, a single subscription list may
+ * be used as well, and #SubscriptionElement_t.pSubscriptionFilterString points
+ * into the arena, where the filters move when a subscription is removed,
+ * unless they are held by #holdSubscriptionFilters.
+ *
  * @note This implementation allows multiple tasks to subscribe to the same topic.
  * In this case, another element is added to the subscription list, differing
- * in the intended publish callback. Also note that the topic filters are not
- * copied in the subscription manager and hence the topic filter strings need to
- * stay in scope until unsubscribed.
+ * in the intended publish callback. Also note that, unless
+ * #SUBSCRIPTION_MANAGER_COPY_FILTERS is set, the topic filters are not copied in
+ * the subscription manager and hence the topic filter strings need to stay in
+ * scope until unsubscribed.
  */
 typedef struct subscriptionElement
 {
@@ -103,7 +183,9 @@ typedef struct subscriptionElement
  * @param[in] incomingPublishCallback Callback function for the subscription.
  * @param[in] pIncomingPublishCallbackContext Context for the subscription callback.
  *
- * @return `true` if subscription added or exists, `false` if insufficient memory.
+ * @return `true` if subscription added or exists, `false` if insufficient memory
+ * or, with subscription_trie.c, if the topic filter is invalid. With
+ * #SUBSCRIPTION_MANAGER_COPY_FILTERS, memory includes space in the arena.
  */
 bool addSubscription( SubscriptionElement_t * pSubscriptionList,
                       const char * pTopicFilterString,
@@ -125,6 +207,25 @@ void removeSubscription( SubscriptionElement_t * pSubscriptionList,
                          const char * pTopicFilterString,
                          uint16_t topicFilterLength );
 
+/**
+ * @brief Keep the topic filters of the subscriptions where they are, until
+ * #releaseSubscriptionFilters is called, while pointers to them are used
+ * outside the subscription list, such as by queued SUBSCRIBE packets.
+ *
+ * Holds may nest. Without #SUBSCRIPTION_MANAGER_COPY_FILTERS, the filters
+ * never move and this does nothing.
+ *
+ * @note The arena bytes of the subscriptions removed while held are only
+ * reclaimed when the last hold is released.
+ */
+void holdSubscriptionFilters( void );
+
+/**
+ * @brief Release a hold taken by #holdSubscriptionFilters, packing the
+ * filter arena when it was the last one.
+ */
+void releaseSubscriptionFilters( void );
+
 /**
  * @brief Handle incoming publishes by invoking the callbacks registered
  * for the incoming publish's topic filter.
@@ -138,4 +239,21 @@ void removeSubscription( SubscriptionElement_t * pSubscriptionList,
 bool handleIncomingPublishes( SubscriptionElement_t * pSubscriptionList,
                               MQTTPublishInfo_t * pPublishInfo );
 
+/**
+ * @brief Find the subscriptions whose topic filter matches an incoming
+ * publish, without invoking their callbacks.
+ *
+ * @param[in] pSubscriptionList  The pointer to the subscription list array.
+ * @param[in] pPublishInfo Info of incoming publish.
+ * @param[out] ppMatches Array receiving the first @p maxMatches matching
+ * subscriptions.
+ * @param[in] maxMatches Number of entries of @p ppMatches.
+ *
+ * @return Number of matching subscriptions, which may exceed @p maxMatches.
+ */
+size_t findMatchingSubscriptions( SubscriptionElement_t * pSubscriptionList,
+                                  MQTTPublishInfo_t * pPublishInfo,
+                                  const SubscriptionElement_t ** ppMatches,
+                                  size_t maxMatches );
+
 #endif /* SUBSCRIPTION_MANAGER_H */
@@ -0,0 +1,170 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file thread_profiler_zephyr.h
+ * @brief Optional stack and CPU profiles of the threads created by the SDK.
+ *
+ * The threads of the MQTT agent, of its publish dispatcher and of the demos
+ * are registered with ThreadProfiler_Register(). Once ThreadProfiler_Start()
+ * was called, the system work queue samples each of them every
+ * #THREAD_PROFILER_PERIOD_MS: the peak number of bytes of its stack ever
+ * used, from k_thread_stack_space_get(), and its share of the CPU during the
+ * period, from k_thread_runtime_stats_get(). The profiles are printed by the
+ * "sdk_threads" shell command, and handed to a callback after each sample,
+ * for example to publish them with ThreadProfiler_Serialize() to a
+ * diagnostics topic.
+ *
+ * The stack peaks need CONFIG_INIT_STACKS and CONFIG_THREAD_STACK_INFO, and
+ * the CPU shares CONFIG_THREAD_RUNTIME_STATS, which
+ * CONFIG_AWS_IOT_MQTT_AGENT_THREAD_PROFILER selects.
+ */
+
+#ifndef THREAD_PROFILER_ZEPHYR_H_
+#define THREAD_PROFILER_ZEPHYR_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Kernel includes. */
+#include <zephyr.h>
+
+/**
+ * @brief Set to 1 to profile the registered threads, as with
+ * CONFIG_AWS_IOT_MQTT_AGENT_THREAD_PROFILER when the Kconfig options of the
+ * agent are used. With the default of 0, registering a thread does nothing.
+ */
+#ifndef THREAD_PROFILING
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_THREAD_PROFILER )
+        #define THREAD_PROFILING    ( 1 )
+    #else
+        #define THREAD_PROFILING    ( 0 )
+    #endif
+#endif
+
+/**
+ * @brief Maximum number of registered threads, set with
+ * CONFIG_AWS_IOT_MQTT_AGENT_THREAD_PROFILER_MAX_THREADS when the Kconfig
+ * options of the agent are used.
+ */
+#ifndef THREAD_PROFILER_MAX_THREADS
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_THREAD_PROFILER_MAX_THREADS )
+        #define THREAD_PROFILER_MAX_THREADS    ( CONFIG_AWS_IOT_MQTT_AGENT_THREAD_PROFILER_MAX_THREADS )
+    #else
+        #define THREAD_PROFILER_MAX_THREADS    ( 8U )
+    #endif
+#endif
+
+/**
+ * @brief Time in milliseconds between two samples, set with
+ * CONFIG_AWS_IOT_MQTT_AGENT_THREAD_PROFILER_PERIOD_MS when the Kconfig
+ * options of the agent are used.
+ */
+#ifndef THREAD_PROFILER_PERIOD_MS
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_THREAD_PROFILER_PERIOD_MS )
+        #define THREAD_PROFILER_PERIOD_MS    ( CONFIG_AWS_IOT_MQTT_AGENT_THREAD_PROFILER_PERIOD_MS )
+    #else
+        #define THREAD_PROFILER_PERIOD_MS    ( 10000U )
+    #endif
+#endif
+
+/**
+ * @brief Profile of a registered thread.
+ */
+typedef struct ThreadProfile
+{
+    const char * pName;       /**< @brief Name given to ThreadProfiler_Register(). */
+    size_t stackSize;         /**< @brief Size of the stack of the thread. */
+    size_t stackPeak;         /**< @brief Most bytes of the stack ever used, or 0 if unknown. */
+    uint64_t cycles;          /**< @brief Cycles the thread has run for since it was created. */
+    uint32_t cpuPermille;     /**< @brief Share of the CPU used during the last period, in thousandths. */
+    uint32_t peakCpuPermille; /**< @brief Largest #ThreadProfile_t.cpuPermille since the last reset. */
+} ThreadProfile_t;
+
+/**
+ * @brief Function called on the system work queue after each sample.
+ *
+ * @param[in] pProfiles The profiles of the registered threads.
+ * @param[in] count Number of profiles in @p pProfiles.
+ * @param[in] pContext Context given to ThreadProfiler_Start().
+ */
+typedef void ( * ThreadProfilerCallback_t )( const ThreadProfile_t * pProfiles,
+                                             size_t count,
+                                             void * pContext );
+
+/**
+ * @brief Register a thread to profile.
+ *
+ * Registering a thread again, for example once it is created again in the same
+ * struct k_thread, renames it and restarts its CPU accounting.
+ *
+ * @param[in] pThread The thread, which must stay allocated.
+ * @param[in] pName Name of the thread in the profiles. It must stay valid, so
+ * it is usually a string literal.
+ */
+void ThreadProfiler_Register( struct k_thread * pThread,
+                              const char * pName );
+
+/**
+ * @brief Start sampling the registered threads every
+ * #THREAD_PROFILER_PERIOD_MS. Calling it again replaces the callback.
+ *
+ * @param[in] callback Function called after each sample, or NULL.
+ * @param[in] pContext Context passed to @p callback.
+ */
+void ThreadProfiler_Start( ThreadProfilerCallback_t callback,
+                           void * pContext );
+
+/**
+ * @brief Copy the profiles of the last sample, and optionally reset their CPU
+ * peaks.
+ *
+ * @param[out] pProfiles Array receiving the profiles.
+ * @param[in] maxProfiles Number of entries of @p pProfiles.
+ * @param[in] reset Whether to reset the CPU peaks once copied.
+ *
+ * @return Number of profiles copied. Always 0 when #THREAD_PROFILING is 0.
+ */
+size_t ThreadProfiler_GetProfiles( ThreadProfile_t * pProfiles,
+                                   size_t maxProfiles,
+                                   bool reset );
+
+/**
+ * @brief Write profiles as a JSON document, such as:
+ * {"threads":[{"name":"agent","stack":4096,"stackPeak":2712,"cpu":153,"cpuPeak":410}]}
+ * with the CPU shares in thousandths.
+ *
+ * @param[in] pProfiles The profiles.
+ * @param[in] count Number of profiles in @p pProfiles.
+ * @param[out] pBuffer Buffer receiving the document, terminated.
+ * @param[in] bufferSize Size of @p pBuffer.
+ *
+ * @return Length of the document, or 0 if it does not fit in @p pBuffer.
+ */
+size_t ThreadProfiler_Serialize( const ThreadProfile_t * pProfiles,
+                                 size_t count,
+                                 char * pBuffer,
+                                 size_t bufferSize );
+
+#endif /* ifndef THREAD_PROFILER_ZEPHYR_H_ */
@@ -23,7 +23,13 @@
 /* Standard includes. */
 #include <stdlib.h>
 #include <assert.h>
+#include <errno.h>
 #include <stdbool.h>
+#include <string.h>
+
+/* Zephyr includes. */
+#include <net/socket.h>
+#include <posix/sys/eventfd.h>
 
 /* Agent interface header */
 #include "agent_interface_zephyr.h"
@@ -31,12 +37,31 @@
 /*-----------------------------------------------------------*/
 
 /**
- * @brief The number of structures to allocate in the command pool.
+ * @brief The number of structures to allocate in the command pool, set with
+ * CONFIG_AWS_IOT_MQTT_AGENT_COMMAND_POOL_SIZE when the Kconfig options of the
+ * agent are used.
  */
 #ifndef NUM_COMMANDS_IN_POOL
-    #define NUM_COMMANDS_IN_POOL    ( 10U )
+    #if defined( CONFIG_AWS_IOT_MQTT_AGENT_COMMAND_POOL_SIZE )
+        #define NUM_COMMANDS_IN_POOL    ( CONFIG_AWS_IOT_MQTT_AGENT_COMMAND_POOL_SIZE )
+    #else
+        #define NUM_COMMANDS_IN_POOL    ( 10U )
+    #endif
 #endif
 
+/**
+ * @brief Number of structures tracked by each word of #commandPoolBitmap.
+ *
+ * Only the low 32 bits of an atomic_t are used, which is its size on every
+ * 32-bit target.
+ */
+#define COMMAND_POOL_BITS_PER_WORD    ( 32U )
+
+/**
+ * @brief Number of words in #commandPoolBitmap.
+ */
+#define COMMAND_POOL_WORDS            ( ( NUM_COMMANDS_IN_POOL + COMMAND_POOL_BITS_PER_WORD - 1U ) / COMMAND_POOL_BITS_PER_WORD )
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -47,28 +72,1006 @@
 static MQTTAgentCommand_t commandStructurePool[ NUM_COMMANDS_IN_POOL ];
 
 /**
- * @brief Statically create a message queue to handle the command structures.
- * The message queue is used for managing the memory blocks of command objects in the
- * command pool in a thread-safe manner.
+ * @brief Allocation bitmap of #commandStructurePool, with a bit set for each
+ * structure in use.
+ *
+ * Structures are allocated and freed with atomic operations on the bitmap, so
+ * neither path makes a kernel call, and both can run in an ISR.
+ */
+static atomic_t commandPoolBitmap[ COMMAND_POOL_WORDS ];
+
+/**
+ * @brief Number of structures in use.
+ */
+static atomic_t commandsInUse;
+
+/**
+ * @brief Highest value of #commandsInUse.
+ */
+static atomic_t peakCommandsInUse;
+
+/**
+ * @brief Number of calls to #Agent_GetCommand that returned NULL.
+ */
+static atomic_t commandAllocationFailures;
+
+/**
+ * @brief Number of threads blocked in #Agent_GetCommand.
+ */
+static atomic_t commandWaiters;
+
+/**
+ * @brief Semaphore given when a structure is freed while a thread waits for
+ * one.
+ */
+K_SEM_DEFINE( commandFreedSemaphore, 0, NUM_COMMANDS_IN_POOL );
+
+/**
+ * @brief Initialization status of the pool.
+ */
+static volatile uint8_t poolInit = false;
+
+#if ( AGENT_LATENCY_TRACING == 1 )
+
+/**
+ * @brief Timestamps of a command of the pool.
+ */
+    typedef struct AgentCommandTrace
+    {
+        uint32_t stamps[ AGENT_LATENCY_POINTS ]; /**< @brief Cycle counter at each #AgentLatencyPoint_t. */
+        uint32_t stampedPoints;                  /**< @brief Bit mask of the points stamped. */
+    } AgentCommandTrace_t;
+
+/**
+ * @brief Timestamps of each structure of #commandStructurePool.
+ *
+ * A command is handed from thread to thread through the queues of the agent,
+ * so its timestamps are never written concurrently.
+ */
+    static AgentCommandTrace_t commandTraces[ NUM_COMMANDS_IN_POOL ];
+#endif
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Claim a free structure of the pool without blocking.
+ *
+ * @return A structure, or NULL if all are in use.
+ */
+static MQTTAgentCommand_t * allocateCommand( void );
+
+/**
+ * @brief Take a queued command, from the lane due to be served.
+ *
+ * @param[in] pMsgCtx An #MQTTAgentMessageContext_t.
+ * @param[out] pReceivedCommand Pointer to write address of received command.
+ * @param[out] pLane Lane of the received command.
+ * @param[in] timeout Maximum time to wait for a command.
+ *
+ * @return `true` if a command was received, else `false`.
+ */
+static bool dequeueCommand( MQTTAgentMessageContext_t * pMsgCtx,
+                            MQTTAgentCommand_t ** pReceivedCommand,
+                            uint32_t * pLane,
+                            k_timeout_t timeout );
+
+/**
+ * @brief Take a queued command from a given lane, unless a higher lane holds
+ * one. Does not wait.
+ *
+ * @param[in] pMsgCtx An #MQTTAgentMessageContext_t.
+ * @param[in] lane The lane.
+ * @param[out] pReceivedCommand Pointer to write address of received command.
+ *
+ * @return `true` if a command was received, else `false`.
+ */
+static bool dequeueFromLane( MQTTAgentMessageContext_t * pMsgCtx,
+                             uint32_t lane,
+                             MQTTAgentCommand_t ** pReceivedCommand );
+
+/**
+ * @brief Whether a lane above a given one holds a command.
+ *
+ * @param[in] pMsgCtx An #MQTTAgentMessageContext_t.
+ * @param[in] lane The lane.
+ *
+ * @return `true` if a higher lane holds a command, else `false`.
+ */
+static bool higherLaneQueued( MQTTAgentMessageContext_t * pMsgCtx,
+                              uint32_t lane );
+
+/**
+ * @brief Account a command taken from a lane in the starvation counts of the
+ * lanes below it.
+ *
+ * @param[in] pMsgCtx An #MQTTAgentMessageContext_t.
+ * @param[in] servedLane The lane of the command.
+ */
+static void countServedLane( MQTTAgentMessageContext_t * pMsgCtx,
+                             uint32_t servedLane );
+
+/**
+ * @brief Block until a command is queued or data arrives on the socket.
+ *
+ * @param[in] pMsgCtx An #MQTTAgentMessageContext_t with a socket set.
+ * @param[out] pReceivedCommand Pointer to write address of received command.
+ * @param[out] pLane Lane of the received command.
+ * @param[in] blockTimeMs Maximum time to wait.
+ *
+ * @return `true` if a command was received, else `false`.
+ */
+static bool waitForCommandOrData( MQTTAgentMessageContext_t * pMsgCtx,
+                                  MQTTAgentCommand_t ** pReceivedCommand,
+                                  uint32_t * pLane,
+                                  uint32_t blockTimeMs );
+
+/**
+ * @brief Receive up to @p maxCommands commands, as #Agent_MessageReceiveBatch,
+ * all from the lane of the first one.
+ *
+ * @param[in] pMsgCtx An #MQTTAgentMessageContext_t.
+ * @param[out] pReceivedCommands Array of @p maxCommands command addresses.
+ * @param[in] maxCommands Maximum number of commands to receive.
+ * @param[in] blockTimeMs Block time to wait for the first command.
+ * @param[out] pLane Lane of the received commands.
+ *
+ * @return Number of commands received.
+ */
+static uint32_t receiveBatch( MQTTAgentMessageContext_t * pMsgCtx,
+                              MQTTAgentCommand_t ** pReceivedCommands,
+                              uint32_t maxCommands,
+                              uint32_t blockTimeMs,
+                              uint32_t * pLane );
+
+#if ( AGENT_COALESCE_PUBLISHES == 1 )
+
+/**
+ * @brief Check whether a command is a QoS 0 publish.
+ *
+ * @param[in] pCommand The command, or NULL.
+ *
+ * @return `true` for a QoS 0 PUBLISH command.
+ */
+    static bool isQoS0Publish( const MQTTAgentCommand_t * pCommand );
+
+/**
+ * @brief Send the packets held by a message context to its transport.
+ *
+ * A send that times out without sending anything is retried for up to
+ * #AGENT_COALESCE_SEND_TIMEOUT_MS. If the packets still cannot be sent, the
+ * connection is shut down with #breakCoalescedConnection, as part of a packet
+ * may already be on the wire.
+ *
+ * @param[in] pMsgCtx An #MQTTAgentMessageContext_t holding packets in
+ * #MQTTAgentMessageContext.pCoalesceBuffer.
+ *
+ * @return `true` if all the packets were sent, else `false`.
+ */
+    static bool flushCoalesced( MQTTAgentMessageContext_t * pMsgCtx );
+
+/**
+ * @brief Shut down the connection of a message context after its held packets
+ * could not be sent, so that the agent sees it as lost.
+ *
+ * @param[in] pMsgCtx An #MQTTAgentMessageContext_t whose connection is shut
+ * down.
+ */
+    static void breakCoalescedConnection( MQTTAgentMessageContext_t * pMsgCtx );
+
+/**
+ * @brief Start or end the coalescing of packets for the command handed out
+ * to the agent.
+ *
+ * @param[in] pMsgCtx An #MQTTAgentMessageContext_t.
+ * @param[in] pCommand The command handed out, or NULL if none was.
+ */
+    static void updateCoalescing( MQTTAgentMessageContext_t * pMsgCtx,
+                                  const MQTTAgentCommand_t * pCommand );
+
+/**
+ * @brief Transport send function holding packets while the agent processes a
+ * QoS 0 publish.
+ *
+ * @param[in] pNetworkContext The #MQTTAgentMessageContext_t of the agent.
+ * @param[in] pBuffer Data to send.
+ * @param[in] bytesToSend Size of @p pBuffer.
+ *
+ * @return Number of bytes sent or held, else a negative value.
+ */
+    static int32_t coalescingSend( NetworkContext_t * pNetworkContext,
+                                   const void * pBuffer,
+                                   size_t bytesToSend );
+
+/**
+ * @brief Transport writev function holding packets while the agent processes
+ * a QoS 0 publish.
+ *
+ * @param[in] pNetworkContext The #MQTTAgentMessageContext_t of the agent.
+ * @param[in] pIoVec Array of buffers to send, in order.
+ * @param[in] ioVecCount Number of buffers in @p pIoVec.
+ *
+ * @return Number of bytes sent or held, else a negative value.
+ */
+    static int32_t coalescingWritev( NetworkContext_t * pNetworkContext,
+                                     TransportOutVector_t * pIoVec,
+                                     size_t ioVecCount );
+
+/**
+ * @brief Transport receive function of a coalescing transport.
+ *
+ * @param[in] pNetworkContext The #MQTTAgentMessageContext_t of the agent.
+ * @param[out] pBuffer Buffer to receive into.
+ * @param[in] bytesToRecv Size of @p pBuffer.
+ *
+ * @return Number of bytes received, else a negative value.
  */
-K_MSGQ_DEFINE( commandStructureQueue, sizeof( MQTTAgentCommand_t * ), NUM_COMMANDS_IN_POOL, sizeof( MQTTAgentCommand_t * ) );
+    static int32_t coalescingRecv( NetworkContext_t * pNetworkContext,
+                                   void * pBuffer,
+                                   size_t bytesToRecv );
+#endif /* if ( AGENT_COALESCE_PUBLISHES == 1 ) */
+
+#if ( AGENT_LATENCY_TRACING == 1 )
 
 /**
- * @brief Initialization status of the queue.
+ * @brief Get the timestamps of a command.
+ *
+ * @param[in] pCommand The command.
+ *
+ * @return The timestamps, or NULL if the command is not from the pool.
  */
-static volatile uint8_t queueInit = false;
+    static AgentCommandTrace_t * getCommandTrace( const MQTTAgentCommand_t * pCommand );
+
+/**
+ * @brief Timestamp a point of the life of a command.
+ *
+ * @param[in] pCommand The command, which may not be from the pool.
+ * @param[in] point The point.
+ */
+    static void stampCommand( const MQTTAgentCommand_t * pCommand,
+                              AgentLatencyPoint_t point );
+
+/**
+ * @brief Timestamp the first network send of the command processed by the
+ * agent of a message context.
+ *
+ * @param[in] pMsgCtx An #MQTTAgentMessageContext_t.
+ */
+    static void stampFirstSend( MQTTAgentMessageContext_t * pMsgCtx );
+
+/**
+ * @brief Transport send function timestamping the first send of the command
+ * processed by the agent.
+ *
+ * @param[in] pNetworkContext The #MQTTAgentMessageContext_t of the agent.
+ * @param[in] pBuffer Data to send.
+ * @param[in] bytesToSend Size of @p pBuffer.
+ *
+ * @return Value returned by the send function of the connection.
+ */
+    static int32_t tracingSend( NetworkContext_t * pNetworkContext,
+                                const void * pBuffer,
+                                size_t bytesToSend );
+
+/**
+ * @brief Transport writev function timestamping the first send of the
+ * command processed by the agent.
+ *
+ * @param[in] pNetworkContext The #MQTTAgentMessageContext_t of the agent.
+ * @param[in] pIoVec Array of buffers to send, in order.
+ * @param[in] ioVecCount Number of buffers in @p pIoVec.
+ *
+ * @return Value returned by the writev function of the connection.
+ */
+    static int32_t tracingWritev( NetworkContext_t * pNetworkContext,
+                                  TransportOutVector_t * pIoVec,
+                                  size_t ioVecCount );
+
+/**
+ * @brief Transport receive function of a tracing transport.
+ *
+ * @param[in] pNetworkContext The #MQTTAgentMessageContext_t of the agent.
+ * @param[out] pBuffer Buffer to receive into.
+ * @param[in] bytesToRecv Size of @p pBuffer.
+ *
+ * @return Value returned by the receive function of the connection.
+ */
+    static int32_t tracingRecv( NetworkContext_t * pNetworkContext,
+                                void * pBuffer,
+                                size_t bytesToRecv );
+#endif /* if ( AGENT_LATENCY_TRACING == 1 ) */
+
+/*-----------------------------------------------------------*/
+
+static MQTTAgentCommand_t * allocateCommand( void )
+{
+    MQTTAgentCommand_t * pCommand = NULL;
+    atomic_val_t word = 0, inUse = 0, peak = 0;
+    uint32_t freeBits = 0U, validBits = 0U;
+    size_t wordIndex = 0U, bitIndex = 0U;
+
+    for( wordIndex = 0U; ( wordIndex < COMMAND_POOL_WORDS ) && ( pCommand == NULL ); wordIndex++ )
+    {
+        /* The last word may track fewer structures than it has bits. */
+        if( ( ( wordIndex + 1U ) * COMMAND_POOL_BITS_PER_WORD ) > NUM_COMMANDS_IN_POOL )
+        {
+            validBits = ( 1UL << ( NUM_COMMANDS_IN_POOL % COMMAND_POOL_BITS_PER_WORD ) ) - 1UL;
+        }
+        else
+        {
+            validBits = UINT32_MAX;
+        }
+
+        /* Retry while other threads change the word, as long as it has a
+         * free bit. */
+        do
+        {
+            word = atomic_get( &( commandPoolBitmap[ wordIndex ] ) );
+            freeBits = ~( ( uint32_t ) word ) & validBits;
+
+            if( freeBits == 0U )
+            {
+                break;
+            }
+
+            bitIndex = ( size_t ) find_lsb_set( freeBits ) - 1U;
+        } while( atomic_cas( &( commandPoolBitmap[ wordIndex ] ),
+                             word,
+                             word | ( atomic_val_t ) ( 1UL << bitIndex ) ) == false );
+
+        if( freeBits != 0U )
+        {
+            pCommand = &( commandStructurePool[ ( wordIndex * COMMAND_POOL_BITS_PER_WORD ) + bitIndex ] );
+        }
+    }
+
+    if( pCommand != NULL )
+    {
+        /* atomic_inc returns the previous value. */
+        inUse = atomic_inc( &commandsInUse ) + 1;
+        peak = atomic_get( &peakCommandsInUse );
+
+        while( ( inUse > peak ) && ( atomic_cas( &peakCommandsInUse, peak, inUse ) == false ) )
+        {
+            peak = atomic_get( &peakCommandsInUse );
+        }
+    }
+
+    return pCommand;
+}
+/*-----------------------------------------------------------*/
+
+static bool dequeueCommand( MQTTAgentMessageContext_t * pMsgCtx,
+                            MQTTAgentCommand_t ** pReceivedCommand,
+                            uint32_t * pLane,
+                            k_timeout_t timeout )
+{
+    bool ret = false;
+    uint32_t lane = 0U, servedLane = 0U;
+
+    /* Commands are queued before the semaphore is given, so a command is
+     * available for each count taken. */
+    if( k_sem_take( &( pMsgCtx->pendingCommands ), timeout ) == 0 )
+    {
+        /* Another receiver may take the command found in a lane first, in
+         * which case the lanes are scanned again. */
+        while( ret == false )
+        {
+            servedLane = AGENT_MESSAGE_LANES;
+
+            /* Serve a lower lane that has waited too long, highest first. */
+            for( lane = 1U; lane < AGENT_MESSAGE_LANES; lane++ )
+            {
+                if( ( pMsgCtx->skippedCount[ lane ] >= AGENT_STARVATION_LIMIT ) &&
+                    ( k_msgq_get( &( pMsgCtx->lanes[ lane ] ), pReceivedCommand, K_NO_WAIT ) == 0 ) )
+                {
+                    servedLane = lane;
+                    break;
+                }
+            }
+
+            /* Otherwise, serve the highest lane holding a command. */
+            for( lane = 0U; ( servedLane == AGENT_MESSAGE_LANES ) && ( lane < AGENT_MESSAGE_LANES ); lane++ )
+            {
+                if( k_msgq_get( &( pMsgCtx->lanes[ lane ] ), pReceivedCommand, K_NO_WAIT ) == 0 )
+                {
+                    servedLane = lane;
+                }
+            }
+
+            ret = ( servedLane < AGENT_MESSAGE_LANES );
+        }
+
+        countServedLane( pMsgCtx, servedLane );
+        *pLane = servedLane;
+    }
+
+    return ret;
+}
+/*-----------------------------------------------------------*/
+
+static bool dequeueFromLane( MQTTAgentMessageContext_t * pMsgCtx,
+                             uint32_t lane,
+                             MQTTAgentCommand_t ** pReceivedCommand )
+{
+    bool ret = false;
+
+    if( ( higherLaneQueued( pMsgCtx, lane ) == false ) &&
+        ( k_sem_take( &( pMsgCtx->pendingCommands ), K_NO_WAIT ) == 0 ) )
+    {
+        if( k_msgq_get( &( pMsgCtx->lanes[ lane ] ), pReceivedCommand, K_NO_WAIT ) == 0 )
+        {
+            countServedLane( pMsgCtx, lane );
+            ret = true;
+        }
+        else
+        {
+            /* The count taken is for a command of another lane. */
+            k_sem_give( &( pMsgCtx->pendingCommands ) );
+        }
+    }
+
+    return ret;
+}
+/*-----------------------------------------------------------*/
+
+static bool higherLaneQueued( MQTTAgentMessageContext_t * pMsgCtx,
+                              uint32_t lane )
+{
+    bool queued = false;
+    uint32_t higherLane = 0U;
+
+    for( higherLane = 0U; ( higherLane < lane ) && ( queued == false ); higherLane++ )
+    {
+        queued = ( k_msgq_num_used_get( &( pMsgCtx->lanes[ higherLane ] ) ) > 0U );
+    }
+
+    return queued;
+}
+/*-----------------------------------------------------------*/
+
+static void countServedLane( MQTTAgentMessageContext_t * pMsgCtx,
+                             uint32_t servedLane )
+{
+    uint32_t lane = 0U;
+
+    pMsgCtx->skippedCount[ servedLane ] = 0U;
+
+    for( lane = servedLane + 1U; lane < AGENT_MESSAGE_LANES; lane++ )
+    {
+        /* The commands of a batch not handed out yet wait in their lane. */
+        if( ( k_msgq_num_used_get( &( pMsgCtx->lanes[ lane ] ) ) > 0U ) ||
+            ( ( lane == pMsgCtx->batchLane ) && ( pMsgCtx->batchIndex < pMsgCtx->batchCount ) ) )
+        {
+            pMsgCtx->skippedCount[ lane ]++;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static bool waitForCommandOrData( MQTTAgentMessageContext_t * pMsgCtx,
+                                  MQTTAgentCommand_t ** pReceivedCommand,
+                                  uint32_t * pLane,
+                                  uint32_t blockTimeMs )
+{
+    bool ret = false;
+    bool dataPending = false;
+    struct zsock_pollfd pollFds[ 2 ];
+    eventfd_t wakeupCount = 0;
+    int pollStatus = 0;
+
+    ret = dequeueCommand( pMsgCtx, pReceivedCommand, pLane, K_NO_WAIT );
+
+    if( ( ret == false ) && ( pMsgCtx->pendingDataCheck != NULL ) )
+    {
+        dataPending = pMsgCtx->pendingDataCheck( pMsgCtx->pNetworkContext );
+    }
+
+    if( ( ret == false ) && ( dataPending == false ) )
+    {
+        /* A command sent after the queue was checked above increments the
+         * eventfd, so the poll below returns immediately for it. */
+        pollFds[ 0 ].fd = pMsgCtx->wakeupFd;
+        pollFds[ 0 ].events = ZSOCK_POLLIN;
+        pollFds[ 0 ].revents = 0;
+        pollFds[ 1 ].fd = pMsgCtx->socket;
+        pollFds[ 1 ].events = ZSOCK_POLLIN | ZSOCK_POLLPRI;
+        pollFds[ 1 ].revents = 0;
+
+        pollStatus = zsock_poll( pollFds, 2, ( int ) blockTimeMs );
+
+        if( ( pollStatus > 0 ) && ( ( pollFds[ 0 ].revents & ZSOCK_POLLIN ) != 0 ) )
+        {
+            /* Reset the eventfd before dequeuing, so that no wakeup is lost. */
+            ( void ) eventfd_read( pMsgCtx->wakeupFd, &wakeupCount );
+            ret = dequeueCommand( pMsgCtx, pReceivedCommand, pLane, K_NO_WAIT );
+        }
+        else if( pollStatus < 0 )
+        {
+            LogError( ( "Failed to poll the agent socket and queue: errno=%d.", errno ) );
+
+            /* Do not spin on a socket that cannot be polled. */
+            ret = dequeueCommand( pMsgCtx, pReceivedCommand, pLane, K_MSEC( blockTimeMs ) );
+        }
+        else
+        {
+            /* Either socket data or a timeout; the agent will run the MQTT
+             * process loop. */
+        }
+    }
+
+    return ret;
+}
+/*-----------------------------------------------------------*/
+
+#if ( AGENT_COALESCE_PUBLISHES == 1 )
+
+    static bool isQoS0Publish( const MQTTAgentCommand_t * pCommand )
+    {
+        const MQTTPublishInfo_t * pPublishInfo = NULL;
+        bool qos0Publish = false;
+
+        if( ( pCommand != NULL ) && ( pCommand->commandType == PUBLISH ) )
+        {
+            pPublishInfo = ( const MQTTPublishInfo_t * ) pCommand->pArgs;
+            qos0Publish = ( pPublishInfo != NULL ) && ( pPublishInfo->qos == MQTTQoS0 );
+        }
+
+        return qos0Publish;
+    }
+/*-----------------------------------------------------------*/
+
+    static bool flushCoalesced( MQTTAgentMessageContext_t * pMsgCtx )
+    {
+        size_t bytesFlushed = 0U;
+        int32_t bytesSent = 0;
+        int64_t lastSendMs = k_uptime_get();
+
+        while( ( bytesFlushed < pMsgCtx->coalescedBytes ) && ( bytesSent >= 0 ) )
+        {
+            bytesSent = pMsgCtx->coalescedTransport.send( pMsgCtx->coalescedTransport.pNetworkContext,
+                                                          &( pMsgCtx->pCoalesceBuffer[ bytesFlushed ] ),
+                                                          pMsgCtx->coalescedBytes - bytesFlushed );
+
+            if( bytesSent > 0 )
+            {
+                bytesFlushed += ( size_t ) bytesSent;
+                lastSendMs = k_uptime_get();
+            }
+            else if( ( bytesSent == 0 ) &&
+                     ( ( k_uptime_get() - lastSendMs ) >= AGENT_COALESCE_SEND_TIMEOUT_MS ) )
+            {
+                bytesSent = -1;
+            }
+            else
+            {
+                /* Empty else marker. */
+            }
+        }
+
+        if( bytesSent < 0 )
+        {
+            LogError( ( "Failed to send %lu coalesced bytes: %lu sent.",
+                        ( unsigned long ) pMsgCtx->coalescedBytes,
+                        ( unsigned long ) bytesFlushed ) );
+            breakCoalescedConnection( pMsgCtx );
+        }
+
+        pMsgCtx->coalescedBytes = 0U;
+
+        return( bytesSent >= 0 );
+    }
+/*-----------------------------------------------------------*/
+
+    static void breakCoalescedConnection( MQTTAgentMessageContext_t * pMsgCtx )
+    {
+        pMsgCtx->coalesceBroken = true;
+
+        /* The agent stops on the failed sends and receives that follow, and
+         * whatever waits on the socket wakes up. */
+        if( pMsgCtx->socket >= 0 )
+        {
+            ( void ) zsock_shutdown( pMsgCtx->socket, ZSOCK_SHUT_RDWR );
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static void updateCoalescing( MQTTAgentMessageContext_t * pMsgCtx,
+                                  const MQTTAgentCommand_t * pCommand )
+    {
+        bool qos0Publish = isQoS0Publish( pCommand );
+        bool windowOver = false;
+
+        if( pMsgCtx->pCoalesceBuffer != NULL )
+        {
+            windowOver = ( ( k_uptime_get() - pMsgCtx->coalesceStartMs ) >= AGENT_COALESCE_WINDOW_MS );
+
+            /* Send the held packets before those of any other command, or once
+             * the oldest one has waited long enough. */
+            if( ( pMsgCtx->coalescedBytes > 0U ) && ( ( qos0Publish == false ) || ( windowOver == true ) ) )
+            {
+                ( void ) flushCoalesced( pMsgCtx );
+            }
+
+            pMsgCtx->corked = qos0Publish;
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static int32_t coalescingSend( NetworkContext_t * pNetworkContext,
+                                   const void * pBuffer,
+                                   size_t bytesToSend )
+    {
+        MQTTAgentMessageContext_t * pMsgCtx = ( MQTTAgentMessageContext_t * ) pNetworkContext;
+        int32_t bytesSent = -1;
+        bool flushed = true;
+
+        if( pMsgCtx->coalesceBroken == true )
+        {
+            /* The connection was shut down when held packets failed. */
+        }
+        else if( ( pMsgCtx->corked == true ) && ( bytesToSend <= pMsgCtx->coalesceBufferSize ) )
+        {
+            if( ( pMsgCtx->coalescedBytes + bytesToSend ) > pMsgCtx->coalesceBufferSize )
+            {
+                flushed = flushCoalesced( pMsgCtx );
+            }
+
+            if( flushed == true )
+            {
+                if( pMsgCtx->coalescedBytes == 0U )
+                {
+                    pMsgCtx->coalesceStartMs = k_uptime_get();
+                }
+
+                ( void ) memcpy( &( pMsgCtx->pCoalesceBuffer[ pMsgCtx->coalescedBytes ] ), pBuffer, bytesToSend );
+                pMsgCtx->coalescedBytes += bytesToSend;
+                bytesSent = ( int32_t ) bytesToSend;
+            }
+        }
+        else
+        {
+            /* The held packets were queued first. */
+            flushed = flushCoalesced( pMsgCtx );
+
+            if( flushed == true )
+            {
+                bytesSent = pMsgCtx->coalescedTransport.send( pMsgCtx->coalescedTransport.pNetworkContext,
+                                                              pBuffer,
+                                                              bytesToSend );
+            }
+        }
+
+        return bytesSent;
+    }
+/*-----------------------------------------------------------*/
+
+    static int32_t coalescingWritev( NetworkContext_t * pNetworkContext,
+                                     TransportOutVector_t * pIoVec,
+                                     size_t ioVecCount )
+    {
+        int32_t totalSent = 0, bytesSent = 0;
+        size_t index = 0U;
+
+        for( index = 0U; index < ioVecCount; index++ )
+        {
+            bytesSent = coalescingSend( pNetworkContext, pIoVec[ index ].iov_base, pIoVec[ index ].iov_len );
+
+            if( bytesSent < 0 )
+            {
+                totalSent = ( totalSent > 0 ) ? totalSent : bytesSent;
+                break;
+            }
+
+            totalSent += bytesSent;
+
+            if( ( size_t ) bytesSent < pIoVec[ index ].iov_len )
+            {
+                break;
+            }
+        }
+
+        return totalSent;
+    }
+/*-----------------------------------------------------------*/
+
+    static int32_t coalescingRecv( NetworkContext_t * pNetworkContext,
+                                   void * pBuffer,
+                                   size_t bytesToRecv )
+    {
+        MQTTAgentMessageContext_t * pMsgCtx = ( MQTTAgentMessageContext_t * ) pNetworkContext;
+        int32_t bytesReceived = -1;
+
+        if( pMsgCtx->coalesceBroken == false )
+        {
+            bytesReceived = pMsgCtx->coalescedTransport.recv( pMsgCtx->coalescedTransport.pNetworkContext,
+                                                              pBuffer,
+                                                              bytesToRecv );
+        }
+
+        return bytesReceived;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* if ( AGENT_COALESCE_PUBLISHES == 1 ) */
+
+#if ( AGENT_LATENCY_TRACING == 1 )
+
+    static AgentCommandTrace_t * getCommandTrace( const MQTTAgentCommand_t * pCommand )
+    {
+        AgentCommandTrace_t * pTrace = NULL;
+
+        if( ( pCommand >= commandStructurePool ) &&
+            ( pCommand < ( commandStructurePool + NUM_COMMANDS_IN_POOL ) ) )
+        {
+            pTrace = &( commandTraces[ pCommand - commandStructurePool ] );
+        }
+
+        return pTrace;
+    }
+/*-----------------------------------------------------------*/
+
+    static void stampCommand( const MQTTAgentCommand_t * pCommand,
+                              AgentLatencyPoint_t point )
+    {
+        AgentCommandTrace_t * pTrace = getCommandTrace( pCommand );
+
+        if( pTrace != NULL )
+        {
+            pTrace->stamps[ point ] = k_cycle_get_32();
+            pTrace->stampedPoints |= 1UL << point;
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static void stampFirstSend( MQTTAgentMessageContext_t * pMsgCtx )
+    {
+        AgentCommandTrace_t * pTrace = getCommandTrace( pMsgCtx->pTracedCommand );
+        uint32_t dequeuedOnly = 1UL << AGENT_LATENCY_POINT_DEQUEUED;
+
+        /* Only the first send of a command still in the hands of the agent is
+         * stamped; the structure may have been freed and reused since. */
+        if( ( pTrace != NULL ) &&
+            ( ( pTrace->stampedPoints & ( dequeuedOnly | ( 1UL << AGENT_LATENCY_POINT_SENT ) ) ) == dequeuedOnly ) )
+        {
+            stampCommand( pMsgCtx->pTracedCommand, AGENT_LATENCY_POINT_SENT );
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static int32_t tracingSend( NetworkContext_t * pNetworkContext,
+                                const void * pBuffer,
+                                size_t bytesToSend )
+    {
+        MQTTAgentMessageContext_t * pMsgCtx = ( MQTTAgentMessageContext_t * ) pNetworkContext;
 
+        stampFirstSend( pMsgCtx );
+
+        return pMsgCtx->tracedTransport.send( pMsgCtx->tracedTransport.pNetworkContext,
+                                              pBuffer,
+                                              bytesToSend );
+    }
+/*-----------------------------------------------------------*/
+
+    static int32_t tracingWritev( NetworkContext_t * pNetworkContext,
+                                  TransportOutVector_t * pIoVec,
+                                  size_t ioVecCount )
+    {
+        MQTTAgentMessageContext_t * pMsgCtx = ( MQTTAgentMessageContext_t * ) pNetworkContext;
+
+        stampFirstSend( pMsgCtx );
+
+        return pMsgCtx->tracedTransport.writev( pMsgCtx->tracedTransport.pNetworkContext,
+                                                pIoVec,
+                                                ioVecCount );
+    }
 /*-----------------------------------------------------------*/
 
+    static int32_t tracingRecv( NetworkContext_t * pNetworkContext,
+                                void * pBuffer,
+                                size_t bytesToRecv )
+    {
+        MQTTAgentMessageContext_t * pMsgCtx = ( MQTTAgentMessageContext_t * ) pNetworkContext;
+
+        return pMsgCtx->tracedTransport.recv( pMsgCtx->tracedTransport.pNetworkContext,
+                                              pBuffer,
+                                              bytesToRecv );
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* if ( AGENT_LATENCY_TRACING == 1 ) */
+
+void Agent_MessageContextInit( MQTTAgentMessageContext_t * pMsgCtx,
+                               char * pQueueBuffer,
+                               uint32_t queueLength )
+{
+    uint32_t lane = 0U;
+
+    assert( pMsgCtx != NULL );
+    assert( pQueueBuffer != NULL );
+
+    for( lane = 0U; lane < ( AGENT_MESSAGE_LANES - 1U ); lane++ )
+    {
+        k_msgq_init( &( pMsgCtx->lanes[ lane ] ),
+                     ( char * ) pMsgCtx->laneBuffers[ lane ],
+                     sizeof( MQTTAgentCommand_t * ),
+                     AGENT_PRIORITY_LANE_LENGTH );
+        pMsgCtx->skippedCount[ lane ] = 0U;
+    }
+
+    k_msgq_init( &( pMsgCtx->lanes[ AGENT_MESSAGE_LANES - 1U ] ), pQueueBuffer, sizeof( MQTTAgentCommand_t * ), queueLength );
+    pMsgCtx->skippedCount[ AGENT_MESSAGE_LANES - 1U ] = 0U;
+
+    ( void ) k_sem_init( &( pMsgCtx->pendingCommands ),
+                         0U,
+                         queueLength + ( ( AGENT_MESSAGE_LANES - 1U ) * AGENT_PRIORITY_LANE_LENGTH ) );
+
+    pMsgCtx->classify = Agent_DefaultPriorityClassifier;
+    pMsgCtx->batchCount = 0U;
+    pMsgCtx->batchIndex = 0U;
+    pMsgCtx->batchLane = 0U;
+
+    pMsgCtx->socket = -1;
+    pMsgCtx->pNetworkContext = NULL;
+    pMsgCtx->pendingDataCheck = NULL;
+
+    #if ( AGENT_COALESCE_PUBLISHES == 1 )
+        pMsgCtx->pCoalesceBuffer = NULL;
+        pMsgCtx->coalesceBufferSize = 0U;
+        pMsgCtx->coalescedBytes = 0U;
+        pMsgCtx->coalesceStartMs = 0;
+        pMsgCtx->corked = false;
+        pMsgCtx->coalesceBroken = false;
+    #endif
+
+    #if ( AGENT_LATENCY_TRACING == 1 )
+        pMsgCtx->pTracedCommand = NULL;
+    #endif
+
+    pMsgCtx->wakeupFd = eventfd( 0, EFD_NONBLOCK );
+
+    if( pMsgCtx->wakeupFd < 0 )
+    {
+        LogWarn( ( "Failed to create the agent wakeup eventfd: errno=%d. "
+                   "The agent will block on its queue only.", errno ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+uint32_t Agent_DefaultPriorityClassifier( const MQTTAgentCommand_t * pCommand )
+{
+    uint32_t lane = 0U;
+    const MQTTPublishInfo_t * pPublishInfo = NULL;
+
+    assert( pCommand != NULL );
+
+    if( pCommand->commandType == PUBLISH )
+    {
+        pPublishInfo = ( const MQTTPublishInfo_t * ) pCommand->pArgs;
+
+        if( ( pPublishInfo != NULL ) && ( pPublishInfo->qos == MQTTQoS0 ) )
+        {
+            lane = AGENT_MESSAGE_LANES - 1U;
+        }
+    }
+
+    return lane;
+}
+/*-----------------------------------------------------------*/
+
+void Agent_SetPriorityClassifier( MQTTAgentMessageContext_t * pMsgCtx,
+                                  AgentPriorityClassifier_t classify )
+{
+    assert( pMsgCtx != NULL );
+
+    pMsgCtx->classify = ( classify != NULL ) ? classify : Agent_DefaultPriorityClassifier;
+}
+/*-----------------------------------------------------------*/
+
+void Agent_SetNetworkSocket( MQTTAgentMessageContext_t * pMsgCtx,
+                             int32_t socket,
+                             NetworkContext_t * pNetworkContext,
+                             AgentPendingDataCheck_t pendingDataCheck )
+{
+    assert( pMsgCtx != NULL );
+
+    pMsgCtx->socket = socket;
+    pMsgCtx->pNetworkContext = pNetworkContext;
+    pMsgCtx->pendingDataCheck = pendingDataCheck;
+
+    #if ( AGENT_COALESCE_PUBLISHES == 1 )
+        /* A new connection is not broken by the held packets of the last. */
+        if( socket >= 0 )
+        {
+            pMsgCtx->coalesceBroken = false;
+        }
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+#if ( AGENT_COALESCE_PUBLISHES == 1 )
+
+    void Agent_EnableCoalescing( MQTTAgentMessageContext_t * pMsgCtx,
+                                 TransportInterface_t * pTransport,
+                                 uint8_t * pBuffer,
+                                 size_t bufferSize )
+    {
+        assert( pMsgCtx != NULL );
+        assert( pTransport != NULL );
+        assert( pBuffer != NULL );
+
+        pMsgCtx->coalescedTransport = *pTransport;
+        pMsgCtx->pCoalesceBuffer = pBuffer;
+        pMsgCtx->coalesceBufferSize = bufferSize;
+        pMsgCtx->coalescedBytes = 0U;
+        pMsgCtx->coalesceStartMs = 0;
+        pMsgCtx->corked = false;
+        pMsgCtx->coalesceBroken = false;
+
+        pTransport->pNetworkContext = ( NetworkContext_t * ) pMsgCtx;
+        pTransport->send = coalescingSend;
+        pTransport->recv = coalescingRecv;
+
+        /* Keep the agent from using writev if the transport cannot. */
+        pTransport->writev = ( pTransport->writev != NULL ) ? coalescingWritev : NULL;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* if ( AGENT_COALESCE_PUBLISHES == 1 ) */
+
+#if ( AGENT_LATENCY_TRACING == 1 )
+
+    void Agent_EnableLatencyTracing( MQTTAgentMessageContext_t * pMsgCtx,
+                                     TransportInterface_t * pTransport )
+    {
+        assert( pMsgCtx != NULL );
+        assert( pTransport != NULL );
+
+        pMsgCtx->tracedTransport = *pTransport;
+        pMsgCtx->pTracedCommand = NULL;
+
+        pTransport->pNetworkContext = ( NetworkContext_t * ) pMsgCtx;
+        pTransport->send = tracingSend;
+        pTransport->recv = tracingRecv;
+        pTransport->writev = ( pTransport->writev != NULL ) ? tracingWritev : NULL;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* if ( AGENT_LATENCY_TRACING == 1 ) */
+
 bool Agent_MessageSend( MQTTAgentMessageContext_t * pMsgCtx,
                         MQTTAgentCommand_t * const * pCommandToSend,
                         uint32_t blockTimeMs )
 {
     bool ret = false;
+    uint32_t lane = 0U;
 
     if( ( pMsgCtx != NULL ) && ( pCommandToSend != NULL ) )
     {
-        ret = ( k_msgq_put( &( pMsgCtx->queue ), pCommandToSend, K_MSEC( blockTimeMs ) ) == 0 );
+        lane = pMsgCtx->classify( *pCommandToSend );
+
+        if( lane >= AGENT_MESSAGE_LANES )
+        {
+            lane = AGENT_MESSAGE_LANES - 1U;
+        }
+
+        #if ( AGENT_LATENCY_TRACING == 1 )
+            /* Stamped first, as the agent may take the command as soon as it
+             * is queued. Waiting for room in the lane counts as queueing. */
+            stampCommand( *pCommandToSend, AGENT_LATENCY_POINT_ENQUEUED );
+        #endif
+
+        ret = ( k_msgq_put( &( pMsgCtx->lanes[ lane ] ), pCommandToSend, K_MSEC( blockTimeMs ) ) == 0 );
+
+        if( ret == true )
+        {
+            k_sem_give( &( pMsgCtx->pendingCommands ) );
+
+            /* Wake the agent if it is waiting on its socket. */
+            if( pMsgCtx->wakeupFd >= 0 )
+            {
+                ( void ) eventfd_write( pMsgCtx->wakeupFd, 1 );
+            }
+        }
     }
 
     return ret;
@@ -80,35 +1083,145 @@ bool Agent_MessageReceive( MQTTAgentMessageContext_t * pMsgCtx,
                            uint32_t blockTimeMs )
 {
     bool ret = false;
+    uint32_t lane = 0U;
 
     if( ( pMsgCtx != NULL ) && ( pReceivedCommand != NULL ) )
     {
-        ret = ( k_msgq_get( &( pMsgCtx->queue ), pReceivedCommand, K_MSEC( blockTimeMs ) ) == 0 );
+        #if ( AGENT_COALESCE_PUBLISHES == 1 )
+            /* Do not hold coalesced packets beyond their window. */
+            if( pMsgCtx->coalescedBytes > 0U )
+            {
+                blockTimeMs = ( uint32_t ) MAX( MIN( ( int64_t ) AGENT_COALESCE_WINDOW_MS - ( k_uptime_get() - pMsgCtx->coalesceStartMs ),
+                                                     ( int64_t ) blockTimeMs ),
+                                                0 );
+            }
+        #endif
+
+        if( pMsgCtx->batchIndex == pMsgCtx->batchCount )
+        {
+            pMsgCtx->batchIndex = 0U;
+            pMsgCtx->batchCount = 0U;
+            pMsgCtx->batchCount = receiveBatch( pMsgCtx,
+                                                pMsgCtx->batch,
+                                                AGENT_RECEIVE_BATCH_SIZE,
+                                                blockTimeMs,
+                                                &( pMsgCtx->batchLane ) );
+        }
+        else if( ( pMsgCtx->skippedCount[ pMsgCtx->batchLane ] < AGENT_STARVATION_LIMIT ) &&
+                 ( higherLaneQueued( pMsgCtx, pMsgCtx->batchLane ) == true ) )
+        {
+            /* A command sent to a higher lane goes before the rest of the
+             * batch, unless the batch has waited too long. No other lane is
+             * served meanwhile, as the lane of the batch holds commands
+             * queued after it. */
+            for( lane = 0U; ( lane < pMsgCtx->batchLane ) && ( ret == false ); lane++ )
+            {
+                ret = dequeueFromLane( pMsgCtx, lane, pReceivedCommand );
+            }
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+
+        if( ( ret == false ) && ( pMsgCtx->batchIndex < pMsgCtx->batchCount ) )
+        {
+            *pReceivedCommand = pMsgCtx->batch[ pMsgCtx->batchIndex ];
+            pMsgCtx->batchIndex++;
+            pMsgCtx->skippedCount[ pMsgCtx->batchLane ] = 0U;
+            ret = true;
+        }
+
+        #if ( AGENT_LATENCY_TRACING == 1 )
+            /* The agent processes the command handed out until its next
+             * receive. */
+            pMsgCtx->pTracedCommand = ( ret == true ) ? *pReceivedCommand : NULL;
+
+            if( ret == true )
+            {
+                stampCommand( *pReceivedCommand, AGENT_LATENCY_POINT_DEQUEUED );
+            }
+        #endif
+
+        #if ( AGENT_COALESCE_PUBLISHES == 1 )
+            updateCoalescing( pMsgCtx, ( ret == true ) ? *pReceivedCommand : NULL );
+        #endif
     }
 
     return ret;
 }
 /*-----------------------------------------------------------*/
 
+static uint32_t receiveBatch( MQTTAgentMessageContext_t * pMsgCtx,
+                              MQTTAgentCommand_t ** pReceivedCommands,
+                              uint32_t maxCommands,
+                              uint32_t blockTimeMs,
+                              uint32_t * pLane )
+{
+    uint32_t count = 0U;
+    bool received = false;
+
+    if( ( pMsgCtx->wakeupFd >= 0 ) && ( pMsgCtx->socket >= 0 ) )
+    {
+        received = waitForCommandOrData( pMsgCtx, &( pReceivedCommands[ 0 ] ), pLane, blockTimeMs );
+    }
+    else
+    {
+        /* Without a socket to wait on, block on the lanes alone. */
+        received = dequeueCommand( pMsgCtx, &( pReceivedCommands[ 0 ] ), pLane, K_MSEC( blockTimeMs ) );
+    }
+
+    /* Take the commands already queued behind the first one in its lane,
+     * until a higher lane gets a command. */
+    while( ( received == true ) && ( count < maxCommands ) )
+    {
+        count++;
+
+        if( count < maxCommands )
+        {
+            received = dequeueFromLane( pMsgCtx, *pLane, &( pReceivedCommands[ count ] ) );
+        }
+    }
+
+    return count;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t Agent_MessageReceiveBatch( MQTTAgentMessageContext_t * pMsgCtx,
+                                    MQTTAgentCommand_t ** pReceivedCommands,
+                                    uint32_t maxCommands,
+                                    uint32_t blockTimeMs )
+{
+    uint32_t count = 0U, lane = 0U;
+
+    if( ( pMsgCtx != NULL ) && ( pReceivedCommands != NULL ) && ( maxCommands > 0U ) )
+    {
+        count = receiveBatch( pMsgCtx, pReceivedCommands, maxCommands, blockTimeMs, &lane );
+    }
+
+    return count;
+}
+/*-----------------------------------------------------------*/
+
 void Agent_InitializePool( void )
 {
     size_t i;
-    MQTTAgentCommand_t * pCommand;
-    bool commandAdded = false;
 
-    if( !queueInit )
+    if( !poolInit )
     {
-        /* Populate the queue. */
-        for( i = 0; i < NUM_COMMANDS_IN_POOL; i++ )
+        /* Mark every structure of the pool free. */
+        for( i = 0; i < COMMAND_POOL_WORDS; i++ )
         {
-            /* Store the address as a variable. */
-            pCommand = &commandStructurePool[ i ];
-            /* Send the pointer to the queue. */
-            commandAdded = ( k_msgq_put( &commandStructureQueue, &pCommand, K_NO_WAIT ) == 0 );
-            assert( commandAdded );
+            ( void ) atomic_clear( &( commandPoolBitmap[ i ] ) );
         }
 
-        queueInit = true;
+        ( void ) atomic_clear( &commandsInUse );
+
+        /* The statistics describe this pool, not one initialized before. */
+        ( void ) atomic_clear( &peakCommandsInUse );
+        ( void ) atomic_clear( &commandAllocationFailures );
+
+        poolInit = true;
     }
 }
 /*-----------------------------------------------------------*/
@@ -116,17 +1229,61 @@ void Agent_InitializePool( void )
 MQTTAgentCommand_t * Agent_GetCommand( uint32_t blockTimeMs )
 {
     MQTTAgentCommand_t * structToUse = NULL;
-    bool commandRetrieved = false;
+    int64_t remainingMs = 0, deadlineMs = 0;
 
-    /* Check queue has been created. */
-    assert( queueInit );
+    #if ( AGENT_LATENCY_TRACING == 1 )
+        uint32_t requestCycles = k_cycle_get_32();
+        AgentCommandTrace_t * pTrace = NULL;
+    #endif
 
-    commandRetrieved = ( k_msgq_get( &commandStructureQueue, &structToUse, K_MSEC( blockTimeMs ) ) == 0 );
+    /* Check pool has been initialized. */
+    assert( poolInit );
 
-    if( !commandRetrieved )
+    structToUse = allocateCommand();
+
+    /* Blocking is not allowed in an ISR, which only uses the fast path. */
+    if( ( structToUse == NULL ) && ( blockTimeMs > 0U ) && ( k_is_in_isr() == false ) )
     {
-        LogError( ( "No command structure available. Maximum number of commands statically allocated in the pool is: %d",
-                    NUM_COMMANDS_IN_POOL ) );
+        deadlineMs = k_uptime_get() + ( int64_t ) blockTimeMs;
+
+        /* Register as a waiter before trying again, so that a structure freed
+         * after the failed attempt above gives the semaphore. */
+        ( void ) atomic_inc( &commandWaiters );
+
+        do
+        {
+            structToUse = allocateCommand();
+            remainingMs = deadlineMs - k_uptime_get();
+
+            if( ( structToUse == NULL ) && ( remainingMs > 0 ) )
+            {
+                ( void ) k_sem_take( &commandFreedSemaphore, K_MSEC( remainingMs ) );
+            }
+        } while( ( structToUse == NULL ) && ( remainingMs > 0 ) );
+
+        ( void ) atomic_dec( &commandWaiters );
+    }
+
+    #if ( AGENT_LATENCY_TRACING == 1 )
+        pTrace = getCommandTrace( structToUse );
+
+        if( pTrace != NULL )
+        {
+            pTrace->stamps[ AGENT_LATENCY_POINT_REQUESTED ] = requestCycles;
+            pTrace->stampedPoints = 1UL << AGENT_LATENCY_POINT_REQUESTED;
+            stampCommand( structToUse, AGENT_LATENCY_POINT_ALLOCATED );
+        }
+    #endif
+
+    if( structToUse == NULL )
+    {
+        ( void ) atomic_inc( &commandAllocationFailures );
+
+        if( k_is_in_isr() == false )
+        {
+            LogError( ( "No command structure available. Maximum number of commands statically allocated in the pool is: %d",
+                        NUM_COMMANDS_IN_POOL ) );
+        }
     }
 
     return structToUse;
@@ -136,18 +1293,59 @@ MQTTAgentCommand_t * Agent_GetCommand( uint32_t blockTimeMs )
 bool Agent_FreeCommand( MQTTAgentCommand_t * pCommandToRelease )
 {
     bool structReturned = false;
+    size_t index = 0U;
+    atomic_val_t mask = 0, previousWord = 0;
 
-    /* Check queue has been created. */
-    assert( queueInit );
+    /* Check pool has been initialized. */
+    assert( poolInit );
 
     /* See if the structure being returned is actually from the pool. */
     if( ( pCommandToRelease >= commandStructurePool ) &&
         ( pCommandToRelease < ( commandStructurePool + NUM_COMMANDS_IN_POOL ) ) )
     {
-        structReturned = ( k_msgq_put( &commandStructureQueue, &pCommandToRelease, K_NO_WAIT ) == 0 );
+        index = ( size_t ) ( pCommandToRelease - commandStructurePool );
+        mask = ( atomic_val_t ) ( 1UL << ( index % COMMAND_POOL_BITS_PER_WORD ) );
+
+        #if ( AGENT_LATENCY_TRACING == 1 )
+            /* Accounted before the structure can be allocated again. Commands
+             * that failed to be queued are not. */
+            if( ( commandTraces[ index ].stampedPoints & ( 1UL << AGENT_LATENCY_POINT_DEQUEUED ) ) != 0U )
+            {
+                stampCommand( pCommandToRelease, AGENT_LATENCY_POINT_COMPLETED );
+                AgentLatency_Record( pCommandToRelease->commandType,
+                                     commandTraces[ index ].stamps,
+                                     commandTraces[ index ].stampedPoints );
+            }
+        #endif
+
+        /* atomic_and returns the previous value, which tells whether the
+         * structure was in use. */
+        previousWord = atomic_and( &( commandPoolBitmap[ index / COMMAND_POOL_BITS_PER_WORD ] ), ~mask );
+        structReturned = ( ( previousWord & mask ) != 0 );
 
         assert( structReturned );
+
+        if( structReturned == true )
+        {
+            ( void ) atomic_dec( &commandsInUse );
+
+            if( atomic_get( &commandWaiters ) > 0 )
+            {
+                k_sem_give( &commandFreedSemaphore );
+            }
+        }
     }
 
     return structReturned;
 }
+/*-----------------------------------------------------------*/
+
+void Agent_GetPoolStats( AgentPoolStats_t * pStats )
+{
+    assert( pStats != NULL );
+
+    pStats->poolSize = NUM_COMMANDS_IN_POOL;
+    pStats->inUse = ( uint32_t ) atomic_get( &commandsInUse );
+    pStats->peakInUse = ( uint32_t ) atomic_get( &peakCommandsInUse );
+    pStats->allocationFailures = ( uint32_t ) atomic_get( &commandAllocationFailures );
+}
@@ -0,0 +1,311 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file agent_latency_zephyr.c
+ * @brief Latency histograms of the commands of the MQTT agent, and the
+ * "mqtt_agent latency" shell command printing them.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Zephyr includes. */
+#include <kernel.h>
+
+#if defined( CONFIG_SHELL )
+    #include <shell/shell.h>
+#endif
+
+#include "agent_latency_zephyr.h"
+
+#if ( AGENT_LATENCY_TRACING == 1 )
+
+/**
+ * @brief Histograms of each command type.
+ */
+    static AgentLatencyStats_t latencyStats[ NUM_COMMANDS ];
+
+/**
+ * @brief Lock protecting #latencyStats.
+ *
+ * Commands may be freed from an ISR, and the sections it protects never
+ * block.
+ */
+    static struct k_spinlock latencyLock;
+
+/**
+ * @brief First and last point of each #AgentLatencyStage_t.
+ */
+    static const uint8_t stagePoints[ AGENT_LATENCY_STAGES ][ 2 ] =
+    {
+        { AGENT_LATENCY_POINT_REQUESTED, AGENT_LATENCY_POINT_ALLOCATED },
+        { AGENT_LATENCY_POINT_ENQUEUED,  AGENT_LATENCY_POINT_DEQUEUED  },
+        { AGENT_LATENCY_POINT_DEQUEUED,  AGENT_LATENCY_POINT_SENT      },
+        { AGENT_LATENCY_POINT_SENT,      AGENT_LATENCY_POINT_COMPLETED },
+        { AGENT_LATENCY_POINT_REQUESTED, AGENT_LATENCY_POINT_COMPLETED }
+    };
+
+/*-----------------------------------------------------------*/
+
+    #if defined( CONFIG_SHELL )
+
+/**
+ * @brief Print the histograms of every command type that completed.
+ *
+ * @param[in] pShell The shell.
+ * @param[in] argc Number of arguments.
+ * @param[in] argv Arguments; "reset" resets the histograms once printed.
+ *
+ * @return 0, or -EINVAL for an unknown argument.
+ */
+        static int latencyShellCommand( const struct shell * pShell,
+                                        size_t argc,
+                                        char ** argv );
+    #endif
+
+/*-----------------------------------------------------------*/
+
+#endif /* if ( AGENT_LATENCY_TRACING == 1 ) */
+
+void AgentLatency_Record( MQTTAgentCommandType_t commandType,
+                          const uint32_t * pStamps,
+                          uint32_t stampedPoints )
+{
+    assert( pStamps != NULL );
+
+    #if ( AGENT_LATENCY_TRACING == 1 )
+        uint32_t elapsedUs[ AGENT_LATENCY_STAGES ];
+        uint32_t stageMask = 0U;
+        k_spinlock_key_t key;
+        size_t stage = 0U;
+
+        if( ( uint32_t ) commandType < ( uint32_t ) NUM_COMMANDS )
+        {
+            /* Convert outside of the lock. */
+            for( stage = 0U; stage < AGENT_LATENCY_STAGES; stage++ )
+            {
+                if( ( ( stampedPoints & ( 1UL << stagePoints[ stage ][ 0 ] ) ) != 0U ) &&
+                    ( ( stampedPoints & ( 1UL << stagePoints[ stage ][ 1 ] ) ) != 0U ) )
+                {
+                    elapsedUs[ stage ] = k_cyc_to_us_floor32( pStamps[ stagePoints[ stage ][ 1 ] ] -
+                                                              pStamps[ stagePoints[ stage ][ 0 ] ] );
+                    stageMask |= 1UL << stage;
+                }
+            }
+
+            key = k_spin_lock( &latencyLock );
+
+            for( stage = 0U; stage < AGENT_LATENCY_STAGES; stage++ )
+            {
+                if( ( stageMask & ( 1UL << stage ) ) != 0U )
+                {
+                    AgentLatency_AddSample( &( latencyStats[ commandType ].stages[ stage ] ), elapsedUs[ stage ] );
+                }
+            }
+
+            k_spin_unlock( &latencyLock, key );
+        }
+    #else /* if ( AGENT_LATENCY_TRACING == 1 ) */
+        ( void ) commandType;
+        ( void ) stampedPoints;
+    #endif /* if ( AGENT_LATENCY_TRACING == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+void AgentLatency_GetStats( MQTTAgentCommandType_t commandType,
+                            AgentLatencyStats_t * pStats,
+                            bool reset )
+{
+    assert( pStats != NULL );
+
+    ( void ) memset( pStats, 0, sizeof( AgentLatencyStats_t ) );
+
+    #if ( AGENT_LATENCY_TRACING == 1 )
+        k_spinlock_key_t key;
+
+        if( ( uint32_t ) commandType < ( uint32_t ) NUM_COMMANDS )
+        {
+            key = k_spin_lock( &latencyLock );
+
+            *pStats = latencyStats[ commandType ];
+
+            if( reset == true )
+            {
+                ( void ) memset( &( latencyStats[ commandType ] ), 0, sizeof( AgentLatencyStats_t ) );
+            }
+
+            k_spin_unlock( &latencyLock, key );
+        }
+    #else
+        ( void ) commandType;
+        ( void ) reset;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+void AgentLatency_AddSample( AgentLatencyHistogram_t * pHistogram,
+                             uint32_t elapsedUs )
+{
+    uint32_t boundUs = AGENT_LATENCY_HISTOGRAM_BASE_US;
+    size_t bucket = 0U;
+
+    assert( pHistogram != NULL );
+
+    while( ( bucket < ( AGENT_LATENCY_HISTOGRAM_BUCKETS - 1U ) ) && ( elapsedUs >= boundUs ) )
+    {
+        bucket++;
+        boundUs <<= 1;
+    }
+
+    pHistogram->buckets[ bucket ]++;
+    pHistogram->count++;
+    pHistogram->totalUs += elapsedUs;
+
+    if( elapsedUs > pHistogram->maxUs )
+    {
+        pHistogram->maxUs = elapsedUs;
+    }
+}
+/*-----------------------------------------------------------*/
+
+uint32_t AgentLatency_PercentileUs( const AgentLatencyHistogram_t * pHistogram,
+                                    uint32_t percent )
+{
+    uint64_t rank = 0U, counted = 0U;
+    uint32_t boundUs = AGENT_LATENCY_HISTOGRAM_BASE_US;
+    size_t bucket = 0U;
+
+    assert( pHistogram != NULL );
+
+    if( pHistogram->count > 0U )
+    {
+        /* Rank of the percentile, from 1 to the number of commands. */
+        rank = ( ( ( uint64_t ) pHistogram->count * MIN( percent, 100U ) ) + 99U ) / 100U;
+        rank = MAX( rank, 1U );
+
+        for( bucket = 0U; bucket < ( AGENT_LATENCY_HISTOGRAM_BUCKETS - 1U ); bucket++ )
+        {
+            counted += pHistogram->buckets[ bucket ];
+
+            if( counted >= rank )
+            {
+                break;
+            }
+
+            boundUs <<= 1;
+        }
+
+        /* The last bucket has no upper bound. */
+        if( ( bucket == ( AGENT_LATENCY_HISTOGRAM_BUCKETS - 1U ) ) || ( boundUs > pHistogram->maxUs ) )
+        {
+            boundUs = pHistogram->maxUs;
+        }
+    }
+    else
+    {
+        boundUs = 0U;
+    }
+
+    return boundUs;
+}
+/*-----------------------------------------------------------*/
+
+#if ( AGENT_LATENCY_TRACING == 1 ) && defined( CONFIG_SHELL )
+
+    static int latencyShellCommand( const struct shell * pShell,
+                                    size_t argc,
+                                    char ** argv )
+    {
+        static const char * const commandNames[ NUM_COMMANDS ] =
+        {
+            "NONE",    "PROCESSLOOP", "PUBLISH",    "SUBSCRIBE", "UNSUBSCRIBE",
+            "PING",    "CONNECT",     "DISCONNECT", "TERMINATE"
+        };
+        static const char * const stageNames[ AGENT_LATENCY_STAGES ] =
+        {
+            "pool wait", "queue wait", "processing", "ack wait", "total"
+        };
+        AgentLatencyStats_t stats;
+        const AgentLatencyHistogram_t * pHistogram = NULL;
+        bool reset = false;
+        int ret = 0;
+        size_t type = 0U, stage = 0U;
+
+        if( argc > 1 )
+        {
+            if( strcmp( argv[ 1 ], "reset" ) == 0 )
+            {
+                reset = true;
+            }
+            else
+            {
+                shell_error( pShell, "Unknown argument: %s", argv[ 1 ] );
+                ret = -EINVAL;
+            }
+        }
+
+        for( type = 0U; ( ret == 0 ) && ( type < ( size_t ) NUM_COMMANDS ); type++ )
+        {
+            AgentLatency_GetStats( ( MQTTAgentCommandType_t ) type, &stats, reset );
+
+            if( stats.stages[ AGENT_LATENCY_STAGE_POOL_WAIT ].count > 0U )
+            {
+                shell_print( pShell, "%s:", ( commandNames[ type ] != NULL ) ? commandNames[ type ] : "?" );
+
+                for( stage = 0U; stage < AGENT_LATENCY_STAGES; stage++ )
+                {
+                    pHistogram = &( stats.stages[ stage ] );
+
+                    if( pHistogram->count > 0U )
+                    {
+                        shell_print( pShell,
+                                     "  %-10s n=%u mean=%uus p50=%uus p90=%uus p99=%uus max=%uus",
+                                     stageNames[ stage ],
+                                     ( unsigned int ) pHistogram->count,
+                                     ( unsigned int ) ( pHistogram->totalUs / pHistogram->count ),
+                                     ( unsigned int ) AgentLatency_PercentileUs( pHistogram, 50U ),
+                                     ( unsigned int ) AgentLatency_PercentileUs( pHistogram, 90U ),
+                                     ( unsigned int ) AgentLatency_PercentileUs( pHistogram, 99U ),
+                                     ( unsigned int ) pHistogram->maxUs );
+                    }
+                }
+            }
+        }
+
+        return ret;
+    }
+
+    SHELL_STATIC_SUBCMD_SET_CREATE( agentShellCommands,
+                                    SHELL_CMD_ARG( latency, NULL,
+                                                   "Print the command latency histograms. "
+                                                   "Usage: latency [reset]",
+                                                   latencyShellCommand, 1, 1 ),
+                                    SHELL_SUBCMD_SET_END );
+
+    SHELL_CMD_REGISTER( mqtt_agent, &agentShellCommands, "MQTT agent commands", NULL );
+/*-----------------------------------------------------------*/
+
+#endif /* if ( AGENT_LATENCY_TRACING == 1 ) && defined( CONFIG_SHELL ) */
@@ -0,0 +1,747 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * @file agent_runner_zephyr.c
+ * @brief Serves the MQTT agents of several connections from one thread.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+/* Zephyr includes. */
+#include <net/socket.h>
+#include <posix/sys/eventfd.h>
+
+/* Agent runner header */
+#include "agent_runner_zephyr.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Number of descriptors polled by the runner: a wakeup eventfd and a
+ * socket for each connection, and the wakeup eventfd of the runner.
+ */
+#define RUNNER_POLL_FDS                   ( 1U + ( 2U * AGENT_RUNNER_MAX_CONNECTIONS ) )
+
+/**
+ * @brief Timeout of the MQTT process loop runs, which only read the data
+ * already received.
+ */
+#define RUNNER_PROCESS_LOOP_TIMEOUT_MS    ( 0U )
+
+/**
+ * @brief State of a connection served by the runner.
+ */
+typedef struct AgentRunnerConnection
+{
+    MQTTAgentContext_t * pAgentContext;             /**< @brief Agent of the connection. */
+    AgentRunnerLoopExitCallback_t loopExitCallback; /**< @brief Called when the connection ends. */
+    int64_t nextServiceMs;                          /**< @brief Uptime by which the connection gets a turn, even if idle; see #getNextService. */
+    atomic_t connected;                             /**< @brief Whether the connection is up; not served otherwise. */
+    bool active;                                    /**< @brief Whether the connection is still served. */
+} AgentRunnerConnection_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Connections served by the runner. Only the runner thread removes
+ * connections, so the entries below #connectionCount do not move while it
+ * serves them.
+ */
+static AgentRunnerConnection_t connections[ AGENT_RUNNER_MAX_CONNECTIONS ];
+
+/**
+ * @brief Number of entries of #connections in use.
+ */
+static size_t connectionCount = 0U;
+
+/**
+ * @brief Guards #connections and #connectionCount against
+ * #AgentRunner_AddConnection, #AgentRunner_ResumeConnection and
+ * #AgentRunner_RemoveConnection.
+ */
+K_MUTEX_DEFINE( connectionsMutex );
+
+/**
+ * @brief eventfd signalled when a connection is added, resumed or removed, so
+ * that the runner stops waiting; -1 if unavailable.
+ */
+static int runnerWakeupFd = -1;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check whether received data awaits the agent of a connection.
+ *
+ * @param[in] pMsgCtx Message context of the connection.
+ *
+ * @return `true` if the socket is readable or the transport buffers data.
+ */
+static bool connectionHasData( MQTTAgentMessageContext_t * pMsgCtx );
+
+/**
+ * @brief Read the uptime by which a connection gets a turn.
+ *
+ * #AgentRunner_ResumeConnection writes it from other threads, so it is only
+ * accessed under #connectionsMutex, as a 64-bit access may tear on 32-bit
+ * targets.
+ *
+ * @param[in] pConnection The connection.
+ *
+ * @return #AgentRunnerConnection_t.nextServiceMs.
+ */
+static int64_t getNextService( const AgentRunnerConnection_t * pConnection );
+
+/**
+ * @brief Set the uptime by which a connection gets a turn, as
+ * #getNextService reads it.
+ *
+ * @param[in] pConnection The connection.
+ * @param[in] nextServiceMs The uptime.
+ */
+static void setNextService( AgentRunnerConnection_t * pConnection,
+                            int64_t nextServiceMs );
+
+/**
+ * @brief Check whether a connection needs a turn without waiting for its
+ * descriptors: it has commands to hand out, buffered data, or its keep-alive
+ * is due.
+ *
+ * @param[in] pConnection The connection.
+ * @param[in] nowMs Current uptime.
+ *
+ * @return `true` if the connection needs a turn.
+ */
+static bool connectionIsReady( AgentRunnerConnection_t * pConnection,
+                               int64_t nowMs );
+
+/**
+ * @brief Wait until any connection needs a turn.
+ *
+ * @param[in] count Number of connections to wait on.
+ * @param[out] pReady Whether each connection needs a turn.
+ */
+static void waitForConnections( size_t count,
+                                bool * pReady );
+
+/**
+ * @brief Take a free entry of the acknowledgments awaited by an agent.
+ *
+ * @param[in] pAgentContext The agent.
+ *
+ * @return The entry, or NULL if #MQTT_AGENT_MAX_OUTSTANDING_ACKS are awaited.
+ */
+static MQTTAgentAckInfo_t * getFreeAck( MQTTAgentContext_t * pAgentContext );
+
+/**
+ * @brief Complete a command: call its callback and release it.
+ *
+ * @param[in] pAgentContext Agent of the command.
+ * @param[in] pCommand The command.
+ * @param[in] status Status of the command.
+ */
+static void concludeCommand( MQTTAgentContext_t * pAgentContext,
+                             MQTTAgentCommand_t * pCommand,
+                             MQTTStatus_t status );
+
+/**
+ * @brief Carry out a command of the agent of a connection, as its command loop
+ * would.
+ *
+ * Commands awaiting an acknowledgment are recorded in the acknowledgments of
+ * the agent, and completed by the agent once the acknowledgment is received in
+ * the MQTT process loop. The others are completed at once.
+ *
+ * @param[in] pAgentContext Agent of the connection.
+ * @param[in] pCommand The command.
+ * @param[out] pEndLoop Set to `true` if the command ends the connection.
+ *
+ * @return Status of the MQTT operation, which ends the connection unless it is
+ * #MQTTSuccess.
+ */
+static MQTTStatus_t processCommand( MQTTAgentContext_t * pAgentContext,
+                                    MQTTAgentCommand_t * pCommand,
+                                    bool * pEndLoop );
+
+/**
+ * @brief Give a connection one turn: carry out its queued commands and run the
+ * MQTT process loop, and call its loop exit callback if the connection ended.
+ *
+ * @param[in] pConnection The connection.
+ */
+static void serveConnection( AgentRunnerConnection_t * pConnection );
+
+/*-----------------------------------------------------------*/
+
+static bool connectionHasData( MQTTAgentMessageContext_t * pMsgCtx )
+{
+    bool dataPending = false;
+    struct zsock_pollfd pollFd;
+
+    if( pMsgCtx->pendingDataCheck != NULL )
+    {
+        dataPending = pMsgCtx->pendingDataCheck( pMsgCtx->pNetworkContext );
+    }
+
+    if( ( dataPending == false ) && ( pMsgCtx->socket >= 0 ) )
+    {
+        pollFd.fd = pMsgCtx->socket;
+        pollFd.events = ZSOCK_POLLIN | ZSOCK_POLLPRI;
+        pollFd.revents = 0;
+
+        dataPending = ( zsock_poll( &pollFd, 1, 0 ) > 0 );
+    }
+
+    return dataPending;
+}
+/*-----------------------------------------------------------*/
+
+static int64_t getNextService( const AgentRunnerConnection_t * pConnection )
+{
+    int64_t nextServiceMs = 0;
+
+    ( void ) k_mutex_lock( &connectionsMutex, K_FOREVER );
+    nextServiceMs = pConnection->nextServiceMs;
+    ( void ) k_mutex_unlock( &connectionsMutex );
+
+    return nextServiceMs;
+}
+/*-----------------------------------------------------------*/
+
+static void setNextService( AgentRunnerConnection_t * pConnection,
+                            int64_t nextServiceMs )
+{
+    ( void ) k_mutex_lock( &connectionsMutex, K_FOREVER );
+    pConnection->nextServiceMs = nextServiceMs;
+    ( void ) k_mutex_unlock( &connectionsMutex );
+}
+/*-----------------------------------------------------------*/
+
+static bool connectionIsReady( AgentRunnerConnection_t * pConnection,
+                               int64_t nowMs )
+{
+    MQTTAgentMessageContext_t * pMsgCtx = pConnection->pAgentContext->agentInterface.pMsgCtx;
+    bool ready = false;
+
+    /* Commands left over by a turn that spent its budget do not signal the
+     * eventfd again. */
+    if( ( k_sem_count_get( &( pMsgCtx->pendingCommands ) ) > 0U ) ||
+        ( pMsgCtx->batchIndex < pMsgCtx->batchCount ) )
+    {
+        ready = true;
+    }
+    else if( ( pMsgCtx->pendingDataCheck != NULL ) &&
+             ( pMsgCtx->pendingDataCheck( pMsgCtx->pNetworkContext ) == true ) )
+    {
+        ready = true;
+    }
+    else
+    {
+        ready = ( nowMs >= getNextService( pConnection ) );
+    }
+
+    return ready;
+}
+/*-----------------------------------------------------------*/
+
+static void waitForConnections( size_t count,
+                                bool * pReady )
+{
+    struct zsock_pollfd pollFds[ RUNNER_POLL_FDS ];
+    size_t fdConnection[ RUNNER_POLL_FDS ];
+    MQTTAgentMessageContext_t * pMsgCtx = NULL;
+    int64_t nowMs = k_uptime_get(), nextServiceMs = INT64_MAX, connectionServiceMs = 0;
+    eventfd_t wakeupCount = 0;
+    size_t index = 0U, fdCount = 0U;
+    bool anyReady = false;
+    int pollStatus = 0, timeoutMs = 0;
+
+    for( index = 0U; index < count; index++ )
+    {
+        pReady[ index ] = false;
+
+        /* The commands of a connection being re-established wait for it. */
+        if( atomic_get( &( connections[ index ].connected ) ) != 0 )
+        {
+            pReady[ index ] = connectionIsReady( &( connections[ index ] ), nowMs );
+            anyReady = anyReady || pReady[ index ];
+
+            connectionServiceMs = getNextService( &( connections[ index ] ) );
+
+            if( connectionServiceMs < nextServiceMs )
+            {
+                nextServiceMs = connectionServiceMs;
+            }
+
+            pMsgCtx = connections[ index ].pAgentContext->agentInterface.pMsgCtx;
+
+            if( pMsgCtx->wakeupFd >= 0 )
+            {
+                pollFds[ fdCount ].fd = pMsgCtx->wakeupFd;
+                pollFds[ fdCount ].events = ZSOCK_POLLIN;
+                pollFds[ fdCount ].revents = 0;
+                fdConnection[ fdCount ] = index;
+                fdCount++;
+            }
+
+            if( pMsgCtx->socket >= 0 )
+            {
+                pollFds[ fdCount ].fd = pMsgCtx->socket;
+                pollFds[ fdCount ].events = ZSOCK_POLLIN | ZSOCK_POLLPRI;
+                pollFds[ fdCount ].revents = 0;
+                fdConnection[ fdCount ] = index;
+                fdCount++;
+            }
+        }
+    }
+
+    if( runnerWakeupFd >= 0 )
+    {
+        pollFds[ fdCount ].fd = runnerWakeupFd;
+        pollFds[ fdCount ].events = ZSOCK_POLLIN;
+        pollFds[ fdCount ].revents = 0;
+        fdConnection[ fdCount ] = count;
+        fdCount++;
+    }
+
+    /* Still poll when a connection is ready, to collect the others. */
+    if( ( anyReady == false ) && ( nextServiceMs > nowMs ) )
+    {
+        timeoutMs = ( int ) MIN( nextServiceMs - nowMs, ( int64_t ) AGENT_RUNNER_SERVICE_INTERVAL_MS );
+    }
+
+    pollStatus = zsock_poll( pollFds, ( int ) fdCount, timeoutMs );
+
+    if( pollStatus < 0 )
+    {
+        LogError( ( "Failed to poll the agent connections: errno=%d.", errno ) );
+
+        /* Do not spin on descriptors that cannot be polled. */
+        ( void ) k_sleep( K_MSEC( timeoutMs ) );
+    }
+
+    for( index = 0U; ( pollStatus > 0 ) && ( index < fdCount ); index++ )
+    {
+        if( pollFds[ index ].revents != 0 )
+        {
+            /* Wakeup eventfds are reset before the queues are read, so that
+             * no wakeup is lost. */
+            if( pollFds[ index ].fd == runnerWakeupFd )
+            {
+                ( void ) eventfd_read( runnerWakeupFd, &wakeupCount );
+            }
+            else if( pollFds[ index ].fd != connections[ fdConnection[ index ] ].pAgentContext->agentInterface.pMsgCtx->socket )
+            {
+                ( void ) eventfd_read( pollFds[ index ].fd, &wakeupCount );
+                pReady[ fdConnection[ index ] ] = true;
+            }
+            else
+            {
+                pReady[ fdConnection[ index ] ] = true;
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static MQTTAgentAckInfo_t * getFreeAck( MQTTAgentContext_t * pAgentContext )
+{
+    MQTTAgentAckInfo_t * pAck = NULL;
+    size_t index = 0U;
+
+    for( index = 0U; ( index < MQTT_AGENT_MAX_OUTSTANDING_ACKS ) && ( pAck == NULL ); index++ )
+    {
+        if( pAgentContext->pPendingAcks[ index ].packetId == MQTT_PACKET_ID_INVALID )
+        {
+            pAck = &( pAgentContext->pPendingAcks[ index ] );
+        }
+    }
+
+    return pAck;
+}
+/*-----------------------------------------------------------*/
+
+static void concludeCommand( MQTTAgentContext_t * pAgentContext,
+                             MQTTAgentCommand_t * pCommand,
+                             MQTTStatus_t status )
+{
+    MQTTAgentReturnInfo_t returnInfo;
+
+    ( void ) memset( &returnInfo, 0x00, sizeof( returnInfo ) );
+    returnInfo.returnCode = status;
+
+    if( pCommand->pCommandCompleteCallback != NULL )
+    {
+        pCommand->pCommandCompleteCallback( pCommand->pCmdContext, &returnInfo );
+    }
+
+    ( void ) pAgentContext->agentInterface.releaseCommand( pCommand );
+}
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t processCommand( MQTTAgentContext_t * pAgentContext,
+                                    MQTTAgentCommand_t * pCommand,
+                                    bool * pEndLoop )
+{
+    MQTTContext_t * pMqttContext = &( pAgentContext->mqttContext );
+    MQTTPublishInfo_t * pPublishInfo = NULL;
+    MQTTAgentSubscribeArgs_t * pSubscribeArgs = NULL;
+    MQTTAgentConnectArgs_t * pConnectArgs = NULL;
+    MQTTAgentAckInfo_t * pAck = NULL;
+    MQTTStatus_t status = MQTTSuccess;
+    uint16_t packetId = MQTT_PACKET_ID_INVALID;
+    bool awaitsAck = false;
+
+    /* Take the entry of the acknowledgment before sending, so that no packet
+     * is sent whose acknowledgment would be dropped. */
+    if( ( pCommand->commandType == SUBSCRIBE ) || ( pCommand->commandType == UNSUBSCRIBE ) ||
+        ( ( pCommand->commandType == PUBLISH ) &&
+          ( ( ( MQTTPublishInfo_t * ) pCommand->pArgs )->qos != MQTTQoS0 ) ) )
+    {
+        awaitsAck = true;
+        pAck = getFreeAck( pAgentContext );
+    }
+
+    if( ( awaitsAck == true ) && ( pAck == NULL ) )
+    {
+        LogError( ( "Failed to send an agent command: %u acknowledgments are awaited already.",
+                    ( unsigned int ) MQTT_AGENT_MAX_OUTSTANDING_ACKS ) );
+        concludeCommand( pAgentContext, pCommand, MQTTNoMemory );
+    }
+    else
+    {
+        if( awaitsAck == true )
+        {
+            packetId = MQTT_GetPacketId( pMqttContext );
+        }
+
+        switch( pCommand->commandType )
+        {
+            case PUBLISH:
+                pPublishInfo = ( MQTTPublishInfo_t * ) pCommand->pArgs;
+                status = MQTT_Publish( pMqttContext, pPublishInfo, packetId );
+                break;
+
+            case SUBSCRIBE:
+                pSubscribeArgs = ( MQTTAgentSubscribeArgs_t * ) pCommand->pArgs;
+                status = MQTT_Subscribe( pMqttContext,
+                                         pSubscribeArgs->pSubscribeInfo,
+                                         pSubscribeArgs->numSubscriptions,
+                                         packetId );
+                break;
+
+            case UNSUBSCRIBE:
+                pSubscribeArgs = ( MQTTAgentSubscribeArgs_t * ) pCommand->pArgs;
+                status = MQTT_Unsubscribe( pMqttContext,
+                                           pSubscribeArgs->pSubscribeInfo,
+                                           pSubscribeArgs->numSubscriptions,
+                                           packetId );
+                break;
+
+            case PING:
+                status = MQTT_Ping( pMqttContext );
+                break;
+
+            case CONNECT:
+                pConnectArgs = ( MQTTAgentConnectArgs_t * ) pCommand->pArgs;
+                status = MQTT_Connect( pMqttContext,
+                                       pConnectArgs->pConnectInfo,
+                                       pConnectArgs->pWillInfo,
+                                       pConnectArgs->timeoutMs,
+                                       &( pConnectArgs->sessionPresent ) );
+
+                if( status == MQTTSuccess )
+                {
+                    status = MQTTAgent_ResumeSession( pAgentContext, pConnectArgs->sessionPresent );
+                }
+
+                break;
+
+            case DISCONNECT:
+                status = MQTT_Disconnect( pMqttContext );
+                *pEndLoop = true;
+                break;
+
+            case TERMINATE:
+                LogInfo( ( "Terminating the agent connection." ) );
+                ( void ) MQTTAgent_CancelAll( pAgentContext );
+                *pEndLoop = true;
+                break;
+
+            default:
+                status = MQTT_ProcessLoop( pMqttContext, RUNNER_PROCESS_LOOP_TIMEOUT_MS );
+                break;
+        }
+
+        if( ( awaitsAck == true ) && ( status == MQTTSuccess ) )
+        {
+            /* The agent completes the command when it receives the
+             * acknowledgment. */
+            pAck->packetId = packetId;
+            pAck->pOriginalCommand = pCommand;
+        }
+        else
+        {
+            concludeCommand( pAgentContext, pCommand, status );
+        }
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+static void serveConnection( AgentRunnerConnection_t * pConnection )
+{
+    MQTTAgentContext_t * pAgentContext = pConnection->pAgentContext;
+    MQTTAgentMessageContext_t * pMsgCtx = pAgentContext->agentInterface.pMsgCtx;
+    MQTTAgentCommand_t * pCommand = NULL;
+    MQTTStatus_t status = MQTTSuccess;
+    uint32_t steps = 0U;
+    bool endLoop = false, processLoopRun = false, idle = false;
+
+    while( ( status == MQTTSuccess ) && ( endLoop == false ) &&
+           ( idle == false ) && ( steps < AGENT_RUNNER_TURN_BUDGET ) )
+    {
+        steps++;
+        pCommand = NULL;
+
+        if( Agent_MessageReceive( pMsgCtx, &pCommand, 0U ) == true )
+        {
+            status = processCommand( pAgentContext, pCommand, &endLoop );
+        }
+        else if( ( processLoopRun == false ) || ( connectionHasData( pMsgCtx ) == true ) )
+        {
+            /* The process loop runs at least once a turn, which services the
+             * keep-alive, and again while data is received. */
+            processLoopRun = true;
+            status = MQTT_ProcessLoop( &( pAgentContext->mqttContext ), RUNNER_PROCESS_LOOP_TIMEOUT_MS );
+        }
+        else
+        {
+            idle = true;
+        }
+    }
+
+    if( ( status != MQTTSuccess ) || ( endLoop == true ) )
+    {
+        /* Serve the connection again once the application resumes it. */
+        ( void ) atomic_set( &( pConnection->connected ), 0 );
+
+        if( pConnection->loopExitCallback != NULL )
+        {
+            pConnection->active = pConnection->loopExitCallback( pAgentContext, status );
+        }
+        else
+        {
+            LogInfo( ( "MQTT agent connection ended: status=%s.", MQTT_Status_strerror( status ) ) );
+            pConnection->active = false;
+        }
+    }
+
+    setNextService( pConnection, k_uptime_get() + AGENT_RUNNER_SERVICE_INTERVAL_MS );
+}
+/*-----------------------------------------------------------*/
+
+void AgentRunner_Init( void )
+{
+    connectionCount = 0U;
+    runnerWakeupFd = eventfd( 0, EFD_NONBLOCK );
+
+    if( runnerWakeupFd < 0 )
+    {
+        LogWarn( ( "Failed to create the agent runner wakeup eventfd: errno=%d. "
+                   "Added connections wait for the next service interval.", errno ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+bool AgentRunner_AddConnection( MQTTAgentContext_t * pAgentContext,
+                                AgentRunnerLoopExitCallback_t loopExitCallback )
+{
+    bool added = false;
+    AgentRunnerConnection_t * pConnection = NULL;
+
+    assert( pAgentContext != NULL );
+
+    ( void ) k_mutex_lock( &connectionsMutex, K_FOREVER );
+
+    if( connectionCount < AGENT_RUNNER_MAX_CONNECTIONS )
+    {
+        pConnection = &( connections[ connectionCount ] );
+        ( void ) memset( pConnection, 0x00, sizeof( AgentRunnerConnection_t ) );
+        pConnection->pAgentContext = pAgentContext;
+        pConnection->loopExitCallback = loopExitCallback;
+        pConnection->nextServiceMs = k_uptime_get();
+        ( void ) atomic_set( &( pConnection->connected ), 1 );
+        pConnection->active = true;
+        connectionCount++;
+        added = true;
+    }
+
+    ( void ) k_mutex_unlock( &connectionsMutex );
+
+    if( added == false )
+    {
+        LogError( ( "Failed to add an agent connection: the runner serves %u connections already.",
+                    ( unsigned int ) AGENT_RUNNER_MAX_CONNECTIONS ) );
+    }
+    else if( runnerWakeupFd >= 0 )
+    {
+        ( void ) eventfd_write( runnerWakeupFd, 1 );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return added;
+}
+/*-----------------------------------------------------------*/
+
+bool AgentRunner_ResumeConnection( MQTTAgentContext_t * pAgentContext )
+{
+    bool resumed = false;
+    size_t index = 0U;
+
+    assert( pAgentContext != NULL );
+
+    ( void ) k_mutex_lock( &connectionsMutex, K_FOREVER );
+
+    for( index = 0U; ( index < connectionCount ) && ( resumed == false ); index++ )
+    {
+        if( ( connections[ index ].pAgentContext == pAgentContext ) &&
+            ( connections[ index ].active == true ) )
+        {
+            connections[ index ].nextServiceMs = k_uptime_get();
+            ( void ) atomic_set( &( connections[ index ].connected ), 1 );
+            resumed = true;
+        }
+    }
+
+    ( void ) k_mutex_unlock( &connectionsMutex );
+
+    if( resumed == false )
+    {
+        LogError( ( "Failed to resume an agent connection: the runner does not serve it." ) );
+    }
+    else if( runnerWakeupFd >= 0 )
+    {
+        ( void ) eventfd_write( runnerWakeupFd, 1 );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return resumed;
+}
+/*-----------------------------------------------------------*/
+
+bool AgentRunner_RemoveConnection( MQTTAgentContext_t * pAgentContext )
+{
+    bool removed = false;
+    size_t index = 0U;
+
+    assert( pAgentContext != NULL );
+
+    ( void ) k_mutex_lock( &connectionsMutex, K_FOREVER );
+
+    for( index = 0U; ( index < connectionCount ) && ( removed == false ); index++ )
+    {
+        /* Only a connection that is not served can be removed, so that its
+         * turn is not cut short. */
+        if( ( connections[ index ].pAgentContext == pAgentContext ) &&
+            ( atomic_get( &( connections[ index ].connected ) ) == 0 ) )
+        {
+            connections[ index ].active = false;
+            removed = true;
+        }
+    }
+
+    ( void ) k_mutex_unlock( &connectionsMutex );
+
+    if( removed == false )
+    {
+        LogError( ( "Failed to remove an agent connection: the runner does not hold it ended." ) );
+    }
+    else if( runnerWakeupFd >= 0 )
+    {
+        ( void ) eventfd_write( runnerWakeupFd, 1 );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return removed;
+}
+/*-----------------------------------------------------------*/
+
+void AgentRunner_Run( void )
+{
+    bool ready[ AGENT_RUNNER_MAX_CONNECTIONS ];
+    size_t count = 0U, index = 0U, kept = 0U;
+
+    ( void ) k_mutex_lock( &connectionsMutex, K_FOREVER );
+    count = connectionCount;
+    ( void ) k_mutex_unlock( &connectionsMutex );
+
+    while( count > 0U )
+    {
+        waitForConnections( count, ready );
+
+        for( index = 0U; index < count; index++ )
+        {
+            if( ready[ index ] == true )
+            {
+                serveConnection( &( connections[ index ] ) );
+            }
+        }
+
+        /* Drop the ended connections, and pick up those added meanwhile. */
+        ( void ) k_mutex_lock( &connectionsMutex, K_FOREVER );
+
+        for( index = 0U, kept = 0U; index < connectionCount; index++ )
+        {
+            if( connections[ index ].active == true )
+            {
+                if( kept != index )
+                {
+                    connections[ kept ] = connections[ index ];
+                }
+
+                kept++;
+            }
+        }
+
+        connectionCount = kept;
+        count = connectionCount;
+        ( void ) k_mutex_unlock( &connectionsMutex );
+    }
+
+    LogInfo( ( "MQTT agent runner has no connection left to serve." ) );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,612 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file offline_queue.c
+ * @brief Flash ring log of the publishes made while the MQTT connection is
+ * down.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+/* Zephyr includes. */
+#include <fs/fcb.h>
+
+/* Offline queue header include. */
+#include "offline_queue.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Magic value of the sectors of the log.
+ */
+#define OFFLINE_QUEUE_MAGIC            ( 0x4F51554EUL )
+
+/**
+ * @brief Bytes of a record before its topic: the QoS and the length of the
+ * topic, little endian.
+ */
+#define RECORD_HEADER_SIZE             ( 3U )
+
+/**
+ * @brief First byte of a commit record, in place of the QoS of a publish.
+ */
+#define RECORD_TYPE_COMMIT             ( 0x80U )
+
+/**
+ * @brief Size of a commit record: its type, the index in #offlineSectors of
+ * the sector of the last acknowledged record and its offset in the sector,
+ * little endian.
+ */
+#define COMMIT_RECORD_SIZE             ( 6U )
+
+/**
+ * @brief Largest write block of the flash, by which a record written to
+ * flash is padded.
+ */
+#define OFFLINE_QUEUE_MAX_WRITE_ALIGN  ( 32U )
+
+/**
+ * @brief A record published as part of the batch being drained.
+ */
+typedef struct OfflineDrainSlot
+{
+    MQTTPublishInfo_t publishInfo;                    /**< @brief Publish pointing into #OfflineDrainSlot_t.record. */
+    uint8_t record[ OFFLINE_QUEUE_MAX_RECORD_SIZE ]; /**< @brief The record read from flash. */
+} OfflineDrainSlot_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The flash circular buffer holding the records.
+ */
+static struct fcb offlineFcb;
+
+/**
+ * @brief Sectors of the flash area of #offlineFcb.
+ */
+static struct flash_sector offlineSectors[ OFFLINE_QUEUE_MAX_SECTORS ];
+
+/**
+ * @brief Last record of the log acknowledged by the broker, or a location
+ * without sector before the first record. It is kept across restarts by the
+ * commit records appended to the log.
+ */
+static struct fcb_entry committedLocation;
+
+/**
+ * @brief Last record read for the batch being drained.
+ */
+static struct fcb_entry drainLocation;
+
+/**
+ * @brief Records of the batch being drained.
+ */
+static OfflineDrainSlot_t drainSlots[ OFFLINE_QUEUE_DRAIN_BATCH ];
+
+/**
+ * @brief Record being written to flash, padded to the write block.
+ */
+static uint8_t __aligned( 4 ) writeBuffer[ OFFLINE_QUEUE_MAX_RECORD_SIZE + OFFLINE_QUEUE_MAX_WRITE_ALIGN ];
+
+static size_t batchOutstanding = 0U; /**< @brief Publishes of the batch not completed yet. */
+static bool batchPending = false;    /**< @brief Whether a batch was published and not settled yet. */
+static bool batchFailed = false;     /**< @brief Whether a publish of the batch failed. */
+static bool queueConnected = false;  /**< @brief Whether the connection is up. */
+static bool queueReady = false;      /**< @brief Whether #offlineFcb was initialized. */
+
+/**
+ * @brief Agent publishing the records.
+ */
+static MQTTAgentContext_t * pQueueAgentContext = NULL;
+
+/**
+ * @brief Guards the log and the state of the drain.
+ */
+K_MUTEX_DEFINE( offlineQueueMutex );
+
+/**
+ * @brief Work item publishing each batch.
+ */
+static struct k_work_delayable drainWork;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Erase the oldest sector of the log, forgetting the positions in it.
+ */
+static void dropOldestSector( void );
+
+/**
+ * @brief Erase the sectors whose records have all been acknowledged.
+ */
+static void releaseCommittedSectors( void );
+
+/**
+ * @brief Append the record held in #writeBuffer to the log.
+ *
+ * @param[in] recordLength Length of the record.
+ *
+ * @return 0 on success, -ENOSPC if the log is full, else a flash error.
+ */
+static int appendRecord( size_t recordLength );
+
+/**
+ * @brief Append a commit record holding #committedLocation, so that its
+ * records are not published again after a restart.
+ */
+static void persistCommittedLocation( void );
+
+/**
+ * @brief Find #committedLocation from the last commit record of the log.
+ */
+static void recoverCommittedLocation( void );
+
+/**
+ * @brief Read the record following #drainLocation into a slot, skipping
+ * commit records.
+ *
+ * @param[out] pSlot The slot.
+ *
+ * @return `true` if a record was read, `false` at the end of the log.
+ */
+static bool readNextRecord( OfflineDrainSlot_t * pSlot );
+
+/**
+ * @brief Work handler settling the previous batch and publishing the next.
+ *
+ * @param[in] pWork #drainWork.
+ */
+static void drainWorkHandler( struct k_work * pWork );
+
+/**
+ * @brief Completion callback of the publishes of a batch.
+ *
+ * @param[in] pCmdContext The #OfflineDrainSlot_t of the publish.
+ * @param[in] pReturnInfo Result of the publish.
+ */
+static void drainPublishCallback( MQTTAgentCommandContext_t * pCmdContext,
+                                  MQTTAgentReturnInfo_t * pReturnInfo );
+
+/*-----------------------------------------------------------*/
+
+static void dropOldestSector( void )
+{
+    if( committedLocation.fe_sector == offlineFcb.f_oldest )
+    {
+        committedLocation.fe_sector = NULL;
+    }
+
+    if( drainLocation.fe_sector == offlineFcb.f_oldest )
+    {
+        drainLocation.fe_sector = NULL;
+    }
+
+    if( fcb_rotate( &offlineFcb ) != 0 )
+    {
+        LogError( ( "Failed to erase the oldest sector of the offline queue." ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void releaseCommittedSectors( void )
+{
+    /* The sector of the last acknowledged record is kept, as it may hold
+     * records after it. */
+    while( ( committedLocation.fe_sector != NULL ) &&
+           ( committedLocation.fe_sector != offlineFcb.f_oldest ) )
+    {
+        if( fcb_rotate( &offlineFcb ) != 0 )
+        {
+            LogError( ( "Failed to erase a drained sector of the offline queue." ) );
+            break;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static int appendRecord( size_t recordLength )
+{
+    struct fcb_entry location = { 0 };
+    size_t writeLength = 0U;
+    int ret = 0;
+
+    /* The FCB reserves the record length rounded up to the write block,
+     * which is written whole. */
+    writeLength = ROUND_UP( recordLength, MAX( offlineFcb.f_align, 1U ) );
+    ( void ) memset( &( writeBuffer[ recordLength ] ), offlineFcb.f_erase_value, writeLength - recordLength );
+
+    ret = fcb_append( &offlineFcb, ( uint16_t ) recordLength, &location );
+
+    if( ret == 0 )
+    {
+        ret = flash_area_write( offlineFcb.fap, FCB_ENTRY_FA_DATA_OFF( location ), writeBuffer, writeLength );
+    }
+
+    if( ret == 0 )
+    {
+        ret = fcb_append_finish( &offlineFcb, &location );
+    }
+
+    return ret;
+}
+/*-----------------------------------------------------------*/
+
+static void persistCommittedLocation( void )
+{
+    uint32_t offset = committedLocation.fe_elem_off;
+    int ret = 0;
+
+    if( committedLocation.fe_sector != NULL )
+    {
+        writeBuffer[ 0 ] = ( uint8_t ) RECORD_TYPE_COMMIT;
+        writeBuffer[ 1 ] = ( uint8_t ) ( committedLocation.fe_sector - offlineSectors );
+        writeBuffer[ 2 ] = ( uint8_t ) ( offset & 0xFFU );
+        writeBuffer[ 3 ] = ( uint8_t ) ( ( offset >> 8 ) & 0xFFU );
+        writeBuffer[ 4 ] = ( uint8_t ) ( ( offset >> 16 ) & 0xFFU );
+        writeBuffer[ 5 ] = ( uint8_t ) ( offset >> 24 );
+
+        /* No sector is dropped for a commit record, as that would drop
+         * records not acknowledged yet. */
+        ret = appendRecord( COMMIT_RECORD_SIZE );
+
+        if( ret != 0 )
+        {
+            LogWarn( ( "Failed to record the acknowledged publishes of the offline queue, "
+                       "which a restart publishes again: ret=%d.", ret ) );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void recoverCommittedLocation( void )
+{
+    struct fcb_entry location = { 0 };
+    uint8_t record[ COMMIT_RECORD_SIZE ];
+    bool sectorSeen[ OFFLINE_QUEUE_MAX_SECTORS ] = { false };
+    uint8_t sectorIndex = 0U;
+
+    ( void ) memset( &committedLocation, 0x00, sizeof( committedLocation ) );
+
+    while( fcb_getnext( &offlineFcb, &location ) == 0 )
+    {
+        sectorSeen[ location.fe_sector - offlineSectors ] = true;
+
+        if( ( location.fe_data_len == COMMIT_RECORD_SIZE ) &&
+            ( flash_area_read( offlineFcb.fap, FCB_ENTRY_FA_DATA_OFF( location ), record, COMMIT_RECORD_SIZE ) == 0 ) &&
+            ( record[ 0 ] == ( uint8_t ) RECORD_TYPE_COMMIT ) )
+        {
+            sectorIndex = record[ 1 ];
+
+            /* The acknowledged record precedes its commit record, so its
+             * sector was already seen unless it was dropped since, with the
+             * records before it. */
+            if( ( sectorIndex < offlineFcb.f_sector_cnt ) && ( sectorSeen[ sectorIndex ] == true ) )
+            {
+                committedLocation.fe_sector = &( offlineSectors[ sectorIndex ] );
+                committedLocation.fe_elem_off = ( uint32_t ) record[ 2 ] |
+                                                ( ( uint32_t ) record[ 3 ] << 8 ) |
+                                                ( ( uint32_t ) record[ 4 ] << 16 ) |
+                                                ( ( uint32_t ) record[ 5 ] << 24 );
+            }
+            else
+            {
+                ( void ) memset( &committedLocation, 0x00, sizeof( committedLocation ) );
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static bool readNextRecord( OfflineDrainSlot_t * pSlot )
+{
+    bool recordRead = false;
+    uint16_t topicLength = 0U;
+
+    /* Unreadable records are skipped, so that they do not block the log. */
+    while( ( recordRead == false ) && ( fcb_getnext( &offlineFcb, &drainLocation ) == 0 ) )
+    {
+        if( ( drainLocation.fe_data_len < RECORD_HEADER_SIZE ) ||
+            ( drainLocation.fe_data_len > OFFLINE_QUEUE_MAX_RECORD_SIZE ) ||
+            ( flash_area_read( offlineFcb.fap,
+                               FCB_ENTRY_FA_DATA_OFF( drainLocation ),
+                               pSlot->record,
+                               drainLocation.fe_data_len ) != 0 ) )
+        {
+            LogError( ( "Skipping an unreadable offline queue record of %u bytes.",
+                        ( unsigned int ) drainLocation.fe_data_len ) );
+        }
+        else
+        {
+            topicLength = ( uint16_t ) ( pSlot->record[ 1 ] | ( pSlot->record[ 2 ] << 8 ) );
+
+            if( pSlot->record[ 0 ] == ( uint8_t ) RECORD_TYPE_COMMIT )
+            {
+                /* Only read by OfflineQueue_Init(). */
+            }
+            else if( pSlot->record[ 0 ] > ( uint8_t ) MQTTQoS2 )
+            {
+                /* A corrupted record, or one of another format. */
+                LogError( ( "Skipping an offline queue record with invalid QoS %u.",
+                            ( unsigned int ) pSlot->record[ 0 ] ) );
+            }
+            else if( ( RECORD_HEADER_SIZE + topicLength ) <= drainLocation.fe_data_len )
+            {
+                ( void ) memset( &( pSlot->publishInfo ), 0x00, sizeof( MQTTPublishInfo_t ) );
+                pSlot->publishInfo.qos = ( MQTTQoS_t ) pSlot->record[ 0 ];
+                pSlot->publishInfo.pTopicName = ( const char * ) &( pSlot->record[ RECORD_HEADER_SIZE ] );
+                pSlot->publishInfo.topicNameLength = topicLength;
+                pSlot->publishInfo.pPayload = &( pSlot->record[ RECORD_HEADER_SIZE + topicLength ] );
+                pSlot->publishInfo.payloadLength = drainLocation.fe_data_len - RECORD_HEADER_SIZE - topicLength;
+                recordRead = true;
+            }
+        }
+    }
+
+    return recordRead;
+}
+/*-----------------------------------------------------------*/
+
+static void drainWorkHandler( struct k_work * pWork )
+{
+    MQTTAgentCommandInfo_t commandInfo = { 0 };
+    MQTTStatus_t mqttStatus = MQTTSuccess;
+    size_t index = 0U, queued = 0U;
+
+    ( void ) pWork;
+
+    ( void ) k_mutex_lock( &offlineQueueMutex, K_FOREVER );
+
+    if( ( queueConnected == true ) && ( batchOutstanding == 0U ) &&
+        ( batchPending == true ) && ( batchFailed == false ) )
+    {
+        /* Record the acknowledgement of the batch as soon as it completes,
+         * then publish the next batch after the drain interval. */
+        committedLocation = drainLocation;
+        persistCommittedLocation();
+        releaseCommittedSectors();
+        batchPending = false;
+
+        ( void ) k_work_schedule( &drainWork, K_MSEC( OFFLINE_QUEUE_DRAIN_INTERVAL_MS ) );
+    }
+    else if( ( queueConnected == true ) && ( batchOutstanding == 0U ) )
+    {
+        /* Read the records of a failed batch again. */
+        if( batchFailed == true )
+        {
+            drainLocation = committedLocation;
+            batchFailed = false;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+
+        commandInfo.blockTimeMs = 0U;
+        commandInfo.cmdCompleteCallback = drainPublishCallback;
+
+        for( index = 0U; ( index < OFFLINE_QUEUE_DRAIN_BATCH ) && ( mqttStatus == MQTTSuccess ); index++ )
+        {
+            if( readNextRecord( &( drainSlots[ index ] ) ) == false )
+            {
+                break;
+            }
+
+            commandInfo.pCmdCompleteCallbackContext = ( MQTTAgentCommandContext_t * ) &( drainSlots[ index ] );
+
+            /* Completions take the mutex, so none is counted before this. */
+            batchOutstanding++;
+            mqttStatus = MQTTAgent_Publish( pQueueAgentContext, &( drainSlots[ index ].publishInfo ), &commandInfo );
+
+            if( mqttStatus == MQTTSuccess )
+            {
+                queued++;
+            }
+            else
+            {
+                batchOutstanding--;
+                batchFailed = true;
+            }
+        }
+
+        batchPending = ( queued > 0U );
+
+        if( queued > 0U )
+        {
+            LogDebug( ( "Publishing %lu records of the offline queue.", ( unsigned long ) queued ) );
+        }
+        else if( batchFailed == true )
+        {
+            /* The agent queue is full: try again later. */
+            ( void ) k_work_schedule( &drainWork, K_MSEC( OFFLINE_QUEUE_DRAIN_INTERVAL_MS ) );
+        }
+        else
+        {
+            /* The log is drained; the next store restarts the drain. */
+        }
+    }
+
+    ( void ) k_mutex_unlock( &offlineQueueMutex );
+}
+/*-----------------------------------------------------------*/
+
+static void drainPublishCallback( MQTTAgentCommandContext_t * pCmdContext,
+                                  MQTTAgentReturnInfo_t * pReturnInfo )
+{
+    ( void ) pCmdContext;
+
+    ( void ) k_mutex_lock( &offlineQueueMutex, K_FOREVER );
+
+    if( pReturnInfo->returnCode != MQTTSuccess )
+    {
+        batchFailed = true;
+    }
+
+    batchOutstanding--;
+
+    /* Once the batch completes, it is settled at once, or published again
+     * after the drain interval if it failed, unless the connection is down. */
+    if( ( batchOutstanding == 0U ) && ( queueConnected == true ) )
+    {
+        ( void ) k_work_schedule( &drainWork,
+                                  ( batchFailed == true ) ? K_MSEC( OFFLINE_QUEUE_DRAIN_INTERVAL_MS ) : K_NO_WAIT );
+    }
+
+    ( void ) k_mutex_unlock( &offlineQueueMutex );
+}
+/*-----------------------------------------------------------*/
+
+bool OfflineQueue_Init( MQTTAgentContext_t * pAgentContext )
+{
+    uint32_t sectorCount = OFFLINE_QUEUE_MAX_SECTORS;
+    int ret = 0;
+
+    assert( pAgentContext != NULL );
+
+    pQueueAgentContext = pAgentContext;
+    k_work_init_delayable( &drainWork, drainWorkHandler );
+
+    ret = flash_area_get_sectors( OFFLINE_QUEUE_FLASH_AREA_ID, &sectorCount, offlineSectors );
+
+    if( ret == 0 )
+    {
+        ( void ) memset( &offlineFcb, 0x00, sizeof( offlineFcb ) );
+        offlineFcb.f_magic = OFFLINE_QUEUE_MAGIC;
+        offlineFcb.f_version = 1U;
+        offlineFcb.f_sectors = offlineSectors;
+        offlineFcb.f_sector_cnt = ( uint8_t ) sectorCount;
+        offlineFcb.f_scratch_cnt = 0U;
+
+        ret = fcb_init( OFFLINE_QUEUE_FLASH_AREA_ID, &offlineFcb );
+    }
+
+    if( ret == 0 )
+    {
+        /* Drain from the first record left by a previous run that was not
+         * acknowledged. */
+        recoverCommittedLocation();
+        releaseCommittedSectors();
+        drainLocation = committedLocation;
+        queueReady = true;
+    }
+    else
+    {
+        LogError( ( "Failed to open the offline queue: ret=%d.", ret ) );
+    }
+
+    return queueReady;
+}
+/*-----------------------------------------------------------*/
+
+bool OfflineQueue_Store( const MQTTPublishInfo_t * pPublishInfo )
+{
+    size_t recordLength = 0U;
+    int ret = -EINVAL;
+
+    assert( pPublishInfo != NULL );
+
+    recordLength = RECORD_HEADER_SIZE + pPublishInfo->topicNameLength + pPublishInfo->payloadLength;
+
+    if( ( queueReady == false ) || ( recordLength > OFFLINE_QUEUE_MAX_RECORD_SIZE ) )
+    {
+        LogError( ( "Cannot store a publish of %lu bytes in the offline queue.",
+                    ( unsigned long ) recordLength ) );
+    }
+    else
+    {
+        ( void ) k_mutex_lock( &offlineQueueMutex, K_FOREVER );
+
+        writeBuffer[ 0 ] = ( uint8_t ) pPublishInfo->qos;
+        writeBuffer[ 1 ] = ( uint8_t ) ( pPublishInfo->topicNameLength & 0xFFU );
+        writeBuffer[ 2 ] = ( uint8_t ) ( pPublishInfo->topicNameLength >> 8 );
+        ( void ) memcpy( &( writeBuffer[ RECORD_HEADER_SIZE ] ), pPublishInfo->pTopicName, pPublishInfo->topicNameLength );
+        ( void ) memcpy( &( writeBuffer[ RECORD_HEADER_SIZE + pPublishInfo->topicNameLength ] ),
+                         pPublishInfo->pPayload,
+                         pPublishInfo->payloadLength );
+
+        ret = appendRecord( recordLength );
+
+        if( ret == -ENOSPC )
+        {
+            LogWarn( ( "Offline queue full: dropping its oldest sector." ) );
+            dropOldestSector();
+            ret = appendRecord( recordLength );
+        }
+
+        /* Restart the drain if it went idle at the end of the log. */
+        if( ( ret == 0 ) && ( queueConnected == true ) && ( batchOutstanding == 0U ) )
+        {
+            ( void ) k_work_schedule( &drainWork, K_MSEC( OFFLINE_QUEUE_DRAIN_INTERVAL_MS ) );
+        }
+
+        ( void ) k_mutex_unlock( &offlineQueueMutex );
+
+        if( ret != 0 )
+        {
+            LogError( ( "Failed to write a record to the offline queue: ret=%d.", ret ) );
+        }
+    }
+
+    return( ret == 0 );
+}
+/*-----------------------------------------------------------*/
+
+void OfflineQueue_SetConnected( bool connected )
+{
+    ( void ) k_mutex_lock( &offlineQueueMutex, K_FOREVER );
+
+    queueConnected = ( queueReady == true ) && connected;
+
+    if( queueConnected == true )
+    {
+        ( void ) k_work_schedule( &drainWork, K_NO_WAIT );
+    }
+    else
+    {
+        /* Publishes in flight fail with the connection, which rewinds their
+         * batch. */
+        ( void ) k_work_cancel_delayable( &drainWork );
+    }
+
+    ( void ) k_mutex_unlock( &offlineQueueMutex );
+}
+/*-----------------------------------------------------------*/
+
+bool OfflineQueue_IsEmpty( void )
+{
+    struct fcb_entry location = { 0 };
+    bool empty = true;
+
+    if( queueReady == true )
+    {
+        ( void ) k_mutex_lock( &offlineQueueMutex, K_FOREVER );
+        location = committedLocation;
+        empty = ( fcb_getnext( &offlineFcb, &location ) != 0 );
+        ( void ) k_mutex_unlock( &offlineQueueMutex );
+    }
+
+    return empty;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,289 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file payload_pool.c
+ * @brief Slab-backed, reference-counted publish payload buffers.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+/* Payload pool header include. */
+#include "payload_pool.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Header in front of the payload of each buffer.
+ *
+ * Its size keeps the payload aligned to 8 bytes.
+ */
+typedef struct PayloadBufferHeader
+{
+    atomic_t references; /**< @brief Number of references to the buffer. */
+    uint32_t sizeClass;  /**< @brief Index of the class of the buffer in #payloadSlabs. */
+} PayloadBufferHeader_t;
+
+/**
+ * @brief A publish of a pool buffer, from its queueing to its completion.
+ */
+typedef struct PayloadPublishRecord
+{
+    MQTTPublishInfo_t publishInfo;     /**< @brief The publish, read by the agent until it completes. */
+    PayloadPublishCallback_t callback; /**< @brief Function called on completion, or NULL. */
+    void * pCallbackContext;           /**< @brief Context of #PayloadPublishRecord_t.callback. */
+} PayloadPublishRecord_t;
+
+/**
+ * @brief Size of a slab block holding a buffer of @p payloadSize bytes.
+ */
+#define PAYLOAD_BLOCK_SIZE( payloadSize )    ROUND_UP( sizeof( PayloadBufferHeader_t ) + ( payloadSize ), 8U )
+
+/**
+ * @brief Number of size classes.
+ */
+#define PAYLOAD_POOL_CLASSES                 ( 3U )
+
+/*-----------------------------------------------------------*/
+
+K_MEM_SLAB_DEFINE( smallPayloadSlab, PAYLOAD_BLOCK_SIZE( PAYLOAD_POOL_SMALL_SIZE ), PAYLOAD_POOL_SMALL_COUNT, 8 );
+K_MEM_SLAB_DEFINE( mediumPayloadSlab, PAYLOAD_BLOCK_SIZE( PAYLOAD_POOL_MEDIUM_SIZE ), PAYLOAD_POOL_MEDIUM_COUNT, 8 );
+K_MEM_SLAB_DEFINE( largePayloadSlab, PAYLOAD_BLOCK_SIZE( PAYLOAD_POOL_LARGE_SIZE ), PAYLOAD_POOL_LARGE_COUNT, 8 );
+
+/**
+ * @brief Records of the publishes in flight.
+ */
+K_MEM_SLAB_DEFINE( publishRecordSlab, ROUND_UP( sizeof( PayloadPublishRecord_t ), 8U ), PAYLOAD_POOL_MAX_PUBLISHES, 8 );
+
+/**
+ * @brief Slab of each size class, from the smallest.
+ */
+static struct k_mem_slab * const payloadSlabs[ PAYLOAD_POOL_CLASSES ] =
+{
+    &smallPayloadSlab,
+    &mediumPayloadSlab,
+    &largePayloadSlab
+};
+
+/**
+ * @brief Payload size of each size class.
+ */
+static const size_t payloadSizes[ PAYLOAD_POOL_CLASSES ] =
+{
+    PAYLOAD_POOL_SMALL_SIZE,
+    PAYLOAD_POOL_MEDIUM_SIZE,
+    PAYLOAD_POOL_LARGE_SIZE
+};
+
+static atomic_t buffersInUse;       /**< @brief Buffers allocated and not returned. */
+static atomic_t publishesInFlight;  /**< @brief Publishes queued and not completed. */
+static atomic_t allocationFailures; /**< @brief Calls to #PayloadPool_Alloc that returned NULL. */
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the header of a buffer.
+ *
+ * @param[in] pBuffer A buffer of #PayloadPool_Alloc.
+ *
+ * @return Its header.
+ */
+static PayloadBufferHeader_t * getHeader( const uint8_t * pBuffer );
+
+/**
+ * @brief Completion callback of the publishes of #PayloadPool_Publish.
+ *
+ * @param[in] pCmdContext The #PayloadPublishRecord_t of the publish.
+ * @param[in] pReturnInfo Result of the publish.
+ */
+static void publishCompleteCallback( MQTTAgentCommandContext_t * pCmdContext,
+                                     MQTTAgentReturnInfo_t * pReturnInfo );
+
+/*-----------------------------------------------------------*/
+
+static PayloadBufferHeader_t * getHeader( const uint8_t * pBuffer )
+{
+    assert( pBuffer != NULL );
+
+    return ( PayloadBufferHeader_t * ) ( pBuffer - sizeof( PayloadBufferHeader_t ) );
+}
+/*-----------------------------------------------------------*/
+
+static void publishCompleteCallback( MQTTAgentCommandContext_t * pCmdContext,
+                                     MQTTAgentReturnInfo_t * pReturnInfo )
+{
+    PayloadPublishRecord_t * pRecord = ( PayloadPublishRecord_t * ) pCmdContext;
+
+    if( pRecord->callback != NULL )
+    {
+        pRecord->callback( pRecord->pCallbackContext, &( pRecord->publishInfo ), pReturnInfo->returnCode );
+    }
+
+    PayloadPool_Release( ( uint8_t * ) pRecord->publishInfo.pPayload );
+
+    ( void ) atomic_dec( &publishesInFlight );
+    k_mem_slab_free( &publishRecordSlab, ( void ** ) &pRecord );
+}
+/*-----------------------------------------------------------*/
+
+uint8_t * PayloadPool_Alloc( size_t size,
+                             uint32_t blockTimeMs )
+{
+    PayloadBufferHeader_t * pHeader = NULL;
+    uint8_t * pBuffer = NULL;
+    uint32_t sizeClass = 0U, fittingClass = PAYLOAD_POOL_CLASSES;
+
+    /* Take the smallest free buffer that fits. */
+    for( sizeClass = 0U; ( sizeClass < PAYLOAD_POOL_CLASSES ) && ( pHeader == NULL ); sizeClass++ )
+    {
+        if( size <= payloadSizes[ sizeClass ] )
+        {
+            fittingClass = MIN( fittingClass, sizeClass );
+
+            if( k_mem_slab_alloc( payloadSlabs[ sizeClass ], ( void ** ) &pHeader, K_NO_WAIT ) != 0 )
+            {
+                pHeader = NULL;
+            }
+            else
+            {
+                pHeader->sizeClass = sizeClass;
+            }
+        }
+    }
+
+    /* Otherwise, wait for a buffer of the smallest class that fits. */
+    if( ( pHeader == NULL ) && ( fittingClass < PAYLOAD_POOL_CLASSES ) && ( blockTimeMs > 0U ) )
+    {
+        if( k_mem_slab_alloc( payloadSlabs[ fittingClass ], ( void ** ) &pHeader, K_MSEC( blockTimeMs ) ) != 0 )
+        {
+            pHeader = NULL;
+        }
+        else
+        {
+            pHeader->sizeClass = fittingClass;
+        }
+    }
+
+    if( pHeader != NULL )
+    {
+        ( void ) atomic_set( &( pHeader->references ), 1 );
+        ( void ) atomic_inc( &buffersInUse );
+        pBuffer = ( uint8_t * ) &( pHeader[ 1 ] );
+    }
+    else
+    {
+        ( void ) atomic_inc( &allocationFailures );
+
+        if( fittingClass == PAYLOAD_POOL_CLASSES )
+        {
+            LogError( ( "No payload buffer class holds %lu bytes.", ( unsigned long ) size ) );
+        }
+    }
+
+    return pBuffer;
+}
+/*-----------------------------------------------------------*/
+
+void PayloadPool_Ref( uint8_t * pBuffer )
+{
+    PayloadBufferHeader_t * pHeader = getHeader( pBuffer );
+
+    /* A buffer can only be referenced by a holder of a reference. */
+    assert( atomic_get( &( pHeader->references ) ) > 0 );
+
+    ( void ) atomic_inc( &( pHeader->references ) );
+}
+/*-----------------------------------------------------------*/
+
+void PayloadPool_Release( uint8_t * pBuffer )
+{
+    PayloadBufferHeader_t * pHeader = getHeader( pBuffer );
+
+    assert( atomic_get( &( pHeader->references ) ) > 0 );
+    assert( pHeader->sizeClass < PAYLOAD_POOL_CLASSES );
+
+    /* atomic_dec returns the previous value. */
+    if( atomic_dec( &( pHeader->references ) ) == 1 )
+    {
+        ( void ) atomic_dec( &buffersInUse );
+        k_mem_slab_free( payloadSlabs[ pHeader->sizeClass ], ( void ** ) &pHeader );
+    }
+}
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t PayloadPool_Publish( MQTTAgentContext_t * pAgentContext,
+                                  const MQTTPublishInfo_t * pPublishInfo,
+                                  uint32_t blockTimeMs,
+                                  PayloadPublishCallback_t callback,
+                                  void * pCallbackContext )
+{
+    PayloadPublishRecord_t * pRecord = NULL;
+    MQTTAgentCommandInfo_t commandInfo = { 0 };
+    MQTTStatus_t mqttStatus = MQTTNoMemory;
+
+    assert( pAgentContext != NULL );
+    assert( pPublishInfo != NULL );
+    assert( pPublishInfo->pPayload != NULL );
+
+    if( k_mem_slab_alloc( &publishRecordSlab, ( void ** ) &pRecord, K_MSEC( blockTimeMs ) ) == 0 )
+    {
+        pRecord->publishInfo = *pPublishInfo;
+        pRecord->callback = callback;
+        pRecord->pCallbackContext = pCallbackContext;
+
+        commandInfo.blockTimeMs = blockTimeMs;
+        commandInfo.cmdCompleteCallback = publishCompleteCallback;
+        commandInfo.pCmdCompleteCallbackContext = ( MQTTAgentCommandContext_t * ) pRecord;
+
+        /* The callback may run before the call returns, so the publish is
+         * counted first. */
+        ( void ) atomic_inc( &publishesInFlight );
+        mqttStatus = MQTTAgent_Publish( pAgentContext, &( pRecord->publishInfo ), &commandInfo );
+
+        if( mqttStatus != MQTTSuccess )
+        {
+            /* The caller keeps its reference. */
+            ( void ) atomic_dec( &publishesInFlight );
+            k_mem_slab_free( &publishRecordSlab, ( void ** ) &pRecord );
+        }
+    }
+    else
+    {
+        LogWarn( ( "No publish record available: %u publishes in flight.",
+                   ( unsigned int ) PAYLOAD_POOL_MAX_PUBLISHES ) );
+    }
+
+    return mqttStatus;
+}
+/*-----------------------------------------------------------*/
+
+void PayloadPool_GetStats( PayloadPoolStats_t * pStats )
+{
+    assert( pStats != NULL );
+
+    pStats->buffersInUse = ( uint32_t ) atomic_get( &buffersInUse );
+    pStats->publishesInFlight = ( uint32_t ) atomic_get( &publishesInFlight );
+    pStats->allocationFailures = ( uint32_t ) atomic_get( &allocationFailures );
+}
+/*-----------------------------------------------------------*/
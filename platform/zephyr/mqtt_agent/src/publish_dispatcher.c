@@ -0,0 +1,382 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file publish_dispatcher.c
+ * @brief Hands incoming publishes to worker threads.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Publish dispatcher header include. */
+#include "publish_dispatcher.h"
+
+/* Stack and CPU profiles of the workers. */
+#include "thread_profiler_zephyr.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A buffer of the pool and the publish copied into it while it is
+ * leased.
+ */
+typedef struct PublishLease
+{
+    atomic_t references;           /**< @brief Callbacks yet to return for the publish. */
+    MQTTPublishInfo_t publishInfo; /**< @brief The publish, pointing into #PublishLease_t.buffer. */
+
+    /**
+     * @brief The topic and the payload of the publish, or the network buffer
+     * of the agent, in words so that the lease stays aligned.
+     */
+    uint32_t buffer[ ( PUBLISH_DISPATCHER_BUFFER_SIZE + sizeof( uint32_t ) - 1U ) / sizeof( uint32_t ) ];
+} PublishLease_t;
+
+/**
+ * @brief A callback to run on a worker thread for a leased publish.
+ */
+typedef struct PublishDelivery
+{
+    void * pFifoReserved;           /**< @brief Reserved for the k_fifo of the worker. */
+    PublishLease_t * pLease;        /**< @brief Lease of the publish. */
+    IncomingPubCallback_t callback; /**< @brief Callback of the subscription. */
+    void * pCallbackContext;        /**< @brief Context of the callback. */
+} PublishDelivery_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Pool of the buffers, one of which is the network buffer of the agent.
+ */
+K_MEM_SLAB_DEFINE( leaseSlab, sizeof( PublishLease_t ), PUBLISH_DISPATCHER_BUFFERS, 4 );
+
+/**
+ * @brief Pool of the callbacks waiting for a worker.
+ */
+K_MEM_SLAB_DEFINE( deliverySlab, sizeof( PublishDelivery_t ), PUBLISH_DISPATCHER_MAX_DELIVERIES, 4 );
+
+/**
+ * @brief Stacks of the worker threads.
+ */
+K_THREAD_STACK_ARRAY_DEFINE( workerStacks, PUBLISH_DISPATCHER_WORKERS, PUBLISH_DISPATCHER_STACK_SIZE );
+
+/**
+ * @brief The worker threads running the callbacks.
+ */
+static struct k_thread workerThreads[ PUBLISH_DISPATCHER_WORKERS ];
+
+#if ( THREAD_PROFILING == 1 )
+
+/**
+ * @brief Names of the worker threads in their profiles.
+ */
+    static char workerNames[ PUBLISH_DISPATCHER_WORKERS ][ 16 ];
+#endif
+
+/**
+ * @brief Callbacks waiting for each worker, in the order of their publishes.
+ */
+static struct k_fifo workerFifos[ PUBLISH_DISPATCHER_WORKERS ];
+
+/**
+ * @brief The lease whose buffer is the network buffer of the agent, for the
+ * lifetime of the dispatcher.
+ */
+static PublishLease_t * pAgentLease = NULL;
+
+/**
+ * @brief Counters of #PublishDispatcherStats_t.
+ */
+static atomic_t dispatchedCount;
+static atomic_t droppedCount;
+static atomic_t leasedCount;
+static atomic_t peakLeasedCount;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Entry of a worker thread, running the callbacks queued for it. The
+ * buffer of a publish returns to the pool after its last callback.
+ *
+ * @param[in] pFifo The k_fifo of the worker.
+ * @param[in] b Unused.
+ * @param[in] c Unused.
+ */
+static void workerTask( void * pFifo,
+                        void * b,
+                        void * c );
+
+/**
+ * @brief Copy the topic and the payload of a publish into a buffer of the
+ * pool leased to its callbacks.
+ *
+ * The publish is copied rather than received in the leased buffer, because
+ * coreMQTT owns the content of its network buffer once the incoming publish
+ * callback returns, and may move unread bytes within it.
+ *
+ * @param[in] pPublishInfo The publish.
+ * @param[in] references Number of callbacks of the publish.
+ * @param[in] timeout Time to wait for a buffer.
+ *
+ * @return The lease of the publish, or NULL if no buffer was freed in time or
+ * the publish does not fit in one.
+ */
+static PublishLease_t * leasePublishCopy( const MQTTPublishInfo_t * pPublishInfo,
+                                          size_t references,
+                                          k_timeout_t timeout );
+
+/**
+ * @brief Time left until a deadline, for the waits of a publish to share
+ * #PUBLISH_DISPATCHER_WAIT_MS.
+ *
+ * @param[in] deadlineMs Uptime of the deadline.
+ *
+ * @return The time left, K_NO_WAIT once the deadline passed.
+ */
+static k_timeout_t timeLeft( int64_t deadlineMs );
+
+/*-----------------------------------------------------------*/
+
+static void workerTask( void * pFifo,
+                        void * b,
+                        void * c )
+{
+    PublishDelivery_t * pDelivery = NULL;
+    PublishLease_t * pLease = NULL;
+
+    ( void ) b;
+    ( void ) c;
+
+    for( ; ; )
+    {
+        pDelivery = ( PublishDelivery_t * ) k_fifo_get( ( struct k_fifo * ) pFifo, K_FOREVER );
+        pLease = pDelivery->pLease;
+
+        pDelivery->callback( pDelivery->pCallbackContext, &( pLease->publishInfo ) );
+
+        k_mem_slab_free( &deliverySlab, ( void ** ) &pDelivery );
+
+        /* atomic_dec() returns the count before the decrement. */
+        if( atomic_dec( &( pLease->references ) ) == 1 )
+        {
+            k_mem_slab_free( &leaseSlab, ( void ** ) &pLease );
+            ( void ) atomic_dec( &leasedCount );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static PublishLease_t * leasePublishCopy( const MQTTPublishInfo_t * pPublishInfo,
+                                          size_t references,
+                                          k_timeout_t timeout )
+{
+    PublishLease_t * pLease = NULL;
+    uint8_t * pBuffer = NULL;
+    atomic_val_t leased = 0, peak = 0;
+
+    if( ( ( size_t ) pPublishInfo->topicNameLength + pPublishInfo->payloadLength ) > PUBLISH_DISPATCHER_BUFFER_SIZE )
+    {
+        LogWarn( ( "A publish of %u bytes does not fit in PUBLISH_DISPATCHER_BUFFER_SIZE.",
+                   ( unsigned int ) ( pPublishInfo->topicNameLength + pPublishInfo->payloadLength ) ) );
+    }
+    else if( k_mem_slab_alloc( &leaseSlab, ( void ** ) &pLease, timeout ) == 0 )
+    {
+        pBuffer = ( uint8_t * ) pLease->buffer;
+        ( void ) memcpy( pBuffer, pPublishInfo->pTopicName, pPublishInfo->topicNameLength );
+
+        if( pPublishInfo->payloadLength > 0U )
+        {
+            ( void ) memcpy( &( pBuffer[ pPublishInfo->topicNameLength ] ),
+                             pPublishInfo->pPayload,
+                             pPublishInfo->payloadLength );
+        }
+
+        pLease->publishInfo = *pPublishInfo;
+        pLease->publishInfo.pTopicName = ( const char * ) pBuffer;
+        pLease->publishInfo.pPayload = &( pBuffer[ pPublishInfo->topicNameLength ] );
+        ( void ) atomic_set( &( pLease->references ), ( atomic_val_t ) references );
+
+        leased = atomic_inc( &leasedCount ) + 1;
+        peak = atomic_get( &peakLeasedCount );
+
+        while( ( leased > peak ) && ( atomic_cas( &peakLeasedCount, peak, leased ) == false ) )
+        {
+            peak = atomic_get( &peakLeasedCount );
+        }
+    }
+    else
+    {
+        /* Every other buffer stayed leased. */
+    }
+
+    return pLease;
+}
+
+/*-----------------------------------------------------------*/
+
+static k_timeout_t timeLeft( int64_t deadlineMs )
+{
+    int64_t leftMs = deadlineMs - k_uptime_get();
+
+    return ( leftMs > 0 ) ? K_MSEC( leftMs ) : K_NO_WAIT;
+}
+
+/*-----------------------------------------------------------*/
+
+void PublishDispatcher_Init( MQTTFixedBuffer_t * pNetworkBuffer )
+{
+    uint32_t i = 0U;
+    int allocStatus = 0;
+
+    assert( pNetworkBuffer != NULL );
+    assert( pAgentLease == NULL );
+
+    for( i = 0U; i < PUBLISH_DISPATCHER_WORKERS; i++ )
+    {
+        k_fifo_init( &( workerFifos[ i ] ) );
+        ( void ) k_thread_create( &( workerThreads[ i ] ),
+                                  workerStacks[ i ],
+                                  K_THREAD_STACK_SIZEOF( workerStacks[ i ] ),
+                                  workerTask,
+                                  &( workerFifos[ i ] ),
+                                  NULL,
+                                  NULL,
+                                  PUBLISH_DISPATCHER_PRIORITY,
+                                  0,
+                                  K_NO_WAIT );
+
+        #if ( THREAD_PROFILING == 1 )
+            ( void ) snprintf( workerNames[ i ], sizeof( workerNames[ i ] ), "dispatcher%u", ( unsigned int ) i );
+            ThreadProfiler_Register( &( workerThreads[ i ] ), workerNames[ i ] );
+        #endif
+    }
+
+    /* The pool is full at start, so the allocation cannot fail. */
+    allocStatus = k_mem_slab_alloc( &leaseSlab, ( void ** ) &pAgentLease, K_NO_WAIT );
+    assert( allocStatus == 0 );
+    ( void ) allocStatus;
+
+    pNetworkBuffer->pBuffer = ( uint8_t * ) pAgentLease->buffer;
+    pNetworkBuffer->size = PUBLISH_DISPATCHER_BUFFER_SIZE;
+}
+
+/*-----------------------------------------------------------*/
+
+bool PublishDispatcher_Dispatch( SubscriptionElement_t * pSubscriptionList,
+                                 MQTTPublishInfo_t * pPublishInfo )
+{
+    const SubscriptionElement_t * pMatches[ PUBLISH_DISPATCHER_MAX_MATCHES ];
+    PublishDelivery_t * pDeliveries[ PUBLISH_DISPATCHER_MAX_MATCHES ];
+    PublishLease_t * pLease = NULL;
+    size_t matchCount = 0U, allocated = 0U, i = 0U;
+    uint32_t worker = 0U;
+    int64_t deadlineMs = 0;
+
+    assert( pPublishInfo != NULL );
+    assert( pAgentLease != NULL );
+
+    matchCount = findMatchingSubscriptions( pSubscriptionList,
+                                            pPublishInfo,
+                                            pMatches,
+                                            PUBLISH_DISPATCHER_MAX_MATCHES );
+
+    if( matchCount > PUBLISH_DISPATCHER_MAX_MATCHES )
+    {
+        LogError( ( "A publish matches %lu subscriptions, more than PUBLISH_DISPATCHER_MAX_MATCHES.",
+                    ( unsigned long ) matchCount ) );
+    }
+    else if( matchCount > 0U )
+    {
+        /* Wait for the workers rather than run the callbacks here, which
+         * would run them ahead of the publishes the workers have queued. */
+        deadlineMs = k_uptime_get() + PUBLISH_DISPATCHER_WAIT_MS;
+
+        while( ( allocated < matchCount ) &&
+               ( k_mem_slab_alloc( &deliverySlab,
+                                   ( void ** ) &( pDeliveries[ allocated ] ),
+                                   timeLeft( deadlineMs ) ) == 0 ) )
+        {
+            allocated++;
+        }
+
+        if( allocated == matchCount )
+        {
+            pLease = leasePublishCopy( pPublishInfo, matchCount, timeLeft( deadlineMs ) );
+        }
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( pLease != NULL )
+    {
+        for( i = 0U; i < matchCount; i++ )
+        {
+            pDeliveries[ i ]->pLease = pLease;
+            pDeliveries[ i ]->callback = pMatches[ i ]->incomingPublishCallback;
+            pDeliveries[ i ]->pCallbackContext = pMatches[ i ]->pIncomingPublishCallbackContext;
+
+            /* Keep the callbacks of a subscription on one worker, in order. */
+            worker = ( uint32_t ) ( pMatches[ i ] - pSubscriptionList ) % PUBLISH_DISPATCHER_WORKERS;
+            k_fifo_put( &( workerFifos[ worker ] ), pDeliveries[ i ] );
+        }
+
+        ( void ) atomic_inc( &dispatchedCount );
+    }
+    else
+    {
+        for( i = 0U; i < allocated; i++ )
+        {
+            k_mem_slab_free( &deliverySlab, ( void ** ) &( pDeliveries[ i ] ) );
+        }
+
+        if( matchCount > 0U )
+        {
+            /* The pools stayed exhausted for PUBLISH_DISPATCHER_WAIT_MS, or
+             * the publish was refused above. */
+            LogError( ( "Dropped a publish to %.*s matching %lu subscriptions.",
+                        pPublishInfo->topicNameLength,
+                        pPublishInfo->pTopicName,
+                        ( unsigned long ) matchCount ) );
+            ( void ) atomic_inc( &droppedCount );
+        }
+    }
+
+    return( matchCount > 0U );
+}
+
+/*-----------------------------------------------------------*/
+
+void PublishDispatcher_GetStats( PublishDispatcherStats_t * pStats )
+{
+    assert( pStats != NULL );
+
+    pStats->dispatched = ( uint32_t ) atomic_get( &dispatchedCount );
+    pStats->dropped = ( uint32_t ) atomic_get( &droppedCount );
+    pStats->buffersLeased = ( uint32_t ) atomic_get( &leasedCount );
+    pStats->peakBuffersLeased = ( uint32_t ) atomic_get( &peakLeasedCount );
+}
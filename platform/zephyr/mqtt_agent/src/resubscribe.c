@@ -0,0 +1,397 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file resubscribe.c
+ * @brief Packs the topic filters of a subscription list into pipelined
+ * SUBSCRIBE packets.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+/* Resubscribe header include. */
+#include "resubscribe.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Bytes of a SUBSCRIBE packet taken by each topic filter besides its
+ * characters: the length of the filter and its QoS.
+ */
+#define FILTER_OVERHEAD_BYTES    ( 3U )
+
+/**
+ * @brief A SUBSCRIBE packet queued to the agent.
+ */
+typedef struct ResubscribePacket
+{
+    MQTTAgentSubscribeArgs_t subscribeArgs; /**< @brief Arguments of the command, kept until it completes. */
+    size_t firstFilter;                     /**< @brief Index in #filterIndices of the first filter of the packet. */
+    uint32_t generation;                    /**< @brief Value of #generation when the packet was queued. */
+    bool inUse;                             /**< @brief Whether the packet awaits its SUBACK. */
+} ResubscribePacket_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Index in the subscription list of the first element holding each
+ * distinct topic filter.
+ */
+static uint16_t filterIndices[ SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ];
+
+/**
+ * @brief Subscription of each distinct topic filter, filled when its packet is
+ * queued.
+ */
+static MQTTSubscribeInfo_t subscribeInfo[ SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ];
+
+/**
+ * @brief Packets awaiting their SUBACK.
+ */
+static ResubscribePacket_t packets[ RESUBSCRIBE_MAX_PACKETS ];
+
+static MQTTAgentContext_t * pResubscribeAgent = NULL;           /**< @brief Agent sending the packets. */
+static const SubscriptionElement_t * pResubscribeList = NULL;   /**< @brief Subscription list being restored. */
+static MQTTQoS_t resubscribeQoS = MQTTQoS0;                     /**< @brief QoS of the subscriptions. */
+static size_t resubscribeMaxPacketSize = 0U;                    /**< @brief Largest SUBSCRIBE packet. */
+static ResubscribeFilterCallback_t resubscribeFilterCallback;   /**< @brief Called with the result of each filter. */
+static ResubscribeDoneCallback_t resubscribeDoneCallback;       /**< @brief Called once every filter has its result. */
+static void * pResubscribeContext = NULL;                       /**< @brief Passed to the callbacks. */
+
+static size_t filterCount = 0U;     /**< @brief Number of entries of #filterIndices. */
+static size_t nextFilter = 0U;      /**< @brief First filter of the next packet. */
+static size_t completedCount = 0U;  /**< @brief Filters whose result is known. */
+static size_t failedCount = 0U;     /**< @brief Filters that could not be subscribed. */
+static bool doneReported = true;    /**< @brief Whether the done callback was called. */
+
+/**
+ * @brief Whether a hold is taken by #holdSubscriptionFilters, so that the
+ * filters of the queued packets do not move in the subscription list.
+ */
+static bool filtersHeld = false;
+
+/**
+ * @brief Incremented by #Resubscribe_Start, so that the SUBACKs of the packets
+ * of a previous call are ignored.
+ */
+static uint32_t generation = 0U;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Compute the size of a SUBSCRIBE packet.
+ *
+ * @param[in] payloadLength Bytes of the topic filters of the packet, with
+ * their lengths and QoS.
+ *
+ * @return Size of the packet with its fixed header and packet identifier.
+ */
+static size_t subscribePacketSize( size_t payloadLength );
+
+/**
+ * @brief Report the results of the filters of a packet and free the packet.
+ *
+ * @param[in] pPacket The packet.
+ * @param[in] pSubackCodes SUBACK codes of the filters, or NULL if the packet
+ * failed altogether.
+ */
+static void finishPacket( ResubscribePacket_t * pPacket,
+                          const uint8_t * pSubackCodes );
+
+/**
+ * @brief Queue packets to the agent while filters are left and a packet is
+ * free, and call the done callback once every filter has its result.
+ *
+ * @return #MQTTSuccess, or the error with which a packet could not be queued,
+ * in which case the filters left are reported as failed.
+ */
+static MQTTStatus_t queuePackets( void );
+
+/**
+ * @brief Release the hold on the subscription filters once the done callback
+ * was called and no packet, of this call or a previous one, is queued.
+ */
+static void releaseFiltersWhenIdle( void );
+
+/**
+ * @brief Completion callback of the SUBSCRIBE commands.
+ *
+ * @param[in] pCmdContext The #ResubscribePacket_t of the command.
+ * @param[in] pReturnInfo Result of the command and its SUBACK codes.
+ */
+static void subscribeCommandCallback( MQTTAgentCommandContext_t * pCmdContext,
+                                      MQTTAgentReturnInfo_t * pReturnInfo );
+
+/*-----------------------------------------------------------*/
+
+static size_t subscribePacketSize( size_t payloadLength )
+{
+    size_t remainingLength = payloadLength + sizeof( uint16_t );
+    size_t encodedLength = 1U;
+
+    /* The Remaining Length takes a byte for each 7 bits. */
+    while( ( remainingLength >> ( 7U * encodedLength ) ) != 0U )
+    {
+        encodedLength++;
+    }
+
+    return 1U + encodedLength + remainingLength;
+}
+/*-----------------------------------------------------------*/
+
+static void finishPacket( ResubscribePacket_t * pPacket,
+                          const uint8_t * pSubackCodes )
+{
+    MQTTSubAckStatus_t subackStatus = MQTTSubAckFailure;
+    size_t index = 0U;
+
+    for( index = 0U; index < pPacket->subscribeArgs.numSubscriptions; index++ )
+    {
+        subackStatus = ( pSubackCodes != NULL ) ? ( MQTTSubAckStatus_t ) pSubackCodes[ index ] : MQTTSubAckFailure;
+
+        if( subackStatus == MQTTSubAckFailure )
+        {
+            failedCount++;
+        }
+
+        if( resubscribeFilterCallback != NULL )
+        {
+            resubscribeFilterCallback( pResubscribeContext,
+                                       &( pResubscribeList[ filterIndices[ pPacket->firstFilter + index ] ] ),
+                                       subackStatus );
+        }
+    }
+
+    completedCount += pPacket->subscribeArgs.numSubscriptions;
+    pPacket->inUse = false;
+}
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t queuePackets( void )
+{
+    MQTTStatus_t mqttStatus = MQTTSuccess;
+    MQTTAgentCommandInfo_t commandInfo = { 0 };
+    ResubscribePacket_t * pPacket = NULL;
+    const SubscriptionElement_t * pSubscription = NULL;
+    size_t index = 0U, payloadLength = 0U, filterBytes = 0U;
+
+    for( index = 0U; ( index < RESUBSCRIBE_MAX_PACKETS ) && ( nextFilter < filterCount ); index++ )
+    {
+        pPacket = &( packets[ index ] );
+
+        if( pPacket->inUse == false )
+        {
+            pPacket->firstFilter = nextFilter;
+            pPacket->subscribeArgs.pSubscribeInfo = &( subscribeInfo[ nextFilter ] );
+            pPacket->subscribeArgs.numSubscriptions = 0U;
+            payloadLength = 0U;
+
+            /* Take filters until the packet is full, but at least one. */
+            while( nextFilter < filterCount )
+            {
+                pSubscription = &( pResubscribeList[ filterIndices[ nextFilter ] ] );
+                filterBytes = FILTER_OVERHEAD_BYTES + pSubscription->filterStringLength;
+
+                if( ( pPacket->subscribeArgs.numSubscriptions > 0U ) &&
+                    ( subscribePacketSize( payloadLength + filterBytes ) > resubscribeMaxPacketSize ) )
+                {
+                    break;
+                }
+
+                subscribeInfo[ nextFilter ].qos = resubscribeQoS;
+                subscribeInfo[ nextFilter ].pTopicFilter = pSubscription->pSubscriptionFilterString;
+                subscribeInfo[ nextFilter ].topicFilterLength = pSubscription->filterStringLength;
+                pPacket->subscribeArgs.numSubscriptions++;
+                payloadLength += filterBytes;
+                nextFilter++;
+            }
+
+            pPacket->generation = generation;
+            pPacket->inUse = true;
+
+            /* The block time is 0 as this runs on the agent thread, or before
+             * the agent runs. */
+            commandInfo.blockTimeMs = 0U;
+            commandInfo.cmdCompleteCallback = subscribeCommandCallback;
+            commandInfo.pCmdCompleteCallbackContext = ( MQTTAgentCommandContext_t * ) pPacket;
+
+            LogDebug( ( "Queuing a SUBSCRIBE packet of %lu bytes for %lu topic filters.",
+                        ( unsigned long ) subscribePacketSize( payloadLength ),
+                        ( unsigned long ) pPacket->subscribeArgs.numSubscriptions ) );
+
+            mqttStatus = MQTTAgent_Subscribe( pResubscribeAgent, &( pPacket->subscribeArgs ), &commandInfo );
+
+            if( mqttStatus != MQTTSuccess )
+            {
+                LogError( ( "Failed to queue a resubscribe packet: mqttStatus=%s. "
+                            "%lu topic filters are left unsubscribed.",
+                            MQTT_Status_strerror( mqttStatus ),
+                            ( unsigned long ) ( filterCount - pPacket->firstFilter ) ) );
+
+                /* Report the filters of this packet and those left as failed. */
+                finishPacket( pPacket, NULL );
+                pPacket->subscribeArgs.pSubscribeInfo = &( subscribeInfo[ nextFilter ] );
+                pPacket->subscribeArgs.numSubscriptions = filterCount - nextFilter;
+                pPacket->firstFilter = nextFilter;
+                nextFilter = filterCount;
+                finishPacket( pPacket, NULL );
+            }
+        }
+    }
+
+    if( ( doneReported == false ) && ( completedCount == filterCount ) )
+    {
+        doneReported = true;
+
+        if( resubscribeDoneCallback != NULL )
+        {
+            resubscribeDoneCallback( pResubscribeContext, failedCount );
+        }
+    }
+
+    releaseFiltersWhenIdle();
+
+    return mqttStatus;
+}
+/*-----------------------------------------------------------*/
+
+static void releaseFiltersWhenIdle( void )
+{
+    size_t index = 0U;
+    bool packetQueued = false;
+
+    for( index = 0U; index < RESUBSCRIBE_MAX_PACKETS; index++ )
+    {
+        packetQueued = packetQueued || packets[ index ].inUse;
+    }
+
+    if( ( filtersHeld == true ) && ( doneReported == true ) && ( packetQueued == false ) )
+    {
+        filtersHeld = false;
+        releaseSubscriptionFilters();
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void subscribeCommandCallback( MQTTAgentCommandContext_t * pCmdContext,
+                                      MQTTAgentReturnInfo_t * pReturnInfo )
+{
+    ResubscribePacket_t * pPacket = ( ResubscribePacket_t * ) pCmdContext;
+    const uint8_t * pSubackCodes = NULL;
+
+    assert( pPacket != NULL );
+    assert( pReturnInfo != NULL );
+
+    if( pPacket->generation != generation )
+    {
+        /* A packet of a previous call, whose results are not wanted. */
+        pPacket->inUse = false;
+        releaseFiltersWhenIdle();
+    }
+    else
+    {
+        /* The codes are those of the SUBACK, which refuses some filters when
+         * the return code is MQTTServerRefused. */
+        if( ( pReturnInfo->returnCode == MQTTSuccess ) || ( pReturnInfo->returnCode == MQTTServerRefused ) )
+        {
+            pSubackCodes = pReturnInfo->pSubackCodes;
+        }
+        else
+        {
+            LogError( ( "Resubscribe packet failed: returnCode=%s.",
+                        MQTT_Status_strerror( pReturnInfo->returnCode ) ) );
+        }
+
+        finishPacket( pPacket, pSubackCodes );
+        ( void ) queuePackets();
+    }
+}
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t Resubscribe_Start( MQTTAgentContext_t * pAgentContext,
+                                const SubscriptionElement_t * pSubscriptionList,
+                                MQTTQoS_t qos,
+                                size_t maxPacketSize,
+                                ResubscribeFilterCallback_t filterCallback,
+                                ResubscribeDoneCallback_t doneCallback,
+                                void * pContext )
+{
+    const SubscriptionElement_t * pSubscription = NULL;
+    size_t index = 0U, distinct = 0U;
+    bool duplicate = false;
+
+    assert( pAgentContext != NULL );
+    assert( pSubscriptionList != NULL );
+
+    /* The queued packets point to the filters of the list, which must not
+     * move until the packets are sent. */
+    if( filtersHeld == false )
+    {
+        holdSubscriptionFilters();
+        filtersHeld = true;
+    }
+
+    generation++;
+    pResubscribeAgent = pAgentContext;
+    pResubscribeList = pSubscriptionList;
+    resubscribeQoS = qos;
+    resubscribeMaxPacketSize = maxPacketSize;
+    resubscribeFilterCallback = filterCallback;
+    resubscribeDoneCallback = doneCallback;
+    pResubscribeContext = pContext;
+
+    /* Several elements hold the same filter when it has several callbacks,
+     * but the filter is subscribed once. */
+    filterCount = 0U;
+
+    for( index = 0U; index < SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; index++ )
+    {
+        pSubscription = &( pSubscriptionList[ index ] );
+        duplicate = false;
+
+        for( distinct = 0U; ( distinct < filterCount ) && ( duplicate == false ); distinct++ )
+        {
+            duplicate = ( pSubscriptionList[ filterIndices[ distinct ] ].filterStringLength == pSubscription->filterStringLength ) &&
+                        ( memcmp( pSubscriptionList[ filterIndices[ distinct ] ].pSubscriptionFilterString,
+                                  pSubscription->pSubscriptionFilterString,
+                                  pSubscription->filterStringLength ) == 0 );
+        }
+
+        if( ( pSubscription->filterStringLength != 0U ) && ( duplicate == false ) )
+        {
+            filterIndices[ filterCount ] = ( uint16_t ) index;
+            filterCount++;
+        }
+    }
+
+    LogInfo( ( "Resubscribing to %lu topic filters.", ( unsigned long ) filterCount ) );
+
+    nextFilter = 0U;
+    completedCount = 0U;
+    failedCount = 0U;
+    doneReported = false;
+
+    return queuePackets();
+}
+/*-----------------------------------------------------------*/
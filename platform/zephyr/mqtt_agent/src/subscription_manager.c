@@ -33,6 +33,290 @@
 
 /*-----------------------------------------------------------*/
 
+#if ( SUBSCRIPTION_MANAGER_COPY_FILTERS == 1 )
+
+/**
+ * @brief Hash of the topic filters holding a wildcard, which are matched
+ * against every incoming publish. No other filter hashes to this value.
+ */
+    #define WILDCARD_FILTER_HASH    ( 0U )
+
+/**
+ * @brief Arena holding the topic filters of the subscriptions, packed in no
+ * particular order.
+ */
+    static char filterArena[ SUBSCRIPTION_MANAGER_ARENA_SIZE ];
+
+/**
+ * @brief Number of bytes of #filterArena in use.
+ */
+    static size_t arenaUsed = 0U;
+
+/**
+ * @brief Offset in #filterArena of the filter of each subscription.
+ */
+    static size_t filterOffsets[ SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ];
+
+/**
+ * @brief Length of the filter of each subscription, 0 for a free element.
+ *
+ * Lengths and hashes are kept apart from the subscription list so that the
+ * scan of each incoming publish reads contiguous memory.
+ */
+    static uint16_t filterLengths[ SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ];
+
+/**
+ * @brief Hash of the filter of each subscription, computed by #hashFilter.
+ */
+    static uint32_t filterHashes[ SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ];
+
+/**
+ * @brief Number of holds taken by #holdSubscriptionFilters and not yet
+ * released, during which the filters stay where they are in #filterArena.
+ */
+    static uint32_t filterHolds = 0U;
+
+/**
+ * @brief The subscription list whose filters are in #filterArena, recorded
+ * so that the arena can be packed when the last hold is released.
+ */
+    static SubscriptionElement_t * pArenaList = NULL;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Hash a topic filter or topic name with 32-bit FNV-1a.
+ *
+ * @param[in] pString The topic filter or topic name.
+ * @param[in] length Length of @p pString.
+ *
+ * @return #WILDCARD_FILTER_HASH if @p pString holds a wildcard, else its hash.
+ */
+    static uint32_t hashFilter( const char * pString,
+                                uint16_t length );
+
+/**
+ * @brief Copy the filter of a subscription to the arena.
+ *
+ * @param[in] pSubscriptionList The subscription list.
+ * @param[in] index Index of the subscription.
+ * @param[in] pTopicFilterString The topic filter.
+ * @param[in] topicFilterLength Length of @p pTopicFilterString.
+ *
+ * @return `true` if the filter was copied, `false` if the arena is full.
+ */
+    static bool copyFilter( SubscriptionElement_t * pSubscriptionList,
+                            size_t index,
+                            const char * pTopicFilterString,
+                            uint16_t topicFilterLength );
+
+/**
+ * @brief Remove the filter of a subscription from the arena, moving the
+ * filters after it to keep the arena packed.
+ *
+ * While the filters are held, no filter moves and the bytes of this one
+ * are reclaimed by #packArena once the last hold is released.
+ *
+ * @param[in] pSubscriptionList The subscription list.
+ * @param[in] index Index of the subscription.
+ */
+    static void releaseFilter( SubscriptionElement_t * pSubscriptionList,
+                               size_t index );
+
+/**
+ * @brief Move the filters in use to the start of the arena, in the order of
+ * their offsets, reclaiming the bytes of the filters released while held.
+ *
+ * @param[in] pSubscriptionList The subscription list.
+ */
+    static void packArena( SubscriptionElement_t * pSubscriptionList );
+
+/*-----------------------------------------------------------*/
+
+    static uint32_t hashFilter( const char * pString,
+                                uint16_t length )
+    {
+        uint32_t hash = 2166136261U;
+        uint16_t i = 0U;
+        bool hasWildcard = false;
+
+        for( i = 0U; i < length; i++ )
+        {
+            hasWildcard = hasWildcard || ( pString[ i ] == '+' ) || ( pString[ i ] == '#' );
+            hash = ( hash ^ ( uint8_t ) pString[ i ] ) * 16777619U;
+        }
+
+        if( hasWildcard == true )
+        {
+            hash = WILDCARD_FILTER_HASH;
+        }
+        else if( hash == WILDCARD_FILTER_HASH )
+        {
+            hash = WILDCARD_FILTER_HASH + 1U;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+
+        return hash;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static bool copyFilter( SubscriptionElement_t * pSubscriptionList,
+                            size_t index,
+                            const char * pTopicFilterString,
+                            uint16_t topicFilterLength )
+    {
+        bool returnStatus = false;
+
+        if( ( SUBSCRIPTION_MANAGER_ARENA_SIZE - arenaUsed ) >= topicFilterLength )
+        {
+            memcpy( &( filterArena[ arenaUsed ] ), pTopicFilterString, topicFilterLength );
+            filterOffsets[ index ] = arenaUsed;
+            filterLengths[ index ] = topicFilterLength;
+            filterHashes[ index ] = hashFilter( pTopicFilterString, topicFilterLength );
+            arenaUsed += topicFilterLength;
+            pArenaList = pSubscriptionList;
+
+            pSubscriptionList[ index ].pSubscriptionFilterString = &( filterArena[ filterOffsets[ index ] ] );
+            returnStatus = true;
+        }
+        else
+        {
+            LogError( ( "No space left in the topic filter arena of %u bytes.",
+                        ( unsigned int ) SUBSCRIPTION_MANAGER_ARENA_SIZE ) );
+        }
+
+        return returnStatus;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void releaseFilter( SubscriptionElement_t * pSubscriptionList,
+                               size_t index )
+    {
+        size_t i = 0U;
+        size_t offset = filterOffsets[ index ];
+        size_t length = filterLengths[ index ];
+
+        if( filterHolds > 0U )
+        {
+            /* A pointer to the filter may still be in use, so only mark it
+             * free and leave its bytes to #packArena. */
+            filterLengths[ index ] = 0U;
+        }
+        else
+        {
+            memmove( &( filterArena[ offset ] ),
+                     &( filterArena[ offset + length ] ),
+                     arenaUsed - offset - length );
+            arenaUsed -= length;
+            filterLengths[ index ] = 0U;
+
+            for( i = 0U; i < SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; i++ )
+            {
+                if( ( filterLengths[ i ] != 0U ) && ( filterOffsets[ i ] > offset ) )
+                {
+                    filterOffsets[ i ] -= length;
+                    pSubscriptionList[ i ].pSubscriptionFilterString = &( filterArena[ filterOffsets[ i ] ] );
+                }
+            }
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void packArena( SubscriptionElement_t * pSubscriptionList )
+    {
+        size_t packed = 0U;
+        size_t i = 0U;
+        size_t next = 0U;
+
+        do
+        {
+            /* Find the filter in use with the lowest offset not yet packed. */
+            next = SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS;
+
+            for( i = 0U; i < SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; i++ )
+            {
+                if( ( filterLengths[ i ] != 0U ) &&
+                    ( filterOffsets[ i ] >= packed ) &&
+                    ( ( next == SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ) ||
+                      ( filterOffsets[ i ] < filterOffsets[ next ] ) ) )
+                {
+                    next = i;
+                }
+            }
+
+            if( next != SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS )
+            {
+                memmove( &( filterArena[ packed ] ),
+                         &( filterArena[ filterOffsets[ next ] ] ),
+                         filterLengths[ next ] );
+                filterOffsets[ next ] = packed;
+                pSubscriptionList[ next ].pSubscriptionFilterString = &( filterArena[ packed ] );
+                packed += filterLengths[ next ];
+            }
+        } while( next != SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS );
+
+        arenaUsed = packed;
+    }
+
+#endif /* if ( SUBSCRIPTION_MANAGER_COPY_FILTERS == 1 ) */
+
+/**
+ * @brief Check whether the filter of a subscription matches an incoming publish.
+ *
+ * @param[in] pSubscriptionList The subscription list.
+ * @param[in] index Index of the subscription.
+ * @param[in] pPublishInfo Info of the incoming publish.
+ * @param[in] topicHash Hash of the topic of the publish, with
+ * #SUBSCRIPTION_MANAGER_COPY_FILTERS.
+ *
+ * @return `true` if the subscription is in use and matches, else `false`.
+ */
+static bool subscriptionMatches( const SubscriptionElement_t * pSubscriptionList,
+                                 int32_t index,
+                                 const MQTTPublishInfo_t * pPublishInfo,
+                                 uint32_t topicHash );
+
+/*-----------------------------------------------------------*/
+
+static bool subscriptionMatches( const SubscriptionElement_t * pSubscriptionList,
+                                 int32_t index,
+                                 const MQTTPublishInfo_t * pPublishInfo,
+                                 uint32_t topicHash )
+{
+    bool isCandidate = false, isMatched = false;
+
+    #if ( SUBSCRIPTION_MANAGER_COPY_FILTERS == 1 )
+        /* Only filters with a wildcard can match a topic of another length or
+         * hash. */
+        isCandidate = ( filterLengths[ index ] > 0U ) &&
+                      ( ( filterHashes[ index ] == WILDCARD_FILTER_HASH ) ||
+                        ( ( filterLengths[ index ] == pPublishInfo->topicNameLength ) &&
+                          ( filterHashes[ index ] == topicHash ) ) );
+    #else
+        ( void ) topicHash;
+        isCandidate = ( pSubscriptionList[ index ].filterStringLength > 0 );
+    #endif
+
+    if( isCandidate == true )
+    {
+        MQTT_MatchTopic( pPublishInfo->pTopicName,
+                         pPublishInfo->topicNameLength,
+                         pSubscriptionList[ index ].pSubscriptionFilterString,
+                         pSubscriptionList[ index ].filterStringLength,
+                         &isMatched );
+    }
+
+    return isMatched;
+}
+
+/*-----------------------------------------------------------*/
+
 bool addSubscription( SubscriptionElement_t * pSubscriptionList,
                       const char * pTopicFilterString,
                       uint16_t topicFilterLength,
@@ -82,11 +366,19 @@ bool addSubscription( SubscriptionElement_t * pSubscriptionList,
 
         if( availableIndex < SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS )
         {
-            pSubscriptionList[ availableIndex ].pSubscriptionFilterString = pTopicFilterString;
-            pSubscriptionList[ availableIndex ].filterStringLength = topicFilterLength;
-            pSubscriptionList[ availableIndex ].incomingPublishCallback = incomingPublishCallback;
-            pSubscriptionList[ availableIndex ].pIncomingPublishCallbackContext = pIncomingPublishCallbackContext;
-            returnStatus = true;
+            #if ( SUBSCRIPTION_MANAGER_COPY_FILTERS == 1 )
+                returnStatus = copyFilter( pSubscriptionList, availableIndex, pTopicFilterString, topicFilterLength );
+            #else
+                pSubscriptionList[ availableIndex ].pSubscriptionFilterString = pTopicFilterString;
+                returnStatus = true;
+            #endif
+
+            if( returnStatus == true )
+            {
+                pSubscriptionList[ availableIndex ].filterStringLength = topicFilterLength;
+                pSubscriptionList[ availableIndex ].incomingPublishCallback = incomingPublishCallback;
+                pSubscriptionList[ availableIndex ].pIncomingPublishCallbackContext = pIncomingPublishCallbackContext;
+            }
         }
     }
 
@@ -113,16 +405,37 @@ void removeSubscription( SubscriptionElement_t * pSubscriptionList,
     }
     else
     {
-        for( index = 0; index < SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; index++ )
-        {
-            if( pSubscriptionList[ index ].filterStringLength == topicFilterLength )
+        #if ( SUBSCRIPTION_MANAGER_COPY_FILTERS == 1 )
+            bool matches[ SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ] = { false };
+
+            /* The filters move as they are released, and the given one may be
+             * in the arena itself, so they are all compared first. */
+            for( index = 0; index < SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; index++ )
             {
-                if( strncmp( pSubscriptionList[ index ].pSubscriptionFilterString, pTopicFilterString, topicFilterLength ) == 0 )
+                matches[ index ] = ( pSubscriptionList[ index ].filterStringLength == topicFilterLength ) &&
+                                   ( strncmp( pSubscriptionList[ index ].pSubscriptionFilterString, pTopicFilterString, topicFilterLength ) == 0 );
+            }
+
+            for( index = 0; index < SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; index++ )
+            {
+                if( matches[ index ] == true )
                 {
+                    releaseFilter( pSubscriptionList, ( size_t ) index );
                     memset( &( pSubscriptionList[ index ] ), 0x00, sizeof( SubscriptionElement_t ) );
                 }
             }
-        }
+        #else /* if ( SUBSCRIPTION_MANAGER_COPY_FILTERS == 1 ) */
+            for( index = 0; index < SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; index++ )
+            {
+                if( pSubscriptionList[ index ].filterStringLength == topicFilterLength )
+                {
+                    if( strncmp( pSubscriptionList[ index ].pSubscriptionFilterString, pTopicFilterString, topicFilterLength ) == 0 )
+                    {
+                        memset( &( pSubscriptionList[ index ] ), 0x00, sizeof( SubscriptionElement_t ) );
+                    }
+                }
+            }
+        #endif /* if ( SUBSCRIPTION_MANAGER_COPY_FILTERS == 1 ) */
     }
 }
 
@@ -132,7 +445,8 @@ bool handleIncomingPublishes( SubscriptionElement_t * pSubscriptionList,
                               MQTTPublishInfo_t * pPublishInfo )
 {
     int32_t index = 0;
-    bool isMatched = false, publishHandled = false;
+    bool publishHandled = false;
+    uint32_t topicHash = 0U;
 
     if( ( pSubscriptionList == NULL ) ||
         ( pPublishInfo == NULL ) )
@@ -143,25 +457,93 @@ bool handleIncomingPublishes( SubscriptionElement_t * pSubscriptionList,
     }
     else
     {
+        #if ( SUBSCRIPTION_MANAGER_COPY_FILTERS == 1 )
+            topicHash = hashFilter( pPublishInfo->pTopicName, pPublishInfo->topicNameLength );
+        #endif
+
         for( index = 0; index < SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; index++ )
         {
-            if( pSubscriptionList[ index ].filterStringLength > 0 )
+            if( subscriptionMatches( pSubscriptionList, index, pPublishInfo, topicHash ) == true )
             {
-                MQTT_MatchTopic( pPublishInfo->pTopicName,
-                                 pPublishInfo->topicNameLength,
-                                 pSubscriptionList[ index ].pSubscriptionFilterString,
-                                 pSubscriptionList[ index ].filterStringLength,
-                                 &isMatched );
+                pSubscriptionList[ index ].incomingPublishCallback( pSubscriptionList[ index ].pIncomingPublishCallbackContext,
+                                                                    pPublishInfo );
+                publishHandled = true;
+            }
+        }
+    }
+
+    return publishHandled;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t findMatchingSubscriptions( SubscriptionElement_t * pSubscriptionList,
+                                  MQTTPublishInfo_t * pPublishInfo,
+                                  const SubscriptionElement_t ** ppMatches,
+                                  size_t maxMatches )
+{
+    int32_t index = 0;
+    size_t matchCount = 0U;
+    uint32_t topicHash = 0U;
+
+    if( ( pSubscriptionList == NULL ) ||
+        ( pPublishInfo == NULL ) ||
+        ( ppMatches == NULL ) )
+    {
+        LogError( ( "Invalid parameter. pSubscriptionList=%p, pPublishInfo=%p, ppMatches=%p.",
+                    pSubscriptionList,
+                    pPublishInfo,
+                    ppMatches ) );
+    }
+    else
+    {
+        #if ( SUBSCRIPTION_MANAGER_COPY_FILTERS == 1 )
+            topicHash = hashFilter( pPublishInfo->pTopicName, pPublishInfo->topicNameLength );
+        #endif
 
-                if( isMatched == true )
+        for( index = 0; index < SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; index++ )
+        {
+            if( subscriptionMatches( pSubscriptionList, index, pPublishInfo, topicHash ) == true )
+            {
+                if( matchCount < maxMatches )
                 {
-                    pSubscriptionList[ index ].incomingPublishCallback( pSubscriptionList[ index ].pIncomingPublishCallbackContext,
-                                                                        pPublishInfo );
-                    publishHandled = true;
+                    ppMatches[ matchCount ] = &( pSubscriptionList[ index ] );
                 }
+
+                matchCount++;
             }
         }
     }
 
-    return publishHandled;
+    return matchCount;
+}
+
+/*-----------------------------------------------------------*/
+
+void holdSubscriptionFilters( void )
+{
+    #if ( SUBSCRIPTION_MANAGER_COPY_FILTERS == 1 )
+        filterHolds++;
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+void releaseSubscriptionFilters( void )
+{
+    #if ( SUBSCRIPTION_MANAGER_COPY_FILTERS == 1 )
+        if( filterHolds == 0U )
+        {
+            LogError( ( "Subscription filters released without a hold." ) );
+        }
+        else
+        {
+            filterHolds--;
+
+            if( ( filterHolds == 0U ) && ( pArenaList != NULL ) )
+            {
+                packArena( pArenaList );
+            }
+        }
+    #endif /* if ( SUBSCRIPTION_MANAGER_COPY_FILTERS == 1 ) */
 }
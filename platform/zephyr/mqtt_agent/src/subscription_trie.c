@@ -0,0 +1,812 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file subscription_trie.c
+ * @brief Functions for managing MQTT subscriptions, indexed in a topic trie.
+ *
+ * Each node of the trie holds one level of a topic filter, and the
+ * subscriptions of a filter are chained to the node of its last level. An
+ * incoming publish is matched by walking the trie one topic level at a time,
+ * following the child named after the level along with the `+` and `#`
+ * children of each node.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* Subscription manager header include. */
+#include "subscription_manager.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Index marking the absence of a node or of a subscription.
+ */
+#define TRIE_INDEX_NONE      ( UINT16_MAX )
+
+/**
+ * @brief Index of the root node, which holds no level.
+ */
+#define TRIE_ROOT_INDEX      ( 0U )
+
+/**
+ * @brief Separator of the levels of a topic.
+ */
+#define TOPIC_LEVEL_SEPARATOR    '/'
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A node of the topic trie.
+ */
+typedef struct TrieNode
+{
+    /**
+     * @brief Name of the level of the node, in the filter of one of the
+     * subscriptions below the node. Unused for the root and wildcard nodes.
+     */
+    const char * pLevel;
+    uint16_t levelLength;  /**< @brief Length of #TrieNode_t.pLevel. */
+    uint16_t depth;        /**< @brief Level of the node in its filters, from 1. */
+    uint16_t parent;       /**< @brief Parent node. */
+    uint16_t firstChild;   /**< @brief First child named after a level, excluding wildcards. */
+    uint16_t nextSibling;  /**< @brief Next child of the parent, or next free node. */
+    uint16_t plusChild;    /**< @brief Child for the `+` wildcard. */
+    uint16_t hashChild;    /**< @brief Child for the `#` wildcard. */
+    uint16_t firstElement; /**< @brief First subscription of the filter ending at the node. */
+} TrieNode_t;
+
+/**
+ * @brief The topic trie indexing one subscription list.
+ */
+typedef struct SubscriptionTrie
+{
+    /**
+     * @brief The subscription list indexed by the trie, set on first use, or
+     * NULL while the trie is unused.
+     */
+    SubscriptionElement_t * pList;
+
+    /**
+     * @brief Nodes of the trie, unused ones linked through
+     * #TrieNode_t.nextSibling from #SubscriptionTrie_t.freeNode.
+     */
+    TrieNode_t nodes[ SUBSCRIPTION_TRIE_MAX_NODES ];
+
+    /**
+     * @brief Next subscription of each element of the list, either at the
+     * same node or in the chain of free elements.
+     */
+    uint16_t nextElement[ SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ];
+
+    uint16_t freeNode;    /**< @brief First unused node. */
+    uint16_t freeElement; /**< @brief First unused element of the list. */
+} SubscriptionTrie_t;
+
+/**
+ * @brief The subscriptions matching an incoming publish.
+ */
+typedef struct MatchResults
+{
+    const SubscriptionTrie_t * pTrie;         /**< @brief The trie of the subscription list. */
+    MQTTPublishInfo_t * pPublishInfo;         /**< @brief Info of the incoming publish. */
+    const SubscriptionElement_t ** ppMatches; /**< @brief Matching subscriptions, or NULL to invoke their callbacks. */
+    size_t maxMatches;                        /**< @brief Capacity of #MatchResults_t.ppMatches. */
+    size_t matchCount;                        /**< @brief Number of matching subscriptions. */
+} MatchResults_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The tries of the subscription lists, one per list.
+ */
+static SubscriptionTrie_t subscriptionTries[ SUBSCRIPTION_TRIE_MAX_LISTS ];
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the trie indexing @p pSubscriptionList, taking an unused one on
+ * first use of the list.
+ *
+ * @param[in] pSubscriptionList The subscription list, initialized to 0.
+ *
+ * @return The trie, or NULL if #SUBSCRIPTION_TRIE_MAX_LISTS other lists are
+ * indexed already.
+ */
+static SubscriptionTrie_t * getTrie( SubscriptionElement_t * pSubscriptionList );
+
+/**
+ * @brief Get the length of the level of a topic or filter starting at @p offset.
+ *
+ * @param[in] pString The topic or filter.
+ * @param[in] length Length of @p pString.
+ * @param[in] offset Start of the level.
+ *
+ * @return Length of the level, up to the next separator.
+ */
+static uint16_t levelLength( const char * pString,
+                             uint16_t length,
+                             uint16_t offset );
+
+/**
+ * @brief Find the child of a node for a filter level, creating it on request.
+ *
+ * @param[in] pTrie The trie.
+ * @param[in] parent The node.
+ * @param[in] pLevel Name of the level, `+` or `#` for the wildcard children.
+ * @param[in] length Length of @p pLevel.
+ * @param[in] create Whether to create the child if it does not exist.
+ *
+ * @return The child, or #TRIE_INDEX_NONE if it does not exist and could not
+ * be created.
+ */
+static uint16_t findChild( SubscriptionTrie_t * pTrie,
+                           uint16_t parent,
+                           const char * pLevel,
+                           uint16_t length,
+                           bool create );
+
+/**
+ * @brief Find the node of the last level of a topic filter, creating the
+ * missing nodes on request.
+ *
+ * @param[in] pTrie The trie.
+ * @param[in] pTopicFilterString The topic filter.
+ * @param[in] topicFilterLength Length of @p pTopicFilterString.
+ * @param[in] create Whether to create the missing nodes.
+ * @param[out] pDeepest Deepest node found or created, even on failure.
+ *
+ * @return The node, or #TRIE_INDEX_NONE if it does not exist and could not be
+ * created, or the filter is invalid.
+ */
+static uint16_t findFilterNode( SubscriptionTrie_t * pTrie,
+                                const char * pTopicFilterString,
+                                uint16_t topicFilterLength,
+                                bool create,
+                                uint16_t * pDeepest );
+
+/**
+ * @brief Free the nodes without subscriptions and children, from @p node up
+ * to the root, and rename the remaining ones after filters still subscribed.
+ *
+ * @param[in] pTrie The trie.
+ * @param[in] node The node from which to start.
+ */
+static void pruneNodes( SubscriptionTrie_t * pTrie,
+                        uint16_t node );
+
+/**
+ * @brief Add the subscriptions of a node to the results of a match, or invoke
+ * their callbacks.
+ *
+ * @param[in] node The node.
+ * @param[in,out] pResults The results of the match.
+ *
+ * @return `true` if the node has a subscription, else `false`.
+ */
+static bool addMatches( uint16_t node,
+                        MatchResults_t * pResults );
+
+/**
+ * @brief Add the subscriptions to the filters below a node which match the
+ * rest of a topic to the results of a match.
+ *
+ * @param[in] node The node matching the levels of the topic before @p offset.
+ * @param[in,out] pResults The results of the match.
+ * @param[in] offset Start of the next level of the topic.
+ * @param[in] levelsLeft Whether the topic has a level at @p offset.
+ *
+ * @return `true` if a subscription matches, else `false`.
+ */
+static bool matchLevels( uint16_t node,
+                         MatchResults_t * pResults,
+                         uint16_t offset,
+                         bool levelsLeft );
+
+/*-----------------------------------------------------------*/
+
+static SubscriptionTrie_t * getTrie( SubscriptionElement_t * pSubscriptionList )
+{
+    SubscriptionTrie_t * pTrie = NULL;
+    uint16_t index = 0U;
+
+    for( index = 0U; ( index < SUBSCRIPTION_TRIE_MAX_LISTS ) && ( pTrie == NULL ); index++ )
+    {
+        if( subscriptionTries[ index ].pList == pSubscriptionList )
+        {
+            pTrie = &( subscriptionTries[ index ] );
+        }
+    }
+
+    for( index = 0U; ( index < SUBSCRIPTION_TRIE_MAX_LISTS ) && ( pTrie == NULL ); index++ )
+    {
+        if( subscriptionTries[ index ].pList == NULL )
+        {
+            pTrie = &( subscriptionTries[ index ] );
+        }
+    }
+
+    if( pTrie == NULL )
+    {
+        LogError( ( "No topic trie left for the subscription list %p: "
+                    "SUBSCRIPTION_TRIE_MAX_LISTS lists are indexed already.",
+                    pSubscriptionList ) );
+    }
+    else if( pTrie->pList == NULL )
+    {
+        for( index = 0U; index < SUBSCRIPTION_TRIE_MAX_NODES; index++ )
+        {
+            pTrie->nodes[ index ].nextSibling = ( uint16_t ) ( index + 1U );
+        }
+
+        pTrie->nodes[ SUBSCRIPTION_TRIE_MAX_NODES - 1U ].nextSibling = TRIE_INDEX_NONE;
+
+        for( index = 0U; index < SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; index++ )
+        {
+            pTrie->nextElement[ index ] = ( uint16_t ) ( index + 1U );
+        }
+
+        pTrie->nextElement[ SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS - 1U ] = TRIE_INDEX_NONE;
+        pTrie->freeElement = 0U;
+
+        /* The root is never freed. */
+        memset( &( pTrie->nodes[ TRIE_ROOT_INDEX ] ), 0x00, sizeof( TrieNode_t ) );
+        pTrie->nodes[ TRIE_ROOT_INDEX ].parent = TRIE_INDEX_NONE;
+        pTrie->nodes[ TRIE_ROOT_INDEX ].firstChild = TRIE_INDEX_NONE;
+        pTrie->nodes[ TRIE_ROOT_INDEX ].nextSibling = TRIE_INDEX_NONE;
+        pTrie->nodes[ TRIE_ROOT_INDEX ].plusChild = TRIE_INDEX_NONE;
+        pTrie->nodes[ TRIE_ROOT_INDEX ].hashChild = TRIE_INDEX_NONE;
+        pTrie->nodes[ TRIE_ROOT_INDEX ].firstElement = TRIE_INDEX_NONE;
+        pTrie->freeNode = TRIE_ROOT_INDEX + 1U;
+
+        pTrie->pList = pSubscriptionList;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return pTrie;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint16_t levelLength( const char * pString,
+                             uint16_t length,
+                             uint16_t offset )
+{
+    uint16_t end = offset;
+
+    while( ( end < length ) && ( pString[ end ] != TOPIC_LEVEL_SEPARATOR ) )
+    {
+        end++;
+    }
+
+    return ( uint16_t ) ( end - offset );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint16_t findChild( SubscriptionTrie_t * pTrie,
+                           uint16_t parent,
+                           const char * pLevel,
+                           uint16_t length,
+                           bool create )
+{
+    uint16_t child = TRIE_INDEX_NONE;
+    uint16_t * pLink = NULL;
+
+    if( ( length == 1U ) && ( pLevel[ 0 ] == '+' ) )
+    {
+        pLink = &( pTrie->nodes[ parent ].plusChild );
+        child = *pLink;
+    }
+    else if( ( length == 1U ) && ( pLevel[ 0 ] == '#' ) )
+    {
+        pLink = &( pTrie->nodes[ parent ].hashChild );
+        child = *pLink;
+    }
+    else
+    {
+        pLink = &( pTrie->nodes[ parent ].firstChild );
+
+        for( child = pTrie->nodes[ parent ].firstChild; child != TRIE_INDEX_NONE; child = pTrie->nodes[ child ].nextSibling )
+        {
+            if( ( pTrie->nodes[ child ].levelLength == length ) &&
+                ( memcmp( pTrie->nodes[ child ].pLevel, pLevel, length ) == 0 ) )
+            {
+                break;
+            }
+        }
+    }
+
+    if( ( child == TRIE_INDEX_NONE ) && ( create == true ) && ( pTrie->freeNode != TRIE_INDEX_NONE ) )
+    {
+        child = pTrie->freeNode;
+        pTrie->freeNode = pTrie->nodes[ child ].nextSibling;
+
+        pTrie->nodes[ child ].pLevel = pLevel;
+        pTrie->nodes[ child ].levelLength = length;
+        pTrie->nodes[ child ].depth = ( uint16_t ) ( pTrie->nodes[ parent ].depth + 1U );
+        pTrie->nodes[ child ].parent = parent;
+        pTrie->nodes[ child ].firstChild = TRIE_INDEX_NONE;
+        pTrie->nodes[ child ].plusChild = TRIE_INDEX_NONE;
+        pTrie->nodes[ child ].hashChild = TRIE_INDEX_NONE;
+        pTrie->nodes[ child ].firstElement = TRIE_INDEX_NONE;
+
+        /* Wildcard children have no siblings. */
+        pTrie->nodes[ child ].nextSibling = ( pLink == &( pTrie->nodes[ parent ].firstChild ) ) ? *pLink : TRIE_INDEX_NONE;
+        *pLink = child;
+    }
+
+    return child;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint16_t findFilterNode( SubscriptionTrie_t * pTrie,
+                                const char * pTopicFilterString,
+                                uint16_t topicFilterLength,
+                                bool create,
+                                uint16_t * pDeepest )
+{
+    uint16_t node = TRIE_ROOT_INDEX, offset = 0U, length = 0U, levels = 0U;
+    bool valid = true, levelsLeft = true;
+
+    *pDeepest = TRIE_ROOT_INDEX;
+
+    while( ( levelsLeft == true ) && ( node != TRIE_INDEX_NONE ) && ( valid == true ) )
+    {
+        length = levelLength( pTopicFilterString, topicFilterLength, offset );
+        levelsLeft = ( ( offset + length ) < topicFilterLength );
+        levels++;
+
+        /* Wildcards must fill their level, and `#` must be the last level. */
+        if( ( length > 1U ) &&
+            ( ( memchr( &( pTopicFilterString[ offset ] ), '+', length ) != NULL ) ||
+              ( memchr( &( pTopicFilterString[ offset ] ), '#', length ) != NULL ) ) )
+        {
+            valid = false;
+        }
+        else if( ( length == 1U ) && ( pTopicFilterString[ offset ] == '#' ) && ( levelsLeft == true ) )
+        {
+            valid = false;
+        }
+        else if( levels > SUBSCRIPTION_TRIE_MAX_LEVELS )
+        {
+            valid = false;
+        }
+        else
+        {
+            node = findChild( pTrie, node, &( pTopicFilterString[ offset ] ), length, create );
+
+            if( node != TRIE_INDEX_NONE )
+            {
+                *pDeepest = node;
+            }
+
+            offset = ( uint16_t ) ( offset + length + 1U );
+        }
+    }
+
+    if( valid == false )
+    {
+        LogError( ( "Invalid topic filter for the topic trie: %.*s.",
+                    ( int ) topicFilterLength,
+                    pTopicFilterString ) );
+        node = TRIE_INDEX_NONE;
+    }
+
+    return node;
+}
+
+/*-----------------------------------------------------------*/
+
+static void pruneNodes( SubscriptionTrie_t * pTrie,
+                        uint16_t node )
+{
+    uint16_t parent = TRIE_INDEX_NONE, below = TRIE_INDEX_NONE, offset = 0U, level = 0U;
+    uint16_t * pLink = NULL;
+    const SubscriptionElement_t * pElement = NULL;
+
+    while( node != TRIE_ROOT_INDEX )
+    {
+        parent = pTrie->nodes[ node ].parent;
+
+        if( ( pTrie->nodes[ node ].firstElement == TRIE_INDEX_NONE ) &&
+            ( pTrie->nodes[ node ].firstChild == TRIE_INDEX_NONE ) &&
+            ( pTrie->nodes[ node ].plusChild == TRIE_INDEX_NONE ) &&
+            ( pTrie->nodes[ node ].hashChild == TRIE_INDEX_NONE ) )
+        {
+            /* Unlink the node from its parent. */
+            if( pTrie->nodes[ parent ].plusChild == node )
+            {
+                pTrie->nodes[ parent ].plusChild = TRIE_INDEX_NONE;
+            }
+            else if( pTrie->nodes[ parent ].hashChild == node )
+            {
+                pTrie->nodes[ parent ].hashChild = TRIE_INDEX_NONE;
+            }
+            else
+            {
+                for( pLink = &( pTrie->nodes[ parent ].firstChild ); *pLink != node; pLink = &( pTrie->nodes[ *pLink ].nextSibling ) )
+                {
+                }
+
+                *pLink = pTrie->nodes[ node ].nextSibling;
+            }
+
+            pTrie->nodes[ node ].nextSibling = pTrie->freeNode;
+            pTrie->freeNode = node;
+        }
+        else if( pTrie->nodes[ node ].levelLength > 0U )
+        {
+            /* The filter naming the node may have been removed: name it after
+             * the filter of a subscription below it, at the same depth. */
+            below = node;
+
+            while( pTrie->nodes[ below ].firstElement == TRIE_INDEX_NONE )
+            {
+                if( pTrie->nodes[ below ].firstChild != TRIE_INDEX_NONE )
+                {
+                    below = pTrie->nodes[ below ].firstChild;
+                }
+                else if( pTrie->nodes[ below ].plusChild != TRIE_INDEX_NONE )
+                {
+                    below = pTrie->nodes[ below ].plusChild;
+                }
+                else
+                {
+                    below = pTrie->nodes[ below ].hashChild;
+                }
+            }
+
+            pElement = &( pTrie->pList[ pTrie->nodes[ below ].firstElement ] );
+
+            for( offset = 0U, level = 1U; level < pTrie->nodes[ node ].depth; level++ )
+            {
+                offset = ( uint16_t ) ( offset + levelLength( pElement->pSubscriptionFilterString, pElement->filterStringLength, offset ) + 1U );
+            }
+
+            pTrie->nodes[ node ].pLevel = &( pElement->pSubscriptionFilterString[ offset ] );
+        }
+        else
+        {
+            /* An empty level needs no name. */
+        }
+
+        node = parent;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool addMatches( uint16_t node,
+                        MatchResults_t * pResults )
+{
+    const SubscriptionTrie_t * pTrie = pResults->pTrie;
+    uint16_t index = 0U;
+    bool publishHandled = false;
+
+    for( index = pTrie->nodes[ node ].firstElement; index != TRIE_INDEX_NONE; index = pTrie->nextElement[ index ] )
+    {
+        if( pResults->ppMatches == NULL )
+        {
+            pTrie->pList[ index ].incomingPublishCallback( pTrie->pList[ index ].pIncomingPublishCallbackContext,
+                                                           pResults->pPublishInfo );
+        }
+        else if( pResults->matchCount < pResults->maxMatches )
+        {
+            pResults->ppMatches[ pResults->matchCount ] = &( pTrie->pList[ index ] );
+        }
+        else
+        {
+            /* Only counted. */
+        }
+
+        pResults->matchCount++;
+        publishHandled = true;
+    }
+
+    return publishHandled;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool matchLevels( uint16_t node,
+                         MatchResults_t * pResults,
+                         uint16_t offset,
+                         bool levelsLeft )
+{
+    const SubscriptionTrie_t * pTrie = pResults->pTrie;
+    const MQTTPublishInfo_t * pPublishInfo = pResults->pPublishInfo;
+    uint16_t child = TRIE_INDEX_NONE, length = 0U;
+    bool publishHandled = false, wildcardsAllowed = true;
+    const char * pLevel = NULL;
+
+    if( levelsLeft == false )
+    {
+        /* The topic ends at this node, which "level/#" also matches. */
+        publishHandled = addMatches( node, pResults );
+
+        if( pTrie->nodes[ node ].hashChild != TRIE_INDEX_NONE )
+        {
+            publishHandled = addMatches( pTrie->nodes[ node ].hashChild, pResults ) || publishHandled;
+        }
+    }
+    else
+    {
+        pLevel = &( pPublishInfo->pTopicName[ offset ] );
+        length = levelLength( pPublishInfo->pTopicName, pPublishInfo->topicNameLength, offset );
+        levelsLeft = ( ( offset + length ) < pPublishInfo->topicNameLength );
+
+        /* Wildcards do not match a first level starting with $. */
+        wildcardsAllowed = ( ( node != TRIE_ROOT_INDEX ) || ( length == 0U ) || ( pLevel[ 0 ] != '$' ) );
+
+        if( ( wildcardsAllowed == true ) && ( pTrie->nodes[ node ].hashChild != TRIE_INDEX_NONE ) )
+        {
+            publishHandled = addMatches( pTrie->nodes[ node ].hashChild, pResults );
+        }
+
+        for( child = pTrie->nodes[ node ].firstChild; child != TRIE_INDEX_NONE; child = pTrie->nodes[ child ].nextSibling )
+        {
+            if( ( pTrie->nodes[ child ].levelLength == length ) &&
+                ( memcmp( pTrie->nodes[ child ].pLevel, pLevel, length ) == 0 ) )
+            {
+                publishHandled = matchLevels( child, pResults, ( uint16_t ) ( offset + length + 1U ), levelsLeft ) || publishHandled;
+                break;
+            }
+        }
+
+        if( ( wildcardsAllowed == true ) && ( pTrie->nodes[ node ].plusChild != TRIE_INDEX_NONE ) )
+        {
+            publishHandled = matchLevels( pTrie->nodes[ node ].plusChild, pResults, ( uint16_t ) ( offset + length + 1U ), levelsLeft ) || publishHandled;
+        }
+    }
+
+    return publishHandled;
+}
+
+/*-----------------------------------------------------------*/
+
+bool addSubscription( SubscriptionElement_t * pSubscriptionList,
+                      const char * pTopicFilterString,
+                      uint16_t topicFilterLength,
+                      IncomingPubCallback_t incomingPublishCallback,
+                      void * pIncomingPublishCallbackContext )
+{
+    SubscriptionTrie_t * pTrie = NULL;
+    uint16_t node = TRIE_INDEX_NONE, deepest = TRIE_ROOT_INDEX, index = TRIE_INDEX_NONE;
+    bool returnStatus = false;
+
+    if( ( pSubscriptionList == NULL ) ||
+        ( pTopicFilterString == NULL ) ||
+        ( topicFilterLength == 0U ) ||
+        ( incomingPublishCallback == NULL ) )
+    {
+        LogError( ( "Invalid parameter. pSubscriptionList=%p, pTopicFilterString=%p,"
+                    " topicFilterLength=%u, incomingPublishCallback=%p.",
+                    pSubscriptionList,
+                    pTopicFilterString,
+                    ( unsigned int ) topicFilterLength,
+                    incomingPublishCallback ) );
+    }
+    else
+    {
+        pTrie = getTrie( pSubscriptionList );
+    }
+
+    if( pTrie != NULL )
+    {
+        node = findFilterNode( pTrie, pTopicFilterString, topicFilterLength, true, &deepest );
+
+        if( node != TRIE_INDEX_NONE )
+        {
+            for( index = pTrie->nodes[ node ].firstElement; index != TRIE_INDEX_NONE; index = pTrie->nextElement[ index ] )
+            {
+                /* If a subscription already exists, don't do anything. */
+                if( ( pSubscriptionList[ index ].incomingPublishCallback == incomingPublishCallback ) &&
+                    ( pSubscriptionList[ index ].pIncomingPublishCallbackContext == pIncomingPublishCallbackContext ) )
+                {
+                    LogWarn( ( "Subscription already exists.\n" ) );
+                    returnStatus = true;
+                    break;
+                }
+            }
+
+            if( ( returnStatus == false ) && ( pTrie->freeElement != TRIE_INDEX_NONE ) )
+            {
+                index = pTrie->freeElement;
+                pTrie->freeElement = pTrie->nextElement[ index ];
+
+                pSubscriptionList[ index ].pSubscriptionFilterString = pTopicFilterString;
+                pSubscriptionList[ index ].filterStringLength = topicFilterLength;
+                pSubscriptionList[ index ].incomingPublishCallback = incomingPublishCallback;
+                pSubscriptionList[ index ].pIncomingPublishCallbackContext = pIncomingPublishCallbackContext;
+
+                pTrie->nextElement[ index ] = pTrie->nodes[ node ].firstElement;
+                pTrie->nodes[ node ].firstElement = index;
+                returnStatus = true;
+            }
+        }
+
+        if( returnStatus == false )
+        {
+            LogError( ( "Failed to add the subscription to %.*s.",
+                        ( int ) topicFilterLength,
+                        pTopicFilterString ) );
+
+            /* Free the nodes created for the filter. */
+            pruneNodes( pTrie, deepest );
+        }
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return returnStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+void removeSubscription( SubscriptionElement_t * pSubscriptionList,
+                         const char * pTopicFilterString,
+                         uint16_t topicFilterLength )
+{
+    SubscriptionTrie_t * pTrie = NULL;
+    uint16_t node = TRIE_INDEX_NONE, deepest = TRIE_ROOT_INDEX, index = TRIE_INDEX_NONE;
+
+    if( ( pSubscriptionList == NULL ) ||
+        ( pTopicFilterString == NULL ) ||
+        ( topicFilterLength == 0U ) )
+    {
+        LogError( ( "Invalid parameter. pSubscriptionList=%p, pTopicFilterString=%p,"
+                    " topicFilterLength=%u.",
+                    pSubscriptionList,
+                    pTopicFilterString,
+                    ( unsigned int ) topicFilterLength ) );
+    }
+    else
+    {
+        pTrie = getTrie( pSubscriptionList );
+    }
+
+    if( pTrie != NULL )
+    {
+        node = findFilterNode( pTrie, pTopicFilterString, topicFilterLength, false, &deepest );
+
+        if( node != TRIE_INDEX_NONE )
+        {
+            /* Remove every subscription to the filter. */
+            while( pTrie->nodes[ node ].firstElement != TRIE_INDEX_NONE )
+            {
+                index = pTrie->nodes[ node ].firstElement;
+                pTrie->nodes[ node ].firstElement = pTrie->nextElement[ index ];
+
+                memset( &( pSubscriptionList[ index ] ), 0x00, sizeof( SubscriptionElement_t ) );
+                pTrie->nextElement[ index ] = pTrie->freeElement;
+                pTrie->freeElement = index;
+            }
+
+            pruneNodes( pTrie, node );
+        }
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+bool handleIncomingPublishes( SubscriptionElement_t * pSubscriptionList,
+                              MQTTPublishInfo_t * pPublishInfo )
+{
+    bool publishHandled = false;
+    MatchResults_t results = { 0 };
+
+    if( ( pSubscriptionList == NULL ) ||
+        ( pPublishInfo == NULL ) )
+    {
+        LogError( ( "Invalid parameter. pSubscriptionList=%p, pPublishInfo=%p,",
+                    pSubscriptionList,
+                    pPublishInfo ) );
+    }
+    else if( pPublishInfo->topicNameLength > 0U )
+    {
+        results.pTrie = getTrie( pSubscriptionList );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( results.pTrie != NULL )
+    {
+        results.pPublishInfo = pPublishInfo;
+        publishHandled = matchLevels( TRIE_ROOT_INDEX, &results, 0U, true );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return publishHandled;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t findMatchingSubscriptions( SubscriptionElement_t * pSubscriptionList,
+                                  MQTTPublishInfo_t * pPublishInfo,
+                                  const SubscriptionElement_t ** ppMatches,
+                                  size_t maxMatches )
+{
+    MatchResults_t results = { 0 };
+
+    if( ( pSubscriptionList == NULL ) ||
+        ( pPublishInfo == NULL ) ||
+        ( ppMatches == NULL ) )
+    {
+        LogError( ( "Invalid parameter. pSubscriptionList=%p, pPublishInfo=%p, ppMatches=%p.",
+                    pSubscriptionList,
+                    pPublishInfo,
+                    ppMatches ) );
+    }
+    else if( pPublishInfo->topicNameLength > 0U )
+    {
+        results.pTrie = getTrie( pSubscriptionList );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( results.pTrie != NULL )
+    {
+        results.pPublishInfo = pPublishInfo;
+        results.ppMatches = ppMatches;
+        results.maxMatches = maxMatches;
+        ( void ) matchLevels( TRIE_ROOT_INDEX, &results, 0U, true );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return results.matchCount;
+}
+
+/*-----------------------------------------------------------*/
+
+void holdSubscriptionFilters( void )
+{
+    /* The filters are never copied, so they never move. */
+}
+
+/*-----------------------------------------------------------*/
+
+void releaseSubscriptionFilters( void )
+{
+    /* The filters are never copied, so they never move. */
+}
@@ -0,0 +1,428 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file thread_profiler_zephyr.c
+ * @brief Stack and CPU profiles of the threads created by the SDK, and the
+ * "sdk_threads" shell command printing them.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Zephyr includes. */
+#include <kernel.h>
+
+#if defined( CONFIG_SHELL )
+    #include <shell/shell.h>
+#endif
+
+/* Include header that defines log levels. */
+#include "logging_levels.h"
+
+/* Logging configuration for the thread profiler. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "ThreadProfiler"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+
+#include "logging_stack.h"
+
+#include "thread_profiler_zephyr.h"
+
+#if ( THREAD_PROFILING == 1 )
+
+/**
+ * @brief A registered thread.
+ */
+    typedef struct ProfiledThread
+    {
+        struct k_thread * pThread; /**< @brief The thread. */
+        uint64_t lastCycles;       /**< @brief Cycles it had run for at the previous sample. */
+        ThreadProfile_t profile;   /**< @brief Its profile at the last sample. */
+    } ProfiledThread_t;
+
+/**
+ * @brief The registered threads, in the order of their registration.
+ */
+    static ProfiledThread_t profiledThreads[ THREAD_PROFILER_MAX_THREADS ];
+
+/**
+ * @brief Number of entries of #profiledThreads in use.
+ */
+    static size_t profiledCount = 0U;
+
+/**
+ * @brief Mutex protecting #profiledThreads and #profiledCount.
+ */
+    K_MUTEX_DEFINE( profilerMutex );
+
+/**
+ * @brief Work item sampling the threads on the system work queue.
+ */
+    static struct k_work_delayable sampleWork;
+
+/**
+ * @brief Uptime in milliseconds of the previous sample.
+ */
+    static int64_t lastSampleMs = 0;
+
+/**
+ * @brief Function called after each sample, and its context.
+ */
+    static ThreadProfilerCallback_t sampleCallback = NULL;
+    static void * pSampleContext = NULL;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Cycles a thread has run for.
+ *
+ * @param[in] pThread The thread.
+ *
+ * @return Its execution cycles, or 0 without CONFIG_THREAD_RUNTIME_STATS.
+ */
+    static uint64_t threadCycles( struct k_thread * pThread );
+
+/**
+ * @brief Sample every registered thread, call the callback and schedule the
+ * next sample.
+ *
+ * @param[in] pWork The work item of the sampling.
+ */
+    static void sampleThreads( struct k_work * pWork );
+
+    #if defined( CONFIG_SHELL )
+
+/**
+ * @brief Print the profiles of the registered threads.
+ *
+ * @param[in] pShell The shell.
+ * @param[in] argc Number of arguments.
+ * @param[in] argv Arguments; "reset" resets the CPU peaks once printed.
+ *
+ * @return 0, or -EINVAL for an unknown argument.
+ */
+        static int threadsShellCommand( const struct shell * pShell,
+                                        size_t argc,
+                                        char ** argv );
+    #endif
+
+/*-----------------------------------------------------------*/
+
+    static uint64_t threadCycles( struct k_thread * pThread )
+    {
+        uint64_t cycles = 0U;
+
+        #if defined( CONFIG_THREAD_RUNTIME_STATS )
+            k_thread_runtime_stats_t threadStats;
+
+            if( k_thread_runtime_stats_get( pThread, &threadStats ) == 0 )
+            {
+                cycles = threadStats.execution_cycles;
+            }
+        #else
+            ( void ) pThread;
+        #endif
+
+        return cycles;
+    }
+/*-----------------------------------------------------------*/
+
+    static void sampleThreads( struct k_work * pWork )
+    {
+        static ThreadProfile_t profiles[ THREAD_PROFILER_MAX_THREADS ];
+        ProfiledThread_t * pEntry = NULL;
+        ThreadProfilerCallback_t callback = NULL;
+        void * pContext = NULL;
+        int64_t nowMs = k_uptime_get();
+        uint64_t elapsedCycles = 0U, cycles = 0U, runCycles = 0U;
+        size_t i = 0U, count = 0U;
+
+        ( void ) pWork;
+
+        elapsedCycles = ( ( uint64_t ) ( nowMs - lastSampleMs ) * ( uint64_t ) sys_clock_hw_cycles_per_sec() ) / 1000U;
+        lastSampleMs = nowMs;
+
+        ( void ) k_mutex_lock( &profilerMutex, K_FOREVER );
+
+        for( i = 0U; i < profiledCount; i++ )
+        {
+            pEntry = &( profiledThreads[ i ] );
+
+            #if defined( CONFIG_INIT_STACKS ) && defined( CONFIG_THREAD_STACK_INFO )
+                size_t unused = 0U;
+
+                /* The unused part of the stack is what was never written since
+                 * the thread was created, so this is the peak. */
+                if( k_thread_stack_space_get( pEntry->pThread, &unused ) == 0 )
+                {
+                    pEntry->profile.stackSize = pEntry->pThread->stack_info.size;
+                    pEntry->profile.stackPeak = pEntry->profile.stackSize - unused;
+                }
+            #endif
+
+            /* A thread created again restarts from zero cycles. */
+            cycles = threadCycles( pEntry->pThread );
+            runCycles = ( cycles >= pEntry->lastCycles ) ? ( cycles - pEntry->lastCycles ) : cycles;
+            pEntry->lastCycles = cycles;
+
+            pEntry->profile.cycles = cycles;
+            pEntry->profile.cpuPermille = ( elapsedCycles > 0U ) ?
+                                          ( uint32_t ) MIN( ( runCycles * 1000U ) / elapsedCycles, 1000U ) : 0U;
+            pEntry->profile.peakCpuPermille = MAX( pEntry->profile.peakCpuPermille, pEntry->profile.cpuPermille );
+
+            profiles[ i ] = pEntry->profile;
+        }
+
+        count = profiledCount;
+        callback = sampleCallback;
+        pContext = pSampleContext;
+
+        k_mutex_unlock( &profilerMutex );
+
+        if( callback != NULL )
+        {
+            callback( profiles, count, pContext );
+        }
+
+        ( void ) k_work_schedule( &sampleWork, K_MSEC( THREAD_PROFILER_PERIOD_MS ) );
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* if ( THREAD_PROFILING == 1 ) */
+
+void ThreadProfiler_Register( struct k_thread * pThread,
+                              const char * pName )
+{
+    assert( pThread != NULL );
+    assert( pName != NULL );
+
+    #if ( THREAD_PROFILING == 1 )
+        ProfiledThread_t * pEntry = NULL;
+        size_t i = 0U;
+
+        ( void ) k_mutex_lock( &profilerMutex, K_FOREVER );
+
+        for( i = 0U; ( i < profiledCount ) && ( pEntry == NULL ); i++ )
+        {
+            if( profiledThreads[ i ].pThread == pThread )
+            {
+                pEntry = &( profiledThreads[ i ] );
+            }
+        }
+
+        if( ( pEntry == NULL ) && ( profiledCount < THREAD_PROFILER_MAX_THREADS ) )
+        {
+            pEntry = &( profiledThreads[ profiledCount ] );
+            profiledCount++;
+        }
+
+        if( pEntry != NULL )
+        {
+            ( void ) memset( pEntry, 0, sizeof( ProfiledThread_t ) );
+            pEntry->pThread = pThread;
+            pEntry->lastCycles = threadCycles( pThread );
+            pEntry->profile.pName = pName;
+        }
+
+        k_mutex_unlock( &profilerMutex );
+
+        if( pEntry == NULL )
+        {
+            LogWarn( ( "Thread %s not profiled: %u threads are registered already.",
+                       pName,
+                       ( unsigned int ) THREAD_PROFILER_MAX_THREADS ) );
+        }
+    #else /* if ( THREAD_PROFILING == 1 ) */
+        ( void ) pThread;
+        ( void ) pName;
+    #endif /* if ( THREAD_PROFILING == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+void ThreadProfiler_Start( ThreadProfilerCallback_t callback,
+                           void * pContext )
+{
+    #if ( THREAD_PROFILING == 1 )
+        static bool started = false;
+
+        ( void ) k_mutex_lock( &profilerMutex, K_FOREVER );
+
+        sampleCallback = callback;
+        pSampleContext = pContext;
+
+        if( started == false )
+        {
+            started = true;
+            lastSampleMs = k_uptime_get();
+            k_work_init_delayable( &sampleWork, sampleThreads );
+            ( void ) k_work_schedule( &sampleWork, K_MSEC( THREAD_PROFILER_PERIOD_MS ) );
+        }
+
+        k_mutex_unlock( &profilerMutex );
+    #else
+        ( void ) callback;
+        ( void ) pContext;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+size_t ThreadProfiler_GetProfiles( ThreadProfile_t * pProfiles,
+                                   size_t maxProfiles,
+                                   bool reset )
+{
+    size_t count = 0U;
+
+    assert( ( pProfiles != NULL ) || ( maxProfiles == 0U ) );
+
+    #if ( THREAD_PROFILING == 1 )
+        size_t i = 0U;
+
+        ( void ) k_mutex_lock( &profilerMutex, K_FOREVER );
+
+        count = MIN( profiledCount, maxProfiles );
+
+        for( i = 0U; i < count; i++ )
+        {
+            pProfiles[ i ] = profiledThreads[ i ].profile;
+
+            if( reset == true )
+            {
+                profiledThreads[ i ].profile.peakCpuPermille = profiledThreads[ i ].profile.cpuPermille;
+            }
+        }
+
+        k_mutex_unlock( &profilerMutex );
+    #else
+        ( void ) pProfiles;
+        ( void ) maxProfiles;
+        ( void ) reset;
+    #endif
+
+    return count;
+}
+/*-----------------------------------------------------------*/
+
+size_t ThreadProfiler_Serialize( const ThreadProfile_t * pProfiles,
+                                 size_t count,
+                                 char * pBuffer,
+                                 size_t bufferSize )
+{
+    size_t length = 0U, i = 0U;
+    int written = 0;
+
+    assert( ( pProfiles != NULL ) || ( count == 0U ) );
+    assert( pBuffer != NULL );
+
+    written = snprintf( pBuffer, bufferSize, "{\"threads\":[" );
+
+    for( i = 0U; ( i < count ) && ( written >= 0 ) && ( ( length + ( size_t ) written ) < bufferSize ); i++ )
+    {
+        length += ( size_t ) written;
+        written = snprintf( &( pBuffer[ length ] ),
+                            bufferSize - length,
+                            "%s{\"name\":\"%s\",\"stack\":%u,\"stackPeak\":%u,\"cpu\":%u,\"cpuPeak\":%u}",
+                            ( i > 0U ) ? "," : "",
+                            pProfiles[ i ].pName,
+                            ( unsigned int ) pProfiles[ i ].stackSize,
+                            ( unsigned int ) pProfiles[ i ].stackPeak,
+                            ( unsigned int ) pProfiles[ i ].cpuPermille,
+                            ( unsigned int ) pProfiles[ i ].peakCpuPermille );
+    }
+
+    if( ( written >= 0 ) && ( ( length + ( size_t ) written ) < bufferSize ) )
+    {
+        length += ( size_t ) written;
+        written = snprintf( &( pBuffer[ length ] ), bufferSize - length, "]}" );
+    }
+
+    if( ( written >= 0 ) && ( ( length + ( size_t ) written ) < bufferSize ) )
+    {
+        length += ( size_t ) written;
+    }
+    else
+    {
+        length = 0U;
+    }
+
+    return length;
+}
+/*-----------------------------------------------------------*/
+
+#if ( THREAD_PROFILING == 1 ) && defined( CONFIG_SHELL )
+
+    static int threadsShellCommand( const struct shell * pShell,
+                                    size_t argc,
+                                    char ** argv )
+    {
+        ThreadProfile_t profiles[ THREAD_PROFILER_MAX_THREADS ];
+        bool reset = false;
+        int ret = 0;
+        size_t i = 0U, count = 0U;
+
+        if( argc > 1 )
+        {
+            if( strcmp( argv[ 1 ], "reset" ) == 0 )
+            {
+                reset = true;
+            }
+            else
+            {
+                shell_error( pShell, "Unknown argument: %s", argv[ 1 ] );
+                ret = -EINVAL;
+            }
+        }
+
+        if( ret == 0 )
+        {
+            count = ThreadProfiler_GetProfiles( profiles, THREAD_PROFILER_MAX_THREADS, reset );
+
+            for( i = 0U; i < count; i++ )
+            {
+                shell_print( pShell,
+                             "%-16s stack %5u/%5u cpu %3u.%u%% peak %3u.%u%%",
+                             profiles[ i ].pName,
+                             ( unsigned int ) profiles[ i ].stackPeak,
+                             ( unsigned int ) profiles[ i ].stackSize,
+                             ( unsigned int ) ( profiles[ i ].cpuPermille / 10U ),
+                             ( unsigned int ) ( profiles[ i ].cpuPermille % 10U ),
+                             ( unsigned int ) ( profiles[ i ].peakCpuPermille / 10U ),
+                             ( unsigned int ) ( profiles[ i ].peakCpuPermille % 10U ) );
+            }
+        }
+
+        return ret;
+    }
+
+    SHELL_CMD_ARG_REGISTER( sdk_threads, NULL,
+                            "Print the stack peaks and CPU shares of the SDK threads. "
+                            "Usage: sdk_threads [reset]",
+                            threadsShellCommand, 1, 1 );
+/*-----------------------------------------------------------*/
+
+#endif /* if ( THREAD_PROFILING == 1 ) && defined( CONFIG_SHELL ) */
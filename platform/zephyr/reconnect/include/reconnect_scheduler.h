@@ -0,0 +1,132 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file reconnect_scheduler.h
+ * @brief Delays between the attempts to connect to a server, shared by the
+ * demos.
+ *
+ * The delays follow decorrelated jitter: each is drawn uniformly between a
+ * floor and three times the previous delay, capped, from the cryptographic
+ * random number generator. Devices that lose the server at the same time
+ * therefore drift apart instead of retrying in waves. The floor depends on
+ * what failed, and the first retry after a TCP or TLS failure is made at once,
+ * as such failures are mostly transient.
+ *
+ * With CONFIG_AWS_IOT_RECONNECT_PERSIST, the previous delay of each named
+ * scheduler is kept in the settings subsystem until a connection succeeds, so
+ * that a device rebooting while the server is down resumes its backoff.
+ */
+#ifndef RECONNECT_SCHEDULER_H
+#define RECONNECT_SCHEDULER_H
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief The maximum length of the name of a scheduler that keeps its state
+ * across reboots.
+ */
+#ifndef RECONNECT_MAX_NAME_LENGTH
+    #define RECONNECT_MAX_NAME_LENGTH    ( 16U )
+#endif
+
+/**
+ * @brief Value of the maximum number of attempts that retries forever.
+ */
+#define RECONNECT_RETRY_FOREVER    ( 0U )
+
+/**
+ * @brief What failed in a connection attempt.
+ */
+typedef enum ReconnectFailure
+{
+    RECONNECT_FAILURE_DNS = 0, /**< Resolving the host name of the server failed. */
+    RECONNECT_FAILURE_TCP,     /**< The TCP connection failed, or the cause is not known. */
+    RECONNECT_FAILURE_TLS,     /**< The TLS handshake failed. */
+    RECONNECT_FAILURE_CONNACK  /**< The server did not accept the application protocol connection. */
+} ReconnectFailure_t;
+
+/**
+ * @brief State of the retries of one connection.
+ */
+typedef struct ReconnectScheduler
+{
+    const char * pName;       /**< @brief Name in the logs and in the settings. */
+    uint32_t baseMs;          /**< @brief Floor of the delays, before scaling by the failure. */
+    uint32_t maxDelayMs;      /**< @brief Cap of the delays. */
+    uint32_t maxAttempts;     /**< @brief Retries before giving up, or #RECONNECT_RETRY_FOREVER. */
+    uint32_t attempts;        /**< @brief Retries since the scheduler was initialized. */
+    uint32_t previousDelayMs; /**< @brief The last delay, from which the next one is drawn. */
+    bool restored;            /**< @brief Whether the last delay was kept from before a reboot. */
+} ReconnectScheduler_t;
+
+/**
+ * @brief Initialize a scheduler, restoring its previous delay if it was kept.
+ *
+ * @param[out] pScheduler The scheduler.
+ * @param[in] pName Name of the connection, of at most
+ * #RECONNECT_MAX_NAME_LENGTH characters; it must stay valid.
+ * @param[in] baseMs Floor of the delays in milliseconds.
+ * @param[in] maxDelayMs Cap of the delays in milliseconds.
+ * @param[in] maxAttempts Retries before giving up, or #RECONNECT_RETRY_FOREVER.
+ */
+void Reconnect_Init( ReconnectScheduler_t * pScheduler,
+                     const char * pName,
+                     uint32_t baseMs,
+                     uint32_t maxDelayMs,
+                     uint32_t maxAttempts );
+
+/**
+ * @brief Compute the delay before retrying a failed attempt.
+ *
+ * @param[in] pScheduler The scheduler.
+ * @param[in] failure What failed.
+ * @param[out] pDelayMs The delay in milliseconds.
+ *
+ * @return true, or false if the attempts are exhausted.
+ */
+bool Reconnect_NextDelay( ReconnectScheduler_t * pScheduler,
+                          ReconnectFailure_t failure,
+                          uint32_t * pDelayMs );
+
+/**
+ * @brief Wait before retrying a failed attempt, with #Reconnect_NextDelay.
+ *
+ * @param[in] pScheduler The scheduler.
+ * @param[in] failure What failed.
+ *
+ * @return true once the delay elapsed, or false if the attempts are exhausted.
+ */
+bool Reconnect_Wait( ReconnectScheduler_t * pScheduler,
+                     ReconnectFailure_t failure );
+
+/**
+ * @brief Record a successful connection, so that the next failure is retried
+ * at once again, and forget the kept delay.
+ *
+ * @param[in] pScheduler The scheduler.
+ */
+void Reconnect_Succeeded( ReconnectScheduler_t * pScheduler );
+
+#endif /* ifndef RECONNECT_SCHEDULER_H */
@@ -0,0 +1,369 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file reconnect_scheduler.c
+ * @brief Decorrelated jitter delays between connection attempts.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Zephyr includes. */
+#include <kernel.h>
+#include <random/rand32.h>
+
+#if defined( CONFIG_AWS_IOT_RECONNECT_PERSIST )
+    #include <settings/settings.h>
+#endif
+
+/* Include header that defines log levels. */
+#include "logging_levels.h"
+
+/* Logging configuration for the reconnect scheduler. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "Reconnect"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+
+#include "logging_stack.h"
+
+#include "reconnect_scheduler.h"
+
+/**
+ * @brief Number of values of #ReconnectFailure_t.
+ */
+#define RECONNECT_FAILURE_TYPES    ( 4U )
+
+/**
+ * @brief Prefix of the settings keys of the schedulers.
+ */
+#define RECONNECT_SETTINGS_PREFIX    "aws_iot/reconnect/"
+
+/**
+ * @brief How each kind of failure is retried.
+ */
+typedef struct ReconnectPolicy
+{
+    const char * pName;       /**< @brief Name of the failure in the logs. */
+    bool immediateFirstRetry; /**< @brief Whether the first retry is made without delay. */
+    uint8_t baseShift;        /**< @brief The floor of the delays is the base shifted left by this. */
+} ReconnectPolicy_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The policies, indexed by #ReconnectFailure_t.
+ *
+ * A reset or timed out TCP connection and an interrupted handshake are mostly
+ * transient, so they are retried at once. A DNS failure is cached by the
+ * sockets layer for a while, and a refused CONNECT usually means the broker is
+ * throttling, so both start from a higher floor.
+ */
+static const ReconnectPolicy_t policies[ RECONNECT_FAILURE_TYPES ] =
+{
+    { "DNS",     false, 1U },
+    { "TCP",     true,  0U },
+    { "TLS",     true,  0U },
+    { "CONNACK", false, 2U }
+};
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Draw a random number, from the CSPRNG when there is one.
+ *
+ * @return The random number.
+ */
+static uint32_t randomNumber( void );
+
+#if defined( CONFIG_AWS_IOT_RECONNECT_PERSIST )
+
+/**
+ * @brief Build the settings key of a scheduler.
+ *
+ * @param[in] pScheduler The scheduler.
+ * @param[out] pKey Buffer of the key.
+ * @param[in] keyLength Size of @p pKey.
+ *
+ * @return true, or false if the scheduler has no name or it is too long.
+ */
+    static bool settingsKey( const ReconnectScheduler_t * pScheduler,
+                             char * pKey,
+                             size_t keyLength );
+
+/**
+ * @brief Called by the settings subsystem with the kept delay of a scheduler.
+ *
+ * @param[in] pKey Remainder of the key, not used.
+ * @param[in] length Length of the value.
+ * @param[in] readCallback Function reading the value.
+ * @param[in] pCallbackArgument Argument of @p readCallback.
+ * @param[in] pParameter The scheduler.
+ *
+ * @return 0.
+ */
+    static int loadDelay( const char * pKey,
+                          size_t length,
+                          settings_read_cb readCallback,
+                          void * pCallbackArgument,
+                          void * pParameter );
+
+/**
+ * @brief Keep the last delay of a scheduler, or forget it when it is 0.
+ *
+ * @param[in] pScheduler The scheduler.
+ */
+    static void storeDelay( const ReconnectScheduler_t * pScheduler );
+#endif /* if defined( CONFIG_AWS_IOT_RECONNECT_PERSIST ) */
+
+/*-----------------------------------------------------------*/
+
+static uint32_t randomNumber( void )
+{
+    uint32_t number = 0U;
+
+    #if defined( CONFIG_CSPRNG_ENABLED )
+        if( sys_csrand_get( &number, sizeof( number ) ) != 0 )
+        {
+            LogWarn( ( "The CSPRNG failed; using the non-cryptographic generator." ) );
+            number = sys_rand32_get();
+        }
+    #else
+        number = sys_rand32_get();
+    #endif
+
+    return number;
+}
+/*-----------------------------------------------------------*/
+
+#if defined( CONFIG_AWS_IOT_RECONNECT_PERSIST )
+
+    static bool settingsKey( const ReconnectScheduler_t * pScheduler,
+                             char * pKey,
+                             size_t keyLength )
+    {
+        bool valid = false;
+
+        if( ( pScheduler->pName != NULL ) &&
+            ( strlen( pScheduler->pName ) <= RECONNECT_MAX_NAME_LENGTH ) )
+        {
+            ( void ) snprintf( pKey, keyLength, RECONNECT_SETTINGS_PREFIX "%s", pScheduler->pName );
+            valid = true;
+        }
+
+        return valid;
+    }
+/*-----------------------------------------------------------*/
+
+    static int loadDelay( const char * pKey,
+                          size_t length,
+                          settings_read_cb readCallback,
+                          void * pCallbackArgument,
+                          void * pParameter )
+    {
+        ReconnectScheduler_t * pScheduler = ( ReconnectScheduler_t * ) pParameter;
+        uint32_t delayMs = 0U;
+
+        ( void ) pKey;
+
+        if( ( length == sizeof( delayMs ) ) &&
+            ( readCallback( pCallbackArgument, &delayMs, sizeof( delayMs ) ) == ( ssize_t ) sizeof( delayMs ) ) &&
+            ( delayMs > 0U ) )
+        {
+            pScheduler->previousDelayMs = MIN( delayMs, pScheduler->maxDelayMs );
+            pScheduler->restored = true;
+        }
+
+        return 0;
+    }
+/*-----------------------------------------------------------*/
+
+    static void storeDelay( const ReconnectScheduler_t * pScheduler )
+    {
+        char key[ sizeof( RECONNECT_SETTINGS_PREFIX ) + RECONNECT_MAX_NAME_LENGTH ];
+        int result = 0;
+
+        if( settingsKey( pScheduler, key, sizeof( key ) ) == true )
+        {
+            if( pScheduler->previousDelayMs > 0U )
+            {
+                result = settings_save_one( key,
+                                            &( pScheduler->previousDelayMs ),
+                                            sizeof( pScheduler->previousDelayMs ) );
+            }
+            else
+            {
+                result = settings_delete( key );
+            }
+
+            if( result != 0 )
+            {
+                LogWarn( ( "Failed to store the reconnect state of %s: %d.", pScheduler->pName, result ) );
+            }
+        }
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* if defined( CONFIG_AWS_IOT_RECONNECT_PERSIST ) */
+
+void Reconnect_Init( ReconnectScheduler_t * pScheduler,
+                     const char * pName,
+                     uint32_t baseMs,
+                     uint32_t maxDelayMs,
+                     uint32_t maxAttempts )
+{
+    assert( pScheduler != NULL );
+    assert( baseMs > 0U );
+
+    ( void ) memset( pScheduler, 0x00, sizeof( ReconnectScheduler_t ) );
+    pScheduler->pName = pName;
+    pScheduler->baseMs = baseMs;
+    pScheduler->maxDelayMs = MAX( maxDelayMs, baseMs );
+    pScheduler->maxAttempts = maxAttempts;
+
+    #if defined( CONFIG_AWS_IOT_RECONNECT_PERSIST )
+    {
+        char key[ sizeof( RECONNECT_SETTINGS_PREFIX ) + RECONNECT_MAX_NAME_LENGTH ];
+
+        if( ( settingsKey( pScheduler, key, sizeof( key ) ) == true ) &&
+            ( settings_subsys_init() == 0 ) )
+        {
+            ( void ) settings_load_subtree_direct( key, loadDelay, pScheduler );
+        }
+
+        if( pScheduler->restored == true )
+        {
+            LogInfo( ( "Resuming the reconnect backoff of %s from %u ms.",
+                       pName,
+                       ( unsigned int ) pScheduler->previousDelayMs ) );
+        }
+    }
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+bool Reconnect_NextDelay( ReconnectScheduler_t * pScheduler,
+                          ReconnectFailure_t failure,
+                          uint32_t * pDelayMs )
+{
+    const ReconnectPolicy_t * pPolicy = NULL;
+    bool retry = false;
+    uint32_t floorMs = 0U, ceilingMs = 0U, delayMs = 0U;
+
+    assert( pScheduler != NULL );
+    assert( pDelayMs != NULL );
+    assert( ( uint32_t ) failure < RECONNECT_FAILURE_TYPES );
+
+    pPolicy = &( policies[ failure ] );
+
+    if( ( pScheduler->maxAttempts == RECONNECT_RETRY_FOREVER ) ||
+        ( pScheduler->attempts < pScheduler->maxAttempts ) )
+    {
+        retry = true;
+
+        if( ( pScheduler->attempts == 0U ) &&
+            ( pScheduler->restored == false ) &&
+            ( pPolicy->immediateFirstRetry == true ) )
+        {
+            /* The first retry does not wait, and leaves the backoff at its floor. */
+            delayMs = 0U;
+        }
+        else
+        {
+            floorMs = MIN( pScheduler->baseMs << pPolicy->baseShift, pScheduler->maxDelayMs );
+
+            /* Draw the delay between the floor and three times the previous
+             * delay, or the floor when there is none, capped such that it
+             * cannot overflow. */
+            ceilingMs = MAX( pScheduler->previousDelayMs, floorMs );
+            ceilingMs = ( ceilingMs > ( pScheduler->maxDelayMs / 3U ) ) ? pScheduler->maxDelayMs : ( ceilingMs * 3U );
+            delayMs = floorMs + ( randomNumber() % ( ceilingMs - floorMs + 1U ) );
+            pScheduler->previousDelayMs = delayMs;
+
+            #if defined( CONFIG_AWS_IOT_RECONNECT_PERSIST )
+                storeDelay( pScheduler );
+            #endif
+        }
+
+        pScheduler->attempts++;
+        *pDelayMs = delayMs;
+    }
+
+    return retry;
+}
+/*-----------------------------------------------------------*/
+
+bool Reconnect_Wait( ReconnectScheduler_t * pScheduler,
+                     ReconnectFailure_t failure )
+{
+    uint32_t delayMs = 0U;
+    bool retry = false;
+
+    retry = Reconnect_NextDelay( pScheduler, failure, &delayMs );
+
+    if( retry == true )
+    {
+        LogWarn( ( "%s connection failed at %s. Retry %u in %u ms.",
+                   ( pScheduler->pName != NULL ) ? pScheduler->pName : "The",
+                   policies[ failure ].pName,
+                   ( unsigned int ) pScheduler->attempts,
+                   ( unsigned int ) delayMs ) );
+
+        if( delayMs > 0U )
+        {
+            k_sleep( K_MSEC( delayMs ) );
+        }
+    }
+    else
+    {
+        LogError( ( "%s connection failed at %s, all %u retries exhausted.",
+                    ( pScheduler->pName != NULL ) ? pScheduler->pName : "The",
+                    policies[ failure ].pName,
+                    ( unsigned int ) pScheduler->maxAttempts ) );
+    }
+
+    return retry;
+}
+/*-----------------------------------------------------------*/
+
+void Reconnect_Succeeded( ReconnectScheduler_t * pScheduler )
+{
+    assert( pScheduler != NULL );
+
+    #if defined( CONFIG_AWS_IOT_RECONNECT_PERSIST )
+        if( pScheduler->previousDelayMs > 0U )
+        {
+            pScheduler->previousDelayMs = 0U;
+            storeDelay( pScheduler );
+        }
+    #endif
+
+    pScheduler->attempts = 0U;
+    pScheduler->previousDelayMs = 0U;
+    pScheduler->restored = false;
+}
+/*-----------------------------------------------------------*/
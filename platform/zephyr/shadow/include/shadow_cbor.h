@@ -0,0 +1,211 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file shadow_cbor.h
+ * @brief Allocation-free encoder and decoder of the subset of CBOR (RFC 8949)
+ * used by compact shadow documents.
+ *
+ * A CBOR document is smaller than the same JSON document, as integers and
+ * the lengths of strings are binary, and it is decoded without scanning for
+ * quotes, escapes and digits. Shadow topics only accept JSON, so CBOR
+ * documents are published to a topic of an AWS IoT rule, which converts
+ * them for the Device Shadow service.
+ *
+ * The encoder writes definite-length items straight into the buffer of the
+ * caller. #ShadowCbor_FindKeys validates a document and locates the values
+ * of a table of keys in a single pass, like #JSONExtract_Keys. Keys are map
+ * keys separated by '.', e.g. "state.reported.powerOn"; array elements cannot
+ * be selected. Indefinite-length items are not supported.
+ */
+
+#ifndef SHADOW_CBOR_H_
+#define SHADOW_CBOR_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Deepest nesting of maps and arrays accepted by #ShadowCbor_FindKeys.
+ */
+#ifndef SHADOW_CBOR_MAX_DEPTH
+    #define SHADOW_CBOR_MAX_DEPTH    ( 8U )
+#endif
+
+/**
+ * @brief Return codes of the CBOR decoder.
+ */
+typedef enum ShadowCborStatus
+{
+    SHADOW_CBOR_SUCCESS = 0,         /**< The document is valid and has all the keys. */
+    SHADOW_CBOR_INVALID_PARAMETER,   /**< At least one parameter was invalid. */
+    SHADOW_CBOR_NOT_FOUND,           /**< The document is valid but some keys have no value. */
+    SHADOW_CBOR_PARTIAL,             /**< The document is truncated. */
+    SHADOW_CBOR_MAX_DEPTH_EXCEEDED,  /**< The document nests deeper than #SHADOW_CBOR_MAX_DEPTH. */
+    SHADOW_CBOR_ILLEGAL_DOCUMENT     /**< The document is not valid, or uses an unsupported item. */
+} ShadowCborStatus_t;
+
+/**
+ * @brief Types of the values located by #ShadowCbor_FindKeys.
+ */
+typedef enum ShadowCborType
+{
+    SHADOW_CBOR_TYPE_UINT = 0,   /**< An unsigned integer, in #ShadowCborKey_t.argument. */
+    SHADOW_CBOR_TYPE_NEGATIVE,   /**< The negative integer -1 - #ShadowCborKey_t.argument. */
+    SHADOW_CBOR_TYPE_BYTES,      /**< A byte string. */
+    SHADOW_CBOR_TYPE_TEXT,       /**< A UTF-8 text string, which is not NUL terminated. */
+    SHADOW_CBOR_TYPE_ARRAY,      /**< An array of #ShadowCborKey_t.argument items. */
+    SHADOW_CBOR_TYPE_MAP,        /**< A map of #ShadowCborKey_t.argument pairs. */
+    SHADOW_CBOR_TYPE_BOOL,       /**< A boolean, 0 or 1 in #ShadowCborKey_t.argument. */
+    SHADOW_CBOR_TYPE_NULL,       /**< The null value. */
+    SHADOW_CBOR_TYPE_FLOAT,      /**< A half, single or double float, whose bits are in #ShadowCborKey_t.argument. */
+    SHADOW_CBOR_TYPE_SIMPLE      /**< Another simple value, in #ShadowCborKey_t.argument. */
+} ShadowCborType_t;
+
+/**
+ * @brief A key to locate in a document, and its value once located.
+ *
+ * Only #ShadowCborKey_t.pKey and #ShadowCborKey_t.keyLength need to be set
+ * by the caller; #ShadowCbor_FindKeys sets the other fields.
+ */
+typedef struct ShadowCborKey
+{
+    const char * pKey;     /**< @brief Path of the key, map keys separated by '.'. */
+    size_t keyLength;      /**< @brief Length of #ShadowCborKey_t.pKey. */
+
+    bool found;            /**< @brief Whether the document has the key. */
+    ShadowCborType_t type; /**< @brief Type of the value. */
+    uint64_t argument;     /**< @brief Integer, length, count or bits of the value, as per its type. */
+
+    /**
+     * @brief The bytes of a string value, or the encoding of any other value
+     * (for maps and arrays, of all their items).
+     */
+    const uint8_t * pData;
+    size_t dataLength;     /**< @brief Length of #ShadowCborKey_t.pData. */
+
+    /* Progress of the scan; not meant to be read by the caller. */
+    uint16_t matchedDepth; /**< @brief Number of segments of the key matching the current path. */
+    bool pending;          /**< @brief The next item is the value of the key. */
+} ShadowCborKey_t;
+
+/**
+ * @brief Helper to initialize a #ShadowCborKey_t from a string literal key.
+ */
+#define SHADOW_CBOR_KEY( key )    { ( key ), sizeof( key ) - 1U, false, SHADOW_CBOR_TYPE_NULL, 0U, NULL, 0U, 0U, false }
+
+/**
+ * @brief Writes CBOR items into a buffer. Once an item does not fit, nothing
+ * more is written and #ShadowCborWriter_t.overflow is set, so a document is
+ * written without checking each item.
+ */
+typedef struct ShadowCborWriter
+{
+    uint8_t * pBuffer; /**< @brief The buffer. */
+    size_t size;       /**< @brief Size of the buffer. */
+    size_t length;     /**< @brief Length of the document written so far. */
+    bool overflow;     /**< @brief An item did not fit in the buffer. */
+} ShadowCborWriter_t;
+
+/**
+ * @brief Start writing a document into a buffer.
+ *
+ * @param[out] pWriter The writer.
+ * @param[in] pBuffer The buffer.
+ * @param[in] size Size of @p pBuffer.
+ */
+void ShadowCbor_WriterInit( ShadowCborWriter_t * pWriter,
+                            uint8_t * pBuffer,
+                            size_t size );
+
+/**
+ * @brief Write the head of a map, to be followed by its keys and values.
+ *
+ * @param[in] pWriter The writer.
+ * @param[in] pairCount Number of key and value pairs of the map.
+ */
+void ShadowCbor_EncodeMap( ShadowCborWriter_t * pWriter,
+                           size_t pairCount );
+
+/**
+ * @brief Write an unsigned integer.
+ *
+ * @param[in] pWriter The writer.
+ * @param[in] value The integer.
+ */
+void ShadowCbor_EncodeUint( ShadowCborWriter_t * pWriter,
+                            uint32_t value );
+
+/**
+ * @brief Write a signed integer.
+ *
+ * @param[in] pWriter The writer.
+ * @param[in] value The integer.
+ */
+void ShadowCbor_EncodeInt( ShadowCborWriter_t * pWriter,
+                           int32_t value );
+
+/**
+ * @brief Write a boolean.
+ *
+ * @param[in] pWriter The writer.
+ * @param[in] value The boolean.
+ */
+void ShadowCbor_EncodeBool( ShadowCborWriter_t * pWriter,
+                            bool value );
+
+/**
+ * @brief Write a text string.
+ *
+ * @param[in] pWriter The writer.
+ * @param[in] pText The UTF-8 text, which need not be NUL terminated.
+ * @param[in] length Length of @p pText.
+ */
+void ShadowCbor_EncodeText( ShadowCborWriter_t * pWriter,
+                            const char * pText,
+                            size_t length );
+
+/**
+ * @brief Validate a CBOR document and locate the values of a table of keys,
+ * in a single pass over the document.
+ *
+ * The document must be exactly one well-formed item. When a key appears more
+ * than once, its first value is returned.
+ *
+ * @param[in] pBuffer The document.
+ * @param[in] length Length of the document.
+ * @param[in,out] pKeys The keys to locate. Their values are set on return.
+ * @param[in] keyCount Number of entries of @p pKeys.
+ *
+ * @return #SHADOW_CBOR_SUCCESS if the document is valid and has all the keys;
+ * #SHADOW_CBOR_NOT_FOUND if it is valid but some keys have no value;
+ * #SHADOW_CBOR_INVALID_PARAMETER, #SHADOW_CBOR_PARTIAL,
+ * #SHADOW_CBOR_MAX_DEPTH_EXCEEDED or #SHADOW_CBOR_ILLEGAL_DOCUMENT otherwise.
+ */
+ShadowCborStatus_t ShadowCbor_FindKeys( const uint8_t * pBuffer,
+                                        size_t length,
+                                        ShadowCborKey_t * pKeys,
+                                        size_t keyCount );
+
+#endif /* ifndef SHADOW_CBOR_H_ */
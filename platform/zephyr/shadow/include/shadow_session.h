@@ -0,0 +1,243 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file shadow_session.h
+ * @brief Topics of the device shadows of a thing, built once, and dispatch of
+ * their incoming messages from a hash table of the topics.
+ *
+ * Matching each incoming topic with Shadow_MatchTopicString() parses it
+ * character by character, and every subscription or publish assembles its
+ * topic again. A session assembles all the topics of a set of shadows of a
+ * thing at initialization. An incoming message is then dispatched with one
+ * hash of its topic and the comparison of the topics of a hash bucket, to the
+ * handler registered for its message type, with the index of its shadow.
+ *
+ * @note A session is not thread safe; it is meant to be used from the thread
+ * running the MQTT connection.
+ */
+
+#ifndef SHADOW_SESSION_H_
+#define SHADOW_SESSION_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* MQTT API header. */
+#include "core_mqtt.h"
+
+/* SHADOW API header. */
+#include "shadow.h"
+
+/**
+ * @brief Size of the buffer of each topic, which bounds the lengths of the
+ * thing and shadow names.
+ */
+#ifndef SHADOW_SESSION_TOPIC_MAX_LENGTH
+    #define SHADOW_SESSION_TOPIC_MAX_LENGTH    ( 128U )
+#endif
+
+/**
+ * @brief Number of response topics of a shadow, one for each
+ * #ShadowMessageType_t.
+ */
+#define SHADOW_SESSION_RESPONSE_TOPICS    ( ( size_t ) ShadowMessageTypeMaxNum )
+
+/**
+ * @brief Number of topics of a shadow: its response topics, then its get,
+ * delete and update topics.
+ */
+#define SHADOW_SESSION_TOPICS_PER_SHADOW    ( SHADOW_SESSION_RESPONSE_TOPICS + 3U )
+
+/**
+ * @brief Return codes of the shadow session functions.
+ */
+typedef enum ShadowSessionStatus
+{
+    SHADOW_SESSION_SUCCESS = 0,       /**< Function successfully completed. */
+    SHADOW_SESSION_INVALID_PARAMETER, /**< At least one parameter was invalid. */
+    SHADOW_SESSION_TOPIC_TOO_LONG     /**< A topic does not fit in #SHADOW_SESSION_TOPIC_MAX_LENGTH. */
+} ShadowSessionStatus_t;
+
+/**
+ * @brief Handler of the incoming messages of a message type.
+ *
+ * @param[in] pContext The context given to #ShadowSession_Init.
+ * @param[in] shadowIndex Index of the shadow in the names given to
+ * #ShadowSession_Init.
+ * @param[in] pPublishInfo The incoming message.
+ */
+typedef void ( * ShadowSessionHandler_t )( void * pContext,
+                                           size_t shadowIndex,
+                                           MQTTPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Name of a shadow of a session. Use #SHADOW_NAME_CLASSIC and a
+ * length of 0 for the classic shadow.
+ */
+typedef struct ShadowSessionName
+{
+    const char * pName; /**< @brief The name. */
+    uint8_t nameLength; /**< @brief Length of #ShadowSessionName_t.pName. */
+} ShadowSessionName_t;
+
+/**
+ * @brief A topic of a session.
+ */
+typedef struct ShadowSessionTopic
+{
+    char topic[ SHADOW_SESSION_TOPIC_MAX_LENGTH ]; /**< @brief The topic. */
+    uint16_t topicLength;                          /**< @brief Length of the topic. */
+
+    /**
+     * @brief One more than the index of the next topic of the same hash
+     * bucket, or 0 at the end of the bucket.
+     */
+    uint16_t nextInBucket;
+} ShadowSessionTopic_t;
+
+/**
+ * @brief Topics and handlers of the shadows of a thing.
+ *
+ * Define one with #SHADOW_SESSION_DEFINE.
+ */
+typedef struct ShadowSession
+{
+    ShadowSessionTopic_t * pTopics; /**< @brief #SHADOW_SESSION_TOPICS_PER_SHADOW topics for each shadow. */
+    uint16_t * pBuckets;            /**< @brief One more than the index of the first topic of each bucket, or 0. */
+    size_t maxShadows;              /**< @brief Number of shadows the storage holds. */
+    size_t shadowCount;             /**< @brief Number of shadows of the session. */
+
+    /**
+     * @brief Handler of each message type, or NULL.
+     */
+    ShadowSessionHandler_t handlers[ ShadowMessageTypeMaxNum ];
+    void * pHandlerContext; /**< @brief Context of the handlers. */
+} ShadowSession_t;
+
+/**
+ * @brief Define a static session named @p name for up to @p shadowCapacity
+ * shadows.
+ *
+ * The response topics hash to as many buckets as there are topics.
+ *
+ * @param[in] name Name of the #ShadowSession_t.
+ * @param[in] shadowCapacity Number of shadows, from 1 to
+ * 65535 / #SHADOW_SESSION_TOPICS_PER_SHADOW.
+ */
+#define SHADOW_SESSION_DEFINE( name, shadowCapacity )                                                   \
+    static ShadowSessionTopic_t name ## Topics[ ( shadowCapacity ) * SHADOW_SESSION_TOPICS_PER_SHADOW ]; \
+    static uint16_t name ## Buckets[ ( shadowCapacity ) * SHADOW_SESSION_RESPONSE_TOPICS ];              \
+    static ShadowSession_t name =                                                                       \
+    {                                                                                                   \
+        .pTopics = name ## Topics,                                                                      \
+        .pBuckets = name ## Buckets,                                                                    \
+        .maxShadows = ( shadowCapacity )                                                                \
+    }
+
+/**
+ * @brief Assemble the topics of the shadows of a thing.
+ *
+ * The handlers registered with #ShadowSession_SetHandler are kept.
+ *
+ * @param[in] pSession The session.
+ * @param[in] pThingName Name of the thing.
+ * @param[in] thingNameLength Length of @p pThingName.
+ * @param[in] pShadowNames Names of the shadows. The names need not stay valid.
+ * @param[in] shadowCount Number of entries of @p pShadowNames.
+ * @param[in] pHandlerContext Context passed to the handlers.
+ *
+ * @return #SHADOW_SESSION_SUCCESS, #SHADOW_SESSION_INVALID_PARAMETER or
+ * #SHADOW_SESSION_TOPIC_TOO_LONG.
+ */
+ShadowSessionStatus_t ShadowSession_Init( ShadowSession_t * pSession,
+                                          const char * pThingName,
+                                          uint8_t thingNameLength,
+                                          const ShadowSessionName_t * pShadowNames,
+                                          size_t shadowCount,
+                                          void * pHandlerContext );
+
+/**
+ * @brief Register the handler of a message type, for all the shadows of the
+ * session. Only the topics of the message types with a handler are
+ * subscribed to by #ShadowSession_GetSubscriptions.
+ *
+ * @param[in] pSession The session.
+ * @param[in] messageType The message type.
+ * @param[in] handler The handler, or NULL to remove it.
+ *
+ * @return #SHADOW_SESSION_SUCCESS or #SHADOW_SESSION_INVALID_PARAMETER.
+ */
+ShadowSessionStatus_t ShadowSession_SetHandler( ShadowSession_t * pSession,
+                                                ShadowMessageType_t messageType,
+                                                ShadowSessionHandler_t handler );
+
+/**
+ * @brief Get a topic of a shadow of the session.
+ *
+ * @param[in] pSession The session.
+ * @param[in] shadowIndex Index of the shadow.
+ * @param[in] topicType Type of the topic.
+ * @param[out] ppTopic The topic, valid until the session is initialized again.
+ * @param[out] pTopicLength Length of the topic.
+ *
+ * @return #SHADOW_SESSION_SUCCESS or #SHADOW_SESSION_INVALID_PARAMETER.
+ */
+ShadowSessionStatus_t ShadowSession_GetTopic( const ShadowSession_t * pSession,
+                                              size_t shadowIndex,
+                                              ShadowTopicStringType_t topicType,
+                                              const char ** ppTopic,
+                                              uint16_t * pTopicLength );
+
+/**
+ * @brief Fill the subscriptions to the response topics of all the shadows of
+ * the session with a handler, to subscribe to them with one MQTT_Subscribe()
+ * or unsubscribe with one MQTT_Unsubscribe().
+ *
+ * @param[in] pSession The session.
+ * @param[in] qos QoS of the subscriptions.
+ * @param[out] pSubscriptions The subscriptions.
+ * @param[in] maxSubscriptions Number of entries of @p pSubscriptions.
+ *
+ * @return The number of subscriptions, which can exceed @p maxSubscriptions,
+ * in which case only the first @p maxSubscriptions are filled.
+ */
+size_t ShadowSession_GetSubscriptions( const ShadowSession_t * pSession,
+                                       MQTTQoS_t qos,
+                                       MQTTSubscribeInfo_t * pSubscriptions,
+                                       size_t maxSubscriptions );
+
+/**
+ * @brief Dispatch an incoming message to the handler of its message type.
+ *
+ * @param[in] pSession The session.
+ * @param[in] pPublishInfo The incoming message.
+ *
+ * @return true if the topic is a response topic of the session, even without
+ * a handler, otherwise false.
+ */
+bool ShadowSession_Dispatch( const ShadowSession_t * pSession,
+                             MQTTPublishInfo_t * pPublishInfo );
+
+#endif /* ifndef SHADOW_SESSION_H_ */
@@ -0,0 +1,340 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file shadow_state.h
+ * @brief Typed local copy of the reported state of a device shadow, which
+ * reports only the fields changed since the last update.
+ *
+ * The application sets the fields with the ShadowState_Set* functions, which
+ * mark a field dirty only when its value changes. #ShadowState_SerializeReported
+ * writes a "reported" update document holding only the dirty fields straight
+ * into the buffer that is then published; coreMQTT sends the payload from that
+ * buffer, so the document is not copied on its way to the network. Changes
+ * made between two updates are coalesced, and #ShadowState_UpdateDue limits
+ * the rate of the updates.
+ *
+ * @note A state is not thread safe; it is meant to be used from the thread
+ * running the MQTT connection.
+ */
+
+#ifndef SHADOW_STATE_H_
+#define SHADOW_STATE_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Logging related header files are required to be included in the following order:
+ * 1. Include the header file "logging_levels.h".
+ * 2. Define LIBRARY_LOG_NAME and  LIBRARY_LOG_LEVEL.
+ * 3. Include the header file "logging_stack.h".
+ */
+
+/* Include header that defines log levels. */
+#include "logging_levels.h"
+
+/* Logging configuration for the shadow state. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "ShadowState"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_ERROR
+#endif
+
+#include "logging_stack.h"
+
+/************ End of logging configuration ****************/
+
+/**
+ * @brief Maximum number of updates of a state waiting for their response.
+ * Serializing one more gives up the oldest, whose fields are reported again.
+ */
+#ifndef SHADOW_STATE_MAX_UPDATES
+    #define SHADOW_STATE_MAX_UPDATES    ( 2U )
+#endif
+
+/**
+ * @brief Maximum length of the client token of an update, which the Device
+ * Shadow service limits to 64 bytes.
+ */
+#ifndef SHADOW_STATE_MAX_CLIENT_TOKEN_LENGTH
+    #define SHADOW_STATE_MAX_CLIENT_TOKEN_LENGTH    ( 64U )
+#endif
+
+/**
+ * @brief Return codes of the shadow state functions.
+ */
+typedef enum ShadowStateStatus
+{
+    SHADOW_STATE_SUCCESS = 0,         /**< Function successfully completed. */
+    SHADOW_STATE_INVALID_PARAMETER,   /**< At least one parameter was invalid. */
+    SHADOW_STATE_BUFFER_TOO_SMALL,    /**< The document or the string does not fit in its buffer. */
+    SHADOW_STATE_NOTHING_TO_REPORT    /**< No field changed since the last update. */
+} ShadowStateStatus_t;
+
+/**
+ * @brief Types of the fields of a shadow state.
+ */
+typedef enum ShadowFieldType
+{
+    SHADOW_FIELD_TYPE_BOOL = 0, /**< A JSON true or false. */
+    SHADOW_FIELD_TYPE_INT,      /**< A signed 32-bit JSON number. */
+    SHADOW_FIELD_TYPE_UINT,     /**< An unsigned 32-bit JSON number. */
+    SHADOW_FIELD_TYPE_STRING    /**< A JSON string, kept in a buffer of the application. */
+} ShadowFieldType_t;
+
+/**
+ * @brief A field of the reported state.
+ *
+ * Initialize the fields with #SHADOW_FIELD or #SHADOW_FIELD_STRING; the
+ * other members are managed by the ShadowState functions.
+ */
+typedef struct ShadowField
+{
+    const char * pKey;      /**< @brief Key of the field in the "reported" object. */
+    uint16_t keyLength;     /**< @brief Length of #ShadowField_t.pKey. */
+    ShadowFieldType_t type; /**< @brief Type of the field. */
+
+    /**
+     * @brief Value of the field, for the types other than
+     * #SHADOW_FIELD_TYPE_STRING.
+     */
+    union
+    {
+        bool boolValue;
+        int32_t intValue;
+        uint32_t uintValue;
+    } value;
+
+    char * pString;        /**< @brief Buffer of a #SHADOW_FIELD_TYPE_STRING field. */
+    size_t stringCapacity; /**< @brief Size of #ShadowField_t.pString. */
+    size_t stringLength;   /**< @brief Length of the value in #ShadowField_t.pString. */
+
+    bool dirty;            /**< @brief The field changed since it was last reported. */
+    bool inFlight;         /**< @brief The field is part of an update waiting for its response. */
+    uint32_t updateId;     /**< @brief Id of the last update holding the field, while it is in flight. */
+} ShadowField_t;
+
+/**
+ * @brief Initializer of a field of any type but #SHADOW_FIELD_TYPE_STRING.
+ *
+ * @param[in] key String literal key of the field.
+ * @param[in] fieldType Type of the field.
+ */
+#define SHADOW_FIELD( key, fieldType ) \
+    { ( key ), ( uint16_t ) ( sizeof( key ) - 1U ), ( fieldType ), { 0 }, NULL, 0U, 0U, false, false, 0U }
+
+/**
+ * @brief Initializer of a #SHADOW_FIELD_TYPE_STRING field.
+ *
+ * @param[in] key String literal key of the field.
+ * @param[in] buffer Array holding the value of the field.
+ */
+#define SHADOW_FIELD_STRING( key, buffer ) \
+    { ( key ), ( uint16_t ) ( sizeof( key ) - 1U ), SHADOW_FIELD_TYPE_STRING, { 0 }, ( buffer ), sizeof( buffer ), 0U, false, false, 0U }
+
+/**
+ * @brief An update of a state waiting for its response.
+ */
+typedef struct ShadowUpdate
+{
+    char clientToken[ SHADOW_STATE_MAX_CLIENT_TOKEN_LENGTH ]; /**< @brief Client token of the update. */
+    size_t clientTokenLength;                                 /**< @brief Length of #ShadowUpdate_t.clientToken. */
+    uint32_t id;                                              /**< @brief Id of the update, 0 for a free entry. */
+} ShadowUpdate_t;
+
+/**
+ * @brief Reported state of a device shadow.
+ */
+typedef struct ShadowState
+{
+    ShadowField_t * pFields;                            /**< @brief The fields of the state. */
+    size_t fieldCount;                                  /**< @brief Number of fields. */
+    uint32_t minIntervalMs;                             /**< @brief Shortest time between two updates. */
+    uint32_t lastUpdateMs;                              /**< @brief Time of the last update. */
+    bool updateSent;                                    /**< @brief Whether an update was serialized since the state was initialized. */
+    ShadowUpdate_t updates[ SHADOW_STATE_MAX_UPDATES ]; /**< @brief Updates waiting for their response. */
+    uint32_t lastUpdateId;                              /**< @brief Id of the last update serialized. */
+} ShadowState_t;
+
+/**
+ * @brief Initialize a shadow state. Every field is dirty, so that the first
+ * update reports the whole state.
+ *
+ * @param[out] pState The state.
+ * @param[in] pFields The fields of the state.
+ * @param[in] fieldCount Number of entries of @p pFields.
+ * @param[in] minIntervalMs Shortest time between two updates, in milliseconds.
+ *
+ * @return #SHADOW_STATE_SUCCESS or #SHADOW_STATE_INVALID_PARAMETER.
+ */
+ShadowStateStatus_t ShadowState_Init( ShadowState_t * pState,
+                                      ShadowField_t * pFields,
+                                      size_t fieldCount,
+                                      uint32_t minIntervalMs );
+
+/**
+ * @brief Set a #SHADOW_FIELD_TYPE_BOOL field.
+ *
+ * @param[in] pState The state.
+ * @param[in] fieldIndex Index of the field in the fields of the state.
+ * @param[in] value The value.
+ *
+ * @return #SHADOW_STATE_SUCCESS or #SHADOW_STATE_INVALID_PARAMETER.
+ */
+ShadowStateStatus_t ShadowState_SetBool( ShadowState_t * pState,
+                                         size_t fieldIndex,
+                                         bool value );
+
+/**
+ * @brief Set a #SHADOW_FIELD_TYPE_INT field.
+ *
+ * @param[in] pState The state.
+ * @param[in] fieldIndex Index of the field in the fields of the state.
+ * @param[in] value The value.
+ *
+ * @return #SHADOW_STATE_SUCCESS or #SHADOW_STATE_INVALID_PARAMETER.
+ */
+ShadowStateStatus_t ShadowState_SetInt( ShadowState_t * pState,
+                                        size_t fieldIndex,
+                                        int32_t value );
+
+/**
+ * @brief Set a #SHADOW_FIELD_TYPE_UINT field.
+ *
+ * @param[in] pState The state.
+ * @param[in] fieldIndex Index of the field in the fields of the state.
+ * @param[in] value The value.
+ *
+ * @return #SHADOW_STATE_SUCCESS or #SHADOW_STATE_INVALID_PARAMETER.
+ */
+ShadowStateStatus_t ShadowState_SetUint( ShadowState_t * pState,
+                                         size_t fieldIndex,
+                                         uint32_t value );
+
+/**
+ * @brief Set a #SHADOW_FIELD_TYPE_STRING field. The value is copied to the
+ * buffer of the field.
+ *
+ * @param[in] pState The state.
+ * @param[in] fieldIndex Index of the field in the fields of the state.
+ * @param[in] pValue The value, which need not be NUL terminated.
+ * @param[in] valueLength Length of @p pValue.
+ *
+ * @return #SHADOW_STATE_SUCCESS, #SHADOW_STATE_INVALID_PARAMETER, or
+ * #SHADOW_STATE_BUFFER_TOO_SMALL if the value does not fit in the buffer of
+ * the field, which is then left unchanged.
+ */
+ShadowStateStatus_t ShadowState_SetString( ShadowState_t * pState,
+                                           size_t fieldIndex,
+                                           const char * pValue,
+                                           size_t valueLength );
+
+/**
+ * @brief Check whether an update should be sent: a field changed, and at
+ * least the minimum interval passed since the last update.
+ *
+ * @param[in] pState The state.
+ * @param[in] nowMs The current time, in milliseconds.
+ *
+ * @return true if an update is due, otherwise false.
+ */
+bool ShadowState_UpdateDue( const ShadowState_t * pState,
+                            uint32_t nowMs );
+
+/**
+ * @brief Write an update document reporting the dirty fields, such as
+ * {"state":{"reported":{"powerOn":1}},"clientToken":"021909"}.
+ *
+ * On success the dirty fields become in flight until #ShadowState_Complete is
+ * called with the response to the update, which is told from the responses to
+ * other updates by its client token.
+ *
+ * @param[in] pState The state.
+ * @param[in] nowMs The current time, in milliseconds.
+ * @param[in] pClientToken Client token of the update, or NULL for none.
+ * @param[in] clientTokenLength Length of @p pClientToken, at most
+ * #SHADOW_STATE_MAX_CLIENT_TOKEN_LENGTH.
+ * @param[out] pBuffer Buffer for the document, which is not NUL terminated.
+ * @param[in] bufferSize Size of @p pBuffer.
+ * @param[out] pDocumentLength Length of the document.
+ *
+ * @return #SHADOW_STATE_SUCCESS, #SHADOW_STATE_INVALID_PARAMETER,
+ * #SHADOW_STATE_NOTHING_TO_REPORT, or #SHADOW_STATE_BUFFER_TOO_SMALL, in which
+ * case the fields stay dirty.
+ */
+ShadowStateStatus_t ShadowState_SerializeReported( ShadowState_t * pState,
+                                                   uint32_t nowMs,
+                                                   const char * pClientToken,
+                                                   size_t clientTokenLength,
+                                                   char * pBuffer,
+                                                   size_t bufferSize,
+                                                   size_t * pDocumentLength );
+
+/**
+ * @brief Write the update document of #ShadowState_SerializeReported in CBOR
+ * (see shadow_cbor.h), with the same maps, keys and values.
+ *
+ * Shadow topics only accept JSON, so the document is meant for the topic of
+ * an AWS IoT rule that converts it for the Device Shadow service.
+ *
+ * @param[in] pState The state.
+ * @param[in] nowMs The current time, in milliseconds.
+ * @param[in] pClientToken Client token of the update, or NULL for none.
+ * @param[in] clientTokenLength Length of @p pClientToken, at most
+ * #SHADOW_STATE_MAX_CLIENT_TOKEN_LENGTH.
+ * @param[out] pBuffer Buffer for the document.
+ * @param[in] bufferSize Size of @p pBuffer.
+ * @param[out] pDocumentLength Length of the document.
+ *
+ * @return The codes of #ShadowState_SerializeReported.
+ */
+ShadowStateStatus_t ShadowState_SerializeReportedCbor( ShadowState_t * pState,
+                                                       uint32_t nowMs,
+                                                       const char * pClientToken,
+                                                       size_t clientTokenLength,
+                                                       uint8_t * pBuffer,
+                                                       size_t bufferSize,
+                                                       size_t * pDocumentLength );
+
+/**
+ * @brief Complete an update in flight, on its response or when it cannot be
+ * sent.
+ *
+ * Only the fields whose last update is this one are completed, so that the
+ * response to an earlier update leaves the fields of a later one in flight.
+ * A response to no update in flight, such as one given up, is ignored.
+ *
+ * @param[in] pState The state.
+ * @param[in] pClientToken Client token of the update, or NULL for none.
+ * @param[in] clientTokenLength Length of @p pClientToken.
+ * @param[in] accepted Whether the update was accepted. Otherwise its fields
+ * are dirty again, to be reported by the next update.
+ */
+void ShadowState_Complete( ShadowState_t * pState,
+                           const char * pClientToken,
+                           size_t clientTokenLength,
+                           bool accepted );
+
+#endif /* ifndef SHADOW_STATE_H_ */
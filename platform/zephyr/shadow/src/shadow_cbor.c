@@ -0,0 +1,710 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file shadow_cbor.c
+ * @brief Allocation-free encoder and single-pass decoder of a CBOR subset.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+#include "shadow_cbor.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Major types of CBOR items, in the top 3 bits of their first byte.
+ */
+#define CBOR_MAJOR_UINT                 ( 0U )
+#define CBOR_MAJOR_NEGATIVE             ( 1U )
+#define CBOR_MAJOR_BYTES                ( 2U )
+#define CBOR_MAJOR_TEXT                 ( 3U )
+#define CBOR_MAJOR_ARRAY                ( 4U )
+#define CBOR_MAJOR_MAP                  ( 5U )
+#define CBOR_MAJOR_TAG                  ( 6U )
+#define CBOR_MAJOR_SIMPLE               ( 7U )
+
+/**
+ * @brief Additional information values of the low 5 bits of the first byte.
+ */
+#define CBOR_INFO_ONE_BYTE              ( 24U )
+#define CBOR_INFO_EIGHT_BYTES           ( 27U )
+#define CBOR_INFO_INDEFINITE            ( 31U )
+
+/**
+ * @brief Simple values of major type 7.
+ */
+#define CBOR_SIMPLE_FALSE               ( 20U )
+#define CBOR_SIMPLE_TRUE                ( 21U )
+#define CBOR_SIMPLE_NULL                ( 22U )
+
+/**
+ * @brief Largest head: the first byte and an 8-byte argument.
+ */
+#define CBOR_HEAD_MAX_LENGTH            ( 9U )
+
+/**
+ * @brief A map or an array being decoded.
+ */
+typedef struct CborContainer
+{
+    uint64_t remaining; /**< @brief Items left, counting keys and values separately for a map. */
+    size_t start;       /**< @brief Offset of the head of the container. */
+    size_t owner;       /**< @brief Index of the key whose value is the container, or keyCount for none. */
+    bool isMap;         /**< @brief The container is a map. */
+} CborContainer_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Write the head of an item with the shortest encoding of its argument.
+ *
+ * Nothing is written unless the head and the content that follows it fit in
+ * the buffer, so that an overflow never leaves part of an item behind.
+ *
+ * @param[in] pWriter The writer.
+ * @param[in] major Major type of the item.
+ * @param[in] argument Value, length or count of the item.
+ * @param[in] contentLength Number of bytes of the item after its head, written
+ * by the caller once the head is written.
+ */
+static void encodeHead( ShadowCborWriter_t * pWriter,
+                        uint8_t major,
+                        uint64_t argument,
+                        size_t contentLength );
+
+/**
+ * @brief Write bytes.
+ *
+ * @param[in] pWriter The writer.
+ * @param[in] pBytes The bytes.
+ * @param[in] length Number of bytes.
+ */
+static void writeBytes( ShadowCborWriter_t * pWriter,
+                        const uint8_t * pBytes,
+                        size_t length );
+
+/**
+ * @brief Read the head of an item.
+ *
+ * @param[in] pBuffer The document.
+ * @param[in] length Length of the document.
+ * @param[in,out] pOffset Offset of the head, then of the content of the item.
+ * @param[out] pMajor Major type of the item.
+ * @param[out] pInfo Additional information of the item.
+ * @param[out] pArgument Argument of the item.
+ *
+ * @return #SHADOW_CBOR_SUCCESS, #SHADOW_CBOR_PARTIAL, or
+ * #SHADOW_CBOR_ILLEGAL_DOCUMENT for reserved or indefinite-length heads.
+ */
+static ShadowCborStatus_t decodeHead( const uint8_t * pBuffer,
+                                      size_t length,
+                                      size_t * pOffset,
+                                      uint8_t * pMajor,
+                                      uint8_t * pInfo,
+                                      uint64_t * pArgument );
+
+/**
+ * @brief Match a map key against the next segment of a key path.
+ *
+ * @param[in] pKey The key path.
+ * @param[in] segmentIndex Index of the segment to match.
+ * @param[in] pText The map key.
+ * @param[in] textLength Length of @p pText.
+ * @param[out] pIsLast Whether the segment is the last of the path.
+ *
+ * @return true if the map key equals the segment.
+ */
+static bool matchSegment( const ShadowCborKey_t * pKey,
+                          uint16_t segmentIndex,
+                          const uint8_t * pText,
+                          size_t textLength,
+                          bool * pIsLast );
+
+/**
+ * @brief Check the content of an item against the rest of the document.
+ *
+ * @param[in] major Major type of the item.
+ * @param[in] info Additional information of the item.
+ * @param[in] argument Argument of the item.
+ * @param[in] remainingLength Length of the document after the head of the item.
+ * @param[in] depth Number of containers around the item.
+ * @param[out] pComplete Whether the item ends with its head and content, i.e.
+ * is not a map or an array with items.
+ *
+ * @return #SHADOW_CBOR_SUCCESS, #SHADOW_CBOR_PARTIAL,
+ * #SHADOW_CBOR_MAX_DEPTH_EXCEEDED or #SHADOW_CBOR_ILLEGAL_DOCUMENT.
+ */
+static ShadowCborStatus_t checkItem( uint8_t major,
+                                     uint8_t info,
+                                     uint64_t argument,
+                                     size_t remainingLength,
+                                     size_t depth,
+                                     bool * pComplete );
+
+/**
+ * @brief Set the value of a key from the item that follows it.
+ *
+ * @param[in] pKey The key.
+ * @param[in] pBuffer The document.
+ * @param[in] itemStart Offset of the head of the item.
+ * @param[in] contentStart Offset of the content of the item, after its head.
+ * @param[in] major Major type of the item.
+ * @param[in] info Additional information of the item.
+ * @param[in] argument Argument of the item.
+ */
+static void setValue( ShadowCborKey_t * pKey,
+                      const uint8_t * pBuffer,
+                      size_t itemStart,
+                      size_t contentStart,
+                      uint8_t major,
+                      uint8_t info,
+                      uint64_t argument );
+
+/*-----------------------------------------------------------*/
+
+static void writeBytes( ShadowCborWriter_t * pWriter,
+                        const uint8_t * pBytes,
+                        size_t length )
+{
+    if( pWriter->overflow == false )
+    {
+        if( length > ( pWriter->size - pWriter->length ) )
+        {
+            pWriter->overflow = true;
+        }
+        else
+        {
+            ( void ) memcpy( &( pWriter->pBuffer[ pWriter->length ] ), pBytes, length );
+            pWriter->length += length;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void encodeHead( ShadowCborWriter_t * pWriter,
+                        uint8_t major,
+                        uint64_t argument,
+                        size_t contentLength )
+{
+    uint8_t head[ CBOR_HEAD_MAX_LENGTH ];
+    size_t argumentLength = 0U, headLength = 0U, roomLength = 0U, i = 0U;
+    uint8_t info = 0U;
+
+    if( argument < CBOR_INFO_ONE_BYTE )
+    {
+        head[ 0 ] = ( uint8_t ) ( ( major << 5 ) | ( uint8_t ) argument );
+    }
+    else
+    {
+        /* Arguments of 1, 2, 4 and 8 bytes have the additional information
+         * 24 to 27. */
+        if( argument <= UINT8_MAX )
+        {
+            argumentLength = 1U;
+            info = CBOR_INFO_ONE_BYTE;
+        }
+        else if( argument <= UINT16_MAX )
+        {
+            argumentLength = 2U;
+            info = CBOR_INFO_ONE_BYTE + 1U;
+        }
+        else if( argument <= UINT32_MAX )
+        {
+            argumentLength = 4U;
+            info = CBOR_INFO_ONE_BYTE + 2U;
+        }
+        else
+        {
+            argumentLength = 8U;
+            info = CBOR_INFO_EIGHT_BYTES;
+        }
+
+        head[ 0 ] = ( uint8_t ) ( ( major << 5 ) | info );
+
+        /* The argument is big endian. */
+        for( i = argumentLength; i > 0U; i-- )
+        {
+            head[ i ] = ( uint8_t ) argument;
+            argument >>= 8;
+        }
+    }
+
+    headLength = argumentLength + 1U;
+    roomLength = pWriter->size - pWriter->length;
+
+    /* Check the whole item before writing any of it. */
+    if( ( headLength > roomLength ) || ( contentLength > ( roomLength - headLength ) ) )
+    {
+        pWriter->overflow = true;
+    }
+    else
+    {
+        writeBytes( pWriter, head, headLength );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void ShadowCbor_WriterInit( ShadowCborWriter_t * pWriter,
+                            uint8_t * pBuffer,
+                            size_t size )
+{
+    pWriter->pBuffer = pBuffer;
+    pWriter->size = ( pBuffer != NULL ) ? size : 0U;
+    pWriter->length = 0U;
+    pWriter->overflow = false;
+}
+/*-----------------------------------------------------------*/
+
+void ShadowCbor_EncodeMap( ShadowCborWriter_t * pWriter,
+                           size_t pairCount )
+{
+    encodeHead( pWriter, CBOR_MAJOR_MAP, ( uint64_t ) pairCount, 0U );
+}
+/*-----------------------------------------------------------*/
+
+void ShadowCbor_EncodeUint( ShadowCborWriter_t * pWriter,
+                            uint32_t value )
+{
+    encodeHead( pWriter, CBOR_MAJOR_UINT, ( uint64_t ) value, 0U );
+}
+/*-----------------------------------------------------------*/
+
+void ShadowCbor_EncodeInt( ShadowCborWriter_t * pWriter,
+                           int32_t value )
+{
+    if( value < 0 )
+    {
+        /* A negative integer n is encoded as -1 - n, which also holds
+         * INT32_MIN in unsigned arithmetic. */
+        encodeHead( pWriter, CBOR_MAJOR_NEGATIVE, ( uint64_t ) ( ( 0U - ( uint32_t ) value ) - 1U ), 0U );
+    }
+    else
+    {
+        encodeHead( pWriter, CBOR_MAJOR_UINT, ( uint64_t ) value, 0U );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void ShadowCbor_EncodeBool( ShadowCborWriter_t * pWriter,
+                            bool value )
+{
+    encodeHead( pWriter, CBOR_MAJOR_SIMPLE, ( value == true ) ? CBOR_SIMPLE_TRUE : CBOR_SIMPLE_FALSE, 0U );
+}
+/*-----------------------------------------------------------*/
+
+void ShadowCbor_EncodeText( ShadowCborWriter_t * pWriter,
+                            const char * pText,
+                            size_t length )
+{
+    encodeHead( pWriter, CBOR_MAJOR_TEXT, ( uint64_t ) length, length );
+    writeBytes( pWriter, ( const uint8_t * ) pText, length );
+}
+/*-----------------------------------------------------------*/
+
+static ShadowCborStatus_t decodeHead( const uint8_t * pBuffer,
+                                      size_t length,
+                                      size_t * pOffset,
+                                      uint8_t * pMajor,
+                                      uint8_t * pInfo,
+                                      uint64_t * pArgument )
+{
+    ShadowCborStatus_t status = SHADOW_CBOR_SUCCESS;
+    size_t offset = *pOffset, argumentLength = 0U, i = 0U;
+    uint64_t argument = 0U;
+    uint8_t info = 0U;
+
+    if( offset >= length )
+    {
+        status = SHADOW_CBOR_PARTIAL;
+    }
+    else
+    {
+        *pMajor = ( uint8_t ) ( pBuffer[ offset ] >> 5 );
+        info = ( uint8_t ) ( pBuffer[ offset ] & 0x1FU );
+        offset++;
+
+        if( info < CBOR_INFO_ONE_BYTE )
+        {
+            argument = info;
+        }
+        else if( info <= CBOR_INFO_EIGHT_BYTES )
+        {
+            argumentLength = ( size_t ) 1U << ( info - CBOR_INFO_ONE_BYTE );
+
+            if( argumentLength > ( length - offset ) )
+            {
+                status = SHADOW_CBOR_PARTIAL;
+            }
+            else
+            {
+                for( i = 0U; i < argumentLength; i++ )
+                {
+                    argument = ( argument << 8 ) | pBuffer[ offset + i ];
+                }
+
+                offset += argumentLength;
+            }
+        }
+        else
+        {
+            /* 28 to 30 are reserved, and indefinite lengths are not
+             * supported. */
+            status = SHADOW_CBOR_ILLEGAL_DOCUMENT;
+        }
+    }
+
+    if( status == SHADOW_CBOR_SUCCESS )
+    {
+        *pInfo = info;
+        *pArgument = argument;
+        *pOffset = offset;
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+static bool matchSegment( const ShadowCborKey_t * pKey,
+                          uint16_t segmentIndex,
+                          const uint8_t * pText,
+                          size_t textLength,
+                          bool * pIsLast )
+{
+    size_t start = 0U, end = 0U;
+    uint16_t segment = 0U;
+    bool match = false;
+
+    /* Skip the segments matched by the outer maps. */
+    while( ( segment < segmentIndex ) && ( start < pKey->keyLength ) )
+    {
+        if( pKey->pKey[ start ] == '.' )
+        {
+            segment++;
+        }
+
+        start++;
+    }
+
+    if( segment == segmentIndex )
+    {
+        end = start;
+
+        while( ( end < pKey->keyLength ) && ( pKey->pKey[ end ] != '.' ) )
+        {
+            end++;
+        }
+
+        match = ( ( end - start ) == textLength ) &&
+                ( memcmp( &( pKey->pKey[ start ] ), pText, textLength ) == 0 );
+        *pIsLast = ( end == pKey->keyLength );
+    }
+
+    return match;
+}
+/*-----------------------------------------------------------*/
+
+static ShadowCborStatus_t checkItem( uint8_t major,
+                                     uint8_t info,
+                                     uint64_t argument,
+                                     size_t remainingLength,
+                                     size_t depth,
+                                     bool * pComplete )
+{
+    ShadowCborStatus_t status = SHADOW_CBOR_SUCCESS;
+
+    *pComplete = true;
+
+    switch( major )
+    {
+        case CBOR_MAJOR_BYTES:
+        case CBOR_MAJOR_TEXT:
+
+            if( argument > remainingLength )
+            {
+                status = SHADOW_CBOR_PARTIAL;
+            }
+
+            break;
+
+        case CBOR_MAJOR_ARRAY:
+        case CBOR_MAJOR_MAP:
+
+            /* Every item takes at least a byte, which also keeps the doubled
+             * count of a map from overflowing. */
+            if( argument > remainingLength )
+            {
+                status = SHADOW_CBOR_PARTIAL;
+            }
+            else if( ( argument > 0U ) && ( depth == SHADOW_CBOR_MAX_DEPTH ) )
+            {
+                status = SHADOW_CBOR_MAX_DEPTH_EXCEEDED;
+            }
+            else
+            {
+                *pComplete = ( argument == 0U );
+            }
+
+            break;
+
+        case CBOR_MAJOR_SIMPLE:
+
+            /* Simple values 0 to 31 must use the short encoding. */
+            if( ( info == CBOR_INFO_ONE_BYTE ) && ( argument < 32U ) )
+            {
+                status = SHADOW_CBOR_ILLEGAL_DOCUMENT;
+            }
+
+            break;
+
+        default:
+            /* Integers are complete with their head. */
+            break;
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+static void setValue( ShadowCborKey_t * pKey,
+                      const uint8_t * pBuffer,
+                      size_t itemStart,
+                      size_t contentStart,
+                      uint8_t major,
+                      uint8_t info,
+                      uint64_t argument )
+{
+    pKey->pending = false;
+    pKey->found = true;
+    pKey->argument = argument;
+
+    /* The encoding of the item; the length of a map or an array is only
+     * known once its last item is decoded. */
+    pKey->pData = &( pBuffer[ itemStart ] );
+    pKey->dataLength = contentStart - itemStart;
+
+    switch( major )
+    {
+        case CBOR_MAJOR_UINT:
+            pKey->type = SHADOW_CBOR_TYPE_UINT;
+            break;
+
+        case CBOR_MAJOR_NEGATIVE:
+            pKey->type = SHADOW_CBOR_TYPE_NEGATIVE;
+            break;
+
+        case CBOR_MAJOR_BYTES:
+        case CBOR_MAJOR_TEXT:
+            pKey->type = ( major == CBOR_MAJOR_TEXT ) ? SHADOW_CBOR_TYPE_TEXT : SHADOW_CBOR_TYPE_BYTES;
+            pKey->pData = &( pBuffer[ contentStart ] );
+            pKey->dataLength = ( size_t ) argument;
+            break;
+
+        case CBOR_MAJOR_ARRAY:
+            pKey->type = SHADOW_CBOR_TYPE_ARRAY;
+            break;
+
+        case CBOR_MAJOR_MAP:
+            pKey->type = SHADOW_CBOR_TYPE_MAP;
+            break;
+
+        default:
+
+            if( ( argument == CBOR_SIMPLE_FALSE ) || ( argument == CBOR_SIMPLE_TRUE ) )
+            {
+                pKey->type = SHADOW_CBOR_TYPE_BOOL;
+                pKey->argument = ( argument == CBOR_SIMPLE_TRUE ) ? 1U : 0U;
+            }
+            else if( argument == CBOR_SIMPLE_NULL )
+            {
+                pKey->type = SHADOW_CBOR_TYPE_NULL;
+            }
+            else if( info > CBOR_INFO_ONE_BYTE )
+            {
+                pKey->type = SHADOW_CBOR_TYPE_FLOAT;
+            }
+            else
+            {
+                pKey->type = SHADOW_CBOR_TYPE_SIMPLE;
+            }
+
+            break;
+    }
+}
+/*-----------------------------------------------------------*/
+
+ShadowCborStatus_t ShadowCbor_FindKeys( const uint8_t * pBuffer,
+                                        size_t length,
+                                        ShadowCborKey_t * pKeys,
+                                        size_t keyCount )
+{
+    ShadowCborStatus_t status = SHADOW_CBOR_SUCCESS;
+    CborContainer_t stack[ SHADOW_CBOR_MAX_DEPTH ];
+    size_t depth = 0U, arrayDepth = 0U, offset = 0U, itemStart = 0U, k = 0U, owner = 0U;
+    uint8_t major = 0U, info = 0U;
+    uint64_t argument = 0U;
+    bool isKey = false, isLast = false, complete = false, done = false;
+    ShadowCborKey_t * pKey = NULL;
+
+    if( ( pBuffer == NULL ) || ( ( pKeys == NULL ) && ( keyCount > 0U ) ) )
+    {
+        status = SHADOW_CBOR_INVALID_PARAMETER;
+    }
+
+    for( k = 0U; ( k < keyCount ) && ( status == SHADOW_CBOR_SUCCESS ); k++ )
+    {
+        if( ( pKeys[ k ].pKey == NULL ) || ( pKeys[ k ].keyLength == 0U ) )
+        {
+            status = SHADOW_CBOR_INVALID_PARAMETER;
+        }
+        else
+        {
+            pKeys[ k ].found = false;
+            pKeys[ k ].pData = NULL;
+            pKeys[ k ].dataLength = 0U;
+            pKeys[ k ].matchedDepth = 0U;
+            pKeys[ k ].pending = false;
+        }
+    }
+
+    while( ( status == SHADOW_CBOR_SUCCESS ) && ( done == false ) )
+    {
+        itemStart = offset;
+        status = decodeHead( pBuffer, length, &offset, &major, &info, &argument );
+
+        /* A tag only qualifies the item that follows it. */
+        if( ( status == SHADOW_CBOR_SUCCESS ) && ( major != CBOR_MAJOR_TAG ) )
+        {
+            status = checkItem( major, info, argument, length - offset, depth, &complete );
+
+            /* The items of a map alternate between keys and values. */
+            isKey = ( depth > 0U ) && ( stack[ depth - 1U ].isMap == true ) &&
+                    ( ( stack[ depth - 1U ].remaining % 2U ) == 0U );
+        }
+
+        if( ( status == SHADOW_CBOR_SUCCESS ) && ( major != CBOR_MAJOR_TAG ) )
+        {
+            owner = keyCount;
+
+            for( k = 0U; k < keyCount; k++ )
+            {
+                pKey = &( pKeys[ k ] );
+
+                if( isKey == true )
+                {
+                    /* A new key of the map ends the match of its previous key. */
+                    if( pKey->matchedDepth >= depth )
+                    {
+                        pKey->matchedDepth = ( uint16_t ) ( depth - 1U );
+                    }
+
+                    /* Keys inside arrays cannot be selected. */
+                    if( ( pKey->found == false ) && ( major == CBOR_MAJOR_TEXT ) && ( arrayDepth == 0U ) &&
+                        ( pKey->matchedDepth == ( depth - 1U ) ) &&
+                        ( matchSegment( pKey, pKey->matchedDepth, &( pBuffer[ offset ] ),
+                                        ( size_t ) argument, &isLast ) == true ) )
+                    {
+                        pKey->matchedDepth = ( uint16_t ) depth;
+                        pKey->pending = isLast;
+                    }
+                }
+                else if( pKey->pending == true )
+                {
+                    setValue( pKey, pBuffer, itemStart, offset, major, info, argument );
+
+                    if( complete == false )
+                    {
+                        owner = k;
+                    }
+                }
+                else
+                {
+                    /* Not a key, nor a value being looked for. */
+                }
+            }
+
+            if( ( major == CBOR_MAJOR_BYTES ) || ( major == CBOR_MAJOR_TEXT ) )
+            {
+                offset += ( size_t ) argument;
+            }
+
+            if( complete == false )
+            {
+                stack[ depth ].remaining = ( major == CBOR_MAJOR_MAP ) ? ( argument * 2U ) : argument;
+                stack[ depth ].start = itemStart;
+                stack[ depth ].owner = owner;
+                stack[ depth ].isMap = ( major == CBOR_MAJOR_MAP );
+                depth++;
+
+                if( major == CBOR_MAJOR_ARRAY )
+                {
+                    arrayDepth++;
+                }
+            }
+
+            /* A complete item may complete the containers around it. */
+            while( ( complete == true ) && ( depth > 0U ) )
+            {
+                stack[ depth - 1U ].remaining--;
+
+                if( stack[ depth - 1U ].remaining == 0U )
+                {
+                    depth--;
+
+                    if( stack[ depth ].owner < keyCount )
+                    {
+                        pKeys[ stack[ depth ].owner ].dataLength = offset - stack[ depth ].start;
+                    }
+
+                    if( stack[ depth ].isMap == false )
+                    {
+                        arrayDepth--;
+                    }
+                }
+                else
+                {
+                    complete = false;
+                }
+            }
+
+            /* The document ends with its first item. */
+            done = ( complete == true );
+        }
+    }
+
+    if( ( status == SHADOW_CBOR_SUCCESS ) && ( offset != length ) )
+    {
+        status = SHADOW_CBOR_ILLEGAL_DOCUMENT;
+    }
+
+    for( k = 0U; ( k < keyCount ) && ( status == SHADOW_CBOR_SUCCESS ); k++ )
+    {
+        if( pKeys[ k ].found == false )
+        {
+            status = SHADOW_CBOR_NOT_FOUND;
+        }
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
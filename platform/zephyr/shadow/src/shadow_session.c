@@ -0,0 +1,367 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file shadow_session.c
+ * @brief Prebuilt device shadow topics and hashed dispatch of their incoming
+ * messages.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+#include "shadow_session.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Slot of the get topic of a shadow, after its response topics.
+ */
+#define SLOT_GET       ( SHADOW_SESSION_RESPONSE_TOPICS )
+
+/**
+ * @brief Slot of the delete topic of a shadow.
+ */
+#define SLOT_DELETE    ( SHADOW_SESSION_RESPONSE_TOPICS + 1U )
+
+/**
+ * @brief Slot of the update topic of a shadow.
+ */
+#define SLOT_UPDATE    ( SHADOW_SESSION_RESPONSE_TOPICS + 2U )
+
+/**
+ * @brief Topic type of each slot of the topics of a shadow. The slot of a
+ * response topic is its message type.
+ */
+static const ShadowTopicStringType_t slotTopicTypes[ SHADOW_SESSION_TOPICS_PER_SHADOW ] =
+{
+    [ ShadowMessageTypeGetAccepted ] = ShadowTopicStringTypeGetAccepted,
+    [ ShadowMessageTypeGetRejected ] = ShadowTopicStringTypeGetRejected,
+    [ ShadowMessageTypeDeleteAccepted ] = ShadowTopicStringTypeDeleteAccepted,
+    [ ShadowMessageTypeDeleteRejected ] = ShadowTopicStringTypeDeleteRejected,
+    [ ShadowMessageTypeUpdateAccepted ] = ShadowTopicStringTypeUpdateAccepted,
+    [ ShadowMessageTypeUpdateRejected ] = ShadowTopicStringTypeUpdateRejected,
+    [ ShadowMessageTypeUpdateDocuments ] = ShadowTopicStringTypeUpdateDocuments,
+    [ ShadowMessageTypeUpdateDelta ] = ShadowTopicStringTypeUpdateDelta,
+    [ SLOT_GET ] = ShadowTopicStringTypeGet,
+    [ SLOT_DELETE ] = ShadowTopicStringTypeDelete,
+    [ SLOT_UPDATE ] = ShadowTopicStringTypeUpdate
+};
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Hash a topic with 32-bit FNV-1a.
+ *
+ * @param[in] pTopic The topic.
+ * @param[in] topicLength Length of the topic.
+ *
+ * @return The hash.
+ */
+static uint32_t hashTopic( const char * pTopic,
+                           uint16_t topicLength );
+
+/**
+ * @brief Get the hash bucket of a topic.
+ *
+ * @param[in] pSession The session.
+ * @param[in] pTopic The topic.
+ * @param[in] topicLength Length of the topic.
+ *
+ * @return Index of the bucket in ShadowSession_t.pBuckets.
+ */
+static size_t bucketOf( const ShadowSession_t * pSession,
+                        const char * pTopic,
+                        uint16_t topicLength );
+
+/**
+ * @brief Get the slot of a topic type in the topics of a shadow.
+ *
+ * @param[in] topicType The topic type.
+ *
+ * @return The slot, or #SHADOW_SESSION_TOPICS_PER_SHADOW for an invalid type.
+ */
+static size_t slotOf( ShadowTopicStringType_t topicType );
+
+/*-----------------------------------------------------------*/
+
+static uint32_t hashTopic( const char * pTopic,
+                           uint16_t topicLength )
+{
+    uint32_t hash = 2166136261U;
+    uint16_t i = 0U;
+
+    for( i = 0U; i < topicLength; i++ )
+    {
+        hash ^= ( uint8_t ) pTopic[ i ];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+/*-----------------------------------------------------------*/
+
+static size_t bucketOf( const ShadowSession_t * pSession,
+                        const char * pTopic,
+                        uint16_t topicLength )
+{
+    return ( size_t ) hashTopic( pTopic, topicLength ) %
+           ( pSession->shadowCount * SHADOW_SESSION_RESPONSE_TOPICS );
+}
+/*-----------------------------------------------------------*/
+
+static size_t slotOf( ShadowTopicStringType_t topicType )
+{
+    size_t slot = 0U;
+
+    for( slot = 0U; slot < SHADOW_SESSION_TOPICS_PER_SHADOW; slot++ )
+    {
+        if( slotTopicTypes[ slot ] == topicType )
+        {
+            break;
+        }
+    }
+
+    return slot;
+}
+/*-----------------------------------------------------------*/
+
+ShadowSessionStatus_t ShadowSession_Init( ShadowSession_t * pSession,
+                                          const char * pThingName,
+                                          uint8_t thingNameLength,
+                                          const ShadowSessionName_t * pShadowNames,
+                                          size_t shadowCount,
+                                          void * pHandlerContext )
+{
+    ShadowSessionStatus_t status = SHADOW_SESSION_SUCCESS;
+    ShadowStatus_t shadowStatus = SHADOW_SUCCESS;
+    ShadowSessionTopic_t * pTopic = NULL;
+    size_t shadowIndex = 0U, slot = 0U, topicIndex = 0U, bucket = 0U;
+
+    if( ( pSession == NULL ) || ( pSession->pTopics == NULL ) || ( pSession->pBuckets == NULL ) ||
+        ( pThingName == NULL ) || ( pShadowNames == NULL ) ||
+        ( shadowCount == 0U ) || ( shadowCount > pSession->maxShadows ) )
+    {
+        LogError( ( "Invalid parameter: pSession=%p, pThingName=%p, pShadowNames=%p, shadowCount=%lu.",
+                    ( void * ) pSession,
+                    ( const void * ) pThingName,
+                    ( const void * ) pShadowNames,
+                    ( unsigned long ) shadowCount ) );
+        status = SHADOW_SESSION_INVALID_PARAMETER;
+    }
+    else
+    {
+        pSession->shadowCount = shadowCount;
+        pSession->pHandlerContext = pHandlerContext;
+        ( void ) memset( pSession->pBuckets,
+                         0x00,
+                         shadowCount * SHADOW_SESSION_RESPONSE_TOPICS * sizeof( uint16_t ) );
+
+        for( shadowIndex = 0U; ( shadowIndex < shadowCount ) && ( status == SHADOW_SESSION_SUCCESS ); shadowIndex++ )
+        {
+            for( slot = 0U; ( slot < SHADOW_SESSION_TOPICS_PER_SHADOW ) && ( status == SHADOW_SESSION_SUCCESS ); slot++ )
+            {
+                topicIndex = ( shadowIndex * SHADOW_SESSION_TOPICS_PER_SHADOW ) + slot;
+                pTopic = &( pSession->pTopics[ topicIndex ] );
+
+                shadowStatus = Shadow_AssembleTopicString( slotTopicTypes[ slot ],
+                                                           pThingName,
+                                                           thingNameLength,
+                                                           pShadowNames[ shadowIndex ].pName,
+                                                           pShadowNames[ shadowIndex ].nameLength,
+                                                           pTopic->topic,
+                                                           ( uint16_t ) sizeof( pTopic->topic ),
+                                                           &( pTopic->topicLength ) );
+
+                if( shadowStatus != SHADOW_SUCCESS )
+                {
+                    LogError( ( "Failed to assemble topic %u of shadow %.*s: %d.",
+                                ( unsigned int ) slot,
+                                ( int ) pShadowNames[ shadowIndex ].nameLength,
+                                pShadowNames[ shadowIndex ].pName,
+                                ( int ) shadowStatus ) );
+                    status = ( shadowStatus == SHADOW_BUFFER_TOO_SMALL ) ?
+                             SHADOW_SESSION_TOPIC_TOO_LONG : SHADOW_SESSION_INVALID_PARAMETER;
+                }
+                else if( slot < SHADOW_SESSION_RESPONSE_TOPICS )
+                {
+                    /* Only response topics are received. */
+                    bucket = bucketOf( pSession, pTopic->topic, pTopic->topicLength );
+                    pTopic->nextInBucket = pSession->pBuckets[ bucket ];
+                    pSession->pBuckets[ bucket ] = ( uint16_t ) ( topicIndex + 1U );
+                }
+                else
+                {
+                    pTopic->nextInBucket = 0U;
+                }
+            }
+        }
+
+        if( status != SHADOW_SESSION_SUCCESS )
+        {
+            pSession->shadowCount = 0U;
+        }
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+ShadowSessionStatus_t ShadowSession_SetHandler( ShadowSession_t * pSession,
+                                                ShadowMessageType_t messageType,
+                                                ShadowSessionHandler_t handler )
+{
+    ShadowSessionStatus_t status = SHADOW_SESSION_SUCCESS;
+
+    if( ( pSession == NULL ) || ( ( size_t ) messageType >= SHADOW_SESSION_RESPONSE_TOPICS ) )
+    {
+        LogError( ( "Invalid parameter: pSession=%p, messageType=%d.",
+                    ( void * ) pSession,
+                    ( int ) messageType ) );
+        status = SHADOW_SESSION_INVALID_PARAMETER;
+    }
+    else
+    {
+        pSession->handlers[ messageType ] = handler;
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+ShadowSessionStatus_t ShadowSession_GetTopic( const ShadowSession_t * pSession,
+                                              size_t shadowIndex,
+                                              ShadowTopicStringType_t topicType,
+                                              const char ** ppTopic,
+                                              uint16_t * pTopicLength )
+{
+    ShadowSessionStatus_t status = SHADOW_SESSION_SUCCESS;
+    const ShadowSessionTopic_t * pTopic = NULL;
+    size_t slot = slotOf( topicType );
+
+    if( ( pSession == NULL ) || ( shadowIndex >= pSession->shadowCount ) ||
+        ( slot == SHADOW_SESSION_TOPICS_PER_SHADOW ) || ( ppTopic == NULL ) || ( pTopicLength == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pSession=%p, shadowIndex=%lu, topicType=%d.",
+                    ( const void * ) pSession,
+                    ( unsigned long ) shadowIndex,
+                    ( int ) topicType ) );
+        status = SHADOW_SESSION_INVALID_PARAMETER;
+    }
+    else
+    {
+        pTopic = &( pSession->pTopics[ ( shadowIndex * SHADOW_SESSION_TOPICS_PER_SHADOW ) + slot ] );
+        *ppTopic = pTopic->topic;
+        *pTopicLength = pTopic->topicLength;
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+size_t ShadowSession_GetSubscriptions( const ShadowSession_t * pSession,
+                                       MQTTQoS_t qos,
+                                       MQTTSubscribeInfo_t * pSubscriptions,
+                                       size_t maxSubscriptions )
+{
+    const ShadowSessionTopic_t * pTopic = NULL;
+    size_t shadowIndex = 0U, slot = 0U, count = 0U;
+
+    assert( pSession != NULL );
+    assert( ( pSubscriptions != NULL ) || ( maxSubscriptions == 0U ) );
+
+    for( shadowIndex = 0U; shadowIndex < pSession->shadowCount; shadowIndex++ )
+    {
+        for( slot = 0U; slot < SHADOW_SESSION_RESPONSE_TOPICS; slot++ )
+        {
+            if( pSession->handlers[ slot ] != NULL )
+            {
+                if( count < maxSubscriptions )
+                {
+                    pTopic = &( pSession->pTopics[ ( shadowIndex * SHADOW_SESSION_TOPICS_PER_SHADOW ) + slot ] );
+                    pSubscriptions[ count ].qos = qos;
+                    pSubscriptions[ count ].pTopicFilter = pTopic->topic;
+                    pSubscriptions[ count ].topicFilterLength = pTopic->topicLength;
+                }
+
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+/*-----------------------------------------------------------*/
+
+bool ShadowSession_Dispatch( const ShadowSession_t * pSession,
+                             MQTTPublishInfo_t * pPublishInfo )
+{
+    const ShadowSessionTopic_t * pTopic = NULL;
+    size_t next = 0U, topicIndex = 0U, slot = 0U;
+    bool found = false;
+
+    assert( pSession != NULL );
+    assert( pPublishInfo != NULL );
+
+    if( pSession->shadowCount > 0U )
+    {
+        next = pSession->pBuckets[ bucketOf( pSession, pPublishInfo->pTopicName, pPublishInfo->topicNameLength ) ];
+
+        while( ( next != 0U ) && ( found == false ) )
+        {
+            topicIndex = next - 1U;
+            pTopic = &( pSession->pTopics[ topicIndex ] );
+
+            if( ( pTopic->topicLength == pPublishInfo->topicNameLength ) &&
+                ( memcmp( pTopic->topic, pPublishInfo->pTopicName, pTopic->topicLength ) == 0 ) )
+            {
+                found = true;
+            }
+            else
+            {
+                next = pTopic->nextInBucket;
+            }
+        }
+    }
+
+    if( found == true )
+    {
+        slot = topicIndex % SHADOW_SESSION_TOPICS_PER_SHADOW;
+
+        if( pSession->handlers[ slot ] != NULL )
+        {
+            pSession->handlers[ slot ]( pSession->pHandlerContext,
+                                        topicIndex / SHADOW_SESSION_TOPICS_PER_SHADOW,
+                                        pPublishInfo );
+        }
+        else
+        {
+            LogDebug( ( "No handler for shadow topic %.*s.",
+                        ( int ) pPublishInfo->topicNameLength,
+                        pPublishInfo->pTopicName ) );
+        }
+    }
+
+    return found;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,888 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file shadow_state.c
+ * @brief Reported state of a device shadow with dirty field tracking.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+#include "shadow_state.h"
+
+/* Compact encoding of the reported state. */
+#include "shadow_cbor.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Writes a document into a buffer. Once something does not fit,
+ * nothing more is written.
+ */
+typedef struct DocumentWriter
+{
+    char * pBuffer; /**< @brief The buffer. */
+    size_t size;    /**< @brief Size of the buffer. */
+    size_t length;  /**< @brief Length of the document written so far. */
+    bool overflow;  /**< @brief Something did not fit in the buffer. */
+} DocumentWriter_t;
+
+/**
+ * @brief Write a string literal.
+ */
+#define WRITE_LITERAL( pWriter, literal )    writeChars( ( pWriter ), ( literal ), sizeof( literal ) - 1U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get a field of a state, checking its type.
+ *
+ * @param[in] pState The state.
+ * @param[in] fieldIndex Index of the field.
+ * @param[in] type Expected type of the field.
+ *
+ * @return The field, or NULL if it does not exist or has another type.
+ */
+static ShadowField_t * getField( ShadowState_t * pState,
+                                 size_t fieldIndex,
+                                 ShadowFieldType_t type );
+
+/**
+ * @brief Write characters.
+ *
+ * @param[in] pWriter The writer.
+ * @param[in] pChars The characters.
+ * @param[in] length Number of characters.
+ */
+static void writeChars( DocumentWriter_t * pWriter,
+                        const char * pChars,
+                        size_t length );
+
+/**
+ * @brief Write an unsigned integer in decimal.
+ *
+ * @param[in] pWriter The writer.
+ * @param[in] value The integer.
+ */
+static void writeUint( DocumentWriter_t * pWriter,
+                       uint32_t value );
+
+/**
+ * @brief Write a JSON string, escaping the characters that need it.
+ *
+ * @param[in] pWriter The writer.
+ * @param[in] pString The string.
+ * @param[in] length Length of @p pString.
+ */
+static void writeString( DocumentWriter_t * pWriter,
+                         const char * pString,
+                         size_t length );
+
+/**
+ * @brief Write the value of a field.
+ *
+ * @param[in] pWriter The writer.
+ * @param[in] pField The field.
+ */
+static void writeValue( DocumentWriter_t * pWriter,
+                        const ShadowField_t * pField );
+
+/**
+ * @brief Encode the value of a field in CBOR.
+ *
+ * @param[in] pWriter The CBOR writer.
+ * @param[in] pField The field.
+ */
+static void encodeValue( ShadowCborWriter_t * pWriter,
+                         const ShadowField_t * pField );
+
+/**
+ * @brief Count the dirty fields of a state.
+ *
+ * @param[in] pState The state.
+ *
+ * @return Number of dirty fields.
+ */
+static size_t countDirtyFields( const ShadowState_t * pState );
+
+/**
+ * @brief Check the client token of an update to serialize.
+ *
+ * @param[in] pClientToken Client token of the update, or NULL for none.
+ * @param[in] clientTokenLength Length of @p pClientToken.
+ *
+ * @return true if the token can be kept while the update is in flight.
+ */
+static bool clientTokenValid( const char * pClientToken,
+                              size_t clientTokenLength );
+
+/**
+ * @brief Get a free entry for the update about to be serialized, giving up
+ * the oldest update in flight if none is free, so that its fields are dirty
+ * again and reported by this update.
+ *
+ * @param[in] pState The state.
+ *
+ * @return The entry, not taken until #startUpdate.
+ */
+static ShadowUpdate_t * reserveUpdate( ShadowState_t * pState );
+
+/**
+ * @brief Find the update in flight with a client token, the oldest if several
+ * have it.
+ *
+ * @param[in] pState The state.
+ * @param[in] pClientToken The client token, or NULL for none.
+ * @param[in] clientTokenLength Length of @p pClientToken.
+ *
+ * @return The update, or NULL if none has the token.
+ */
+static ShadowUpdate_t * findUpdate( ShadowState_t * pState,
+                                    const char * pClientToken,
+                                    size_t clientTokenLength );
+
+/**
+ * @brief Complete the fields whose last update is a given one, and free the
+ * entry of the update.
+ *
+ * @param[in] pState The state.
+ * @param[in] pUpdate The update.
+ * @param[in] accepted Whether the update was accepted.
+ */
+static void completeUpdate( ShadowState_t * pState,
+                            ShadowUpdate_t * pUpdate,
+                            bool accepted );
+
+/**
+ * @brief Mark the dirty fields in flight once their update is serialized.
+ *
+ * @param[in] pState The state.
+ * @param[in] pUpdate The entry given by #reserveUpdate.
+ * @param[in] nowMs The current time, in milliseconds.
+ * @param[in] pClientToken Client token of the update, or NULL for none.
+ * @param[in] clientTokenLength Length of @p pClientToken.
+ */
+static void startUpdate( ShadowState_t * pState,
+                         ShadowUpdate_t * pUpdate,
+                         uint32_t nowMs,
+                         const char * pClientToken,
+                         size_t clientTokenLength );
+
+/*-----------------------------------------------------------*/
+
+static ShadowField_t * getField( ShadowState_t * pState,
+                                 size_t fieldIndex,
+                                 ShadowFieldType_t type )
+{
+    ShadowField_t * pField = NULL;
+
+    if( ( pState != NULL ) && ( pState->pFields != NULL ) && ( fieldIndex < pState->fieldCount ) &&
+        ( pState->pFields[ fieldIndex ].type == type ) )
+    {
+        pField = &( pState->pFields[ fieldIndex ] );
+    }
+    else
+    {
+        LogError( ( "No shadow field of type %d at index %lu.",
+                    ( int ) type,
+                    ( unsigned long ) fieldIndex ) );
+    }
+
+    return pField;
+}
+/*-----------------------------------------------------------*/
+
+static void writeChars( DocumentWriter_t * pWriter,
+                        const char * pChars,
+                        size_t length )
+{
+    if( pWriter->overflow == false )
+    {
+        if( length > ( pWriter->size - pWriter->length ) )
+        {
+            pWriter->overflow = true;
+        }
+        else
+        {
+            ( void ) memcpy( &( pWriter->pBuffer[ pWriter->length ] ), pChars, length );
+            pWriter->length += length;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void writeUint( DocumentWriter_t * pWriter,
+                       uint32_t value )
+{
+    /* The digits of the largest 32-bit integer. */
+    char digits[ 10 ];
+    size_t start = sizeof( digits );
+
+    do
+    {
+        start--;
+        digits[ start ] = ( char ) ( '0' + ( value % 10U ) );
+        value /= 10U;
+    } while( value > 0U );
+
+    writeChars( pWriter, &( digits[ start ] ), sizeof( digits ) - start );
+}
+/*-----------------------------------------------------------*/
+
+static void writeString( DocumentWriter_t * pWriter,
+                         const char * pString,
+                         size_t length )
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    char escape[ 6 ] = { '\\', 'u', '0', '0', '0', '0' };
+    size_t i = 0U, runStart = 0U;
+    uint8_t c = 0U;
+
+    WRITE_LITERAL( pWriter, "\"" );
+
+    /* Characters that need no escape are written in runs. */
+    for( i = 0U; i < length; i++ )
+    {
+        c = ( uint8_t ) pString[ i ];
+
+        if( ( c == ( uint8_t ) '"' ) || ( c == ( uint8_t ) '\\' ) || ( c < 0x20U ) )
+        {
+            writeChars( pWriter, &( pString[ runStart ] ), i - runStart );
+            runStart = i + 1U;
+
+            if( c < 0x20U )
+            {
+                escape[ 1 ] = 'u';
+                escape[ 4 ] = hexDigits[ c >> 4 ];
+                escape[ 5 ] = hexDigits[ c & 0x0FU ];
+                writeChars( pWriter, escape, sizeof( escape ) );
+            }
+            else
+            {
+                escape[ 1 ] = ( char ) c;
+                writeChars( pWriter, escape, 2U );
+            }
+        }
+    }
+
+    writeChars( pWriter, &( pString[ runStart ] ), length - runStart );
+
+    WRITE_LITERAL( pWriter, "\"" );
+}
+/*-----------------------------------------------------------*/
+
+static void writeValue( DocumentWriter_t * pWriter,
+                        const ShadowField_t * pField )
+{
+    switch( pField->type )
+    {
+        case SHADOW_FIELD_TYPE_BOOL:
+
+            if( pField->value.boolValue == true )
+            {
+                WRITE_LITERAL( pWriter, "true" );
+            }
+            else
+            {
+                WRITE_LITERAL( pWriter, "false" );
+            }
+
+            break;
+
+        case SHADOW_FIELD_TYPE_INT:
+
+            if( pField->value.intValue < 0 )
+            {
+                WRITE_LITERAL( pWriter, "-" );
+                /* Negate in unsigned arithmetic, which also holds INT32_MIN. */
+                writeUint( pWriter, 0U - ( uint32_t ) pField->value.intValue );
+            }
+            else
+            {
+                writeUint( pWriter, ( uint32_t ) pField->value.intValue );
+            }
+
+            break;
+
+        case SHADOW_FIELD_TYPE_UINT:
+            writeUint( pWriter, pField->value.uintValue );
+            break;
+
+        case SHADOW_FIELD_TYPE_STRING:
+        default:
+            writeString( pWriter, pField->pString, pField->stringLength );
+            break;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void encodeValue( ShadowCborWriter_t * pWriter,
+                         const ShadowField_t * pField )
+{
+    switch( pField->type )
+    {
+        case SHADOW_FIELD_TYPE_BOOL:
+            ShadowCbor_EncodeBool( pWriter, pField->value.boolValue );
+            break;
+
+        case SHADOW_FIELD_TYPE_INT:
+            ShadowCbor_EncodeInt( pWriter, pField->value.intValue );
+            break;
+
+        case SHADOW_FIELD_TYPE_UINT:
+            ShadowCbor_EncodeUint( pWriter, pField->value.uintValue );
+            break;
+
+        case SHADOW_FIELD_TYPE_STRING:
+        default:
+            ShadowCbor_EncodeText( pWriter, pField->pString, pField->stringLength );
+            break;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static size_t countDirtyFields( const ShadowState_t * pState )
+{
+    size_t i = 0U, dirtyCount = 0U;
+
+    for( i = 0U; i < pState->fieldCount; i++ )
+    {
+        if( pState->pFields[ i ].dirty == true )
+        {
+            dirtyCount++;
+        }
+    }
+
+    return dirtyCount;
+}
+/*-----------------------------------------------------------*/
+
+static bool clientTokenValid( const char * pClientToken,
+                              size_t clientTokenLength )
+{
+    bool valid = true;
+
+    if( ( pClientToken != NULL ) && ( clientTokenLength > SHADOW_STATE_MAX_CLIENT_TOKEN_LENGTH ) )
+    {
+        LogError( ( "A client token of %lu bytes exceeds SHADOW_STATE_MAX_CLIENT_TOKEN_LENGTH.",
+                    ( unsigned long ) clientTokenLength ) );
+        valid = false;
+    }
+
+    return valid;
+}
+/*-----------------------------------------------------------*/
+
+static ShadowUpdate_t * reserveUpdate( ShadowState_t * pState )
+{
+    ShadowUpdate_t * pUpdate = NULL;
+    size_t i = 0U;
+
+    for( i = 0U; i < SHADOW_STATE_MAX_UPDATES; i++ )
+    {
+        if( pState->updates[ i ].id == 0U )
+        {
+            pUpdate = &( pState->updates[ i ] );
+            break;
+        }
+
+        /* Ids increase from update to update, across a wrap. */
+        if( ( pUpdate == NULL ) ||
+            ( ( pState->lastUpdateId - pState->updates[ i ].id ) > ( pState->lastUpdateId - pUpdate->id ) ) )
+        {
+            pUpdate = &( pState->updates[ i ] );
+        }
+    }
+
+    if( pUpdate->id != 0U )
+    {
+        LogWarn( ( "Giving up the shadow update with clientToken %.*s, which got no response.",
+                   ( int ) pUpdate->clientTokenLength,
+                   pUpdate->clientToken ) );
+        completeUpdate( pState, pUpdate, false );
+    }
+
+    return pUpdate;
+}
+/*-----------------------------------------------------------*/
+
+static ShadowUpdate_t * findUpdate( ShadowState_t * pState,
+                                    const char * pClientToken,
+                                    size_t clientTokenLength )
+{
+    ShadowUpdate_t * pUpdate = NULL;
+    const ShadowUpdate_t * pCandidate = NULL;
+    size_t i = 0U;
+
+    if( pClientToken == NULL )
+    {
+        clientTokenLength = 0U;
+    }
+
+    for( i = 0U; i < SHADOW_STATE_MAX_UPDATES; i++ )
+    {
+        pCandidate = &( pState->updates[ i ] );
+
+        if( ( pCandidate->id != 0U ) &&
+            ( pCandidate->clientTokenLength == clientTokenLength ) &&
+            ( ( clientTokenLength == 0U ) ||
+              ( memcmp( pCandidate->clientToken, pClientToken, clientTokenLength ) == 0 ) ) &&
+            ( ( pUpdate == NULL ) ||
+              ( ( pState->lastUpdateId - pCandidate->id ) > ( pState->lastUpdateId - pUpdate->id ) ) ) )
+        {
+            pUpdate = &( pState->updates[ i ] );
+        }
+    }
+
+    return pUpdate;
+}
+/*-----------------------------------------------------------*/
+
+static void completeUpdate( ShadowState_t * pState,
+                            ShadowUpdate_t * pUpdate,
+                            bool accepted )
+{
+    size_t i = 0U;
+
+    for( i = 0U; i < pState->fieldCount; i++ )
+    {
+        if( ( pState->pFields[ i ].inFlight == true ) &&
+            ( pState->pFields[ i ].updateId == pUpdate->id ) )
+        {
+            pState->pFields[ i ].inFlight = false;
+
+            /* A field set again since the update is already dirty. */
+            if( accepted == false )
+            {
+                pState->pFields[ i ].dirty = true;
+            }
+        }
+    }
+
+    pUpdate->id = 0U;
+}
+/*-----------------------------------------------------------*/
+
+static void startUpdate( ShadowState_t * pState,
+                         ShadowUpdate_t * pUpdate,
+                         uint32_t nowMs,
+                         const char * pClientToken,
+                         size_t clientTokenLength )
+{
+    size_t i = 0U;
+
+    pState->lastUpdateId++;
+
+    if( pState->lastUpdateId == 0U )
+    {
+        pState->lastUpdateId = 1U;
+    }
+
+    pUpdate->id = pState->lastUpdateId;
+    pUpdate->clientTokenLength = ( pClientToken != NULL ) ? clientTokenLength : 0U;
+
+    if( pUpdate->clientTokenLength > 0U )
+    {
+        ( void ) memcpy( pUpdate->clientToken, pClientToken, pUpdate->clientTokenLength );
+    }
+
+    /* A field still in flight in an earlier update now waits for this one. */
+    for( i = 0U; i < pState->fieldCount; i++ )
+    {
+        if( pState->pFields[ i ].dirty == true )
+        {
+            pState->pFields[ i ].dirty = false;
+            pState->pFields[ i ].inFlight = true;
+            pState->pFields[ i ].updateId = pUpdate->id;
+        }
+    }
+
+    pState->lastUpdateMs = nowMs;
+    pState->updateSent = true;
+}
+/*-----------------------------------------------------------*/
+
+ShadowStateStatus_t ShadowState_Init( ShadowState_t * pState,
+                                      ShadowField_t * pFields,
+                                      size_t fieldCount,
+                                      uint32_t minIntervalMs )
+{
+    ShadowStateStatus_t status = SHADOW_STATE_SUCCESS;
+    size_t i = 0U;
+
+    if( ( pState == NULL ) || ( pFields == NULL ) || ( fieldCount == 0U ) )
+    {
+        LogError( ( "Invalid parameter: pState=%p, pFields=%p, fieldCount=%lu.",
+                    ( void * ) pState,
+                    ( void * ) pFields,
+                    ( unsigned long ) fieldCount ) );
+        status = SHADOW_STATE_INVALID_PARAMETER;
+    }
+    else
+    {
+        for( i = 0U; ( i < fieldCount ) && ( status == SHADOW_STATE_SUCCESS ); i++ )
+        {
+            if( ( pFields[ i ].type == SHADOW_FIELD_TYPE_STRING ) && ( pFields[ i ].pString == NULL ) )
+            {
+                LogError( ( "String shadow field %.*s has no buffer.",
+                            ( int ) pFields[ i ].keyLength,
+                            pFields[ i ].pKey ) );
+                status = SHADOW_STATE_INVALID_PARAMETER;
+            }
+
+            pFields[ i ].dirty = true;
+            pFields[ i ].inFlight = false;
+            pFields[ i ].updateId = 0U;
+        }
+    }
+
+    if( status == SHADOW_STATE_SUCCESS )
+    {
+        pState->pFields = pFields;
+        pState->fieldCount = fieldCount;
+        pState->minIntervalMs = minIntervalMs;
+        pState->lastUpdateMs = 0U;
+        pState->updateSent = false;
+        ( void ) memset( pState->updates, 0x00, sizeof( pState->updates ) );
+        pState->lastUpdateId = 0U;
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+ShadowStateStatus_t ShadowState_SetBool( ShadowState_t * pState,
+                                         size_t fieldIndex,
+                                         bool value )
+{
+    ShadowStateStatus_t status = SHADOW_STATE_INVALID_PARAMETER;
+    ShadowField_t * pField = getField( pState, fieldIndex, SHADOW_FIELD_TYPE_BOOL );
+
+    if( pField != NULL )
+    {
+        if( pField->value.boolValue != value )
+        {
+            pField->value.boolValue = value;
+            pField->dirty = true;
+        }
+
+        status = SHADOW_STATE_SUCCESS;
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+ShadowStateStatus_t ShadowState_SetInt( ShadowState_t * pState,
+                                        size_t fieldIndex,
+                                        int32_t value )
+{
+    ShadowStateStatus_t status = SHADOW_STATE_INVALID_PARAMETER;
+    ShadowField_t * pField = getField( pState, fieldIndex, SHADOW_FIELD_TYPE_INT );
+
+    if( pField != NULL )
+    {
+        if( pField->value.intValue != value )
+        {
+            pField->value.intValue = value;
+            pField->dirty = true;
+        }
+
+        status = SHADOW_STATE_SUCCESS;
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+ShadowStateStatus_t ShadowState_SetUint( ShadowState_t * pState,
+                                         size_t fieldIndex,
+                                         uint32_t value )
+{
+    ShadowStateStatus_t status = SHADOW_STATE_INVALID_PARAMETER;
+    ShadowField_t * pField = getField( pState, fieldIndex, SHADOW_FIELD_TYPE_UINT );
+
+    if( pField != NULL )
+    {
+        if( pField->value.uintValue != value )
+        {
+            pField->value.uintValue = value;
+            pField->dirty = true;
+        }
+
+        status = SHADOW_STATE_SUCCESS;
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+ShadowStateStatus_t ShadowState_SetString( ShadowState_t * pState,
+                                           size_t fieldIndex,
+                                           const char * pValue,
+                                           size_t valueLength )
+{
+    ShadowStateStatus_t status = SHADOW_STATE_INVALID_PARAMETER;
+    ShadowField_t * pField = getField( pState, fieldIndex, SHADOW_FIELD_TYPE_STRING );
+
+    if( ( pField == NULL ) || ( ( pValue == NULL ) && ( valueLength > 0U ) ) )
+    {
+        status = SHADOW_STATE_INVALID_PARAMETER;
+    }
+    else if( valueLength > pField->stringCapacity )
+    {
+        LogError( ( "Value of %lu bytes does not fit in shadow field %.*s.",
+                    ( unsigned long ) valueLength,
+                    ( int ) pField->keyLength,
+                    pField->pKey ) );
+        status = SHADOW_STATE_BUFFER_TOO_SMALL;
+    }
+    else
+    {
+        if( ( pField->stringLength != valueLength ) ||
+            ( memcmp( pField->pString, pValue, valueLength ) != 0 ) )
+        {
+            ( void ) memcpy( pField->pString, pValue, valueLength );
+            pField->stringLength = valueLength;
+            pField->dirty = true;
+        }
+
+        status = SHADOW_STATE_SUCCESS;
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+bool ShadowState_UpdateDue( const ShadowState_t * pState,
+                            uint32_t nowMs )
+{
+    bool due = false;
+    size_t i = 0U;
+
+    assert( pState != NULL );
+
+    /* The subtraction is correct across a wrap of the clock. */
+    if( ( pState->updateSent == false ) || ( ( nowMs - pState->lastUpdateMs ) >= pState->minIntervalMs ) )
+    {
+        for( i = 0U; ( i < pState->fieldCount ) && ( due == false ); i++ )
+        {
+            due = pState->pFields[ i ].dirty;
+        }
+    }
+
+    return due;
+}
+/*-----------------------------------------------------------*/
+
+ShadowStateStatus_t ShadowState_SerializeReported( ShadowState_t * pState,
+                                                   uint32_t nowMs,
+                                                   const char * pClientToken,
+                                                   size_t clientTokenLength,
+                                                   char * pBuffer,
+                                                   size_t bufferSize,
+                                                   size_t * pDocumentLength )
+{
+    ShadowStateStatus_t status = SHADOW_STATE_SUCCESS;
+    DocumentWriter_t writer = { 0 };
+    const ShadowField_t * pField = NULL;
+    ShadowUpdate_t * pUpdate = NULL;
+    size_t i = 0U, reportedCount = 0U;
+
+    if( ( pState == NULL ) || ( pBuffer == NULL ) || ( pDocumentLength == NULL ) ||
+        ( clientTokenValid( pClientToken, clientTokenLength ) == false ) )
+    {
+        LogError( ( "Invalid parameter: pState=%p, pBuffer=%p, pDocumentLength=%p.",
+                    ( void * ) pState,
+                    ( void * ) pBuffer,
+                    ( void * ) pDocumentLength ) );
+        status = SHADOW_STATE_INVALID_PARAMETER;
+    }
+    else
+    {
+        pUpdate = reserveUpdate( pState );
+        writer.pBuffer = pBuffer;
+        writer.size = bufferSize;
+
+        WRITE_LITERAL( &writer, "{\"state\":{\"reported\":{" );
+
+        for( i = 0U; i < pState->fieldCount; i++ )
+        {
+            pField = &( pState->pFields[ i ] );
+
+            if( pField->dirty == true )
+            {
+                if( reportedCount > 0U )
+                {
+                    WRITE_LITERAL( &writer, "," );
+                }
+
+                writeString( &writer, pField->pKey, pField->keyLength );
+                WRITE_LITERAL( &writer, ":" );
+                writeValue( &writer, pField );
+                reportedCount++;
+            }
+        }
+
+        WRITE_LITERAL( &writer, "}}" );
+
+        if( pClientToken != NULL )
+        {
+            WRITE_LITERAL( &writer, ",\"clientToken\":" );
+            writeString( &writer, pClientToken, clientTokenLength );
+        }
+
+        WRITE_LITERAL( &writer, "}" );
+
+        if( reportedCount == 0U )
+        {
+            status = SHADOW_STATE_NOTHING_TO_REPORT;
+        }
+        else if( writer.overflow == true )
+        {
+            LogError( ( "Reporting %lu shadow fields needs a buffer larger than %lu bytes.",
+                        ( unsigned long ) reportedCount,
+                        ( unsigned long ) bufferSize ) );
+            status = SHADOW_STATE_BUFFER_TOO_SMALL;
+        }
+        else
+        {
+            startUpdate( pState, pUpdate, nowMs, pClientToken, clientTokenLength );
+            *pDocumentLength = writer.length;
+
+            LogDebug( ( "Reporting %lu of %lu shadow fields in %lu bytes.",
+                        ( unsigned long ) reportedCount,
+                        ( unsigned long ) pState->fieldCount,
+                        ( unsigned long ) writer.length ) );
+        }
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+ShadowStateStatus_t ShadowState_SerializeReportedCbor( ShadowState_t * pState,
+                                                       uint32_t nowMs,
+                                                       const char * pClientToken,
+                                                       size_t clientTokenLength,
+                                                       uint8_t * pBuffer,
+                                                       size_t bufferSize,
+                                                       size_t * pDocumentLength )
+{
+    ShadowStateStatus_t status = SHADOW_STATE_SUCCESS;
+    ShadowCborWriter_t writer = { 0 };
+    const ShadowField_t * pField = NULL;
+    ShadowUpdate_t * pUpdate = NULL;
+    size_t i = 0U, reportedCount = 0U;
+
+    if( ( pState == NULL ) || ( pBuffer == NULL ) || ( pDocumentLength == NULL ) ||
+        ( clientTokenValid( pClientToken, clientTokenLength ) == false ) )
+    {
+        LogError( ( "Invalid parameter: pState=%p, pBuffer=%p, pDocumentLength=%p.",
+                    ( void * ) pState,
+                    ( void * ) pBuffer,
+                    ( void * ) pDocumentLength ) );
+        status = SHADOW_STATE_INVALID_PARAMETER;
+    }
+    else
+    {
+        /* CBOR maps hold their number of pairs up front, counted once
+         * the fields of an update given up are dirty again. */
+        pUpdate = reserveUpdate( pState );
+        reportedCount = countDirtyFields( pState );
+
+        ShadowCbor_WriterInit( &writer, pBuffer, bufferSize );
+        ShadowCbor_EncodeMap( &writer, ( pClientToken != NULL ) ? 2U : 1U );
+        ShadowCbor_EncodeText( &writer, "state", sizeof( "state" ) - 1U );
+        ShadowCbor_EncodeMap( &writer, 1U );
+        ShadowCbor_EncodeText( &writer, "reported", sizeof( "reported" ) - 1U );
+        ShadowCbor_EncodeMap( &writer, reportedCount );
+
+        for( i = 0U; i < pState->fieldCount; i++ )
+        {
+            pField = &( pState->pFields[ i ] );
+
+            if( pField->dirty == true )
+            {
+                ShadowCbor_EncodeText( &writer, pField->pKey, pField->keyLength );
+                encodeValue( &writer, pField );
+            }
+        }
+
+        if( pClientToken != NULL )
+        {
+            ShadowCbor_EncodeText( &writer, "clientToken", sizeof( "clientToken" ) - 1U );
+            ShadowCbor_EncodeText( &writer, pClientToken, clientTokenLength );
+        }
+
+        if( reportedCount == 0U )
+        {
+            status = SHADOW_STATE_NOTHING_TO_REPORT;
+        }
+        else if( writer.overflow == true )
+        {
+            LogError( ( "Reporting %lu shadow fields in CBOR needs a buffer larger than %lu bytes.",
+                        ( unsigned long ) reportedCount,
+                        ( unsigned long ) bufferSize ) );
+            status = SHADOW_STATE_BUFFER_TOO_SMALL;
+        }
+        else
+        {
+            startUpdate( pState, pUpdate, nowMs, pClientToken, clientTokenLength );
+            *pDocumentLength = writer.length;
+
+            LogDebug( ( "Reporting %lu of %lu shadow fields in %lu CBOR bytes.",
+                        ( unsigned long ) reportedCount,
+                        ( unsigned long ) pState->fieldCount,
+                        ( unsigned long ) writer.length ) );
+        }
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+void ShadowState_Complete( ShadowState_t * pState,
+                           const char * pClientToken,
+                           size_t clientTokenLength,
+                           bool accepted )
+{
+    ShadowUpdate_t * pUpdate = NULL;
+
+    assert( pState != NULL );
+
+    pUpdate = findUpdate( pState, pClientToken, clientTokenLength );
+
+    if( pUpdate != NULL )
+    {
+        completeUpdate( pState, pUpdate, accepted );
+    }
+    else
+    {
+        LogWarn( ( "No shadow update in flight has clientToken %.*s.",
+                   ( pClientToken != NULL ) ? ( int ) clientTokenLength : 0,
+                   ( pClientToken != NULL ) ? pClientToken : "" ) );
+    }
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,88 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file mbedtls_arena_zephyr.h
+ * @brief Optional static memory arena for mbed TLS, with per-connection usage
+ * accounting.
+ */
+
+#ifndef MBEDTLS_ARENA_ZEPHYR_H_
+#define MBEDTLS_ARENA_ZEPHYR_H_
+
+/* Standard includes. */
+#include <stddef.h>
+
+/**
+ * @brief Size in bytes of the static arena from which all mbed TLS memory is
+ * allocated. Set to 0, the default, to leave mbed TLS on its own allocator.
+ *
+ * @note The arena replaces the allocator of mbed TLS when the system starts,
+ * so mbed TLS must be built with MBEDTLS_PLATFORM_MEMORY, which
+ * CONFIG_MBEDTLS_ENABLE_HEAP provides. The heap configured by
+ * CONFIG_MBEDTLS_HEAP_SIZE is then unused and can be kept small.
+ */
+#ifndef MBEDTLS_ZEPHYR_ARENA_SIZE
+    #define MBEDTLS_ZEPHYR_ARENA_SIZE    ( 0U )
+#endif
+
+/**
+ * @brief Maximum number of threads that can attribute the allocations they
+ * make to a connection at the same time.
+ */
+#ifndef MBEDTLS_ZEPHYR_ARENA_MAX_OWNERS
+    #define MBEDTLS_ZEPHYR_ARENA_MAX_OWNERS    ( 4U )
+#endif
+
+/**
+ * @brief Bytes of the arena in use, by a connection or in total.
+ */
+typedef struct MbedTLSArenaUsage
+{
+    size_t currentBytes; /**< @brief Bytes currently allocated. */
+    size_t peakBytes;    /**< @brief Highest value of #MbedTLSArenaUsage_t.currentBytes. */
+} MbedTLSArenaUsage_t;
+
+/**
+ * @brief Attribute the allocations that mbed TLS makes from the calling
+ * thread to a usage record, until the record is changed again.
+ *
+ * The transport calls this around the calls into mbed TLS made on behalf of
+ * a connection. Memory is credited back to the same record when it is freed,
+ * from any thread.
+ *
+ * @param[in] pUsage Usage record of the connection, or NULL to stop
+ * attributing allocations of the calling thread.
+ */
+void MbedTLSArena_SetOwner( MbedTLSArenaUsage_t * pUsage );
+
+/**
+ * @brief Read a usage record consistently with concurrent allocations.
+ *
+ * @param[in] pUsage Usage record of a connection, or NULL for the whole arena.
+ * @param[out] pSnapshot Copy of the usage record. All zero when
+ * #MBEDTLS_ZEPHYR_ARENA_SIZE is 0.
+ */
+void MbedTLSArena_GetUsage( const MbedTLSArenaUsage_t * pUsage,
+                            MbedTLSArenaUsage_t * pSnapshot );
+
+#endif /* ifndef MBEDTLS_ARENA_ZEPHYR_H_ */
@@ -59,6 +59,12 @@
 /* Zephyr Sockets library include. */
 #include "sockets_zephyr.h"
 
+/* mbed TLS memory arena include. */
+#include "mbedtls_arena_zephyr.h"
+
+/* Transport metrics include. */
+#include "transport_metrics_zephyr.h"
+
 /* mbed TLS includes. */
 #include <mbedtls/net_sockets.h>
 #include <mbedtls/ctr_drbg.h>
@@ -66,6 +72,17 @@
 #include <mbedtls/ssl.h>
 #include <mbedtls/x509.h>
 
+/**
+ * @brief Size of the buffer in which #MbedTLS_Writev gathers the plaintext
+ * of a TLS record, held by every TlsTransportParams_t.
+ *
+ * Vectors are gathered only up to the maximum record payload of the
+ * connection, so a larger buffer is not used.
+ */
+#ifndef MBEDTLS_ZEPHYR_WRITEV_BUFFER_SIZE
+    #define MBEDTLS_ZEPHYR_WRITEV_BUFFER_SIZE    ( 1024U )
+#endif
+
 /**
  * @brief Secured connection context.
  */
@@ -77,10 +94,35 @@ typedef struct SSLContext
     mbedtls_x509_crt rootCa;                 /**< @brief Root CA certificate context. */
     mbedtls_x509_crt clientCert;             /**< @brief Client certificate context. */
     mbedtls_pk_context privKey;              /**< @brief Client private key context. */
-    mbedtls_entropy_context entropyContext;  /**< @brief Entropy context for random number generation. */
-    mbedtls_ctr_drbg_context ctrDrgbContext; /**< @brief CTR DRBG context for random number generation. */
 } SSLContext_t;
 
+/**
+ * @brief Progress of a connection being established by #MbedTLS_ConnectStart
+ * and #MbedTLS_ConnectStep.
+ *
+ * The pointers are those given to #MbedTLS_ConnectStart, which must remain
+ * valid until the connection is established or has failed.
+ */
+typedef struct TlsConnectOperation
+{
+    const ServerInfo_t * pServerInfo;                      /**< @brief Server being connected to. */
+    const struct NetworkCredentials * pNetworkCredentials; /**< @brief Credentials of the connection. */
+    const SocketsConfig_t * pSocketsConfig;                /**< @brief Tuning profile of the socket, or NULL. */
+    uint32_t receiveTimeoutMs;                             /**< @brief Receive timeout of the established connection. */
+    uint32_t sendTimeoutMs;                                /**< @brief Send timeout of the established connection. */
+    bool nonBlocking;                                      /**< @brief Whether the handshake runs on a non-blocking socket. */
+    bool inProgress;                                       /**< @brief Whether #MbedTLS_ConnectStep must be called. */
+    bool sessionOffered;                                   /**< @brief Whether a cached session is offered in the current handshake. */
+    unsigned char offeredMasterSecret[ 48 ];               /**< @brief Master secret of the offered session. */
+
+    /**
+     * @brief Readiness of TlsTransportParams_t.tcpSocket that the handshake
+     * waits for, ZSOCK_POLLIN or ZSOCK_POLLOUT, while #MbedTLS_ConnectStep
+     * returns #TLS_TRANSPORT_IN_PROGRESS.
+     */
+    int16_t pollEvents;
+} TlsConnectOperation_t;
+
 /**
  * @brief Parameters for the network context of the transport interface
  * implementation that uses mbedTLS and Zephyr sockets.
@@ -89,8 +131,61 @@ typedef struct TlsTransportParams
 {
     int32_t tcpSocket;
     SSLContext_t sslContext;
+
+    /**
+     * @brief Set by #MbedTLS_Connect to true when the connection was
+     * established with an abbreviated handshake that resumed a cached session.
+     */
+    bool sessionResumed;
+
+    /**
+     * @brief Optional read-ahead buffer for #MbedTLS_recv. Leave
+     * ReadAheadBuffer_t.pBuffer NULL to read directly from mbed TLS.
+     */
+    ReadAheadBuffer_t readAhead;
+
+    /**
+     * @brief Buffer in which #MbedTLS_Writev gathers the plaintext of a
+     * record, owned by the connection so that concurrent connections write
+     * without waiting for each other.
+     */
+    uint8_t writevBuffer[ MBEDTLS_ZEPHYR_WRITEV_BUFFER_SIZE ];
+
+    /**
+     * @brief Arena memory used by the connection, reset by #MbedTLS_Connect.
+     * Read it with #MbedTLSArena_GetUsage. It stays zero unless
+     * #MBEDTLS_ZEPHYR_ARENA_SIZE is set.
+     */
+    MbedTLSArenaUsage_t memoryUsage;
+
+    /**
+     * @brief Metrics of the connection, including the TLS records of
+     * application data. Read them with #TransportMetrics_Snapshot. They stay
+     * zero unless #TRANSPORT_METRICS_ENABLED is 1.
+     */
+    TransportMetrics_t metrics;
+
+    /**
+     * @brief State of the connection while it is being established.
+     */
+    TlsConnectOperation_t connect;
 } TlsTransportParams_t;
 
+/**
+ * @brief Credentials parsed once by #MbedTLS_LoadCredentials and shared,
+ * read-only, by any number of TLS connections.
+ *
+ * @note The store must outlive every connection that references it, and must
+ * not be freed or reloaded while such a connection is open.
+ */
+typedef struct TlsCredentialStore
+{
+    mbedtls_x509_crt rootCa;     /**< @brief Trusted server root CA certificate chain. */
+    mbedtls_x509_crt clientCert; /**< @brief Client certificate. */
+    mbedtls_pk_context privKey;  /**< @brief Client private key. */
+    bool hasClientCredentials;   /**< @brief Whether #TlsCredentialStore.clientCert and #TlsCredentialStore.privKey are set. */
+} TlsCredentialStore_t;
+
 /**
  * @brief Contains the credentials necessary for tls connection setup.
  */
@@ -117,6 +212,30 @@ typedef struct NetworkCredentials
     size_t clientCertSize;       /**< @brief Size associated with #NetworkCredentials.pClientCert. */
     const uint8_t * pPrivateKey; /**< @brief String representing the client certificate's private key. */
     size_t privateKeySize;       /**< @brief Size associated with #NetworkCredentials.pPrivateKey. */
+
+    /**
+     * @brief Optional credentials already parsed by #MbedTLS_LoadCredentials.
+     *
+     * When set, the connection references the certificates and key of the
+     * store instead of parsing #NetworkCredentials.pRootCa,
+     * #NetworkCredentials.pClientCert and #NetworkCredentials.pPrivateKey,
+     * which may then be left NULL.
+     */
+    const TlsCredentialStore_t * pCredentialStore;
+
+    /**
+     * @brief Maximum TLS record payload (RFC 6066 maximum fragment length) of
+     * the connection: 512, 1024, 2048 or 4096 bytes, or 0 for 4096.
+     *
+     * Outgoing records never exceed this size. Incoming records are limited
+     * to it when the server accepts the extension. With
+     * MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH, mbed TLS also shrinks the record
+     * buffers of the connection to this size once the handshake completes,
+     * so small values suit low-rate telemetry links on constrained parts,
+     * and large values suit bulk transfers. Ignored when mbed TLS is built
+     * without MBEDTLS_SSL_MAX_FRAGMENT_LENGTH.
+     */
+    uint16_t maxFragmentLength;
 } NetworkCredentials_t;
 
 /**
@@ -130,9 +249,45 @@ typedef enum TlsTransportStatus
     TLS_TRANSPORT_INVALID_CREDENTIALS, /**< Provided credentials were invalid. */
     TLS_TRANSPORT_HANDSHAKE_FAILED,    /**< Performing TLS handshake with server failed. */
     TLS_TRANSPORT_INTERNAL_ERROR,      /**< A call to a system API resulted in an internal error. */
-    TLS_TRANSPORT_CONNECT_FAILURE      /**< Initial connection to the server failed. */
+    TLS_TRANSPORT_CONNECT_FAILURE,     /**< Initial connection to the server failed. */
+    TLS_TRANSPORT_IN_PROGRESS,         /**< The TLS handshake has not completed yet. */
+    TLS_TRANSPORT_DNS_FAILURE          /**< Resolving the hostname of the server failed. */
 } TlsTransportStatus_t;
 
+/**
+ * @brief Seed the random number generator shared by all TLS connections.
+ *
+ * The generator is seeded only once; later calls return immediately. Calling
+ * this function at startup moves the seeding cost out of the first
+ * #MbedTLS_Connect, which otherwise seeds the generator itself.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, or #TLS_TRANSPORT_INTERNAL_ERROR.
+ */
+TlsTransportStatus_t MbedTLS_Init( void );
+
+/**
+ * @brief Parse the PEM credentials of @p pNetworkCredentials into a store
+ * that can be shared by many connections.
+ *
+ * The root CA is required. The client certificate and private key are parsed
+ * only if both are given.
+ *
+ * @param[out] pCredentialStore Store to initialize.
+ * @param[in] pNetworkCredentials Credentials to parse.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, #TLS_TRANSPORT_INVALID_PARAMETER, or
+ * #TLS_TRANSPORT_INVALID_CREDENTIALS.
+ */
+TlsTransportStatus_t MbedTLS_LoadCredentials( TlsCredentialStore_t * pCredentialStore,
+                                              const NetworkCredentials_t * pNetworkCredentials );
+
+/**
+ * @brief Free the credentials parsed by #MbedTLS_LoadCredentials.
+ *
+ * @param[in] pCredentialStore Store to free.
+ */
+void MbedTLS_FreeCredentials( TlsCredentialStore_t * pCredentialStore );
+
 /**
  * @brief Create a TLS connection with Zephyr sockets.
  *
@@ -143,15 +298,89 @@ typedef enum TlsTransportStatus
  * @param[in] pNetworkCredentials Credentials for the TLS connection.
  * @param[in] receiveTimeoutMs Receive socket timeout.
  * @param[in] sendTimeoutMs Send socket timeout.
+ * @param[in] pSocketsConfig Tuning profile of the socket, or NULL for the
+ * defaults of the network stack.
+ *
+ * @note If a session for the same server is cached from an earlier connection,
+ * an abbreviated handshake resuming it is attempted first. Should that
+ * handshake fail, the cached session is discarded and a full handshake is
+ * performed on a new TCP connection. #TlsTransportParams_t.sessionResumed
+ * reports which of the two succeeded.
  *
  * @return #TLS_TRANSPORT_SUCCESS, #TLS_TRANSPORT_INSUFFICIENT_MEMORY, #TLS_TRANSPORT_INVALID_CREDENTIALS,
- * #TLS_TRANSPORT_HANDSHAKE_FAILED, #TLS_TRANSPORT_INTERNAL_ERROR, or #TLS_TRANSPORT_CONNECT_FAILURE.
+ * #TLS_TRANSPORT_HANDSHAKE_FAILED, #TLS_TRANSPORT_INTERNAL_ERROR, #TLS_TRANSPORT_DNS_FAILURE, or
+ * #TLS_TRANSPORT_CONNECT_FAILURE.
  */
 TlsTransportStatus_t MbedTLS_Connect( NetworkContext_t * pNetworkContext,
                                       const ServerInfo_t * pServerInfo,
                                       const NetworkCredentials_t * pNetworkCredentials,
                                       uint32_t receiveTimeoutMs,
-                                      uint32_t sendTimeoutMs );
+                                      uint32_t sendTimeoutMs,
+                                      const SocketsConfig_t * pSocketsConfig );
+
+/**
+ * @brief Start creating a TLS connection without waiting for the TLS handshake.
+ *
+ * The host name is resolved and the TCP connection is established as by
+ * #MbedTLS_Connect, within SocketsConfig_t.connectTimeoutMs. The handshake
+ * then runs on a non-blocking socket: each call to #MbedTLS_ConnectStep
+ * processes what the server has sent and returns instead of waiting for more.
+ * A single thread can thus establish several connections at once, or serve
+ * other work between the steps of a handshake.
+ *
+ * @param[out] pNetworkContext Network context of the connection.
+ * @param[in] pServerInfo Server connection info.
+ * @param[in] pNetworkCredentials Credentials for the TLS connection.
+ * @param[in] receiveTimeoutMs Receive socket timeout of the established connection.
+ * @param[in] sendTimeoutMs Send socket timeout of the established connection.
+ * @param[in] pSocketsConfig Tuning profile of the socket, or NULL for the
+ * defaults of the network stack.
+ *
+ * @note @p pServerInfo, @p pNetworkCredentials and @p pSocketsConfig must
+ * remain valid until #MbedTLS_ConnectStep no longer returns
+ * #TLS_TRANSPORT_IN_PROGRESS. As with #MbedTLS_Connect, a failed abbreviated
+ * handshake is retried with a full handshake on a new TCP connection, which a
+ * step establishes before returning.
+ *
+ * @return #TLS_TRANSPORT_IN_PROGRESS once the TCP connection is established;
+ * otherwise the same errors as #MbedTLS_Connect.
+ */
+TlsTransportStatus_t MbedTLS_ConnectStart( NetworkContext_t * pNetworkContext,
+                                           const ServerInfo_t * pServerInfo,
+                                           const NetworkCredentials_t * pNetworkCredentials,
+                                           uint32_t receiveTimeoutMs,
+                                           uint32_t sendTimeoutMs,
+                                           const SocketsConfig_t * pSocketsConfig );
+
+/**
+ * @brief Advance the TLS handshake of a connection started with
+ * #MbedTLS_ConnectStart.
+ *
+ * Call this function whenever TlsTransportParams_t.tcpSocket reports the
+ * readiness in TlsConnectOperation_t.pollEvents, for example from a
+ * zsock_poll on the sockets of several connections. The function never waits
+ * for the server. The caller bounds the duration of the handshake, and
+ * abandons a connection that is still in progress with #MbedTLS_Disconnect.
+ *
+ * @param[in] pNetworkContext Network context of the connection.
+ *
+ * @return #TLS_TRANSPORT_IN_PROGRESS while the handshake is not complete;
+ * #TLS_TRANSPORT_SUCCESS once the connection is established, after which it
+ * is used as one returned by #MbedTLS_Connect; #TLS_TRANSPORT_INVALID_PARAMETER
+ * if no connection is in progress; otherwise the same errors as
+ * #MbedTLS_Connect, after which the resources of the connection are released.
+ */
+TlsTransportStatus_t MbedTLS_ConnectStep( NetworkContext_t * pNetworkContext );
+
+/**
+ * @brief Discard every TLS session cached for resumption.
+ *
+ * #MbedTLS_Connect caches the session of each successful connection, keyed by
+ * the host name and port of the server, and offers it on the next connection
+ * to the same server. Call this function when the cached sessions must no
+ * longer be used, such as after the credentials have been rotated.
+ */
+void MbedTLS_ClearSessionCache( void );
 
 /**
  * @brief Gracefully disconnect an established TLS connection.
@@ -170,6 +399,11 @@ SocketStatus_t MbedTLS_Disconnect( NetworkContext_t * pNetworkContext );
  * @param[out] pBuffer Buffer to receive bytes into.
  * @param[in] bytesToRecv Number of bytes to receive from the network.
  *
+ * @note When TlsTransportParams_t.readAhead is configured, a request smaller
+ * than the read-ahead buffer decrypts as much of the current TLS record as fits
+ * into that buffer, and following requests are served from it. Fewer bytes
+ * than @p bytesToRecv may then be returned.
+ *
  * @return Number of bytes (> 0) received if successful;
  * 0 if the socket times out without reading any bytes;
  * negative value on error.
@@ -178,6 +412,21 @@ int32_t MbedTLS_recv( NetworkContext_t * pNetworkContext,
                       void * pBuffer,
                       size_t bytesToRecv );
 
+/**
+ * @brief Check whether data received on a TLS connection is waiting to be read.
+ *
+ * mbed TLS reads whole records from the socket, and the read-ahead buffer
+ * holds decrypted data, so such data may remain even when the socket itself
+ * has nothing left to read. Use this function next to polling the socket when
+ * waiting for incoming data.
+ *
+ * @param[in] pNetworkContext The Network context.
+ *
+ * @return true if #MbedTLS_recv can return data without reading the socket;
+ * false otherwise.
+ */
+bool MbedTLS_HasPendingData( NetworkContext_t * pNetworkContext );
+
 /**
  * @brief Sends data over an established TLS connection.
  *
@@ -196,4 +445,26 @@ int32_t MbedTLS_send( NetworkContext_t * pNetworkContext,
                       const void * pBuffer,
                       size_t bytesToSend );
 
+/**
+ * @brief Sends the data of several buffers over an established TLS connection
+ * in as few TLS records as possible.
+ *
+ * This is the TLS version of the transport interface's
+ * #TransportWritev_t function. Buffers are copied into a single TLS record,
+ * up to the maximum fragment length of the connection, before being written.
+ * Each connection gathers into its own TlsTransportParams_t.writevBuffer, so
+ * concurrent connections do not serialize on a shared buffer.
+ *
+ * @param[in] pNetworkContext The network context.
+ * @param[in] pIoVec Array of buffers to send, in order.
+ * @param[in] ioVecCount Number of buffers in @p pIoVec.
+ *
+ * @return Number of bytes (> 0) sent on success, which may be less than the
+ * total size of the buffers; 0 if the socket times out without sending any
+ * bytes; else a negative value to represent error.
+ */
+int32_t MbedTLS_Writev( NetworkContext_t * pNetworkContext,
+                        TransportOutVector_t * pIoVec,
+                        size_t ioVecCount );
+
 #endif /* ifndef MBEDTLS_ZEPHYR_H */
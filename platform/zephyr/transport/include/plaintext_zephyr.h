@@ -55,6 +55,9 @@
 /* Zephyr Sockets library include. */
 #include "sockets_zephyr.h"
 
+/* Transport metrics include. */
+#include "transport_metrics_zephyr.h"
+
 /**
  * @brief Parameters for the transport-interface
  * implementation that uses plaintext Zephyr sockets.
@@ -62,6 +65,19 @@
 typedef struct PlaintextParams
 {
     int32_t socketDescriptor;
+
+    /**
+     * @brief Optional read-ahead buffer for #Plaintext_Recv. Leave
+     * ReadAheadBuffer_t.pBuffer NULL to read directly from the socket.
+     */
+    ReadAheadBuffer_t readAhead;
+
+    /**
+     * @brief Metrics of the connection. Read them with
+     * #TransportMetrics_Snapshot. They stay zero unless
+     * #TRANSPORT_METRICS_ENABLED is 1.
+     */
+    TransportMetrics_t metrics;
 } PlaintextParams_t;
 
 /**
@@ -71,16 +87,20 @@ typedef struct PlaintextParams
  * @param[in] pServerInfo Server connection info.
  * @param[in] sendTimeout Timeout for socket send.
  * @param[in] recvTimeout Timeout for socket recv.
+ * @param[in] pSocketsConfig Tuning profile of the socket, or NULL for the
+ * defaults of the network stack.
  *
  * @note A timeout of 0 means infinite timeout.
  *
  * @return #SOCKETS_SUCCESS if successful;
- * #SOCKETS_INVALID_PARAMETER, #SOCKETS_DNS_FAILURE, #SOCKETS_CONNECT_FAILURE on error.
+ * #SOCKETS_INVALID_PARAMETER, #SOCKETS_DNS_FAILURE, #SOCKETS_CONNECT_FAILURE,
+ * #SOCKETS_API_ERROR on error.
  */
 SocketStatus_t Plaintext_Connect( NetworkContext_t * pNetworkContext,
                                   const ServerInfo_t * pServerInfo,
                                   uint32_t sendTimeoutMs,
-                                  uint32_t recvTimeoutMs );
+                                  uint32_t recvTimeoutMs,
+                                  const SocketsConfig_t * pSocketsConfig );
 
 /**
  * @brief Close TCP connection to server.
@@ -101,12 +121,30 @@ SocketStatus_t Plaintext_Disconnect( const NetworkContext_t * pNetworkContext );
  * @param[out] pBuffer Buffer to receive network data into.
  * @param[in] bytesToRecv Number of bytes requested from the network.
  *
+ * @note When PlaintextParams_t.readAhead is configured, a request smaller
+ * than the read-ahead buffer reads everything the socket has available into
+ * that buffer, and following requests are served from it. Fewer bytes than
+ * @p bytesToRecv may then be returned.
+ *
  * @return Number of bytes received if successful; negative value on error.
  */
 int32_t Plaintext_Recv( NetworkContext_t * pNetworkContext,
                         void * pBuffer,
                         size_t bytesToRecv );
 
+/**
+ * @brief Check whether #Plaintext_Recv can return data without reading the
+ * socket, because bytes are left in the read-ahead buffer.
+ *
+ * A caller that waits for the socket to become readable must check this
+ * first, as the socket is not readable while the data is buffered.
+ *
+ * @param[in] pNetworkContext The network context created using Plaintext_Connect API.
+ *
+ * @return true if buffered data is available; false otherwise.
+ */
+bool Plaintext_HasPendingData( NetworkContext_t * pNetworkContext );
+
 /**
  * @brief Sends data over an established TCP connection.
  *
@@ -117,10 +155,30 @@ int32_t Plaintext_Recv( NetworkContext_t * pNetworkContext,
  * @param[in] pBuffer Buffer containing the bytes to send over the network.
  * @param[in] bytesToSend Number of bytes to send over the network.
  *
- * @return Number of bytes sent if successful; negative value on error.
+ * @return Number of bytes sent if successful; 0 if the socket is not ready to
+ * send, so that the caller may retry; negative value on error.
  */
 int32_t Plaintext_Send( NetworkContext_t * pNetworkContext,
                         const void * pBuffer,
                         size_t bytesToSend );
 
+/**
+ * @brief Sends the data of several buffers over an established TCP connection
+ * with a single call to the socket.
+ *
+ * This can be used as the #TransportInterface.writev function to send data
+ * over the network.
+ *
+ * @param[in] pNetworkContext The network context created using Plaintext_Connect API.
+ * @param[in] pIoVec Array of buffers to send, in order.
+ * @param[in] ioVecCount Number of buffers in @p pIoVec.
+ *
+ * @return Number of bytes sent if successful, which may be less than the
+ * total size of the buffers; 0 if the socket is not ready to send;
+ * negative value on error.
+ */
+int32_t Plaintext_Writev( NetworkContext_t * pNetworkContext,
+                          TransportOutVector_t * pIoVec,
+                          size_t ioVecCount );
+
 #endif /* ifndef PLAINTEXT_ZEPHYR_H_ */
@@ -23,6 +23,11 @@
 #ifndef SOCKETS_ZEPHYR_H_
 #define SOCKETS_ZEPHYR_H_
 
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 /**************************************************/
 /******* DO NOT CHANGE the following order ********/
 /**************************************************/
@@ -74,6 +79,68 @@ typedef struct ServerInfo
     uint16_t port;          /**< @brief Server port in host-order. */
 } ServerInfo_t;
 
+/**
+ * @brief Tuning profile applied to the socket of a connection.
+ *
+ * Zero-initialize the structure and set the fields to change; a field left at
+ * zero keeps the default of the network stack. Options that the network stack
+ * was built without are skipped with a warning.
+ */
+typedef struct SocketsConfig
+{
+    uint32_t connectTimeoutMs;    /**< @brief Time after which a connection attempt to one address is abandoned; 0 for the default. */
+    bool noDelay;                 /**< @brief Disable Nagle's algorithm (TCP_NODELAY) to send small packets without delay. */
+    int32_t sendBufferSize;       /**< @brief Size of the socket send buffer (SO_SNDBUF). */
+    int32_t recvBufferSize;       /**< @brief Size of the socket receive buffer (SO_RCVBUF). */
+    bool keepAlive;               /**< @brief Enable TCP keepalive probes (SO_KEEPALIVE). */
+    int32_t keepAliveIdleSec;     /**< @brief Idle time before the first keepalive probe (TCP_KEEPIDLE). */
+    int32_t keepAliveIntervalSec; /**< @brief Time between keepalive probes (TCP_KEEPINTVL). */
+    int32_t keepAliveProbeCount;  /**< @brief Number of unanswered probes before the connection is dropped (TCP_KEEPCNT). */
+} SocketsConfig_t;
+
+/**
+ * @brief Function that #Sockets_ConnectWithProtocol calls on each socket it
+ * creates, before connecting it.
+ *
+ * @param[in] tcpSocket The socket descriptor.
+ * @param[in] pContext SocketsProtocol_t.pPrepareContext.
+ *
+ * @return #SOCKETS_SUCCESS to connect the socket; any other status abandons
+ * the connection and is returned by #Sockets_ConnectWithProtocol.
+ */
+typedef SocketStatus_t ( * SocketsPrepareFunc_t )( int32_t tcpSocket,
+                                                   void * pContext );
+
+/**
+ * @brief Protocol of the socket created by #Sockets_ConnectWithProtocol, for
+ * transports that need a socket other than plain TCP, such as a Zephyr TLS
+ * socket.
+ */
+typedef struct SocketsProtocol
+{
+    int32_t protocol;             /**< @brief Protocol passed to zsock_socket, for example IPPROTO_TLS_1_2. */
+    SocketsPrepareFunc_t prepare; /**< @brief Sets the options that must precede zsock_connect, or NULL. */
+    void * pPrepareContext;       /**< @brief Passed to @p prepare. */
+} SocketsProtocol_t;
+
+/**
+ * @brief Optional read-ahead buffer of a transport connection.
+ *
+ * When @p pBuffer is set, reads smaller than @p bufferSize are served from
+ * this buffer, which is refilled with a single read of whatever the connection
+ * has available, up to @p bufferSize bytes. This turns the 1-byte reads that
+ * coreMQTT issues for each packet header into copies from RAM. Set @p pBuffer
+ * to NULL, as zero-initializing the transport parameters does, to read
+ * directly from the connection.
+ */
+typedef struct ReadAheadBuffer
+{
+    uint8_t * pBuffer;  /**< @brief Storage for the buffered bytes, or NULL to disable read-ahead. */
+    size_t bufferSize;  /**< @brief Size of @p pBuffer in bytes. */
+    size_t readIndex;   /**< @brief Offset of the next buffered byte to return. */
+    size_t fillLength;  /**< @brief Number of bytes stored in @p pBuffer. */
+} ReadAheadBuffer_t;
+
 /**
  * @brief Establish a connection to server.
  *
@@ -81,16 +148,51 @@ typedef struct ServerInfo
  * @param[in] pServerInfo Server connection info.
  * @param[in] sendTimeoutMs Timeout for transport send.
  * @param[in] recvTimeoutMs Timeout for transport recv.
+ * @param[in] pSocketsConfig Tuning profile of the socket, or NULL for the
+ * defaults of the network stack.
  *
  * @note A timeout of 0 means infinite timeout.
  *
  * @return #SOCKETS_SUCCESS if successful;
- * #SOCKETS_INVALID_PARAMETER, #SOCKETS_DNS_FAILURE, #SOCKETS_CONNECT_FAILURE on error.
+ * #SOCKETS_INVALID_PARAMETER, #SOCKETS_DNS_FAILURE, #SOCKETS_CONNECT_FAILURE,
+ * #SOCKETS_API_ERROR on error.
  */
 SocketStatus_t Sockets_Connect( int32_t * pTcpSocket,
                                 const ServerInfo_t * pServerInfo,
                                 uint32_t sendTimeoutMs,
-                                uint32_t recvTimeoutMs );
+                                uint32_t recvTimeoutMs,
+                                const SocketsConfig_t * pSocketsConfig );
+
+/**
+ * @brief Establish a connection to server with a socket of the given protocol.
+ *
+ * This behaves as #Sockets_Connect, except that the socket is created with
+ * SocketsProtocol_t.protocol and prepared with SocketsProtocol_t.prepare
+ * before it connects. As protocols such as TLS complete their handshake within
+ * zsock_connect, the resolved addresses are tried one at a time with blocking
+ * connects rather than in parallel.
+ *
+ * @param[out] pTcpSocket The output parameter to return the created socket descriptor.
+ * @param[in] pServerInfo Server connection info.
+ * @param[in] sendTimeoutMs Timeout for transport send.
+ * @param[in] recvTimeoutMs Timeout for transport recv.
+ * @param[in] pSocketsConfig Tuning profile of the socket, or NULL for the
+ * defaults of the network stack.
+ * @param[in] pProtocol Protocol of the socket, or NULL for TCP as with
+ * #Sockets_Connect.
+ *
+ * @note A timeout of 0 means infinite timeout.
+ *
+ * @return #SOCKETS_SUCCESS if successful;
+ * #SOCKETS_INVALID_PARAMETER, #SOCKETS_DNS_FAILURE, #SOCKETS_CONNECT_FAILURE,
+ * #SOCKETS_API_ERROR, or the status returned by SocketsProtocol_t.prepare on error.
+ */
+SocketStatus_t Sockets_ConnectWithProtocol( int32_t * pTcpSocket,
+                                            const ServerInfo_t * pServerInfo,
+                                            uint32_t sendTimeoutMs,
+                                            uint32_t recvTimeoutMs,
+                                            const SocketsConfig_t * pSocketsConfig,
+                                            const SocketsProtocol_t * pProtocol );
 
 /**
  * @brief End connection to server.
@@ -101,4 +203,80 @@ SocketStatus_t Sockets_Connect( int32_t * pTcpSocket,
  */
 SocketStatus_t Sockets_Disconnect( int32_t tcpSocket );
 
+/**
+ * @brief Switch a socket between blocking and non-blocking mode.
+ *
+ * The sockets returned by #Sockets_Connect are blocking, and their send and
+ * receive calls wait for up to the timeouts of the connection. In
+ * non-blocking mode these calls fail with EAGAIN instead of waiting.
+ *
+ * @param[in] tcpSocket The socket descriptor.
+ * @param[in] blocking true for blocking mode; false for non-blocking mode.
+ *
+ * @return #SOCKETS_SUCCESS if successful; #SOCKETS_INVALID_PARAMETER or
+ * #SOCKETS_API_ERROR on error.
+ */
+SocketStatus_t Sockets_SetBlocking( int32_t tcpSocket,
+                                    bool blocking );
+
+/**
+ * @brief Discard the cached addresses of a host name.
+ *
+ * #Sockets_Connect reuses the addresses a host name resolved to, and a recent
+ * failure to resolve it, for a limited time. A cached entry is discarded
+ * automatically when no cached address accepts the connection. Call this
+ * function when the addresses are known to have changed.
+ *
+ * @param[in] pHostName Host name to discard, or NULL to discard every host name.
+ * @param[in] hostNameLength Length of @p pHostName.
+ */
+void Sockets_InvalidateDnsCache( const char * pHostName,
+                                 size_t hostNameLength );
+
+/**
+ * @brief Discard the bytes stored in a read-ahead buffer.
+ *
+ * Transports call this when a connection is established so that no data of a
+ * previous connection is returned.
+ *
+ * @param[in] pReadAhead The read-ahead buffer.
+ */
+void Sockets_ReadAheadReset( ReadAheadBuffer_t * pReadAhead );
+
+/**
+ * @brief Check whether a read should refill the read-ahead buffer instead of
+ * reading directly into the caller's buffer.
+ *
+ * @param[in] pReadAhead The read-ahead buffer.
+ * @param[in] bytesToRecv Number of bytes requested by the caller.
+ *
+ * @return true if read-ahead is enabled and @p bytesToRecv is smaller than
+ * the buffer; false otherwise.
+ */
+bool Sockets_ReadAheadShouldFill( const ReadAheadBuffer_t * pReadAhead,
+                                  size_t bytesToRecv );
+
+/**
+ * @brief Get the number of bytes stored in a read-ahead buffer that have not
+ * been returned yet.
+ *
+ * @param[in] pReadAhead The read-ahead buffer.
+ *
+ * @return Number of buffered bytes.
+ */
+size_t Sockets_ReadAheadPending( const ReadAheadBuffer_t * pReadAhead );
+
+/**
+ * @brief Copy buffered bytes out of a read-ahead buffer.
+ *
+ * @param[in] pReadAhead The read-ahead buffer.
+ * @param[out] pBuffer Buffer to copy the bytes into.
+ * @param[in] bytesToRecv Maximum number of bytes to copy.
+ *
+ * @return Number of bytes copied, which is 0 when the buffer is empty.
+ */
+size_t Sockets_ReadAheadCopy( ReadAheadBuffer_t * pReadAhead,
+                              void * pBuffer,
+                              size_t bytesToRecv );
+
 #endif /* ifndef SOCKETS_ZEPHYR_H_ */
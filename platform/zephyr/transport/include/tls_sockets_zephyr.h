@@ -0,0 +1,249 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file tls_sockets_zephyr.h
+ * @brief TLS transport interface header for Zephyr TLS sockets.
+ *
+ * This transport leaves TLS to the network stack: the connection is a Zephyr
+ * socket of protocol IPPROTO_TLS_1_2, which performs the handshake within
+ * zsock_connect and encrypts and decrypts the data passed to zsock_send and
+ * zsock_recv. The certificates and keys are registered once with
+ * #TlsSockets_AddCredential and are referenced by their security tags, so no
+ * connection parses or stores its own copy of them. On targets whose network
+ * driver offloads sockets (CONFIG_NET_SOCKETS_OFFLOAD) and supports TLS, the
+ * whole TLS session runs on the network co-processor.
+ *
+ * The network stack must be built with CONFIG_NET_SOCKETS_SOCKOPT_TLS.
+ */
+
+#ifndef TLS_SOCKETS_ZEPHYR_H_
+#define TLS_SOCKETS_ZEPHYR_H_
+
+/**************************************************/
+/******* DO NOT CHANGE the following order ********/
+/**************************************************/
+
+/* Logging related header files are required to be included in the following order:
+ * 1. Include the header file "logging_levels.h".
+ * 2. Define LIBRARY_LOG_NAME and  LIBRARY_LOG_LEVEL.
+ * 3. Include the header file "logging_stack.h".
+ */
+
+/* Include header that defines log levels. */
+#include "logging_levels.h"
+
+/* Logging configuration for the transport interface implementation which uses
+ * Zephyr TLS sockets. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "Transport_TLS_Sockets"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_ERROR
+#endif
+
+#include "logging_stack.h"
+
+/************ End of logging configuration ****************/
+
+/* Transport includes. */
+#include "transport_interface.h"
+
+/* Zephyr Sockets library include. */
+#include "sockets_zephyr.h"
+
+/* Zephyr TLS credentials include. */
+#include <net/tls_credentials.h>
+
+/**
+ * @brief Parameters for the transport-interface implementation that uses
+ * Zephyr TLS sockets.
+ */
+typedef struct TlsSocketsParams
+{
+    int32_t socketDescriptor;
+} TlsSocketsParams_t;
+
+/**
+ * @brief Contains the credentials necessary for TLS connection setup.
+ */
+typedef struct TlsSocketsCredentials
+{
+    /**
+     * @brief Security tags of the credentials to use, as registered with
+     * #TlsSockets_AddCredential. The tags usually hold the root CA of the
+     * server and, for mutual authentication, the client certificate and key.
+     */
+    const sec_tag_t * pSecTags;
+    size_t secTagCount; /**< @brief Number of tags in #TlsSocketsCredentials.pSecTags. */
+
+    /**
+     * @brief To use ALPN, set this to a NULL-terminated list of supported
+     * protocols in decreasing order of preference.
+     */
+    const char ** pAlpnProtos;
+
+    /**
+     * @brief Disable server name indication (SNI) for a TLS session.
+     */
+    bool disableSni;
+} TlsSocketsCredentials_t;
+
+/**
+ * @brief TLS Connect / Disconnect return status.
+ */
+typedef enum TlsSocketsStatus
+{
+    TLS_SOCKETS_SUCCESS = 0,         /**< Function successfully completed. */
+    TLS_SOCKETS_INVALID_PARAMETER,   /**< At least one parameter was invalid. */
+    TLS_SOCKETS_INVALID_CREDENTIALS, /**< A credential could not be registered. */
+    TLS_SOCKETS_DNS_FAILURE,         /**< Resolving hostname of server failed. */
+    TLS_SOCKETS_INTERNAL_ERROR,      /**< A call to a system API resulted in an internal error. */
+    TLS_SOCKETS_CONNECT_FAILURE      /**< The TCP connection or the TLS handshake with the server failed. */
+} TlsSocketsStatus_t;
+
+/**
+ * @brief Register a certificate or key with the network stack under a
+ * security tag.
+ *
+ * Register each credential once, typically at startup; every connection that
+ * lists the tag in TlsSocketsCredentials_t.pSecTags then uses it. Registering
+ * the same type under the same tag again succeeds without replacing it.
+ *
+ * @param[in] secTag Security tag to register the credential under.
+ * @param[in] type Type of the credential, such as TLS_CREDENTIAL_CA_CERTIFICATE
+ * for a root CA, or TLS_CREDENTIAL_SERVER_CERTIFICATE and
+ * TLS_CREDENTIAL_PRIVATE_KEY for the certificate and key of the device.
+ * @param[in] pCredential The credential. PEM credentials must include the
+ * terminating NULL character.
+ * @param[in] credentialLength Length of @p pCredential, including the
+ * terminating NULL character of PEM credentials.
+ *
+ * @note The network stack does not copy the credential, so @p pCredential
+ * must remain valid for as long as connections use the tag.
+ *
+ * @note Offloading network drivers may keep credentials in storage of their
+ * own that must be provisioned with the tools of the vendor instead.
+ *
+ * @return #TLS_SOCKETS_SUCCESS if successful; #TLS_SOCKETS_INVALID_PARAMETER
+ * or #TLS_SOCKETS_INVALID_CREDENTIALS on error.
+ */
+TlsSocketsStatus_t TlsSockets_AddCredential( sec_tag_t secTag,
+                                             enum tls_credential_type type,
+                                             const void * pCredential,
+                                             size_t credentialLength );
+
+/**
+ * @brief Create a TLS connection with a Zephyr TLS socket.
+ *
+ * The server certificate is always verified against the CA certificates of
+ * the listed tags.
+ *
+ * @param[out] pNetworkContext Pointer to a network context to contain the
+ * initialized socket handle.
+ * @param[in] pServerInfo Server connection info.
+ * @param[in] pCredentials Credentials for the TLS connection.
+ * @param[in] receiveTimeoutMs Receive socket timeout.
+ * @param[in] sendTimeoutMs Send socket timeout.
+ * @param[in] pSocketsConfig Tuning profile of the socket, or NULL for the
+ * defaults of the network stack.
+ *
+ * @note A timeout of 0 means infinite timeout.
+ *
+ * @return #TLS_SOCKETS_SUCCESS, #TLS_SOCKETS_INVALID_PARAMETER,
+ * #TLS_SOCKETS_DNS_FAILURE, #TLS_SOCKETS_INTERNAL_ERROR, or
+ * #TLS_SOCKETS_CONNECT_FAILURE.
+ */
+TlsSocketsStatus_t TlsSockets_Connect( NetworkContext_t * pNetworkContext,
+                                       const ServerInfo_t * pServerInfo,
+                                       const TlsSocketsCredentials_t * pCredentials,
+                                       uint32_t receiveTimeoutMs,
+                                       uint32_t sendTimeoutMs,
+                                       const SocketsConfig_t * pSocketsConfig );
+
+/**
+ * @brief Close a TLS connection.
+ *
+ * The network stack sends the TLS close notification before closing the
+ * TCP connection.
+ *
+ * @param[in] pNetworkContext The network context to close the connection.
+ *
+ * @return #SOCKETS_SUCCESS if successful; #SOCKETS_INVALID_PARAMETER on error.
+ */
+SocketStatus_t TlsSockets_Disconnect( const NetworkContext_t * pNetworkContext );
+
+/**
+ * @brief Receives data from an established TLS connection.
+ *
+ * This can be used as #TransportInterface.recv function to receive data over
+ * the network.
+ *
+ * @param[in] pNetworkContext The network context created using TlsSockets_Connect API.
+ * @param[out] pBuffer Buffer to receive network data into.
+ * @param[in] bytesToRecv Number of bytes requested from the network.
+ *
+ * @return Number of bytes (> 0) received if successful;
+ * 0 if no data is available or the socket times out;
+ * negative value on error.
+ */
+int32_t TlsSockets_Recv( NetworkContext_t * pNetworkContext,
+                         void * pBuffer,
+                         size_t bytesToRecv );
+
+/**
+ * @brief Sends data over an established TLS connection.
+ *
+ * This can be used as the #TransportInterface.send function to send data
+ * over the network.
+ *
+ * @param[in] pNetworkContext The network context created using TlsSockets_Connect API.
+ * @param[in] pBuffer Buffer containing the bytes to send over the network.
+ * @param[in] bytesToSend Number of bytes to send over the network.
+ *
+ * @return Number of bytes sent if successful; 0 if the socket is not ready
+ * to send; negative value on error.
+ */
+int32_t TlsSockets_Send( NetworkContext_t * pNetworkContext,
+                         const void * pBuffer,
+                         size_t bytesToSend );
+
+/**
+ * @brief Sends the data of several buffers over an established TLS connection
+ * with a single call to the socket.
+ *
+ * This can be used as the #TransportInterface.writev function to send data
+ * over the network.
+ *
+ * @param[in] pNetworkContext The network context created using TlsSockets_Connect API.
+ * @param[in] pIoVec Array of buffers to send, in order.
+ * @param[in] ioVecCount Number of buffers in @p pIoVec.
+ *
+ * @return Number of bytes sent if successful, which may be less than the
+ * total size of the buffers; 0 if the socket is not ready to send;
+ * negative value on error.
+ */
+int32_t TlsSockets_Writev( NetworkContext_t * pNetworkContext,
+                           TransportOutVector_t * pIoVec,
+                           size_t ioVecCount );
+
+#endif /* ifndef TLS_SOCKETS_ZEPHYR_H_ */
@@ -0,0 +1,163 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file transport_metrics_zephyr.h
+ * @brief Optional counters and latency histograms of a transport connection.
+ */
+
+#ifndef TRANSPORT_METRICS_ZEPHYR_H_
+#define TRANSPORT_METRICS_ZEPHYR_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Set to 1 to collect the metrics of each transport connection. With
+ * the default of 0, the metrics of every connection stay zero and collecting
+ * them costs nothing.
+ */
+#ifndef TRANSPORT_METRICS_ENABLED
+    #define TRANSPORT_METRICS_ENABLED    ( 0 )
+#endif
+
+/**
+ * @brief Number of buckets of a latency histogram.
+ */
+#ifndef TRANSPORT_METRICS_HISTOGRAM_BUCKETS
+    #define TRANSPORT_METRICS_HISTOGRAM_BUCKETS    ( 16U )
+#endif
+
+/**
+ * @brief Upper bound, in microseconds, of the first bucket of a latency
+ * histogram.
+ *
+ * Bucket 0 counts calls that took less than this bound, and each following
+ * bucket doubles it. The last bucket counts every longer call. The defaults
+ * span 100 us to 1.6 s.
+ */
+#ifndef TRANSPORT_METRICS_HISTOGRAM_BASE_US
+    #define TRANSPORT_METRICS_HISTOGRAM_BASE_US    ( 100U )
+#endif
+
+/**
+ * @brief Coarse, logarithmic histogram of the duration of transport calls.
+ */
+typedef struct TransportLatencyHistogram
+{
+    uint32_t buckets[ TRANSPORT_METRICS_HISTOGRAM_BUCKETS ]; /**< @brief Number of calls per duration range. */
+    uint32_t maxUs;                                          /**< @brief Longest call, in microseconds. */
+} TransportLatencyHistogram_t;
+
+/**
+ * @brief Metrics of a transport connection.
+ *
+ * The metrics accumulate across the connections made with the same transport
+ * parameters, until they are reset with #TransportMetrics_Snapshot.
+ */
+typedef struct TransportMetrics
+{
+    uint64_t bytesReceived;                  /**< @brief Bytes returned by the receive function. */
+    uint64_t bytesSent;                      /**< @brief Bytes accepted by the send functions. */
+    uint32_t recvCalls;                      /**< @brief Calls to the receive function. */
+    uint32_t sendCalls;                      /**< @brief Calls to the send functions. */
+    uint32_t recvRetries;                    /**< @brief Receive calls that returned 0 bytes, for the caller to retry. */
+    uint32_t sendRetries;                    /**< @brief Send calls that returned 0 bytes, for the caller to retry. */
+    uint32_t recvErrors;                     /**< @brief Receive calls that failed. */
+    uint32_t sendErrors;                     /**< @brief Send calls that failed. */
+    uint32_t pollCalls;                      /**< @brief Calls to zsock_poll made by the transport. */
+    uint32_t pollTimeouts;                   /**< @brief Calls to zsock_poll that found the socket not ready. */
+    uint32_t recordsRead;                    /**< @brief TLS records of application data read; 0 for plaintext connections. */
+    uint32_t recordsWritten;                 /**< @brief TLS records of application data written; 0 for plaintext connections. */
+    TransportLatencyHistogram_t recvLatency; /**< @brief Duration of the receive calls. */
+    TransportLatencyHistogram_t sendLatency; /**< @brief Duration of the send calls. */
+} TransportMetrics_t;
+
+/**
+ * @brief Get the time at which a transport call starts, to pass to
+ * #TransportMetrics_RecordRecv or #TransportMetrics_RecordSend.
+ *
+ * @return The hardware cycle counter, or 0 when #TRANSPORT_METRICS_ENABLED
+ * is 0.
+ */
+uint32_t TransportMetrics_Now( void );
+
+/**
+ * @brief Account a call to the receive function of a transport.
+ *
+ * @param[in] pMetrics Metrics of the connection.
+ * @param[in] result Value returned by the receive function.
+ * @param[in] startCycles Value of #TransportMetrics_Now when the call started.
+ */
+void TransportMetrics_RecordRecv( TransportMetrics_t * pMetrics,
+                                  int32_t result,
+                                  uint32_t startCycles );
+
+/**
+ * @brief Account a call to a send function of a transport.
+ *
+ * @param[in] pMetrics Metrics of the connection.
+ * @param[in] result Value returned by the send function.
+ * @param[in] startCycles Value of #TransportMetrics_Now when the call started.
+ */
+void TransportMetrics_RecordSend( TransportMetrics_t * pMetrics,
+                                  int32_t result,
+                                  uint32_t startCycles );
+
+/**
+ * @brief Account a call to zsock_poll made by a transport.
+ *
+ * @param[in] pMetrics Metrics of the connection.
+ * @param[in] pollStatus Value returned by zsock_poll.
+ */
+void TransportMetrics_RecordPoll( TransportMetrics_t * pMetrics,
+                                  int32_t pollStatus );
+
+/**
+ * @brief Account TLS records of application data.
+ *
+ * @param[in] pMetrics Metrics of the connection.
+ * @param[in] recordsRead Number of records read.
+ * @param[in] recordsWritten Number of records written.
+ */
+void TransportMetrics_RecordTlsRecords( TransportMetrics_t * pMetrics,
+                                        uint32_t recordsRead,
+                                        uint32_t recordsWritten );
+
+/**
+ * @brief Copy the metrics of a connection consistently with the transport
+ * calls running concurrently, and optionally reset them.
+ *
+ * Resetting when taking each snapshot yields the metrics of the interval since
+ * the previous snapshot, suited to periodic reporting.
+ *
+ * @param[in] pMetrics Metrics of the connection.
+ * @param[out] pSnapshot Copy of the metrics. All zero when
+ * #TRANSPORT_METRICS_ENABLED is 0.
+ * @param[in] reset Whether to reset @p pMetrics once copied.
+ */
+void TransportMetrics_Snapshot( TransportMetrics_t * pMetrics,
+                                TransportMetrics_t * pSnapshot,
+                                bool reset );
+
+#endif /* ifndef TRANSPORT_METRICS_ZEPHYR_H_ */
@@ -0,0 +1,368 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file mbedtls_arena_zephyr.c
+ * @brief Allocator that serves mbed TLS from a static arena and accounts the
+ * memory used by each connection.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Zephyr includes. */
+#include <kernel.h>
+#include <init.h>
+
+/* Include header that defines log levels. */
+#include "logging_levels.h"
+
+/* Logging configuration for the mbed TLS arena. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "MbedTLSArena"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_ERROR
+#endif
+
+#include "logging_stack.h"
+
+#include "mbedtls_arena_zephyr.h"
+
+#if ( MBEDTLS_ZEPHYR_ARENA_SIZE > 0U )
+
+/* mbed TLS includes. */
+    #include <mbedtls/platform.h>
+
+    #if !defined( MBEDTLS_PLATFORM_MEMORY )
+        #error "MBEDTLS_ZEPHYR_ARENA_SIZE requires mbed TLS to be built with MBEDTLS_PLATFORM_MEMORY."
+    #endif
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Header stored in front of each allocation.
+ *
+ * Its size is a multiple of 8 bytes on 32-bit and 64-bit targets, so the
+ * memory returned after it keeps the alignment of the heap.
+ */
+    typedef struct ArenaBlockHeader
+    {
+        size_t size;                  /**< @brief Size of the allocation, without the header. */
+        MbedTLSArenaUsage_t * pOwner; /**< @brief Connection the allocation is attributed to, or NULL. */
+    } ArenaBlockHeader_t;
+
+/**
+ * @brief Usage record that a thread attributes its allocations to.
+ */
+    typedef struct ArenaOwner
+    {
+        k_tid_t thread;               /**< @brief The thread, or NULL if the slot is free. */
+        MbedTLSArenaUsage_t * pUsage; /**< @brief Usage record of the thread. */
+    } ArenaOwner_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The arena.
+ */
+    K_HEAP_DEFINE( mbedtlsArena, MBEDTLS_ZEPHYR_ARENA_SIZE );
+
+/**
+ * @brief Usage of the whole arena.
+ */
+    static MbedTLSArenaUsage_t arenaUsage;
+
+/**
+ * @brief Threads currently attributing their allocations to a connection.
+ */
+    static ArenaOwner_t arenaOwners[ MBEDTLS_ZEPHYR_ARENA_MAX_OWNERS ];
+
+/**
+ * @brief Mutex protecting #arenaUsage, #arenaOwners and the usage records.
+ */
+    K_MUTEX_DEFINE( arenaMutex );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Find the usage record of the calling thread.
+ *
+ * @note #arenaMutex must be held by the caller.
+ *
+ * @return The usage record; NULL if the thread has none.
+ */
+    static MbedTLSArenaUsage_t * findOwner( void );
+
+/**
+ * @brief Add an allocation to a usage record.
+ *
+ * @param[in] pUsage The usage record.
+ * @param[in] size Size of the allocation.
+ */
+    static void addUsage( MbedTLSArenaUsage_t * pUsage,
+                          size_t size );
+
+/**
+ * @brief Remove an allocation from a usage record.
+ *
+ * @param[in] pUsage The usage record.
+ * @param[in] size Size of the allocation.
+ */
+    static void removeUsage( MbedTLSArenaUsage_t * pUsage,
+                             size_t size );
+
+/**
+ * @brief Allocate zeroed memory from the arena, as mbed TLS requires of its
+ * calloc function.
+ *
+ * @param[in] count Number of elements.
+ * @param[in] size Size of each element.
+ *
+ * @return The memory; NULL if the arena is exhausted.
+ */
+    static void * arenaCalloc( size_t count,
+                               size_t size );
+
+/**
+ * @brief Return memory allocated by #arenaCalloc to the arena.
+ *
+ * @param[in] pMemory The memory, or NULL.
+ */
+    static void arenaFree( void * pMemory );
+
+/**
+ * @brief Install the arena as the allocator of mbed TLS.
+ *
+ * This runs when the system starts, before the application can use mbed TLS,
+ * so that no memory from the default allocator is ever freed into the arena.
+ *
+ * @param[in] pDevice Unused.
+ *
+ * @return 0 if successful; -1 otherwise.
+ */
+    static int arenaInit( const struct device * pDevice );
+
+/*-----------------------------------------------------------*/
+
+    static MbedTLSArenaUsage_t * findOwner( void )
+    {
+        MbedTLSArenaUsage_t * pUsage = NULL;
+        k_tid_t thread = k_current_get();
+        size_t index = 0U;
+
+        for( index = 0U; index < MBEDTLS_ZEPHYR_ARENA_MAX_OWNERS; index++ )
+        {
+            if( arenaOwners[ index ].thread == thread )
+            {
+                pUsage = arenaOwners[ index ].pUsage;
+                break;
+            }
+        }
+
+        return pUsage;
+    }
+/*-----------------------------------------------------------*/
+
+    static void addUsage( MbedTLSArenaUsage_t * pUsage,
+                          size_t size )
+    {
+        pUsage->currentBytes += size;
+
+        if( pUsage->currentBytes > pUsage->peakBytes )
+        {
+            pUsage->peakBytes = pUsage->currentBytes;
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static void removeUsage( MbedTLSArenaUsage_t * pUsage,
+                             size_t size )
+    {
+        /* A record reset while its memory was allocated must not wrap. */
+        pUsage->currentBytes = ( pUsage->currentBytes > size ) ? ( pUsage->currentBytes - size ) : 0U;
+    }
+/*-----------------------------------------------------------*/
+
+    static void * arenaCalloc( size_t count,
+                               size_t size )
+    {
+        ArenaBlockHeader_t * pHeader = NULL;
+        void * pMemory = NULL;
+        size_t length = 0U;
+
+        if( ( count > 0U ) && ( size > 0U ) &&
+            ( count <= ( ( SIZE_MAX - sizeof( ArenaBlockHeader_t ) ) / size ) ) )
+        {
+            length = count * size;
+            pHeader = k_heap_alloc( &mbedtlsArena, sizeof( ArenaBlockHeader_t ) + length, K_NO_WAIT );
+
+            if( pHeader == NULL )
+            {
+                LogWarn( ( "mbed TLS arena exhausted: Requested=%u, InUse=%u, Size=%u.",
+                           ( unsigned int ) length,
+                           ( unsigned int ) arenaUsage.currentBytes,
+                           ( unsigned int ) MBEDTLS_ZEPHYR_ARENA_SIZE ) );
+            }
+        }
+
+        if( pHeader != NULL )
+        {
+            pMemory = &( pHeader[ 1 ] );
+            ( void ) memset( pMemory, 0, length );
+            pHeader->size = length;
+
+            ( void ) k_mutex_lock( &arenaMutex, K_FOREVER );
+
+            pHeader->pOwner = findOwner();
+            addUsage( &arenaUsage, length );
+
+            if( pHeader->pOwner != NULL )
+            {
+                addUsage( pHeader->pOwner, length );
+            }
+
+            ( void ) k_mutex_unlock( &arenaMutex );
+        }
+
+        return pMemory;
+    }
+/*-----------------------------------------------------------*/
+
+    static void arenaFree( void * pMemory )
+    {
+        ArenaBlockHeader_t * pHeader = NULL;
+
+        if( pMemory != NULL )
+        {
+            pHeader = &( ( ( ArenaBlockHeader_t * ) pMemory )[ -1 ] );
+
+            ( void ) k_mutex_lock( &arenaMutex, K_FOREVER );
+
+            removeUsage( &arenaUsage, pHeader->size );
+
+            if( pHeader->pOwner != NULL )
+            {
+                removeUsage( pHeader->pOwner, pHeader->size );
+            }
+
+            ( void ) k_mutex_unlock( &arenaMutex );
+
+            k_heap_free( &mbedtlsArena, pHeader );
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static int arenaInit( const struct device * pDevice )
+    {
+        int returnStatus = 0;
+
+        ( void ) pDevice;
+
+        if( mbedtls_platform_set_calloc_free( arenaCalloc, arenaFree ) != 0 )
+        {
+            LogError( ( "Failed to install the mbed TLS arena allocator." ) );
+            returnStatus = -1;
+        }
+
+        return returnStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    SYS_INIT( arenaInit, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY );
+
+#endif /* if ( MBEDTLS_ZEPHYR_ARENA_SIZE > 0U ) */
+
+/*-----------------------------------------------------------*/
+
+void MbedTLSArena_SetOwner( MbedTLSArenaUsage_t * pUsage )
+{
+    #if ( MBEDTLS_ZEPHYR_ARENA_SIZE > 0U )
+        k_tid_t thread = k_current_get();
+        ArenaOwner_t * pSlot = NULL;
+        size_t index = 0U;
+
+        ( void ) k_mutex_lock( &arenaMutex, K_FOREVER );
+
+        /* Use the slot of the thread, or else a free one. */
+        for( index = 0U; index < MBEDTLS_ZEPHYR_ARENA_MAX_OWNERS; index++ )
+        {
+            if( arenaOwners[ index ].thread == thread )
+            {
+                pSlot = &( arenaOwners[ index ] );
+                break;
+            }
+            else if( ( pSlot == NULL ) && ( arenaOwners[ index ].thread == NULL ) )
+            {
+                pSlot = &( arenaOwners[ index ] );
+            }
+            else
+            {
+                /* Empty else marker. */
+            }
+        }
+
+        if( pUsage == NULL )
+        {
+            if( ( pSlot != NULL ) && ( pSlot->thread == thread ) )
+            {
+                pSlot->thread = NULL;
+                pSlot->pUsage = NULL;
+            }
+        }
+        else if( pSlot != NULL )
+        {
+            pSlot->thread = thread;
+            pSlot->pUsage = pUsage;
+        }
+        else
+        {
+            LogWarn( ( "No free slot to attribute mbed TLS memory; "
+                       "increase MBEDTLS_ZEPHYR_ARENA_MAX_OWNERS." ) );
+        }
+
+        ( void ) k_mutex_unlock( &arenaMutex );
+    #else /* if ( MBEDTLS_ZEPHYR_ARENA_SIZE > 0U ) */
+        ( void ) pUsage;
+    #endif /* if ( MBEDTLS_ZEPHYR_ARENA_SIZE > 0U ) */
+}
+/*-----------------------------------------------------------*/
+
+void MbedTLSArena_GetUsage( const MbedTLSArenaUsage_t * pUsage,
+                            MbedTLSArenaUsage_t * pSnapshot )
+{
+    assert( pSnapshot != NULL );
+
+    #if ( MBEDTLS_ZEPHYR_ARENA_SIZE > 0U )
+        ( void ) k_mutex_lock( &arenaMutex, K_FOREVER );
+
+        *pSnapshot = ( pUsage != NULL ) ? *pUsage : arenaUsage;
+
+        ( void ) k_mutex_unlock( &arenaMutex );
+    #else
+        ( void ) pUsage;
+        ( void ) memset( pSnapshot, 0, sizeof( MbedTLSArenaUsage_t ) );
+    #endif
+}
+/*-----------------------------------------------------------*/
@@ -29,13 +29,16 @@
 /* Standard includes. */
 #include <assert.h>
 #include <string.h>
+#include <errno.h>
 
 /* Zephyr includes. */
+#include <kernel.h>
 #include <net/socket.h>
 #include <random/rand32.h>
 
 /* mbed TLS includes. */
 #include <mbedtls/error.h>
+#include <mbedtls/platform_util.h>
 
 /* TLS transport header. */
 #include "mbedtls_zephyr.h"
@@ -87,6 +90,81 @@ static const char * pNoLowLevelMbedTlsCodeStr = "<No-Low-Level-Code>";
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Number of servers for which a TLS session is cached for resumption.
+ *
+ * When the cache is full, the least recently used entry is replaced.
+ */
+#ifndef MBEDTLS_ZEPHYR_SESSION_CACHE_SIZE
+    #define MBEDTLS_ZEPHYR_SESSION_CACHE_SIZE    ( 2U )
+#endif
+
+/**
+ * @brief Maximum length of a host name that can be used as a session cache key.
+ *
+ * Sessions of servers with longer host names are not cached.
+ */
+#ifndef MBEDTLS_ZEPHYR_SESSION_CACHE_HOSTNAME_LENGTH
+    #define MBEDTLS_ZEPHYR_SESSION_CACHE_HOSTNAME_LENGTH    ( 128U )
+#endif
+
+/**
+ * @brief A TLS session cached for a single server.
+ */
+typedef struct SessionCacheEntry
+{
+    char hostName[ MBEDTLS_ZEPHYR_SESSION_CACHE_HOSTNAME_LENGTH ]; /**< @brief Host name of the server, not NULL terminated. */
+    size_t hostNameLength;                                         /**< @brief Length of #SessionCacheEntry.hostName. */
+    uint16_t port;                                                 /**< @brief Port of the server. */
+    bool valid;                                                    /**< @brief Whether #SessionCacheEntry.session is usable. */
+    uint32_t lastUsed;                                             /**< @brief Value of #sessionCacheUseCount when last used. */
+    mbedtls_ssl_session session;                                   /**< @brief Session ID, ticket and master secret. */
+} SessionCacheEntry_t;
+
+/**
+ * @brief Sessions of earlier connections, available for resumption.
+ */
+static SessionCacheEntry_t sessionCache[ MBEDTLS_ZEPHYR_SESSION_CACHE_SIZE ];
+
+/**
+ * @brief Counter incremented on every cache access, used for LRU replacement.
+ */
+static uint32_t sessionCacheUseCount = 0U;
+
+/**
+ * @brief Mutex protecting #sessionCache from concurrent connections.
+ */
+K_MUTEX_DEFINE( sessionCacheMutex );
+
+/**
+ * @brief Usage record of the mbed TLS memory held by #sessionCache, which
+ * outlives the connections that stored the sessions.
+ */
+static MbedTLSArenaUsage_t sessionCacheUsage;
+
+/**
+ * @brief Entropy context shared by all TLS connections.
+ */
+static mbedtls_entropy_context entropyContext;
+
+/**
+ * @brief CTR DRBG context shared by all TLS connections.
+ */
+static mbedtls_ctr_drbg_context ctrDrbgContext;
+
+/**
+ * @brief Whether #ctrDrbgContext has been seeded.
+ */
+static bool randomInitialized = false;
+
+/**
+ * @brief Mutex serializing the use of #ctrDrbgContext, which mbed TLS does not
+ * protect itself.
+ */
+K_MUTEX_DEFINE( randomMutex );
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Sends data over TCP socket.
  *
@@ -135,6 +213,21 @@ static int mbedtls_platform_entropy_poll( void * data,
                                           size_t len,
                                           size_t * olen );
 
+/**
+ * @brief Generate random bytes from the shared CTR DRBG.
+ *
+ * This is the RNG function supplied to mbedTLS by every connection.
+ *
+ * @param[in] pContext Callback context; unused.
+ * @param[out] pOutput Buffer that receives the random bytes.
+ * @param[in] outputLength Number of random bytes to generate.
+ *
+ * @return 0 on success; otherwise, an mbedTLS CTR DRBG error.
+ */
+static int mbedtls_platform_random( void * pContext,
+                                    unsigned char * pOutput,
+                                    size_t outputLength );
+
 /**
  * @brief Initialize the mbed TLS structures in a network connection.
  *
@@ -150,45 +243,41 @@ static void sslContextInit( SSLContext_t * pSslContext );
 static void sslContextFree( SSLContext_t * pSslContext );
 
 /**
- * @brief Add X509 certificate to the trusted list of root certificates.
+ * @brief Parse the trusted server root CA certificate.
  *
- * OpenSSL does not provide a single function for reading and loading certificates
- * from files into stores, so the file API must be called. Start with the
- * root certificate.
- *
- * @param[out] pSslContext SSL context to which the trusted server root CA is to be added.
+ * @param[out] pRootCaChain Certificate chain into which the root CA is parsed.
  * @param[in] pRootCa PEM-encoded string of the trusted server root CA.
  * @param[in] rootCaSize Size of the trusted server root CA.
  *
  * @return 0 on success; otherwise, failure;
  */
-static int32_t setRootCa( SSLContext_t * pSslContext,
+static int32_t setRootCa( mbedtls_x509_crt * pRootCaChain,
                           const uint8_t * pRootCa,
                           size_t rootCaSize );
 
 /**
- * @brief Set X509 certificate as client certificate for the server to authenticate.
+ * @brief Parse the X509 certificate used by the server to authenticate the client.
  *
- * @param[out] pSslContext SSL context to which the client certificate is to be set.
+ * @param[out] pClientCertChain Certificate chain into which the client certificate is parsed.
  * @param[in] pClientCert PEM-encoded string of the client certificate.
  * @param[in] clientCertSize Size of the client certificate.
  *
  * @return 0 on success; otherwise, failure;
  */
-static int32_t setClientCertificate( SSLContext_t * pSslContext,
+static int32_t setClientCertificate( mbedtls_x509_crt * pClientCertChain,
                                      const uint8_t * pClientCert,
                                      size_t clientCertSize );
 
 /**
- * @brief Set private key for the client's certificate.
+ * @brief Parse the private key for the client's certificate.
  *
- * @param[out] pSslContext SSL context to which the private key is to be set.
+ * @param[out] pPrivKey Key context into which the private key is parsed.
  * @param[in] pPrivateKey PEM-encoded string of the client private key.
  * @param[in] privateKeySize Size of the client private key.
  *
  * @return 0 on success; otherwise, failure;
  */
-static int32_t setPrivateKey( SSLContext_t * pSslContext,
+static int32_t setPrivateKey( mbedtls_pk_context * pPrivKey,
                               const uint8_t * pPrivateKey,
                               size_t privateKeySize );
 
@@ -197,7 +286,8 @@ static int32_t setPrivateKey( SSLContext_t * pSslContext,
  *
  * Provides the root CA certificate, client certificate, and private key to the
  * OpenSSL library. If the client certificate or private key is not NULL, mutual
- * authentication is used when performing the TLS handshake.
+ * authentication is used when performing the TLS handshake. If a credential
+ * store is given, its already parsed credentials are referenced instead.
  *
  * @param[out] pSslContext SSL context to which the credentials are to be imported.
  * @param[in] pNetworkCredentials TLS credentials to be imported.
@@ -220,6 +310,20 @@ static void setOptionalConfigurations( SSLContext_t * pSslContext,
                                        const char * pHostName,
                                        const NetworkCredentials_t * pNetworkCredentials );
 
+#ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+
+/**
+ * @brief Map a maximum fragment length in bytes to the mbed TLS code for it.
+ *
+ * @param[in] maxFragmentLength Length in bytes; 0 selects the 4096 byte default.
+ *
+ * @return The matching MBEDTLS_SSL_MAX_FRAG_LEN_* code, or
+ * MBEDTLS_SSL_MAX_FRAG_LEN_NONE if the length is not supported.
+ */
+    static unsigned char getMaxFragmentLengthCode( uint16_t maxFragmentLength );
+
+#endif
+
 /**
  * @brief Setup TLS by initializing contexts and setting configurations.
  *
@@ -235,26 +339,150 @@ static TlsTransportStatus_t tlsSetup( NetworkContext_t * pNetworkContext,
                                       const NetworkCredentials_t * pNetworkCredentials );
 
 /**
- * @brief Perform the TLS handshake on a TCP connection.
+ * @brief Prepare the TLS handshake on a TCP connection.
  *
  * @param[in] pNetworkContext Network context.
- * @param[in] pNetworkCredentials TLS setup parameters.
+ * @param[in] allowResumption Whether the session cached for
+ * TlsConnectOperation_t.pServerInfo may be offered.
+ *
+ * @note TlsConnectOperation_t.sessionOffered is set to true if a cached
+ * session is offered.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, or #TLS_TRANSPORT_INTERNAL_ERROR.
+ */
+static TlsTransportStatus_t tlsHandshakeStart( NetworkContext_t * pNetworkContext,
+                                               bool allowResumption );
+
+/**
+ * @brief Run the TLS handshake until it completes, fails, or waits for the
+ * socket.
+ *
+ * @param[in] pNetworkContext Network context.
+ *
+ * @note On success, #TlsTransportParams_t.sessionResumed is set. While the
+ * handshake waits, TlsConnectOperation_t.pollEvents is set.
  *
- * @return #TLS_TRANSPORT_SUCCESS, #TLS_TRANSPORT_HANDSHAKE_FAILED, or #TLS_TRANSPORT_INTERNAL_ERROR.
+ * @return #TLS_TRANSPORT_SUCCESS, #TLS_TRANSPORT_IN_PROGRESS, or
+ * #TLS_TRANSPORT_HANDSHAKE_FAILED.
  */
-static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pNetworkContext,
-                                          const NetworkCredentials_t * pNetworkCredentials );
+static TlsTransportStatus_t tlsHandshakeStep( NetworkContext_t * pNetworkContext );
 
 /**
- * @brief Initialize mbedTLS.
+ * @brief Initialize mbedTLS by seeding the shared random number generator.
  *
- * @param[out] entropyContext mbed TLS entropy context for generation of random numbers.
- * @param[out] ctrDrgbContext mbed TLS CTR DRBG context for generation of random numbers.
+ * @note #randomMutex must be held by the caller.
  *
  * @return #TLS_TRANSPORT_SUCCESS, or #TLS_TRANSPORT_INTERNAL_ERROR.
  */
-static TlsTransportStatus_t initMbedtls( mbedtls_entropy_context * pEntropyContext,
-                                         mbedtls_ctr_drbg_context * pCtrDrgbContext );
+static TlsTransportStatus_t initMbedtls( void );
+
+/**
+ * @brief Establish the TCP connection of #TlsTransportParams_t.connect and
+ * prepare the TLS handshake on it.
+ *
+ * On failure, all resources acquired for the connection are released.
+ *
+ * @param[in] pNetworkContext Network context.
+ * @param[in] allowResumption Whether a cached session may be offered.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, or the errors of #MbedTLS_Connect.
+ */
+static TlsTransportStatus_t startConnection( NetworkContext_t * pNetworkContext,
+                                             bool allowResumption );
+
+/**
+ * @brief Advance the TLS handshake of a connection, falling back to a full
+ * handshake on a new TCP connection if an abbreviated one fails.
+ *
+ * On failure, all resources acquired for the connection are released.
+ *
+ * @param[in] pNetworkContext Network context.
+ *
+ * @return Same as #MbedTLS_ConnectStep.
+ */
+static TlsTransportStatus_t advanceConnection( NetworkContext_t * pNetworkContext );
+
+/**
+ * @brief Validate the parameters of a connection and start establishing it.
+ *
+ * @param[in] pNetworkContext Network context.
+ * @param[in] pServerInfo Server connection info.
+ * @param[in] pNetworkCredentials TLS setup parameters.
+ * @param[in] receiveTimeoutMs Receive socket timeout.
+ * @param[in] sendTimeoutMs Send socket timeout.
+ * @param[in] pSocketsConfig Tuning profile of the socket, or NULL.
+ * @param[in] nonBlocking Whether the handshake runs on a non-blocking socket.
+ *
+ * @return Same as #MbedTLS_ConnectStart.
+ */
+static TlsTransportStatus_t connectStart( NetworkContext_t * pNetworkContext,
+                                          const ServerInfo_t * pServerInfo,
+                                          const NetworkCredentials_t * pNetworkCredentials,
+                                          uint32_t receiveTimeoutMs,
+                                          uint32_t sendTimeoutMs,
+                                          const SocketsConfig_t * pSocketsConfig,
+                                          bool nonBlocking );
+
+/**
+ * @brief Read application data from a TLS connection.
+ *
+ * @param[in] pTlsTransportParams Parameters of the connection.
+ * @param[out] pBuffer Buffer to receive bytes into.
+ * @param[in] bufferLength Maximum number of bytes to receive.
+ *
+ * @return Same as #MbedTLS_recv.
+ */
+static int32_t readFromTls( TlsTransportParams_t * pTlsTransportParams,
+                            void * pBuffer,
+                            size_t bufferLength );
+
+/**
+ * @brief Find the session cache entry of a server.
+ *
+ * @note #sessionCacheMutex must be held by the caller.
+ *
+ * @param[in] pServerInfo Server to look up.
+ *
+ * @return The cache entry, or NULL if none matches.
+ */
+static SessionCacheEntry_t * findSessionCacheEntry( const ServerInfo_t * pServerInfo );
+
+/**
+ * @brief Offer the cached session of a server, if any, on an SSL context
+ * that has been set up but has not started the handshake.
+ *
+ * @param[in] pSslContext SSL context on which to set the session.
+ * @param[in] pServerInfo Server whose session is looked up.
+ * @param[out] pMasterSecret Receives the master secret of the offered session,
+ * which is used to tell whether the server resumed it.
+ *
+ * @return true if a cached session was set; false otherwise.
+ */
+static bool loadCachedSession( SSLContext_t * pSslContext,
+                               const ServerInfo_t * pServerInfo,
+                               unsigned char * pMasterSecret );
+
+/**
+ * @brief Store the session of a completed handshake in the cache.
+ *
+ * The memory of the cached session is attributed to #sessionCacheUsage
+ * rather than to the connection.
+ *
+ * @param[in] pSslContext SSL context that completed the handshake.
+ * @param[in] pServerInfo Server the session belongs to.
+ * @param[in] pConnectionUsage Usage record of the connection, to which
+ * allocations are attributed again afterwards.
+ */
+static void storeCachedSession( SSLContext_t * pSslContext,
+                                const ServerInfo_t * pServerInfo,
+                                MbedTLSArenaUsage_t * pConnectionUsage );
+
+/**
+ * @brief Drop the cached session of a server.
+ *
+ * @param[in] pServerInfo Server whose session is discarded.
+ */
+static void removeCachedSession( const ServerInfo_t * pServerInfo );
 
 /*-----------------------------------------------------------*/
 
@@ -265,6 +493,12 @@ static int mbedtls_platform_send( void * ctx,
     int socket = ( int ) ctx;
     ssize_t sendStatus = zsock_send( socket, buf, len, 0 );
 
+    /* Report an expired send timeout as retryable to mbed TLS. */
+    if( ( sendStatus < 0 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
+    {
+        sendStatus = MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+
     return sendStatus;
 }
 /*-----------------------------------------------------------*/
@@ -276,6 +510,12 @@ static int mbedtls_platform_recv( void * ctx,
     int socket = ( int ) ctx;
     ssize_t recvStatus = zsock_recv( socket, buf, len, 0 );
 
+    /* Report an expired receive timeout as retryable to mbed TLS. */
+    if( ( recvStatus < 0 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
+    {
+        recvStatus = MBEDTLS_ERR_SSL_WANT_READ;
+    }
+
     return recvStatus;
 }
 /*-----------------------------------------------------------*/
@@ -314,6 +554,22 @@ static int mbedtls_platform_entropy_poll( void * data,
 }
 /*-----------------------------------------------------------*/
 
+static int mbedtls_platform_random( void * pContext,
+                                    unsigned char * pOutput,
+                                    size_t outputLength )
+{
+    int mbedtlsError = 0;
+
+    ( void ) pContext;
+
+    ( void ) k_mutex_lock( &randomMutex, K_FOREVER );
+    mbedtlsError = mbedtls_ctr_drbg_random( &ctrDrbgContext, pOutput, outputLength );
+    ( void ) k_mutex_unlock( &randomMutex );
+
+    return mbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
 static void sslContextInit( SSLContext_t * pSslContext )
 {
     assert( pSslContext != NULL );
@@ -334,23 +590,21 @@ static void sslContextFree( SSLContext_t * pSslContext )
     mbedtls_x509_crt_free( &( pSslContext->rootCa ) );
     mbedtls_x509_crt_free( &( pSslContext->clientCert ) );
     mbedtls_pk_free( &( pSslContext->privKey ) );
-    mbedtls_entropy_free( &( pSslContext->entropyContext ) );
-    mbedtls_ctr_drbg_free( &( pSslContext->ctrDrgbContext ) );
     mbedtls_ssl_config_free( &( pSslContext->config ) );
 }
 /*-----------------------------------------------------------*/
 
-static int32_t setRootCa( SSLContext_t * pSslContext,
+static int32_t setRootCa( mbedtls_x509_crt * pRootCaChain,
                           const uint8_t * pRootCa,
                           size_t rootCaSize )
 {
     int32_t mbedtlsError = -1;
 
-    assert( pSslContext != NULL );
+    assert( pRootCaChain != NULL );
     assert( pRootCa != NULL );
 
-    /* Parse the server root CA certificate into the SSL context. */
-    mbedtlsError = mbedtls_x509_crt_parse( &( pSslContext->rootCa ),
+    /* Parse the server root CA certificate. */
+    mbedtlsError = mbedtls_x509_crt_parse( pRootCaChain,
                                            pRootCa,
                                            rootCaSize );
 
@@ -360,28 +614,22 @@ static int32_t setRootCa( SSLContext_t * pSslContext,
                     mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
                     mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
     }
-    else
-    {
-        mbedtls_ssl_conf_ca_chain( &( pSslContext->config ),
-                                   &( pSslContext->rootCa ),
-                                   NULL );
-    }
 
     return mbedtlsError;
 }
 /*-----------------------------------------------------------*/
 
-static int32_t setClientCertificate( SSLContext_t * pSslContext,
+static int32_t setClientCertificate( mbedtls_x509_crt * pClientCertChain,
                                      const uint8_t * pClientCert,
                                      size_t clientCertSize )
 {
     int32_t mbedtlsError = -1;
 
-    assert( pSslContext != NULL );
+    assert( pClientCertChain != NULL );
     assert( pClientCert != NULL );
 
     /* Setup the client certificate. */
-    mbedtlsError = mbedtls_x509_crt_parse( &( pSslContext->clientCert ),
+    mbedtlsError = mbedtls_x509_crt_parse( pClientCertChain,
                                            pClientCert,
                                            clientCertSize );
 
@@ -396,17 +644,17 @@ static int32_t setClientCertificate( SSLContext_t * pSslContext,
 }
 /*-----------------------------------------------------------*/
 
-static int32_t setPrivateKey( SSLContext_t * pSslContext,
+static int32_t setPrivateKey( mbedtls_pk_context * pPrivKey,
                               const uint8_t * pPrivateKey,
                               size_t privateKeySize )
 {
     int32_t mbedtlsError = -1;
 
-    assert( pSslContext != NULL );
+    assert( pPrivKey != NULL );
     assert( pPrivateKey != NULL );
 
     /* Setup the client private key. */
-    mbedtlsError = mbedtls_pk_parse_key( &( pSslContext->privKey ),
+    mbedtlsError = mbedtls_pk_parse_key( pPrivKey,
                                          pPrivateKey,
                                          privateKeySize,
                                          NULL,
@@ -427,6 +675,10 @@ static int32_t setCredentials( SSLContext_t * pSslContext,
                                const NetworkCredentials_t * pNetworkCredentials )
 {
     int32_t mbedtlsError = -1;
+    TlsCredentialStore_t * pCredentialStore = NULL;
+    mbedtls_x509_crt * pRootCa = NULL;
+    mbedtls_x509_crt * pClientCert = NULL;
+    mbedtls_pk_context * pPrivKey = NULL;
 
     assert( pSslContext != NULL );
     assert( pNetworkCredentials != NULL );
@@ -438,44 +690,108 @@ static int32_t setCredentials( SSLContext_t * pSslContext,
     mbedtls_ssl_conf_authmode( &( pSslContext->config ),
                                MBEDTLS_SSL_VERIFY_REQUIRED );
     mbedtls_ssl_conf_rng( &( pSslContext->config ),
-                          mbedtls_ctr_drbg_random,
-                          &( pSslContext->ctrDrgbContext ) );
+                          mbedtls_platform_random,
+                          NULL );
     mbedtls_ssl_conf_cert_profile( &( pSslContext->config ),
                                    &( pSslContext->certProfile ) );
 
-    mbedtlsError = setRootCa( pSslContext,
-                              pNetworkCredentials->pRootCa,
-                              pNetworkCredentials->rootCaSize );
-
-    if( ( pNetworkCredentials->pClientCert != NULL ) &&
-        ( pNetworkCredentials->pPrivateKey != NULL ) )
+    if( pNetworkCredentials->pCredentialStore != NULL )
     {
-        if( mbedtlsError == 0 )
-        {
-            mbedtlsError = setClientCertificate( pSslContext,
-                                                 pNetworkCredentials->pClientCert,
-                                                 pNetworkCredentials->clientCertSize );
-        }
+        /* mbed TLS only reads the credentials referenced by the configuration,
+         * so the shared store can be used without copying it. */
+        pCredentialStore = ( TlsCredentialStore_t * ) pNetworkCredentials->pCredentialStore;
+        pRootCa = &( pCredentialStore->rootCa );
+        mbedtlsError = 0;
 
-        if( mbedtlsError == 0 )
+        if( pCredentialStore->hasClientCredentials == true )
         {
-            mbedtlsError = setPrivateKey( pSslContext,
-                                          pNetworkCredentials->pPrivateKey,
-                                          pNetworkCredentials->privateKeySize );
+            pClientCert = &( pCredentialStore->clientCert );
+            pPrivKey = &( pCredentialStore->privKey );
         }
+    }
+    else
+    {
+        pRootCa = &( pSslContext->rootCa );
+        mbedtlsError = setRootCa( pRootCa,
+                                  pNetworkCredentials->pRootCa,
+                                  pNetworkCredentials->rootCaSize );
 
-        if( mbedtlsError == 0 )
+        if( ( pNetworkCredentials->pClientCert != NULL ) &&
+            ( pNetworkCredentials->pPrivateKey != NULL ) )
         {
-            mbedtlsError = mbedtls_ssl_conf_own_cert( &( pSslContext->config ),
-                                                      &( pSslContext->clientCert ),
-                                                      &( pSslContext->privKey ) );
+            pClientCert = &( pSslContext->clientCert );
+            pPrivKey = &( pSslContext->privKey );
+
+            if( mbedtlsError == 0 )
+            {
+                mbedtlsError = setClientCertificate( pClientCert,
+                                                     pNetworkCredentials->pClientCert,
+                                                     pNetworkCredentials->clientCertSize );
+            }
+
+            if( mbedtlsError == 0 )
+            {
+                mbedtlsError = setPrivateKey( pPrivKey,
+                                              pNetworkCredentials->pPrivateKey,
+                                              pNetworkCredentials->privateKeySize );
+            }
         }
     }
 
+    if( mbedtlsError == 0 )
+    {
+        mbedtls_ssl_conf_ca_chain( &( pSslContext->config ),
+                                   pRootCa,
+                                   NULL );
+    }
+
+    if( ( mbedtlsError == 0 ) && ( pClientCert != NULL ) )
+    {
+        mbedtlsError = mbedtls_ssl_conf_own_cert( &( pSslContext->config ),
+                                                  pClientCert,
+                                                  pPrivKey );
+    }
+
     return mbedtlsError;
 }
 /*-----------------------------------------------------------*/
 
+#ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+
+    static unsigned char getMaxFragmentLengthCode( uint16_t maxFragmentLength )
+    {
+        unsigned char code = MBEDTLS_SSL_MAX_FRAG_LEN_NONE;
+
+        switch( maxFragmentLength )
+        {
+            case 512U:
+                code = MBEDTLS_SSL_MAX_FRAG_LEN_512;
+                break;
+
+            case 1024U:
+                code = MBEDTLS_SSL_MAX_FRAG_LEN_1024;
+                break;
+
+            case 2048U:
+                code = MBEDTLS_SSL_MAX_FRAG_LEN_2048;
+                break;
+
+            case 0U:
+            case 4096U:
+                code = MBEDTLS_SSL_MAX_FRAG_LEN_4096;
+                break;
+
+            default:
+                /* Unsupported length. */
+                break;
+        }
+
+        return code;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH */
+
 static void setOptionalConfigurations( SSLContext_t * pSslContext,
                                        const char * pHostName,
                                        const NetworkCredentials_t * pNetworkCredentials )
@@ -515,15 +831,24 @@ static void setOptionalConfigurations( SSLContext_t * pSslContext,
         }
     }
 
+    /* Request RFC 5077 session tickets if enabled, so that the session can be
+     * resumed even when the server does not keep a session ID cache. */
+    #ifdef MBEDTLS_SSL_SESSION_TICKETS
+        mbedtls_ssl_conf_session_tickets( &( pSslContext->config ),
+                                          MBEDTLS_SSL_SESSION_TICKETS_ENABLED );
+    #endif /* ifdef MBEDTLS_SSL_SESSION_TICKETS */
+
     /* Set Maximum Fragment Length if enabled. */
     #ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
 
-        /* Enable the max fragment extension. 4096 bytes is currently the largest fragment size permitted.
-         * See RFC 8449 https://tools.ietf.org/html/rfc8449 for more information.
-         *
-         * Smaller values can be found in "mbedtls/include/ssl.h".
+        /* Enable the max fragment extension with the length requested for this
+         * connection. 4096 bytes is the largest fragment size permitted, and is
+         * used when no length is given. With MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH,
+         * mbed TLS also shrinks the record buffers to this size after the handshake.
+         * See RFC 6066 https://tools.ietf.org/html/rfc6066#section-4 for more information.
          */
-        mbedtlsError = mbedtls_ssl_conf_max_frag_len( &( pSslContext->config ), MBEDTLS_SSL_MAX_FRAG_LEN_4096 );
+        mbedtlsError = mbedtls_ssl_conf_max_frag_len( &( pSslContext->config ),
+                                                      getMaxFragmentLengthCode( pNetworkCredentials->maxFragmentLength ) );
 
         if( mbedtlsError != 0 )
         {
@@ -547,7 +872,8 @@ static TlsTransportStatus_t tlsSetup( NetworkContext_t * pNetworkContext,
     assert( pNetworkContext->pParams != NULL );
     assert( pHostName != NULL );
     assert( pNetworkCredentials != NULL );
-    assert( pNetworkCredentials->pRootCa != NULL );
+    assert( ( pNetworkCredentials->pRootCa != NULL ) ||
+            ( pNetworkCredentials->pCredentialStore != NULL ) );
 
     pTlsTransportParams = pNetworkContext->pParams;
     /* Initialize the mbed TLS context structures. */
@@ -590,8 +916,8 @@ static TlsTransportStatus_t tlsSetup( NetworkContext_t * pNetworkContext,
 }
 /*-----------------------------------------------------------*/
 
-static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pNetworkContext,
-                                          const NetworkCredentials_t * pNetworkCredentials )
+static TlsTransportStatus_t tlsHandshakeStart( NetworkContext_t * pNetworkContext,
+                                               bool allowResumption )
 {
     TlsTransportParams_t * pTlsTransportParams = NULL;
     TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
@@ -599,9 +925,10 @@ static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pNetworkContext,
 
     assert( pNetworkContext != NULL );
     assert( pNetworkContext->pParams != NULL );
-    assert( pNetworkCredentials != NULL );
 
     pTlsTransportParams = pNetworkContext->pParams;
+    pTlsTransportParams->connect.sessionOffered = false;
+
     /* Initialize the mbed TLS secured connection context. */
     mbedtlsError = mbedtls_ssl_setup( &( pTlsTransportParams->sslContext.context ),
                                       &( pTlsTransportParams->sslContext.config ) );
@@ -622,48 +949,96 @@ static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pNetworkContext,
                              mbedtls_platform_send,
                              mbedtls_platform_recv,
                              NULL );
+
+        /* Offer the session of an earlier connection to this server so an
+         * abbreviated handshake can be performed. */
+        if( allowResumption == true )
+        {
+            pTlsTransportParams->connect.sessionOffered =
+                loadCachedSession( &( pTlsTransportParams->sslContext ),
+                                   pTlsTransportParams->connect.pServerInfo,
+                                   pTlsTransportParams->connect.offeredMasterSecret );
+        }
+
+        /* The ClientHello is written first. */
+        pTlsTransportParams->connect.pollEvents = ZSOCK_POLLOUT;
     }
 
-    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t tlsHandshakeStep( NetworkContext_t * pNetworkContext )
+{
+    TlsTransportParams_t * pTlsTransportParams = NULL;
+    TlsConnectOperation_t * pConnect = NULL;
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+    int32_t mbedtlsError = 0;
+
+    assert( pNetworkContext != NULL );
+    assert( pNetworkContext->pParams != NULL );
+
+    pTlsTransportParams = pNetworkContext->pParams;
+    pConnect = &( pTlsTransportParams->connect );
+
+    /* Perform the TLS handshake until it needs the socket to be ready. On a
+     * blocking socket, this happens only when a socket timeout expires. */
+    mbedtlsError = mbedtls_ssl_handshake( &( pTlsTransportParams->sslContext.context ) );
+
+    if( mbedtlsError == MBEDTLS_ERR_SSL_WANT_READ )
     {
-        /* Perform the TLS handshake. */
-        do
-        {
-            mbedtlsError = mbedtls_ssl_handshake( &( pTlsTransportParams->sslContext.context ) );
-        } while( ( mbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
-                 ( mbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) );
+        pConnect->pollEvents = ZSOCK_POLLIN;
+        returnStatus = TLS_TRANSPORT_IN_PROGRESS;
+    }
+    else if( mbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE )
+    {
+        pConnect->pollEvents = ZSOCK_POLLOUT;
+        returnStatus = TLS_TRANSPORT_IN_PROGRESS;
+    }
+    else if( mbedtlsError != 0 )
+    {
+        LogError( ( "Failed to perform TLS handshake: mbedTLSError= %s : %s.",
+                    mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
 
-        if( mbedtlsError != 0 )
-        {
-            LogError( ( "Failed to perform TLS handshake: mbedTLSError= %s : %s.",
-                        mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
-                        mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+        returnStatus = TLS_TRANSPORT_HANDSHAKE_FAILED;
+    }
+    else
+    {
+        /* mbed TLS does not expose whether the server accepted the offered
+         * session. A resumed session keeps its master secret, while a full
+         * handshake always derives a new one. */
+        pTlsTransportParams->sessionResumed =
+            ( pConnect->sessionOffered == true ) &&
+            ( memcmp( pTlsTransportParams->sslContext.context.session->master,
+                      pConnect->offeredMasterSecret,
+                      sizeof( pConnect->offeredMasterSecret ) ) == 0 );
+
+        LogInfo( ( "(Network connection %p) TLS handshake successful. Session resumed=%d.",
+                   pNetworkContext,
+                   ( int ) pTlsTransportParams->sessionResumed ) );
+    }
 
-            returnStatus = TLS_TRANSPORT_HANDSHAKE_FAILED;
-        }
-        else
-        {
-            LogInfo( ( "(Network connection %p) TLS handshake successful.",
-                       pNetworkContext ) );
-        }
+    if( ( returnStatus != TLS_TRANSPORT_IN_PROGRESS ) && ( pConnect->sessionOffered == true ) )
+    {
+        mbedtls_platform_zeroize( pConnect->offeredMasterSecret, sizeof( pConnect->offeredMasterSecret ) );
     }
 
     return returnStatus;
 }
 /*-----------------------------------------------------------*/
 
-static TlsTransportStatus_t initMbedtls( mbedtls_entropy_context * pEntropyContext,
-                                         mbedtls_ctr_drbg_context * pCtrDrgbContext )
+static TlsTransportStatus_t initMbedtls( void )
 {
     TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
     int32_t mbedtlsError = 0;
 
     /* Initialize contexts for random number generation. */
-    mbedtls_entropy_init( pEntropyContext );
-    mbedtls_ctr_drbg_init( pCtrDrgbContext );
+    mbedtls_entropy_init( &entropyContext );
+    mbedtls_ctr_drbg_init( &ctrDrbgContext );
 
     /* Add a strong entropy source. At least one is required. */
-    mbedtlsError = mbedtls_entropy_add_source( pEntropyContext,
+    mbedtlsError = mbedtls_entropy_add_source( &entropyContext,
                                                mbedtls_platform_entropy_poll,
                                                NULL,
                                                32,
@@ -680,9 +1055,9 @@ static TlsTransportStatus_t initMbedtls( mbedtls_entropy_context * pEntropyConte
     if( returnStatus == TLS_TRANSPORT_SUCCESS )
     {
         /* Seed the random number generator. */
-        mbedtlsError = mbedtls_ctr_drbg_seed( pCtrDrgbContext,
+        mbedtlsError = mbedtls_ctr_drbg_seed( &ctrDrbgContext,
                                               mbedtls_entropy_func,
-                                              pEntropyContext,
+                                              &entropyContext,
                                               NULL,
                                               0 );
 
@@ -699,91 +1074,593 @@ static TlsTransportStatus_t initMbedtls( mbedtls_entropy_context * pEntropyConte
     {
         LogDebug( ( "Successfully initialized mbedTLS." ) );
     }
+    else
+    {
+        /* Leave the contexts ready for another seeding attempt. */
+        mbedtls_ctr_drbg_free( &ctrDrbgContext );
+        mbedtls_entropy_free( &entropyContext );
+    }
 
     return returnStatus;
 }
 /*-----------------------------------------------------------*/
 
-TlsTransportStatus_t MbedTLS_Connect( NetworkContext_t * pNetworkContext,
-                                      const ServerInfo_t * pServerInfo,
-                                      const NetworkCredentials_t * pNetworkCredentials,
-                                      uint32_t receiveTimeoutMs,
-                                      uint32_t sendTimeoutMs )
+static SessionCacheEntry_t * findSessionCacheEntry( const ServerInfo_t * pServerInfo )
 {
-    TlsTransportParams_t * pTlsTransportParams = NULL;
-    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
-    SocketStatus_t socketStatus = 0;
+    SessionCacheEntry_t * pEntry = NULL;
+    size_t index = 0U;
 
-    const char * pHostName = pServerInfo->pHostName;
-
-    if( ( pNetworkContext == NULL ) ||
-        ( pNetworkContext->pParams == NULL ) ||
-        ( pHostName == NULL ) ||
-        ( pNetworkCredentials == NULL ) )
-    {
-        LogError( ( "Invalid input parameter(s): Arguments cannot be NULL. pNetworkContext=%p, "
-                    "pHostName=%p, pNetworkCredentials=%p.",
-                    pNetworkContext,
-                    pHostName,
-                    pNetworkCredentials ) );
-        returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
-    }
-    else if( ( pNetworkCredentials->pRootCa == NULL ) )
-    {
-        LogError( ( "pRootCa cannot be NULL." ) );
-        returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
-    }
+    assert( pServerInfo != NULL );
 
-    /* Establish a TCP connection with the server. */
-    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    for( index = 0U; index < MBEDTLS_ZEPHYR_SESSION_CACHE_SIZE; index++ )
     {
-        pTlsTransportParams = pNetworkContext->pParams;
-        socketStatus = Sockets_Connect( &( pTlsTransportParams->tcpSocket ),
-                                        pServerInfo,
-                                        receiveTimeoutMs,
-                                        sendTimeoutMs );
-
-        if( socketStatus != 0 )
+        if( ( sessionCache[ index ].valid == true ) &&
+            ( sessionCache[ index ].port == pServerInfo->port ) &&
+            ( sessionCache[ index ].hostNameLength == pServerInfo->hostNameLength ) &&
+            ( memcmp( sessionCache[ index ].hostName,
+                      pServerInfo->pHostName,
+                      pServerInfo->hostNameLength ) == 0 ) )
         {
-            LogError( ( "Failed to connect to %s with error %d.",
-                        pHostName,
-                        socketStatus ) );
-            returnStatus = TLS_TRANSPORT_CONNECT_FAILURE;
+            pEntry = &( sessionCache[ index ] );
+            break;
         }
     }
 
-    /* Initialize mbedtls. */
-    if( returnStatus == TLS_TRANSPORT_SUCCESS )
-    {
-        returnStatus = initMbedtls( &( pTlsTransportParams->sslContext.entropyContext ),
-                                    &( pTlsTransportParams->sslContext.ctrDrgbContext ) );
-    }
+    return pEntry;
+}
+/*-----------------------------------------------------------*/
 
-    /* Initialize TLS contexts and set credentials. */
-    if( returnStatus == TLS_TRANSPORT_SUCCESS )
-    {
-        returnStatus = tlsSetup( pNetworkContext, pHostName, pNetworkCredentials );
-    }
+static bool loadCachedSession( SSLContext_t * pSslContext,
+                               const ServerInfo_t * pServerInfo,
+                               unsigned char * pMasterSecret )
+{
+    SessionCacheEntry_t * pEntry = NULL;
+    int32_t mbedtlsError = 0;
+    bool sessionSet = false;
 
-    /* Perform TLS handshake. */
-    if( returnStatus == TLS_TRANSPORT_SUCCESS )
-    {
-        returnStatus = tlsHandshake( pNetworkContext, pNetworkCredentials );
-    }
+    assert( pSslContext != NULL );
+    assert( pServerInfo != NULL );
+    assert( pMasterSecret != NULL );
 
-    /* Clean up on failure. */
-    if( returnStatus != TLS_TRANSPORT_SUCCESS )
+    ( void ) k_mutex_lock( &sessionCacheMutex, K_FOREVER );
+
+    pEntry = findSessionCacheEntry( pServerInfo );
+
+    if( pEntry != NULL )
     {
-        if( ( pNetworkContext != NULL ) && ( pNetworkContext->pParams != NULL ) )
+        /* The session is copied into the SSL context, so the cache entry
+         * remains usable by other connections. */
+        mbedtlsError = mbedtls_ssl_set_session( &( pSslContext->context ),
+                                                &( pEntry->session ) );
+
+        if( mbedtlsError != 0 )
         {
-            sslContextFree( &( pTlsTransportParams->sslContext ) );
+            LogWarn( ( "Failed to set cached TLS session: mbedTLSError= %s : %s.",
+                       mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
+                       mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
         }
-    }
+        else
+        {
+            ( void ) memcpy( pMasterSecret,
+                             pEntry->session.master,
+                             sizeof( pEntry->session.master ) );
+            pEntry->lastUsed = ++sessionCacheUseCount;
+            sessionSet = true;
+        }
+    }
+
+    ( void ) k_mutex_unlock( &sessionCacheMutex );
+
+    return sessionSet;
+}
+/*-----------------------------------------------------------*/
+
+static void storeCachedSession( SSLContext_t * pSslContext,
+                                const ServerInfo_t * pServerInfo,
+                                MbedTLSArenaUsage_t * pConnectionUsage )
+{
+    SessionCacheEntry_t * pEntry = NULL;
+    int32_t mbedtlsError = 0;
+    size_t index = 0U;
+
+    assert( pSslContext != NULL );
+    assert( pServerInfo != NULL );
+
+    if( pServerInfo->hostNameLength <= MBEDTLS_ZEPHYR_SESSION_CACHE_HOSTNAME_LENGTH )
+    {
+        ( void ) k_mutex_lock( &sessionCacheMutex, K_FOREVER );
+
+        pEntry = findSessionCacheEntry( pServerInfo );
+
+        /* Use a free entry, or replace the least recently used one. */
+        for( index = 0U; ( pEntry == NULL ) && ( index < MBEDTLS_ZEPHYR_SESSION_CACHE_SIZE ); index++ )
+        {
+            if( sessionCache[ index ].valid == false )
+            {
+                pEntry = &( sessionCache[ index ] );
+            }
+        }
+
+        if( pEntry == NULL )
+        {
+            pEntry = &( sessionCache[ 0 ] );
+
+            for( index = 1U; index < MBEDTLS_ZEPHYR_SESSION_CACHE_SIZE; index++ )
+            {
+                if( ( int32_t ) ( sessionCache[ index ].lastUsed - pEntry->lastUsed ) < 0 )
+                {
+                    pEntry = &( sessionCache[ index ] );
+                }
+            }
+        }
+
+        /* Release the previous session, including any ticket it owns. */
+        mbedtls_ssl_session_free( &( pEntry->session ) );
+        pEntry->valid = false;
+
+        /* The copy is freed after the connection, possibly once its usage
+         * record is gone. */
+        MbedTLSArena_SetOwner( &sessionCacheUsage );
+
+        mbedtlsError = mbedtls_ssl_get_session( &( pSslContext->context ),
+                                                &( pEntry->session ) );
+
+        if( mbedtlsError != 0 )
+        {
+            LogWarn( ( "Failed to cache TLS session: mbedTLSError= %s : %s.",
+                       mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
+                       mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+            mbedtls_ssl_session_free( &( pEntry->session ) );
+        }
+        else
+        {
+            ( void ) memcpy( pEntry->hostName,
+                             pServerInfo->pHostName,
+                             pServerInfo->hostNameLength );
+            pEntry->hostNameLength = pServerInfo->hostNameLength;
+            pEntry->port = pServerInfo->port;
+            pEntry->lastUsed = ++sessionCacheUseCount;
+            pEntry->valid = true;
+        }
+
+        MbedTLSArena_SetOwner( pConnectionUsage );
+
+        ( void ) k_mutex_unlock( &sessionCacheMutex );
+    }
+    else
+    {
+        LogDebug( ( "Host name too long to cache the TLS session: Length=%u.",
+                    ( unsigned int ) pServerInfo->hostNameLength ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void removeCachedSession( const ServerInfo_t * pServerInfo )
+{
+    SessionCacheEntry_t * pEntry = NULL;
+
+    assert( pServerInfo != NULL );
+
+    ( void ) k_mutex_lock( &sessionCacheMutex, K_FOREVER );
+
+    pEntry = findSessionCacheEntry( pServerInfo );
+
+    if( pEntry != NULL )
+    {
+        mbedtls_ssl_session_free( &( pEntry->session ) );
+        pEntry->valid = false;
+    }
+
+    ( void ) k_mutex_unlock( &sessionCacheMutex );
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t startConnection( NetworkContext_t * pNetworkContext,
+                                             bool allowResumption )
+{
+    TlsTransportParams_t * pTlsTransportParams = NULL;
+    TlsConnectOperation_t * pConnect = NULL;
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+    SocketStatus_t socketStatus = SOCKETS_SUCCESS;
+    bool socketConnected = false;
+
+    assert( pNetworkContext != NULL );
+    assert( pNetworkContext->pParams != NULL );
+
+    pTlsTransportParams = pNetworkContext->pParams;
+    pConnect = &( pTlsTransportParams->connect );
+    pConnect->sessionOffered = false;
+
+    /* Establish a TCP connection with the server. */
+    socketStatus = Sockets_Connect( &( pTlsTransportParams->tcpSocket ),
+                                    pConnect->pServerInfo,
+                                    pConnect->sendTimeoutMs,
+                                    pConnect->receiveTimeoutMs,
+                                    pConnect->pSocketsConfig );
+
+    if( socketStatus != SOCKETS_SUCCESS )
+    {
+        LogError( ( "Failed to connect to %s with error %d.",
+                    pConnect->pServerInfo->pHostName,
+                    socketStatus ) );
+        returnStatus = ( socketStatus == SOCKETS_DNS_FAILURE ) ? TLS_TRANSPORT_DNS_FAILURE : TLS_TRANSPORT_CONNECT_FAILURE;
+    }
     else
     {
-        LogInfo( ( "(Network connection %p) Connection to %s established.",
+        socketConnected = true;
+    }
+
+    /* Let the handshake return to the caller whenever it waits for the server. */
+    if( ( returnStatus == TLS_TRANSPORT_SUCCESS ) && ( pConnect->nonBlocking == true ) )
+    {
+        if( Sockets_SetBlocking( pTlsTransportParams->tcpSocket, false ) != SOCKETS_SUCCESS )
+        {
+            returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+        }
+    }
+
+    /* Initialize mbedtls. */
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        returnStatus = MbedTLS_Init();
+    }
+
+    /* Initialize TLS contexts and set credentials. */
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        returnStatus = tlsSetup( pNetworkContext,
+                                 pConnect->pServerInfo->pHostName,
+                                 pConnect->pNetworkCredentials );
+    }
+
+    /* Prepare the TLS handshake. */
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        returnStatus = tlsHandshakeStart( pNetworkContext, allowResumption );
+    }
+
+    /* Clean up on failure. */
+    if( returnStatus != TLS_TRANSPORT_SUCCESS )
+    {
+        sslContextFree( &( pTlsTransportParams->sslContext ) );
+
+        if( socketConnected == true )
+        {
+            ( void ) Sockets_Disconnect( pTlsTransportParams->tcpSocket );
+        }
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t advanceConnection( NetworkContext_t * pNetworkContext )
+{
+    TlsTransportParams_t * pTlsTransportParams = NULL;
+    TlsConnectOperation_t * pConnect = NULL;
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+    bool sessionOffered = false;
+
+    assert( pNetworkContext != NULL );
+    assert( pNetworkContext->pParams != NULL );
+
+    pTlsTransportParams = pNetworkContext->pParams;
+    pConnect = &( pTlsTransportParams->connect );
+    sessionOffered = pConnect->sessionOffered;
+
+    returnStatus = tlsHandshakeStep( pNetworkContext );
+
+    /* Restore blocking mode, which the send and receive functions expect. */
+    if( ( returnStatus == TLS_TRANSPORT_SUCCESS ) && ( pConnect->nonBlocking == true ) )
+    {
+        if( Sockets_SetBlocking( pTlsTransportParams->tcpSocket, true ) != SOCKETS_SUCCESS )
+        {
+            returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+        }
+    }
+
+    /* Release the connection unless its handshake continues. */
+    if( ( returnStatus != TLS_TRANSPORT_SUCCESS ) && ( returnStatus != TLS_TRANSPORT_IN_PROGRESS ) )
+    {
+        sslContextFree( &( pTlsTransportParams->sslContext ) );
+        ( void ) Sockets_Disconnect( pTlsTransportParams->tcpSocket );
+    }
+
+    /* A server may reject a resumption attempt in a way that aborts the
+     * handshake instead of falling back to a full one. Do not offer the
+     * session again, and retry with a full handshake on a new connection. */
+    if( ( returnStatus == TLS_TRANSPORT_HANDSHAKE_FAILED ) && ( sessionOffered == true ) )
+    {
+        LogWarn( ( "Abbreviated TLS handshake with %s failed. Retrying with a full handshake.",
+                   pConnect->pServerInfo->pHostName ) );
+
+        removeCachedSession( pConnect->pServerInfo );
+
+        returnStatus = startConnection( pNetworkContext, false );
+
+        if( returnStatus == TLS_TRANSPORT_SUCCESS )
+        {
+            returnStatus = TLS_TRANSPORT_IN_PROGRESS;
+        }
+    }
+
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        /* Keep the session, possibly with a renewed ticket, for the next
+         * connection to this server. */
+        storeCachedSession( &( pTlsTransportParams->sslContext ),
+                            pConnect->pServerInfo,
+                            &( pTlsTransportParams->memoryUsage ) );
+
+        LogInfo( ( "(Network connection %p) Connection to %s established. Session resumed=%d.",
                    pNetworkContext,
-                   pHostName ) );
+                   pConnect->pServerInfo->pHostName,
+                   ( int ) pTlsTransportParams->sessionResumed ) );
+    }
+
+    pConnect->inProgress = ( returnStatus == TLS_TRANSPORT_IN_PROGRESS );
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t connectStart( NetworkContext_t * pNetworkContext,
+                                          const ServerInfo_t * pServerInfo,
+                                          const NetworkCredentials_t * pNetworkCredentials,
+                                          uint32_t receiveTimeoutMs,
+                                          uint32_t sendTimeoutMs,
+                                          const SocketsConfig_t * pSocketsConfig,
+                                          bool nonBlocking )
+{
+    TlsTransportParams_t * pTlsTransportParams = NULL;
+    TlsConnectOperation_t * pConnect = NULL;
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+
+    if( ( pNetworkContext == NULL ) ||
+        ( pNetworkContext->pParams == NULL ) ||
+        ( pServerInfo == NULL ) ||
+        ( pServerInfo->pHostName == NULL ) ||
+        ( pNetworkCredentials == NULL ) )
+    {
+        LogError( ( "Invalid input parameter(s): Arguments cannot be NULL. pNetworkContext=%p, "
+                    "pServerInfo=%p, pNetworkCredentials=%p.",
+                    pNetworkContext,
+                    pServerInfo,
+                    pNetworkCredentials ) );
+        returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
+    }
+    else if( ( pNetworkCredentials->pRootCa == NULL ) &&
+             ( pNetworkCredentials->pCredentialStore == NULL ) )
+    {
+        LogError( ( "pRootCa cannot be NULL without a credential store." ) );
+        returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
+    }
+
+    #ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+        else if( getMaxFragmentLengthCode( pNetworkCredentials->maxFragmentLength ) ==
+                 MBEDTLS_SSL_MAX_FRAG_LEN_NONE )
+        {
+            LogError( ( "Unsupported maximum fragment length %u: Must be 0, 512, 1024, 2048 or 4096.",
+                        ( unsigned int ) pNetworkCredentials->maxFragmentLength ) );
+            returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
+        }
+    #endif
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        pTlsTransportParams = pNetworkContext->pParams;
+        pTlsTransportParams->sessionResumed = false;
+        Sockets_ReadAheadReset( &( pTlsTransportParams->readAhead ) );
+        ( void ) memset( &( pTlsTransportParams->memoryUsage ), 0, sizeof( MbedTLSArenaUsage_t ) );
+
+        pConnect = &( pTlsTransportParams->connect );
+        ( void ) memset( pConnect, 0, sizeof( TlsConnectOperation_t ) );
+        pConnect->pServerInfo = pServerInfo;
+        pConnect->pNetworkCredentials = pNetworkCredentials;
+        pConnect->pSocketsConfig = pSocketsConfig;
+        pConnect->receiveTimeoutMs = receiveTimeoutMs;
+        pConnect->sendTimeoutMs = sendTimeoutMs;
+        pConnect->nonBlocking = nonBlocking;
+
+        /* Attribute the memory mbed TLS allocates for the connection to it. */
+        MbedTLSArena_SetOwner( &( pTlsTransportParams->memoryUsage ) );
+
+        returnStatus = startConnection( pNetworkContext, true );
+
+        MbedTLSArena_SetOwner( NULL );
+
+        if( returnStatus == TLS_TRANSPORT_SUCCESS )
+        {
+            pConnect->inProgress = true;
+            returnStatus = TLS_TRANSPORT_IN_PROGRESS;
+        }
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t MbedTLS_Init( void )
+{
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+
+    ( void ) k_mutex_lock( &randomMutex, K_FOREVER );
+
+    if( randomInitialized == false )
+    {
+        returnStatus = initMbedtls();
+        randomInitialized = ( returnStatus == TLS_TRANSPORT_SUCCESS );
+    }
+
+    ( void ) k_mutex_unlock( &randomMutex );
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t MbedTLS_LoadCredentials( TlsCredentialStore_t * pCredentialStore,
+                                              const NetworkCredentials_t * pNetworkCredentials )
+{
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+    int32_t mbedtlsError = 0;
+
+    if( ( pCredentialStore == NULL ) ||
+        ( pNetworkCredentials == NULL ) ||
+        ( pNetworkCredentials->pRootCa == NULL ) )
+    {
+        LogError( ( "Invalid input parameter(s): Arguments cannot be NULL. pCredentialStore=%p, "
+                    "pNetworkCredentials=%p.",
+                    pCredentialStore,
+                    pNetworkCredentials ) );
+        returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        mbedtls_x509_crt_init( &( pCredentialStore->rootCa ) );
+        mbedtls_x509_crt_init( &( pCredentialStore->clientCert ) );
+        mbedtls_pk_init( &( pCredentialStore->privKey ) );
+        pCredentialStore->hasClientCredentials = false;
+
+        mbedtlsError = setRootCa( &( pCredentialStore->rootCa ),
+                                  pNetworkCredentials->pRootCa,
+                                  pNetworkCredentials->rootCaSize );
+
+        if( ( mbedtlsError == 0 ) &&
+            ( pNetworkCredentials->pClientCert != NULL ) &&
+            ( pNetworkCredentials->pPrivateKey != NULL ) )
+        {
+            mbedtlsError = setClientCertificate( &( pCredentialStore->clientCert ),
+                                                 pNetworkCredentials->pClientCert,
+                                                 pNetworkCredentials->clientCertSize );
+
+            if( mbedtlsError == 0 )
+            {
+                mbedtlsError = setPrivateKey( &( pCredentialStore->privKey ),
+                                              pNetworkCredentials->pPrivateKey,
+                                              pNetworkCredentials->privateKeySize );
+            }
+
+            pCredentialStore->hasClientCredentials = ( mbedtlsError == 0 );
+        }
+
+        if( mbedtlsError != 0 )
+        {
+            MbedTLS_FreeCredentials( pCredentialStore );
+            returnStatus = TLS_TRANSPORT_INVALID_CREDENTIALS;
+        }
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+void MbedTLS_FreeCredentials( TlsCredentialStore_t * pCredentialStore )
+{
+    if( pCredentialStore != NULL )
+    {
+        mbedtls_x509_crt_free( &( pCredentialStore->rootCa ) );
+        mbedtls_x509_crt_free( &( pCredentialStore->clientCert ) );
+        mbedtls_pk_free( &( pCredentialStore->privKey ) );
+        pCredentialStore->hasClientCredentials = false;
+    }
+}
+/*-----------------------------------------------------------*/
+
+void MbedTLS_ClearSessionCache( void )
+{
+    size_t index = 0U;
+
+    ( void ) k_mutex_lock( &sessionCacheMutex, K_FOREVER );
+
+    for( index = 0U; index < MBEDTLS_ZEPHYR_SESSION_CACHE_SIZE; index++ )
+    {
+        if( sessionCache[ index ].valid == true )
+        {
+            mbedtls_ssl_session_free( &( sessionCache[ index ].session ) );
+            sessionCache[ index ].valid = false;
+        }
+    }
+
+    ( void ) k_mutex_unlock( &sessionCacheMutex );
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t MbedTLS_Connect( NetworkContext_t * pNetworkContext,
+                                      const ServerInfo_t * pServerInfo,
+                                      const NetworkCredentials_t * pNetworkCredentials,
+                                      uint32_t receiveTimeoutMs,
+                                      uint32_t sendTimeoutMs,
+                                      const SocketsConfig_t * pSocketsConfig )
+{
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+
+    returnStatus = connectStart( pNetworkContext,
+                                 pServerInfo,
+                                 pNetworkCredentials,
+                                 receiveTimeoutMs,
+                                 sendTimeoutMs,
+                                 pSocketsConfig,
+                                 false );
+
+    /* On the blocking socket, each step waits for the server until the
+     * handshake completes or a socket timeout expires. */
+    while( returnStatus == TLS_TRANSPORT_IN_PROGRESS )
+    {
+        returnStatus = MbedTLS_ConnectStep( pNetworkContext );
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t MbedTLS_ConnectStart( NetworkContext_t * pNetworkContext,
+                                           const ServerInfo_t * pServerInfo,
+                                           const NetworkCredentials_t * pNetworkCredentials,
+                                           uint32_t receiveTimeoutMs,
+                                           uint32_t sendTimeoutMs,
+                                           const SocketsConfig_t * pSocketsConfig )
+{
+    return connectStart( pNetworkContext,
+                         pServerInfo,
+                         pNetworkCredentials,
+                         receiveTimeoutMs,
+                         sendTimeoutMs,
+                         pSocketsConfig,
+                         true );
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t MbedTLS_ConnectStep( NetworkContext_t * pNetworkContext )
+{
+    TlsTransportParams_t * pTlsTransportParams = NULL;
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+
+    if( ( pNetworkContext == NULL ) ||
+        ( pNetworkContext->pParams == NULL ) )
+    {
+        LogError( ( "Invalid input parameter(s): Arguments cannot be NULL. pNetworkContext=%p.",
+                    pNetworkContext ) );
+        returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
+    }
+    else if( pNetworkContext->pParams->connect.inProgress == false )
+    {
+        LogError( ( "(Network connection %p) No connection is in progress.",
+                    pNetworkContext ) );
+        returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        pTlsTransportParams = pNetworkContext->pParams;
+
+        MbedTLSArena_SetOwner( &( pTlsTransportParams->memoryUsage ) );
+
+        returnStatus = advanceConnection( pNetworkContext );
+
+        MbedTLSArena_SetOwner( NULL );
     }
 
     return returnStatus;
@@ -798,6 +1675,15 @@ SocketStatus_t MbedTLS_Disconnect( NetworkContext_t * pNetworkContext )
     if( ( pNetworkContext != NULL ) && ( pNetworkContext->pParams != NULL ) )
     {
         pTlsTransportParams = pNetworkContext->pParams;
+
+        /* A connection still in progress may be abandoned. */
+        if( pTlsTransportParams->connect.inProgress == true )
+        {
+            pTlsTransportParams->connect.inProgress = false;
+            mbedtls_platform_zeroize( pTlsTransportParams->connect.offeredMasterSecret,
+                                      sizeof( pTlsTransportParams->connect.offeredMasterSecret ) );
+        }
+
         /* Attempting to terminate TLS connection. */
         tlsStatus = ( SocketStatus_t ) mbedtls_ssl_close_notify( &( pTlsTransportParams->sslContext.context ) );
 
@@ -838,19 +1724,15 @@ SocketStatus_t MbedTLS_Disconnect( NetworkContext_t * pNetworkContext )
 }
 /*-----------------------------------------------------------*/
 
-int32_t MbedTLS_recv( NetworkContext_t * pNetworkContext,
-                      void * pBuffer,
-                      size_t bytesToRecv )
+static int32_t readFromTls( TlsTransportParams_t * pTlsTransportParams,
+                            void * pBuffer,
+                            size_t bufferLength )
 {
-    TlsTransportParams_t * pTlsTransportParams = NULL;
     int32_t pollStatus = 1, tlsStatus = 0;
     uint8_t shouldRead = 0U;
+    bool newRecord = false;
     struct zsock_pollfd pollFds;
 
-    assert( ( pNetworkContext != NULL ) && ( pNetworkContext->pParams != NULL ) );
-
-    pTlsTransportParams = pNetworkContext->pParams;
-
     /* Initialize the file descriptor.
      * #ZSOCK_POLLPRI corresponds to high-priority data while #ZSOCK_POLLIN corresponds
      * to any other data that may be read. */
@@ -877,6 +1759,7 @@ int32_t MbedTLS_recv( NetworkContext_t * pNetworkContext,
          * Note: A timeout value of zero causes zsock_poll to not detect data on the socket
          * even across multiple re-tries. Thus, the smallest non-zero block time of 1ms is used. */
         pollStatus = zsock_poll( &pollFds, 1, 1 );
+        TransportMetrics_RecordPoll( &( pTlsTransportParams->metrics ), pollStatus );
 
         if( pollStatus < 0 )
         {
@@ -890,6 +1773,7 @@ int32_t MbedTLS_recv( NetworkContext_t * pNetworkContext,
         else
         {
             shouldRead = 1U;
+            newRecord = true;
         }
     }
 
@@ -897,7 +1781,14 @@ int32_t MbedTLS_recv( NetworkContext_t * pNetworkContext,
     {
         tlsStatus = ( int32_t ) mbedtls_ssl_read( &( pTlsTransportParams->sslContext.context ),
                                                   pBuffer,
-                                                  bytesToRecv );
+                                                  bufferLength );
+
+        /* Data returned when none was left of the previous record starts a
+         * new record. */
+        if( ( tlsStatus > 0 ) && ( newRecord == true ) )
+        {
+            TransportMetrics_RecordTlsRecords( &( pTlsTransportParams->metrics ), 1U, 0U );
+        }
 
         if( ( tlsStatus == MBEDTLS_ERR_SSL_TIMEOUT ) ||
             ( tlsStatus == MBEDTLS_ERR_SSL_WANT_READ ) ||
@@ -928,6 +1819,65 @@ int32_t MbedTLS_recv( NetworkContext_t * pNetworkContext,
 }
 /*-----------------------------------------------------------*/
 
+int32_t MbedTLS_recv( NetworkContext_t * pNetworkContext,
+                      void * pBuffer,
+                      size_t bytesToRecv )
+{
+    TlsTransportParams_t * pTlsTransportParams = NULL;
+    ReadAheadBuffer_t * pReadAhead = NULL;
+    int32_t tlsStatus = 0;
+    uint32_t startCycles = TransportMetrics_Now();
+
+    assert( ( pNetworkContext != NULL ) && ( pNetworkContext->pParams != NULL ) );
+
+    pTlsTransportParams = pNetworkContext->pParams;
+    pReadAhead = &( pTlsTransportParams->readAhead );
+
+    if( Sockets_ReadAheadPending( pReadAhead ) > 0U )
+    {
+        /* Serve the request from the bytes read ahead of time. */
+        tlsStatus = ( int32_t ) Sockets_ReadAheadCopy( pReadAhead, pBuffer, bytesToRecv );
+    }
+    else if( Sockets_ReadAheadShouldFill( pReadAhead, bytesToRecv ) == true )
+    {
+        /* Read as much of the current TLS record as fits into the read-ahead
+         * buffer, and return the requested part of it. */
+        tlsStatus = readFromTls( pTlsTransportParams,
+                                 pReadAhead->pBuffer,
+                                 pReadAhead->bufferSize );
+
+        if( tlsStatus > 0 )
+        {
+            pReadAhead->readIndex = 0U;
+            pReadAhead->fillLength = ( size_t ) tlsStatus;
+            tlsStatus = ( int32_t ) Sockets_ReadAheadCopy( pReadAhead, pBuffer, bytesToRecv );
+        }
+    }
+    else
+    {
+        tlsStatus = readFromTls( pTlsTransportParams, pBuffer, bytesToRecv );
+    }
+
+    TransportMetrics_RecordRecv( &( pTlsTransportParams->metrics ), tlsStatus, startCycles );
+
+    return tlsStatus;
+}
+/*-----------------------------------------------------------*/
+
+bool MbedTLS_HasPendingData( NetworkContext_t * pNetworkContext )
+{
+    bool dataPending = false;
+
+    if( ( pNetworkContext != NULL ) && ( pNetworkContext->pParams != NULL ) )
+    {
+        dataPending = ( Sockets_ReadAheadPending( &( pNetworkContext->pParams->readAhead ) ) > 0U ) ||
+                      ( mbedtls_ssl_check_pending( &( pNetworkContext->pParams->sslContext.context ) ) != 0 );
+    }
+
+    return dataPending;
+}
+/*-----------------------------------------------------------*/
+
 int32_t MbedTLS_send( NetworkContext_t * pNetworkContext,
                       const void * pBuffer,
                       size_t bytesToSend )
@@ -936,6 +1886,7 @@ int32_t MbedTLS_send( NetworkContext_t * pNetworkContext,
     int32_t tlsStatus = 0;
     struct zsock_pollfd pollFds;
     int32_t pollStatus;
+    uint32_t startCycles = TransportMetrics_Now();
 
     assert( ( pNetworkContext != NULL ) && ( pNetworkContext->pParams != NULL ) );
 
@@ -952,6 +1903,7 @@ int32_t MbedTLS_send( NetworkContext_t * pNetworkContext,
      * when TCP socket is not ready to accept more data for
      * network transmission (possibly due to a full TX buffer). */
     pollStatus = zsock_poll( &pollFds, 1, 0 );
+    TransportMetrics_RecordPoll( &( pTlsTransportParams->metrics ), pollStatus );
 
     if( pollStatus > 0 )
     {
@@ -980,7 +1932,8 @@ int32_t MbedTLS_send( NetworkContext_t * pNetworkContext,
         }
         else
         {
-            /* Empty else marker. */
+            /* mbedtls_ssl_write writes at most one record per call. */
+            TransportMetrics_RecordTlsRecords( &( pTlsTransportParams->metrics ), 0U, 1U );
         }
     }
     else if( pollStatus < 0 )
@@ -997,6 +1950,68 @@ int32_t MbedTLS_send( NetworkContext_t * pNetworkContext,
         tlsStatus = 0;
     }
 
+    TransportMetrics_RecordSend( &( pTlsTransportParams->metrics ), tlsStatus, startCycles );
+
+    return tlsStatus;
+}
+/*-----------------------------------------------------------*/
+
+int32_t MbedTLS_Writev( NetworkContext_t * pNetworkContext,
+                        TransportOutVector_t * pIoVec,
+                        size_t ioVecCount )
+{
+    TlsTransportParams_t * pTlsTransportParams = NULL;
+    int32_t tlsStatus = 0;
+    int32_t maxRecordPayload = 0;
+    size_t recordLimit = MBEDTLS_ZEPHYR_WRITEV_BUFFER_SIZE;
+    size_t bytesGathered = 0U, bytesToCopy = 0U, index = 0U;
+
+    assert( ( pNetworkContext != NULL ) && ( pNetworkContext->pParams != NULL ) );
+    assert( pIoVec != NULL );
+    assert( ioVecCount > 0 );
+
+    pTlsTransportParams = pNetworkContext->pParams;
+
+    /* A record cannot carry more than the negotiated maximum fragment length. */
+    maxRecordPayload = mbedtls_ssl_get_max_out_record_payload( &( pTlsTransportParams->sslContext.context ) );
+
+    if( ( maxRecordPayload > 0 ) && ( ( size_t ) maxRecordPayload < recordLimit ) )
+    {
+        recordLimit = ( size_t ) maxRecordPayload;
+    }
+
+    if( ( ioVecCount == 1U ) || ( pIoVec[ 0 ].iov_len >= recordLimit ) )
+    {
+        /* The first buffer fills a record on its own, so copying it would not
+         * save a record. */
+        tlsStatus = MbedTLS_send( pNetworkContext,
+                                  pIoVec[ 0 ].iov_base,
+                                  pIoVec[ 0 ].iov_len );
+    }
+    else
+    {
+        for( index = 0U; ( index < ioVecCount ) && ( bytesGathered < recordLimit ); index++ )
+        {
+            bytesToCopy = pIoVec[ index ].iov_len;
+
+            if( bytesToCopy > ( recordLimit - bytesGathered ) )
+            {
+                bytesToCopy = recordLimit - bytesGathered;
+            }
+
+            ( void ) memcpy( &( pTlsTransportParams->writevBuffer[ bytesGathered ] ),
+                             pIoVec[ index ].iov_base,
+                             bytesToCopy );
+            bytesGathered += bytesToCopy;
+        }
+
+        /* The caller resends whatever is not written, so a partial write keeps
+         * the stream consistent. */
+        tlsStatus = MbedTLS_send( pNetworkContext,
+                                  pTlsTransportParams->writevBuffer,
+                                  bytesGathered );
+    }
+
     return tlsStatus;
 }
 /*-----------------------------------------------------------*/
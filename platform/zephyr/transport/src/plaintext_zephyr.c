@@ -32,6 +32,16 @@
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Maximum number of buffers passed to a single zsock_sendmsg call by
+ * #Plaintext_Writev. Further buffers are left for the next call.
+ */
+#ifndef PLAINTEXT_WRITEV_MAX_VECTORS
+    #define PLAINTEXT_WRITEV_MAX_VECTORS    ( 8U )
+#endif
+
+/*-----------------------------------------------------------*/
+
 /* Each compilation unit must define the NetworkContext struct. */
 struct NetworkContext
 {
@@ -47,6 +57,23 @@ struct NetworkContext
  */
 static void logTransportError( int32_t errorNumber );
 
+/**
+ * @brief Receive data from the socket of a connection.
+ *
+ * @param[in] pPlaintextParams Parameters of the connection.
+ * @param[out] pBuffer Buffer to receive network data into.
+ * @param[in] bufferLength Maximum number of bytes to receive.
+ * @param[in] pollFirst Check that data is available before calling
+ * zsock_recv, so that the call does not block for the receive timeout.
+ *
+ * @return Number of bytes received if successful; 0 if no data is
+ * available; negative value on error.
+ */
+static int32_t receiveFromSocket( PlaintextParams_t * pPlaintextParams,
+                                  void * pBuffer,
+                                  size_t bufferLength,
+                                  bool pollFirst );
+
 /*-----------------------------------------------------------*/
 
 static void logTransportError( int32_t errorNumber )
@@ -61,7 +88,8 @@ static void logTransportError( int32_t errorNumber )
 SocketStatus_t Plaintext_Connect( NetworkContext_t * pNetworkContext,
                                   const ServerInfo_t * pServerInfo,
                                   uint32_t sendTimeoutMs,
-                                  uint32_t recvTimeoutMs )
+                                  uint32_t recvTimeoutMs,
+                                  const SocketsConfig_t * pSocketsConfig )
 {
     SocketStatus_t returnStatus = SOCKETS_SUCCESS;
     PlaintextParams_t * pPlaintextParams = NULL;
@@ -75,10 +103,12 @@ SocketStatus_t Plaintext_Connect( NetworkContext_t * pNetworkContext,
     else
     {
         pPlaintextParams = pNetworkContext->pParams;
+        Sockets_ReadAheadReset( &( pPlaintextParams->readAhead ) );
         returnStatus = Sockets_Connect( &pPlaintextParams->socketDescriptor,
                                         pServerInfo,
                                         sendTimeoutMs,
-                                        recvTimeoutMs );
+                                        recvTimeoutMs,
+                                        pSocketsConfig );
     }
 
     return returnStatus;
@@ -106,20 +136,14 @@ SocketStatus_t Plaintext_Disconnect( const NetworkContext_t * pNetworkContext )
 }
 /*-----------------------------------------------------------*/
 
-int32_t Plaintext_Recv( NetworkContext_t * pNetworkContext,
-                        void * pBuffer,
-                        size_t bytesToRecv )
+static int32_t receiveFromSocket( PlaintextParams_t * pPlaintextParams,
+                                  void * pBuffer,
+                                  size_t bufferLength,
+                                  bool pollFirst )
 {
-    PlaintextParams_t * pPlaintextParams = NULL;
     int32_t bytesReceived = -1, pollStatus = 1;
     struct zsock_pollfd pollFds;
 
-    assert( pNetworkContext != NULL && pNetworkContext->pParams != NULL );
-    assert( pBuffer != NULL );
-    assert( bytesToRecv > 0 );
-
-    pPlaintextParams = pNetworkContext->pParams;
-
     /* Initialize the file descriptor.
      * #ZSOCK_POLLPRI corresponds to high-priority data while #ZSOCK_POLLIN corresponds
      * to any other data that may be read. */
@@ -131,12 +155,13 @@ int32_t Plaintext_Recv( NetworkContext_t * pNetworkContext,
     /* Speculative read for the start of a payload.
      * Note: This is done to avoid blocking when
      * no data is available to be read from the socket. */
-    if( bytesToRecv == 1U )
+    if( pollFirst == true )
     {
         /* Check if there is data to read (without blocking) from the socket.
          * Note: A timeout value of zero causes zsock_poll to not detect data on the socket
          * even across multiple re-tries. Thus, the smallest non-zero block time of 1ms is used. */
         pollStatus = zsock_poll( &pollFds, 1, 1 );
+        TransportMetrics_RecordPoll( &( pPlaintextParams->metrics ), pollStatus );
     }
 
     if( pollStatus > 0 )
@@ -144,7 +169,7 @@ int32_t Plaintext_Recv( NetworkContext_t * pNetworkContext,
         /* The socket is available for receiving data. */
         bytesReceived = ( int32_t ) zsock_recv( pPlaintextParams->socketDescriptor,
                                                 pBuffer,
-                                                bytesToRecv,
+                                                bufferLength,
                                                 0 );
     }
     else if( pollStatus < 0 )
@@ -165,6 +190,11 @@ int32_t Plaintext_Recv( NetworkContext_t * pNetworkContext,
         /* Peer has closed the connection. Treat as an error. */
         bytesReceived = -1;
     }
+    else if( ( bytesReceived < 0 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
+    {
+        /* The receive timeout of the socket expired. The caller may retry. */
+        bytesReceived = 0;
+    }
     else if( bytesReceived < 0 )
     {
         logTransportError( errno );
@@ -174,6 +204,65 @@ int32_t Plaintext_Recv( NetworkContext_t * pNetworkContext,
 }
 /*-----------------------------------------------------------*/
 
+int32_t Plaintext_Recv( NetworkContext_t * pNetworkContext,
+                        void * pBuffer,
+                        size_t bytesToRecv )
+{
+    PlaintextParams_t * pPlaintextParams = NULL;
+    ReadAheadBuffer_t * pReadAhead = NULL;
+    int32_t bytesReceived = -1;
+    uint32_t startCycles = TransportMetrics_Now();
+
+    assert( pNetworkContext != NULL && pNetworkContext->pParams != NULL );
+    assert( pBuffer != NULL );
+    assert( bytesToRecv > 0 );
+
+    pPlaintextParams = pNetworkContext->pParams;
+    pReadAhead = &( pPlaintextParams->readAhead );
+
+    if( Sockets_ReadAheadPending( pReadAhead ) > 0U )
+    {
+        /* Serve the request from the bytes read ahead of time. */
+        bytesReceived = ( int32_t ) Sockets_ReadAheadCopy( pReadAhead, pBuffer, bytesToRecv );
+    }
+    else if( Sockets_ReadAheadShouldFill( pReadAhead, bytesToRecv ) == true )
+    {
+        /* Read everything the socket has available, up to the size of the
+         * read-ahead buffer, and return the requested part of it. */
+        bytesReceived = receiveFromSocket( pPlaintextParams,
+                                           pReadAhead->pBuffer,
+                                           pReadAhead->bufferSize,
+                                           ( bytesToRecv == 1U ) );
+
+        if( bytesReceived > 0 )
+        {
+            pReadAhead->readIndex = 0U;
+            pReadAhead->fillLength = ( size_t ) bytesReceived;
+            bytesReceived = ( int32_t ) Sockets_ReadAheadCopy( pReadAhead, pBuffer, bytesToRecv );
+        }
+    }
+    else
+    {
+        bytesReceived = receiveFromSocket( pPlaintextParams,
+                                           pBuffer,
+                                           bytesToRecv,
+                                           ( bytesToRecv == 1U ) );
+    }
+
+    TransportMetrics_RecordRecv( &( pPlaintextParams->metrics ), bytesReceived, startCycles );
+
+    return bytesReceived;
+}
+/*-----------------------------------------------------------*/
+
+bool Plaintext_HasPendingData( NetworkContext_t * pNetworkContext )
+{
+    assert( ( pNetworkContext != NULL ) && ( pNetworkContext->pParams != NULL ) );
+
+    return Sockets_ReadAheadPending( &( pNetworkContext->pParams->readAhead ) ) > 0U;
+}
+/*-----------------------------------------------------------*/
+
 int32_t Plaintext_Send( NetworkContext_t * pNetworkContext,
                         const void * pBuffer,
                         size_t bytesToSend )
@@ -181,6 +270,7 @@ int32_t Plaintext_Send( NetworkContext_t * pNetworkContext,
     PlaintextParams_t * pPlaintextParams = NULL;
     int32_t bytesSent = -1, pollStatus = -1;
     struct zsock_pollfd pollFds;
+    uint32_t startCycles = TransportMetrics_Now();
 
     assert( pNetworkContext != NULL && pNetworkContext->pParams != NULL );
     assert( pBuffer != NULL );
@@ -199,6 +289,7 @@ int32_t Plaintext_Send( NetworkContext_t * pNetworkContext,
      * the socket is not ready to accept more data for network
      * transmission (possibly due to a full TX buffer). */
     pollStatus = zsock_poll( &pollFds, 1, 0 );
+    TransportMetrics_RecordPoll( &( pPlaintextParams->metrics ), pollStatus );
 
     if( pollStatus > 0 )
     {
@@ -224,11 +315,114 @@ int32_t Plaintext_Send( NetworkContext_t * pNetworkContext,
         /* Peer has closed the connection. Treat as an error. */
         bytesSent = -1;
     }
+    else if( ( bytesSent < 0 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
+    {
+        /* The send buffer filled up, or the send timeout of the socket
+         * expired. The caller may retry, as with the TLS transport. */
+        bytesSent = 0;
+    }
     else if( bytesSent < 0 )
     {
         logTransportError( errno );
     }
 
+    TransportMetrics_RecordSend( &( pPlaintextParams->metrics ), bytesSent, startCycles );
+
+    return bytesSent;
+}
+/*-----------------------------------------------------------*/
+
+int32_t Plaintext_Writev( NetworkContext_t * pNetworkContext,
+                          TransportOutVector_t * pIoVec,
+                          size_t ioVecCount )
+{
+    PlaintextParams_t * pPlaintextParams = NULL;
+    int32_t bytesSent = -1, pollStatus = -1;
+    struct zsock_pollfd pollFds;
+    struct iovec socketIoVec[ PLAINTEXT_WRITEV_MAX_VECTORS ];
+    struct msghdr message;
+    size_t index = 0U, bytesToSend = 0U;
+    uint32_t startCycles = TransportMetrics_Now();
+
+    assert( pNetworkContext != NULL && pNetworkContext->pParams != NULL );
+    assert( pIoVec != NULL );
+    assert( ioVecCount > 0 );
+
+    pPlaintextParams = pNetworkContext->pParams;
+
+    /* Send at most #PLAINTEXT_WRITEV_MAX_VECTORS buffers. The caller sends the
+     * rest, as it would after any other partial send. */
+    if( ioVecCount > PLAINTEXT_WRITEV_MAX_VECTORS )
+    {
+        ioVecCount = PLAINTEXT_WRITEV_MAX_VECTORS;
+    }
+
+    for( index = 0U; index < ioVecCount; index++ )
+    {
+        socketIoVec[ index ].iov_base = ( void * ) pIoVec[ index ].iov_base;
+        socketIoVec[ index ].iov_len = pIoVec[ index ].iov_len;
+        bytesToSend += pIoVec[ index ].iov_len;
+    }
+
+    ( void ) memset( &message, 0, sizeof( message ) );
+    message.msg_iov = socketIoVec;
+    message.msg_iovlen = ioVecCount;
+
+    /* Initialize the file descriptor. */
+    pollFds.events = ZSOCK_POLLOUT;
+    pollFds.revents = 0;
+    /* Set the file descriptor for poll. */
+    pollFds.fd = pPlaintextParams->socketDescriptor;
+
+    /* Check if data can be written to the socket, as in Plaintext_Send. */
+    pollStatus = zsock_poll( &pollFds, 1, 0 );
+    TransportMetrics_RecordPoll( &( pPlaintextParams->metrics ), pollStatus );
+
+    if( bytesToSend == 0U )
+    {
+        /* Nothing to send. */
+        bytesSent = 0;
+    }
+    else if( pollStatus > 0 )
+    {
+        /* The socket is available for sending data. */
+        bytesSent = ( int32_t ) zsock_sendmsg( pPlaintextParams->socketDescriptor,
+                                               &message,
+                                               0 );
+
+        if( bytesSent == 0 )
+        {
+            /* Peer has closed the connection. Treat as an error. */
+            bytesSent = -1;
+        }
+        else if( ( bytesSent < 0 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
+        {
+            /* The caller may retry, as in Plaintext_Send. */
+            bytesSent = 0;
+        }
+        else if( bytesSent < 0 )
+        {
+            logTransportError( errno );
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+    else if( pollStatus < 0 )
+    {
+        /* An error occurred while polling. */
+        logTransportError( errno );
+        bytesSent = -1;
+    }
+    else
+    {
+        /* Socket is not available for sending data. */
+        bytesSent = 0;
+    }
+
+    TransportMetrics_RecordSend( &( pPlaintextParams->metrics ), bytesSent, startCycles );
+
     return bytesSent;
 }
 /*-----------------------------------------------------------*/
@@ -25,6 +25,10 @@
 #include <string.h>
 #include <errno.h>
 
+/* Zephyr includes. */
+#include <kernel.h>
+#include <fcntl.h>
+
 /* Zephyr socket includes */
 #include <net/socket.h>
 
@@ -42,6 +46,126 @@
  */
 #define ONE_MS_TO_US     ( 1000 )
 
+/**
+ * @brief Set to 1 to connect with the RFC 8305 ("Happy Eyeballs") algorithm:
+ * several resolved addresses are tried in parallel, started a short delay
+ * apart, alternating between address families. Set to 0 to try one address
+ * after the other with a blocking connect.
+ */
+#ifndef SOCKETS_HAPPY_EYEBALLS
+    #define SOCKETS_HAPPY_EYEBALLS    ( 1 )
+#endif
+
+/**
+ * @brief Delay before a connection attempt to the next address is started
+ * while the previous attempts are still in progress. RFC 8305 recommends
+ * 250 milliseconds.
+ */
+#ifndef SOCKETS_CONNECT_ATTEMPT_DELAY_MS
+    #define SOCKETS_CONNECT_ATTEMPT_DELAY_MS    ( 250 )
+#endif
+
+/**
+ * @brief Time after which a connection attempt to one address is abandoned.
+ */
+#ifndef SOCKETS_CONNECT_ATTEMPT_TIMEOUT_MS
+    #define SOCKETS_CONNECT_ATTEMPT_TIMEOUT_MS    ( 3000 )
+#endif
+
+/**
+ * @brief Maximum number of connection attempts in progress at the same time.
+ */
+#ifndef SOCKETS_MAX_PARALLEL_CONNECTS
+    #define SOCKETS_MAX_PARALLEL_CONNECTS    ( 3U )
+#endif
+
+/**
+ * @brief Maximum number of resolved addresses that are tried.
+ */
+#ifndef SOCKETS_MAX_CONNECT_ADDRESSES
+    #define SOCKETS_MAX_CONNECT_ADDRESSES    ( 8U )
+#endif
+
+/**
+ * @brief Number of host names whose resolved addresses are cached. Set to 0 to
+ * resolve the host name on every connection.
+ */
+#ifndef SOCKETS_DNS_CACHE_SIZE
+    #define SOCKETS_DNS_CACHE_SIZE    ( 2U )
+#endif
+
+/**
+ * @brief Maximum number of resolved addresses cached for a host name.
+ */
+#ifndef SOCKETS_DNS_CACHE_MAX_ADDRESSES
+    #define SOCKETS_DNS_CACHE_MAX_ADDRESSES    ( 4U )
+#endif
+
+/**
+ * @brief Maximum length of a host name that can be cached.
+ */
+#ifndef SOCKETS_DNS_CACHE_HOSTNAME_LENGTH
+    #define SOCKETS_DNS_CACHE_HOSTNAME_LENGTH    ( 128U )
+#endif
+
+/**
+ * @brief Time for which resolved addresses are reused.
+ *
+ * @note zsock_getaddrinfo does not report the TTL of the DNS records, so the
+ * same lifetime applies to every host name.
+ */
+#ifndef SOCKETS_DNS_CACHE_TTL_MS
+    #define SOCKETS_DNS_CACHE_TTL_MS    ( 300000 )
+#endif
+
+/**
+ * @brief Time for which a failure to resolve a host name is reused, before
+ * the host name is resolved again.
+ */
+#ifndef SOCKETS_DNS_CACHE_NEGATIVE_TTL_MS
+    #define SOCKETS_DNS_CACHE_NEGATIVE_TTL_MS    ( 10000 )
+#endif
+
+/*-----------------------------------------------------------*/
+
+#if ( SOCKETS_DNS_CACHE_SIZE > 0U )
+
+/**
+ * @brief Resolved addresses of a host name, or the failure to resolve it.
+ */
+    typedef struct DnsCacheEntry
+    {
+        char hostName[ SOCKETS_DNS_CACHE_HOSTNAME_LENGTH ];                    /**< @brief Host name, not NULL-terminated. */
+        size_t hostNameLength;                                                 /**< @brief Length of #DnsCacheEntry_t.hostName. */
+        bool valid;                                                            /**< @brief Whether the entry is in use. */
+        int64_t expiryTimeMs;                                                  /**< @brief Uptime at which the entry expires. */
+        size_t addressCount;                                                   /**< @brief Number of addresses; 0 if the host name failed to resolve. */
+        struct zsock_addrinfo addresses[ SOCKETS_DNS_CACHE_MAX_ADDRESSES ];    /**< @brief Resolved addresses. */
+    } DnsCacheEntry_t;
+
+/**
+ * @brief Cached host names.
+ */
+    static DnsCacheEntry_t dnsCache[ SOCKETS_DNS_CACHE_SIZE ];
+
+/**
+ * @brief Mutex protecting #dnsCache from concurrent connections.
+ */
+    K_MUTEX_DEFINE( dnsCacheMutex );
+#endif /* if ( SOCKETS_DNS_CACHE_SIZE > 0U ) */
+
+#if ( SOCKETS_HAPPY_EYEBALLS == 1 )
+
+/**
+ * @brief A connection attempt in progress.
+ */
+    typedef struct ConnectAttempt
+    {
+        int32_t tcpSocket;   /**< @brief Socket of the attempt, in non-blocking mode. */
+        int64_t startTimeMs; /**< @brief Uptime at which the attempt was started. */
+    } ConnectAttempt_t;
+#endif
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -58,6 +182,51 @@ static SocketStatus_t resolveHostName( const char * pHostName,
                                        size_t hostNameLength,
                                        struct zsock_addrinfo ** pListHead );
 
+#if ( SOCKETS_DNS_CACHE_SIZE > 0U )
+
+/**
+ * @brief Find the unexpired cache entry of a host name.
+ *
+ * @note #dnsCacheMutex must be held by the caller.
+ *
+ * @param[in] pHostName Server host name.
+ * @param[in] hostNameLength Length associated with host name.
+ *
+ * @return The cache entry; NULL if the host name is not cached.
+ */
+    static DnsCacheEntry_t * findDnsCacheEntry( const char * pHostName,
+                                                size_t hostNameLength );
+
+/**
+ * @brief Look up the resolved addresses of a host name in the cache.
+ *
+ * @param[in] pHostName Server host name.
+ * @param[in] hostNameLength Length associated with host name.
+ * @param[out] pAddresses Array of #SOCKETS_DNS_CACHE_MAX_ADDRESSES records
+ * to copy the cached addresses into, linked as a list.
+ * @param[out] pCacheHit Set to true if the host name is cached.
+ *
+ * @return #SOCKETS_SUCCESS if the host name is not cached or resolved to
+ * addresses; #SOCKETS_DNS_FAILURE if it is cached as failing to resolve.
+ */
+    static SocketStatus_t lookupDnsCache( const char * pHostName,
+                                          size_t hostNameLength,
+                                          struct zsock_addrinfo * pAddresses,
+                                          bool * pCacheHit );
+
+/**
+ * @brief Store the result of resolving a host name in the cache.
+ *
+ * @param[in] pHostName Server host name.
+ * @param[in] hostNameLength Length associated with host name.
+ * @param[in] pListHead Resolved DNS records; NULL if the host name failed
+ * to resolve.
+ */
+    static void storeDnsCache( const char * pHostName,
+                               size_t hostNameLength,
+                               const struct zsock_addrinfo * pListHead );
+#endif /* if ( SOCKETS_DNS_CACHE_SIZE > 0U ) */
+
 /**
  * @brief Traverse list of DNS records until a connection is established.
  *
@@ -65,16 +234,55 @@ static SocketStatus_t resolveHostName( const char * pHostName,
  * @param[in] pHostName Server host name.
  * @param[in] hostNameLength Length associated with host name.
  * @param[in] port Server port in host-order.
+ * @param[in] connectTimeoutMs Time after which a connection attempt to one
+ * address is abandoned; 0 for #SOCKETS_CONNECT_ATTEMPT_TIMEOUT_MS.
+ * @param[in] pProtocol Protocol of the sockets to create, or NULL for TCP.
  * @param[out] pTcpSocket The output parameter to return the created socket.
  *
- * @return #SOCKETS_SUCCESS if successful; #SOCKETS_CONNECT_FAILURE on error.
+ * @return #SOCKETS_SUCCESS if successful; #SOCKETS_CONNECT_FAILURE or the
+ * status of SocketsProtocol_t.prepare on error.
  */
 static SocketStatus_t attemptConnection( struct zsock_addrinfo * pListHead,
                                          const char * pHostName,
                                          size_t hostNameLength,
                                          uint16_t port,
+                                         uint32_t connectTimeoutMs,
+                                         const SocketsProtocol_t * pProtocol,
                                          int32_t * pTcpSocket );
 
+/**
+ * @brief Set an integer socket option, logging a warning on failure.
+ *
+ * @param[in] tcpSocket The socket descriptor.
+ * @param[in] level Protocol level of the option.
+ * @param[in] option The option.
+ * @param[in] value Value of the option.
+ *
+ * @return 0 if successful; -1 on error.
+ */
+static int32_t setIntegerOption( int32_t tcpSocket,
+                                 int32_t level,
+                                 int32_t option,
+                                 int32_t value );
+
+/**
+ * @brief Apply the send and receive timeouts and the tuning profile to a
+ * connected socket.
+ *
+ * @param[in] tcpSocket The socket descriptor.
+ * @param[in] sendTimeoutMs Timeout for transport send; 0 for no timeout.
+ * @param[in] recvTimeoutMs Timeout for transport recv; 0 for no timeout.
+ * @param[in] pSocketsConfig Tuning profile, or NULL.
+ *
+ * @return #SOCKETS_SUCCESS if successful; #SOCKETS_API_ERROR if a timeout
+ * could not be set. Tuning options that the network stack does not support
+ * are skipped with a warning.
+ */
+static SocketStatus_t configureSocket( int32_t tcpSocket,
+                                       uint32_t sendTimeoutMs,
+                                       uint32_t recvTimeoutMs,
+                                       const SocketsConfig_t * pSocketsConfig );
+
 /**
  * @brief Connect to server using the provided address record.
  *
@@ -88,6 +296,118 @@ static SocketStatus_t connectToAddress( struct sockaddr * pAddrInfo,
                                         uint16_t port,
                                         int32_t tcpSocket );
 
+/**
+ * @brief Connect to the resolved addresses one after the other with blocking
+ * connects, until one succeeds.
+ *
+ * @param[in] pListHead List containing resolved DNS records.
+ * @param[in] port Server port in host-order.
+ * @param[in] pProtocol Protocol of the sockets to create, or NULL for the
+ * protocol of the DNS records.
+ * @param[out] pTcpSocket The output parameter to return the created socket.
+ *
+ * @return #SOCKETS_SUCCESS if successful; #SOCKETS_CONNECT_FAILURE if no
+ * address could be connected; the status of SocketsProtocol_t.prepare if it
+ * failed.
+ */
+static SocketStatus_t connectSequentially( const struct zsock_addrinfo * pListHead,
+                                           uint16_t port,
+                                           const SocketsProtocol_t * pProtocol,
+                                           int32_t * pTcpSocket );
+
+/**
+ * @brief Set the port of an address record and format its IP address.
+ *
+ * @param[in, out] pAddrInfo Address record of the server.
+ * @param[in] port Server port in host-order.
+ * @param[out] pIpAddress Buffer of #INET6_ADDRSTRLEN bytes to return the IP
+ * address as a string, for logging.
+ *
+ * @return Length of the address record.
+ */
+static socklen_t setAddressPort( struct sockaddr * pAddrInfo,
+                                 uint16_t port,
+                                 char * pIpAddress );
+
+#if ( SOCKETS_HAPPY_EYEBALLS == 1 )
+
+/**
+ * @brief Order resolved addresses for connection, alternating between the
+ * address family of the first record and the other family, as RFC 8305
+ * recommends.
+ *
+ * @param[in] pListHead List containing resolved DNS records.
+ * @param[out] pAddresses Array to return the ordered records.
+ *
+ * @return Number of records in @p pAddresses, at most
+ * #SOCKETS_MAX_CONNECT_ADDRESSES.
+ */
+    static size_t orderAddresses( const struct zsock_addrinfo * pListHead,
+                                  const struct zsock_addrinfo ** pAddresses );
+
+/**
+ * @brief Start a non-blocking connection to an address.
+ *
+ * @param[in] pAddress Address record of the server.
+ * @param[in] port Server port in host-order.
+ * @param[out] pConnected Set to true if the connection completed immediately.
+ *
+ * @return The socket of the attempt; -1 if the attempt failed.
+ */
+    static int32_t startConnect( const struct zsock_addrinfo * pAddress,
+                                 uint16_t port,
+                                 bool * pConnected );
+
+/**
+ * @brief Close a connection attempt and remove it from the attempts in progress.
+ *
+ * @param[in, out] pAttempts Attempts in progress, oldest first.
+ * @param[in, out] pAttemptCount Number of attempts in @p pAttempts.
+ * @param[in] index Index of the attempt to remove.
+ * @param[in] closeSocket Whether the socket of the attempt is closed.
+ */
+    static void removeAttempt( ConnectAttempt_t * pAttempts,
+                               size_t * pAttemptCount,
+                               size_t index,
+                               bool closeSocket );
+
+/**
+ * @brief Wait for one of the connection attempts in progress to complete.
+ *
+ * Attempts that fail or time out are removed.
+ *
+ * @param[in, out] pAttempts Attempts in progress, oldest first.
+ * @param[in, out] pAttemptCount Number of attempts in @p pAttempts.
+ * @param[in] timeoutMs Maximum time to wait.
+ * @param[in] attemptTimeoutMs Time after which an attempt is abandoned.
+ * @param[out] pAttemptFailed Set to true if an attempt failed or timed out.
+ *
+ * @return The socket of the attempt that connected, which is removed from
+ * @p pAttempts; -1 if none connected.
+ */
+    static int32_t waitForConnect( ConnectAttempt_t * pAttempts,
+                                   size_t * pAttemptCount,
+                                   int32_t timeoutMs,
+                                   uint32_t attemptTimeoutMs,
+                                   bool * pAttemptFailed );
+
+/**
+ * @brief Connect to the first reachable address of a list of DNS records,
+ * trying several addresses in parallel.
+ *
+ * @param[in] pListHead List containing resolved DNS records.
+ * @param[in] port Server port in host-order.
+ * @param[in] attemptTimeoutMs Time after which an attempt is abandoned.
+ * @param[out] pTcpSocket The output parameter to return the connected socket.
+ *
+ * @return #SOCKETS_SUCCESS if successful; #SOCKETS_CONNECT_FAILURE on error.
+ */
+    static SocketStatus_t connectInParallel( const struct zsock_addrinfo * pListHead,
+                                             uint16_t port,
+                                             uint32_t attemptTimeoutMs,
+                                             int32_t * pTcpSocket );
+#endif /* if ( SOCKETS_HAPPY_EYEBALLS == 1 ) */
+
 /*-----------------------------------------------------------*/
 
 static SocketStatus_t resolveHostName( const char * pHostName,
@@ -129,13 +449,162 @@ static SocketStatus_t resolveHostName( const char * pHostName,
 }
 /*-----------------------------------------------------------*/
 
-static SocketStatus_t connectToAddress( struct sockaddr * pAddrInfo,
-                                        uint16_t port,
-                                        int32_t tcpSocket )
+#if ( SOCKETS_DNS_CACHE_SIZE > 0U )
+
+    static DnsCacheEntry_t * findDnsCacheEntry( const char * pHostName,
+                                                size_t hostNameLength )
+    {
+        DnsCacheEntry_t * pEntry = NULL;
+        int64_t nowMs = k_uptime_get();
+        size_t index = 0U;
+
+        for( index = 0U; index < SOCKETS_DNS_CACHE_SIZE; index++ )
+        {
+            if( ( dnsCache[ index ].valid == true ) &&
+                ( ( dnsCache[ index ].expiryTimeMs - nowMs ) <= 0 ) )
+            {
+                /* Drop expired entries as they are found. */
+                dnsCache[ index ].valid = false;
+            }
+
+            if( ( dnsCache[ index ].valid == true ) &&
+                ( dnsCache[ index ].hostNameLength == hostNameLength ) &&
+                ( memcmp( dnsCache[ index ].hostName, pHostName, hostNameLength ) == 0 ) )
+            {
+                pEntry = &( dnsCache[ index ] );
+            }
+        }
+
+        return pEntry;
+    }
+/*-----------------------------------------------------------*/
+
+    static SocketStatus_t lookupDnsCache( const char * pHostName,
+                                          size_t hostNameLength,
+                                          struct zsock_addrinfo * pAddresses,
+                                          bool * pCacheHit )
+    {
+        SocketStatus_t returnStatus = SOCKETS_SUCCESS;
+        const DnsCacheEntry_t * pEntry = NULL;
+        size_t index = 0U;
+
+        assert( pHostName != NULL );
+        assert( pAddresses != NULL );
+        assert( pCacheHit != NULL );
+
+        ( void ) k_mutex_lock( &dnsCacheMutex, K_FOREVER );
+
+        pEntry = findDnsCacheEntry( pHostName, hostNameLength );
+        *pCacheHit = ( pEntry != NULL );
+
+        if( pEntry != NULL )
+        {
+            /* Copy the records, so that the connection can modify them, and
+             * point them at their own copies of the address. */
+            for( index = 0U; index < pEntry->addressCount; index++ )
+            {
+                pAddresses[ index ] = pEntry->addresses[ index ];
+                pAddresses[ index ].ai_addr = &( pAddresses[ index ]._ai_addr );
+                pAddresses[ index ].ai_next = ( ( index + 1U ) < pEntry->addressCount ) ?
+                                              &( pAddresses[ index + 1U ] ) : NULL;
+            }
+
+            if( pEntry->addressCount == 0U )
+            {
+                LogDebug( ( "Host name recently failed to resolve: Hostname=%.*s.",
+                            ( int32_t ) hostNameLength,
+                            pHostName ) );
+                returnStatus = SOCKETS_DNS_FAILURE;
+            }
+        }
+
+        ( void ) k_mutex_unlock( &dnsCacheMutex );
+
+        return returnStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    static void storeDnsCache( const char * pHostName,
+                               size_t hostNameLength,
+                               const struct zsock_addrinfo * pListHead )
+    {
+        DnsCacheEntry_t * pEntry = NULL;
+        const struct zsock_addrinfo * pIndex = NULL;
+        struct zsock_addrinfo * pAddress = NULL;
+        size_t index = 0U;
+
+        assert( pHostName != NULL );
+
+        if( hostNameLength <= SOCKETS_DNS_CACHE_HOSTNAME_LENGTH )
+        {
+            ( void ) k_mutex_lock( &dnsCacheMutex, K_FOREVER );
+
+            pEntry = findDnsCacheEntry( pHostName, hostNameLength );
+
+            /* Otherwise use a free entry, or the entry that expires first. */
+            for( index = 0U; ( pEntry == NULL ) && ( index < SOCKETS_DNS_CACHE_SIZE ); index++ )
+            {
+                if( dnsCache[ index ].valid == false )
+                {
+                    pEntry = &( dnsCache[ index ] );
+                }
+            }
+
+            if( pEntry == NULL )
+            {
+                pEntry = &( dnsCache[ 0 ] );
+
+                for( index = 1U; index < SOCKETS_DNS_CACHE_SIZE; index++ )
+                {
+                    if( dnsCache[ index ].expiryTimeMs < pEntry->expiryTimeMs )
+                    {
+                        pEntry = &( dnsCache[ index ] );
+                    }
+                }
+            }
+
+            ( void ) memcpy( pEntry->hostName, pHostName, hostNameLength );
+            pEntry->hostNameLength = hostNameLength;
+            pEntry->addressCount = 0U;
+
+            for( pIndex = pListHead;
+                 ( pIndex != NULL ) && ( pEntry->addressCount < SOCKETS_DNS_CACHE_MAX_ADDRESSES );
+                 pIndex = pIndex->ai_next )
+            {
+                if( ( pIndex->ai_addr != NULL ) &&
+                    ( pIndex->ai_addrlen <= sizeof( pAddress->_ai_addr ) ) )
+                {
+                    pAddress = &( pEntry->addresses[ pEntry->addressCount ] );
+                    ( void ) memset( pAddress, 0, sizeof( struct zsock_addrinfo ) );
+                    pAddress->ai_family = pIndex->ai_family;
+                    pAddress->ai_socktype = pIndex->ai_socktype;
+                    pAddress->ai_protocol = pIndex->ai_protocol;
+                    pAddress->ai_addrlen = pIndex->ai_addrlen;
+                    ( void ) memcpy( &( pAddress->_ai_addr ), pIndex->ai_addr, pIndex->ai_addrlen );
+                    pEntry->addressCount++;
+                }
+            }
+
+            pEntry->expiryTimeMs = k_uptime_get() +
+                                   ( ( pEntry->addressCount > 0U ) ? SOCKETS_DNS_CACHE_TTL_MS :
+                                     SOCKETS_DNS_CACHE_NEGATIVE_TTL_MS );
+            pEntry->valid = true;
+
+            ( void ) k_mutex_unlock( &dnsCacheMutex );
+        }
+        else
+        {
+            LogDebug( ( "Host name too long to cache its addresses: Length=%u.",
+                        ( unsigned int ) hostNameLength ) );
+        }
+    }
+/*-----------------------------------------------------------*/
+#endif /* if ( SOCKETS_DNS_CACHE_SIZE > 0U ) */
+
+static socklen_t setAddressPort( struct sockaddr * pAddrInfo,
+                                 uint16_t port,
+                                 char * pIpAddress )
 {
-    SocketStatus_t returnStatus = SOCKETS_SUCCESS;
-    int32_t connectStatus = 0;
-    char resolvedIpAddr[ INET6_ADDRSTRLEN ];
     socklen_t addrInfoLength;
     uint16_t netPort = 0;
     struct sockaddr_in * pIpv4Address;
@@ -143,7 +612,7 @@ static SocketStatus_t connectToAddress( struct sockaddr * pAddrInfo,
 
     assert( pAddrInfo != NULL );
     assert( pAddrInfo->sa_family == AF_INET || pAddrInfo->sa_family == AF_INET6 );
-    assert( tcpSocket >= 0 );
+    assert( pIpAddress != NULL );
 
     /* Convert port from host byte order to network byte order. */
     netPort = htons( port );
@@ -156,8 +625,8 @@ static SocketStatus_t connectToAddress( struct sockaddr * pAddrInfo,
         addrInfoLength = ( socklen_t ) sizeof( struct sockaddr_in );
         ( void ) zsock_inet_ntop( ( int32_t ) pAddrInfo->sa_family,
                                   &pIpv4Address->sin_addr,
-                                  resolvedIpAddr,
-                                  addrInfoLength );
+                                  pIpAddress,
+                                  INET6_ADDRSTRLEN );
     }
     else
     {
@@ -167,10 +636,28 @@ static SocketStatus_t connectToAddress( struct sockaddr * pAddrInfo,
         addrInfoLength = ( socklen_t ) sizeof( struct sockaddr_in6 );
         ( void ) zsock_inet_ntop( ( int32_t ) pAddrInfo->sa_family,
                                   &pIpv6Address->sin6_addr,
-                                  resolvedIpAddr,
-                                  addrInfoLength );
+                                  pIpAddress,
+                                  INET6_ADDRSTRLEN );
     }
 
+    return addrInfoLength;
+}
+/*-----------------------------------------------------------*/
+
+static SocketStatus_t connectToAddress( struct sockaddr * pAddrInfo,
+                                        uint16_t port,
+                                        int32_t tcpSocket )
+{
+    SocketStatus_t returnStatus = SOCKETS_SUCCESS;
+    int32_t connectStatus = 0;
+    char resolvedIpAddr[ INET6_ADDRSTRLEN ];
+    socklen_t addrInfoLength;
+
+    assert( pAddrInfo != NULL );
+    assert( tcpSocket >= 0 );
+
+    addrInfoLength = setAddressPort( pAddrInfo, port, resolvedIpAddr );
+
     LogDebug( ( "Attempting to connect to server using the resolved IP address:"
                 " IP address=%s.",
                 resolvedIpAddr ) );
@@ -190,14 +677,498 @@ static SocketStatus_t connectToAddress( struct sockaddr * pAddrInfo,
 }
 /*-----------------------------------------------------------*/
 
+static SocketStatus_t connectSequentially( const struct zsock_addrinfo * pListHead,
+                                           uint16_t port,
+                                           const SocketsProtocol_t * pProtocol,
+                                           int32_t * pTcpSocket )
+{
+    SocketStatus_t returnStatus = SOCKETS_CONNECT_FAILURE;
+    const struct zsock_addrinfo * pIndex = NULL;
+
+    for( pIndex = pListHead; pIndex != NULL; pIndex = pIndex->ai_next )
+    {
+        *pTcpSocket = zsock_socket( pIndex->ai_family,
+                                    pIndex->ai_socktype,
+                                    ( pProtocol != NULL ) ? pProtocol->protocol : pIndex->ai_protocol );
+
+        if( *pTcpSocket == -1 )
+        {
+            continue;
+        }
+
+        if( ( pProtocol != NULL ) && ( pProtocol->prepare != NULL ) )
+        {
+            returnStatus = pProtocol->prepare( *pTcpSocket, pProtocol->pPrepareContext );
+
+            if( returnStatus != SOCKETS_SUCCESS )
+            {
+                /* The options do not depend on the address, so the other
+                 * addresses would fail in the same way. */
+                ( void ) zsock_close( *pTcpSocket );
+                *pTcpSocket = -1;
+                break;
+            }
+        }
+
+        /* Attempt to connect to a resolved DNS address of the host. */
+        returnStatus = connectToAddress( pIndex->ai_addr, port, *pTcpSocket );
+
+        /* If connected to an IP address successfully, exit from the loop. */
+        if( returnStatus == SOCKETS_SUCCESS )
+        {
+            break;
+        }
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+#if ( SOCKETS_HAPPY_EYEBALLS == 1 )
+
+    static size_t orderAddresses( const struct zsock_addrinfo * pListHead,
+                                  const struct zsock_addrinfo ** pAddresses )
+    {
+        const struct zsock_addrinfo * pPreferred = pListHead;
+        const struct zsock_addrinfo * pOther = pListHead;
+        size_t addressCount = 0U;
+        bool preferredTurn = true;
+
+        assert( pListHead != NULL );
+        assert( pAddresses != NULL );
+
+        while( addressCount < SOCKETS_MAX_CONNECT_ADDRESSES )
+        {
+            /* Advance both cursors to their next record. */
+            while( ( pPreferred != NULL ) && ( pPreferred->ai_family != pListHead->ai_family ) )
+            {
+                pPreferred = pPreferred->ai_next;
+            }
+
+            while( ( pOther != NULL ) && ( pOther->ai_family == pListHead->ai_family ) )
+            {
+                pOther = pOther->ai_next;
+            }
+
+            if( ( pPreferred == NULL ) && ( pOther == NULL ) )
+            {
+                break;
+            }
+
+            /* Take the record of the family whose turn it is, or of the other
+             * family once the records of one family are exhausted. */
+            if( ( pOther == NULL ) || ( ( preferredTurn == true ) && ( pPreferred != NULL ) ) )
+            {
+                pAddresses[ addressCount ] = pPreferred;
+                pPreferred = pPreferred->ai_next;
+            }
+            else
+            {
+                pAddresses[ addressCount ] = pOther;
+                pOther = pOther->ai_next;
+            }
+
+            addressCount++;
+            preferredTurn = !preferredTurn;
+        }
+
+        return addressCount;
+    }
+/*-----------------------------------------------------------*/
+
+    static int32_t startConnect( const struct zsock_addrinfo * pAddress,
+                                 uint16_t port,
+                                 bool * pConnected )
+    {
+        int32_t tcpSocket = -1, connectStatus = -1;
+        char resolvedIpAddr[ INET6_ADDRSTRLEN ];
+        socklen_t addrInfoLength;
+
+        assert( pAddress != NULL );
+        assert( pConnected != NULL );
+
+        *pConnected = false;
+
+        tcpSocket = zsock_socket( pAddress->ai_family,
+                                  pAddress->ai_socktype,
+                                  pAddress->ai_protocol );
+
+        if( ( tcpSocket >= 0 ) && ( Sockets_SetBlocking( tcpSocket, false ) != SOCKETS_SUCCESS ) )
+        {
+            ( void ) zsock_close( tcpSocket );
+            tcpSocket = -1;
+        }
+
+        if( tcpSocket >= 0 )
+        {
+            addrInfoLength = setAddressPort( pAddress->ai_addr, port, resolvedIpAddr );
+
+            LogDebug( ( "Starting connection to server using the resolved IP address:"
+                        " IP address=%s.",
+                        resolvedIpAddr ) );
+
+            connectStatus = zsock_connect( tcpSocket, pAddress->ai_addr, addrInfoLength );
+
+            if( connectStatus == 0 )
+            {
+                *pConnected = true;
+            }
+            else if( errno != EINPROGRESS )
+            {
+                LogWarn( ( "Failed to connect to server using the resolved IP address: IP address=%s.",
+                           resolvedIpAddr ) );
+                ( void ) zsock_close( tcpSocket );
+                tcpSocket = -1;
+            }
+            else
+            {
+                /* Empty else marker. */
+            }
+        }
+
+        return tcpSocket;
+    }
+/*-----------------------------------------------------------*/
+
+    static void removeAttempt( ConnectAttempt_t * pAttempts,
+                               size_t * pAttemptCount,
+                               size_t index,
+                               bool closeSocket )
+    {
+        assert( pAttempts != NULL );
+        assert( pAttemptCount != NULL );
+        assert( index < *pAttemptCount );
+
+        if( closeSocket == true )
+        {
+            ( void ) zsock_close( pAttempts[ index ].tcpSocket );
+        }
+
+        /* Keep the remaining attempts ordered from the oldest. */
+        ( void ) memmove( &( pAttempts[ index ] ),
+                          &( pAttempts[ index + 1U ] ),
+                          ( *pAttemptCount - index - 1U ) * sizeof( ConnectAttempt_t ) );
+        ( *pAttemptCount )--;
+    }
+/*-----------------------------------------------------------*/
+
+    static int32_t waitForConnect( ConnectAttempt_t * pAttempts,
+                                   size_t * pAttemptCount,
+                                   int32_t timeoutMs,
+                                   uint32_t attemptTimeoutMs,
+                                   bool * pAttemptFailed )
+    {
+        struct zsock_pollfd pollFds[ SOCKETS_MAX_PARALLEL_CONNECTS ];
+        int32_t tcpSocket = -1, pollStatus = 0, socketError = 0;
+        socklen_t socketErrorLength;
+        size_t pollIndex = 0U, attemptIndex = 0U, pollCount = *pAttemptCount;
+        int64_t nowMs = 0;
+        bool connected = false;
+
+        assert( pAttempts != NULL );
+        assert( *pAttemptCount > 0U );
+        assert( *pAttemptCount <= SOCKETS_MAX_PARALLEL_CONNECTS );
+        assert( pAttemptFailed != NULL );
+
+        *pAttemptFailed = false;
+
+        for( pollIndex = 0U; pollIndex < pollCount; pollIndex++ )
+        {
+            /* A non-blocking connect completes when the socket becomes writable. */
+            pollFds[ pollIndex ].fd = pAttempts[ pollIndex ].tcpSocket;
+            pollFds[ pollIndex ].events = ZSOCK_POLLOUT;
+            pollFds[ pollIndex ].revents = 0;
+        }
+
+        pollStatus = zsock_poll( pollFds, ( int ) pollCount, timeoutMs );
+        nowMs = k_uptime_get();
+
+        if( pollStatus < 0 )
+        {
+            LogError( ( "Failed to poll the connection attempts: errno=%d.", errno ) );
+        }
+
+        /* Removing an attempt shifts the later ones, so the attempts are
+         * indexed separately from the poll results. Older attempts are
+         * checked first, so they win over later ones that complete at the
+         * same time. */
+        for( pollIndex = 0U; pollIndex < pollCount; pollIndex++ )
+        {
+            if( ( pollStatus > 0 ) && ( pollFds[ pollIndex ].revents != 0 ) )
+            {
+                socketErrorLength = ( socklen_t ) sizeof( socketError );
+                connected = ( zsock_getsockopt( pAttempts[ attemptIndex ].tcpSocket,
+                                                SOL_SOCKET,
+                                                SO_ERROR,
+                                                &socketError,
+                                                &socketErrorLength ) == 0 ) &&
+                            ( socketError == 0 );
+
+                if( connected == false )
+                {
+                    LogWarn( ( "Connection attempt failed: SocketError=%d.", socketError ) );
+                    removeAttempt( pAttempts, pAttemptCount, attemptIndex, true );
+                    *pAttemptFailed = true;
+                }
+                else if( tcpSocket == -1 )
+                {
+                    tcpSocket = pAttempts[ attemptIndex ].tcpSocket;
+                    removeAttempt( pAttempts, pAttemptCount, attemptIndex, false );
+                }
+                else
+                {
+                    /* Another attempt connected first. The caller closes this one
+                     * with the attempts still in progress. */
+                    attemptIndex++;
+                }
+            }
+            else if( ( pollStatus < 0 ) ||
+                     ( ( nowMs - pAttempts[ attemptIndex ].startTimeMs ) >= ( int64_t ) attemptTimeoutMs ) )
+            {
+                LogWarn( ( "Connection attempt abandoned after %d ms.",
+                           ( int32_t ) ( nowMs - pAttempts[ attemptIndex ].startTimeMs ) ) );
+                removeAttempt( pAttempts, pAttemptCount, attemptIndex, true );
+                *pAttemptFailed = true;
+            }
+            else
+            {
+                attemptIndex++;
+            }
+        }
+
+        return tcpSocket;
+    }
+/*-----------------------------------------------------------*/
+
+    static SocketStatus_t connectInParallel( const struct zsock_addrinfo * pListHead,
+                                             uint16_t port,
+                                             uint32_t attemptTimeoutMs,
+                                             int32_t * pTcpSocket )
+    {
+        const struct zsock_addrinfo * pAddresses[ SOCKETS_MAX_CONNECT_ADDRESSES ];
+        ConnectAttempt_t attempts[ SOCKETS_MAX_PARALLEL_CONNECTS ];
+        size_t addressCount = 0U, nextAddress = 0U, attemptCount = 0U;
+        int32_t tcpSocket = -1, timeoutMs = 0;
+        int64_t nowMs = 0, nextStartMs = 0;
+        bool connected = false, attemptFailed = false;
+
+        assert( pListHead != NULL );
+        assert( pTcpSocket != NULL );
+
+        addressCount = orderAddresses( pListHead, pAddresses );
+
+        while( ( tcpSocket == -1 ) && ( ( attemptCount > 0U ) || ( nextAddress < addressCount ) ) )
+        {
+            nowMs = k_uptime_get();
+
+            /* Start the next attempt when the delay since the previous one has
+             * elapsed, or right away when no attempt is in progress. */
+            if( ( nextAddress < addressCount ) &&
+                ( attemptCount < SOCKETS_MAX_PARALLEL_CONNECTS ) &&
+                ( ( attemptCount == 0U ) || ( nowMs >= nextStartMs ) ) )
+            {
+                tcpSocket = startConnect( pAddresses[ nextAddress ], port, &connected );
+                nextAddress++;
+
+                if( tcpSocket < 0 )
+                {
+                    /* Move on to the next address right away. */
+                    nextStartMs = nowMs;
+                }
+                else if( connected == false )
+                {
+                    attempts[ attemptCount ].tcpSocket = tcpSocket;
+                    attempts[ attemptCount ].startTimeMs = nowMs;
+                    attemptCount++;
+                    tcpSocket = -1;
+                    nextStartMs = nowMs + SOCKETS_CONNECT_ATTEMPT_DELAY_MS;
+                }
+                else
+                {
+                    /* Connected immediately. */
+                }
+            }
+            else if( attemptCount > 0U )
+            {
+                /* Wait until the oldest attempt times out, or until the next
+                 * attempt is due. */
+                timeoutMs = ( int32_t ) ( attempts[ 0 ].startTimeMs + ( int64_t ) attemptTimeoutMs - nowMs );
+
+                if( ( nextAddress < addressCount ) &&
+                    ( attemptCount < SOCKETS_MAX_PARALLEL_CONNECTS ) &&
+                    ( ( nextStartMs - nowMs ) < timeoutMs ) )
+                {
+                    timeoutMs = ( int32_t ) ( nextStartMs - nowMs );
+                }
+
+                if( timeoutMs < 0 )
+                {
+                    timeoutMs = 0;
+                }
+
+                tcpSocket = waitForConnect( attempts,
+                                            &attemptCount,
+                                            timeoutMs,
+                                            attemptTimeoutMs,
+                                            &attemptFailed );
+
+                if( attemptFailed == true )
+                {
+                    /* RFC 8305 starts the next attempt as soon as one fails. */
+                    nextStartMs = nowMs;
+                }
+            }
+            else
+            {
+                /* Empty else marker. */
+            }
+        }
+
+        /* Keep only the first socket that connected. */
+        while( attemptCount > 0U )
+        {
+            removeAttempt( attempts, &attemptCount, 0U, true );
+        }
+
+        /* Restore blocking mode, which the transports expect. */
+        if( ( tcpSocket >= 0 ) && ( Sockets_SetBlocking( tcpSocket, true ) != SOCKETS_SUCCESS ) )
+        {
+            ( void ) zsock_close( tcpSocket );
+            tcpSocket = -1;
+        }
+
+        *pTcpSocket = tcpSocket;
+
+        return ( tcpSocket >= 0 ) ? SOCKETS_SUCCESS : SOCKETS_CONNECT_FAILURE;
+    }
+/*-----------------------------------------------------------*/
+#endif /* if ( SOCKETS_HAPPY_EYEBALLS == 1 ) */
+
+static int32_t setIntegerOption( int32_t tcpSocket,
+                                 int32_t level,
+                                 int32_t option,
+                                 int32_t value )
+{
+    int32_t setOptStatus = -1;
+
+    setOptStatus = zsock_setsockopt( tcpSocket,
+                                     level,
+                                     option,
+                                     &value,
+                                     ( socklen_t ) sizeof( value ) );
+
+    if( setOptStatus < 0 )
+    {
+        LogWarn( ( "Failed to set socket option: Level=%d, Option=%d, errno=%d.",
+                   level,
+                   option,
+                   errno ) );
+    }
+
+    return setOptStatus;
+}
+/*-----------------------------------------------------------*/
+
+static SocketStatus_t configureSocket( int32_t tcpSocket,
+                                       uint32_t sendTimeoutMs,
+                                       uint32_t recvTimeoutMs,
+                                       const SocketsConfig_t * pSocketsConfig )
+{
+    SocketStatus_t returnStatus = SOCKETS_SUCCESS;
+    struct timeval transportTimeout;
+
+    assert( tcpSocket >= 0 );
+
+    /* A timeout of 0 means infinite timeout, which is the socket default. */
+    if( sendTimeoutMs > 0U )
+    {
+        transportTimeout.tv_sec = ( int32_t ) ( sendTimeoutMs / ONE_SEC_TO_MS );
+        transportTimeout.tv_usec = ( int32_t ) ( ONE_MS_TO_US * ( sendTimeoutMs % ONE_SEC_TO_MS ) );
+
+        if( zsock_setsockopt( tcpSocket,
+                              SOL_SOCKET,
+                              SO_SNDTIMEO,
+                              &transportTimeout,
+                              ( socklen_t ) sizeof( transportTimeout ) ) < 0 )
+        {
+            LogError( ( "Setting socket send timeout failed: errno=%d.", errno ) );
+            returnStatus = SOCKETS_API_ERROR;
+        }
+    }
+
+    if( ( returnStatus == SOCKETS_SUCCESS ) && ( recvTimeoutMs > 0U ) )
+    {
+        transportTimeout.tv_sec = ( int32_t ) ( recvTimeoutMs / ONE_SEC_TO_MS );
+        transportTimeout.tv_usec = ( int32_t ) ( ONE_MS_TO_US * ( recvTimeoutMs % ONE_SEC_TO_MS ) );
+
+        if( zsock_setsockopt( tcpSocket,
+                              SOL_SOCKET,
+                              SO_RCVTIMEO,
+                              &transportTimeout,
+                              ( socklen_t ) sizeof( transportTimeout ) ) < 0 )
+        {
+            LogError( ( "Setting socket receive timeout failed: errno=%d.", errno ) );
+            returnStatus = SOCKETS_API_ERROR;
+        }
+    }
+
+    /* The tuning options are best effort: a network stack built without
+     * support for one of them still provides a working connection. */
+    if( ( returnStatus == SOCKETS_SUCCESS ) && ( pSocketsConfig != NULL ) )
+    {
+        if( pSocketsConfig->noDelay == true )
+        {
+            ( void ) setIntegerOption( tcpSocket, IPPROTO_TCP, TCP_NODELAY, 1 );
+        }
+
+        if( pSocketsConfig->sendBufferSize > 0 )
+        {
+            ( void ) setIntegerOption( tcpSocket, SOL_SOCKET, SO_SNDBUF, pSocketsConfig->sendBufferSize );
+        }
+
+        if( pSocketsConfig->recvBufferSize > 0 )
+        {
+            ( void ) setIntegerOption( tcpSocket, SOL_SOCKET, SO_RCVBUF, pSocketsConfig->recvBufferSize );
+        }
+
+        if( pSocketsConfig->keepAlive == true )
+        {
+            ( void ) setIntegerOption( tcpSocket, SOL_SOCKET, SO_KEEPALIVE, 1 );
+
+            #if defined( TCP_KEEPIDLE ) && defined( TCP_KEEPINTVL ) && defined( TCP_KEEPCNT )
+                if( pSocketsConfig->keepAliveIdleSec > 0 )
+                {
+                    ( void ) setIntegerOption( tcpSocket, IPPROTO_TCP, TCP_KEEPIDLE, pSocketsConfig->keepAliveIdleSec );
+                }
+
+                if( pSocketsConfig->keepAliveIntervalSec > 0 )
+                {
+                    ( void ) setIntegerOption( tcpSocket, IPPROTO_TCP, TCP_KEEPINTVL, pSocketsConfig->keepAliveIntervalSec );
+                }
+
+                if( pSocketsConfig->keepAliveProbeCount > 0 )
+                {
+                    ( void ) setIntegerOption( tcpSocket, IPPROTO_TCP, TCP_KEEPCNT, pSocketsConfig->keepAliveProbeCount );
+                }
+            #else /* if defined( TCP_KEEPIDLE ) && defined( TCP_KEEPINTVL ) && defined( TCP_KEEPCNT ) */
+                LogDebug( ( "TCP keepalive timing options are not supported; using the stack defaults." ) );
+            #endif /* if defined( TCP_KEEPIDLE ) && defined( TCP_KEEPINTVL ) && defined( TCP_KEEPCNT ) */
+        }
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
 static SocketStatus_t attemptConnection( struct zsock_addrinfo * pListHead,
                                          const char * pHostName,
                                          size_t hostNameLength,
                                          uint16_t port,
+                                         uint32_t connectTimeoutMs,
+                                         const SocketsProtocol_t * pProtocol,
                                          int32_t * pTcpSocket )
 {
     SocketStatus_t returnStatus = SOCKETS_CONNECT_FAILURE;
-    const struct zsock_addrinfo * pIndex = NULL;
 
     assert( pListHead != NULL );
     assert( pHostName != NULL );
@@ -212,27 +1183,29 @@ static SocketStatus_t attemptConnection( struct zsock_addrinfo * pListHead,
                 ( int32_t ) hostNameLength,
                 pHostName ) );
 
-    /* Attempt to connect to one of the retrieved DNS records. */
-    for( pIndex = pListHead; pIndex != NULL; pIndex = pIndex->ai_next )
-    {
-        *pTcpSocket = zsock_socket( pIndex->ai_family,
-                                    pIndex->ai_socktype,
-                                    pIndex->ai_protocol );
-
-        if( *pTcpSocket == -1 )
+    #if ( SOCKETS_HAPPY_EYEBALLS == 1 )
+        if( pProtocol == NULL )
         {
-            continue;
+            /* Attempt to connect to several of the retrieved DNS records at once. */
+            returnStatus = connectInParallel( pListHead,
+                                              port,
+                                              ( connectTimeoutMs > 0U ) ? connectTimeoutMs :
+                                              SOCKETS_CONNECT_ATTEMPT_TIMEOUT_MS,
+                                              pTcpSocket );
         }
-
-        /* Attempt to connect to a resolved DNS address of the host. */
-        returnStatus = connectToAddress( pIndex->ai_addr, port, *pTcpSocket );
-
-        /* If connected to an IP address successfully, exit from the loop. */
-        if( returnStatus == SOCKETS_SUCCESS )
+        else
         {
-            break;
+            /* Secure sockets complete their handshake inside zsock_connect,
+             * which only a blocking connect supports. */
+            returnStatus = connectSequentially( pListHead, port, pProtocol, pTcpSocket );
         }
-    }
+    #else
+        /* The blocking connect is bounded by the network stack instead. */
+        ( void ) connectTimeoutMs;
+
+        /* Attempt to connect to one of the retrieved DNS records. */
+        returnStatus = connectSequentially( pListHead, port, pProtocol, pTcpSocket );
+    #endif /* if ( SOCKETS_HAPPY_EYEBALLS == 1 ) */
 
     if( returnStatus == SOCKETS_SUCCESS )
     {
@@ -247,8 +1220,6 @@ static SocketStatus_t attemptConnection( struct zsock_addrinfo * pListHead,
                     pHostName ) );
     }
 
-    zsock_freeaddrinfo( pListHead );
-
     return returnStatus;
 }
 /*-----------------------------------------------------------*/
@@ -256,10 +1227,32 @@ static SocketStatus_t attemptConnection( struct zsock_addrinfo * pListHead,
 SocketStatus_t Sockets_Connect( int32_t * pTcpSocket,
                                 const ServerInfo_t * pServerInfo,
                                 uint32_t sendTimeoutMs,
-                                uint32_t recvTimeoutMs )
+                                uint32_t recvTimeoutMs,
+                                const SocketsConfig_t * pSocketsConfig )
+{
+    return Sockets_ConnectWithProtocol( pTcpSocket,
+                                        pServerInfo,
+                                        sendTimeoutMs,
+                                        recvTimeoutMs,
+                                        pSocketsConfig,
+                                        NULL );
+}
+/*-----------------------------------------------------------*/
+
+SocketStatus_t Sockets_ConnectWithProtocol( int32_t * pTcpSocket,
+                                            const ServerInfo_t * pServerInfo,
+                                            uint32_t sendTimeoutMs,
+                                            uint32_t recvTimeoutMs,
+                                            const SocketsConfig_t * pSocketsConfig,
+                                            const SocketsProtocol_t * pProtocol )
 {
     SocketStatus_t returnStatus = SOCKETS_SUCCESS;
     struct zsock_addrinfo * pListHead = NULL;
+    bool cacheHit = false;
+
+    #if ( SOCKETS_DNS_CACHE_SIZE > 0U )
+        struct zsock_addrinfo cachedAddresses[ SOCKETS_DNS_CACHE_MAX_ADDRESSES ];
+    #endif
 
     if( pServerInfo == NULL )
     {
@@ -286,26 +1279,118 @@ SocketStatus_t Sockets_Connect( int32_t * pTcpSocket,
         /* Empty else. */
     }
 
-    if( returnStatus == SOCKETS_SUCCESS )
+    #if ( SOCKETS_DNS_CACHE_SIZE > 0U )
+        if( returnStatus == SOCKETS_SUCCESS )
+        {
+            returnStatus = lookupDnsCache( pServerInfo->pHostName,
+                                           pServerInfo->hostNameLength,
+                                           cachedAddresses,
+                                           &cacheHit );
+        }
+    #endif
+
+    if( ( returnStatus == SOCKETS_SUCCESS ) && ( cacheHit == false ) )
     {
         returnStatus = resolveHostName( pServerInfo->pHostName,
                                         pServerInfo->hostNameLength,
                                         &pListHead );
+
+        #if ( SOCKETS_DNS_CACHE_SIZE > 0U )
+            if( ( returnStatus == SOCKETS_SUCCESS ) || ( returnStatus == SOCKETS_DNS_FAILURE ) )
+            {
+                storeDnsCache( pServerInfo->pHostName,
+                               pServerInfo->hostNameLength,
+                               pListHead );
+            }
+        #endif
     }
 
     if( returnStatus == SOCKETS_SUCCESS )
     {
+        #if ( SOCKETS_DNS_CACHE_SIZE > 0U )
+            if( cacheHit == true )
+            {
+                LogDebug( ( "Using cached addresses: Hostname=%.*s.",
+                            ( int32_t ) pServerInfo->hostNameLength,
+                            pServerInfo->pHostName ) );
+                pListHead = cachedAddresses;
+            }
+        #endif
+
         returnStatus = attemptConnection( pListHead,
                                           pServerInfo->pHostName,
                                           pServerInfo->hostNameLength,
                                           pServerInfo->port,
+                                          ( pSocketsConfig != NULL ) ? pSocketsConfig->connectTimeoutMs : 0U,
+                                          pProtocol,
                                           pTcpSocket );
+
+        /* Cached addresses may be stale. Resolve the host name again on the
+         * next connection. */
+        if( ( returnStatus == SOCKETS_CONNECT_FAILURE ) && ( cacheHit == true ) )
+        {
+            Sockets_InvalidateDnsCache( pServerInfo->pHostName,
+                                        pServerInfo->hostNameLength );
+        }
+    }
+
+    if( ( pListHead != NULL ) && ( cacheHit == false ) )
+    {
+        zsock_freeaddrinfo( pListHead );
+    }
+
+    if( returnStatus == SOCKETS_SUCCESS )
+    {
+        returnStatus = configureSocket( *pTcpSocket,
+                                        sendTimeoutMs,
+                                        recvTimeoutMs,
+                                        pSocketsConfig );
+
+        if( returnStatus != SOCKETS_SUCCESS )
+        {
+            ( void ) zsock_close( *pTcpSocket );
+            *pTcpSocket = -1;
+        }
     }
 
     return returnStatus;
 }
 /*-----------------------------------------------------------*/
 
+void Sockets_InvalidateDnsCache( const char * pHostName,
+                                 size_t hostNameLength )
+{
+    #if ( SOCKETS_DNS_CACHE_SIZE > 0U )
+        DnsCacheEntry_t * pEntry = NULL;
+        size_t index = 0U;
+
+        ( void ) k_mutex_lock( &dnsCacheMutex, K_FOREVER );
+
+        if( pHostName == NULL )
+        {
+            for( index = 0U; index < SOCKETS_DNS_CACHE_SIZE; index++ )
+            {
+                dnsCache[ index ].valid = false;
+            }
+        }
+        else
+        {
+            pEntry = findDnsCacheEntry( pHostName, hostNameLength );
+
+            if( pEntry != NULL )
+            {
+                pEntry->valid = false;
+            }
+        }
+
+        ( void ) k_mutex_unlock( &dnsCacheMutex );
+    #else /* if ( SOCKETS_DNS_CACHE_SIZE > 0U ) */
+        ( void ) pHostName;
+        ( void ) hostNameLength;
+    #endif /* if ( SOCKETS_DNS_CACHE_SIZE > 0U ) */
+}
+/*-----------------------------------------------------------*/
+
 SocketStatus_t Sockets_Disconnect( int32_t tcpSocket )
 {
     SocketStatus_t returnStatus = SOCKETS_SUCCESS;
@@ -324,3 +1409,96 @@ SocketStatus_t Sockets_Disconnect( int32_t tcpSocket )
     return returnStatus;
 }
 /*-----------------------------------------------------------*/
+
+SocketStatus_t Sockets_SetBlocking( int32_t tcpSocket,
+                                    bool blocking )
+{
+    SocketStatus_t returnStatus = SOCKETS_SUCCESS;
+    int32_t socketFlags = 0;
+
+    if( tcpSocket < 0 )
+    {
+        LogError( ( "Parameter check failed: tcpSocket was negative." ) );
+        returnStatus = SOCKETS_INVALID_PARAMETER;
+    }
+    else
+    {
+        socketFlags = zsock_fcntl( tcpSocket, F_GETFL, 0 );
+
+        if( socketFlags >= 0 )
+        {
+            socketFlags = ( blocking == true ) ? ( socketFlags & ~O_NONBLOCK ) :
+                          ( socketFlags | O_NONBLOCK );
+            socketFlags = zsock_fcntl( tcpSocket, F_SETFL, socketFlags );
+        }
+
+        if( socketFlags < 0 )
+        {
+            LogError( ( "Failed to set the socket to %s mode: errno=%d.",
+                        ( blocking == true ) ? "blocking" : "non-blocking",
+                        errno ) );
+            returnStatus = SOCKETS_API_ERROR;
+        }
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+void Sockets_ReadAheadReset( ReadAheadBuffer_t * pReadAhead )
+{
+    assert( pReadAhead != NULL );
+
+    pReadAhead->readIndex = 0U;
+    pReadAhead->fillLength = 0U;
+}
+/*-----------------------------------------------------------*/
+
+bool Sockets_ReadAheadShouldFill( const ReadAheadBuffer_t * pReadAhead,
+                                  size_t bytesToRecv )
+{
+    assert( pReadAhead != NULL );
+
+    return ( pReadAhead->pBuffer != NULL ) && ( bytesToRecv < pReadAhead->bufferSize );
+}
+/*-----------------------------------------------------------*/
+
+size_t Sockets_ReadAheadPending( const ReadAheadBuffer_t * pReadAhead )
+{
+    size_t pendingBytes = 0U;
+
+    assert( pReadAhead != NULL );
+
+    if( pReadAhead->fillLength > pReadAhead->readIndex )
+    {
+        pendingBytes = pReadAhead->fillLength - pReadAhead->readIndex;
+    }
+
+    return pendingBytes;
+}
+/*-----------------------------------------------------------*/
+
+size_t Sockets_ReadAheadCopy( ReadAheadBuffer_t * pReadAhead,
+                              void * pBuffer,
+                              size_t bytesToRecv )
+{
+    size_t bytesCopied = Sockets_ReadAheadPending( pReadAhead );
+
+    assert( pBuffer != NULL );
+
+    if( bytesCopied > bytesToRecv )
+    {
+        bytesCopied = bytesToRecv;
+    }
+
+    if( bytesCopied > 0U )
+    {
+        ( void ) memcpy( pBuffer,
+                         &( pReadAhead->pBuffer[ pReadAhead->readIndex ] ),
+                         bytesCopied );
+        pReadAhead->readIndex += bytesCopied;
+    }
+
+    return bytesCopied;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,559 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file tls_sockets_zephyr.c
+ * @brief TLS transport interface implementation on Zephyr TLS sockets.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+
+/* Zephyr socket includes. */
+#include <net/socket.h>
+
+#include "tls_sockets_zephyr.h"
+
+#if defined( CONFIG_NET_SOCKETS_SOCKOPT_TLS )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Maximum number of buffers passed to a single zsock_sendmsg call by
+ * #TlsSockets_Writev. Further buffers are left for the next call.
+ */
+    #ifndef TLS_SOCKETS_WRITEV_MAX_VECTORS
+        #define TLS_SOCKETS_WRITEV_MAX_VECTORS    ( 8U )
+    #endif
+
+/**
+ * @brief Value of the TLS_PEER_VERIFY option that requires the server
+ * certificate to be verified. Older Zephyr releases do not name it.
+ */
+    #ifndef TLS_PEER_VERIFY_REQUIRED
+        #define TLS_PEER_VERIFY_REQUIRED    ( 2 )
+    #endif
+
+/*-----------------------------------------------------------*/
+
+/* Each compilation unit must define the NetworkContext struct. */
+    struct NetworkContext
+    {
+        TlsSocketsParams_t * pParams;
+    };
+
+/**
+ * @brief What #prepareTlsSocket needs to configure a socket.
+ */
+    typedef struct PrepareContext
+    {
+        const ServerInfo_t * pServerInfo;
+        const TlsSocketsCredentials_t * pCredentials;
+    } PrepareContext_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Log possible error from send/recv.
+ *
+ * @param[in] errorNumber Error number to be logged.
+ */
+    static void logTransportError( int32_t errorNumber );
+
+/**
+ * @brief Set the TLS options of a socket before it connects.
+ *
+ * @param[in] tcpSocket The socket descriptor.
+ * @param[in] pContext The #PrepareContext_t of the connection.
+ *
+ * @return #SOCKETS_SUCCESS if successful; #SOCKETS_API_ERROR if an option
+ * was rejected.
+ */
+    static SocketStatus_t prepareTlsSocket( int32_t tcpSocket,
+                                            void * pContext );
+
+/**
+ * @brief Set a TLS option of a socket, logging an error on failure.
+ *
+ * @param[in] tcpSocket The socket descriptor.
+ * @param[in] option The SOL_TLS option.
+ * @param[in] pValue Value of the option.
+ * @param[in] valueLength Length of @p pValue.
+ * @param[in] pOptionName Name of the option, for logging.
+ *
+ * @return #SOCKETS_SUCCESS if successful; #SOCKETS_API_ERROR on error.
+ */
+    static SocketStatus_t setTlsOption( int32_t tcpSocket,
+                                        int32_t option,
+                                        const void * pValue,
+                                        size_t valueLength,
+                                        const char * pOptionName );
+
+/*-----------------------------------------------------------*/
+
+    static void logTransportError( int32_t errorNumber )
+    {
+        /* Remove unused parameter warning. */
+        ( void ) errorNumber;
+
+        LogError( ( "A transport error occurred: %d.", errorNumber ) );
+    }
+/*-----------------------------------------------------------*/
+
+    static SocketStatus_t setTlsOption( int32_t tcpSocket,
+                                        int32_t option,
+                                        const void * pValue,
+                                        size_t valueLength,
+                                        const char * pOptionName )
+    {
+        SocketStatus_t returnStatus = SOCKETS_SUCCESS;
+
+        /* Unused parameter when logging is disabled. */
+        ( void ) pOptionName;
+
+        if( zsock_setsockopt( tcpSocket,
+                              SOL_TLS,
+                              option,
+                              pValue,
+                              ( socklen_t ) valueLength ) < 0 )
+        {
+            LogError( ( "Failed to set TLS socket option %s: errno=%d.",
+                        pOptionName,
+                        errno ) );
+            returnStatus = SOCKETS_API_ERROR;
+        }
+
+        return returnStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    static SocketStatus_t prepareTlsSocket( int32_t tcpSocket,
+                                            void * pContext )
+    {
+        SocketStatus_t returnStatus = SOCKETS_SUCCESS;
+        const PrepareContext_t * pPrepareContext = pContext;
+        const TlsSocketsCredentials_t * pCredentials = pPrepareContext->pCredentials;
+        int32_t peerVerify = TLS_PEER_VERIFY_REQUIRED;
+        size_t alpnCount = 0U;
+
+        returnStatus = setTlsOption( tcpSocket,
+                                     TLS_SEC_TAG_LIST,
+                                     pCredentials->pSecTags,
+                                     pCredentials->secTagCount * sizeof( sec_tag_t ),
+                                     "TLS_SEC_TAG_LIST" );
+
+        if( returnStatus == SOCKETS_SUCCESS )
+        {
+            returnStatus = setTlsOption( tcpSocket,
+                                         TLS_PEER_VERIFY,
+                                         &peerVerify,
+                                         sizeof( peerVerify ),
+                                         "TLS_PEER_VERIFY" );
+        }
+
+        /* The host name also enables verification of the server certificate
+         * against it, as with the mbed TLS transport. */
+        if( ( returnStatus == SOCKETS_SUCCESS ) && ( pCredentials->disableSni == false ) )
+        {
+            returnStatus = setTlsOption( tcpSocket,
+                                         TLS_HOSTNAME,
+                                         pPrepareContext->pServerInfo->pHostName,
+                                         pPrepareContext->pServerInfo->hostNameLength,
+                                         "TLS_HOSTNAME" );
+        }
+
+        if( ( returnStatus == SOCKETS_SUCCESS ) && ( pCredentials->pAlpnProtos != NULL ) )
+        {
+            /* The option takes the array of protocols without its NULL terminator. */
+            while( pCredentials->pAlpnProtos[ alpnCount ] != NULL )
+            {
+                alpnCount++;
+            }
+
+            returnStatus = setTlsOption( tcpSocket,
+                                         TLS_ALPN_LIST,
+                                         pCredentials->pAlpnProtos,
+                                         alpnCount * sizeof( const char * ),
+                                         "TLS_ALPN_LIST" );
+        }
+
+        return returnStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    TlsSocketsStatus_t TlsSockets_AddCredential( sec_tag_t secTag,
+                                                 enum tls_credential_type type,
+                                                 const void * pCredential,
+                                                 size_t credentialLength )
+    {
+        TlsSocketsStatus_t returnStatus = TLS_SOCKETS_SUCCESS;
+        int addStatus = 0;
+
+        if( ( pCredential == NULL ) || ( credentialLength == 0U ) )
+        {
+            LogError( ( "Invalid input parameter(s): pCredential=%p, credentialLength=%u.",
+                        pCredential,
+                        ( unsigned int ) credentialLength ) );
+            returnStatus = TLS_SOCKETS_INVALID_PARAMETER;
+        }
+        else
+        {
+            addStatus = tls_credential_add( secTag, type, pCredential, credentialLength );
+
+            if( addStatus == -EEXIST )
+            {
+                LogDebug( ( "Credential of type %d is already registered under tag %d.",
+                            ( int ) type,
+                            ( int ) secTag ) );
+            }
+            else if( addStatus < 0 )
+            {
+                LogError( ( "Failed to register credential of type %d under tag %d: Error=%d.",
+                            ( int ) type,
+                            ( int ) secTag,
+                            addStatus ) );
+                returnStatus = TLS_SOCKETS_INVALID_CREDENTIALS;
+            }
+            else
+            {
+                /* Empty else marker. */
+            }
+        }
+
+        return returnStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    TlsSocketsStatus_t TlsSockets_Connect( NetworkContext_t * pNetworkContext,
+                                           const ServerInfo_t * pServerInfo,
+                                           const TlsSocketsCredentials_t * pCredentials,
+                                           uint32_t receiveTimeoutMs,
+                                           uint32_t sendTimeoutMs,
+                                           const SocketsConfig_t * pSocketsConfig )
+    {
+        TlsSocketsStatus_t returnStatus = TLS_SOCKETS_SUCCESS;
+        SocketStatus_t socketStatus = SOCKETS_SUCCESS;
+        PrepareContext_t prepareContext;
+        SocketsProtocol_t protocol;
+
+        if( ( pNetworkContext == NULL ) ||
+            ( pNetworkContext->pParams == NULL ) ||
+            ( pServerInfo == NULL ) ||
+            ( pCredentials == NULL ) )
+        {
+            LogError( ( "Invalid input parameter(s): Arguments cannot be NULL. pNetworkContext=%p, "
+                        "pServerInfo=%p, pCredentials=%p.",
+                        pNetworkContext,
+                        pServerInfo,
+                        pCredentials ) );
+            returnStatus = TLS_SOCKETS_INVALID_PARAMETER;
+        }
+        else if( ( pCredentials->pSecTags == NULL ) || ( pCredentials->secTagCount == 0U ) )
+        {
+            LogError( ( "At least one security tag is required to verify the server." ) );
+            returnStatus = TLS_SOCKETS_INVALID_PARAMETER;
+        }
+        else
+        {
+            prepareContext.pServerInfo = pServerInfo;
+            prepareContext.pCredentials = pCredentials;
+
+            protocol.protocol = IPPROTO_TLS_1_2;
+            protocol.prepare = prepareTlsSocket;
+            protocol.pPrepareContext = &prepareContext;
+
+            socketStatus = Sockets_ConnectWithProtocol( &( pNetworkContext->pParams->socketDescriptor ),
+                                                        pServerInfo,
+                                                        sendTimeoutMs,
+                                                        receiveTimeoutMs,
+                                                        pSocketsConfig,
+                                                        &protocol );
+
+            switch( socketStatus )
+            {
+                case SOCKETS_SUCCESS:
+                    returnStatus = TLS_SOCKETS_SUCCESS;
+                    break;
+
+                case SOCKETS_INVALID_PARAMETER:
+                    returnStatus = TLS_SOCKETS_INVALID_PARAMETER;
+                    break;
+
+                case SOCKETS_DNS_FAILURE:
+                    returnStatus = TLS_SOCKETS_DNS_FAILURE;
+                    break;
+
+                case SOCKETS_CONNECT_FAILURE:
+                    returnStatus = TLS_SOCKETS_CONNECT_FAILURE;
+                    break;
+
+                default:
+                    returnStatus = TLS_SOCKETS_INTERNAL_ERROR;
+                    break;
+            }
+        }
+
+        if( returnStatus == TLS_SOCKETS_SUCCESS )
+        {
+            LogDebug( ( "Established TLS connection: Server=%.*s.",
+                        ( int32_t ) pServerInfo->hostNameLength,
+                        pServerInfo->pHostName ) );
+        }
+
+        return returnStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    SocketStatus_t TlsSockets_Disconnect( const NetworkContext_t * pNetworkContext )
+    {
+        SocketStatus_t returnStatus = SOCKETS_SUCCESS;
+
+        /* Validate parameters. */
+        if( ( pNetworkContext == NULL ) || ( pNetworkContext->pParams == NULL ) )
+        {
+            LogError( ( "Parameter check failed: pNetworkContext is NULL." ) );
+            returnStatus = SOCKETS_INVALID_PARAMETER;
+        }
+        else
+        {
+            /* Closing a TLS socket sends the close notification first. */
+            returnStatus = Sockets_Disconnect( pNetworkContext->pParams->socketDescriptor );
+        }
+
+        return returnStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    int32_t TlsSockets_Recv( NetworkContext_t * pNetworkContext,
+                             void * pBuffer,
+                             size_t bytesToRecv )
+    {
+        TlsSocketsParams_t * pTlsSocketsParams = NULL;
+        int32_t bytesReceived = -1, pollStatus = 1;
+        struct zsock_pollfd pollFds;
+
+        assert( pNetworkContext != NULL && pNetworkContext->pParams != NULL );
+        assert( pBuffer != NULL );
+        assert( bytesToRecv > 0 );
+
+        pTlsSocketsParams = pNetworkContext->pParams;
+
+        /* Initialize the file descriptor. The TLS socket reports data as
+         * readable once a whole record has been decrypted, or while part of
+         * a decrypted record is still buffered. */
+        pollFds.events = ZSOCK_POLLIN | ZSOCK_POLLPRI;
+        pollFds.revents = 0;
+        /* Set the file descriptor for poll. */
+        pollFds.fd = pTlsSocketsParams->socketDescriptor;
+
+        /* Speculative read for the start of a payload, as in Plaintext_Recv.
+         * Note: This is done to avoid blocking when no data is available. */
+        if( bytesToRecv == 1U )
+        {
+            pollStatus = zsock_poll( &pollFds, 1, 1 );
+        }
+
+        if( pollStatus > 0 )
+        {
+            /* The socket is available for receiving data. */
+            bytesReceived = ( int32_t ) zsock_recv( pTlsSocketsParams->socketDescriptor,
+                                                    pBuffer,
+                                                    bytesToRecv,
+                                                    0 );
+        }
+        else if( pollStatus < 0 )
+        {
+            /* An error occurred while polling. */
+            bytesReceived = -1;
+        }
+        else
+        {
+            /* No data available to receive. */
+            bytesReceived = 0;
+        }
+
+        /* Note: A zero value return from recv() represents
+         * closure of the connection by the peer. */
+        if( ( pollStatus > 0 ) && ( bytesReceived == 0 ) )
+        {
+            /* Peer has closed the connection. Treat as an error. */
+            bytesReceived = -1;
+        }
+        else if( ( bytesReceived < 0 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
+        {
+            /* The receive timeout of the socket expired. The caller may retry. */
+            bytesReceived = 0;
+        }
+        else if( bytesReceived < 0 )
+        {
+            logTransportError( errno );
+        }
+
+        return bytesReceived;
+    }
+/*-----------------------------------------------------------*/
+
+    int32_t TlsSockets_Send( NetworkContext_t * pNetworkContext,
+                             const void * pBuffer,
+                             size_t bytesToSend )
+    {
+        TlsSocketsParams_t * pTlsSocketsParams = NULL;
+        int32_t bytesSent = -1, pollStatus = -1;
+        struct zsock_pollfd pollFds;
+
+        assert( pNetworkContext != NULL && pNetworkContext->pParams != NULL );
+        assert( pBuffer != NULL );
+        assert( bytesToSend > 0 );
+
+        pTlsSocketsParams = pNetworkContext->pParams;
+
+        /* Initialize the file descriptor. */
+        pollFds.events = ZSOCK_POLLOUT;
+        pollFds.revents = 0;
+        /* Set the file descriptor for poll. */
+        pollFds.fd = pTlsSocketsParams->socketDescriptor;
+
+        /* Check if data can be written to the socket, as in Plaintext_Send. */
+        pollStatus = zsock_poll( &pollFds, 1, 0 );
+
+        if( pollStatus > 0 )
+        {
+            /* The socket is available for sending data. */
+            bytesSent = ( int32_t ) zsock_send( pTlsSocketsParams->socketDescriptor,
+                                                pBuffer,
+                                                bytesToSend,
+                                                0 );
+        }
+        else if( pollStatus < 0 )
+        {
+            /* An error occurred while polling. */
+            bytesSent = -1;
+        }
+        else
+        {
+            /* Socket is not available for sending data. */
+            bytesSent = 0;
+        }
+
+        if( ( pollStatus > 0 ) && ( bytesSent == 0 ) )
+        {
+            /* Peer has closed the connection. Treat as an error. */
+            bytesSent = -1;
+        }
+        else if( bytesSent < 0 )
+        {
+            logTransportError( errno );
+        }
+
+        return bytesSent;
+    }
+/*-----------------------------------------------------------*/
+
+    int32_t TlsSockets_Writev( NetworkContext_t * pNetworkContext,
+                               TransportOutVector_t * pIoVec,
+                               size_t ioVecCount )
+    {
+        TlsSocketsParams_t * pTlsSocketsParams = NULL;
+        int32_t bytesSent = -1, pollStatus = -1;
+        struct zsock_pollfd pollFds;
+        struct iovec socketIoVec[ TLS_SOCKETS_WRITEV_MAX_VECTORS ];
+        struct msghdr message;
+        size_t index = 0U, bytesToSend = 0U;
+
+        assert( pNetworkContext != NULL && pNetworkContext->pParams != NULL );
+        assert( pIoVec != NULL );
+        assert( ioVecCount > 0 );
+
+        pTlsSocketsParams = pNetworkContext->pParams;
+
+        /* Send at most #TLS_SOCKETS_WRITEV_MAX_VECTORS buffers. The caller
+         * sends the rest, as it would after any other partial send. */
+        if( ioVecCount > TLS_SOCKETS_WRITEV_MAX_VECTORS )
+        {
+            ioVecCount = TLS_SOCKETS_WRITEV_MAX_VECTORS;
+        }
+
+        for( index = 0U; index < ioVecCount; index++ )
+        {
+            socketIoVec[ index ].iov_base = ( void * ) pIoVec[ index ].iov_base;
+            socketIoVec[ index ].iov_len = pIoVec[ index ].iov_len;
+            bytesToSend += pIoVec[ index ].iov_len;
+        }
+
+        ( void ) memset( &message, 0, sizeof( message ) );
+        message.msg_iov = socketIoVec;
+        message.msg_iovlen = ioVecCount;
+
+        /* Initialize the file descriptor. */
+        pollFds.events = ZSOCK_POLLOUT;
+        pollFds.revents = 0;
+        /* Set the file descriptor for poll. */
+        pollFds.fd = pTlsSocketsParams->socketDescriptor;
+
+        /* Check if data can be written to the socket, as in Plaintext_Send. */
+        pollStatus = zsock_poll( &pollFds, 1, 0 );
+
+        if( bytesToSend == 0U )
+        {
+            /* Nothing to send. */
+            bytesSent = 0;
+        }
+        else if( pollStatus > 0 )
+        {
+            /* The socket encrypts the buffers into as few records as it can. */
+            bytesSent = ( int32_t ) zsock_sendmsg( pTlsSocketsParams->socketDescriptor,
+                                                   &message,
+                                                   0 );
+
+            if( bytesSent == 0 )
+            {
+                /* Peer has closed the connection. Treat as an error. */
+                bytesSent = -1;
+            }
+            else if( bytesSent < 0 )
+            {
+                logTransportError( errno );
+            }
+            else
+            {
+                /* Empty else marker. */
+            }
+        }
+        else if( pollStatus < 0 )
+        {
+            /* An error occurred while polling. */
+            logTransportError( errno );
+            bytesSent = -1;
+        }
+        else
+        {
+            /* Socket is not available for sending data. */
+            bytesSent = 0;
+        }
+
+        return bytesSent;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* if defined( CONFIG_NET_SOCKETS_SOCKOPT_TLS ) */
@@ -0,0 +1,243 @@
+/*
+ * AWS IoT Device Embedded C SDK for ZephyrRTOS
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file transport_metrics_zephyr.c
+ * @brief Counters and latency histograms of the transport connections.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+/* Zephyr includes. */
+#include <kernel.h>
+
+#include "transport_metrics_zephyr.h"
+
+#if ( TRANSPORT_METRICS_ENABLED == 1 )
+
+/**
+ * @brief Lock protecting the metrics of every connection.
+ *
+ * A spinlock keeps the cost on the send and receive paths to a few
+ * instructions, and the sections it protects never block.
+ */
+    static struct k_spinlock metricsLock;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Add the duration of a call to a latency histogram.
+ *
+ * @note #metricsLock must be held by the caller.
+ *
+ * @param[in] pHistogram The histogram.
+ * @param[in] startCycles Value of #TransportMetrics_Now when the call started.
+ */
+    static void addLatency( TransportLatencyHistogram_t * pHistogram,
+                            uint32_t startCycles );
+
+/**
+ * @brief Account the result of a send or receive call.
+ *
+ * @note #metricsLock must be held by the caller.
+ *
+ * @param[in] result Value returned by the call.
+ * @param[in,out] pBytes Bytes transferred by the connection.
+ * @param[in,out] pRetries Calls that returned 0 bytes.
+ * @param[in,out] pErrors Calls that failed.
+ */
+    static void addResult( int32_t result,
+                           uint64_t * pBytes,
+                           uint32_t * pRetries,
+                           uint32_t * pErrors );
+
+/*-----------------------------------------------------------*/
+
+    static void addLatency( TransportLatencyHistogram_t * pHistogram,
+                            uint32_t startCycles )
+    {
+        uint32_t elapsedUs = k_cyc_to_us_floor32( k_cycle_get_32() - startCycles );
+        uint32_t boundUs = TRANSPORT_METRICS_HISTOGRAM_BASE_US;
+        size_t bucket = 0U;
+
+        while( ( bucket < ( TRANSPORT_METRICS_HISTOGRAM_BUCKETS - 1U ) ) && ( elapsedUs >= boundUs ) )
+        {
+            bucket++;
+            boundUs <<= 1;
+        }
+
+        pHistogram->buckets[ bucket ]++;
+
+        if( elapsedUs > pHistogram->maxUs )
+        {
+            pHistogram->maxUs = elapsedUs;
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static void addResult( int32_t result,
+                           uint64_t * pBytes,
+                           uint32_t * pRetries,
+                           uint32_t * pErrors )
+    {
+        if( result > 0 )
+        {
+            *pBytes += ( uint64_t ) result;
+        }
+        else if( result == 0 )
+        {
+            ( *pRetries )++;
+        }
+        else
+        {
+            ( *pErrors )++;
+        }
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* if ( TRANSPORT_METRICS_ENABLED == 1 ) */
+
+uint32_t TransportMetrics_Now( void )
+{
+    #if ( TRANSPORT_METRICS_ENABLED == 1 )
+        return k_cycle_get_32();
+    #else
+        return 0U;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+void TransportMetrics_RecordRecv( TransportMetrics_t * pMetrics,
+                                  int32_t result,
+                                  uint32_t startCycles )
+{
+    assert( pMetrics != NULL );
+
+    #if ( TRANSPORT_METRICS_ENABLED == 1 )
+        k_spinlock_key_t key = k_spin_lock( &metricsLock );
+
+        pMetrics->recvCalls++;
+        addResult( result, &( pMetrics->bytesReceived ), &( pMetrics->recvRetries ), &( pMetrics->recvErrors ) );
+        addLatency( &( pMetrics->recvLatency ), startCycles );
+
+        k_spin_unlock( &metricsLock, key );
+    #else
+        ( void ) pMetrics;
+        ( void ) result;
+        ( void ) startCycles;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+void TransportMetrics_RecordSend( TransportMetrics_t * pMetrics,
+                                  int32_t result,
+                                  uint32_t startCycles )
+{
+    assert( pMetrics != NULL );
+
+    #if ( TRANSPORT_METRICS_ENABLED == 1 )
+        k_spinlock_key_t key = k_spin_lock( &metricsLock );
+
+        pMetrics->sendCalls++;
+        addResult( result, &( pMetrics->bytesSent ), &( pMetrics->sendRetries ), &( pMetrics->sendErrors ) );
+        addLatency( &( pMetrics->sendLatency ), startCycles );
+
+        k_spin_unlock( &metricsLock, key );
+    #else
+        ( void ) pMetrics;
+        ( void ) result;
+        ( void ) startCycles;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+void TransportMetrics_RecordPoll( TransportMetrics_t * pMetrics,
+                                  int32_t pollStatus )
+{
+    assert( pMetrics != NULL );
+
+    #if ( TRANSPORT_METRICS_ENABLED == 1 )
+        k_spinlock_key_t key = k_spin_lock( &metricsLock );
+
+        pMetrics->pollCalls++;
+
+        if( pollStatus == 0 )
+        {
+            pMetrics->pollTimeouts++;
+        }
+
+        k_spin_unlock( &metricsLock, key );
+    #else
+        ( void ) pMetrics;
+        ( void ) pollStatus;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+void TransportMetrics_RecordTlsRecords( TransportMetrics_t * pMetrics,
+                                        uint32_t recordsRead,
+                                        uint32_t recordsWritten )
+{
+    assert( pMetrics != NULL );
+
+    #if ( TRANSPORT_METRICS_ENABLED == 1 )
+        k_spinlock_key_t key = k_spin_lock( &metricsLock );
+
+        pMetrics->recordsRead += recordsRead;
+        pMetrics->recordsWritten += recordsWritten;
+
+        k_spin_unlock( &metricsLock, key );
+    #else
+        ( void ) pMetrics;
+        ( void ) recordsRead;
+        ( void ) recordsWritten;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+void TransportMetrics_Snapshot( TransportMetrics_t * pMetrics,
+                                TransportMetrics_t * pSnapshot,
+                                bool reset )
+{
+    assert( pMetrics != NULL );
+    assert( pSnapshot != NULL );
+
+    #if ( TRANSPORT_METRICS_ENABLED == 1 )
+        k_spinlock_key_t key = k_spin_lock( &metricsLock );
+
+        *pSnapshot = *pMetrics;
+
+        if( reset == true )
+        {
+            ( void ) memset( pMetrics, 0, sizeof( TransportMetrics_t ) );
+        }
+
+        k_spin_unlock( &metricsLock, key );
+    #else
+        ( void ) pMetrics;
+        ( void ) reset;
+        ( void ) memset( pSnapshot, 0, sizeof( TransportMetrics_t ) );
+    #endif
+}
+/*-----------------------------------------------------------*/
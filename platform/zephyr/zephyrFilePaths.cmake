@@ -7,7 +7,8 @@
 
 # Platform socket library source files.
 set( SOCKETS_SOURCES
-     ${CMAKE_CURRENT_LIST_DIR}/transport/src/sockets_zephyr.c )
+     ${CMAKE_CURRENT_LIST_DIR}/transport/src/sockets_zephyr.c
+     ${CMAKE_CURRENT_LIST_DIR}/transport/src/transport_metrics_zephyr.c )
 
 # Platform plaintext library source files.
 set( PLAINTEXT_SOURCES
@@ -15,15 +16,99 @@ set( PLAINTEXT_SOURCES
 
 # Platform mbedtls library source files.
 set( MBEDTLS_SOURCES
-     ${CMAKE_CURRENT_LIST_DIR}/transport/src/mbedtls_zephyr.c )
+     ${CMAKE_CURRENT_LIST_DIR}/transport/src/mbedtls_zephyr.c
+     ${CMAKE_CURRENT_LIST_DIR}/transport/src/mbedtls_arena_zephyr.c )
+
+# Platform Zephyr TLS sockets library source files.
+set( TLS_SOCKETS_SOURCES
+     ${CMAKE_CURRENT_LIST_DIR}/transport/src/tls_sockets_zephyr.c )
 
 # Platform transport library include directories.
 set( COMMON_TRANSPORT_INCLUDE_PUBLIC_DIRS
      ${CMAKE_CURRENT_LIST_DIR}/transport/include )
 
+# Platform reconnect scheduler source files.
+set( RECONNECT_ZEPHYR_SOURCES
+     ${CMAKE_CURRENT_LIST_DIR}/reconnect/src/reconnect_scheduler.c )
+
+# Platform reconnect scheduler include directories.
+set( RECONNECT_ZEPHYR_INCLUDE_PUBLIC_DIRS
+     ${CMAKE_CURRENT_LIST_DIR}/reconnect/include )
+
+# Platform network buffer pool source files. The pool reserves its RAM, so it
+# is only built when selected.
+set( NETWORK_BUFFER_POOL_SOURCES )
+
+if( CONFIG_AWS_IOT_NETWORK_BUFFER_POOL )
+    list( APPEND NETWORK_BUFFER_POOL_SOURCES
+          ${CMAKE_CURRENT_LIST_DIR}/buffers/src/network_buffer_pool.c )
+endif()
+
+# Platform network buffer pool include directories.
+set( NETWORK_BUFFER_POOL_INCLUDE_PUBLIC_DIRS
+     ${CMAKE_CURRENT_LIST_DIR}/buffers/include )
+
+# Platform MQTT helper source files.
+set( MQTT_ZEPHYR_SOURCES
+     ${CMAKE_CURRENT_LIST_DIR}/mqtt/src/outgoing_publish_tracker.c
+     ${CMAKE_CURRENT_LIST_DIR}/mqtt/src/mqtt_idle.c )
+
+# Platform MQTT helper include directories.
+set( MQTT_ZEPHYR_INCLUDE_PUBLIC_DIRS
+     ${CMAKE_CURRENT_LIST_DIR}/mqtt/include )
+
+# Platform JSON helper source files.
+set( JSON_ZEPHYR_SOURCES
+     ${CMAKE_CURRENT_LIST_DIR}/json/src/json_extract.c )
+
+# Platform JSON helper include directories.
+set( JSON_ZEPHYR_INCLUDE_PUBLIC_DIRS
+     ${CMAKE_CURRENT_LIST_DIR}/json/include )
+
+# Platform Device Shadow helper source files.
+set( SHADOW_ZEPHYR_SOURCES
+     ${CMAKE_CURRENT_LIST_DIR}/shadow/src/shadow_state.c
+     ${CMAKE_CURRENT_LIST_DIR}/shadow/src/shadow_session.c
+     ${CMAKE_CURRENT_LIST_DIR}/shadow/src/shadow_cbor.c )
+
+# Platform Device Shadow helper include directories.
+set( SHADOW_ZEPHYR_INCLUDE_PUBLIC_DIRS
+     ${CMAKE_CURRENT_LIST_DIR}/shadow/include )
+
 set( MQTT_AGENT_ZEPHYR_SOURCES
      ${CMAKE_CURRENT_LIST_DIR}/mqtt_agent/src/agent_interface_zephyr.c
-     ${CMAKE_CURRENT_LIST_DIR}/mqtt_agent/src/subscription_manager.c )
+     ${CMAKE_CURRENT_LIST_DIR}/mqtt_agent/src/agent_latency_zephyr.c
+     ${CMAKE_CURRENT_LIST_DIR}/mqtt_agent/src/thread_profiler_zephyr.c
+     ${CMAKE_CURRENT_LIST_DIR}/mqtt_agent/src/resubscribe.c )
+
+# The topic trie replaces the linear subscription list when selected.
+if( CONFIG_AWS_IOT_MQTT_AGENT_SUBSCRIPTION_TRIE )
+    list( APPEND MQTT_AGENT_ZEPHYR_SOURCES
+          ${CMAKE_CURRENT_LIST_DIR}/mqtt_agent/src/subscription_trie.c )
+else()
+    list( APPEND MQTT_AGENT_ZEPHYR_SOURCES
+          ${CMAKE_CURRENT_LIST_DIR}/mqtt_agent/src/subscription_manager.c )
+endif()
+
+if( CONFIG_AWS_IOT_MQTT_AGENT_PUBLISH_DISPATCHER )
+    list( APPEND MQTT_AGENT_ZEPHYR_SOURCES
+          ${CMAKE_CURRENT_LIST_DIR}/mqtt_agent/src/publish_dispatcher.c )
+endif()
+
+if( CONFIG_AWS_IOT_MQTT_AGENT_RUNNER )
+    list( APPEND MQTT_AGENT_ZEPHYR_SOURCES
+          ${CMAKE_CURRENT_LIST_DIR}/mqtt_agent/src/agent_runner_zephyr.c )
+endif()
+
+if( CONFIG_AWS_IOT_MQTT_AGENT_OFFLINE_QUEUE )
+    list( APPEND MQTT_AGENT_ZEPHYR_SOURCES
+          ${CMAKE_CURRENT_LIST_DIR}/mqtt_agent/src/offline_queue.c )
+endif()
+
+if( CONFIG_AWS_IOT_MQTT_AGENT_PAYLOAD_POOL )
+    list( APPEND MQTT_AGENT_ZEPHYR_SOURCES
+          ${CMAKE_CURRENT_LIST_DIR}/mqtt_agent/src/payload_pool.c )
+endif()
 
 set( MQTT_AGENT_ZEPHYR_INCLUDE_PUBLIC_DIRS
      ${CMAKE_CURRENT_LIST_DIR}/mqtt_agent/include )